@@ -0,0 +1,188 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include "batching_model_server.h"
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/op_context.h>
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* BatchingModelServer */
+/************************************************************************/
+BatchingModelServer::~BatchingModelServer() { Stop(); }
+
+bool BatchingModelServer::TakeBatch(std::vector<Request>* batch) {
+  std::unique_lock<std::mutex> guard(mutex_);
+  for (;;) {
+    cond_.wait(guard, [this]() { return stop_ || !requests_.empty(); });
+    if (requests_.empty()) {
+      return false;
+    }
+
+    // Wait for a full batch until the oldest request expires.
+    auto deadline = requests_.front().queue_time +
+                    std::chrono::microseconds(config_.max_wait_us);
+    while (!stop_ && !requests_.empty() &&
+           (int)requests_.size() < config_.max_batch) {
+      if (cond_.wait_until(guard, deadline) == std::cv_status::timeout) {
+        break;
+      }
+    }
+    // Requests may be taken by other workers.
+    if (!requests_.empty()) {
+      break;
+    }
+  }
+
+  size_t n = std::min(requests_.size(), (size_t)config_.max_batch);
+  batch->clear();
+  for (size_t i = 0; i < n; ++i) {
+    batch->emplace_back(std::move(requests_.front()));
+    requests_.pop_front();
+  }
+  if (!requests_.empty()) {
+    cond_.notify_one();
+  }
+  return true;
+}
+
+void BatchingModelServer::WorkerThread() {
+  ModelServer::op_context_ptr_t op_context = model_server_->NewOpContext();
+  std::vector<Request> batch;
+  std::vector<features_t> batch_features;
+  std::vector<std::vector<float>> batch_probs;
+  while (TakeBatch(&batch)) {
+    auto begin = steady_clock_t::now();
+    uint64_t queue_us = 0;
+    batch_features.resize(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+      queue_us += (uint64_t)std::chrono::duration_cast<
+                      std::chrono::microseconds>(begin - batch[i].queue_time)
+                      .count();
+      batch_features[i].swap(batch[i].features);
+    }
+
+    bool ok = false;
+    try {
+      // There may be no version when the worker started,
+      // or 'op_context' was dropped by an exception.
+      if (!op_context) {
+        op_context = model_server_->NewOpContext();
+      }
+      ok = op_context && BatchPredict(op_context.get(), batch_features,
+                                      &batch_probs);
+    } catch (std::exception& e) {
+      DXERROR("Failed to predict a batch of %zu requests: %s.", batch.size(),
+              e.what());
+      op_context.reset();
+    } catch (...) {
+      DXERROR("Failed to predict a batch of %zu requests.", batch.size());
+      op_context.reset();
+    }
+    ok = ok && batch_probs.size() == batch.size();
+    auto end = steady_clock_t::now();
+    // Every request of the batch is answered, so that no caller waits
+    // forever on its future.
+    for (size_t i = 0; i < batch.size(); ++i) {
+      if (ok) {
+        batch[i].probs->swap(batch_probs[i]);
+      }
+      batch[i].promise.set_value(ok);
+    }
+
+    request_ += batch.size();
+    ++batch_;
+    queue_us_ += queue_us;
+    compute_us_ += (uint64_t)std::chrono::duration_cast<
+                       std::chrono::microseconds>(end - begin)
+                       .count();
+  }
+}
+
+bool BatchingModelServer::BatchPredict(
+    OpContext* op_context, const std::vector<features_t>& batch_features,
+    std::vector<std::vector<float>>* batch_probs) {
+  return model_server_->BatchPredict(op_context, batch_features, batch_probs);
+}
+
+void BatchingModelServer::Start(const ModelServer* model_server,
+                                const Config& config) {
+  DXCHECK_THROW(threads_.empty());
+  DXCHECK_THROW(config.thread > 0);
+  DXCHECK_THROW(config.max_batch > 0);
+  DXCHECK_THROW(config.max_wait_us >= 0);
+  model_server_ = model_server;
+  config_ = config;
+  stop_ = 0;
+  ResetStats();
+  for (int i = 0; i < config_.thread; ++i) {
+    threads_.emplace_back(&BatchingModelServer::WorkerThread, this);
+  }
+}
+
+void BatchingModelServer::Stop() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stop_ = 1;
+  }
+  cond_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+std::future<bool> BatchingModelServer::PredictAsync(
+    features_t features, std::vector<float>* probs) {
+  Request request;
+  request.features = std::move(features);
+  request.probs = probs;
+  request.queue_time = steady_clock_t::now();
+  std::future<bool> future = request.promise.get_future();
+
+  bool full;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (stop_ || threads_.empty()) {
+      request.promise.set_value(false);
+      return future;
+    }
+    requests_.emplace_back(std::move(request));
+    full = (int)requests_.size() >= config_.max_batch;
+  }
+  // A full batch wakes up the worker waiting for it.
+  if (full) {
+    cond_.notify_all();
+  } else {
+    cond_.notify_one();
+  }
+  return future;
+}
+
+bool BatchingModelServer::Predict(const features_t& features,
+                                  std::vector<float>* probs) {
+  return PredictAsync(features, probs).get();
+}
+
+BatchingModelServer::Stats BatchingModelServer::stats() const noexcept {
+  Stats stats;
+  stats.request = request_.load();
+  stats.batch = batch_.load();
+  stats.queue_ms = queue_us_.load() / 1e3;
+  stats.compute_ms = compute_us_.load() / 1e3;
+  return stats;
+}
+
+void BatchingModelServer::ResetStats() noexcept {
+  request_ = 0;
+  batch_ = 0;
+  queue_us_ = 0;
+  compute_us_ = 0;
+}
+
+}  // namespace deepx_core
@@ -0,0 +1,104 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "model_server.h"
+
+namespace deepx_core {
+
+// BatchingModelServer batches concurrent requests to a ModelServer.
+//
+// Requests are queued, worker threads take up to 'max_batch' of them
+// at a time, once 'max_batch' requests are queued or the oldest one
+// has waited for 'max_wait_us'.
+// Each batch is predicted by one 'BatchPredict' with the OpContext of
+// the worker, and each request receives its own probs.
+//
+// Hot swaps and deltas of the ModelServer are served as they are published.
+class BatchingModelServer {
+ public:
+  struct Config {
+    int thread = 1;
+    int max_batch = 64;
+    int max_wait_us = 1000;
+  };
+
+  // Sums since 'Start' or the last 'ResetStats'.
+  struct Stats {
+    uint64_t request = 0;
+    uint64_t batch = 0;
+    // from being queued to being taken by a worker
+    double queue_ms = 0;
+    // 'BatchPredict'
+    double compute_ms = 0;
+  };
+
+ private:
+  using steady_clock_t = std::chrono::steady_clock;
+
+  struct Request {
+    features_t features;
+    std::vector<float>* probs;
+    std::promise<bool> promise;
+    steady_clock_t::time_point queue_time;
+  };
+
+  const ModelServer* model_server_ = nullptr;
+  Config config_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Request> requests_;
+  int stop_ = 0;
+  std::vector<std::thread> threads_;
+  std::atomic<uint64_t> request_{0};
+  std::atomic<uint64_t> batch_{0};
+  std::atomic<uint64_t> queue_us_{0};
+  std::atomic<uint64_t> compute_us_{0};
+
+ public:
+  BatchingModelServer() = default;
+  virtual ~BatchingModelServer();
+  BatchingModelServer(const BatchingModelServer&) = delete;
+  BatchingModelServer& operator=(const BatchingModelServer&) = delete;
+
+ private:
+  // Take the next batch, return false if it is stopped.
+  bool TakeBatch(std::vector<Request>* batch);
+  void WorkerThread();
+
+ protected:
+  // Predict a batch, called by worker threads.
+  // Exceptions fail all requests of the batch.
+  // Subclasses overriding it must call 'Stop' in their destructors.
+  virtual bool BatchPredict(OpContext* op_context,
+                            const std::vector<features_t>& batch_features,
+                            std::vector<std::vector<float>>* batch_probs);
+
+ public:
+  // 'model_server' must outlive this.
+  void Start(const ModelServer* model_server, const Config& config);
+  // Serve all queued requests and stop worker threads.
+  void Stop();
+
+ public:
+  // 'probs' must be valid until the future is ready.
+  std::future<bool> PredictAsync(features_t features,
+                                 std::vector<float>* probs);
+  bool Predict(const features_t& features, std::vector<float>* probs);
+
+ public:
+  Stats stats() const noexcept;
+  void ResetStats() noexcept;
+};
+
+}  // namespace deepx_core
@@ -0,0 +1,214 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include "batching_model_server.h"
+#include <deepx_core/common/group_config.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "model_server.h"
+#include "model_zoo.h"
+
+namespace deepx_core {
+
+// It records sizes of batches, and throws when 'fail' is set.
+class TestBatchingModelServer : public BatchingModelServer {
+ public:
+  std::atomic<int> fail{0};
+  std::mutex mutex;
+  std::vector<size_t> batch_sizes;
+
+ public:
+  ~TestBatchingModelServer() override { Stop(); }
+
+ protected:
+  bool BatchPredict(OpContext* op_context,
+                    const std::vector<features_t>& batch_features,
+                    std::vector<std::vector<float>>* batch_probs) override {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      batch_sizes.emplace_back(batch_features.size());
+    }
+    if (fail) {
+      throw std::runtime_error("TestBatchingModelServer");
+    }
+    return BatchingModelServer::BatchPredict(op_context, batch_features,
+                                             batch_probs);
+  }
+};
+
+class BatchingModelServerTest : public testing::Test, public DataType {
+ protected:
+  static constexpr int REQUEST = 100;
+  ModelServer model_server;
+  std::vector<features_t> requests;
+
+ protected:
+  void SetUp() override {
+    std::string group_config = "1:100:4,2:100:4";
+    std::unique_ptr<ModelZoo> model_zoo(NewModelZoo("deep_fm"));
+    ASSERT_TRUE(model_zoo);
+    StringMap config;
+    config["group_config"] = group_config;
+    config["sparse"] = "1";
+    ASSERT_TRUE(model_zoo->InitConfig(config));
+    Graph graph;
+    ASSERT_TRUE(model_zoo->InitGraph(&graph));
+
+    std::vector<GroupConfigItem> items;
+    ASSERT_TRUE(GuessGroupConfig(group_config, &items, nullptr));
+    std::default_random_engine engine;
+    Model model;
+    model.Init(&graph);
+    ASSERT_TRUE(model.InitParam(engine));
+    model.ForEachSRM([&engine, &items](const std::string&, srm_t* W) {
+      for (const GroupConfigItem& item : items) {
+        for (int i = 0; i < item.embedding_row; ++i) {
+          W->get_row(engine, (int_t)ll_sparse_tensor_t::make_feature_id(
+                                 item.group_id, (int_t)i));
+        }
+      }
+    });
+
+    std::string graph_file = "batching_model_server_test.graph";
+    std::string model_file = "batching_model_server_test.model";
+    ASSERT_TRUE(graph.Save(graph_file));
+    ASSERT_TRUE(model.Save(model_file));
+    ASSERT_TRUE(model_server.LoadGraph(graph_file));
+    ASSERT_TRUE(model_server.LoadModel(model_file));
+
+    std::uniform_int_distribution<int_t> id_dist(0, 99);
+    std::uniform_real_distribution<float> value_dist(0, 1);
+    requests.resize(REQUEST);
+    for (features_t& features : requests) {
+      for (const GroupConfigItem& item : items) {
+        features.emplace_back(ll_sparse_tensor_t::make_feature_id(
+                                  item.group_id, id_dist(engine)),
+                              value_dist(engine));
+      }
+    }
+  }
+
+  void CheckProbs(const features_t& features,
+                  const std::vector<float>& probs) const {
+    std::vector<float> expected_probs;
+    ASSERT_TRUE(model_server.Predict(features, &expected_probs));
+    ASSERT_EQ(probs.size(), expected_probs.size());
+    for (size_t i = 0; i < probs.size(); ++i) {
+      EXPECT_NEAR(probs[i], expected_probs[i], 1e-5);
+    }
+  }
+};
+
+constexpr int BatchingModelServerTest::REQUEST;
+
+TEST_F(BatchingModelServerTest, Predict_Concurrent) {
+  BatchingModelServer::Config config;
+  config.thread = 2;
+  config.max_batch = 8;
+  config.max_wait_us = 100;
+  BatchingModelServer batching_model_server;
+  batching_model_server.Start(&model_server, config);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([this, t, &batching_model_server]() {
+      std::vector<float> probs;
+      for (int i = t; i < REQUEST; i += 4) {
+        ASSERT_TRUE(batching_model_server.Predict(requests[i], &probs));
+        CheckProbs(requests[i], probs);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  batching_model_server.Stop();
+  EXPECT_EQ(batching_model_server.stats().request, (uint64_t)REQUEST);
+}
+
+TEST_F(BatchingModelServerTest, Predict_MaxBatch) {
+  BatchingModelServer::Config config;
+  config.max_batch = 4;
+  config.max_wait_us = 100000;
+  TestBatchingModelServer batching_model_server;
+  batching_model_server.Start(&model_server, config);
+
+  std::vector<std::vector<float>> batch_probs(REQUEST);
+  std::vector<std::future<bool>> futures;
+  for (int i = 0; i < REQUEST; ++i) {
+    futures.emplace_back(
+        batching_model_server.PredictAsync(requests[i], &batch_probs[i]));
+  }
+  for (int i = 0; i < REQUEST; ++i) {
+    ASSERT_TRUE(futures[i].get());
+    CheckProbs(requests[i], batch_probs[i]);
+  }
+  batching_model_server.Stop();
+
+  size_t request = 0;
+  for (size_t batch_size : batching_model_server.batch_sizes) {
+    EXPECT_LE(batch_size, 4u);
+    request += batch_size;
+  }
+  EXPECT_EQ(request, (size_t)REQUEST);
+}
+
+TEST_F(BatchingModelServerTest, Predict_MaxWait) {
+  BatchingModelServer::Config config;
+  config.max_batch = 64;
+  config.max_wait_us = 20000;
+  TestBatchingModelServer batching_model_server;
+  batching_model_server.Start(&model_server, config);
+
+  // A single request is flushed once it has waited for 'max_wait_us'.
+  std::vector<float> probs;
+  auto begin = std::chrono::steady_clock::now();
+  ASSERT_TRUE(batching_model_server.Predict(requests[0], &probs));
+  auto end = std::chrono::steady_clock::now();
+  EXPECT_GE(end - begin, std::chrono::microseconds(config.max_wait_us));
+  CheckProbs(requests[0], probs);
+  batching_model_server.Stop();
+  ASSERT_EQ(batching_model_server.batch_sizes.size(), 1u);
+  EXPECT_EQ(batching_model_server.batch_sizes[0], 1u);
+}
+
+TEST_F(BatchingModelServerTest, Predict_Exception) {
+  BatchingModelServer::Config config;
+  config.max_batch = 8;
+  config.max_wait_us = 1000;
+  TestBatchingModelServer batching_model_server;
+  batching_model_server.Start(&model_server, config);
+
+  // All requests of failed batches are failed, none of them hangs.
+  batching_model_server.fail = 1;
+  std::vector<std::vector<float>> batch_probs(REQUEST);
+  std::vector<std::future<bool>> futures;
+  for (int i = 0; i < REQUEST; ++i) {
+    futures.emplace_back(
+        batching_model_server.PredictAsync(requests[i], &batch_probs[i]));
+  }
+  for (std::future<bool>& future : futures) {
+    EXPECT_FALSE(future.get());
+  }
+
+  // Workers survive failed batches.
+  batching_model_server.fail = 0;
+  std::vector<float> probs;
+  ASSERT_TRUE(batching_model_server.Predict(requests[0], &probs));
+  CheckProbs(requests[0], probs);
+}
+
+}  // namespace deepx_core
@@ -8,6 +8,7 @@
 #include <deepx_core/common/stream.h>
 #include <deepx_core/dx_log.h>
 #include <deepx_core/graph/feature_kv_util.h>
+#include <deepx_core/graph/ol_store.h>
 #include <deepx_core/tensor/data_type.h>
 #include <limits>  // std::numeric_limits
 #include <string>
@@ -18,6 +19,8 @@ DEFINE_string(cs_addr, "127.0.0.1:61000", "coord server address");
 DEFINE_string(ps_addrs, "127.0.0.1:60000", "param server addresses");
 DEFINE_int32(ps_id, 0, "param server id");
 DEFINE_int32(ps_thread, 1, "# of param server working threads");
+DEFINE_string(shard_func, "default",
+              "shard function name: default or consistent_hash");
 
 DEFINE_string(instance_reader, "libsvm", "instance reader name");
 DEFINE_string(instance_reader_config, "", "instance reader config");
@@ -30,6 +33,9 @@ DEFINE_int32(batch, 32, "batch size");
 DEFINE_string(in, "", "input dir/file of training/testing data");
 DEFINE_int32(reverse_in, 0, "reverse input files");
 DEFINE_int32(shuffle_in, 1, "shuffle input files for each epoch");
+DEFINE_uint64(split_in, 0,
+              "split uncompressed input files into chunks of this many bytes "
+              "(0 means no split)");
 DEFINE_string(in_model, "", "input model dir");
 DEFINE_string(warmup_model, "", "warmup model dir");
 DEFINE_int32(out_model_remove_zeros, 0, "remove zeros from output model");
@@ -39,6 +45,16 @@ DEFINE_string(out_feature_kv_model, "",
               "output feature kv model dir(optional)");
 DEFINE_int32(out_feature_kv_protocol_version, 2,
              "output feature kv protocol version");
+DEFINE_string(out_ol_feature_kv_model, "",
+              "output feature kv model dir of ids changed since the last "
+              "save(optional)");
+DEFINE_uint64(ol_update_threshold, 0,
+              "ids updated more than this many times are changed");
+DEFINE_double(ol_distance_threshold, 0,
+              "ids whose embeddings moved farther than this are changed");
+DEFINE_int32(ol_baseline_type, 0,
+             "type of baseline embeddings of changed ids, "
+             "0: fp32, 1: int8(4x smaller, bounded distance error)");
 DEFINE_string(out_predict, "", "output predict dir(optional)");
 DEFINE_int32(verbose, 1, "verbose level: 0-10");
 DEFINE_int32(seed, 9527, "seed of random engine");
@@ -47,6 +63,26 @@ DEFINE_uint64(ts_now, 0, "timestamp of now");
 DEFINE_uint64(ts_expire_threshold, 0, "timestamp expiration threshold");
 DEFINE_uint64(freq_filter_threshold, 0,
               "feature frequency filtering threshold");
+DEFINE_uint64(hot_id_cache_size, 0,
+              "# of hot ids whose rows are cached by workers "
+              "(0 means no cache)");
+DEFINE_int32(hot_id_sample_period, 16,
+             "sample 1 of every this many pulled ids to find hot ids");
+DEFINE_int32(hot_id_refresh_batch, 100, "refresh hot ids every # of batches");
+DEFINE_int32(hot_id_max_staleness_batch, 10,
+             "max # of batches for which a cached row is served");
+DEFINE_uint64(expected_id, 0,
+              "expected # of ids of each param server, "
+              "sparse params are reserved for them (0 means no hint)");
+DEFINE_uint64(rehash_step, 0,
+              "# of buckets rehashed per insertion when sparse params grow "
+              "(0 means all buckets are rehashed at once)");
+DEFINE_string(cold_store_config, "",
+              "memory budgets in MB of sparse params, e.g. "
+              "\"emb1=1024;emb2=512\", cold rows beyond them are spilled "
+              "to local files (empty means no spilling)");
+DEFINE_string(cold_store_dir, "/tmp",
+              "local directory of files of spilled cold rows");
 
 namespace deepx_core {
 
@@ -147,6 +183,14 @@ void CheckFlags() {
       (void)AutoFileSystem::MakeDir(FLAGS_out_feature_kv_model);
       FeatureKVUtil::CheckVersion(FLAGS_out_feature_kv_protocol_version);
     }
+
+    CanonicalizePath(&FLAGS_out_ol_feature_kv_model);
+    if (!FLAGS_out_ol_feature_kv_model.empty()) {
+      DXCHECK_THROW(fs.Open(FLAGS_out_ol_feature_kv_model));
+      DXCHECK_THROW(!IsStdinStdoutPath(FLAGS_out_ol_feature_kv_model));
+      (void)AutoFileSystem::MakeDir(FLAGS_out_ol_feature_kv_model);
+      FeatureKVUtil::CheckVersion(FLAGS_out_feature_kv_protocol_version);
+    }
   } else {
     CanonicalizePath(&FLAGS_out_predict);
     if (FLAGS_out_predict.empty()) {
@@ -159,6 +203,9 @@ void CheckFlags() {
   }
 
   DXCHECK_THROW(FLAGS_verbose >= 0);
+  DXCHECK_THROW(FLAGS_hot_id_sample_period > 0);
+  DXCHECK_THROW(FLAGS_hot_id_refresh_batch > 0);
+  DXCHECK_THROW(FLAGS_hot_id_max_staleness_batch >= 0);
 
   if (FLAGS_is_train) {
     if (FLAGS_ts_enable) {
@@ -170,9 +217,14 @@ void CheckFlags() {
 
     DXCHECK_THROW(FLAGS_freq_filter_threshold <=
                   (google::uint64)std::numeric_limits<DataType::freq_t>::max());
+    DXCHECK_THROW(FLAGS_ol_update_threshold <=
+                  (google::uint64)std::numeric_limits<DataType::freq_t>::max());
+    DXCHECK_THROW(FLAGS_ol_distance_threshold >= 0);
+    DXCHECK_THROW(FLAGS_ol_baseline_type == OL_STORE_BASELINE_TYPE_FP32 ||
+                  FLAGS_ol_baseline_type == OL_STORE_BASELINE_TYPE_INT8);
   }
 
-  FLAGS_shard.InitShard(FLAGS_ps_size, "default");
+  FLAGS_shard.InitShard(FLAGS_ps_size, FLAGS_shard_func);
 }
 
 }  // namespace deepx_core
@@ -15,6 +15,7 @@ DECLARE_string(cs_addr);
 DECLARE_string(ps_addrs);
 DECLARE_int32(ps_id);
 DECLARE_int32(ps_thread);
+DECLARE_string(shard_func);
 
 DECLARE_string(instance_reader);
 DECLARE_string(instance_reader_config);
@@ -27,6 +28,7 @@ DECLARE_int32(batch);
 DECLARE_string(in);
 DECLARE_int32(reverse_in);
 DECLARE_int32(shuffle_in);
+DECLARE_uint64(split_in);
 DECLARE_string(in_model);
 DECLARE_string(warmup_model);
 DECLARE_int32(out_model_remove_zeros);
@@ -34,6 +36,10 @@ DECLARE_string(out_model);
 DECLARE_string(out_text_model);
 DECLARE_string(out_feature_kv_model);
 DECLARE_int32(out_feature_kv_protocol_version);
+DECLARE_string(out_ol_feature_kv_model);
+DECLARE_uint64(ol_update_threshold);
+DECLARE_double(ol_distance_threshold);
+DECLARE_int32(ol_baseline_type);
 DECLARE_string(out_predict);
 DECLARE_int32(verbose);
 DECLARE_int32(seed);
@@ -41,6 +47,14 @@ DECLARE_int32(ts_enable);
 DECLARE_uint64(ts_now);
 DECLARE_uint64(ts_expire_threshold);
 DECLARE_uint64(freq_filter_threshold);
+DECLARE_uint64(hot_id_cache_size);
+DECLARE_int32(hot_id_sample_period);
+DECLARE_int32(hot_id_refresh_batch);
+DECLARE_int32(hot_id_max_staleness_batch);
+DECLARE_uint64(expected_id);
+DECLARE_uint64(rehash_step);
+DECLARE_string(cold_store_config);
+DECLARE_string(cold_store_dir);
 
 namespace deepx_core {
 
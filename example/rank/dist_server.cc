@@ -14,6 +14,7 @@
 #include <deepx_core/ps/param_server.h>
 #include <deepx_core/tensor/data_type.h>
 #include <memory>
+#include <string>
 #include "dist_flags.h"
 #include "model_zoo.h"
 
@@ -50,6 +51,9 @@ class RankParamServer : public ParamServer {
   void OnPushNotify(conn_t conn) override;
   void OnModelSaveRequest(conn_t conn) override;
   void OnTerminationNotify(conn_t conn) override;
+  void OnShardExportRequest(conn_t conn) override;
+  void OnShardImportRequest(conn_t conn) override;
+  void OnShardCommitRequest(conn_t conn) override;
 };
 
 void RankParamServer::Init() {
@@ -112,6 +116,12 @@ void RankParamServer::Init() {
         DXCHECK_THROW(model_shard_.WarmupFreqStore(FLAGS_warmup_model));
       }
     }
+    if (!FLAGS_out_ol_feature_kv_model.empty()) {
+      DXCHECK_THROW(model_shard_.InitOLStore(
+          (DataType::freq_t)FLAGS_ol_update_threshold,
+          (DataType::float_t)FLAGS_ol_distance_threshold,
+          FLAGS_ol_baseline_type));
+    }
   } else {
     DXCHECK_THROW(LoadGraph(FLAGS_in_model, &graph_));
     model_shard_.InitShard(&FLAGS_shard, FLAGS_ps_id);
@@ -120,6 +130,14 @@ void RankParamServer::Init() {
   }
 
   DXCHECK_THROW(model_shard_.model().HasSRM());
+  if (FLAGS_is_train) {
+    model_shard_.ReserveSRM((size_t)FLAGS_expected_id,
+                            (size_t)FLAGS_rehash_step);
+    if (!FLAGS_cold_store_config.empty()) {
+      DXCHECK_THROW(model_shard_.InitColdStore(FLAGS_cold_store_dir,
+                                               FLAGS_cold_store_config));
+    }
+  }
 
   if (FLAGS_is_train && config_.thread > 1) {
     DXCHECK_THROW(model_shard_.InitLock());
@@ -142,17 +160,17 @@ void RankParamServer::OnPullRequest(conn_t conn) {
     DXCHECK_THROW(is);
   }
 
-  model_shard_.Pull(&session_data.pull_request, &session_data.param);
-
-  {
-    std::string& buf =
-        conn->mutable_out_message()->mutable_pull_response()->buf;
-    OutputStringStream os;
-    buf.clear();
-    os.SetView(&buf);
-    os << session_data.param;
-    DXCHECK_THROW(os);
-  }
+  // Rows are written under the param locks, other threads may push, erase
+  // or spill them after that.
+  // They are copied once to 'buf', whose capacity is kept between requests,
+  // a large 'buf' is referenced by the connection instead of being copied.
+  auto* pull_response = conn->mutable_out_message()->mutable_pull_response();
+  pull_response->buf_writer = nullptr;
+  pull_response->buf.clear();
+  OutputStringStream os;
+  os.SetView(&pull_response->buf);
+  model_shard_.Pull(&session_data.pull_request, &session_data.param, os);
+  DXCHECK_THROW(os);
 }
 
 void RankParamServer::OnPushNotify(conn_t conn) {
@@ -180,6 +198,10 @@ void RankParamServer::OnModelSaveRequest(conn_t /*conn*/) {
   if (FLAGS_ts_enable && FLAGS_ts_expire_threshold > 0) {
     model_shard_.ExpireTSStore();
   }
+  if (!FLAGS_out_text_model.empty() || !FLAGS_out_feature_kv_model.empty() ||
+      !FLAGS_out_ol_feature_kv_model.empty()) {
+    model_shard_.RestoreColdStore();
+  }
   DXCHECK_THROW(model_shard_.SaveModel(FLAGS_out_model));
   if (!FLAGS_out_text_model.empty()) {
     DXCHECK_THROW(model_shard_.SaveTextModel(FLAGS_out_text_model));
@@ -188,6 +210,10 @@ void RankParamServer::OnModelSaveRequest(conn_t /*conn*/) {
     DXCHECK_THROW(model_shard_.SaveFeatureKVModel(
         FLAGS_out_feature_kv_model, FLAGS_out_feature_kv_protocol_version));
   }
+  if (!FLAGS_out_ol_feature_kv_model.empty()) {
+    DXCHECK_THROW(model_shard_.SaveOLFeatureKVModel(
+        FLAGS_out_ol_feature_kv_model, FLAGS_out_feature_kv_protocol_version));
+  }
   DXCHECK_THROW(model_shard_.SaveOptimizer(FLAGS_out_model));
   if (FLAGS_ts_enable) {
     DXCHECK_THROW(model_shard_.SaveTSStore(FLAGS_out_model));
@@ -199,6 +225,32 @@ void RankParamServer::OnModelSaveRequest(conn_t /*conn*/) {
 
 void RankParamServer::OnTerminationNotify(conn_t /*conn*/) {}
 
+void RankParamServer::OnShardExportRequest(conn_t conn) {
+  const auto& request = conn->in_message().shard_export_request();
+  Shard shard;
+  shard.InitShard(request.shard_size, request.shard_func_name);
+  std::string& buf =
+      conn->mutable_out_message()->mutable_shard_export_response()->buf;
+  buf.clear();
+  OutputStringStream os;
+  os.SetView(&buf);
+  DXCHECK_THROW(model_shard_.ExportShard(&shard, request.shard_id, os));
+}
+
+void RankParamServer::OnShardImportRequest(conn_t conn) {
+  const const_string_view& buf = conn->in_message().shard_import_request().buf;
+  InputStringStream is;
+  is.SetView(buf.data(), buf.size());
+  DXCHECK_THROW(model_shard_.ImportShard(is));
+}
+
+void RankParamServer::OnShardCommitRequest(conn_t conn) {
+  const auto& request = conn->in_message().shard_commit_request();
+  FLAGS_shard.InitShard(request.shard_size, request.shard_func_name);
+  FLAGS_ps_id = request.shard_id;
+  DXCHECK_THROW(model_shard_.CommitShard(&FLAGS_shard, FLAGS_ps_id));
+}
+
 }  // namespace
 
 void RunCoordServer() {
@@ -221,6 +273,7 @@ void RunCoordServer() {
     config.file_dispatcher_shuffle = 0;
   }
   config.file_dispatcher_timeout = 0;
+  config.file_dispatcher_split_bytes = FLAGS_split_in;
   if (FLAGS_is_train) {
     config.dump_model = 1;
   } else {
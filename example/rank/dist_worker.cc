@@ -10,10 +10,14 @@
 #include <deepx_core/dx_log.h>
 #include <deepx_core/graph/dist_proto.h>
 #include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/hot_id_cache.h>
 #include <deepx_core/graph/model_shard.h>
 #include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/ps/file_dispatcher.h>
 #include <deepx_core/ps/tcp_connection.h>
+#include <algorithm>  // std::max
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <thread>
@@ -38,14 +42,20 @@ class TrainerContextDist : public TrainerContext {
   PullRequest pull_request_;
   std::vector<PullRequest> pull_requests_;
   std::vector<int> pull_request_masks_;
+  // The last one holds rows served by 'hot_id_cache_'.
   std::vector<std::unique_ptr<TensorMap>> params_;
   std::vector<std::unique_ptr<TensorMap>> grads_;
   std::vector<std::unique_ptr<TensorMap>> overwritten_params_;
   std::vector<id_set_t*> aux1_;
   std::vector<srm_t*> aux2_;
+  HotIdCache hot_id_cache_;
+  // per-shard load, for profile
+  std::vector<uint64_t> shard_pull_ids_;
+  std::vector<uint64_t> shard_pull_bytes_;
 
  public:
   TrainerContextDist();
+  ~TrainerContextDist() override;
   void Init(ModelShard* local_model_shard);
   void TrainBatch() override;
   void PredictBatch() override;
@@ -53,10 +63,17 @@ class TrainerContextDist : public TrainerContext {
  private:
   void Pull();
   void Push();
+  void DumpShardLoad() const;
 };
 
 TrainerContextDist::TrainerContextDist() : io_(), ps_conns_(&io_) {}
 
+TrainerContextDist::~TrainerContextDist() {
+  if (enable_profile_) {
+    DumpShardLoad();
+  }
+}
+
 void TrainerContextDist::Init(ModelShard* local_model_shard) {
   _Init(local_model_shard);
 
@@ -65,7 +82,7 @@ void TrainerContextDist::Init(ModelShard* local_model_shard) {
   shard_size_ = FLAGS_shard.shard_size();
   pull_requests_.resize(shard_size_);
   pull_request_masks_.resize(shard_size_);
-  params_.resize(shard_size_);
+  params_.resize(shard_size_ + 1);
   grads_.resize(shard_size_);
   overwritten_params_.resize(shard_size_);
   for (int i = 0; i < shard_size_; ++i) {
@@ -73,8 +90,15 @@ void TrainerContextDist::Init(ModelShard* local_model_shard) {
     grads_[i].reset(new TensorMap);
     overwritten_params_[i].reset(new TensorMap);
   }
+  params_[shard_size_].reset(new TensorMap);
   aux1_.resize(shard_size_);
   aux2_.resize(shard_size_);
+
+  hot_id_cache_.Init(FLAGS_hot_id_cache_size, FLAGS_hot_id_sample_period,
+                     FLAGS_hot_id_refresh_batch,
+                     FLAGS_hot_id_max_staleness_batch, (uint32_t)FLAGS_seed);
+  shard_pull_ids_.assign(shard_size_, 0);
+  shard_pull_bytes_.assign(shard_size_, 0);
 }
 
 void TrainerContextDist::TrainBatch() {
@@ -166,6 +190,7 @@ void TrainerContextDist::Pull() {
     FreqStore::GetIdFreqMap(op_context_->inst(), &pull_request_.id_freq_map);
   }
   pull_request_.is_train = FLAGS_is_train;
+  hot_id_cache_.Filter(&pull_request_, params_[shard_size_].get());
   local_model_shard_->SplitPullRequest(pull_request_, &pull_requests_, &aux1_);
 
   for (int i = 0; i < shard_size_; ++i) {
@@ -197,6 +222,13 @@ void TrainerContextDist::Pull() {
       // view, zero-copy
       ReadView(is_, *params_[i]);
       DXCHECK_THROW(is_);
+      hot_id_cache_.Put(*params_[i]);
+      if (enable_profile_) {
+        for (const auto& entry : pull_requests_[i].srm_map) {
+          shard_pull_ids_[i] += entry.second.size();
+        }
+        shard_pull_bytes_[i] += buf.size();
+      }
     } else {
       params_[i]->clear();
     }
@@ -225,6 +257,33 @@ void TrainerContextDist::Push() {
   DXCHECK_THROW(ps_conns_.RpcPushNotify(&pull_request_masks_) == 0);
 }
 
+void TrainerContextDist::DumpShardLoad() const {
+  uint64_t total_ids = 0, max_ids = 0;
+  for (uint64_t ids : shard_pull_ids_) {
+    total_ids += ids;
+    max_ids = std::max(max_ids, ids);
+  }
+  if (total_ids == 0) {
+    return;
+  }
+
+  for (int i = 0; i < shard_size_; ++i) {
+    DXINFO("Shard %d: pulled %zu ids(%.2f%%), %.1fMB.", i,
+           (size_t)shard_pull_ids_[i], 100.0 * shard_pull_ids_[i] / total_ids,
+           shard_pull_bytes_[i] / (1024.0 * 1024.0));
+  }
+  DXINFO("Shard load imbalance(max/mean pulled ids): %.2f.",
+         (double)max_ids * shard_size_ / total_ids);
+
+  if (hot_id_cache_.enabled()) {
+    const HotIdCache::Stat& stat = hot_id_cache_.stat();
+    uint64_t total = stat.hit + stat.miss + stat.stale;
+    DXINFO("HotIdCache: hit=%zu, miss=%zu, stale=%zu, hit rate=%.2f%%.",
+           (size_t)stat.hit, (size_t)stat.miss, (size_t)stat.stale,
+           total ? 100.0 * stat.hit / total : 0.0);
+  }
+}
+
 /************************************************************************/
 /* TrainerDist */
 /************************************************************************/
@@ -280,24 +339,29 @@ void TrainerDist::Init() {
 
 void TrainerDist::Train() {
   int epoch = 0;
-  std::string file;
+  FileChunk chunk;
   for (;;) {
     DXINFO("Epoch %d begins.", epoch + 1);
     DXCHECK_THROW(cs_conn_.ConnectRetry(FLAGS_cs_endpoint) == 0);
     for (;;) {
       if (cs_conn_.RpcFileRequest() == 0) {
         epoch = cs_conn_.in_message().file_response().epoch;
-        file = cs_conn_.in_message().file_response().file;
-        if (file.empty()) {
+        const auto& file_response = cs_conn_.in_message().file_response();
+        chunk.file = file_response.file;
+        chunk.offset = file_response.offset;
+        chunk.length = file_response.length;
+        if (chunk.file.empty()) {
           DXINFO("Worker got no new file.");
           std::this_thread::sleep_for(std::chrono::seconds(5));  // magic number
           continue;
         } else {
-          DXINFO("Worker has got file: %s.", file.c_str());
-          context_.TrainFile(0, file);
+          DXINFO("Worker has got file: %s.", to_string(chunk).c_str());
+          context_.TrainFile(0, chunk);
           auto* file_finished_notify =
               cs_conn_.mutable_out_message()->mutable_file_finish_notify();
-          file_finished_notify->file = file;
+          file_finished_notify->file = chunk.file;
+          file_finished_notify->offset = chunk.offset;
+          file_finished_notify->length = chunk.length;
           file_finished_notify->loss = context_.file_loss();
           file_finished_notify->loss_weight = context_.file_loss_weight();
           DXCHECK_THROW(cs_conn_.RpcFileFinishNotify() == 0);
@@ -317,22 +381,32 @@ void TrainerDist::Train() {
 }
 
 void TrainerDist::Predict() {
-  std::string file;
+  FileChunk chunk;
   DXCHECK_THROW(cs_conn_.ConnectRetry(FLAGS_cs_endpoint) == 0);
   for (;;) {
     if (cs_conn_.RpcFileRequest() == 0) {
-      file = cs_conn_.in_message().file_response().file;
-      if (file.empty()) {
+      const auto& file_response = cs_conn_.in_message().file_response();
+      chunk.file = file_response.file;
+      chunk.offset = file_response.offset;
+      chunk.length = file_response.length;
+      if (chunk.file.empty()) {
         DXINFO("Worker got no new file.");
         std::this_thread::sleep_for(std::chrono::seconds(5));  // magic number
         continue;
       } else {
-        DXINFO("Worker has got file: %s.", file.c_str());
-        context_.PredictFile(0, file,
-                             GetOutputPredictFile(FLAGS_out_predict, file));
+        DXINFO("Worker has got file: %s.", to_string(chunk).c_str());
+        std::string out_file =
+            GetOutputPredictFile(FLAGS_out_predict, chunk.file);
+        if (!chunk.whole() && !IsStdinStdoutPath(out_file)) {
+          // One output file for each chunk.
+          out_file += "_" + std::to_string(chunk.offset);
+        }
+        context_.PredictFile(0, chunk, out_file);
         auto* file_finished_notify =
             cs_conn_.mutable_out_message()->mutable_file_finish_notify();
-        file_finished_notify->file = file;
+        file_finished_notify->file = chunk.file;
+        file_finished_notify->offset = chunk.offset;
+        file_finished_notify->length = chunk.length;
         file_finished_notify->loss = 0;
         file_finished_notify->loss_weight = 0;
         DXCHECK_THROW(cs_conn_.RpcFileFinishNotify() == 0);
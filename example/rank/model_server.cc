@@ -3,13 +3,27 @@
 //
 
 #include "model_server.h"
+#include <deepx_core/common/lru_cache.h>
 #include <deepx_core/common/stream.h>
 #include <deepx_core/dx_log.h>
+#include <deepx_core/graph/feature_kv_util.h>
 #include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/graph_module_creator.h>
 #include <deepx_core/graph/instance_reader.h>
+#include <deepx_core/graph/mapped_model.h>
 #include <deepx_core/graph/model.h>
+#include <deepx_core/graph/model_quantizer.h>
 #include <deepx_core/graph/op_context.h>
+#include <deepx_core/graph/predict_plan.h>
 #include <deepx_core/instance/base.h>
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <unordered_map>
 #include "model_zoo/dtn.h"
 
 namespace deepx_core {
@@ -17,7 +31,9 @@ namespace deepx_core {
 using float_t = InstanceReader::float_t;
 using int_t = InstanceReader::int_t;
 using tsr_t = InstanceReader::tsr_t;
+using srm_t = InstanceReader::srm_t;
 using csr_t = InstanceReader::csr_t;
+using ll_math_t = InstanceReader::ll_math_t;
 
 static void EmplaceRow(const features_t& features, csr_t* X) {
   static constexpr float MAX_FEATURE_VALUE =
@@ -31,11 +47,178 @@ static void EmplaceRow(const features_t& features, csr_t* X) {
   X->add_row();
 }
 
-ModelServer::ModelServer() {}
+/************************************************************************/
+/* ModelServer */
+/************************************************************************/
+struct ModelServer::Version {
+  std::shared_ptr<const Graph> graph;
+  std::string target_name;
+  // the version overlaid by a delta version, which is a full version or
+  // another delta version
+  std::shared_ptr<const Version> base;
+  std::unique_ptr<MappedModel> mapped_model;
+  // Views of 'mapped_model' and 'base' are released first.
+  std::unique_ptr<Model> model;
+  // # of delta versions chained on the full version, including this one
+  int delta_depth = 0;
+  // # of overlaid rows of the chain, rows overlaid twice are counted twice
+  size_t delta_rows = 0;
+  // whether 'model' has params converted by 'model_quantizer'
+  int quantized = 0;
+};
+
+// OpContext and PredictPlan created by ModelServer only remember the serial
+// of the version they are bound to.
+// They view params of that version, which is pinned only during each use,
+// so they are rebound to the pinned version if the serial changes.
+class ModelServer::VersionedOpContext : public OpContext {
+ public:
+  uint64_t serial = 0;
+};
+
+class ModelServer::VersionedPredictPlan : public PredictPlan {
+ public:
+  uint64_t serial = 0;
+  int frozen_batch = 0;
+  // names of CSR instance nodes of (batch, ...)
+  std::vector<std::string> batch_inputs;
+  // names of CSR instance nodes of a fixed # of rows, e.g. the DTN user
+  std::vector<std::string> fixed_inputs;
+
+  // Resolve inputs from instance nodes of 'target_name' after 'InitOp'.
+  // Inputs of a fixed # of rows are created here,
+  // or 'Freeze' would create them with 'frozen_batch' rows.
+  bool InitInputs(const std::string& target_name);
+  // Fill the only input of (batch, ...).
+  bool Fill(const std::vector<features_t>& batch_features);
+  // Fill the user and item inputs of DTNModel.
+  bool FillDTN(const features_t& user_features,
+               const std::vector<features_t>& batch_item_features);
+};
+
+struct ModelServer::DTNCatalog {
+  std::vector<uint64_t> ids;
+  std::vector<features_t> features;
+  std::unordered_map<uint64_t, int> index;  // id -> index
+  // # of lists of 'DTNIndex', 0 disables it
+  int index_list = 0;
+};
+
+// Inverted lists of item tower outputs clustered by k-means.
+struct ModelServer::DTNIndex {
+  // (# of lists, item tower dim)
+  tsr_t centroids;
+  // Items of list i are list_items[list_begin[i], list_begin[i + 1]).
+  std::vector<int> list_begin;
+  std::vector<int> list_items;
+
+  // Cluster rows of 'T' into 'nlist' lists.
+  // Centroids are trained on a sample of rows.
+  void Build(const tsr_t& T, int nlist);
+  // Assign rows of 'T' to lists of 'centroids'.
+  void Assign(const tsr_t& T);
+};
+
+// Item tower outputs of a catalog and a version.
+struct ModelServer::DTNItems {
+  std::shared_ptr<const DTNCatalog> catalog;
+  // the version of 'tower' and its serial,
+  // which may be older than the latest version
+  std::shared_ptr<const Version> version;
+  uint64_t serial = 0;
+  // (# of items, item tower dim)
+  tsr_t tower;
+  DTNIndex index;
+};
+
+struct ModelServer::DTNPrecompute {
+  std::mutex mutex;
+  std::condition_variable cond;
+  // item catalog of the latest 'DTNSetItems'
+  std::shared_ptr<const DTNCatalog> catalog;
+  // Only the latest pending precompute is kept.
+  int pending = 0;
+  // whether all versions since the last precompute are deltas,
+  // so that centroids of the index are reused
+  int delta = 0;
+  int busy = 0;
+  // whether the last precompute failed
+  int failed = 0;
+  int stop = 0;
+  std::thread thread;
+};
+
+struct ModelServer::DTNUserCache {
+  struct Entry {
+    // serial of the version of 'tower'
+    uint64_t serial = 0;
+    std::vector<float> tower;
+  };
+
+  std::mutex mutex;
+  size_t capacity = 0;
+  LRUCache<uint64_t, Entry> cache;
+};
+
+// Graph target conventions.
+// Offline train, target 0.
+// Offline predict, target 1.
+// Online infer, target 2 if exists, otherwise target 1.
+static std::string GetTargetName(const Graph& graph) {
+  if (graph.target_size() >= 3) {
+    return graph.target(2).name();
+  } else {
+    return graph.target(1).name();
+  }
+}
+
+static bool HasDTNTowers(const Graph& graph) {
+  if (graph.target_size() <= DTN_TOWER_INFER_TARGET) {
+    DXERROR("Graph has no DTN tower targets.");
+    return false;
+  }
+  return true;
+}
+
+ModelServer::ModelServer()
+    : dtn_precompute_(new DTNPrecompute), dtn_user_cache_(new DTNUserCache) {
+  static constexpr size_t DTN_USER_CACHE_CAPACITY = 100000;  // magic number
+  DTNSetUserCacheCapacity(DTN_USER_CACHE_CAPACITY);
+}
+
+ModelServer::~ModelServer() {
+  DTNPrecompute& precompute = *dtn_precompute_;
+  {
+    std::lock_guard<std::mutex> guard(precompute.mutex);
+    precompute.stop = 1;
+  }
+  precompute.cond.notify_all();
+  if (precompute.thread.joinable()) {
+    precompute.thread.join();
+  }
+}
 
-ModelServer::~ModelServer() {}
+bool ModelServer::Publish(std::unique_ptr<Version> version, bool delta) {
+  {
+    std::lock_guard<std::mutex> guard(dtn_precompute_->mutex);
+    if (dtn_precompute_->catalog && !HasDTNTowers(*version->graph)) {
+      DXERROR("Couldn't precompute item towers with the new version.");
+      return false;
+    }
+  }
+
+  if (version->quantized) {
+    DXINFO("Serving quantized params with predict-only kernels.");
+  }
+  version_.store(std::shared_ptr<const Version>(std::move(version)));
+  DXINFO("Published version %llu.",
+         (unsigned long long)version_.serial());  // NOLINT
+  ScheduleDTNItems(delta);
+  return true;
+}
 
 bool ModelServer::Load(const std::string& file) {
+  std::lock_guard<std::mutex> guard(load_mutex_);
   AutoInputFileStream is;
   if (!is.Open(file)) {
     DXERROR("Failed to open: %s.", file.c_str());
@@ -43,61 +226,255 @@ bool ModelServer::Load(const std::string& file) {
   }
 
   DXINFO("Loading graph from %s...", file.c_str());
-  graph_.reset(new Graph);
-  if (!graph_->Read(is)) {
+  std::shared_ptr<Graph> graph(new Graph);
+  if (!graph->Read(is)) {
     return false;
   }
-
-  // Graph target conventions.
-  // Offline train, target 0.
-  // Offline predict, target 1.
-  // Online infer, target 2 if exists, otherwise target 1.
-  if (graph_->target_size() >= 3) {
-    target_name_ = graph_->target(2).name();
-  } else {
-    target_name_ = graph_->target(1).name();
-  }
   DXINFO("Done.");
 
   DXINFO("Loading model from %s...", file.c_str());
-  model_.reset(new Model);
-  model_->Init(graph_.get());
-  if (!model_->Read(is)) {
+  std::unique_ptr<Version> version(new Version);
+  version->graph = graph;
+  version->target_name = GetTargetName(*graph);
+  version->model.reset(new Model);
+  version->model->Init(graph.get());
+  if (!version->model->Read(is)) {
     return false;
   }
+  version->quantized =
+      ModelQuantizer::HasQuantizedParam(version->model->param());
   DXINFO("Done.");
+
+  std::string target_name = version->target_name;
+  if (!Publish(std::move(version))) {
+    return false;
+  }
+  graph_ = graph;
+  target_name_ = target_name;
   return true;
 }
 
 bool ModelServer::LoadGraph(const std::string& file) {
-  graph_.reset(new Graph);
-  if (!graph_->Load(file)) {
+  std::lock_guard<std::mutex> guard(load_mutex_);
+  std::shared_ptr<Graph> graph(new Graph);
+  if (!graph->Load(file)) {
     return false;
   }
 
-  // Check out graph target conventions.
-  if (graph_->target_size() >= 3) {
-    target_name_ = graph_->target(2).name();
-  } else {
-    target_name_ = graph_->target(1).name();
-  }
+  graph_ = graph;
+  target_name_ = GetTargetName(*graph);
   return true;
 }
 
 bool ModelServer::LoadModel(const std::string& file) {
-  model_.reset(new Model);
-  model_->Init(graph_.get());
-  return model_->Load(file);
+  std::lock_guard<std::mutex> guard(load_mutex_);
+  if (!graph_) {
+    DXERROR("Please load graph first.");
+    return false;
+  }
+
+  std::unique_ptr<Version> version(new Version);
+  version->graph = graph_;
+  version->target_name = target_name_;
+  version->model.reset(new Model);
+  version->model->Init(graph_.get());
+  if (!version->model->Load(file)) {
+    return false;
+  }
+  version->quantized =
+      ModelQuantizer::HasQuantizedParam(version->model->param());
+  return Publish(std::move(version));
+}
+
+bool ModelServer::LoadMappedModel(const std::string& file, bool populate) {
+  std::lock_guard<std::mutex> guard(load_mutex_);
+  if (!graph_) {
+    DXERROR("Please load graph first.");
+    return false;
+  }
+
+  std::unique_ptr<Version> version(new Version);
+  version->graph = graph_;
+  version->target_name = target_name_;
+  version->mapped_model.reset(new MappedModel);
+  version->model.reset(new Model);
+  version->model->Init(graph_.get());
+  if (!version->mapped_model->Open(file, version->model->mutable_param(),
+                                   populate)) {
+    return false;
+  }
+  return Publish(std::move(version));
+}
+
+// Copy rows of 'deltas'(newest first) missing in 'param' to 'param',
+// which is then overlaid on 'base'(nullptr for no base).
+// Dense params of 'param' which don't view 'base' are copied.
+static void MergeDeltas(const std::vector<const TensorMap*>& deltas,
+                        const TensorMap* base, TensorMap* param) {
+  using tsr_t = DataType::tsr_t;
+  using srm_t = DataType::srm_t;
+  for (auto& entry : *param) {
+    const std::string& name = entry.first;
+    Any& Wany = entry.second;
+    if (Wany.is<tsr_t>()) {
+      auto& W = Wany.unsafe_to_ref<tsr_t>();
+      if (W.is_view() &&
+          (base == nullptr || W.data() != base->get<tsr_t>(name).data())) {
+        tsr_t copy(W.shape());
+        copy.set_data(W);
+        W = std::move(copy);
+      }
+    } else if (Wany.is<srm_t>()) {
+      auto& W = Wany.unsafe_to_ref<srm_t>();
+      for (const TensorMap* delta : deltas) {
+        W.merge(delta->get<srm_t>(name));
+      }
+      W.set_base(base ? &base->get<srm_t>(name) : nullptr);
+    }
+  }
+}
+
+bool ModelServer::ApplyDelta(const std::string& file) {
+  // Overlays of in-memory models are folded, once they have more rows
+  // than 1/MAX_DELTA_RATIO of their full version.
+  static constexpr size_t MAX_DELTA_RATIO = 8;  // magic number
+  // Longer chains of deltas are merged into one delta.
+  static constexpr int MAX_DELTA_DEPTH = 8;  // magic number
+  std::lock_guard<std::mutex> guard(load_mutex_);
+  std::shared_ptr<const Version> current = version_.load();
+  if (!current) {
+    DXERROR("Please load model first.");
+    return false;
+  }
+
+  if (current->quantized) {
+    DXERROR("Couldn't apply deltas to a quantized model.");
+    return false;
+  }
+
+  std::unique_ptr<Version> version(new Version);
+  version->graph = current->graph;
+  version->target_name = current->target_name;
+  version->base = current;
+  version->delta_depth = current->delta_depth + 1;
+  version->model.reset(new Model);
+  version->model->Init(version->graph.get());
+
+  // Dense params are shared with 'current' unless they are in the delta,
+  // sparse rows of the delta are overlaid on 'current'.
+  TensorMap* param = version->model->mutable_param();
+  for (const auto& entry : current->model->param()) {
+    const std::string& name = entry.first;
+    const Any& Wany = entry.second;
+    if (Wany.is<tsr_t>()) {
+      // view, zero-copy
+      param->insert<tsr_t>(name) = Wany.unsafe_to_ref<tsr_t>().get_view();
+    } else if (Wany.is<srm_t>()) {
+      const auto& base_W = Wany.unsafe_to_ref<srm_t>();
+      auto& W = param->insert<srm_t>(name);
+      W.set_col(base_W.col());
+      W.set_base(&base_W);
+    }
+  }
+
+  if (!FeatureKVUtil::LoadModel(file, *version->graph, param)) {
+    return false;
+  }
+
+  // params of deltas chained on 'full', newest first
+  std::vector<const TensorMap*> deltas;
+  std::shared_ptr<const Version> full = current;
+  for (; full->base; full = full->base) {
+    deltas.emplace_back(&full->model->param());
+  }
+
+  size_t rows = 0, base_rows = 0;
+  for (const auto& entry : *param) {
+    const std::string& name = entry.first;
+    const Any& Wany = entry.second;
+    if (Wany.is<srm_t>()) {
+      const auto& base_W = full->model->param().get<srm_t>(name);
+      rows += Wany.unsafe_to_ref<srm_t>().size();
+      base_rows += base_W.size() + base_W.mapped().size;
+    }
+  }
+  version->delta_rows = current->delta_rows + rows;
+  DXINFO("Applied %zu rows, overlaid %zu rows on %zu rows.", rows,
+         version->delta_rows, base_rows);
+
+  if (!full->mapped_model &&
+      version->delta_rows * MAX_DELTA_RATIO > base_rows) {
+    // Rows and dense params are copied once, unless they are in the delta.
+    DXINFO("Folding overlaid rows...");
+    deltas.emplace_back(&full->model->param());
+    MergeDeltas(deltas, nullptr, param);
+    version->base.reset();
+    version->delta_depth = 0;
+    version->delta_rows = 0;
+    DXINFO("Done.");
+  } else if (version->delta_depth > MAX_DELTA_DEPTH) {
+    // Overlaid rows are copied, rows of 'full' are not.
+    DXINFO("Merging %d deltas...", version->delta_depth);
+    MergeDeltas(deltas, &full->model->param(), param);
+    version->base = full;
+    version->delta_depth = 1;
+    version->delta_rows = 0;
+    for (const auto& entry : *param) {
+      if (entry.second.is<srm_t>()) {
+        version->delta_rows += entry.second.unsafe_to_ref<srm_t>().size();
+      }
+    }
+    DXINFO("Done.");
+  }
+  return Publish(std::move(version), true);
+}
+
+uint64_t ModelServer::version() const noexcept { return version_.serial(); }
+
+bool ModelServer::Bind(const version_guard_t& version,
+                       OpContext* op_context) {
+  if (!version) {
+    return false;
+  }
+
+  auto* context = static_cast<VersionedOpContext*>(op_context);
+  if (context->serial != version.serial()) {
+    context->Init(version->graph.get(), version->model->mutable_param());
+    bool ok = context->InitOp({version->target_name}, -1);
+    context->mutable_inst()->clear_batch();
+    context->serial = ok ? version.serial() : 0;
+    return ok;
+  }
+  return true;
+}
+
+bool ModelServer::Bind(const version_guard_t& version,
+                       PredictPlan* predict_plan) {
+  if (!version) {
+    return false;
+  }
+
+  auto* plan = static_cast<VersionedPredictPlan*>(predict_plan);
+  if (plan->serial != version.serial()) {
+    plan->Init(version->graph.get(), version->model->mutable_param());
+    bool ok = plan->InitOp({version->target_name}) &&
+              plan->InitInputs(version->target_name) &&
+              plan->Freeze(plan->frozen_batch);
+    plan->serial = ok ? version.serial() : 0;
+    return ok;
+  }
+  return true;
 }
 
 bool ModelServer::Predict(const features_t& features, float* prob) const {
-  if (!graph_ || !model_) {
+  version_guard_t version(version_);
+  if (!version) {
     return false;
   }
 
   OpContext op_context;
-  op_context.Init(graph_.get(), model_->mutable_param());
-  if (!op_context.InitOp({target_name_}, -1)) {
+  op_context.Init(version->graph.get(), version->model->mutable_param());
+  if (!op_context.InitOp({version->target_name}, -1)) {
     return false;
   }
 
@@ -108,7 +485,7 @@ bool ModelServer::Predict(const features_t& features, float* prob) const {
 
   op_context.InitPredict();
   op_context.Predict();
-  const auto& P = op_context.hidden().get<tsr_t>(target_name_);
+  const auto& P = op_context.hidden().get<tsr_t>(version->target_name);
   DXASSERT(P.is_rank(2));
   DXASSERT(P.same_shape(X.row(), 1));
   *prob = (float)P.data(0);
@@ -117,13 +494,14 @@ bool ModelServer::Predict(const features_t& features, float* prob) const {
 
 bool ModelServer::Predict(const features_t& features,
                           std::vector<float>* probs) const {
-  if (!graph_ || !model_) {
+  version_guard_t version(version_);
+  if (!version) {
     return false;
   }
 
   OpContext op_context;
-  op_context.Init(graph_.get(), model_->mutable_param());
-  if (!op_context.InitOp({target_name_}, -1)) {
+  op_context.Init(version->graph.get(), version->model->mutable_param());
+  if (!op_context.InitOp({version->target_name}, -1)) {
     return false;
   }
 
@@ -134,7 +512,7 @@ bool ModelServer::Predict(const features_t& features,
 
   op_context.InitPredict();
   op_context.Predict();
-  const auto& P = op_context.hidden().get<tsr_t>(target_name_);
+  const auto& P = op_context.hidden().get<tsr_t>(version->target_name);
   DXASSERT(P.is_rank(2));
   int col = P.dim(1);
   DXASSERT(P.same_shape(X.row(), col));
@@ -153,13 +531,14 @@ bool ModelServer::BatchPredict(const std::vector<features_t>& batch_features,
     return false;
   }
 
-  if (!graph_ || !model_) {
+  version_guard_t version(version_);
+  if (!version) {
     return false;
   }
 
   OpContext op_context;
-  op_context.Init(graph_.get(), model_->mutable_param());
-  if (!op_context.InitOp({target_name_}, -1)) {
+  op_context.Init(version->graph.get(), version->model->mutable_param());
+  if (!op_context.InitOp({version->target_name}, -1)) {
     return false;
   }
 
@@ -172,7 +551,7 @@ bool ModelServer::BatchPredict(const std::vector<features_t>& batch_features,
 
   op_context.InitPredict();
   op_context.Predict();
-  const auto& P = op_context.hidden().get<tsr_t>(target_name_);
+  const auto& P = op_context.hidden().get<tsr_t>(version->target_name);
   DXASSERT(P.is_rank(2));
   DXASSERT(P.same_shape(X.row(), 1));
   batch_prob->resize(X.row());
@@ -191,13 +570,14 @@ bool ModelServer::BatchPredict(
     return false;
   }
 
-  if (!graph_ || !model_) {
+  version_guard_t version(version_);
+  if (!version) {
     return false;
   }
 
   OpContext op_context;
-  op_context.Init(graph_.get(), model_->mutable_param());
-  if (!op_context.InitOp({target_name_}, -1)) {
+  op_context.Init(version->graph.get(), version->model->mutable_param());
+  if (!op_context.InitOp({version->target_name}, -1)) {
     return false;
   }
 
@@ -210,7 +590,7 @@ bool ModelServer::BatchPredict(
 
   op_context.InitPredict();
   op_context.Predict();
-  const auto& P = op_context.hidden().get<tsr_t>(target_name_);
+  const auto& P = op_context.hidden().get<tsr_t>(version->target_name);
   DXASSERT(P.is_rank(2));
   int col = P.dim(1);
   DXASSERT(P.same_shape(X.row(), col));
@@ -236,13 +616,14 @@ bool ModelServer::DTNBatchPredict(
     return false;
   }
 
-  if (!graph_ || !model_) {
+  version_guard_t version(version_);
+  if (!version) {
     return false;
   }
 
   OpContext op_context;
-  op_context.Init(graph_.get(), model_->mutable_param());
-  if (!op_context.InitOp({target_name_}, -1)) {
+  op_context.Init(version->graph.get(), version->model->mutable_param());
+  if (!op_context.InitOp({version->target_name}, -1)) {
     return false;
   }
 
@@ -257,7 +638,7 @@ bool ModelServer::DTNBatchPredict(
 
   op_context.InitPredict();
   op_context.Predict();
-  const auto& P = op_context.hidden().get<tsr_t>(target_name_);
+  const auto& P = op_context.hidden().get<tsr_t>(version->target_name);
   DXASSERT(P.is_rank(2));
   int col = P.dim(1);
   DXASSERT(P.same_shape(Xitem.row(), col));
@@ -275,29 +656,617 @@ bool ModelServer::DTNBatchPredict(
   return true;
 }
 
-static void DeleteOpContext(OpContext* op_context) noexcept {
-  delete op_context;
+// Run tower 'target' of DTNModel on rows [begin, end) of 'batch_features'.
+static bool RunDTNTower(const Graph& graph, TensorMap* param, int target,
+                        const std::string& X_name,
+                        const std::vector<features_t>& batch_features,
+                        size_t begin, size_t end, tsr_t* T) {
+  if (!HasDTNTowers(graph)) {
+    return false;
+  }
+
+  const std::string& target_name = graph.target(target).name();
+  OpContext op_context;
+  op_context.Init(&graph, param);
+  if (!op_context.InitOp({target_name}, -1)) {
+    return false;
+  }
+
+  Instance* inst = op_context.mutable_inst();
+  auto& X = inst->insert<csr_t>(X_name);
+  for (size_t i = begin; i < end; ++i) {
+    EmplaceRow(batch_features[i], &X);
+  }
+  inst->set_batch(X.row());
+
+  op_context.InitPredict();
+  op_context.Predict();
+  *T = op_context.hidden().get<tsr_t>(target_name);
+  return true;
+}
+
+// Assign rows of 'X' of (n, dim) to their nearest centroids of 'C'.
+// 'C_norm' are squared L2 norms of 'C'.
+static void AssignDTNIndex(const float_t* X, int n, const tsr_t& C,
+                           const std::vector<float_t>& C_norm, int* list) {
+  // 'XC' of a batch fits in cache.
+  static constexpr int BATCH = 64;  // magic number
+  int nlist = C.dim(0);
+  int dim = C.dim(1);
+  // transposed 'C', so that 'gemm' runs on rows of it by 'axpy'
+  std::vector<float_t> CT((size_t)dim * nlist);
+  for (int j = 0; j < nlist; ++j) {
+    for (int l = 0; l < dim; ++l) {
+      CT[(size_t)l * nlist + j] = C.data()[(size_t)j * dim + l];
+    }
+  }
+  std::vector<float_t> XC((size_t)BATCH * nlist);
+  for (int begin = 0; begin < n; begin += BATCH) {
+    int rows = std::min(BATCH, n - begin);
+    ll_math_t::gemm(0, 0, rows, nlist, dim, X + (size_t)begin * dim,
+                    CT.data(), XC.data());
+    for (int i = 0; i < rows; ++i) {
+      // |x - c|^2 = |x|^2 - 2 * x * c + |c|^2
+      const float_t* xc = XC.data() + (size_t)i * nlist;
+      int best = 0;
+      float_t best_distance = C_norm[0] - 2 * xc[0];
+      for (int j = 1; j < nlist; ++j) {
+        float_t distance = C_norm[j] - 2 * xc[j];
+        if (distance < best_distance) {
+          best = j;
+          best_distance = distance;
+        }
+      }
+      list[begin + i] = best;
+    }
+  }
 }
 
-auto ModelServer::NewOpContext() const -> op_context_ptr_t {
-  op_context_ptr_t op_context(new OpContext, DeleteOpContext);
+void ModelServer::DTNIndex::Build(const tsr_t& T, int nlist) {
+  static constexpr int ITER = 10;            // magic number
+  static constexpr int TRAIN_PER_LIST = 64;  // magic number
+  int n = T.dim(0);
+  int dim = T.dim(1);
+  nlist = std::min(nlist, n);
+  int m = (int)std::min((int64_t)n, (int64_t)nlist * TRAIN_PER_LIST);
+
+  std::default_random_engine engine;
+  std::vector<int> sample(n);
+  std::iota(sample.begin(), sample.end(), 0);
+  for (int i = 0; i < m; ++i) {
+    std::uniform_int_distribution<int> dist(i, n - 1);
+    std::swap(sample[i], sample[dist(engine)]);
+  }
+  tsr_t S;
+  S.resize(m, dim);
+  for (int i = 0; i < m; ++i) {
+    const float_t* row = T.data() + (size_t)sample[i] * dim;
+    std::copy(row, row + dim, S.data() + (size_t)i * dim);
+  }
 
-  if (!graph_ || !model_) {
-    op_context.reset();
-    return op_context;
+  tsr_t& C = centroids;
+  C.resize(nlist, dim);
+  std::copy(S.data(), S.data() + (size_t)nlist * dim, C.data());
+  std::vector<float_t> C_norm(nlist);
+  auto update_norm = [&C, &C_norm, dim, nlist]() {
+    for (int j = 0; j < nlist; ++j) {
+      const float_t* c = C.data() + (size_t)j * dim;
+      C_norm[j] = ll_math_t::dot(dim, c, c);
+    }
+  };
+
+  std::vector<int> list(m);
+  std::vector<int> count(nlist);
+  std::uniform_int_distribution<int> sample_dist(0, m - 1);
+  for (int iter = 0; iter < ITER; ++iter) {
+    update_norm();
+    AssignDTNIndex(S.data(), m, C, C_norm, list.data());
+    C.zeros();
+    std::fill(count.begin(), count.end(), 0);
+    for (int i = 0; i < m; ++i) {
+      ll_math_t::add(dim, C.data() + (size_t)list[i] * dim,
+                     S.data() + (size_t)i * dim,
+                     C.data() + (size_t)list[i] * dim);
+      ++count[list[i]];
+    }
+    for (int j = 0; j < nlist; ++j) {
+      float_t* c = C.data() + (size_t)j * dim;
+      if (count[j] > 0) {
+        ll_math_t::mul_scalar(dim, c, (float_t)1 / count[j], c);
+      } else {
+        // Restart an empty list from a random row.
+        const float_t* row = S.data() + (size_t)sample_dist(engine) * dim;
+        std::copy(row, row + dim, c);
+      }
+    }
   }
 
-  op_context->Init(graph_.get(), model_->mutable_param());
-  if (!op_context->InitOp({target_name_}, -1)) {
-    op_context.reset();
-    return op_context;
+  Assign(T);
+}
+
+void ModelServer::DTNIndex::Assign(const tsr_t& T) {
+  const tsr_t& C = centroids;
+  int n = T.dim(0);
+  int dim = T.dim(1);
+  int nlist = C.dim(0);
+  std::vector<float_t> C_norm(nlist);
+  for (int j = 0; j < nlist; ++j) {
+    const float_t* c = C.data() + (size_t)j * dim;
+    C_norm[j] = ll_math_t::dot(dim, c, c);
   }
 
+  std::vector<int> list(n);
+  AssignDTNIndex(T.data(), n, C, C_norm, list.data());
+  list_begin.assign(nlist + 1, 0);
+  for (int i = 0; i < n; ++i) {
+    ++list_begin[list[i] + 1];
+  }
+  for (int j = 0; j < nlist; ++j) {
+    list_begin[j + 1] += list_begin[j];
+  }
+  list_items.resize(n);
+  std::vector<int> cursor(list_begin.begin(), list_begin.end() - 1);
+  for (int i = 0; i < n; ++i) {
+    list_items[cursor[list[i]]++] = i;
+  }
+}
+
+namespace {
+
+// Interaction of DTNModel of a user tower output and item tower outputs.
+class DTNInteraction {
+ private:
+  OpContext op_context_;
+  std::string target_name_;
+
+ public:
+  bool Init(const Graph& graph, TensorMap* param) {
+    if (!HasDTNTowers(graph)) {
+      return false;
+    }
+    target_name_ = graph.target(DTN_TOWER_INFER_TARGET).name();
+    op_context_.Init(&graph, param);
+    return op_context_.InitOp({target_name_}, -1);
+  }
+
+  // Predict rows 'indices[0, n)' of 'T' of (*, dim),
+  // or rows [0, n) of 'T' if 'indices' is nullptr.
+  const tsr_t& Predict(const std::vector<float>& user_tower, const float_t* T,
+                       int dim, const int* indices, int n) {
+    Instance* inst = op_context_.mutable_inst();
+    auto& U = inst->get_or_insert<tsr_t>(DTN_USER_TOWER_NAME);
+    U.resize(1, (int)user_tower.size());
+    std::copy(user_tower.begin(), user_tower.end(), U.begin());
+    auto& I = inst->get_or_insert<tsr_t>(DTN_ITEM_TOWER_NAME);
+    I.resize(n, dim);
+    if (indices) {
+      for (int i = 0; i < n; ++i) {
+        const float_t* row = T + (size_t)indices[i] * dim;
+        std::copy(row, row + dim, I.data() + (size_t)i * dim);
+      }
+    } else {
+      std::copy(T, T + (size_t)n * dim, I.data());
+    }
+    inst->set_batch(n);
+
+    op_context_.InitPredict();
+    op_context_.Predict();
+    const auto& P = op_context_.hidden().get<tsr_t>(target_name_);
+    DXASSERT(P.is_rank(2));
+    DXASSERT(P.dim(0) == n);
+    return P;
+  }
+};
+
+}  // namespace
+
+auto ModelServer::PrecomputeDTNItems(
+    const std::shared_ptr<const Version>& version, uint64_t serial,
+    const std::shared_ptr<const DTNCatalog>& catalog, const DTNIndex* index)
+    -> std::shared_ptr<const DTNItems> {
+  static constexpr size_t BATCH = 1024;  // magic number
+  DXINFO("Precomputing item towers of %zu items...", catalog->ids.size());
+  std::shared_ptr<DTNItems> items(new DTNItems);
+  items->catalog = catalog;
+  items->version = version;
+  items->serial = serial;
+  size_t n = catalog->ids.size();
+  tsr_t T;
+  for (size_t begin = 0; begin < n; begin += BATCH) {
+    size_t end = std::min(begin + BATCH, n);
+    if (!RunDTNTower(*version->graph, version->model->mutable_param(),
+                     DTN_ITEM_TOWER_TARGET, DTN_X_ITEM_NAME,
+                     catalog->features, begin, end, &T)) {
+      DXERROR("Failed to precompute item towers.");
+      return nullptr;
+    }
+    DXASSERT(T.is_rank(2));
+    if (begin == 0) {
+      items->tower.resize((int)n, T.dim(1));
+    }
+    std::copy(T.begin(), T.end(),
+              items->tower.begin() + begin * items->tower.dim(1));
+  }
+  if (catalog->index_list > 0) {
+    if (index && !index->centroids.empty() &&
+        index->centroids.dim(1) == items->tower.dim(1)) {
+      DXINFO("Reassigning item towers to %d lists...",
+             index->centroids.dim(0));
+      items->index.centroids = index->centroids;
+      items->index.Assign(items->tower);
+    } else {
+      DXINFO("Clustering item towers into %d lists...", catalog->index_list);
+      items->index.Build(items->tower, catalog->index_list);
+    }
+  }
+  DXINFO("Done.");
+  return items;
+}
+
+void ModelServer::ScheduleDTNItems(bool delta) {
+  DTNPrecompute& precompute = *dtn_precompute_;
+  std::lock_guard<std::mutex> guard(precompute.mutex);
+  if (!precompute.catalog || !version_.load()) {
+    return;
+  }
+  // Pending precomputes are merged, a full version makes them full.
+  precompute.delta = precompute.pending ? precompute.delta && delta : delta;
+  precompute.pending = 1;
+  if (!precompute.thread.joinable()) {
+    precompute.thread = std::thread(&ModelServer::DTNPrecomputeThread, this);
+  }
+  precompute.cond.notify_all();
+}
+
+void ModelServer::DTNPrecomputeThread() {
+  DTNPrecompute& precompute = *dtn_precompute_;
+  std::unique_lock<std::mutex> guard(precompute.mutex);
+  for (;;) {
+    precompute.cond.wait(guard, [&precompute]() {
+      return precompute.stop || precompute.pending;
+    });
+    if (precompute.stop) {
+      return;
+    }
+    std::shared_ptr<const DTNCatalog> catalog = precompute.catalog;
+    bool delta = precompute.delta != 0;
+    precompute.pending = 0;
+    precompute.busy = 1;
+    guard.unlock();
+
+    uint64_t serial;
+    std::shared_ptr<const Version> version = version_.load(&serial);
+    // Centroids are reused after deltas of the version of 'prev_items'.
+    std::shared_ptr<const DTNItems> prev_items = dtn_items_.load();
+    const DTNIndex* index = nullptr;
+    if (delta && prev_items && prev_items->catalog == catalog) {
+      index = &prev_items->index;
+    }
+    std::shared_ptr<const DTNItems> items;
+    try {
+      items = PrecomputeDTNItems(version, serial, catalog, index);
+    } catch (std::exception& e) {
+      DXERROR("Failed to precompute item towers: %s.", e.what());
+    }
+
+    guard.lock();
+    precompute.busy = 0;
+    precompute.failed = items ? 0 : 1;
+    if (!items) {
+      // Centroids of previous items are stale for the next precompute.
+      precompute.delta = 0;
+    } else if (catalog == precompute.catalog) {
+      // Items of a replaced catalog are dropped.
+      dtn_items_.store(std::move(items));
+    }
+    precompute.cond.notify_all();
+  }
+}
+
+bool ModelServer::GetDTNUserTower(const Version& version, uint64_t serial,
+                                  uint64_t user_id,
+                                  const features_t& user_features,
+                                  std::vector<float>* user_tower) const {
+  DTNUserCache& cache = *dtn_user_cache_;
+  {
+    std::lock_guard<std::mutex> guard(cache.mutex);
+    if (cache.capacity > 0) {
+      auto node = cache.cache.get(user_id);
+      if (node && node->value().serial == serial) {
+        *user_tower = node->value().tower;
+        return true;
+      }
+    }
+  }
+
+  tsr_t T;
+  if (!RunDTNTower(*version.graph, version.model->mutable_param(),
+                   DTN_USER_TOWER_TARGET, DTN_X_USER_NAME, {user_features}, 0,
+                   1, &T)) {
+    return false;
+  }
+  user_tower->assign(T.begin(), T.end());
+
+  std::lock_guard<std::mutex> guard(cache.mutex);
+  if (cache.capacity > 0) {
+    DTNUserCache::Entry entry;
+    entry.serial = serial;
+    entry.tower = *user_tower;
+    cache.cache.insert(user_id, entry);
+  }
+  return true;
+}
+
+bool ModelServer::DTNSetItems(
+    const std::vector<uint64_t>& item_ids,
+    const std::vector<features_t>& batch_item_features, int index_list) {
+  if (item_ids.size() != batch_item_features.size()) {
+    DXERROR("Inconsistent item ids and features: %zu vs %zu.",
+            item_ids.size(), batch_item_features.size());
+    return false;
+  }
+
+  if (index_list < 0) {
+    DXERROR("Invalid index_list: %d.", index_list);
+    return false;
+  }
+
+  std::shared_ptr<DTNCatalog> catalog;
+  if (!item_ids.empty()) {
+    catalog.reset(new DTNCatalog);
+    catalog->ids = item_ids;
+    catalog->features = batch_item_features;
+    catalog->index_list = index_list;
+    for (size_t i = 0; i < item_ids.size(); ++i) {
+      if (!catalog->index.emplace(item_ids[i], (int)i).second) {
+        DXERROR("Duplicate item: %llu.",
+                (unsigned long long)item_ids[i]);  // NOLINT
+        return false;
+      }
+    }
+  }
+
+  DTNPrecompute& precompute = *dtn_precompute_;
+  std::shared_ptr<const DTNCatalog> prev_catalog;
+  {
+    std::lock_guard<std::mutex> load_guard(load_mutex_);
+    std::lock_guard<std::mutex> guard(precompute.mutex);
+    std::shared_ptr<const Version> version = version_.load();
+    if (catalog && version && !HasDTNTowers(*version->graph)) {
+      return false;
+    }
+    prev_catalog = precompute.catalog;
+    precompute.catalog = catalog;
+    precompute.failed = 0;
+    if (!catalog) {
+      precompute.pending = 0;
+      dtn_items_.store(nullptr);
+      return true;
+    }
+  }
+  ScheduleDTNItems(false);
+  if (DTNWaitItems()) {
+    return true;
+  }
+
+  std::lock_guard<std::mutex> guard(precompute.mutex);
+  if (precompute.catalog == catalog) {
+    precompute.catalog = prev_catalog;
+  }
+  return false;
+}
+
+bool ModelServer::DTNWaitItems() {
+  DTNPrecompute& precompute = *dtn_precompute_;
+  std::unique_lock<std::mutex> guard(precompute.mutex);
+  precompute.cond.wait(guard, [&precompute]() {
+    return !precompute.pending && !precompute.busy;
+  });
+  return !precompute.failed;
+}
+
+void ModelServer::DTNSetUserCacheCapacity(size_t capacity) {
+  DTNUserCache& cache = *dtn_user_cache_;
+  std::lock_guard<std::mutex> guard(cache.mutex);
+  cache.capacity = capacity;
+  if (capacity > 0) {
+    cache.cache.init(capacity);
+  } else {
+    cache.cache.clear();
+  }
+}
+
+bool ModelServer::DTNBatchPredict(
+    uint64_t user_id, const features_t& user_features,
+    const std::vector<uint64_t>& item_ids,
+    std::vector<std::vector<float>>* batch_probs) const {
+  if (item_ids.empty()) {
+    return false;
+  }
+
+  uint64_t serial;
+  std::shared_ptr<const Version> version = version_.load(&serial);
+  if (!version) {
+    return false;
+  }
+
+  std::shared_ptr<const DTNItems> items = dtn_items_.load();
+  if (!items) {
+    DXERROR("Please set items first.");
+    return false;
+  }
+
+  const DTNCatalog& catalog = *items->catalog;
+  std::vector<int> indices(item_ids.size());
+  for (size_t i = 0; i < item_ids.size(); ++i) {
+    auto it = catalog.index.find(item_ids[i]);
+    if (it == catalog.index.end()) {
+      DXERROR("Item %llu is not in the catalog.",
+              (unsigned long long)item_ids[i]);  // NOLINT
+      return false;
+    }
+    indices[i] = it->second;
+  }
+
+  if (items->serial != serial) {
+    // Item towers are being precomputed for a new version.
+    std::vector<features_t> batch_item_features;
+    batch_item_features.reserve(indices.size());
+    for (int index : indices) {
+      batch_item_features.emplace_back(catalog.features[index]);
+    }
+    return DTNBatchPredict(user_features, batch_item_features, batch_probs);
+  }
+
+  std::vector<float> user_tower;
+  if (!GetDTNUserTower(*version, serial, user_id, user_features,
+                       &user_tower)) {
+    return false;
+  }
+
+  DTNInteraction interaction;
+  if (!interaction.Init(*version->graph, version->model->mutable_param())) {
+    return false;
+  }
+
+  const auto& P =
+      interaction.Predict(user_tower, items->tower.data(), items->tower.dim(1),
+                          indices.data(), (int)indices.size());
+  int col = P.dim(1);
+  const float_t* _P = P.data();
+  batch_probs->resize(indices.size());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    auto& batch_prob = (*batch_probs)[i];
+    batch_prob.resize(col);
+    for (int j = 0; j < col; ++j) {
+      batch_prob[j] = (float)*_P;
+      ++_P;
+    }
+  }
+  return true;
+}
+
+bool ModelServer::LoadDTNItems(
+    std::shared_ptr<const DTNItems>* items) const {
+  *items = dtn_items_.load();
+  if (!*items) {
+    DXERROR("Please set items first.");
+    return false;
+  }
+  return true;
+}
+
+bool ModelServer::DTNTopK(
+    uint64_t user_id, const features_t& user_features, int k, int nprobe,
+    std::vector<std::pair<uint64_t, float>>* top_items) const {
+  static constexpr int BATCH = 4096;  // magic number
+  if (k <= 0 || nprobe < 0) {
+    return false;
+  }
+
+  // Items are scored with the version of their item tower outputs.
+  std::shared_ptr<const DTNItems> items;
+  if (!LoadDTNItems(&items)) {
+    return false;
+  }
+  const Version& version = *items->version;
+
+  std::vector<float> user_tower;
+  if (!GetDTNUserTower(version, items->serial, user_id, user_features,
+                       &user_tower)) {
+    return false;
+  }
+
+  DTNInteraction interaction;
+  if (!interaction.Init(*version.graph, version.model->mutable_param())) {
+    return false;
+  }
+
+  const tsr_t& T = items->tower;
+  int dim = T.dim(1);
+  const DTNIndex& index = items->index;
+  int nlist = index.centroids.empty() ? 0 : index.centroids.dim(0);
+  std::vector<int> candidates;
+  const int* indices = nullptr;
+  int n = T.dim(0);
+  if (0 < nprobe && nprobe < nlist) {
+    // Probe lists whose centroids have the highest probs.
+    const auto& P =
+        interaction.Predict(user_tower, index.centroids.data(), dim, nullptr,
+                            nlist);
+    std::vector<std::pair<float, int>> lists(nlist);
+    for (int j = 0; j < nlist; ++j) {
+      lists[j] = std::make_pair((float)P.data()[j * P.dim(1)], j);
+    }
+    std::partial_sort(lists.begin(), lists.begin() + nprobe, lists.end(),
+                      std::greater<std::pair<float, int>>());
+    for (int j = 0; j < nprobe; ++j) {
+      int list = lists[j].second;
+      candidates.insert(candidates.end(),
+                        index.list_items.begin() + index.list_begin[list],
+                        index.list_items.begin() + index.list_begin[list + 1]);
+    }
+    indices = candidates.data();
+    n = (int)candidates.size();
+  }
+
+  // a min heap of (prob, index) of the top items
+  using scored_t = std::pair<float, int>;
+  std::vector<scored_t> top;
+  top.reserve(k);
+  for (int begin = 0; begin < n; begin += BATCH) {
+    int rows = std::min(BATCH, n - begin);
+    const auto& P =
+        indices ? interaction.Predict(user_tower, T.data(), dim,
+                                      indices + begin, rows)
+                : interaction.Predict(user_tower,
+                                      T.data() + (size_t)begin * dim, dim,
+                                      nullptr, rows);
+    int col = P.dim(1);
+    for (int i = 0; i < rows; ++i) {
+      scored_t scored((float)P.data()[i * col],
+                      indices ? indices[begin + i] : begin + i);
+      if ((int)top.size() < k) {
+        top.emplace_back(scored);
+        std::push_heap(top.begin(), top.end(), std::greater<scored_t>());
+      } else if (scored > top.front()) {
+        std::pop_heap(top.begin(), top.end(), std::greater<scored_t>());
+        top.back() = scored;
+        std::push_heap(top.begin(), top.end(), std::greater<scored_t>());
+      }
+    }
+  }
+  std::sort_heap(top.begin(), top.end(), std::greater<scored_t>());
+
+  const DTNCatalog& catalog = *items->catalog;
+  top_items->resize(top.size());
+  for (size_t i = 0; i < top.size(); ++i) {
+    (*top_items)[i].first = catalog.ids[top[i].second];
+    (*top_items)[i].second = top[i].first;
+  }
+  return true;
+}
+
+void ModelServer::DeleteOpContext(OpContext* op_context) noexcept {
+  delete static_cast<VersionedOpContext*>(op_context);
+}
+
+auto ModelServer::NewOpContext() const -> op_context_ptr_t {
+  op_context_ptr_t op_context(new VersionedOpContext, DeleteOpContext);
+  version_guard_t version(version_);
+  if (!Bind(version, op_context.get())) {
+    op_context.reset();
+  }
   return op_context;
 }
 
 bool ModelServer::Predict(OpContext* op_context, const features_t& features,
                           float* prob) const {
+  version_guard_t version(version_);
+  if (!Bind(version, op_context)) {
+    return false;
+  }
+
   Instance* inst = op_context->mutable_inst();
   int prev_batch = inst->batch();
 
@@ -311,7 +1280,7 @@ bool ModelServer::Predict(OpContext* op_context, const features_t& features,
   }
 
   op_context->Predict();
-  const auto& P = op_context->hidden().get<tsr_t>(target_name_);
+  const auto& P = op_context->hidden().get<tsr_t>(version->target_name);
   DXASSERT(P.is_rank(2));
   DXASSERT(P.same_shape(X.row(), 1));
   *prob = (float)P.data(0);
@@ -320,6 +1289,11 @@ bool ModelServer::Predict(OpContext* op_context, const features_t& features,
 
 bool ModelServer::Predict(OpContext* op_context, const features_t& features,
                           std::vector<float>* probs) const {
+  version_guard_t version(version_);
+  if (!Bind(version, op_context)) {
+    return false;
+  }
+
   Instance* inst = op_context->mutable_inst();
   int prev_batch = inst->batch();
 
@@ -333,7 +1307,7 @@ bool ModelServer::Predict(OpContext* op_context, const features_t& features,
   }
 
   op_context->Predict();
-  const auto& P = op_context->hidden().get<tsr_t>(target_name_);
+  const auto& P = op_context->hidden().get<tsr_t>(version->target_name);
   DXASSERT(P.is_rank(2));
   int col = P.dim(1);
   DXASSERT(P.same_shape(X.row(), col));
@@ -353,6 +1327,11 @@ bool ModelServer::BatchPredict(OpContext* op_context,
     return false;
   }
 
+  version_guard_t version(version_);
+  if (!Bind(version, op_context)) {
+    return false;
+  }
+
   Instance* inst = op_context->mutable_inst();
   int prev_batch = inst->batch();
 
@@ -368,7 +1347,7 @@ bool ModelServer::BatchPredict(OpContext* op_context,
   }
 
   op_context->Predict();
-  const auto& P = op_context->hidden().get<tsr_t>(target_name_);
+  const auto& P = op_context->hidden().get<tsr_t>(version->target_name);
   DXASSERT(P.is_rank(2));
   DXASSERT(P.same_shape(X.row(), 1));
   batch_prob->resize(X.row());
@@ -387,6 +1366,11 @@ bool ModelServer::BatchPredict(
     return false;
   }
 
+  version_guard_t version(version_);
+  if (!Bind(version, op_context)) {
+    return false;
+  }
+
   Instance* inst = op_context->mutable_inst();
   int prev_batch = inst->batch();
 
@@ -402,7 +1386,7 @@ bool ModelServer::BatchPredict(
   }
 
   op_context->Predict();
-  const auto& P = op_context->hidden().get<tsr_t>(target_name_);
+  const auto& P = op_context->hidden().get<tsr_t>(version->target_name);
   DXASSERT(P.is_rank(2));
   int col = P.dim(1);
   DXASSERT(P.same_shape(X.row(), col));
@@ -428,6 +1412,11 @@ bool ModelServer::DTNBatchPredict(
     return false;
   }
 
+  version_guard_t version(version_);
+  if (!Bind(version, op_context)) {
+    return false;
+  }
+
   Instance* inst = op_context->mutable_inst();
   int prev_batch = inst->batch();
 
@@ -446,7 +1435,7 @@ bool ModelServer::DTNBatchPredict(
   }
 
   op_context->Predict();
-  const auto& P = op_context->hidden().get<tsr_t>(target_name_);
+  const auto& P = op_context->hidden().get<tsr_t>(version->target_name);
   DXASSERT(P.is_rank(2));
   int col = P.dim(1);
   DXASSERT(P.same_shape(Xitem.row(), col));
@@ -464,4 +1453,183 @@ bool ModelServer::DTNBatchPredict(
   return true;
 }
 
+void ModelServer::DeletePredictPlan(PredictPlan* predict_plan) noexcept {
+  delete static_cast<VersionedPredictPlan*>(predict_plan);
+}
+
+auto ModelServer::NewPredictPlan(int batch) const -> predict_plan_ptr_t {
+  auto* plan = new VersionedPredictPlan;
+  plan->frozen_batch = batch;
+  predict_plan_ptr_t predict_plan(plan, DeletePredictPlan);
+  version_guard_t version(version_);
+  if (!Bind(version, predict_plan.get())) {
+    predict_plan.reset();
+  }
+  return predict_plan;
+}
+
+bool ModelServer::VersionedPredictPlan::InitInputs(
+    const std::string& target_name) {
+  batch_inputs.clear();
+  fixed_inputs.clear();
+  const GraphTarget* target = graph().find_target(target_name);
+  if (target == nullptr) {
+    DXERROR("Invalid target name: %s.", target_name.c_str());
+    return false;
+  }
+
+  for (int j = 0; j < target->forward_size(); ++j) {  // NOLINT
+    const GraphNode* node = target->forward(j);
+    if (node->node_type() != GRAPH_NODE_TYPE_INSTANCE) {
+      continue;
+    }
+
+    if (node->tensor_type() != TENSOR_TYPE_CSR) {
+      DXERROR("Instance node %s of predict plan is not a CSR.",
+              node->name().c_str());
+      return false;
+    }
+
+    int row = node->shape().empty() ? BATCH_PLACEHOLDER : node->shape()[0];
+    if (row == BATCH_PLACEHOLDER) {
+      batch_inputs.emplace_back(node->name());
+    } else {
+      auto& X = mutable_inst()->insert<csr_t>(node->name());
+      for (int i = 0; i < row; ++i) {
+        X.add_row();
+      }
+      fixed_inputs.emplace_back(node->name());
+    }
+  }
+  return true;
+}
+
+static bool FillPredictPlan(PredictPlan* predict_plan, const std::string& name,
+                            const std::vector<features_t>& batch_features) {
+  if (batch_features.empty() ||
+      (int)batch_features.size() > predict_plan->batch()) {
+    return false;
+  }
+
+  auto& X = predict_plan->mutable_inst()->get<csr_t>(name);
+  X.clear();
+  for (const auto& features : batch_features) {
+    EmplaceRow(features, &X);
+  }
+  while (X.row() < predict_plan->batch()) {
+    X.add_row();
+  }
+  return true;
+}
+
+bool ModelServer::VersionedPredictPlan::Fill(
+    const std::vector<features_t>& batch_features) {
+  if (batch_inputs.size() != 1 || !fixed_inputs.empty()) {
+    DXERROR("Predict plan has %d inputs, only 1 input of (batch, ...) is "
+            "supported.",
+            (int)(batch_inputs.size() + fixed_inputs.size()));
+    return false;
+  }
+  return FillPredictPlan(this, batch_inputs[0], batch_features);
+}
+
+bool ModelServer::VersionedPredictPlan::FillDTN(
+    const features_t& user_features,
+    const std::vector<features_t>& batch_item_features) {
+  if (fixed_inputs.size() != 1 || fixed_inputs[0] != DTN_X_USER_NAME ||
+      batch_inputs.size() != 1 || batch_inputs[0] != DTN_X_ITEM_NAME) {
+    DXERROR("Predict plan has no inputs of DTNModel.");
+    return false;
+  }
+
+  auto& Xuser = mutable_inst()->get<csr_t>(DTN_X_USER_NAME);
+  if (Xuser.row() != 1) {
+    DXERROR("Invalid DTN user input of %d rows.", Xuser.row());
+    return false;
+  }
+  Xuser.clear();
+  EmplaceRow(user_features, &Xuser);
+  return FillPredictPlan(this, DTN_X_ITEM_NAME, batch_item_features);
+}
+
+bool ModelServer::BatchPredict(PredictPlan* predict_plan,
+                               const std::vector<features_t>& batch_features,
+                               std::vector<float>* batch_prob) const {
+  auto* plan = static_cast<VersionedPredictPlan*>(predict_plan);
+  version_guard_t version(version_);
+  if (!Bind(version, plan) || !plan->Fill(batch_features)) {
+    return false;
+  }
+
+  predict_plan->Predict();
+  const auto& P = predict_plan->target(0);
+  DXASSERT(P.same_shape(predict_plan->batch(), 1));
+  int row = (int)batch_features.size();
+  batch_prob->resize(row);
+  const float_t* _P = P.data();
+  for (int i = 0; i < row; ++i) {
+    (*batch_prob)[i] = (float)*_P;
+    ++_P;
+  }
+  return true;
+}
+
+bool ModelServer::BatchPredict(
+    PredictPlan* predict_plan, const std::vector<features_t>& batch_features,
+    std::vector<std::vector<float>>* batch_probs) const {
+  auto* plan = static_cast<VersionedPredictPlan*>(predict_plan);
+  version_guard_t version(version_);
+  if (!Bind(version, plan) || !plan->Fill(batch_features)) {
+    return false;
+  }
+
+  predict_plan->Predict();
+  const auto& P = predict_plan->target(0);
+  DXASSERT(P.is_rank(2));
+  int col = P.dim(1);
+  DXASSERT(P.same_shape(predict_plan->batch(), col));
+  int row = (int)batch_features.size();
+  batch_probs->resize(row);
+  const float_t* _P = P.data();
+  for (int i = 0; i < row; ++i) {
+    auto& batch_prob = (*batch_probs)[i];
+    batch_prob.resize(col);
+    for (int j = 0; j < col; ++j) {
+      batch_prob[j] = (float)*_P;
+      ++_P;
+    }
+  }
+  return true;
+}
+
+bool ModelServer::DTNBatchPredict(
+    PredictPlan* predict_plan, const features_t& user_features,
+    const std::vector<features_t>& batch_item_features,
+    std::vector<std::vector<float>>* batch_probs) const {
+  auto* plan = static_cast<VersionedPredictPlan*>(predict_plan);
+  version_guard_t version(version_);
+  if (!Bind(version, plan) ||
+      !plan->FillDTN(user_features, batch_item_features)) {
+    return false;
+  }
+
+  predict_plan->Predict();
+  const auto& P = predict_plan->target(0);
+  DXASSERT(P.is_rank(2));
+  int col = P.dim(1);
+  DXASSERT(P.same_shape(predict_plan->batch(), col));
+  int row = (int)batch_item_features.size();
+  batch_probs->resize(row);
+  const float_t* _P = P.data();
+  for (int i = 0; i < row; ++i) {
+    auto& batch_prob = (*batch_probs)[i];
+    batch_prob.resize(col);
+    for (int j = 0; j < col; ++j) {
+      batch_prob[j] = (float)*_P;
+      ++_P;
+    }
+  }
+  return true;
+}
+
 }  // namespace deepx_core
@@ -3,8 +3,11 @@
 //
 
 #pragma once
+#include <deepx_core/common/rcu.h>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -12,17 +15,60 @@
 namespace deepx_core {
 
 class Graph;
+class MappedModel;
 class Model;
 class OpContext;
+class PredictPlan;
 
 using feature_t = std::pair<uint64_t, float>;
 using features_t = std::vector<feature_t>;
 
+// ModelServer serves a version of a graph and its model.
+//
+// Each successful 'Load', 'LoadModel' or 'LoadMappedModel' publishes a new
+// version atomically, they are thread safe with predictions,
+// so that models can be hot swapped while serving.
+// In-flight predictions finish on the old version,
+// which is freed after the last of them leaves.
+//
+// Predictions pin the version with 'RCUPtr' while they run.
+// An idle OpContext or PredictPlan doesn't keep its version alive,
+// it is bound to the latest version on its next use after a swap.
+//
+// 'ApplyDelta' publishes a delta version, which overlays changed rows on
+// the current version and shares its unchanged dense params, without
+// reloading it.
+// Rows of a version are never changed after it is published,
+// so predictions never see torn embeddings.
+//
+// For DTNModel, item tower outputs of an item catalog are precomputed for
+// each published version, and user tower outputs are cached,
+// so that 'DTNBatchPredict' of catalog items only runs the interaction.
+// Catalog items can be clustered by their item tower outputs,
+// so that 'DTNTopK' scores only items of the most promising clusters.
+// Precomputes run in a background thread after publishes,
+// previous outputs and their version are served until they finish.
 class ModelServer {
  private:
-  std::unique_ptr<Graph> graph_;
+  struct Version;
+  class VersionedOpContext;
+  class VersionedPredictPlan;
+  struct DTNCatalog;
+  struct DTNIndex;
+  struct DTNItems;
+  struct DTNPrecompute;
+  struct DTNUserCache;
+
+  std::mutex load_mutex_;
+  // graph of the next 'LoadModel' or 'LoadMappedModel'
+  std::shared_ptr<const Graph> graph_;
   std::string target_name_;
-  std::unique_ptr<Model> model_;
+  RCUPtr<const Version> version_;
+  // item tower outputs of the catalog
+  RCUPtr<const DTNItems> dtn_items_;
+  // the item catalog and the thread precomputing 'dtn_items_'
+  std::unique_ptr<DTNPrecompute> dtn_precompute_;
+  std::unique_ptr<DTNUserCache> dtn_user_cache_;
 
  public:
   ModelServer();
@@ -30,10 +76,52 @@ class ModelServer {
   ModelServer(const ModelServer&) = delete;
   ModelServer& operator=(const ModelServer&) = delete;
 
+ private:
+  // 'delta' is whether 'version' is a delta of the latest version.
+  // It fails if item towers of the catalog can't run with 'version'.
+  bool Publish(std::unique_ptr<Version> version, bool delta = false);
+  using version_guard_t = RCUPtr<const Version>::ReadGuard;
+  // Bind 'op_context' or 'predict_plan' to 'version',
+  // which is pinned by the caller while they are used.
+  static bool Bind(const version_guard_t& version, OpContext* op_context);
+  static bool Bind(const version_guard_t& version, PredictPlan* predict_plan);
+  static void DeleteOpContext(OpContext* op_context) noexcept;
+  static void DeletePredictPlan(PredictPlan* predict_plan) noexcept;
+  // Precompute item tower outputs of 'catalog' with 'version' of 'serial'.
+  // Centroids of 'index'(can be nullptr) are reused by the new index.
+  static std::shared_ptr<const DTNItems> PrecomputeDTNItems(
+      const std::shared_ptr<const Version>& version, uint64_t serial,
+      const std::shared_ptr<const DTNCatalog>& catalog,
+      const DTNIndex* index);
+  // Precompute item tower outputs with the latest version in the background.
+  void ScheduleDTNItems(bool delta);
+  void DTNPrecomputeThread();
+  bool GetDTNUserTower(const Version& version, uint64_t serial,
+                       uint64_t user_id, const features_t& user_features,
+                       std::vector<float>* user_tower) const;
+  // Load the latest item tower outputs, which hold their version.
+  bool LoadDTNItems(std::shared_ptr<const DTNItems>* items) const;
+
  public:
   bool Load(const std::string& file);
+  // 'LoadGraph' is not published until the next 'LoadModel' or
+  // 'LoadMappedModel'.
   bool LoadGraph(const std::string& file);
+  // Models converted by 'model_quantizer' are served by predict-only
+  // quantized kernels.
   bool LoadModel(const std::string& file);
+  // Map a model converted by 'mapped_model_converter' after 'LoadGraph'.
+  // Params are served read-only from the mapping.
+  bool LoadMappedModel(const std::string& file, bool populate = false);
+  // Apply a delta of changed dense params and sparse rows, saved by
+  // 'OLStore::SaveFeatureKVModel' or 'FeatureKVUtil::SaveModel',
+  // after 'Load', 'LoadModel' or 'LoadMappedModel' of an unquantized model.
+  // Overlays of in-memory models are folded into a new full version, once
+  // they grow beyond a fraction of the model.
+  // Long chains of overlays are merged into one overlay.
+  bool ApplyDelta(const std::string& file);
+  // # of published versions.
+  uint64_t version() const noexcept;
 
  public:
   bool Predict(const features_t& features, float* prob) const;
@@ -48,6 +136,41 @@ class ModelServer {
                        std::vector<std::vector<float>>* batch_probs) const;
 
  public:
+  // only for DTNModel whose graph has tower targets, see "model_zoo/dtn.h"
+  //
+  // Set the item catalog, replacing the old one.
+  // Item tower outputs are precomputed now and after each later publish.
+  // If 'index_list' > 0, they are clustered into 'index_list' lists
+  // for 'DTNTopK', after deltas, items are only reassigned to the lists.
+  // The old catalog is kept if they fail to be precomputed.
+  bool DTNSetItems(const std::vector<uint64_t>& item_ids,
+                   const std::vector<features_t>& batch_item_features,
+                   int index_list = 0);
+  // Wait for precomputes of item tower outputs,
+  // return false if the last one failed.
+  bool DTNWaitItems();
+  // Cache user tower outputs of at most 'capacity' users, 0 disables it.
+  void DTNSetUserCacheCapacity(size_t capacity);
+  // Predict catalog items of 'item_ids' for user 'user_id'.
+  // It runs only the interaction of the user tower output and
+  // precomputed item tower outputs.
+  // 'user_features' are ignored, if the user tower output of 'user_id'
+  // is cached for the current version.
+  bool DTNBatchPredict(uint64_t user_id, const features_t& user_features,
+                       const std::vector<uint64_t>& item_ids,
+                       std::vector<std::vector<float>>* batch_probs) const;
+  // Retrieve top 'k' catalog items of the highest probs for user 'user_id',
+  // in descending order of probs.
+  // If the catalog is clustered and 'nprobe' > 0, only items of 'nprobe'
+  // lists whose centroids have the highest probs are scored,
+  // otherwise all items are scored exactly.
+  bool DTNTopK(uint64_t user_id, const features_t& user_features, int k,
+               int nprobe,
+               std::vector<std::pair<uint64_t, float>>* top_items) const;
+
+ public:
+  // An OpContext must be used by one thread at a time.
+  // It is bound to the latest version on its next use after a swap.
   using op_context_ptr_t = std::unique_ptr<OpContext, void (*)(OpContext*)>;
   op_context_ptr_t NewOpContext() const;
   bool Predict(OpContext* op_context, const features_t& features,
@@ -64,6 +187,29 @@ class ModelServer {
   bool DTNBatchPredict(OpContext* op_context, const features_t& user_features,
                        const std::vector<features_t>& batch_item_features,
                        std::vector<std::vector<float>>* batch_probs) const;
+
+ public:
+  // A plan is frozen at 'batch' and must be used by one thread at a time.
+  // Requests of at most 'batch' rows are padded with empty rows.
+  // It is bound to the latest version on its next use after a swap.
+  //
+  // Its inputs are the CSR instance nodes of the target.
+  // 'BatchPredict' requires exactly one input of (batch, ...),
+  // 'DTNBatchPredict' requires the user and item inputs of DTNModel.
+  using predict_plan_ptr_t =
+      std::unique_ptr<PredictPlan, void (*)(PredictPlan*)>;
+  predict_plan_ptr_t NewPredictPlan(int batch) const;
+  bool BatchPredict(PredictPlan* predict_plan,
+                    const std::vector<features_t>& batch_features,
+                    std::vector<float>* batch_prob) const;
+  bool BatchPredict(PredictPlan* predict_plan,
+                    const std::vector<features_t>& batch_features,
+                    std::vector<std::vector<float>>* batch_probs) const;
+  // only for DTNModel
+  bool DTNBatchPredict(PredictPlan* predict_plan,
+                       const features_t& user_features,
+                       const std::vector<features_t>& batch_item_features,
+                       std::vector<std::vector<float>>* batch_probs) const;
 };
 
 }  // namespace deepx_core
@@ -0,0 +1,231 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Load generator of BatchingModelServer.
+//
+// Clients send single requests in closed loops at increasing concurrencies,
+// either directly to a ModelServer with their own OpContexts,
+// or through a BatchingModelServer.
+// Throughputs and latencies are reported for each concurrency,
+// as well as the best throughput whose p99 latency is within '--p99'.
+//
+
+#include <deepx_core/common/group_config.h>
+#include <deepx_core/common/str_util.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "batching_model_server.h"
+#include "model_server.h"
+#include "model_zoo.h"
+
+DEFINE_string(model, "deep_fm", "model name");
+DEFINE_string(group_config, "1:10000:8,2:10000:8,3:10000:8,4:10000:8",
+              "group config");
+DEFINE_string(dir, "/tmp", "directory of temporary graph and model files");
+DEFINE_string(client, "1,4,16,64", "comma separated # of clients");
+DEFINE_int32(second, 3, "seconds of each run");
+DEFINE_int32(thread, 1, "# of worker threads of BatchingModelServer");
+DEFINE_int32(max_batch, 64, "max batch size of BatchingModelServer");
+DEFINE_int32(max_wait_us, 100, "max wait in us of BatchingModelServer");
+DEFINE_double(p99, 10, "p99 latency bound in ms");
+
+namespace deepx_core {
+namespace {
+
+using int_t = DataType::int_t;
+using srm_t = DataType::srm_t;
+using ll_sparse_tensor_t = DataType::ll_sparse_tensor_t;
+using steady_clock_t = std::chrono::steady_clock;
+
+double ToMillisecond(steady_clock_t::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+features_t MakeFeatures(const std::vector<GroupConfigItem>& items,
+                        std::default_random_engine& engine) {
+  std::uniform_real_distribution<float> value_dist(0, 1);
+  features_t features;
+  for (const GroupConfigItem& item : items) {
+    std::uniform_int_distribution<int_t> id_dist(
+        0, (int_t)item.embedding_row - 1);
+    features.emplace_back(
+        ll_sparse_tensor_t::make_feature_id(item.group_id, id_dist(engine)),
+        value_dist(engine));
+  }
+  return features;
+}
+
+// Save a model with all rows of 'items'.
+void SaveModel(const Graph& graph, const std::vector<GroupConfigItem>& items,
+               const std::string& file) {
+  std::default_random_engine engine;
+  Model model;
+  model.Init(&graph);
+  DXCHECK_THROW(model.InitParam(engine));
+  model.ForEachSRM([&engine, &items](const std::string&, srm_t* W) {
+    for (const GroupConfigItem& item : items) {
+      for (int i = 0; i < item.embedding_row; ++i) {
+        W->get_row(engine, (int_t)ll_sparse_tensor_t::make_feature_id(
+                               item.group_id, (int_t)i));
+      }
+    }
+  });
+  DXCHECK_THROW(model.Save(file));
+}
+
+struct Result {
+  double qps = 0;
+  double p50 = 0;
+  double p99 = 0;
+};
+
+// Run 'client' clients in closed loops for 'FLAGS_second' seconds.
+// 'predict(i, features, probs)' is called by the i-th client.
+template <class Predict>
+Result Run(const std::vector<features_t>& requests, int client,
+           Predict&& predict) {
+  std::atomic<int> stop{0};
+  std::atomic<int> error{0};
+  std::vector<std::vector<double>> latencies(client);
+  std::vector<std::thread> threads;
+  auto begin = steady_clock_t::now();
+  for (int i = 0; i < client; ++i) {
+    threads.emplace_back([&, i]() {
+      std::vector<float> probs;
+      size_t k = (size_t)i;
+      while (!stop) {
+        const features_t& features = requests[k++ % requests.size()];
+        auto request_begin = steady_clock_t::now();
+        if (!predict(i, features, &probs)) {
+          ++error;
+        }
+        latencies[i].emplace_back(
+            ToMillisecond(steady_clock_t::now() - request_begin));
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(FLAGS_second));
+  stop = 1;
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  double second = ToMillisecond(steady_clock_t::now() - begin) / 1e3;
+  DXCHECK_THROW(error == 0);
+
+  std::vector<double> latency;
+  for (const std::vector<double>& l : latencies) {
+    latency.insert(latency.end(), l.begin(), l.end());
+  }
+  std::sort(latency.begin(), latency.end());
+  Result result;
+  result.qps = latency.size() / second;
+  result.p50 = latency[latency.size() / 2];
+  result.p99 = latency[latency.size() * 99 / 100];
+  return result;
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::vector<int> clients;
+  DXCHECK_THROW(Split<int>(FLAGS_client, ",", &clients));
+  DXCHECK_THROW(!clients.empty());
+  DXCHECK_THROW(FLAGS_second > 0);
+
+  std::unique_ptr<ModelZoo> model_zoo(NewModelZoo(FLAGS_model));
+  DXCHECK_THROW(model_zoo);
+  StringMap config;
+  config["group_config"] = FLAGS_group_config;
+  config["sparse"] = "1";
+  Graph graph;
+  DXCHECK_THROW(model_zoo->InitConfig(config));
+  DXCHECK_THROW(model_zoo->InitGraph(&graph));
+
+  std::vector<GroupConfigItem> items;
+  DXCHECK_THROW(GuessGroupConfig(FLAGS_group_config, &items, nullptr));
+  std::string graph_file = FLAGS_dir + "/model_server_batching_bench.graph";
+  std::string model_file = FLAGS_dir + "/model_server_batching_bench.model";
+  DXCHECK_THROW(graph.Save(graph_file));
+  SaveModel(graph, items, model_file);
+
+  ModelServer model_server;
+  DXCHECK_THROW(model_server.LoadGraph(graph_file));
+  DXCHECK_THROW(model_server.LoadModel(model_file));
+
+  std::default_random_engine engine;
+  std::vector<features_t> requests(10000);  // magic number
+  for (features_t& features : requests) {
+    features = MakeFeatures(items, engine);
+  }
+
+  BatchingModelServer::Config batching_config;
+  batching_config.thread = FLAGS_thread;
+  batching_config.max_batch = FLAGS_max_batch;
+  batching_config.max_wait_us = FLAGS_max_wait_us;
+
+  double best_qps[2] = {0, 0};
+  for (int client : clients) {
+    std::vector<ModelServer::op_context_ptr_t> op_contexts;
+    for (int i = 0; i < client; ++i) {
+      op_contexts.emplace_back(model_server.NewOpContext());
+    }
+    Result direct = Run(requests, client,
+                        [&](int i, const features_t& features,
+                            std::vector<float>* probs) {
+                          return model_server.Predict(op_contexts[i].get(),
+                                                      features, probs);
+                        });
+
+    BatchingModelServer batching_model_server;
+    batching_model_server.Start(&model_server, batching_config);
+    Result batching =
+        Run(requests, client,
+            [&](int, const features_t& features, std::vector<float>* probs) {
+              return batching_model_server.Predict(features, probs);
+            });
+    BatchingModelServer::Stats stats = batching_model_server.stats();
+    batching_model_server.Stop();
+
+    DXINFO("clients=%d, direct: qps=%.0f, p50=%.3fms, p99=%.3fms.", client,
+           direct.qps, direct.p50, direct.p99);
+    DXINFO(
+        "clients=%d, batching: qps=%.0f, p50=%.3fms, p99=%.3fms, "
+        "mean batch=%.1f, mean queue=%.3fms, mean compute=%.3fms.",
+        client, batching.qps, batching.p50, batching.p99,
+        (double)stats.request / stats.batch, stats.queue_ms / stats.request,
+        stats.compute_ms / stats.batch);
+    if (direct.p99 <= FLAGS_p99) {
+      best_qps[0] = std::max(best_qps[0], direct.qps);
+    }
+    if (batching.p99 <= FLAGS_p99) {
+      best_qps[1] = std::max(best_qps[1], batching.qps);
+    }
+  }
+  DXINFO("qps at p99<=%.1fms: direct=%.0f, batching=%.0f.", FLAGS_p99,
+         best_qps[0], best_qps[1]);
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
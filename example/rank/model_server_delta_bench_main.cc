@@ -0,0 +1,313 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Benchmark of applying deltas to a live ModelServer.
+//
+// Deltas of changed rows are applied one after another,
+// while threads keep predicting with stateless calls, OpContext and
+// PredictPlan.
+// Rows of the request alternate between two patterns across deltas,
+// each prediction must match one pattern entirely.
+//
+
+#include <deepx_core/common/group_config.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/feature_kv_util.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "model_server.h"
+#include "model_zoo.h"
+
+DEFINE_string(model, "deep_fm", "model name");
+DEFINE_string(group_config, "1:100000:8,2:100000:8,3:100000:8,4:100000:8",
+              "group config");
+DEFINE_string(dir, "/tmp", "directory of temporary graph and model files");
+DEFINE_int32(thread, 6, "# of predicting threads");
+DEFINE_int32(batch, 16, "batch size");
+DEFINE_int32(delta, 20, "# of deltas");
+DEFINE_int32(delta_id, 20000, "# of changed ids per delta");
+
+namespace deepx_core {
+namespace {
+
+using float_t = DataType::float_t;
+using int_t = DataType::int_t;
+using tsr_t = DataType::tsr_t;
+using srm_t = DataType::srm_t;
+using ll_sparse_tensor_t = DataType::ll_sparse_tensor_t;
+using steady_clock_t = std::chrono::steady_clock;
+using batch_probs_t = std::vector<std::vector<float>>;
+
+double ToMillisecond(steady_clock_t::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+int_t RandomId(const std::vector<GroupConfigItem>& items,
+               std::default_random_engine& engine) {
+  std::uniform_int_distribution<size_t> item_dist(0, items.size() - 1);
+  const GroupConfigItem& item = items[item_dist(engine)];
+  std::uniform_int_distribution<int_t> id_dist(0,
+                                               (int_t)item.embedding_row - 1);
+  return (int_t)ll_sparse_tensor_t::make_feature_id(item.group_id,
+                                                    id_dist(engine));
+}
+
+std::vector<features_t> MakeRequest(const std::vector<GroupConfigItem>& items,
+                                    std::default_random_engine& engine) {
+  std::uniform_real_distribution<float> value_dist(0, 1);
+  std::vector<features_t> batch_features(FLAGS_batch);
+  for (features_t& features : batch_features) {
+    for (size_t i = 0; i < items.size(); ++i) {
+      features.emplace_back(RandomId(items, engine), value_dist(engine));
+    }
+  }
+  return batch_features;
+}
+
+// Whether the SRM 'name' holds ids of 'group_id'.
+// SRMs of groups are named like "quadW1", shared ones like "quadW".
+bool HasGroup(const std::string& name, uint16_t group_id) {
+  std::string suffix = "W" + std::to_string(group_id);
+  return (name.size() > suffix.size() &&
+          name.compare(name.size() - suffix.size(), suffix.size(), suffix) ==
+              0) ||
+         name.back() == 'W';
+}
+
+// Save a model with all rows of 'items'.
+void SaveModel(const Graph& graph, const std::vector<GroupConfigItem>& items,
+               const std::string& file) {
+  std::default_random_engine engine;
+  Model model;
+  model.Init(&graph);
+  DXCHECK_THROW(model.InitParam(engine));
+  model.ForEachSRM([&engine, &items](const std::string& name, srm_t* W) {
+    for (const GroupConfigItem& item : items) {
+      if (HasGroup(name, item.group_id)) {
+        for (int i = 0; i < item.embedding_row; ++i) {
+          W->get_row(engine, (int_t)ll_sparse_tensor_t::make_feature_id(
+                                 item.group_id, (int_t)i));
+        }
+      }
+    }
+  });
+  DXCHECK_THROW(model.Save(file));
+}
+
+// Save the k-th delta, which changes rows of 'request_ids' to pattern k % 2
+// and 'FLAGS_delta_id' other random rows.
+// Return # of changed rows.
+size_t SaveDelta(const Graph& graph, const Model& base,
+                 const std::vector<GroupConfigItem>& items,
+                 const std::unordered_set<int_t>& request_ids, int k,
+                 const std::string& file) {
+  std::default_random_engine engine(k);
+  std::uniform_real_distribution<float_t> value_dist(-0.1, 0.1);
+  std::vector<int_t> ids(request_ids.begin(), request_ids.end());
+  while ((int)ids.size() < FLAGS_delta_id) {
+    int_t id = RandomId(items, engine);
+    if (request_ids.count(id) == 0) {
+      ids.emplace_back(id);
+    }
+  }
+
+  Model delta;
+  delta.Init(&graph);
+  DXCHECK_THROW(delta.InitParamPlaceholder());
+  size_t rows = 0;
+  for (auto& entry : *delta.mutable_param()) {
+    const std::string& name = entry.first;
+    Any& Wany = entry.second;
+    if (Wany.is<tsr_t>()) {
+      Wany.unsafe_to_ref<tsr_t>().set_data(base.param().get<tsr_t>(name));
+    } else if (Wany.is<srm_t>()) {
+      auto& W = Wany.unsafe_to_ref<srm_t>();
+      for (int_t id : ids) {
+        if (!HasGroup(name, ll_sparse_tensor_t::get_group_id(id))) {
+          continue;
+        }
+        float_t* row = W.get_row_no_init(id);
+        for (int j = 0; j < W.col(); ++j) {
+          if (request_ids.count(id) > 0) {
+            row[j] = (k % 2 == 0) ? (float_t)0.05 : (float_t)-0.05;
+          } else {
+            row[j] = value_dist(engine);
+          }
+        }
+      }
+      rows += W.size();
+    }
+  }
+  DXCHECK_THROW(FeatureKVUtil::SaveModel(file, graph, delta.param(), 2));
+  return rows;
+}
+
+bool Match(const batch_probs_t& probs, const batch_probs_t& expected) {
+  if (probs.size() != expected.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < probs.size(); ++i) {
+    if (probs[i].size() != expected[i].size()) {
+      return false;
+    }
+    for (size_t j = 0; j < probs[i].size(); ++j) {
+      if (std::fabs(probs[i][j] - expected[i][j]) > 1e-4) {  // magic number
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(FLAGS_thread > 0);
+  DXCHECK_THROW(FLAGS_batch > 0);
+  DXCHECK_THROW(FLAGS_delta > 2);
+  DXCHECK_THROW(FLAGS_delta_id > 0);
+
+  std::unique_ptr<ModelZoo> model_zoo(NewModelZoo(FLAGS_model));
+  DXCHECK_THROW(model_zoo);
+  StringMap config;
+  config["group_config"] = FLAGS_group_config;
+  config["sparse"] = "1";
+  Graph graph;
+  DXCHECK_THROW(model_zoo->InitConfig(config));
+  DXCHECK_THROW(model_zoo->InitGraph(&graph));
+
+  std::vector<GroupConfigItem> items;
+  DXCHECK_THROW(GuessGroupConfig(FLAGS_group_config, &items, nullptr));
+  std::default_random_engine engine;
+  std::vector<features_t> request = MakeRequest(items, engine);
+  std::unordered_set<int_t> request_ids;
+  for (const features_t& features : request) {
+    for (const feature_t& feature : features) {
+      request_ids.emplace((int_t)feature.first);
+    }
+  }
+
+  std::string graph_file = FLAGS_dir + "/model_server_delta_bench.graph";
+  std::string model_file = FLAGS_dir + "/model_server_delta_bench.model";
+  DXCHECK_THROW(graph.Save(graph_file));
+  SaveModel(graph, items, model_file);
+  Model base;
+  base.Init(&graph);
+  DXCHECK_THROW(base.Load(model_file));
+  std::vector<std::string> delta_files(FLAGS_delta);
+  std::vector<size_t> delta_rows(FLAGS_delta);
+  for (int k = 0; k < FLAGS_delta; ++k) {
+    delta_files[k] =
+        FLAGS_dir + "/model_server_delta_bench.delta." + std::to_string(k);
+    delta_rows[k] =
+        SaveDelta(graph, base, items, request_ids, k, delta_files[k]);
+  }
+
+  ModelServer model_server;
+  batch_probs_t expected[2];
+  DXCHECK_THROW(model_server.LoadGraph(graph_file));
+  DXCHECK_THROW(model_server.LoadModel(model_file));
+  for (int k = 0; k < 2; ++k) {
+    DXCHECK_THROW(model_server.ApplyDelta(delta_files[k]));
+    DXCHECK_THROW(model_server.BatchPredict(request, &expected[k]));
+  }
+  DXCHECK_THROW(!Match(expected[0], expected[1]));
+
+  std::atomic<int> stop{0};
+  std::atomic<int> error{0};
+  std::vector<std::vector<double>> latencies(FLAGS_thread);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < FLAGS_thread; ++i) {
+    threads.emplace_back([&, i]() {
+      auto op_context = model_server.NewOpContext();
+      auto predict_plan = model_server.NewPredictPlan(FLAGS_batch);
+      DXCHECK_THROW(op_context && predict_plan);
+      batch_probs_t probs;
+      while (!stop) {
+        auto begin = steady_clock_t::now();
+        bool ok;
+        switch (i % 3) {
+          case 0:
+            ok = model_server.BatchPredict(request, &probs);
+            break;
+          case 1:
+            ok = model_server.BatchPredict(op_context.get(), request, &probs);
+            break;
+          default:
+            ok = model_server.BatchPredict(predict_plan.get(), request,
+                                           &probs);
+            break;
+        }
+        latencies[i].emplace_back(ToMillisecond(steady_clock_t::now() - begin));
+        if (!ok || (!Match(probs, expected[0]) && !Match(probs, expected[1]))) {
+          ++error;
+        }
+      }
+    });
+  }
+
+  std::vector<double> apply_latency;
+  size_t rows = 0;
+  auto begin = steady_clock_t::now();
+  for (int k = 2; k < FLAGS_delta; ++k) {
+    auto apply_begin = steady_clock_t::now();
+    DXCHECK_THROW(model_server.ApplyDelta(delta_files[k]));
+    apply_latency.emplace_back(
+        ToMillisecond(steady_clock_t::now() - apply_begin));
+    rows += delta_rows[k];
+  }
+  stop = 1;
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  double second = ToMillisecond(steady_clock_t::now() - begin) / 1e3;
+
+  double apply_second = 0;
+  for (double l : apply_latency) {
+    apply_second += l / 1e3;
+  }
+  std::vector<double> latency;
+  for (const std::vector<double>& l : latencies) {
+    latency.insert(latency.end(), l.begin(), l.end());
+  }
+  std::sort(latency.begin(), latency.end());
+  std::sort(apply_latency.begin(), apply_latency.end());
+  DXINFO(
+      "predictions=%zu, errors=%d, qps=%.0f, p50=%.3fms, p99=%.3fms, "
+      "max=%.3fms.",
+      latency.size(), (int)error, latency.size() / second,
+      latency[latency.size() / 2], latency[latency.size() * 99 / 100],
+      latency.back());
+  DXINFO(
+      "deltas=%zu, rows=%zu, rows/s=%.0f, apply p50=%.1fms, "
+      "apply max=%.1fms.",
+      apply_latency.size(), rows, rows / apply_second,
+      apply_latency[apply_latency.size() / 2], apply_latency.back());
+  DXCHECK_THROW(error == 0);
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
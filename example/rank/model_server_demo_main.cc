@@ -14,6 +14,8 @@
 DEFINE_string(in, "", "input file");
 DEFINE_string(in_graph, "", "input graph file");
 DEFINE_string(in_model, "", "input model param file");
+DEFINE_string(in_mapped_model, "",
+              "input mapped model file, instead of --in_model");
 
 namespace deepx_core {
 namespace {
@@ -39,9 +41,13 @@ int main(int argc, char** argv) {
     DXCHECK_THROW(model_server.Load(FLAGS_in));
   } else {
     DXCHECK_THROW(!FLAGS_in_graph.empty());
-    DXCHECK_THROW(!FLAGS_in_model.empty());
     DXCHECK_THROW(model_server.LoadGraph(FLAGS_in_graph));
-    DXCHECK_THROW(model_server.LoadModel(FLAGS_in_model));
+    if (!FLAGS_in_mapped_model.empty()) {
+      DXCHECK_THROW(model_server.LoadMappedModel(FLAGS_in_mapped_model));
+    } else {
+      DXCHECK_THROW(!FLAGS_in_model.empty());
+      DXCHECK_THROW(model_server.LoadModel(FLAGS_in_model));
+    }
   }
 
   auto op_context = model_server.NewOpContext();
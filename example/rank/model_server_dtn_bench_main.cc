@@ -0,0 +1,197 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Benchmark of DTNBatchPredict with precomputed item towers and cached
+// user towers.
+//
+// Each request ranks '--candidate' items of a catalog for a user,
+// by the full graph and by precomputed tower outputs.
+// Their probabilities must match.
+//
+
+#include <deepx_core/common/group_config.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "model_server.h"
+#include "model_zoo.h"
+
+DEFINE_string(user_group_config, "1:10000:16,2:10000:16",
+              "user group config");
+DEFINE_string(item_group_config, "3:100000:16,4:100000:16",
+              "item group config");
+DEFINE_string(dir, "/tmp", "directory of temporary graph and model files");
+DEFINE_int32(item, 10000, "# of items of the catalog");
+DEFINE_int32(user, 100, "# of users");
+DEFINE_int32(candidate, 1000, "# of candidate items per request");
+DEFINE_int32(request, 200, "# of requests");
+
+namespace deepx_core {
+namespace {
+
+using int_t = DataType::int_t;
+using srm_t = DataType::srm_t;
+using ll_sparse_tensor_t = DataType::ll_sparse_tensor_t;
+using steady_clock_t = std::chrono::steady_clock;
+using batch_probs_t = std::vector<std::vector<float>>;
+
+double ToMillisecond(steady_clock_t::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+features_t MakeFeatures(const std::vector<GroupConfigItem>& items,
+                        std::default_random_engine& engine) {
+  std::uniform_real_distribution<float> value_dist(0, 1);
+  features_t features;
+  for (const GroupConfigItem& item : items) {
+    std::uniform_int_distribution<int_t> id_dist(
+        0, (int_t)item.embedding_row - 1);
+    features.emplace_back(
+        ll_sparse_tensor_t::make_feature_id(item.group_id, id_dist(engine)),
+        value_dist(engine));
+  }
+  return features;
+}
+
+// Save a model with all rows of 'items'.
+void SaveModel(const Graph& graph, const std::vector<GroupConfigItem>& items,
+               const std::string& file) {
+  std::default_random_engine engine;
+  Model model;
+  model.Init(&graph);
+  DXCHECK_THROW(model.InitParam(engine));
+  model.ForEachSRM([&engine, &items](const std::string&, srm_t* W) {
+    for (const GroupConfigItem& item : items) {
+      for (int i = 0; i < item.embedding_row; ++i) {
+        W->get_row(engine, (int_t)ll_sparse_tensor_t::make_feature_id(
+                               item.group_id, (int_t)i));
+      }
+    }
+  });
+  DXCHECK_THROW(model.Save(file));
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(FLAGS_item > 0);
+  DXCHECK_THROW(FLAGS_user > 0);
+  DXCHECK_THROW(FLAGS_candidate > 0 && FLAGS_candidate <= FLAGS_item);
+  DXCHECK_THROW(FLAGS_request > 0);
+
+  std::unique_ptr<ModelZoo> model_zoo(NewModelZoo("dtn"));
+  DXCHECK_THROW(model_zoo);
+  StringMap config;
+  config["user_group_config"] = FLAGS_user_group_config;
+  config["item_group_config"] = FLAGS_item_group_config;
+  config["sparse"] = "1";
+  Graph graph;
+  DXCHECK_THROW(model_zoo->InitConfig(config));
+  DXCHECK_THROW(model_zoo->InitGraph(&graph));
+
+  std::vector<GroupConfigItem> user_items, item_items, items;
+  DXCHECK_THROW(
+      GuessGroupConfig(FLAGS_user_group_config, &user_items, nullptr));
+  DXCHECK_THROW(
+      GuessGroupConfig(FLAGS_item_group_config, &item_items, nullptr));
+  items = user_items;
+  items.insert(items.end(), item_items.begin(), item_items.end());
+  std::string graph_file = FLAGS_dir + "/model_server_dtn_bench.graph";
+  std::string model_file = FLAGS_dir + "/model_server_dtn_bench.model";
+  DXCHECK_THROW(graph.Save(graph_file));
+  SaveModel(graph, items, model_file);
+
+  ModelServer model_server;
+  DXCHECK_THROW(model_server.LoadGraph(graph_file));
+  DXCHECK_THROW(model_server.LoadModel(model_file));
+
+  std::default_random_engine engine;
+  std::vector<uint64_t> item_ids(FLAGS_item);
+  std::vector<features_t> item_features(FLAGS_item);
+  for (int i = 0; i < FLAGS_item; ++i) {
+    item_ids[i] = (uint64_t)i;
+    item_features[i] = MakeFeatures(item_items, engine);
+  }
+  std::vector<features_t> user_features(FLAGS_user);
+  for (features_t& features : user_features) {
+    features = MakeFeatures(user_items, engine);
+  }
+
+  auto begin = steady_clock_t::now();
+  DXCHECK_THROW(model_server.DTNSetItems(item_ids, item_features));
+  double precompute_ms = ToMillisecond(steady_clock_t::now() - begin);
+
+  std::uniform_int_distribution<int> user_dist(0, FLAGS_user - 1);
+  std::vector<uint64_t> candidate_ids(item_ids);
+  std::vector<features_t> candidate_features(FLAGS_candidate);
+  ModelServer::predict_plan_ptr_t plan =
+      model_server.NewPredictPlan(FLAGS_candidate);
+  DXCHECK_THROW(plan);
+  batch_probs_t probs, plan_probs, expected;
+  double full_ms = 0, tower_ms = 0, plan_ms = 0, max_delta = 0;
+  for (int k = 0; k < FLAGS_request; ++k) {
+    int user = user_dist(engine);
+    std::shuffle(candidate_ids.begin(), candidate_ids.end(), engine);
+    candidate_ids.resize(FLAGS_candidate);
+    for (int i = 0; i < FLAGS_candidate; ++i) {
+      candidate_features[i] = item_features[candidate_ids[i]];
+    }
+
+    begin = steady_clock_t::now();
+    DXCHECK_THROW(model_server.DTNBatchPredict(
+        user_features[user], candidate_features, &expected));
+    full_ms += ToMillisecond(steady_clock_t::now() - begin);
+
+    begin = steady_clock_t::now();
+    DXCHECK_THROW(model_server.DTNBatchPredict(
+        (uint64_t)user, user_features[user], candidate_ids, &probs));
+    tower_ms += ToMillisecond(steady_clock_t::now() - begin);
+
+    begin = steady_clock_t::now();
+    DXCHECK_THROW(model_server.DTNBatchPredict(
+        plan.get(), user_features[user], candidate_features, &plan_probs));
+    plan_ms += ToMillisecond(steady_clock_t::now() - begin);
+
+    DXCHECK_THROW(probs.size() == expected.size());
+    DXCHECK_THROW(plan_probs.size() == expected.size());
+    for (size_t i = 0; i < probs.size(); ++i) {
+      max_delta =
+          std::max(max_delta, (double)std::fabs(probs[i][0] - expected[i][0]));
+      max_delta = std::max(
+          max_delta, (double)std::fabs(plan_probs[i][0] - expected[i][0]));
+    }
+    candidate_ids = item_ids;
+  }
+
+  DXINFO("items=%d, precompute=%.1fms.", FLAGS_item, precompute_ms);
+  DXINFO(
+      "users=%d, candidates=%d, full graph=%.3fms, towers=%.3fms(%.1fx), "
+      "plan=%.3fms(%.1fx), max delta=%.2e.",
+      FLAGS_user, FLAGS_candidate, full_ms / FLAGS_request,
+      tower_ms / FLAGS_request, full_ms / tower_ms, plan_ms / FLAGS_request,
+      full_ms / plan_ms, max_delta);
+  DXCHECK_THROW(max_delta < 1e-5);  // magic number
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
@@ -0,0 +1,210 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Benchmark of DTNTopK over a synthetic item catalog.
+//
+// Each request retrieves top '--k' items of the catalog for a user,
+// exactly and with each '--nprobe' of an index of '--index_list' lists.
+// Recalls are measured against the exact top items.
+//
+// Cover 10^7 items with
+// '--item=10000000 --deep_dims=16 --index_list=4096'.
+//
+
+#include <deepx_core/common/group_config.h>
+#include <deepx_core/common/str_util.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gflags/gflags.h>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "model_server.h"
+#include "model_zoo.h"
+
+DEFINE_string(user_group_config, "1:10000:16,2:10000:16",
+              "user group config");
+DEFINE_string(item_group_config, "3:100000:16,4:100000:16",
+              "item group config");
+DEFINE_string(deep_dims, "64,32", "deep dims of the interaction");
+DEFINE_string(dir, "/tmp", "directory of temporary graph and model files");
+DEFINE_int32(item, 1000000, "# of items of the catalog");
+DEFINE_int32(index_list, 1024, "# of lists of the index");
+DEFINE_string(nprobe, "1,4,16,64", "comma separated # of probed lists");
+DEFINE_int32(k, 100, "# of retrieved items");
+DEFINE_int32(user, 100, "# of users");
+DEFINE_int32(request, 20, "# of requests");
+
+namespace deepx_core {
+namespace {
+
+using int_t = DataType::int_t;
+using srm_t = DataType::srm_t;
+using ll_sparse_tensor_t = DataType::ll_sparse_tensor_t;
+using steady_clock_t = std::chrono::steady_clock;
+using top_items_t = std::vector<std::pair<uint64_t, float>>;
+
+double ToMillisecond(steady_clock_t::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+features_t MakeFeatures(const std::vector<GroupConfigItem>& items,
+                        std::default_random_engine& engine) {
+  std::uniform_real_distribution<float> value_dist(0, 1);
+  features_t features;
+  for (const GroupConfigItem& item : items) {
+    std::uniform_int_distribution<int_t> id_dist(
+        0, (int_t)item.embedding_row - 1);
+    features.emplace_back(
+        ll_sparse_tensor_t::make_feature_id(item.group_id, id_dist(engine)),
+        value_dist(engine));
+  }
+  return features;
+}
+
+// Save a model with all rows of 'items'.
+void SaveModel(const Graph& graph, const std::vector<GroupConfigItem>& items,
+               const std::string& file) {
+  std::default_random_engine engine;
+  Model model;
+  model.Init(&graph);
+  DXCHECK_THROW(model.InitParam(engine));
+  model.ForEachSRM([&engine, &items](const std::string&, srm_t* W) {
+    for (const GroupConfigItem& item : items) {
+      for (int i = 0; i < item.embedding_row; ++i) {
+        W->get_row(engine, (int_t)ll_sparse_tensor_t::make_feature_id(
+                               item.group_id, (int_t)i));
+      }
+    }
+  });
+  DXCHECK_THROW(model.Save(file));
+}
+
+double Recall(const top_items_t& top_items, const top_items_t& expected) {
+  std::unordered_set<uint64_t> expected_ids;
+  for (const auto& entry : expected) {
+    expected_ids.emplace(entry.first);
+  }
+  int hit = 0;
+  for (const auto& entry : top_items) {
+    hit += (int)expected_ids.count(entry.first);
+  }
+  return (double)hit / expected.size();
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::vector<int> nprobes;
+  DXCHECK_THROW(Split<int>(FLAGS_nprobe, ",", &nprobes));
+  DXCHECK_THROW(FLAGS_item > 0);
+  DXCHECK_THROW(FLAGS_index_list > 0);
+  DXCHECK_THROW(FLAGS_k > 0 && FLAGS_k <= FLAGS_item);
+  DXCHECK_THROW(FLAGS_user > 0);
+  DXCHECK_THROW(FLAGS_request > 0);
+
+  std::unique_ptr<ModelZoo> model_zoo(NewModelZoo("dtn"));
+  DXCHECK_THROW(model_zoo);
+  StringMap config;
+  config["user_group_config"] = FLAGS_user_group_config;
+  config["item_group_config"] = FLAGS_item_group_config;
+  config["deep_dims"] = FLAGS_deep_dims;
+  config["sparse"] = "1";
+  Graph graph;
+  DXCHECK_THROW(model_zoo->InitConfig(config));
+  DXCHECK_THROW(model_zoo->InitGraph(&graph));
+
+  std::vector<GroupConfigItem> user_items, item_items, items;
+  DXCHECK_THROW(
+      GuessGroupConfig(FLAGS_user_group_config, &user_items, nullptr));
+  DXCHECK_THROW(
+      GuessGroupConfig(FLAGS_item_group_config, &item_items, nullptr));
+  items = user_items;
+  items.insert(items.end(), item_items.begin(), item_items.end());
+  std::string graph_file = FLAGS_dir + "/model_server_dtn_topk_bench.graph";
+  std::string model_file = FLAGS_dir + "/model_server_dtn_topk_bench.model";
+  DXCHECK_THROW(graph.Save(graph_file));
+  SaveModel(graph, items, model_file);
+
+  ModelServer model_server;
+  DXCHECK_THROW(model_server.LoadGraph(graph_file));
+  DXCHECK_THROW(model_server.LoadModel(model_file));
+
+  std::default_random_engine engine;
+  std::vector<features_t> user_features(FLAGS_user);
+  for (features_t& features : user_features) {
+    features = MakeFeatures(user_items, engine);
+  }
+
+  double index_ms;
+  {
+    std::vector<uint64_t> item_ids(FLAGS_item);
+    std::vector<features_t> item_features(FLAGS_item);
+    for (int i = 0; i < FLAGS_item; ++i) {
+      item_ids[i] = (uint64_t)i;
+      item_features[i] = MakeFeatures(item_items, engine);
+    }
+    auto begin = steady_clock_t::now();
+    DXCHECK_THROW(
+        model_server.DTNSetItems(item_ids, item_features, FLAGS_index_list));
+    index_ms = ToMillisecond(steady_clock_t::now() - begin);
+  }
+  DXINFO("items=%d, lists=%d, precompute and index=%.1fms.", FLAGS_item,
+         FLAGS_index_list, index_ms);
+
+  std::uniform_int_distribution<int> user_dist(0, FLAGS_user - 1);
+  std::vector<int> users(FLAGS_request);
+  for (int& user : users) {
+    user = user_dist(engine);
+  }
+
+  std::vector<top_items_t> expected(FLAGS_request);
+  double exact_ms = 0;
+  for (int i = 0; i < FLAGS_request; ++i) {
+    auto begin = steady_clock_t::now();
+    DXCHECK_THROW(model_server.DTNTopK((uint64_t)users[i],
+                                       user_features[users[i]], FLAGS_k, 0,
+                                       &expected[i]));
+    exact_ms += ToMillisecond(steady_clock_t::now() - begin);
+    DXCHECK_THROW((int)expected[i].size() == FLAGS_k);
+  }
+  exact_ms /= FLAGS_request;
+  DXINFO("exact: %.3fms, qps=%.1f.", exact_ms, 1e3 / exact_ms);
+
+  top_items_t top_items;
+  for (int nprobe : nprobes) {
+    double ms = 0, recall = 0;
+    for (int i = 0; i < FLAGS_request; ++i) {
+      auto begin = steady_clock_t::now();
+      DXCHECK_THROW(model_server.DTNTopK((uint64_t)users[i],
+                                         user_features[users[i]], FLAGS_k,
+                                         nprobe, &top_items));
+      ms += ToMillisecond(steady_clock_t::now() - begin);
+      recall += Recall(top_items, expected[i]);
+    }
+    ms /= FLAGS_request;
+    recall /= FLAGS_request;
+    DXINFO("nprobe=%d: %.3fms, qps=%.1f(%.1fx), recall@%d=%.4f.", nprobe, ms,
+           1e3 / ms, exact_ms / ms, FLAGS_k, recall);
+  }
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
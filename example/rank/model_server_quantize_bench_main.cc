@@ -0,0 +1,235 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Benchmark of quantized models on ModelServer.
+//
+// For each model of the model zoo, a float model is quantized to int8 and
+// fp16 with 'ModelQuantizer'.
+// Each model is served by a ModelServer,
+// accuracy deltas of probabilities against the float model are reported
+// next to bytes of values and latencies.
+//
+
+#include <deepx_core/common/group_config.h>
+#include <deepx_core/common/str_util.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/graph/model_quantizer.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "model_server.h"
+#include "model_zoo.h"
+
+DEFINE_string(model, "lr,fm,deep_fm,wnd,dcn,xdeep_fm,auto_int",
+              "comma separated model names");
+DEFINE_string(group_config, "1:10000:8,2:10000:8,3:10000:8,4:10000:8",
+              "group config");
+DEFINE_int32(sparse, 1, "use SRMs(1) or TSRs(0) for embeddings");
+DEFINE_string(dir, "/tmp", "directory of temporary graph and model files");
+DEFINE_int32(batch, 64, "batch size");
+DEFINE_int32(request, 200, "# of requests");
+
+namespace deepx_core {
+namespace {
+
+using float_t = DataType::float_t;
+using int_t = DataType::int_t;
+using srm_t = DataType::srm_t;
+using ll_sparse_tensor_t = DataType::ll_sparse_tensor_t;
+using steady_clock_t = std::chrono::steady_clock;
+using batch_probs_t = std::vector<std::vector<float>>;
+
+double ToMillisecond(steady_clock_t::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+std::vector<features_t> MakeRequest(const std::vector<GroupConfigItem>& items,
+                                    std::default_random_engine& engine) {
+  std::uniform_real_distribution<float> value_dist(0, 1);
+  std::vector<features_t> batch_features(FLAGS_batch);
+  for (features_t& features : batch_features) {
+    for (const GroupConfigItem& item : items) {
+      std::uniform_int_distribution<int_t> id_dist(
+          0, (int_t)item.embedding_row - 1);
+      features.emplace_back(
+          (int_t)ll_sparse_tensor_t::make_feature_id(item.group_id,
+                                                     id_dist(engine)),
+          value_dist(engine));
+    }
+  }
+  return batch_features;
+}
+
+// Whether the SRM 'name' holds ids of 'group_id'.
+// SRMs of groups are named like "quadW1", shared ones like "quadW".
+bool HasGroup(const std::string& name, uint16_t group_id) {
+  std::string suffix = "W" + std::to_string(group_id);
+  return (name.size() > suffix.size() &&
+          name.compare(name.size() - suffix.size(), suffix.size(), suffix) ==
+              0) ||
+         name.back() == 'W';
+}
+
+// Initialize a model with all rows of 'items'.
+void InitModel(const std::vector<GroupConfigItem>& items, Model* model) {
+  std::default_random_engine engine;
+  DXCHECK_THROW(model->InitParam(engine));
+  model->ForEachSRM([&engine, &items](const std::string& name, srm_t* W) {
+    for (const GroupConfigItem& item : items) {
+      if (HasGroup(name, item.group_id)) {
+        for (int i = 0; i < item.embedding_row; ++i) {
+          W->get_row(engine, (int_t)ll_sparse_tensor_t::make_feature_id(
+                                 item.group_id, (int_t)i));
+        }
+      }
+    }
+  });
+}
+
+struct Result {
+  size_t bytes = 0;
+  double latency = 0;  // ms per request
+  double mean_delta = 0;
+  double max_delta = 0;
+};
+
+Result Serve(const std::string& graph_file, const std::string& model_file,
+             const std::vector<std::vector<features_t>>& requests,
+             const std::vector<batch_probs_t>* expected,
+             std::vector<batch_probs_t>* probs) {
+  ModelServer model_server;
+  DXCHECK_THROW(model_server.LoadGraph(graph_file));
+  DXCHECK_THROW(model_server.LoadModel(model_file));
+
+  Result result;
+  Model model;
+  Graph graph;
+  DXCHECK_THROW(graph.Load(graph_file));
+  model.Init(&graph);
+  DXCHECK_THROW(model.Load(model_file));
+  result.bytes = ModelQuantizer::GetValueBytes(model.param());
+
+  // warm up
+  probs->resize(requests.size());
+  DXCHECK_THROW(model_server.BatchPredict(requests[0], &(*probs)[0]));
+  auto begin = steady_clock_t::now();
+  for (size_t i = 0; i < requests.size(); ++i) {
+    DXCHECK_THROW(model_server.BatchPredict(requests[i], &(*probs)[i]));
+  }
+  result.latency =
+      ToMillisecond(steady_clock_t::now() - begin) / requests.size();
+
+  if (expected) {
+    size_t n = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+      const batch_probs_t& p = (*probs)[i];
+      const batch_probs_t& e = (*expected)[i];
+      DXCHECK_THROW(p.size() == e.size());
+      for (size_t j = 0; j < p.size(); ++j) {
+        for (size_t k = 0; k < p[j].size(); ++k) {
+          double delta = std::fabs(p[j][k] - e[j][k]);
+          result.mean_delta += delta;
+          result.max_delta = std::max(result.max_delta, delta);
+          ++n;
+        }
+      }
+    }
+    result.mean_delta /= n;
+  }
+  return result;
+}
+
+void Bench(const std::string& model_name,
+           const std::vector<GroupConfigItem>& items) {
+  std::unique_ptr<ModelZoo> model_zoo(NewModelZoo(model_name));
+  DXCHECK_THROW(model_zoo);
+  StringMap config;
+  config["group_config"] = FLAGS_group_config;
+  config["sparse"] = std::to_string(FLAGS_sparse);
+  Graph graph;
+  DXCHECK_THROW(model_zoo->InitConfig(config));
+  DXCHECK_THROW(model_zoo->InitGraph(&graph));
+
+  std::string prefix = FLAGS_dir + "/model_server_quantize_bench";
+  std::string graph_file = prefix + ".graph";
+  std::string model_files[3] = {prefix + ".model", prefix + ".int8",
+                                prefix + ".fp16"};
+  const int dtypes[2] = {TENSOR_DTYPE_INT8, TENSOR_DTYPE_FLOAT16};
+  DXCHECK_THROW(graph.Save(graph_file));
+  Model model;
+  model.Init(&graph);
+  InitModel(items, &model);
+  DXCHECK_THROW(model.Save(model_files[0]));
+  for (int i = 0; i < 2; ++i) {
+    ModelQuantizer quantizer;
+    quantizer.Init(&graph, dtypes[i]);
+    Model quantized_model;
+    quantized_model.Init(&graph);
+    DXCHECK_THROW(
+        quantizer.Quantize(model.param(), quantized_model.mutable_param()));
+    DXCHECK_THROW(quantized_model.Save(model_files[i + 1]));
+  }
+
+  std::default_random_engine engine;
+  std::vector<std::vector<features_t>> requests(FLAGS_request);
+  for (std::vector<features_t>& request : requests) {
+    request = MakeRequest(items, engine);
+  }
+
+  std::vector<batch_probs_t> expected, probs;
+  Result results[3];
+  results[0] = Serve(graph_file, model_files[0], requests, nullptr, &expected);
+  for (int i = 1; i < 3; ++i) {
+    results[i] =
+        Serve(graph_file, model_files[i], requests, &expected, &probs);
+  }
+
+  const char* dtype_names[3] = {"float", "int8", "fp16"};
+  for (int i = 0; i < 3; ++i) {
+    const Result& result = results[i];
+    DXINFO(
+        "%s %s: bytes=%zu(%.2fx), latency=%.3fms(%.2fx), "
+        "mean delta=%.2e, max delta=%.2e.",
+        model_name.c_str(), dtype_names[i], result.bytes,
+        (double)results[0].bytes / result.bytes, result.latency,
+        results[0].latency / result.latency, result.mean_delta,
+        result.max_delta);
+  }
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(FLAGS_batch > 0);
+  DXCHECK_THROW(FLAGS_request > 0);
+
+  std::vector<std::string> model_names;
+  Split(FLAGS_model, ",", &model_names);
+  std::vector<GroupConfigItem> items;
+  DXCHECK_THROW(GuessGroupConfig(FLAGS_group_config, &items, nullptr));
+  for (const std::string& model_name : model_names) {
+    Bench(model_name, items);
+  }
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
@@ -0,0 +1,219 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Stress test of hot model swaps of ModelServer.
+//
+// Two versions of a model are swapped again and again,
+// while threads keep predicting with stateless calls, OpContext and
+// PredictPlan.
+// Each prediction must match one version entirely.
+//
+
+#include <deepx_core/common/group_config.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "model_server.h"
+#include "model_zoo.h"
+
+DEFINE_string(model, "deep_fm", "model name");
+DEFINE_string(group_config, "1:1000:8,2:1000:8,3:1000:8,4:1000:8",
+              "group config");
+DEFINE_string(dir, "/tmp", "directory of temporary graph and model files");
+DEFINE_int32(thread, 6, "# of predicting threads");
+DEFINE_int32(batch, 16, "batch size");
+DEFINE_int32(swap, 20, "# of swaps");
+DEFINE_int32(swap_interval, 50, "interval between swaps in ms");
+
+namespace deepx_core {
+namespace {
+
+using float_t = DataType::float_t;
+using int_t = DataType::int_t;
+using srm_t = DataType::srm_t;
+using ll_sparse_tensor_t = DataType::ll_sparse_tensor_t;
+using steady_clock_t = std::chrono::steady_clock;
+using batch_probs_t = std::vector<std::vector<float>>;
+
+double ToMillisecond(steady_clock_t::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+std::vector<features_t> MakeRequest(const std::vector<GroupConfigItem>& items,
+                                    std::default_random_engine& engine) {
+  std::uniform_real_distribution<float> value_dist(0, 1);
+  std::vector<features_t> batch_features(FLAGS_batch);
+  for (features_t& features : batch_features) {
+    for (const GroupConfigItem& item : items) {
+      std::uniform_int_distribution<int_t> id_dist(
+          0, (int_t)item.embedding_row - 1);
+      features.emplace_back(
+          ll_sparse_tensor_t::make_feature_id(item.group_id, id_dist(engine)),
+          value_dist(engine));
+    }
+  }
+  return batch_features;
+}
+
+// Save a model of 'graph', whose params are initialized by 'seed'.
+void SaveModel(const Graph& graph, const std::vector<features_t>& request,
+               unsigned seed, const std::string& file) {
+  std::default_random_engine engine(seed);
+  Model model;
+  model.Init(&graph);
+  DXCHECK_THROW(model.InitParam(engine));
+  model.ForEachSRM([&engine, &request](const std::string&, srm_t* W) {
+    for (const features_t& features : request) {
+      for (const feature_t& feature : features) {
+        W->get_row(engine, (int_t)feature.first);
+      }
+    }
+  });
+  DXCHECK_THROW(model.Save(file));
+}
+
+bool Match(const batch_probs_t& probs, const batch_probs_t& expected) {
+  if (probs.size() != expected.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < probs.size(); ++i) {
+    if (probs[i].size() != expected[i].size()) {
+      return false;
+    }
+    for (size_t j = 0; j < probs[i].size(); ++j) {
+      if (std::fabs(probs[i][j] - expected[i][j]) > 1e-4) {  // magic number
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(FLAGS_thread > 0);
+  DXCHECK_THROW(FLAGS_batch > 0);
+  DXCHECK_THROW(FLAGS_swap > 0);
+  DXCHECK_THROW(FLAGS_swap_interval >= 0);
+
+  std::unique_ptr<ModelZoo> model_zoo(NewModelZoo(FLAGS_model));
+  DXCHECK_THROW(model_zoo);
+  StringMap config;
+  config["group_config"] = FLAGS_group_config;
+  Graph graph;
+  DXCHECK_THROW(model_zoo->InitConfig(config));
+  DXCHECK_THROW(model_zoo->InitGraph(&graph));
+
+  std::vector<GroupConfigItem> items;
+  DXCHECK_THROW(GuessGroupConfig(FLAGS_group_config, &items, nullptr));
+  std::default_random_engine engine;
+  std::vector<features_t> request = MakeRequest(items, engine);
+
+  std::string graph_file = FLAGS_dir + "/model_server_stress.graph";
+  std::string model_files[2] = {FLAGS_dir + "/model_server_stress.model.0",
+                                FLAGS_dir + "/model_server_stress.model.1"};
+  DXCHECK_THROW(graph.Save(graph_file));
+  SaveModel(graph, request, 1, model_files[0]);
+  SaveModel(graph, request, 2, model_files[1]);
+
+  ModelServer model_server;
+  batch_probs_t expected[2];
+  DXCHECK_THROW(model_server.LoadGraph(graph_file));
+  for (int k = 1; k >= 0; --k) {
+    DXCHECK_THROW(model_server.LoadModel(model_files[k]));
+    DXCHECK_THROW(model_server.BatchPredict(request, &expected[k]));
+  }
+  DXCHECK_THROW(!Match(expected[0], expected[1]));
+
+  std::atomic<int> stop{0};
+  std::atomic<int> error{0};
+  std::vector<std::vector<double>> latencies(FLAGS_thread);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < FLAGS_thread; ++i) {
+    threads.emplace_back([&, i]() {
+      auto op_context = model_server.NewOpContext();
+      auto predict_plan = model_server.NewPredictPlan(FLAGS_batch);
+      DXCHECK_THROW(op_context && predict_plan);
+      batch_probs_t probs;
+      while (!stop) {
+        auto begin = steady_clock_t::now();
+        bool ok;
+        switch (i % 3) {
+          case 0:
+            ok = model_server.BatchPredict(request, &probs);
+            break;
+          case 1:
+            ok = model_server.BatchPredict(op_context.get(), request, &probs);
+            break;
+          default:
+            ok = model_server.BatchPredict(predict_plan.get(), request,
+                                           &probs);
+            break;
+        }
+        latencies[i].emplace_back(ToMillisecond(steady_clock_t::now() - begin));
+        if (!ok || (!Match(probs, expected[0]) && !Match(probs, expected[1]))) {
+          ++error;
+        }
+      }
+    });
+  }
+
+  std::vector<double> swap_latency;
+  auto begin = steady_clock_t::now();
+  for (int k = 0; k < FLAGS_swap; ++k) {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(FLAGS_swap_interval));
+    auto swap_begin = steady_clock_t::now();
+    DXCHECK_THROW(model_server.LoadModel(model_files[(k + 1) % 2]));
+    swap_latency.emplace_back(
+        ToMillisecond(steady_clock_t::now() - swap_begin));
+  }
+  stop = 1;
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  double second = ToMillisecond(steady_clock_t::now() - begin) / 1e3;
+
+  std::vector<double> latency;
+  for (const std::vector<double>& l : latencies) {
+    latency.insert(latency.end(), l.begin(), l.end());
+  }
+  std::sort(latency.begin(), latency.end());
+  std::sort(swap_latency.begin(), swap_latency.end());
+  DXINFO(
+      "predictions=%zu, errors=%d, qps=%.0f, p50=%.3fms, p99=%.3fms, "
+      "max=%.3fms.",
+      latency.size(), (int)error, latency.size() / second,
+      latency[latency.size() / 2], latency[latency.size() * 99 / 100],
+      latency.back());
+  DXINFO("swaps=%d, versions=%llu, swap p50=%.1fms, swap max=%.1fms.",
+         FLAGS_swap, (unsigned long long)model_server.version(),  // NOLINT
+         swap_latency[swap_latency.size() / 2], swap_latency.back());
+  DXCHECK_THROW(error == 0);
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
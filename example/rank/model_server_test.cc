@@ -0,0 +1,264 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include "model_server.h"
+#include <deepx_core/common/group_config.h>
+#include <deepx_core/graph/feature_kv_util.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "model_zoo.h"
+
+namespace deepx_core {
+
+class ModelServerDTNTest : public testing::Test, public DataType {
+ protected:
+  static constexpr int ITEM = 200;
+  static constexpr int K = 10;
+  std::vector<GroupConfigItem> user_items;
+  std::vector<GroupConfigItem> item_items;
+  std::default_random_engine engine;
+  std::string graph_file = "model_server_test.graph";
+  std::string model_file = "model_server_test.model";
+  std::string delta_file = "model_server_test.delta";
+  ModelServer model_server;
+  std::vector<uint64_t> item_ids;
+  std::vector<features_t> item_features;
+  features_t user_features;
+
+ protected:
+  static features_t MakeFeatures(const std::vector<GroupConfigItem>& items,
+                                 std::default_random_engine& engine) {
+    std::uniform_int_distribution<int_t> id_dist(0, 99);
+    std::uniform_real_distribution<float> value_dist(0, 1);
+    features_t features;
+    for (const GroupConfigItem& item : items) {
+      features.emplace_back(ll_sparse_tensor_t::make_feature_id(
+                                item.group_id, id_dist(engine)),
+                            value_dist(engine));
+    }
+    return features;
+  }
+
+  // Save a graph of 'model_name' and a model with all rows of 'items'.
+  void SaveModel(const std::string& model_name, const StringMap& config,
+                 const std::vector<GroupConfigItem>& items) {
+    std::unique_ptr<ModelZoo> model_zoo(NewModelZoo(model_name));
+    ASSERT_TRUE(model_zoo);
+    ASSERT_TRUE(model_zoo->InitConfig(config));
+    Graph graph;
+    ASSERT_TRUE(model_zoo->InitGraph(&graph));
+    Model model;
+    model.Init(&graph);
+    ASSERT_TRUE(model.InitParam(engine));
+    model.ForEachSRM([this, &items](const std::string&, srm_t* W) {
+      for (const GroupConfigItem& item : items) {
+        for (int i = 0; i < item.embedding_row; ++i) {
+          W->get_row(engine, (int_t)ll_sparse_tensor_t::make_feature_id(
+                                 item.group_id, (int_t)i));
+        }
+      }
+    });
+    ASSERT_TRUE(graph.Save(graph_file));
+    ASSERT_TRUE(model.Save(model_file));
+    // All rows are changed by the delta.
+    ASSERT_TRUE(
+        FeatureKVUtil::SaveModel(delta_file, graph, model.param(), 2));
+  }
+
+  void SetUp() override {
+    StringMap config;
+    config["user_group_config"] = "1:100:4";
+    config["item_group_config"] = "2:100:4";
+    config["deep_dims"] = "8";
+    config["sparse"] = "1";
+    ASSERT_TRUE(GuessGroupConfig(config["user_group_config"], &user_items,
+                                 nullptr));
+    ASSERT_TRUE(GuessGroupConfig(config["item_group_config"], &item_items,
+                                 nullptr));
+    std::vector<GroupConfigItem> items = user_items;
+    items.insert(items.end(), item_items.begin(), item_items.end());
+    SaveModel("dtn", config, items);
+    ASSERT_TRUE(model_server.LoadGraph(graph_file));
+    ASSERT_TRUE(model_server.LoadModel(model_file));
+
+    for (int i = 0; i < ITEM; ++i) {
+      item_ids.emplace_back((uint64_t)i);
+      item_features.emplace_back(MakeFeatures(item_items, engine));
+    }
+    user_features = MakeFeatures(user_items, engine);
+  }
+
+  static void CheckProbs(const std::vector<std::vector<float>>& batch_probs,
+                         const std::vector<std::vector<float>>& expected) {
+    ASSERT_EQ(batch_probs.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      ASSERT_EQ(batch_probs[i].size(), expected[i].size());
+      for (size_t j = 0; j < expected[i].size(); ++j) {
+        EXPECT_NEAR(batch_probs[i][j], expected[i][j], 1e-5);
+      }
+    }
+  }
+
+  // Check the exact top items against predictions of the full graph.
+  void CheckTopK() const {
+    std::vector<std::vector<float>> batch_probs;
+    ASSERT_TRUE(model_server.DTNBatchPredict(user_features, item_features,
+                                             &batch_probs));
+    std::vector<float> expected;
+    for (const std::vector<float>& probs : batch_probs) {
+      expected.emplace_back(probs[0]);
+    }
+    std::sort(expected.begin(), expected.end(), std::greater<float>());
+
+    std::vector<std::pair<uint64_t, float>> top_items;
+    ASSERT_TRUE(model_server.DTNTopK(1, user_features, K, 0, &top_items));
+    ASSERT_EQ(top_items.size(), (size_t)K);
+    for (int i = 0; i < K; ++i) {
+      EXPECT_NEAR(top_items[i].second, expected[i], 1e-5);
+    }
+  }
+};
+
+constexpr int ModelServerDTNTest::ITEM;
+constexpr int ModelServerDTNTest::K;
+
+TEST_F(ModelServerDTNTest, DTNTopK) {
+  ASSERT_TRUE(model_server.DTNSetItems(item_ids, item_features, 4));
+  CheckTopK();
+
+  std::vector<std::pair<uint64_t, float>> top_items;
+  ASSERT_TRUE(model_server.DTNTopK(1, user_features, K, 2, &top_items));
+  EXPECT_LE(top_items.size(), (size_t)K);
+}
+
+TEST_F(ModelServerDTNTest, Publish) {
+  ASSERT_TRUE(model_server.DTNSetItems(item_ids, item_features, 4));
+  std::vector<std::pair<uint64_t, float>> top_items;
+
+  // Previous items are served until new ones are precomputed.
+  ASSERT_TRUE(model_server.LoadModel(model_file));
+  ASSERT_TRUE(model_server.DTNTopK(1, user_features, K, 2, &top_items));
+  ASSERT_TRUE(model_server.DTNWaitItems());
+  CheckTopK();
+
+  // Items are reassigned to lists of the previous centroids.
+  ASSERT_TRUE(model_server.ApplyDelta(delta_file));
+  ASSERT_TRUE(model_server.DTNTopK(1, user_features, K, 2, &top_items));
+  ASSERT_TRUE(model_server.DTNWaitItems());
+  CheckTopK();
+  ASSERT_TRUE(model_server.DTNTopK(1, user_features, K, 2, &top_items));
+}
+
+TEST_F(ModelServerDTNTest, Publish_NoTowers) {
+  ASSERT_TRUE(model_server.DTNSetItems(item_ids, item_features));
+  uint64_t version = model_server.version();
+
+  StringMap config;
+  config["group_config"] = "1:100:4,2:100:4";
+  config["sparse"] = "1";
+  std::vector<GroupConfigItem> items;
+  ASSERT_TRUE(GuessGroupConfig(config["group_config"], &items, nullptr));
+  SaveModel("deep_fm", config, items);
+  ASSERT_TRUE(model_server.LoadGraph(graph_file));
+  // Item towers of the catalog can't run with the new version.
+  EXPECT_FALSE(model_server.LoadModel(model_file));
+  EXPECT_EQ(model_server.version(), version);
+  CheckTopK();
+}
+
+TEST_F(ModelServerDTNTest, OpContext_Swap) {
+  auto op_context = model_server.NewOpContext();
+  ASSERT_TRUE(op_context);
+  auto predict_plan = model_server.NewPredictPlan(ITEM);
+  ASSERT_TRUE(predict_plan);
+  // Idle ones are rebound to versions published after they are created.
+  for (int i = 0; i < 3; ++i) {
+    if (i == 1) {
+      ASSERT_TRUE(model_server.LoadModel(model_file));
+    } else if (i == 2) {
+      ASSERT_TRUE(model_server.ApplyDelta(delta_file));
+    }
+    std::vector<std::vector<float>> expected;
+    ASSERT_TRUE(model_server.DTNBatchPredict(user_features, item_features,
+                                             &expected));
+    std::vector<std::vector<float>> batch_probs;
+    ASSERT_TRUE(model_server.DTNBatchPredict(
+        op_context.get(), user_features, item_features, &batch_probs));
+    CheckProbs(batch_probs, expected);
+    ASSERT_TRUE(model_server.DTNBatchPredict(
+        predict_plan.get(), user_features, item_features, &batch_probs));
+    CheckProbs(batch_probs, expected);
+  }
+}
+
+TEST_F(ModelServerDTNTest, ApplyDelta_Chain) {
+  Graph graph;
+  ASSERT_TRUE(graph.Load(graph_file));
+  Model model;
+  model.Init(&graph);
+  ASSERT_TRUE(model.Load(model_file));
+  ModelServer full_model_server;
+  ASSERT_TRUE(full_model_server.LoadGraph(graph_file));
+  std::vector<GroupConfigItem> items = user_items;
+  items.insert(items.end(), item_items.begin(), item_items.end());
+  std::uniform_int_distribution<int_t> id_dist(0, 99);
+  std::uniform_real_distribution<float> value_dist(-1, 1);
+  // Small deltas are chained and merged, but not folded.
+  for (int i = 0; i < 12; ++i) {
+    id_set_t id_set;
+    for (const GroupConfigItem& item : items) {
+      id_set.emplace(
+          ll_sparse_tensor_t::make_feature_id(item.group_id, id_dist(engine)));
+    }
+    for (auto& entry : *model.mutable_param()) {
+      Any& Wany = entry.second;
+      if (Wany.is<tsr_t>()) {
+        for (float_t& value : Wany.unsafe_to_ref<tsr_t>()) {
+          value += value_dist(engine) * 0.1f;  // magic number
+        }
+      } else if (Wany.is<srm_t>()) {
+        auto& W = Wany.unsafe_to_ref<srm_t>();
+        for (int_t id : id_set) {
+          float_t* row = W.get_row_no_init(id);
+          for (int j = 0; j < W.col(); ++j) {
+            row[j] = value_dist(engine);
+          }
+        }
+      }
+    }
+    ASSERT_TRUE(FeatureKVUtil::SaveModel(delta_file, graph, model.param(),
+                                         id_set, 2));
+    ASSERT_TRUE(model_server.ApplyDelta(delta_file));
+    ASSERT_TRUE(model.Save(model_file));
+    ASSERT_TRUE(full_model_server.LoadModel(model_file));
+
+    std::vector<std::vector<float>> expected;
+    ASSERT_TRUE(full_model_server.DTNBatchPredict(user_features,
+                                                  item_features, &expected));
+    std::vector<std::vector<float>> batch_probs;
+    ASSERT_TRUE(model_server.DTNBatchPredict(user_features, item_features,
+                                             &batch_probs));
+    CheckProbs(batch_probs, expected);
+  }
+}
+
+TEST_F(ModelServerDTNTest, DTNSetItems_Clear) {
+  ASSERT_TRUE(model_server.DTNSetItems(item_ids, item_features));
+  ASSERT_TRUE(model_server.DTNSetItems({}, {}));
+  std::vector<std::pair<uint64_t, float>> top_items;
+  EXPECT_FALSE(model_server.DTNTopK(1, user_features, K, 0, &top_items));
+  ASSERT_TRUE(model_server.LoadModel(model_file));
+  EXPECT_TRUE(model_server.DTNWaitItems());
+}
+
+}  // namespace deepx_core
@@ -85,13 +85,7 @@ class DTNModel : public ModelZooImpl {
     *predict_prob = target[1];
   }
 
-  void Infer(GraphNode** infer_prob) const {
-    auto* Xuser = GetXUser();
-    auto* Xitem = GetXItem();
-    auto* UE = DeepGroupEmbeddingLookup("UE", Xuser, user_items_, sparse_);
-    auto* USFC = StackedFullyConnect("USFC", UE, user_deep_dims_);
-    auto* IE = DeepGroupEmbeddingLookup("IE", Xitem, item_items_, sparse_);
-    auto* ISFC = StackedFullyConnect("ISFC", IE, item_deep_dims_);
+  GraphNode* Interact(GraphNode* USFC, GraphNode* ISFC) const {
     if (USFC->shape()[1] == ISFC->shape()[1]) {
       USFC = BroadcastToLike("", USFC, ISFC);
     } else {
@@ -101,14 +95,72 @@ class DTNModel : public ModelZooImpl {
     }
     auto* C = Concat("", {USFC, ISFC});
     auto* SFC = StackedFullyConnect("SFC", C, deep_dims_);
-    *infer_prob = Sigmoid("", SFC);
+    return Sigmoid("", SFC);
+  }
+
+  // The first layer of "SFC" is split into projections of the user tower
+  // and item towers, which can be precomputed.
+  // The rest layers interact the projections.
+  void TowerInfer(GraphNode* USFC, GraphNode* ISFC, GraphNode** user_tower,
+                  GraphNode** item_tower, GraphNode** tower_infer_prob) const {
+    int user_dim = USFC->shape()[1];
+    int in_dim = user_dim + ISFC->shape()[1];
+    // the same as 'StackedFullyConnect'
+    std::vector<int> dims;
+    if (deep_dims_[0] != in_dim) {
+      dims.emplace_back(in_dim);
+    }
+    dims.insert(dims.end(), deep_dims_.begin(), deep_dims_.end());
+    int deep_size = (int)dims.size() - 1;
+
+    auto* W0 = GetVariableRandXavier("SFCW0", Shape(dims[0], dims[1]));
+    auto* b0 = GetVariableZeros("SFCb0", Shape(1, dims[1]));
+    auto* UW0 = SubscriptRange("", W0, 0, 0, user_dim);
+    auto* IW0 = SubscriptRange("", W0, 0, user_dim, in_dim);
+    *user_tower = new FullyConnectNode("", USFC, UW0, b0);
+    *item_tower = new FullyConnectNode("", ISFC, IW0);
+
+    // Don't use BATCH_PLACEHOLDER.
+    auto* Tuser = new InstanceNode(DTN_USER_TOWER_NAME, Shape(1, dims[1]),
+                                   TENSOR_TYPE_TSR);
+    auto* Titem =
+        new InstanceNode(DTN_ITEM_TOWER_NAME,
+                         Shape(BATCH_PLACEHOLDER, dims[1]), TENSOR_TYPE_TSR);
+    GraphNode* Z = BroadcastAdd("", Titem, Tuser);
+    for (int i = 0;; ++i) {
+      if (dims.back() != 1 || i != deep_size - 1) {
+        Z = Relu("", Z);
+      }
+      if (i == deep_size - 1) {
+        break;
+      }
+      auto ii = std::to_string(i + 1);
+      auto* W = GetVariableRandXavier("SFCW" + ii,
+                                      Shape(dims[i + 1], dims[i + 2]));
+      auto* b = GetVariableZeros("SFCb" + ii, Shape(1, dims[i + 2]));
+      Z = new FullyConnectNode("", Z, W, b);
+    }
+    *tower_infer_prob = Sigmoid("", Z);
+  }
+
+  void Infer(GraphNode** infer_prob, GraphNode** user_tower,
+             GraphNode** item_tower, GraphNode** tower_infer_prob) const {
+    auto* Xuser = GetXUser();
+    auto* Xitem = GetXItem();
+    auto* UE = DeepGroupEmbeddingLookup("UE", Xuser, user_items_, sparse_);
+    auto* USFC = StackedFullyConnect("USFC", UE, user_deep_dims_);
+    auto* IE = DeepGroupEmbeddingLookup("IE", Xitem, item_items_, sparse_);
+    auto* ISFC = StackedFullyConnect("ISFC", IE, item_deep_dims_);
+    *infer_prob = Interact(USFC, ISFC);
+    TowerInfer(USFC, ISFC, user_tower, item_tower, tower_infer_prob);
   }
 
  public:
   bool InitGraph(Graph* graph) const override {
-    std::vector<GraphNode*> target(3);
+    std::vector<GraphNode*> target(6);
     TrainPredict(&target[0], &target[1]);
-    Infer(&target[2]);
+    Infer(&target[2], &target[DTN_USER_TOWER_TARGET],
+          &target[DTN_ITEM_TOWER_TARGET], &target[DTN_TOWER_INFER_TARGET]);
     ReleaseVariable();
     return graph->Compile(target, 1);
   }
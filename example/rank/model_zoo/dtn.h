@@ -9,5 +9,19 @@ namespace deepx_core {
 
 const std::string DTN_X_USER_NAME = "__instDTNXuser";
 const std::string DTN_X_ITEM_NAME = "__instDTNXitem";
+// precomputed projections of the user tower and item towers
+const std::string DTN_USER_TOWER_NAME = "__instDTNuser_tower";
+const std::string DTN_ITEM_TOWER_NAME = "__instDTNitem_tower";
+
+// Targets of DTNModel.
+// Offline train, target 0.
+// Offline predict, target 1.
+// Online infer, target 2.
+// Online projection of the user tower of DTN_X_USER_NAME, target 3.
+// Online projections of item towers of DTN_X_ITEM_NAME, target 4.
+// Online infer of DTN_USER_TOWER_NAME and DTN_ITEM_TOWER_NAME, target 5.
+constexpr int DTN_USER_TOWER_TARGET = 3;
+constexpr int DTN_ITEM_TOWER_TARGET = 4;
+constexpr int DTN_TOWER_INFER_TARGET = 5;
 
 }  // namespace deepx_core
@@ -0,0 +1,212 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Latency benchmark of OpContext and PredictPlan over the model zoo.
+//
+
+#include <deepx_core/common/group_config.h>
+#include <deepx_core/common/str_util.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/instance_reader.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/graph/op_context.h>
+#include <deepx_core/graph/predict_plan.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "model_zoo.h"
+
+DEFINE_string(model, "lr,fm,deep_fm,wnd,dcn,xdeep_fm,auto_int",
+              "model names(separated by comma)");
+DEFINE_string(group_config,
+              "1:10000:8,2:10000:8,3:10000:8,4:10000:8,"
+              "5:10000:8,6:10000:8,7:10000:8,8:10000:8",
+              "group config");
+DEFINE_int32(batch, 32, "batch size");
+DEFINE_int32(request, 2000, "# of requests of each mode");
+
+namespace deepx_core {
+namespace {
+
+using float_t = DataType::float_t;
+using int_t = DataType::int_t;
+using tsr_t = DataType::tsr_t;
+using csr_t = DataType::csr_t;
+using ll_sparse_tensor_t = DataType::ll_sparse_tensor_t;
+using steady_clock_t = std::chrono::steady_clock;
+
+double ToMicrosecond(steady_clock_t::duration duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+struct BenchModel {
+  std::string name;
+  Graph graph;
+  Model model;
+  std::string target_name;
+  std::vector<csr_t> requests;
+};
+
+bool InitBenchModel(const std::string& name, BenchModel* bench) {
+  std::unique_ptr<ModelZoo> model_zoo(NewModelZoo(name));
+  if (!model_zoo) {
+    return false;
+  }
+
+  StringMap config;
+  config["group_config"] = FLAGS_group_config;
+  if (!model_zoo->InitConfig(config) || !model_zoo->InitGraph(&bench->graph)) {
+    return false;
+  }
+
+  std::default_random_engine engine;
+  bench->name = name;
+  bench->model.Init(&bench->graph);
+  if (!bench->model.InitParam(engine)) {
+    return false;
+  }
+
+  // Check out graph target conventions.
+  if (bench->graph.target_size() >= 3) {
+    bench->target_name = bench->graph.target(2).name();
+  } else {
+    bench->target_name = bench->graph.target(1).name();
+  }
+
+  std::vector<GroupConfigItem> items;
+  DXCHECK_THROW(GuessGroupConfig(FLAGS_group_config, &items, nullptr));
+  std::uniform_real_distribution<float_t> value_dist(0, 1);
+  bench->requests.resize(64);
+  for (csr_t& X : bench->requests) {
+    for (int i = 0; i < FLAGS_batch; ++i) {
+      for (const GroupConfigItem& item : items) {
+        std::uniform_int_distribution<int_t> id_dist(
+            0, (int_t)item.embedding_row - 1);
+        X.emplace(
+            ll_sparse_tensor_t::make_feature_id(item.group_id, id_dist(engine)),
+            value_dist(engine));
+      }
+      X.add_row();
+    }
+  }
+  return true;
+}
+
+// Run 'predict(request)' for each request, return the average latency.
+double BenchLatency(const BenchModel& bench, const char* mode,
+                    const std::function<void(const csr_t&)>& predict) {
+  int total = FLAGS_request;
+  std::vector<double> latency((size_t)total);
+  // warm up
+  for (const csr_t& X : bench.requests) {
+    predict(X);
+  }
+  for (int i = 0; i < total; ++i) {
+    const csr_t& X = bench.requests[(size_t)i % bench.requests.size()];
+    auto begin = steady_clock_t::now();
+    predict(X);
+    latency[(size_t)i] = ToMicrosecond(steady_clock_t::now() - begin);
+  }
+
+  double sum = 0;
+  for (double l : latency) {
+    sum += l;
+  }
+  std::sort(latency.begin(), latency.end());
+  DXINFO("%-10s %-17s avg=%.1fus p50=%.1fus p99=%.1fus", bench.name.c_str(),
+         mode, sum / total, latency[total / 2],
+         latency[(size_t)total * 99 / 100]);
+  return sum / total;
+}
+
+void Bench(BenchModel* bench) {
+  TensorMap* param = bench->model.mutable_param();
+  const std::string& target_name = bench->target_name;
+
+  // A new OpContext for each request.
+  double op_context_latency =
+      BenchLatency(*bench, "op_context", [&](const csr_t& X) {
+        OpContext op_context;
+        op_context.Init(&bench->graph, param);
+        DXCHECK_THROW(op_context.InitOp({target_name}, -1));
+        Instance* inst = op_context.mutable_inst();
+        inst->insert<csr_t>(X_NAME) = X;
+        inst->set_batch(X.row());
+        op_context.InitPredict();
+        op_context.Predict();
+        (void)op_context.hidden().get<tsr_t>(target_name);
+      });
+
+  // A reused OpContext.
+  OpContext op_context;
+  op_context.Init(&bench->graph, param);
+  DXCHECK_THROW(op_context.InitOp({target_name}, -1));
+  double op_context_reuse_latency =
+      BenchLatency(*bench, "op_context_reuse", [&](const csr_t& X) {
+        Instance* inst = op_context.mutable_inst();
+        int prev_batch = inst->batch();
+        inst->get_or_insert<csr_t>(X_NAME) = X;
+        inst->set_batch(X.row());
+        if (prev_batch != inst->batch()) {
+          op_context.InitPredict();
+        }
+        op_context.Predict();
+        (void)op_context.hidden().get<tsr_t>(target_name);
+      });
+
+  // A frozen PredictPlan.
+  PredictPlan plan;
+  plan.Init(&bench->graph, param);
+  DXCHECK_THROW(plan.InitOp({target_name}));
+  DXCHECK_THROW(plan.Freeze(FLAGS_batch));
+  auto& plan_X = plan.mutable_inst()->get<csr_t>(X_NAME);
+  double plan_latency =
+      BenchLatency(*bench, "predict_plan", [&](const csr_t& X) {
+        plan_X = X;
+        plan.Predict();
+        (void)plan.target(0);
+      });
+
+  DXINFO("%-10s kernels=%d speedup=%.2fx vs op_context, %.2fx vs reuse",
+         bench->name.c_str(), plan.kernel_size(),
+         op_context_latency / plan_latency,
+         op_context_reuse_latency / plan_latency);
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(FLAGS_batch > 0);
+  DXCHECK_THROW(FLAGS_request > 0);
+
+  std::vector<std::string> models;
+  Split(FLAGS_model, ",", &models);
+  for (const std::string& name : models) {
+    BenchModel bench;
+    if (!InitBenchModel(name, &bench)) {
+      DXERROR("Failed to init model: %s.", name.c_str());
+      continue;
+    }
+    Bench(&bench);
+  }
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
@@ -63,6 +63,12 @@ TrainerContext::~TrainerContext() {
 }
 
 void TrainerContext::TrainFile(int thread_id, const std::string& file) {
+  FileChunk chunk;
+  chunk.file = file;
+  TrainFile(thread_id, chunk);
+}
+
+void TrainerContext::TrainFile(int thread_id, const FileChunk& chunk) {
   DXCHECK_THROW(op_context_->InitOp({target_name_}, 0));
   op_context_->mutable_inst()->clear();
   op_context_batch_ = -1;
@@ -76,7 +82,8 @@ void TrainerContext::TrainFile(int thread_id, const std::string& file) {
   DXCHECK_THROW(ParseConfig(instance_reader_config_, &config));
   config["batch"] = std::to_string(batch_);
   DXCHECK_THROW(instance_reader->InitConfig(config));
-  DXCHECK_THROW(instance_reader->Open(file));
+  DXCHECK_THROW(
+      instance_reader->Open(chunk.file, chunk.offset, chunk.length));
 
   size_t processed_batch = 0;
   size_t verbose_batch = GetVerboseBatch(verbose_);
@@ -179,6 +186,13 @@ void TrainerContext::DumpPredictBatch(OutputStream& os) const {
 
 void TrainerContext::PredictFile(int thread_id, const std::string& file,
                                  const std::string& out_file) {
+  FileChunk chunk;
+  chunk.file = file;
+  PredictFile(thread_id, chunk, out_file);
+}
+
+void TrainerContext::PredictFile(int thread_id, const FileChunk& chunk,
+                                 const std::string& out_file) {
   DXCHECK_THROW(op_context_->InitOp({target_name_}, -1));
   op_context_->mutable_inst()->clear();
   op_context_batch_ = -1;
@@ -190,7 +204,8 @@ void TrainerContext::PredictFile(int thread_id, const std::string& file,
   DXCHECK_THROW(ParseConfig(instance_reader_config_, &config));
   config["batch"] = std::to_string(batch_);
   DXCHECK_THROW(instance_reader->InitConfig(config));
-  DXCHECK_THROW(instance_reader->Open(file));
+  DXCHECK_THROW(
+      instance_reader->Open(chunk.file, chunk.offset, chunk.length));
 
   AutoOutputFileStream os;
   DXCHECK_THROW(os.Open(out_file));
@@ -11,6 +11,7 @@
 #include <deepx_core/graph/op_context.h>
 #include <deepx_core/graph/optimizer.h>
 #include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/ps/file_dispatcher.h>
 #include <deepx_core/tensor/data_type.h>
 #include <memory>
 #include <string>
@@ -70,10 +71,15 @@ class TrainerContext : public DataType {
   virtual ~TrainerContext();
   virtual void TrainBatch() = 0;
   virtual void TrainFile(int thread_id, const std::string& file);
+  // Train lines starting in the byte range of 'chunk'.
+  virtual void TrainFile(int thread_id, const FileChunk& chunk);
   virtual void PredictBatch() = 0;
   virtual void DumpPredictBatch(OutputStream& os) const;  // NOLINT
   virtual void PredictFile(int thread_id, const std::string& file,
                            const std::string& out_file);
+  // Predict lines starting in the byte range of 'chunk'.
+  virtual void PredictFile(int thread_id, const FileChunk& chunk,
+                           const std::string& out_file);
 };
 
 /************************************************************************/
@@ -3,7 +3,11 @@
 //
 
 #pragma once
+#if defined __SSE2__
+#include <emmintrin.h>
+#endif
 #include <cstddef>
+#include <cstdint>
 #include <functional>  // std::hash
 #include <initializer_list>
 #include <stdexcept>    // std::out_of_range
@@ -93,6 +97,110 @@ constexpr size_t HASH_MAP_INVALID_BUCKET_INDEX = (size_t)-1;
 constexpr size_t HASH_MAP_MIN_BUCKET_SIZE = 128;
 constexpr size_t HASH_MAP_MAX_LOAD_FACTOR = 2;
 constexpr double HASH_MAP_INV_MIN_LOAD_FACTOR = 1 / 1.5;
+// # of keys hashed and prefetched before any of them is probed.
+constexpr size_t HASH_MAP_PREFETCH_BLOCK = 16;
+
+inline void prefetch(const void* p) noexcept {
+#if defined __GNUC__
+  __builtin_prefetch(p, 0, 3);
+#else
+  (void)p;
+#endif
+}
+
+// Whether FlatHashMap probes groups of buckets by default.
+#if HAVE_HASH_MAP_GROUP_PROBE == 1
+constexpr bool HASH_MAP_GROUP_PROBE = true;
+#else
+constexpr bool HASH_MAP_GROUP_PROBE = false;
+#endif
+
+/************************************************************************/
+/* HashMapGroup */
+/************************************************************************/
+// Meta bytes of used buckets are 7-bit hash fragments(0 - 127),
+// those of empty and deleted buckets are negative.
+constexpr int8_t HASH_MAP_META_EMPTY = -128;
+constexpr int8_t HASH_MAP_META_DELETED = -2;
+// # of meta bytes probed at a time.
+constexpr size_t HASH_MAP_GROUP_SIZE = 16;
+
+inline int8_t hash_map_meta(size_t hash_value) noexcept {
+  // Take the high 7 bits of a multiplicative hash,
+  // so that integral keys hashed to themselves have different fragments.
+  return (int8_t)(((uint64_t)hash_value * 0x9e3779b97f4a7c15ULL) >>
+                  57);  // magic number
+}
+
+inline int count_trailing_zeros(uint32_t mask) noexcept {
+#if defined __GNUC__
+  return __builtin_ctz(mask);
+#else
+  int n = 0;
+  while ((mask & 1) == 0) {
+    mask >>= 1;
+    ++n;
+  }
+  return n;
+#endif
+}
+
+// 'HASH_MAP_GROUP_SIZE' meta bytes starting from any bucket.
+// Bit i of a mask is for meta byte i.
+class HashMapGroup {
+ private:
+#if defined __SSE2__
+  __m128i meta_;
+#else
+  const int8_t* meta_;
+#endif
+
+ public:
+#if defined __SSE2__
+  explicit HashMapGroup(const int8_t* meta) noexcept
+      : meta_(_mm_loadu_si128((const __m128i*)meta)) {}
+
+  uint32_t match(int8_t m) const noexcept {
+    return (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_set1_epi8(m), meta_));
+  }
+
+  uint32_t match_empty() const noexcept { return match(HASH_MAP_META_EMPTY); }
+
+  // empty or deleted
+  uint32_t match_free() const noexcept {
+    return (uint32_t)_mm_movemask_epi8(meta_);
+  }
+#else
+  explicit HashMapGroup(const int8_t* meta) noexcept : meta_(meta) {}
+
+  uint32_t match(int8_t m) const noexcept {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < HASH_MAP_GROUP_SIZE; ++i) {
+      if (meta_[i] == m) {
+        mask |= (uint32_t)1 << i;
+      }
+    }
+    return mask;
+  }
+
+  uint32_t match_empty() const noexcept { return match(HASH_MAP_META_EMPTY); }
+
+  uint32_t match_free() const noexcept {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < HASH_MAP_GROUP_SIZE; ++i) {
+      if (meta_[i] < 0) {
+        mask |= (uint32_t)1 << i;
+      }
+    }
+    return mask;
+  }
+#endif
+
+  uint32_t match_used() const noexcept {
+    return ~match_free() & (((uint32_t)1 << HASH_MAP_GROUP_SIZE) - 1);
+  }
+};
 
 }  // namespace detail
 
@@ -156,8 +264,8 @@ class FlatHashMapIterator {
 
   // 'value_type.first' is not const,
   // it is dangerous to modify it through an iterator.
-  reference operator*() const noexcept { return map_->bucket_[index_]; }
-  pointer operator->() const noexcept { return &map_->bucket_[index_]; }
+  reference operator*() const noexcept { return map_->get_bucket(index_); }
+  pointer operator->() const noexcept { return &map_->get_bucket(index_); }
 };
 
 /************************************************************************/
@@ -216,8 +324,12 @@ class FlatHashMapConstIterator {
     return origin;
   }
 
-  const_reference operator*() const noexcept { return map_->bucket_[index_]; }
-  const_pointer operator->() const noexcept { return &map_->bucket_[index_]; }
+  const_reference operator*() const noexcept {
+    return map_->get_bucket(index_);
+  }
+  const_pointer operator->() const noexcept {
+    return &map_->get_bucket(index_);
+  }
 };
 
 /************************************************************************/
@@ -234,8 +346,21 @@ bool FlatHashMapIterator<FlatHashMap>::operator==(
 /************************************************************************/
 /* FlatHashMap */
 /************************************************************************/
+// If 'GroupProbe' is true, meta bytes of 'HASH_MAP_GROUP_SIZE' buckets are
+// matched against the hash fragment of a key at a time(SwissTable style),
+// otherwise buckets are probed one by one.
+// Both modes share the same meta layout, iteration order and serialization.
+//
+// By default, all buckets are rehashed at once when the table grows.
+// After 'set_rehash_step(n)'(n > 0), the table grows incrementally,
+// the old table and the new one are both live,
+// n buckets of the old table are migrated to the new one per insertion.
+// Once the migration ends, the table of the next growth is reserved and
+// initialized by a few buckets per insertion,
+// so no insertion allocates or fills a whole table.
 template <typename Key, typename Value, class KeyHash = detail::KeyHash<Key>,
-          class KeyEqual = detail::KeyEqual<Key>>
+          class KeyEqual = detail::KeyEqual<Key>,
+          bool GroupProbe = detail::HASH_MAP_GROUP_PROBE>
 class FlatHashMap {
  public:
   using key_type = Key;
@@ -251,13 +376,11 @@ class FlatHashMap {
   using const_pointer = const value_type*;
 
  private:
-  enum META_FLAG {
-    META_FLAG_EMPTY = 0,
-    META_FLAG_USED = 1,
-    META_FLAG_DELETED = 2,
-  };
-  using meta_t = std::vector<char>;
+  // The first 'HASH_MAP_GROUP_SIZE - 1' meta bytes are cloned after the last
+  // one, so that a group starting from any bucket is contiguous.
+  using meta_t = std::vector<int8_t>;
   using bucket_t = std::vector<value_type>;
+  using group_t = detail::HashMapGroup;
   meta_t meta_;
   bucket_t bucket_;
   hasher khash_;
@@ -265,37 +388,95 @@ class FlatHashMap {
   size_type rehash_threshold_ = 0;
   size_type size_ = 0;
 
+  // incremental rehash
+  //
+  // Indices of buckets in 'old_bucket_' are offset by 'bucket_.size()'.
+  // Migrated buckets are marked as deleted to keep probe sequences.
+  meta_t old_meta_;
+  bucket_t old_bucket_;
+  size_type migrate_index_ = 0;
+  size_type rehash_step_ = 0;
+  // The table of the next growth of 'next_size_' buckets.
+  // Its capacity is reserved up front, 'prepare_step_' buckets of it are
+  // initialized per insertion.
+  meta_t next_meta_;
+  bucket_t next_bucket_;
+  size_type next_size_ = 0;
+  size_type prepare_step_ = 0;
+
  private:
+  static bool is_used(int8_t m) noexcept { return m >= 0; }
+
+  static void set_meta(meta_t* meta, size_type bucket_size, size_type index,
+                       int8_t m) noexcept {
+    (*meta)[index] = m;
+    if (index < detail::HASH_MAP_GROUP_SIZE - 1) {
+      (*meta)[bucket_size + index] = m;
+    }
+  }
+
   static size_type find_bucket(const meta_t& meta, const bucket_t& bucket,
-                               const hasher& khash, const key_equal& kequal,
+                               const key_equal& kequal, size_type hash_value,
                                const key_type& k) noexcept {
     if (bucket.empty()) {
       return detail::HASH_MAP_INVALID_BUCKET_INDEX;
     }
 
     size_type hash_mask = bucket.size() - 1;
-    size_type hash_value = khash(k);
     size_type index;
     size_type first_deleted_index = detail::HASH_MAP_INVALID_BUCKET_INDEX;
+    if (GroupProbe) {
+      int8_t m = detail::hash_map_meta(hash_value);
+      index = hash_value & hash_mask;
+      for (size_type probed = 0; probed < bucket.size();
+           probed += detail::HASH_MAP_GROUP_SIZE) {
+        group_t group(&meta[index]);
+        uint32_t mask = group.match(m);
+        for (; mask; mask &= mask - 1) {
+          size_type i =
+              (index + detail::count_trailing_zeros(mask)) & hash_mask;
+          if (kequal(bucket[i].first, k)) {
+            // used & found
+            return i;
+          }
+        }
+        if (first_deleted_index == detail::HASH_MAP_INVALID_BUCKET_INDEX) {
+          mask = group.match_free();
+          if (mask) {
+            first_deleted_index =
+                (index + detail::count_trailing_zeros(mask)) & hash_mask;
+          }
+        }
+        if (group.match_empty()) {
+          // The first empty or deleted bucket.
+          return first_deleted_index;
+        }
+
+        // linear probe by groups
+        index = (index + detail::HASH_MAP_GROUP_SIZE) & hash_mask;
+      }
+      return first_deleted_index;
+    }
+
     int deleted_mode = 0;
     for (;;) {
       index = hash_value & hash_mask;
       switch (meta[index]) {
-        case META_FLAG_USED:
-          if (kequal(bucket[index].first, k)) {
-            // used & found
-            return index;
-          }
-          break;
-        case META_FLAG_EMPTY:
+        case detail::HASH_MAP_META_EMPTY:
           // empty
           return deleted_mode ? first_deleted_index : index;
-        case META_FLAG_DELETED:
+        case detail::HASH_MAP_META_DELETED:
           if (!deleted_mode) {
             first_deleted_index = index;
             deleted_mode = 1;
           }
           break;
+        default:
+          if (kequal(bucket[index].first, k)) {
+            // used & found
+            return index;
+          }
+          break;
       }
 
       // linear probe
@@ -303,29 +484,70 @@ class FlatHashMap {
     }
   }
 
+  // Return the index of the first free bucket of 'hash_value',
+  // which exists as the table is never full.
+  // It reinserts keys known to be absent, e.g. in a rehash.
+  static size_type find_free_bucket(const meta_t& meta, size_type bucket_size,
+                                    size_type hash_value) noexcept {
+    size_type hash_mask = bucket_size - 1;
+    size_type index = hash_value & hash_mask;
+    while (is_used(meta[index])) {
+      // linear probe, which visits groups in order as the group probe does
+      index = (index + 1) & hash_mask;
+    }
+    return index;
+  }
+
   static size_type find_used_bucket(const meta_t& meta, const bucket_t& bucket,
-                                    const hasher& khash,
                                     const key_equal& kequal,
+                                    size_type hash_value,
                                     const key_type& k) noexcept {
     if (bucket.empty()) {
       return detail::HASH_MAP_INVALID_BUCKET_INDEX;
     }
 
     size_type hash_mask = bucket.size() - 1;
-    size_type hash_value = khash(k);
     size_type index;
+    if (GroupProbe) {
+      int8_t m = detail::hash_map_meta(hash_value);
+      index = hash_value & hash_mask;
+      for (size_type probed = 0; probed < bucket.size();
+           probed += detail::HASH_MAP_GROUP_SIZE) {
+        group_t group(&meta[index]);
+        uint32_t mask = group.match(m);
+        for (; mask; mask &= mask - 1) {
+          size_type i =
+              (index + detail::count_trailing_zeros(mask)) & hash_mask;
+          if (kequal(bucket[i].first, k)) {
+            // used & found
+            return i;
+          }
+        }
+        if (group.match_empty()) {
+          // empty
+          return detail::HASH_MAP_INVALID_BUCKET_INDEX;
+        }
+
+        // linear probe by groups
+        index = (index + detail::HASH_MAP_GROUP_SIZE) & hash_mask;
+      }
+      return detail::HASH_MAP_INVALID_BUCKET_INDEX;
+    }
+
     for (;;) {
       index = hash_value & hash_mask;
       switch (meta[index]) {
-        case META_FLAG_USED:
+        case detail::HASH_MAP_META_EMPTY:
+          // empty
+          return detail::HASH_MAP_INVALID_BUCKET_INDEX;
+        case detail::HASH_MAP_META_DELETED:
+          break;
+        default:
           if (kequal(bucket[index].first, k)) {
             // used & found
             return index;
           }
           break;
-        case META_FLAG_EMPTY:
-          // empty
-          return detail::HASH_MAP_INVALID_BUCKET_INDEX;
       }
 
       // linear probe
@@ -340,7 +562,22 @@ class FlatHashMap {
     if (index >= bucket_size) {
       return detail::HASH_MAP_INVALID_BUCKET_INDEX;
     }
-    while (meta[index] != META_FLAG_USED) {
+    if (GroupProbe) {
+      for (;;) {
+        uint32_t mask = group_t(&meta[index]).match_used();
+        if (mask) {
+          index += detail::count_trailing_zeros(mask);
+          // Skip cloned meta bytes.
+          return index < bucket_size ? index
+                                     : detail::HASH_MAP_INVALID_BUCKET_INDEX;
+        }
+        index += detail::HASH_MAP_GROUP_SIZE;
+        if (index >= bucket_size) {
+          return detail::HASH_MAP_INVALID_BUCKET_INDEX;
+        }
+      }
+    }
+    while (!is_used(meta[index])) {
       if (++index >= bucket_size) {
         return detail::HASH_MAP_INVALID_BUCKET_INDEX;
       }
@@ -357,12 +594,16 @@ class FlatHashMap {
     return size;
   }
 
+  static size_type meta_size(size_type bucket_size) noexcept {
+    return bucket_size + detail::HASH_MAP_GROUP_SIZE - 1;
+  }
+
   static void clear_value(pointer /*kv*/) noexcept {
     // Nothing is actually cleared.
   }
 
   static void clear_meta(meta_t* meta) noexcept {
-    meta->assign(meta->size(), META_FLAG_EMPTY);
+    meta->assign(meta->size(), detail::HASH_MAP_META_EMPTY);
   }
 
   static void clear_bucket(bucket_t* /*bucket*/) noexcept {
@@ -372,22 +613,100 @@ class FlatHashMap {
  private:
   void resize_bucket(size_type size) {
     size = next_size(size);
-    meta_.resize(size);
+    meta_.resize(meta_size(size), detail::HASH_MAP_META_EMPTY);
     bucket_.resize(size);
     rehash_threshold_ =
         (size_type)(bucket_.size() * detail::HASH_MAP_INV_MIN_LOAD_FACTOR);
   }
 
+  reference get_bucket(size_type index) noexcept {
+    return index < bucket_.size() ? bucket_[index]
+                                  : old_bucket_[index - bucket_.size()];
+  }
+
+  const_reference get_bucket(size_type index) const noexcept {
+    return index < bucket_.size() ? bucket_[index]
+                                  : old_bucket_[index - bucket_.size()];
+  }
+
+  // Migrate at most 'n' buckets of the old table.
+  void migrate(size_type n) {
+    size_type old_bucket_size = old_bucket_.size();
+    size_type migrate_end = migrate_index_ + n;
+    if (migrate_end > old_bucket_size || migrate_end < migrate_index_) {
+      migrate_end = old_bucket_size;
+    }
+    for (; migrate_index_ < migrate_end; ++migrate_index_) {
+      int8_t m = old_meta_[migrate_index_];
+      if (is_used(m)) {
+        reference kv = old_bucket_[migrate_index_];
+        size_type index =
+            find_free_bucket(meta_, bucket_.size(), khash_(kv.first));
+        set_meta(&meta_, bucket_.size(), index, m);
+        bucket_[index] = std::move(kv);
+        set_meta(&old_meta_, old_bucket_size, migrate_index_,
+                 detail::HASH_MAP_META_DELETED);
+      }
+    }
+
+    if (migrate_index_ == old_bucket_size) {
+      meta_t().swap(old_meta_);
+      bucket_t().swap(old_bucket_);
+      migrate_index_ = 0;
+    }
+  }
+
+  void migrate_all() {
+    if (!old_bucket_.empty()) {
+      migrate(old_bucket_.size());
+    }
+  }
+
+  void clear_next() noexcept {
+    meta_t().swap(next_meta_);
+    bucket_t().swap(next_bucket_);
+    next_size_ = 0;
+    prepare_step_ = 0;
+  }
+
+  // Reserve the table of the next growth.
+  void start_prepare() {
+    next_size_ = next_size(rehash_threshold_ + 1);
+    next_meta_.reserve(meta_size(next_size_));
+    next_bucket_.reserve(next_size_);
+    // Finish before 'size_' reaches 'rehash_threshold_'.
+    size_type room = rehash_threshold_ > size_ ? rehash_threshold_ - size_ : 1;
+    prepare_step_ = (meta_size(next_size_) + room - 1) / room;
+  }
+
+  // Initialize at most 'n' more buckets of the next table.
+  void prepare(size_type n) {
+    size_type bucket_end = next_bucket_.size() + n;
+    if (bucket_end > next_size_ || bucket_end < n) {
+      bucket_end = next_size_;
+    }
+    size_type meta_end = next_meta_.size() + n;
+    if (meta_end > meta_size(next_size_) || meta_end < n) {
+      meta_end = meta_size(next_size_);
+    }
+    // no reallocation within the reserved capacity
+    next_bucket_.resize(bucket_end);
+    next_meta_.resize(meta_end, detail::HASH_MAP_META_EMPTY);
+  }
+
   void _rehash(size_type new_size) {
-    meta_t new_meta(new_size);
+    migrate_all();
+    clear_next();
+
+    meta_t new_meta(meta_size(new_size), detail::HASH_MAP_META_EMPTY);
     bucket_t new_bucket(new_size);
 
     for (size_type i = 0; i < bucket_.size(); ++i) {
-      if (meta_[i] == META_FLAG_USED) {
+      if (is_used(meta_[i])) {
         reference kv = bucket_[i];
         size_type index =
-            find_bucket(new_meta, new_bucket, khash_, kequal_, kv.first);
-        new_meta[index] = META_FLAG_USED;
+            find_free_bucket(new_meta, new_size, khash_(kv.first));
+        set_meta(&new_meta, new_size, index, meta_[i]);
         new_bucket[index] = std::move(kv);
       }
     }
@@ -399,32 +718,129 @@ class FlatHashMap {
   }
 
   void rehash_for_emplace() {
+    if (!old_bucket_.empty()) {
+      migrate(rehash_step_ > 0 ? rehash_step_ : old_bucket_.size());
+    } else if (rehash_step_ > 0 && size_ > 0 && size_ < rehash_threshold_) {
+      if (next_size_ == 0) {
+        start_prepare();
+      }
+      prepare(prepare_step_);
+    }
+
     if (size_ >= rehash_threshold_) {
       size_type new_size = next_size(size_ + 1);
-      _rehash(new_size);
+      if (rehash_step_ == 0 || size_ == 0) {
+        _rehash(new_size);
+        return;
+      }
+
+      // Start an incremental rehash.
+      // The new table has room for 'size_' more insertions,
+      // the old table has about '1.5 * size_' buckets,
+      // so a rehash ends before the next one starts if 'rehash_step_' >= 2.
+      migrate_all();
+      old_meta_.swap(meta_);
+      old_bucket_.swap(bucket_);
+      if (next_size_ == new_size) {
+        prepare(meta_size(new_size));
+        next_meta_.swap(meta_);
+        next_bucket_.swap(bucket_);
+      } else {
+        meta_t(meta_size(new_size), detail::HASH_MAP_META_EMPTY).swap(meta_);
+        bucket_t(new_size).swap(bucket_);
+      }
+      clear_next();
+      migrate_index_ = 0;
+      rehash_threshold_ =
+          (size_type)(bucket_.size() * detail::HASH_MAP_INV_MIN_LOAD_FACTOR);
+      migrate(rehash_step_);
     }
   }
 
-  size_type find_bucket(const key_type& k) const noexcept {
-    return find_bucket(meta_, bucket_, khash_, kequal_, k);
+  // Return the index of 'k' in the new or old table if it is found,
+  // otherwise the index of a free bucket in the new table.
+  size_type find_bucket(const key_type& k, size_type* hash_value) const
+      noexcept {
+    *hash_value = khash_(k);
+    size_type index = find_bucket(meta_, bucket_, kequal_, *hash_value, k);
+    if (!old_bucket_.empty() && !is_used(meta_[index])) {
+      size_type old_index =
+          find_used_bucket(old_meta_, old_bucket_, kequal_, *hash_value, k);
+      if (old_index != detail::HASH_MAP_INVALID_BUCKET_INDEX) {
+        return bucket_.size() + old_index;
+      }
+    }
+    return index;
   }
 
   template <typename... Args>
-  size_type find_bucket(const key_type& k, Args&&...) const noexcept {
-    return find_bucket(k);
+  size_type find_bucket(size_type* hash_value, const key_type& k,
+                        Args&&...) const noexcept {
+    return find_bucket(k, hash_value);
   }
 
   template <typename... Args>
-  size_type find_bucket(const_reference kv, Args&&...) const noexcept {
-    return find_bucket(kv.first);
+  size_type find_bucket(size_type* hash_value, const_reference kv,
+                        Args&&...) const noexcept {
+    return find_bucket(kv.first, hash_value);
   }
 
   size_type find_used_bucket(const key_type& k) const noexcept {
-    return find_used_bucket(meta_, bucket_, khash_, kequal_, k);
+    size_type hash_value = khash_(k);
+    size_type index = find_used_bucket(meta_, bucket_, kequal_, hash_value, k);
+    if (index == detail::HASH_MAP_INVALID_BUCKET_INDEX &&
+        !old_bucket_.empty()) {
+      index = find_used_bucket(old_meta_, old_bucket_, kequal_, hash_value, k);
+      if (index != detail::HASH_MAP_INVALID_BUCKET_INDEX) {
+        index += bucket_.size();
+      }
+    }
+    return index;
   }
 
   size_type find_next_used_bucket(size_type index) const noexcept {
-    return find_next_used_bucket(meta_, bucket_, index);
+    size_type bucket_size = bucket_.size();
+    if (index < bucket_size) {
+      index = find_next_used_bucket(meta_, bucket_, index);
+      if (index != detail::HASH_MAP_INVALID_BUCKET_INDEX ||
+          old_bucket_.empty()) {
+        return index;
+      }
+      index = bucket_size;
+    }
+    index = find_next_used_bucket(old_meta_, old_bucket_, index - bucket_size);
+    if (index != detail::HASH_MAP_INVALID_BUCKET_INDEX) {
+      index += bucket_size;
+    }
+    return index;
+  }
+
+  void set_used(size_type index, size_type hash_value) noexcept {
+    set_meta(&meta_, bucket_.size(), index, detail::hash_map_meta(hash_value));
+  }
+
+  template <class Mapped>
+  void _find_batch(const key_type* keys, size_type n, Mapped** values) const
+      noexcept {
+    size_type i = 0, j, block_end;
+    while (i < n) {
+      block_end = i + detail::HASH_MAP_PREFETCH_BLOCK;
+      if (block_end > n) {
+        block_end = n;
+      }
+      for (j = i; j < block_end; ++j) {
+        prefetch(keys[j]);
+      }
+      for (j = i; j < block_end; ++j) {
+        size_type index = find_used_bucket(keys[j]);
+        if (index == detail::HASH_MAP_INVALID_BUCKET_INDEX) {
+          values[j] = nullptr;
+        } else {
+          values[j] = const_cast<Mapped*>(&get_bucket(index).second);
+        }
+      }
+      i = block_end;
+    }
   }
 
  public:
@@ -457,10 +873,22 @@ class FlatHashMap {
     kequal_ = std::move(other.kequal_);
     rehash_threshold_ = other.rehash_threshold_;
     size_ = other.size_;
+    old_meta_ = std::move(other.old_meta_);
+    old_bucket_ = std::move(other.old_bucket_);
+    migrate_index_ = other.migrate_index_;
+    rehash_step_ = other.rehash_step_;
+    next_meta_ = std::move(other.next_meta_);
+    next_bucket_ = std::move(other.next_bucket_);
+    next_size_ = other.next_size_;
+    prepare_step_ = other.prepare_step_;
     other.meta_.clear();
     other.bucket_.clear();
     other.rehash_threshold_ = 0;
     other.size_ = 0;
+    other.old_meta_.clear();
+    other.old_bucket_.clear();
+    other.migrate_index_ = 0;
+    other.clear_next();
   }
 
   FlatHashMap& operator=(FlatHashMap&& other) noexcept {
@@ -471,10 +899,22 @@ class FlatHashMap {
       kequal_ = std::move(other.kequal_);
       rehash_threshold_ = other.rehash_threshold_;
       size_ = other.size_;
+      old_meta_ = std::move(other.old_meta_);
+      old_bucket_ = std::move(other.old_bucket_);
+      migrate_index_ = other.migrate_index_;
+      rehash_step_ = other.rehash_step_;
+      next_meta_ = std::move(other.next_meta_);
+      next_bucket_ = std::move(other.next_bucket_);
+      next_size_ = other.next_size_;
+      prepare_step_ = other.prepare_step_;
       other.meta_.clear();
       other.bucket_.clear();
       other.rehash_threshold_ = 0;
       other.size_ = 0;
+      other.old_meta_.clear();
+      other.old_bucket_.clear();
+      other.migrate_index_ = 0;
+      other.clear_next();
     }
     return *this;
   }
@@ -544,18 +984,28 @@ class FlatHashMap {
   size_type size() const noexcept { return size_; }
   bool empty() const noexcept { return size_ == 0; }
   size_type bucket_size() const noexcept { return bucket_.size(); }
+  size_type rehash_step() const noexcept { return rehash_step_; }
+  // 0 rehashes all buckets at once.
+  void set_rehash_step(size_type rehash_step) noexcept {
+    rehash_step_ = rehash_step;
+  }
+  // Whether an incremental rehash is in progress.
+  bool rehashing() const noexcept { return !old_bucket_.empty(); }
 
  public:
   mapped_type& operator[](const key_type& k) {
     rehash_for_emplace();
-    size_type index = find_bucket(k);
-    char& flag = meta_[index];
+    size_type hash_value;
+    size_type index = find_bucket(k, &hash_value);
+    if (index >= bucket_.size()) {
+      return old_bucket_[index - bucket_.size()].second;
+    }
     reference kv = bucket_[index];
-    if (flag != META_FLAG_USED) {
+    if (!is_used(meta_[index])) {
       kv.first = k;
       kv.second = mapped_type{};
       ++size_;
-      flag = META_FLAG_USED;
+      set_used(index, hash_value);
     }
     return kv.second;
   }
@@ -565,7 +1015,7 @@ class FlatHashMap {
     if (index == detail::HASH_MAP_INVALID_BUCKET_INDEX) {
       throw std::out_of_range("at");
     }
-    return bucket_[index].second;
+    return get_bucket(index).second;
   }
 
   const mapped_type& at(const key_type& k) const {
@@ -573,7 +1023,7 @@ class FlatHashMap {
     if (index == detail::HASH_MAP_INVALID_BUCKET_INDEX) {
       throw std::out_of_range("at");
     }
-    return bucket_[index].second;
+    return get_bucket(index).second;
   }
 
  public:
@@ -585,6 +1035,31 @@ class FlatHashMap {
     return const_iterator(this, find_used_bucket(k));
   }
 
+  // Prefetch the first bucket to probe for 'k'.
+  void prefetch(const key_type& k) const noexcept {
+    if (bucket_.empty()) {
+      return;
+    }
+    size_type index = khash_(k) & (bucket_.size() - 1);
+    detail::prefetch(&meta_[index]);
+    detail::prefetch(&bucket_[index]);
+  }
+
+  // Find 'n' keys in blocks.
+  // Buckets of all keys of a block are prefetched before any of them is
+  // probed, so that their cache misses overlap.
+  //
+  // values[i] points to the mapped value of keys[i], or is nullptr.
+  void find_batch(const key_type* keys, size_type n,
+                  const mapped_type** values) const noexcept {
+    _find_batch<const mapped_type>(keys, n, values);
+  }
+
+  void find_batch(const key_type* keys, size_type n,
+                  mapped_type** values) noexcept {
+    _find_batch<mapped_type>(keys, n, values);
+  }
+
   size_type count(const key_type& k) const noexcept {
     size_type index = find_used_bucket(k);
     if (index == detail::HASH_MAP_INVALID_BUCKET_INDEX) {
@@ -605,25 +1080,35 @@ class FlatHashMap {
   template <typename... Args>
   std::pair<iterator, bool> emplace(Args&&... args) {
     rehash_for_emplace();
-    size_type index = find_bucket(std::forward<Args>(args)...);
-    char& flag = meta_[index];
-    if (flag == META_FLAG_USED) {
+    size_type hash_value;
+    size_type index = find_bucket(&hash_value, std::forward<Args>(args)...);
+    if (index >= bucket_.size() || is_used(meta_[index])) {
       return std::make_pair(iterator(this, index), false);
     } else {
       bucket_[index] = value_type{std::forward<Args>(args)...};
       ++size_;
-      flag = META_FLAG_USED;
+      set_used(index, hash_value);
       return std::make_pair(iterator(this, index), true);
     }
   }
 
   iterator erase(const_iterator pos) {
     size_type index = pos.index_;
-    char& flag = meta_[index];
-    if (flag == META_FLAG_USED) {
-      clear_value(&bucket_[index]);
-      --size_;
-      flag = META_FLAG_DELETED;
+    size_type bucket_size = bucket_.size();
+    if (index < bucket_size) {
+      if (is_used(meta_[index])) {
+        clear_value(&bucket_[index]);
+        --size_;
+        set_meta(&meta_, bucket_size, index, detail::HASH_MAP_META_DELETED);
+      }
+    } else {
+      size_type old_index = index - bucket_size;
+      if (is_used(old_meta_[old_index])) {
+        clear_value(&old_bucket_[old_index]);
+        --size_;
+        set_meta(&old_meta_, old_bucket_.size(), old_index,
+                 detail::HASH_MAP_META_DELETED);
+      }
     }
     return iterator(this, find_next_used_bucket(index + 1));
   }
@@ -633,6 +1118,10 @@ class FlatHashMap {
     clear_bucket(&bucket_);
     rehash_threshold_ = 0;
     size_ = 0;
+    meta_t().swap(old_meta_);
+    bucket_t().swap(old_bucket_);
+    migrate_index_ = 0;
+    clear_next();
   }
 
   template <typename Int>
@@ -640,6 +1129,8 @@ class FlatHashMap {
     size_type new_size = next_size((size_type)_new_size);
     if (new_size > bucket_.size()) {
       _rehash(new_size);
+    } else {
+      migrate_all();
     }
   }
 
@@ -655,6 +1146,14 @@ class FlatHashMap {
     std::swap(kequal_, other.kequal_);
     std::swap(rehash_threshold_, other.rehash_threshold_);
     std::swap(size_, other.size_);
+    old_meta_.swap(other.old_meta_);
+    old_bucket_.swap(other.old_bucket_);
+    std::swap(migrate_index_, other.migrate_index_);
+    std::swap(rehash_step_, other.rehash_step_);
+    next_meta_.swap(other.next_meta_);
+    next_bucket_.swap(other.next_bucket_);
+    std::swap(next_size_, other.next_size_);
+    std::swap(prepare_step_, other.prepare_step_);
   }
 };
 
@@ -662,7 +1161,8 @@ class FlatHashMap {
 /* HashMap */
 /************************************************************************/
 template <typename Key, typename Value, class KeyHash = detail::KeyHash<Key>,
-          class KeyEqual = detail::KeyEqual<Key>>
-using HashMap = FlatHashMap<Key, Value, KeyHash, KeyEqual>;
+          class KeyEqual = detail::KeyEqual<Key>,
+          bool GroupProbe = detail::HASH_MAP_GROUP_PROBE>
+using HashMap = FlatHashMap<Key, Value, KeyHash, KeyEqual, GroupProbe>;
 
 }  // namespace deepx_core
@@ -10,9 +10,11 @@
 
 namespace deepx_core {
 
-template <typename Key, typename Value, class KeyHash, class KeyEqual>
-OutputStream& operator<<(OutputStream& os,
-                         const FlatHashMap<Key, Value, KeyHash, KeyEqual>& m) {
+template <typename Key, typename Value, class KeyHash, class KeyEqual,
+          bool GroupProbe>
+OutputStream& operator<<(
+    OutputStream& os,
+    const FlatHashMap<Key, Value, KeyHash, KeyEqual, GroupProbe>& m) {
   int version = 0x0a0c72e7;            // magic number version
   uint64_t size = (uint64_t)m.size();  // NOLINT
   os << version;
@@ -29,9 +31,11 @@ OutputStream& operator<<(OutputStream& os,
   return os;
 }
 
-template <typename Key, typename Value, class KeyHash, class KeyEqual>
-InputStream& operator>>(InputStream& is,
-                        FlatHashMap<Key, Value, KeyHash, KeyEqual>& m) {
+template <typename Key, typename Value, class KeyHash, class KeyEqual,
+          bool GroupProbe>
+InputStream& operator>>(
+    InputStream& is,
+    FlatHashMap<Key, Value, KeyHash, KeyEqual, GroupProbe>& m) {
   int version;
   if (is.Peek(&version, sizeof(version)) != sizeof(version)) {
     return is;
@@ -69,10 +73,62 @@ InputStream& operator>>(InputStream& is,
   return is;
 }
 
-template <typename Key, typename Value, class KeyHash, class KeyEqual>
+// Read entries one by one and pass them to 'func',
+// they are not inserted into any map.
+// 'func' is called with a 'std::pair<Key, Value>&'.
+template <typename Key, typename Value, class Func>
+InputStream& ReadEach(InputStream& is, Func&& func) {  // NOLINT
+  int version;
+  if (is.Peek(&version, sizeof(version)) != sizeof(version)) {
+    return is;
+  }
+
+  size_t size;
+  if (version == 0x0a0c72e7) {  // magic number version
+    uint64_t size_u64 = 0;
+    is >> version;
+    is >> size_u64;
+    size = (size_t)size_u64;
+  } else {
+    // backward compatibility
+    int size_i = 0;
+    is >> size_i;
+    size = (size_t)size_i;
+  }
+  if (!is) {
+    return is;
+  }
+
+  std::pair<Key, Value> kv;
+  for (size_t i = 0; i < size; ++i) {
+    is >> kv.first >> kv.second;
+    if (!is) {
+      return is;
+    }
+    func(kv);
+  }
+  return is;
+}
+
+// Write a map of 'size' entries, the entries are written by 'func(os)'.
+// It can be read back as a FlatHashMap.
+template <class Func>
+OutputStream& WriteEach(OutputStream& os, uint64_t size,  // NOLINT
+                        Func&& func) {
+  int version = 0x0a0c72e7;  // magic number version
+  os << version;
+  os << size;
+  if (os) {
+    func(os);
+  }
+  return os;
+}
+
+template <typename Key, typename Value, class KeyHash, class KeyEqual,
+          bool GroupProbe>
 InputStringStream& ReadView(
-    InputStringStream& is,                            // NOLINT
-    FlatHashMap<Key, Value, KeyHash, KeyEqual>& m) {  // NOLINT
+    InputStringStream& is,                                      // NOLINT
+    FlatHashMap<Key, Value, KeyHash, KeyEqual, GroupProbe>& m) {  // NOLINT
   int version;
   if (is.Peek(&version, sizeof(version)) != sizeof(version)) {
     return is;
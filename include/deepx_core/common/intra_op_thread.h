@@ -0,0 +1,53 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#pragma once
+#include <functional>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* intra-op parallelism */
+/************************************************************************/
+// Kernels split heavy loops into chunks with 'IntraOpParallelFor'.
+//
+// The thread budget belongs to the calling thread and is 1 by default,
+// so kernels run in the calling thread unless the caller opts in with
+// 'IntraOpThreadGuard', e.g. OpContext.
+// Chunks run in a thread pool shared by the whole process,
+// kernels called in chunks run single-threaded.
+
+// Return the thread budget of the current thread.
+int GetIntraOpThread() noexcept;
+
+// Set the thread budget of the current thread in the scope.
+class IntraOpThreadGuard {
+ private:
+  int prev_thread_;
+
+ public:
+  explicit IntraOpThreadGuard(int thread) noexcept;
+  ~IntraOpThreadGuard();
+  IntraOpThreadGuard(const IntraOpThreadGuard&) = delete;
+  IntraOpThreadGuard& operator=(const IntraOpThreadGuard&) = delete;
+};
+
+// Return the min # of elements of a chunk,
+// given the cost(e.g. # of multiply-adds) of an element.
+int GetIntraOpGrain(int cost) noexcept;
+
+// Return the # of chunks [0, n) will be split into.
+int GetIntraOpChunk(int n, int min_grain) noexcept;
+
+using intra_op_function_t =
+    std::function<void(int chunk, int chunk_begin, int chunk_end)>;
+
+// Split [0, n) into 'GetIntraOpChunk(n, min_grain)' contiguous chunks,
+// run 'func(chunk, chunk_begin, chunk_end)' for each chunk and wait for the
+// completion.
+//
+// The chunks are disjoint, 'func' must not write data shared by chunks.
+void IntraOpParallelFor(int n, int min_grain, const intra_op_function_t& func);
+
+}  // namespace deepx_core
@@ -0,0 +1,165 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* RCU */
+/************************************************************************/
+// RCU(read-copy-update) lets readers use published objects without locks,
+// while writers wait for readers before freeing replaced objects.
+//
+// A reader increments a counter of the current epoch in a slot picked by
+// its thread, and decrements it when it leaves.
+// Slots are padded to cache lines, readers of different threads don't
+// contend in general.
+// 'Synchronize' flips the epoch and waits for counters of the previous
+// epoch to drain, twice, so that it waits for all readers which entered
+// before it, and it is not starved by new readers.
+class RCU {
+ public:
+  static constexpr int SLOT_SIZE = 64;  // magic number
+
+ private:
+  struct Slot {
+    std::atomic<int64_t> count{0};
+    char padding[64 - sizeof(std::atomic<int64_t>)];  // magic number
+  };
+
+  std::atomic<uint64_t> epoch_{0};
+  Slot slots_[2][SLOT_SIZE];
+  std::mutex synchronize_mutex_;
+
+ private:
+  static int GetThreadSlot() noexcept;
+
+ public:
+  using reader_t = std::atomic<int64_t>*;
+
+  RCU() = default;
+  RCU(const RCU&) = delete;
+  RCU& operator=(const RCU&) = delete;
+
+  reader_t ReadLock() noexcept {
+    uint64_t epoch = epoch_.load();
+    reader_t reader = &slots_[epoch & 1][GetThreadSlot()].count;
+    reader->fetch_add(1);
+    return reader;
+  }
+
+  static void ReadUnlock(reader_t reader) noexcept {
+    reader->fetch_sub(1, std::memory_order_release);
+  }
+
+  // Wait for readers which entered before.
+  void Synchronize();
+
+  // A non-blocking alternative to 'Synchronize'.
+  // Readers which entered before 'GracePeriod' have left once
+  // 'PollGracePeriod' of the returned ticket returns true.
+  // Instead of waiting, polls advance the epoch when readers of the
+  // previous one have left.
+  uint64_t GracePeriod();
+  bool PollGracePeriod(uint64_t ticket);
+};
+
+/************************************************************************/
+/* RCUPtr */
+/************************************************************************/
+// RCUPtr publishes a 'std::shared_ptr<T>' to readers.
+//
+// 'ReadGuard' is a lock free reader, its pointer is valid during its life.
+// 'load' returns a shared pointer, which keeps the object alive longer.
+// 'store' publishes a new object, waits for readers of the old one,
+// then releases the old one, which is freed if it is not shared by others.
+template <typename T>
+class RCUPtr {
+ private:
+  struct Node {
+    std::shared_ptr<T> ptr;
+    uint64_t serial = 0;
+  };
+
+  mutable RCU rcu_;
+  std::atomic<Node*> node_{nullptr};
+  std::atomic<uint64_t> serial_{0};
+  std::mutex store_mutex_;
+
+ public:
+  class ReadGuard {
+   private:
+    RCU::reader_t reader_;
+    T* ptr_ = nullptr;
+    uint64_t serial_ = 0;
+
+   public:
+    explicit ReadGuard(const RCUPtr& rcu_ptr) noexcept
+        : reader_(rcu_ptr.rcu_.ReadLock()) {
+      const Node* node = rcu_ptr.node_.load();
+      if (node) {
+        ptr_ = node->ptr.get();
+        serial_ = node->serial;
+      }
+    }
+    ~ReadGuard() { RCU::ReadUnlock(reader_); }
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+    T* get() const noexcept { return ptr_; }
+    // Serial of the pinned object, 0 if nothing has been published.
+    uint64_t serial() const noexcept { return serial_; }
+    T* operator->() const noexcept { return ptr_; }
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+  };
+
+ public:
+  RCUPtr() = default;
+  ~RCUPtr() { delete node_.load(); }
+  RCUPtr(const RCUPtr&) = delete;
+  RCUPtr& operator=(const RCUPtr&) = delete;
+
+  // Serial of the published object, it increases with each 'store'.
+  uint64_t serial() const noexcept {
+    return serial_.load(std::memory_order_acquire);
+  }
+
+  // Return the published object and its serial.
+  std::shared_ptr<T> load(uint64_t* serial = nullptr) const {
+    RCU::reader_t reader = rcu_.ReadLock();
+    std::shared_ptr<T> ptr;
+    uint64_t _serial = 0;
+    const Node* node = node_.load();
+    if (node) {
+      ptr = node->ptr;
+      _serial = node->serial;
+    }
+    RCU::ReadUnlock(reader);
+    if (serial) {
+      *serial = _serial;
+    }
+    return ptr;
+  }
+
+  // Publish 'ptr', which can be nullptr.
+  // It blocks until readers of the old object leave.
+  void store(std::shared_ptr<T> ptr) {
+    std::lock_guard<std::mutex> guard(store_mutex_);
+    std::unique_ptr<Node> node(new Node);
+    node->ptr = std::move(ptr);
+    node->serial = serial_.load() + 1;
+    std::unique_ptr<Node> old_node(node_.exchange(node.get()));
+    serial_.store(node->serial, std::memory_order_release);
+    node.release();
+    rcu_.Synchronize();
+  }
+};
+
+}  // namespace deepx_core
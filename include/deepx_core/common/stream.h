@@ -394,6 +394,8 @@ class CFileStream : public IOStream {
 
  public:
   bool Open(const std::string& file, int mode);
+  // Seek to 'offset' of an input file.
+  bool Seek(size_t offset);
   bool IsOpen() const noexcept;
   void Close() noexcept;
 };
@@ -435,8 +437,85 @@ class OutputStringStream : public OutputStream {
  public:
   void BeginMessage();
   void EndMessage() noexcept;
+  // Write a placeholder of the size of a string, return its position.
+  size_t BeginString();
+  // Fill the placeholder at 'pos' with the # of bytes written after it,
+  // the data written in between is read back as a string.
+  void EndString(size_t pos) noexcept;
 };
 
+/************************************************************************/
+/* OutputGatherStream */
+/************************************************************************/
+// OutputGatherStream collects written data as a list of buffers for
+// vectored writes.
+//
+// Data of at least 'min_ref_bytes' bytes is referenced instead of copied,
+// it must be alive and unchanged until the buffers have been consumed.
+// Smaller data is copied and coalesced.
+class OutputGatherStream : public OutputStream {
+ public:
+  static constexpr size_t DEFAULT_MIN_REF_BYTES = 64 * 1024;  // magic number
+
+ private:
+  struct Piece {
+    // nullptr for copied data, which starts at 'offset' of 'buf_'.
+    const char* data;
+    size_t offset;
+    size_t size;
+  };
+
+  size_t min_ref_bytes_ = DEFAULT_MIN_REF_BYTES;
+  std::string buf_;
+  std::vector<Piece> pieces_;
+  size_t size_ = 0;
+  size_t ref_size_ = 0;
+
+ public:
+  size_t Write(const void* data, size_t size) override;
+
+ public:
+  void set_min_ref_bytes(size_t min_ref_bytes) noexcept {
+    // Placeholders must be copied.
+    min_ref_bytes_ = min_ref_bytes < sizeof(int) + 1 ? sizeof(int) + 1
+                                                     : min_ref_bytes;
+  }
+  size_t min_ref_bytes() const noexcept { return min_ref_bytes_; }
+  // # of bytes written.
+  size_t GetSize() const noexcept { return size_; }
+  // # of bytes referenced.
+  size_t GetRefSize() const noexcept { return ref_size_; }
+  size_t GetPieceSize() const noexcept { return pieces_.size(); }
+
+  // Call 'func(data, size)' for each buffer after the first 'skip' bytes.
+  template <class Func>
+  void ForEachBuf(size_t skip, Func&& func) const;
+
+  // Copy all data to 's', for test and debug.
+  std::string GetString() const;
+
+  void clear() noexcept;
+
+ public:
+  void BeginMessage();
+  void EndMessage() noexcept;
+  size_t BeginString();
+  void EndString(size_t pos) noexcept;
+};
+
+template <class Func>
+void OutputGatherStream::ForEachBuf(size_t skip, Func&& func) const {
+  for (const Piece& piece : pieces_) {
+    if (skip >= piece.size) {
+      skip -= piece.size;
+      continue;
+    }
+    const char* data = piece.data ? piece.data : buf_.data() + piece.offset;
+    func(data + skip, piece.size - skip);
+    skip = 0;
+  }
+}
+
 /************************************************************************/
 /* InputStringStream */
 /************************************************************************/
@@ -586,6 +665,8 @@ class HDFSFileStream : public IOStream {
 
  public:
   bool Open(const std::string& file, int mode);
+  // Seek to 'offset' of an input file.
+  bool Seek(size_t offset);
   bool IsOpen() const noexcept;
   void Close() noexcept;
 };
@@ -657,6 +738,9 @@ class AutoInputFileStream : public InputStream {
 
  public:
   bool Open(const std::string& file);
+  // Open 'file' and start reading at 'offset'.
+  // Gzip files and stdin can only be opened at offset 0.
+  bool Open(const std::string& file, size_t offset);
   bool IsOpen() const noexcept;
   void Close() noexcept;
 };
@@ -3,18 +3,149 @@
 //
 
 #pragma once
+#include <atomic>
 #include <condition_variable>
-#include <forward_list>
+#include <cstddef>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace deepx_core {
 
+/************************************************************************/
+/* ThreadPoolTask */
+/************************************************************************/
+// ThreadPoolTask is a move-only function object of 'void()'.
+//
+// Function objects of at most 'INLINE_SIZE' bytes are stored inline,
+// constructing, moving and destroying them don't allocate.
+// Larger ones are stored on the heap.
+class ThreadPoolTask {
+ public:
+  static constexpr size_t INLINE_SIZE = 48;
+
+ private:
+  struct Ops {
+    void (*call)(void* storage);
+    // Move the function object from 'from' to 'to', 'from' is left destroyed.
+    void (*move)(void* from, void* to);
+    void (*destroy)(void* storage);
+  };
+
+  template <class Func>
+  struct InlineOps {
+    static void call(void* storage) { (*static_cast<Func*>(storage))(); }
+    static void move(void* from, void* to) {
+      new (to) Func(std::move(*static_cast<Func*>(from)));
+      static_cast<Func*>(from)->~Func();
+    }
+    static void destroy(void* storage) { static_cast<Func*>(storage)->~Func(); }
+    static const Ops ops;
+  };
+
+  template <class Func>
+  struct HeapOps {
+    static Func* get(void* storage) { return *static_cast<Func**>(storage); }
+    static void call(void* storage) { (*get(storage))(); }
+    static void move(void* from, void* to) { new (to) Func*(get(from)); }
+    static void destroy(void* storage) { delete get(storage); }
+    static const Ops ops;
+  };
+
+  using storage_t =
+      typename std::aligned_storage<INLINE_SIZE,
+                                    alignof(std::max_align_t)>::type;
+  storage_t storage_;
+  const Ops* ops_ = nullptr;
+
+ public:
+  // Return if 'Func' is stored inline.
+  template <class Func>
+  static constexpr bool is_inline() noexcept {
+    return sizeof(Func) <= INLINE_SIZE &&
+           alignof(Func) <= alignof(std::max_align_t) &&
+           std::is_nothrow_move_constructible<Func>::value;
+  }
+
+ private:
+  template <class Func, class Func2>
+  void init(Func2&& func, std::true_type /*inline*/) {
+    new (&storage_) Func(std::forward<Func2>(func));
+    ops_ = &InlineOps<Func>::ops;
+  }
+
+  template <class Func, class Func2>
+  void init(Func2&& func, std::false_type /*inline*/) {
+    new (&storage_) Func*(new Func(std::forward<Func2>(func)));
+    ops_ = &HeapOps<Func>::ops;
+  }
+
+ public:
+  ThreadPoolTask() = default;
+  template <class Func,
+            typename = typename std::enable_if<!std::is_same<
+                typename std::decay<Func>::type, ThreadPoolTask>::value>::type>
+  ThreadPoolTask(Func&& func) {  // NOLINT
+    using func_t = typename std::decay<Func>::type;
+    init<func_t>(std::forward<Func>(func),
+                 std::integral_constant<bool, is_inline<func_t>()>());
+  }
+  ThreadPoolTask(ThreadPoolTask&& other) noexcept : ops_(other.ops_) {
+    if (ops_) {
+      ops_->move(&other.storage_, &storage_);
+      other.ops_ = nullptr;
+    }
+  }
+  ThreadPoolTask& operator=(ThreadPoolTask&& other) noexcept {
+    if (this != &other) {
+      reset();
+      if (other.ops_) {
+        other.ops_->move(&other.storage_, &storage_);
+        ops_ = other.ops_;
+        other.ops_ = nullptr;
+      }
+    }
+    return *this;
+  }
+  ThreadPoolTask(const ThreadPoolTask&) = delete;
+  ThreadPoolTask& operator=(const ThreadPoolTask&) = delete;
+  ~ThreadPoolTask() { reset(); }
+
+  void reset() noexcept {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  explicit operator bool() const noexcept { return ops_ != nullptr; }
+  void operator()() { ops_->call(&storage_); }
+};
+
+template <class Func>
+const ThreadPoolTask::Ops ThreadPoolTask::InlineOps<Func>::ops = {
+    &InlineOps<Func>::call, &InlineOps<Func>::move,
+    &InlineOps<Func>::destroy};
+
+template <class Func>
+const ThreadPoolTask::Ops ThreadPoolTask::HeapOps<Func>::ops = {
+    &HeapOps<Func>::call, &HeapOps<Func>::move, &HeapOps<Func>::destroy};
+
 /************************************************************************/
 /* ThreadPool */
 /************************************************************************/
+// ThreadPool is a work-stealing thread pool.
+//
+// Each worker thread owns a task deque.
+// Tasks posted by a worker thread go to its own deque,
+// other tasks are distributed to deques in a round-robin way.
+// A worker thread pops tasks from the back of its own deque,
+// and steals tasks from the front of other deques when its own is empty.
 class ThreadPool {
  public:
   struct WaitToken {
@@ -23,20 +154,61 @@ class ThreadPool {
     int remain = 0;
   };
   using function_t = std::function<void()>;
+  using range_function_t = std::function<void(int, int)>;
+  using task_t = ThreadPoolTask;
   using wait_token_t = WaitToken;
 
  private:
-  mutable std::mutex mutex_;
+  // TaskQueue is a double-ended queue of tasks on a ring buffer.
+  // The buffer grows but never shrinks,
+  // so pushing and popping don't allocate once it is large enough.
+  class TaskQueue {
+   private:
+    std::vector<task_t> buf_;  // the size is 0 or a power of 2
+    size_t head_ = 0;
+    size_t size_ = 0;
+
+   public:
+    bool empty() const noexcept { return size_ == 0; }
+    void push_back(task_t&& task);
+    void pop_back(task_t* task) noexcept;
+    void pop_front(task_t* task) noexcept;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    TaskQueue tasks;
+  };
+
+  std::mutex mutex_;
   std::condition_variable cond_;
-  int started_ = 0;
-  std::forward_list<function_t> tasks_;
+  std::atomic<int> started_{0};
+  std::atomic<int> pending_{0};
+  std::atomic<int> sleeping_{0};
+  std::atomic<unsigned> next_worker_{0};
+  // at least 1 deque, even if no worker thread is started
+  std::vector<std::unique_ptr<Worker>> workers_;
   std::vector<std::thread> threads_;
 
  private:
-  int started() const;
-  void worker_thread();
+  int started() const noexcept { return started_.load(); }
+  // Return the index of the current worker thread of this pool, or -1.
+  int current_worker() const noexcept;
+  bool pop_task(int i, task_t* task);
+  void worker_thread(int i);
+  void wait(wait_token_t* token);
+  static void done(wait_token_t* token);
+  void post_task(task_t&& task);
+
+  template <class Func>
+  static void call_range(void* func, int begin, int end) {
+    (*static_cast<Func*>(func))(begin, end);
+  }
+  void parallel_for_impl(int begin, int end, int grain,
+                         void (*call)(void*, int, int), void* func);
 
  public:
+  ThreadPool();
   ~ThreadPool();
 
   // Start 'n' worker threads.
@@ -45,11 +217,21 @@ class ThreadPool {
   // Run all remaining function objects and stop all worker threads.
   void stop();
 
+  // Return the number of worker threads.
+  int size() const noexcept { return (int)threads_.size(); }
+
   // Post 'func' and return immediately.
   // 'func' will be run in a worker thread.
   //
-  // The thread pool must be started.
-  void post(function_t func);
+  // 'func' is stored in a task_t,
+  // it doesn't allocate if 'func' is small enough.
+  //
+  // The thread pool must be started,
+  // otherwise 'func' is queued until it is started in release builds.
+  template <class Func>
+  void post(Func&& func) {
+    post_task(task_t(std::forward<Func>(func)));
+  }
 
   // Run 'func' in a worker thread and wait for the completion.
   //
@@ -60,6 +242,22 @@ class ThreadPool {
   //
   // The thread pool must be started.
   void run(const std::vector<function_t>& funcs, wait_token_t* token);
+
+  // Split [begin, end) into chunks of 'grain' elements,
+  // run 'func(chunk_begin, chunk_end)' for each chunk and wait for the
+  // completion.
+  //
+  // Chunks are claimed dynamically by worker threads and the calling thread.
+  // If the thread pool is not started, all chunks are run in the calling
+  // thread.
+  //
+  // 'func' is called by reference, it is neither copied nor allocated.
+  template <class Func>
+  void parallel_for(int begin, int end, int grain, Func&& func) {
+    using func_t = typename std::remove_reference<Func>::type;
+    parallel_for_impl(begin, end, grain, &call_range<func_t>,
+                      const_cast<void*>(static_cast<const void*>(&func)));
+  }
 };
 
 }  // namespace deepx_core
@@ -0,0 +1,118 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#pragma once
+#include <deepx_core/common/lru_cache.h>
+#include <deepx_core/contrib/we_ps/client/we_ps_client_impl.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* WePSCachedClient */
+/************************************************************************/
+// WePSCachedClient caches SRM rows in front of another WePSClient.
+//
+// Config:
+// client: name of the underlying client, e.g. "proxy" or "mock".
+// cache_capacity: max # of cached rows per SRM, 0 disables the cache.
+// cache_max_staleness_batch: cached rows are re-fetched after this many
+// batches(calls to 'GetSRM'), 0 means no limit.
+// cache_max_staleness_second: cached rows are re-fetched after this many
+// seconds, 0 means no limit.
+// Other configs are passed to the underlying client.
+//
+// 'UpdateSRM' and 'SetSRM' write through the cache,
+// so only updates from other workers may be stale.
+//
+// Set environment variable 'DEEPX_WE_PS_CACHED_CLIENT_ENABLE_PROFILE=1' to
+// dump hit rates and time costs.
+class WePSCachedClient : public WePSClient {
+ private:
+  struct CachedRow {
+    std::vector<float_t> embedding;
+    int64_t batch = 0;
+    double second = 0;
+  };
+  using cache_t = LRUCache<int_t, CachedRow>;
+
+  struct CacheStat {
+    int64_t hit = 0;
+    int64_t miss = 0;
+    int64_t stale = 0;
+  };
+
+  std::unique_ptr<WePSClient> client_;
+  int cache_capacity_ = 1000000;
+  int cache_max_staleness_batch_ = 10;
+  double cache_max_staleness_second_ = 0;
+  int64_t batch_ = 0;
+  std::unordered_map<std::string, std::unique_ptr<cache_t>> cache_map_;
+  std::unordered_map<std::string, id_set_t> miss_id_set_map_;
+  TensorMap miss_param_;
+
+  int enable_profile_ = 0;
+  std::unordered_map<std::string, CacheStat> stat_map_;
+  double get_srm_nanosecond_ = 0;
+  double client_get_srm_nanosecond_ = 0;
+
+ public:
+  WePSCachedClient();
+  ~WePSCachedClient() override;
+  DEFINE_WE_PS_CLIENT_LIKE(WePSCachedClient);
+  bool InitConfig(const AnyMap& config) override;
+  bool InitConfig(const StringMap& config) override;
+  WePSClient* mutable_client() noexcept { return client_.get(); }
+  const WePSClient& client() const noexcept { return *client_; }
+
+ private:
+  static double Now() noexcept;
+  bool IsFresh(const CachedRow& row, double now) const noexcept;
+  cache_t* GetCache(const std::string& name);
+  // Serve fresh rows of 'id_set' from the cache to 'W'.
+  // Collect the others into 'miss_id_set'.
+  void GetCachedRows(const std::string& name, const id_set_t& id_set,
+                     double now, srm_t* W, id_set_t* miss_id_set);
+  // Copy fetched rows from 'miss_W' to 'W' and the cache.
+  void PutFetchedRows(const std::string& name, const srm_t& miss_W, double now,
+                      srm_t* W);
+  void SetCachedRows(const std::string& name, const srm_t& W);
+  void UpdateCachedRows(const std::string& name, const srm_t& delta_W);
+  void SetCachedRows(const TensorMap& param);
+  void UpdateCachedRows(const TensorMap& delta_param);
+  void DumpProfile() const;
+
+ public:
+  bool SetTSR(const std::string& name, const tsr_t& W) override;
+  bool GetTSR(const std::string& name, tsr_t* W) override;
+  bool UpdateTSR(const std::string& name, const tsr_t& delta_W,
+                 tsr_t* new_W) override;
+
+  bool SetTSR(const TensorMap& param) override;
+  bool GetTSR(TensorMap* param) override;
+  bool UpdateTSR(const TensorMap& delta_param, TensorMap* new_param) override;
+
+  bool SetSRM(const std::string& name, const srm_t& W) override;
+  bool GetSRM(const std::string& name, const id_set_t& id_set,
+              srm_t* W) override;
+  bool UpdateSRM(const std::string& name, const srm_t& delta_W) override;
+
+  bool SetSRM(const TensorMap& param) override;
+  bool GetSRM(const std::unordered_map<std::string, id_set_t>& id_set_map,
+              TensorMap* param) override;
+  bool UpdateSRM(const TensorMap& delta_param) override;
+
+  bool UpdateParam(const TensorMap& delta_param, const TensorMap& new_srm_param,
+                   TensorMap* new_tsr_param) override;
+  bool SetParam(const TensorMap& param) override;
+
+  bool SetGraph(const Graph& graph) override;
+  bool GetGraph(Graph* graph, int* exist) override;
+};
+
+}  // namespace deepx_core
@@ -46,6 +46,20 @@ class WePSClient : public DataType {
       TensorMap* param) = 0;
   virtual bool UpdateSRM(const TensorMap& delta_param) = 0;
 
+  // Update TSRs of 'delta_param' to 'new_tsr_param',
+  // set SRMs of 'new_srm_param', then update SRMs of 'delta_param'.
+  //
+  // The default implementation calls 'UpdateTSR', 'SetSRM' and 'UpdateSRM' in
+  // turn, clients may override it to overlap round trips.
+  virtual bool UpdateParam(const TensorMap& delta_param,
+                           const TensorMap& new_srm_param,
+                           TensorMap* new_tsr_param);
+  // Set TSRs and SRMs of 'param'.
+  //
+  // The default implementation calls 'SetTSR' and 'SetSRM' in turn,
+  // clients may override it to overlap round trips.
+  virtual bool SetParam(const TensorMap& param);
+
   static std::string GetGraphKey() noexcept { return "graph"; }
   virtual bool SetGraph(const Graph& graph) = 0;
   virtual bool GetGraph(Graph* graph, int* exist) = 0;
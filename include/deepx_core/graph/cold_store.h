@@ -0,0 +1,223 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#pragma once
+#include <deepx_core/common/any_map.h>
+#include <deepx_core/common/hash.h>
+#include <deepx_core/common/hash_map.h>
+#include <deepx_core/common/rcu.h>
+#include <deepx_core/common/read_write_lock.h>
+#include <deepx_core/graph/dist_proto.h>
+#include <deepx_core/graph/optimizer.h>
+#include <deepx_core/graph/shard.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/tensor/data_type.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* ColdStore */
+/************************************************************************/
+// ColdStore spills cold SRM rows to local append-only files,
+// so that SRMs can be larger than the memory of a PS.
+//
+// Each SRM param with a memory budget is a tier.
+// A row of the param and its rows of optimizer slots are a record.
+// When the param has more rows than its budget allows,
+// cold records are appended to the file of the tier,
+// and their offsets are indexed in memory.
+// They are faulted back in when their ids are pulled or pushed.
+// A file is compacted when dead records outnumber live ones.
+//
+// Cold records are selected by CLOCK(second chance) over ids in memory,
+// without the write lock, a spill only visits as many ids as it needs.
+// Spilled rows are freed after readers holding 'ViewGuard' leave,
+// so that views of them returned by earlier pulls are still valid.
+//
+// While a 'SaveGuard' is alive, spilled records are streamed from files
+// when their SRMs are written, so that saves don't fault them in.
+class ColdStore : public DataType {
+ private:
+  using offset_map_t = FlatHashMap<int_t, uint64_t, MurmurHash<int_t>>;
+  using tick_map_t = FlatHashMap<int_t, uint64_t, MurmurHash<int_t>>;
+
+  struct Tier {
+    std::string name;
+    // the param and its optimizer slots
+    std::vector<srm_t*> W;
+    size_t max_row = 0;
+    size_t record_size = 0;
+    std::string file;
+    int fd = -1;
+    uint64_t file_size = 0;
+    // id -> offset of its record in 'file'
+    offset_map_t offset_map;
+    size_t offset_map_erased = 0;
+    // id -> tick of its last access
+    tick_map_t tick_map;
+    size_t tick_map_erased = 0;
+    // CLOCK of ids in 'tick_map', (id, its tick when it was passed).
+    // An id accessed since it was passed gets a second chance.
+    std::deque<std::pair<int_t, uint64_t>> clock;
+    // # of rows to spill, set under the write lock.
+    std::atomic<size_t> need{0};
+    // # of records in 'file' not indexed by 'offset_map'
+    size_t dead_record = 0;
+    // # of rows erased from 'W' since the last compaction
+    size_t erased_row = 0;
+  };
+  using access_t = std::vector<std::pair<Tier*, std::vector<int_t>>>;
+  // (id, tick) of ids selected to spill
+  using victim_t = std::vector<std::pair<int_t, uint64_t>>;
+  // victims of each tier
+  using victims_t = std::vector<victim_t>;
+
+  // Spilled rows waiting for a grace period of 'rcu_'.
+  struct Retired {
+    uint64_t ticket = 0;
+    std::vector<srm_t> rows;
+  };
+
+ public:
+  struct Stat {
+    uint64_t fault_in = 0;
+    uint64_t spill = 0;
+    uint64_t compaction = 0;
+  };
+
+ private:
+  std::string file_prefix_;
+  TensorMap* param_ = nullptr;
+  Optimizer* optimizer_ = nullptr;
+  std::vector<std::unique_ptr<Tier>> tiers_;
+  std::unordered_map<std::string, Tier*> tier_map_;
+  std::atomic<uint64_t> tick_{0};
+  std::atomic<uint64_t> access_{0};
+  Stat stat_;
+  int use_lock_ = 0;
+  std::unique_ptr<ReadWriteLock> lock_;
+  // 'tick_map' and 'clock' of tiers
+  std::unique_ptr<std::mutex> tick_lock_;
+  std::unique_ptr<std::mutex> select_lock_;
+  mutable RCU rcu_;
+  std::deque<Retired> retired_;
+
+ public:
+  // Files are '<file_prefix>.<index of tier>'.
+  void set_file_prefix(const std::string& file_prefix) {
+    file_prefix_ = file_prefix;
+  }
+  const std::string& file_prefix() const noexcept { return file_prefix_; }
+  // # of spilled rows of all tiers.
+  size_t size() const noexcept;
+  // # of spilled rows of the tier of 'name'.
+  size_t size(const std::string& name) const noexcept;
+  // max # of rows in memory of the tier of 'name'.
+  size_t max_row(const std::string& name) const noexcept;
+  const Stat& stat() const noexcept { return stat_; }
+
+ public:
+  ColdStore() = default;
+  ~ColdStore();
+  ColdStore(const ColdStore&) = delete;
+  ColdStore& operator=(const ColdStore&) = delete;
+
+  // Rows spilled while a 'ViewGuard' is alive are not freed until it is
+  // destroyed, so views of rows(see 'Model::Pull') stay valid.
+  class ViewGuard {
+   private:
+    RCU::reader_t reader_;
+
+   public:
+    explicit ViewGuard(const ColdStore& cold_store) noexcept
+        : reader_(cold_store.rcu_.ReadLock()) {}
+    ~ViewGuard() { RCU::ReadUnlock(reader_); }
+    ViewGuard(const ViewGuard&) = delete;
+    ViewGuard& operator=(const ViewGuard&) = delete;
+  };
+
+  // Attach spilled rows of 'shard_id' under 'shard'(all rows if 'shard'
+  // is null) to SRMs of 'param' and 'optimizer' of the same names during
+  // its life(see 'SRMExtraRows').
+  // 'param' and 'optimizer' can be other than those of 'Init', e.g. those
+  // of an exported shard, either of them can be nullptr.
+  class SaveGuard {
+   private:
+    std::vector<srm_t*> W_;
+    std::vector<std::unique_ptr<SRMExtraRows>> extra_rows_;
+
+   public:
+    // 'cold_store' can be nullptr, then it does nothing.
+    SaveGuard(const ColdStore* cold_store, TensorMap* param,
+              Optimizer* optimizer, const Shard* shard = nullptr,
+              int shard_id = 0);
+    ~SaveGuard();
+    SaveGuard(const SaveGuard&) = delete;
+    SaveGuard& operator=(const SaveGuard&) = delete;
+  };
+
+ private:
+  std::unique_lock<std::mutex> LockTick() const;
+  void CloseFiles() noexcept;
+  void Track(Tier* tier);
+  void Touch(const access_t& access, uint64_t tick);
+  bool NeedFaultIn(const access_t& access) const;
+  void FaultIn(Tier* tier, const std::vector<int_t>& ids);
+  void FaultIn(const access_t& access);
+  void Select(Tier* tier, victim_t* victims);
+  void Select(victims_t* victims);
+  void Spill(Tier* tier, const victim_t& victims, Retired* retired);
+  void Spill(const victims_t& victims, std::deque<Retired>* freed);
+  void MaybeCompactFile(Tier* tier);
+  void MaybeCompactRows(Tier* tier);
+  uint64_t CountSpilled(const Tier* tier, const Shard* shard,
+                        int shard_id) const;
+  void WriteSpilled(OutputStream& os, const Tier* tier, size_t i,  // NOLINT
+                    const Shard* shard, int shard_id) const;
+  void Access(const access_t& access, const std::function<void()>& func);
+  void AddAccess(const std::string& name, const srm_t& W,
+                 access_t* access) const;
+
+ public:
+  void Init(TensorMap* param, Optimizer* optimizer) noexcept;
+  // 'config' maps names of SRM params to their memory budgets in MB.
+  // A budget covers rows of the param and of its optimizer slots.
+  bool InitConfig(const StringMap& config);
+  void InitLock();
+
+ public:
+  // thread safe after 'InitLock'
+  //
+  // Fault in rows of ids of 'pull_request', then call 'func',
+  // during which no row is spilled.
+  void Pull(const PullRequest& pull_request, const std::function<void()>& func);
+  // Fault in rows of ids of 'grad' and 'overwritten_param'(can be nullptr),
+  // then call 'func', during which no row is spilled.
+  void Push(const TensorMap& grad, const TensorMap* overwritten_param,
+            const std::function<void()>& func);
+
+ public:
+  // They are not thread safe.
+
+  // Spill rows of each tier down to its budget.
+  void Spill();
+  // Fault in all spilled rows, e.g. before the model is saved.
+  void Restore();
+  // Drop spilled rows of 'ids', e.g. expired ones.
+  void Remove(const id_set_t& ids);
+  // Drop spilled rows of ids for which 'func' returns true.
+  void RemoveIf(const std::function<bool(int_t id)>& func);
+};
+
+}  // namespace deepx_core
@@ -159,6 +159,15 @@ class FeatureKVUtil : public DataType {
   static bool SaveModel(const std::string& file, const Graph& graph,
                         const TensorMap& param, const id_set_t& id_set,
                         int version);
+  // Read a model written by 'WriteModel', e.g. a delta of changed ids.
+  // 'param' must have been initialized for 'graph'.
+  // Dense params of 'param' are overwritten(views of them are replaced by
+  // copies), sparse params of 'param' are cleared and filled with rows in
+  // 'is'.
+  static bool ReadModel(InputStream& is,  // NOLINT
+                        const Graph& graph, TensorMap* param);
+  static bool LoadModel(const std::string& file, const Graph& graph,
+                        TensorMap* param);
 
  public:
   struct ParamParserStat {
@@ -36,6 +36,7 @@ class FreqStore : public DataType {
     return freq_filter_threshold_;
   }
   const TensorMap& param() const noexcept { return *param_; }
+  size_t size() const noexcept { return id_freq_map_.size(); }
 
  public:
   void Init(const TensorMap* param) noexcept;
@@ -46,6 +47,11 @@ class FreqStore : public DataType {
   bool Save(const std::string& file) const;
   bool Load(const std::string& file);
   void Merge(FreqStore* other, const Shard* shard = nullptr, int shard_id = 0);
+  // Move ids of 'shard_id' under 'shard'(all ids if 'shard' is null)
+  // to 'other', overwriting its frequencies.
+  //
+  // Not thread safe, it is used to migrate ids between shards.
+  void Split(FreqStore* other, const Shard* shard = nullptr, int shard_id = 0);
   void RemoveIf(
       const std::function<bool(const id_freq_map_t::value_type&)>& func);
 
@@ -1731,6 +1731,89 @@ class BatchNormNode : public GraphNode {
   DEFINE_GRAPH_NODE_LIKE(BatchNormNode);
 };
 
+/************************************************************************/
+/* fused op */
+/************************************************************************/
+// Fused ops are created by the graph simplifier.
+class FusedFullyConnectNode : public GraphNode {
+ public:
+  enum ACTIVATION {
+    ACTIVATION_NONE = 0,
+    ACTIVATION_RELU = 1,
+    ACTIVATION_SIGMOID = 2,
+    ACTIVATION_TANH = 3,
+  };
+
+ private:
+  int activation_ = ACTIVATION_NONE;
+  DEFINE_GRAPH_NODE_ATTR(FusedFullyConnectNode, activation_);
+
+ public:
+  int activation() const noexcept { return activation_; }
+
+ public:
+  FusedFullyConnectNode(std::string name, GraphNode* X, GraphNode* W,
+                        int activation);
+  FusedFullyConnectNode(std::string name, GraphNode* X, GraphNode* W,
+                        GraphNode* b, int activation);
+  DEFINE_GRAPH_NODE_LIKE(FusedFullyConnectNode);
+};
+
+class FusedElementWiseNode : public GraphNode {
+ public:
+  enum FUSED_OP {
+    FUSED_OP_NONE = 0,
+    // unary, Z = f(Z)
+    FUSED_OP_SIGMOID = 1,
+    FUSED_OP_TANH = 2,
+    FUSED_OP_RELU = 3,
+    FUSED_OP_EXP = 4,
+    FUSED_OP_LOG = 5,
+    FUSED_OP_NEGATE = 6,
+    FUSED_OP_INV = 7,
+    FUSED_OP_SQRT = 8,
+    FUSED_OP_SQUARE = 9,
+    // binary, Z = f(Z, Y)
+    FUSED_OP_ADD = 101,
+    FUSED_OP_SUB = 102,   // Z - Y
+    FUSED_OP_RSUB = 103,  // Y - Z
+    FUSED_OP_MUL = 104,
+  };
+  enum { MAX_FUSED_OP = 16 };
+
+ private:
+  std::vector<int> ops_;
+  std::vector<int> operands_;
+  DEFINE_GRAPH_NODE_ATTR(FusedElementWiseNode, ops_, operands_);
+
+ public:
+  const std::vector<int>& ops() const noexcept { return ops_; }
+  const std::vector<int>& operands() const noexcept { return operands_; }
+  static bool IsUnaryOp(int op) noexcept;
+  static bool IsBinaryOp(int op) noexcept;
+  // Return if Y is the same shape as Z, or can be broadcast to Z as a
+  // scalar(all dims are 1) or a row(all dims but the last are 1).
+  static bool IsBroadcastable(const Shape& Z, const Shape& Y) noexcept;
+
+ public:
+  // Z starts from X[0], 'ops[i]' is applied to Z in order.
+  // 'operands[i]' is the index of Y in X for binary ops, -1 for unary ops.
+  // Y of binary ops has the same shape as X[0], or is broadcast to X[0]
+  // as a scalar or a row.
+  FusedElementWiseNode(std::string name, std::vector<GraphNode*> X,
+                       std::vector<int> ops, std::vector<int> operands);
+  DEFINE_GRAPH_NODE_LIKE(FusedElementWiseNode);
+};
+
+// Mean of SigmoidBCELoss(X, Y) or Mul(SigmoidBCELoss(X, Y), W).
+class FusedSigmoidBCELossNode : public GraphNode {
+ public:
+  FusedSigmoidBCELossNode(std::string name, GraphNode* X, GraphNode* Y);
+  FusedSigmoidBCELossNode(std::string name, GraphNode* X, GraphNode* Y,
+                          GraphNode* W);
+  DEFINE_GRAPH_NODE_LIKE(FusedSigmoidBCELossNode);
+};
+
 /************************************************************************/
 /* fast node creator */
 /************************************************************************/
@@ -2047,4 +2130,16 @@ DEFINE_GRAPH_NODE_CREATOR(StopGrad)
 // DEFINE_GRAPH_NODE_CREATOR(BatchNorm)
 // use BatchNorm in graph_module_creator.h
 
+DEFINE_GRAPH_NODE_CREATOR(FusedFullyConnect)
+
+// DEFINE_GRAPH_NODE_CREATOR(FusedElementWise)
+inline GraphNode* FusedElementWise(std::string name, std::vector<GraphNode*> X,
+                                   std::vector<int> ops,
+                                   std::vector<int> operands) {
+  return new FusedElementWiseNode(std::move(name), std::move(X), std::move(ops),
+                                  std::move(operands));
+}
+
+DEFINE_GRAPH_NODE_CREATOR(FusedSigmoidBCELoss)
+
 }  // namespace deepx_core
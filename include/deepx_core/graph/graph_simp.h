@@ -11,6 +11,9 @@ namespace deepx_core {
 struct SimpConfig {
   int max_iteration = 2;
   int use_static_shape = 0;
+  // Fuse chains of nodes into fused nodes, e.g. FullyConnect + bias +
+  // activation, element-wise ops and the loss head.
+  int enable_fusion = 0;
 };
 
 // Simplify graph.
@@ -0,0 +1,93 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#pragma once
+#include <deepx_core/graph/dist_proto.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/tensor/data_type.h>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* HotIdCache */
+/************************************************************************/
+// HotIdCache is a worker side read-mostly replica of the rows of hot ids.
+//
+// Ids in pull requests are sampled, 1 of every 'sample_period' ids on
+// average, into a frequency counter.
+// Every 'refresh_batch' batches, the 'size' most frequently sampled ids
+// become hot and the counter decays by half.
+//
+// Rows of hot ids are copied from pull responses and served locally
+// for at most 'max_staleness_batch' batches, after that they are pulled
+// again from their PSs.
+// In this way, pulls of a hot id from all batches within a staleness
+// window are coalesced into one and the PSs owning hot ids are unloaded.
+// Gradients of hot ids are still pushed to their PSs.
+class HotIdCache : public DataType {
+ private:
+  size_t size_ = 0;
+  int sample_period_ = 1;
+  int refresh_batch_ = 1;
+  int max_staleness_batch_ = 0;
+
+  std::default_random_engine engine_;
+  std::unique_ptr<std::geometric_distribution<int>> skip_;
+  int next_sample_ = 0;
+  std::unordered_map<int_t, uint64_t> freq_map_;
+  id_set_t hot_id_set_;
+
+  struct CachedSRM {
+    srm_t W;
+    // id -> batch at which the row is pulled
+    std::unordered_map<int_t, uint64_t> batch_map;
+  };
+  std::unordered_map<std::string, CachedSRM> cache_;
+  uint64_t batch_ = 0;
+
+ public:
+  struct Stat {
+    uint64_t hit = 0;
+    uint64_t miss = 0;
+    uint64_t stale = 0;
+  };
+
+ private:
+  Stat stat_;
+
+ public:
+  size_t size() const noexcept { return size_; }
+  int sample_period() const noexcept { return sample_period_; }
+  int refresh_batch() const noexcept { return refresh_batch_; }
+  int max_staleness_batch() const noexcept { return max_staleness_batch_; }
+  const id_set_t& hot_id_set() const noexcept { return hot_id_set_; }
+  const Stat& stat() const noexcept { return stat_; }
+  bool enabled() const noexcept { return size_ > 0; }
+
+ private:
+  bool Sample() noexcept;
+  void Refresh();
+
+ public:
+  // 'size' = 0 disables the cache.
+  void Init(size_t size, int sample_period, int refresh_batch,
+            int max_staleness_batch, uint32_t seed = 0);
+
+  // Start a batch.
+  //
+  // Remove ids whose rows are fresh in the cache from 'pull_request',
+  // and put their rows to 'cached_param'.
+  void Filter(PullRequest* pull_request, TensorMap* cached_param);
+
+  // Copy rows of hot ids from 'param' which is pulled from a PS.
+  void Put(const TensorMap& param);
+};
+
+}  // namespace deepx_core
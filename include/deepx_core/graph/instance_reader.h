@@ -6,6 +6,7 @@
 #include <deepx_core/common/any_map.h>
 #include <deepx_core/graph/tensor_map.h>
 #include <deepx_core/tensor/data_type.h>
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -35,6 +36,12 @@ class InstanceReader : public DataType {
   virtual bool InitConfig(const AnyMap& config) = 0;
   virtual bool InitConfig(const StringMap& config) = 0;
   virtual bool Open(const std::string& file) = 0;
+  // Open the byte range ['offset', 'offset' + 'length') of 'file'.
+  // Lines starting in the range are read,
+  // a line across the end of the range is read to its end.
+  // 'length' 0 means to the end of 'file'.
+  virtual bool Open(const std::string& file, uint64_t offset,
+                    uint64_t length) = 0;
   virtual void Close() noexcept = 0;
   virtual bool GetBatch(Instance* inst) = 0;
 };
@@ -30,6 +30,10 @@ class InstanceReaderImpl : public InstanceReader {
   int has_uuid_ = 0;
 
   AutoInputFileStream is_;
+  // Position of the next line and the end of the range in bytes,
+  // 'end_' 0 means no range.
+  uint64_t pos_ = 0;
+  uint64_t end_ = 0;
   std::string line_;
   tsr_t* Y_ = nullptr;
   tsr_t* W_ = nullptr;
@@ -39,6 +43,8 @@ class InstanceReaderImpl : public InstanceReader {
   bool InitConfig(const AnyMap& config) override;
   bool InitConfig(const StringMap& config) override;
   bool Open(const std::string& file) override;
+  bool Open(const std::string& file, uint64_t offset,
+            uint64_t length) override;
   void Close() noexcept override { is_.Close(); }
   bool GetBatch(Instance* inst) override;
 
@@ -49,6 +55,9 @@ class InstanceReaderImpl : public InstanceReader {
   virtual void InitX(Instance* inst) = 0;
   virtual void InitXBatch(Instance* inst) = 0;
   virtual bool ParseLine() = 0;
+
+ private:
+  bool GetLineInRange();
 };
 
 }  // namespace deepx_core
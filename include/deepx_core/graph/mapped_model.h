@@ -0,0 +1,64 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#pragma once
+#include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/tensor/data_type.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* MappedModel */
+/************************************************************************/
+// MappedModel is an immutable serving format of model params,
+// which is opened via mmap instead of being deserialized.
+//
+// Layout of a file.
+//   header, 64 bytes
+//     magic, version, sizeof(float_t), sizeof(int_t),
+//     offset and size of the directory
+//   blocks, each is aligned to 64 bytes
+//     TSR: its data
+//     SRM: bucket offsets, ids and contiguous rows of 'SRMMappedIndex'
+//   directory
+//     names, types, shapes and offsets of blocks of params
+//
+// Opened params are views of the mapping,
+// so that startup is independent of the model size and page cache of
+// the file is shared by processes on a host.
+// TSRs are read-only views, SRMs serve const lookups from their mapped
+// indices, see 'SparseRowMatrix::set_mapped'.
+class MappedModel : public DataType {
+ private:
+  std::string file_;
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+
+ public:
+  const std::string& file() const noexcept { return file_; }
+  size_t size() const noexcept { return size_; }
+
+ public:
+  MappedModel() = default;
+  ~MappedModel();
+  MappedModel(const MappedModel&) = delete;
+  MappedModel& operator=(const MappedModel&) = delete;
+
+ public:
+  // Convert 'param' to 'file'.
+  // Only TSRs and SRMs are supported, mapped rows of SRMs are not written.
+  static bool Save(const std::string& file, const TensorMap& param);
+
+  // Map 'file' and view its params in 'param',
+  // which are valid until 'Close' or destruction.
+  //
+  // If 'populate' is true, pages are read ahead at once.
+  bool Open(const std::string& file, TensorMap* param, bool populate = false);
+  void Close() noexcept;
+};
+
+}  // namespace deepx_core
@@ -56,14 +56,31 @@ class Model : public DataType {
   bool SaveFeatureKV(const std::string& file,
                      int feature_kv_protocol_version) const;
   void Merge(Model* other, const Shard* shard = nullptr, int shard_id = 0);
+  // Move params of 'shard_id' under 'shard'(all params if 'shard' is null)
+  // to 'other', overwriting its entries and creating missing ones.
+  //
+  // Not thread safe, it is used to migrate params between shards.
+  void Split(Model* other, const Shard* shard = nullptr, int shard_id = 0);
 
  public:
   bool HasSRM() const noexcept;
   void RemoveZerosSRM();
   void ForEachSRM(const std::function<void(const std::string&, srm_t*)>& func);
   // thread safe after 'InitLock'
+  //
+  // 'remote_param' views params by default.
+  // If 'copy' is 1, it owns copies of params taken under the param locks,
+  // which stay valid while params are updated, erased or spilled.
   void Pull(std::default_random_engine& engine,  // NOLINT
-            const PullRequest& pull_request, TensorMap* remote_param);
+            const PullRequest& pull_request, TensorMap* remote_param,
+            int copy = 0);
+  // thread safe after 'InitLock'
+  //
+  // Write params of 'pull_request' to 'os' as a TensorMap under the param
+  // locks, rows are viewed in 'remote_param' and copied only to 'os'.
+  void Pull(std::default_random_engine& engine,  // NOLINT
+            const PullRequest& pull_request, TensorMap* remote_param,
+            OutputStream& os);  // NOLINT
   void SetParam(std::vector<std::unique_ptr<TensorMap>>* remote_params);
   // thread safe after 'InitLock'
   void Update(TensorMap* param);
@@ -0,0 +1,47 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#pragma once
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/tensor/data_type.h>
+#include <cstddef>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* ModelQuantizer */
+/************************************************************************/
+// ModelQuantizer converts params of a model to predict-only quantized
+// params for serving, values are int8 with float scales or fp16.
+//
+// Dense params used only as the right operand of FullyConnect,
+// FusedFullyConnect, GEMM, Matmul and Matmul2 without transposition
+// are quantized with a scale per column(output channel).
+// Params used only by GroupEmbeddingLookup and GroupEmbeddingLookup2
+// are quantized with a scale per row, either all or none of params of
+// a lookup are quantized.
+// Rows too narrow for int8 are quantized to fp16.
+// Other params are copied.
+//
+// Activations and accumulations stay in float,
+// kernels of these operators dequantize params on the fly,
+// once they find quantized params in 'TensorMap'.
+class ModelQuantizer : public DataType {
+ private:
+  const Graph* graph_ = nullptr;
+  int dtype_ = TENSOR_DTYPE_INT8;
+
+ public:
+  // 'dtype' is TENSOR_DTYPE_INT8 or TENSOR_DTYPE_FLOAT16.
+  void Init(const Graph* graph, int dtype);
+  bool Quantize(const TensorMap& param, TensorMap* qparam) const;
+
+ public:
+  static bool HasQuantizedParam(const TensorMap& param) noexcept;
+  // bytes of values of TSRs, SRMs and quantized params
+  static size_t GetValueBytes(const TensorMap& param) noexcept;
+};
+
+}  // namespace deepx_core
@@ -5,6 +5,7 @@
 
 #pragma once
 #include <deepx_core/common/thread_pool.h>
+#include <deepx_core/graph/cold_store.h>
 #include <deepx_core/graph/dist_proto.h>
 #include <deepx_core/graph/freq_store.h>
 #include <deepx_core/graph/graph.h>
@@ -37,6 +38,7 @@ class ModelShard : public DataType {
   std::unique_ptr<TSStore> ts_store_;
   std::unique_ptr<FreqStore> freq_store_;
   std::unique_ptr<OLStore> ol_store_;
+  std::unique_ptr<ColdStore> cold_store_;
   std::unique_ptr<ThreadPool> thread_pool_;
 
  public:
@@ -60,6 +62,8 @@ class ModelShard : public DataType {
   const FreqStore& freq_store() const noexcept { return *freq_store_; }
   OLStore* mutable_ol_store() noexcept { return ol_store_.get(); }
   const OLStore& ol_store() const noexcept { return *ol_store_; }
+  ColdStore* mutable_cold_store() noexcept { return cold_store_.get(); }
+  const ColdStore& cold_store() const noexcept { return *cold_store_; }
 
  private:
   // backward compatibility
@@ -124,8 +128,22 @@ class ModelShard : public DataType {
   bool InitOptimizerConfig(const std::string& optimizer_config);
   bool InitTSStore(ts_t now, ts_t expire_threshold);
   bool InitFreqStore(freq_t freq_filter_threshold);
-  bool InitOLStore(freq_t update_threshold, float_t distance_threshold);
+  bool InitOLStore(freq_t update_threshold, float_t distance_threshold,
+                   int baseline_type = OL_STORE_BASELINE_TYPE_FP32);
+  // 'cold_store_config' maps names of SRM params to their memory budgets
+  // in MB, e.g. "emb1=1024;emb2=512"(see 'ColdStore').
+  // Cold rows are spilled to files in local directory 'dir'.
+  //
+  // It is called after model and optimizer are initialized or loaded.
+  bool InitColdStore(const std::string& dir,
+                     const std::string& cold_store_config);
   bool InitLock();
+  // Reserve each SRM of model and optimizer for 'expected_id' rows,
+  // the expected # of ids of this shard,
+  // and set their rehash steps(see 'SparseRowMatrix::set_rehash_step').
+  //
+  // It is called after model and optimizer are initialized or loaded.
+  void ReserveSRM(size_t expected_id, size_t rehash_step);
 
   // backward compatibility
   bool SaveModelLegacy(const std::string& dir) const;
@@ -198,11 +216,55 @@ class ModelShard : public DataType {
 
  public:
   // thread safe after 'InitLock'
-  void Pull(PullRequest* pull_request, TensorMap* param);
+  // 'copy' is the same as that of 'Model::Pull'.
+  void Pull(PullRequest* pull_request, TensorMap* param, int copy = 0);
+  // thread safe after 'InitLock'
+  // It is the same as that of 'Model::Pull' writing to 'os'.
+  void Pull(PullRequest* pull_request, TensorMap* param,
+            OutputStream& os);  // NOLINT
   // thread safe after 'InitLock'
   // 'overwritten_param' can be nullptr.
   void Push(TensorMap* grad, TensorMap* overwritten_param);
   void ExpireTSStore();
+  // Fault in all rows spilled by ColdStore.
+  // The model and the optimizer stream spilled rows when they are saved,
+  // other formats, e.g. text and feature kv models, need them in memory.
+  // Not thread safe.
+  void RestoreColdStore();
+
+ private:
+  void _Pull(PullRequest* pull_request, TensorMap* param, int copy);
+  void _Push(TensorMap* grad, TensorMap* overwritten_param);
+
+ private:
+  // Move entries of 'shard_id' under 'shard'(all entries if 'shard' is null)
+  // to 'other', whose members are created on demand.
+  bool Split(ModelShard* other, const Shard* shard, int shard_id);
+
+ public:
+  // Shard migration moves entries between shards without checkpoints,
+  // while training is paused.
+  //
+  // 1. Each shard exports entries of each other shard under the new shard.
+  // 2. The exported entries are imported by the other shard.
+  // 3. Each shard commits the new shard,
+  //    entries owned by other shards are dropped.
+  //
+  // Entries of model, optimizer, TSStore and FreqStore are migrated,
+  // entries of OLStore are not.
+  //
+  // They are not thread safe.
+
+  // Write copies of entries of 'shard_id' under 'shard' to 'os'.
+  // Rows spilled by ColdStore are streamed from its files.
+  bool ExportShard(const Shard* shard, int shard_id,
+                   OutputStream& os);  // NOLINT
+  // Read entries written by 'ExportShard' from 'is',
+  // overwriting existing ones.
+  bool ImportShard(InputStream& is);  // NOLINT
+  // Drop entries not owned by 'shard_id' under 'shard',
+  // then call 'InitShard(shard, shard_id)'.
+  bool CommitShard(const Shard* shard, int shard_id);
 
  public:
   bool InitThreadPool();
@@ -5,17 +5,40 @@
 //
 
 #pragma once
+#include <deepx_core/common/any_map.h>
+#include <deepx_core/common/hash.h>
+#include <deepx_core/common/hash_map.h>
 #include <deepx_core/graph/graph.h>
 #include <deepx_core/graph/tensor_map.h>
 #include <deepx_core/tensor/data_type.h>
+#include <cstddef>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace deepx_core {
 
 /************************************************************************/
 /* OLStore */
 /************************************************************************/
+enum OL_STORE_BASELINE_TYPE {
+  // Float copies of embeddings, distances are exact.
+  OL_STORE_BASELINE_TYPE_FP32 = 0,
+  // Per-row int8 quantized copies of embeddings,
+  // 'col + 4' bytes per row instead of '4 * col' bytes.
+  // The error of each element is at most 'max_abs(row) / 254',
+  // so the error of distances is at most 'sqrt(col) * max_abs(row) / 254'.
+  OL_STORE_BASELINE_TYPE_INT8 = 1,
+};
+
+// OLStore collects ids of SRMs to be exported in online learning.
+//
+// An id is collected if it is new, if it is updated more than
+// 'update_threshold' times, or if the euclidean distance between its
+// embedding and the baseline, the embedding when it was last collected,
+// is greater than 'distance_threshold'.
 class OLStore : public DataType {
  private:
   struct State {
@@ -24,13 +47,50 @@ class OLStore : public DataType {
   using srm_state_t = std::unordered_map<int_t, State>;
   using srm_state_map_t = std::unordered_map<std::string, srm_state_t>;
 
+  // Baseline embeddings of an SRM.
+  // Rows are stored in fixed size blocks, which are never reallocated.
+  class SRMBaseline {
+   private:
+    static constexpr size_t BLOCK_ROW = 4096;
+    int type_ = OL_STORE_BASELINE_TYPE_FP32;
+    int col_ = 0;
+    size_t row_bytes_ = 0;
+    size_t row_ = 0;
+    HashMap<int_t, size_t, MurmurHash<int_t>> row_index_;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+
+   private:
+    char* GetRow(size_t index) const noexcept {
+      return blocks_[index / BLOCK_ROW].get() + index % BLOCK_ROW * row_bytes_;
+    }
+
+   public:
+    void Init(int type, int col);
+    size_t size() const noexcept { return row_; }
+    // Approximate memory usage in bytes.
+    size_t bytes() const noexcept;
+    void Assign(int_t id, const float_t* embedding);
+    // Return false if 'id' has no baseline.
+    bool Get(int_t id, float_t* embedding) const;
+  };
+  using srm_baseline_map_t = std::unordered_map<std::string, SRMBaseline>;
+
   freq_t update_threshold_ = 0;
   float_t distance_threshold_ = 0;
+  int baseline_type_ = OL_STORE_BASELINE_TYPE_FP32;
 
   const Graph* graph_ = nullptr;
   const TensorMap* param_ = nullptr;
-  TensorMap prev_param_;
+  srm_baseline_map_t srm_baseline_map_;
+  // states updated since the last 'Collect'
   srm_state_map_t srm_state_map_;
+  // states not collected by previous 'Collect'
+  srm_state_map_t pending_srm_state_map_;
+  int use_lock_ = 0;
+  const AnyMap* param_lock_ = nullptr;
+  std::unique_ptr<std::mutex> srm_state_map_lock_;
+  // lock of 'srm_baseline_map_' and 'pending_srm_state_map_'
+  std::unique_ptr<std::mutex> collect_lock_;
 
  public:
   void set_update_threshold(freq_t update_threshold) noexcept {
@@ -41,14 +101,26 @@ class OLStore : public DataType {
     distance_threshold_ = distance_threshold;
   }
   float_t distance_threshold() const noexcept { return distance_threshold_; }
+  void set_baseline_type(int baseline_type) noexcept {
+    baseline_type_ = baseline_type;
+  }
+  int baseline_type() const noexcept { return baseline_type_; }
   const Graph& graph() const noexcept { return *graph_; }
   const TensorMap& param() const noexcept { return *param_; }
 
  public:
   void Init(const Graph* graph, const TensorMap* param) noexcept;
   bool InitParam();
+  // 'param_lock' is the param lock of Model.
+  void InitLock(const AnyMap* param_lock);
+  // Approximate memory usage of baselines in bytes.
+  size_t baseline_bytes() const noexcept;
+
+ public:
+  // thread safe after 'InitLock'
   void Update(TensorMap* param);
   // for unit test
+  // thread safe after 'InitLock'
   id_set_t Collect();
 
  private:
@@ -18,6 +18,10 @@ namespace deepx_core {
 /************************************************************************/
 /* OpContext */
 /************************************************************************/
+// Set environment variable 'DEEPX_OP_CONTEXT_INTRA_OP_THREAD=n' or call
+// 'set_intra_op_thread(n)' to let heavy kernels use up to n threads.
+// The default 1 keeps kernels in the calling thread,
+// which suits hogwild training with many OpContext threads.
 class OpContext : public DataType {
  private:
   const Graph* graph_ = nullptr;
@@ -61,6 +65,15 @@ class OpContext : public DataType {
   TensorMap* mutable_overwritten_ptr() noexcept { return &overwritten_ptr_; }
   const TensorMap& overwritten_ptr() const noexcept { return overwritten_ptr_; }
 
+ private:
+  int intra_op_thread_ = 1;
+
+ public:
+  void set_intra_op_thread(int intra_op_thread) noexcept {
+    intra_op_thread_ = intra_op_thread > 1 ? intra_op_thread : 1;
+  }
+  int intra_op_thread() const noexcept { return intra_op_thread_; }
+
  private:
   int enable_profile_ = 0;
   struct OpProfile {
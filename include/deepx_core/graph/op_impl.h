@@ -104,6 +104,24 @@ class OpImpl : public Op {
     return ptr_->get<tsrs_t*>(node->name());
   }
 
+  // Return nullptr if the param of 'node' is not quantized.
+  const qtsr_t* GetPtrQTSR(const GraphNode* node) {
+    auto it = ptr_->find(node->name());
+    if (it == ptr_->end() || !it->second.is<const qtsr_t*>()) {
+      return nullptr;
+    }
+    return it->second.unsafe_to_ref<const qtsr_t*>();
+  }
+
+  // Return nullptr if the param of 'node' is not quantized.
+  const qsrm_t* GetPtrQSRM(const GraphNode* node) {
+    auto it = ptr_->find(node->name());
+    if (it == ptr_->end() || !it->second.is<const qsrm_t*>()) {
+      return nullptr;
+    }
+    return it->second.unsafe_to_ref<const qsrm_t*>();
+  }
+
   tsr_t* InitPtrTSR(const GraphNode* node, tsr_t* tsr) {
     (*ptr_)[node->name()] = tsr;
     return tsr;
@@ -129,6 +147,16 @@ class OpImpl : public Op {
     return tsrs;
   }
 
+  const qtsr_t* InitPtrQTSR(const GraphNode* node, const qtsr_t* qtsr) {
+    (*ptr_)[node->name()] = qtsr;
+    return qtsr;
+  }
+
+  const qsrm_t* InitPtrQSRM(const GraphNode* node, const qsrm_t* qsrm) {
+    (*ptr_)[node->name()] = qsrm;
+    return qsrm;
+  }
+
   tsr_t* InitGradTSR(const GraphNode* node, const Shape& shape) {
     if (node->need_grad()) {
       auto& G = grad_->get_or_insert<tsr_t>(node->name());
@@ -38,6 +38,12 @@ class Optimizer : public DataType {
                            int shard_id = 0) = 0;
   virtual bool Merge(Optimizer* other, const Shard* shard = nullptr,
                      int shard_id = 0) = 0;
+  // Move slots of 'shard_id' under 'shard'(all slots if 'shard' is null)
+  // to 'other', overwriting its entries and creating missing ones.
+  //
+  // Not thread safe, it is used to migrate slots between shards.
+  virtual bool Split(Optimizer* other, const Shard* shard = nullptr,
+                     int shard_id = 0) = 0;
 
  public:
   // thread safe after 'InitLock'
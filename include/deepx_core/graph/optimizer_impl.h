@@ -207,6 +207,7 @@ class OptimizerImpl : public Optimizer {
   bool Read(InputStream& is) override;
   bool MergeLegacy(Optimizer* other, const Shard* shard, int shard_id) override;
   bool Merge(Optimizer* other, const Shard* shard, int shard_id) override;
+  bool Split(Optimizer* other, const Shard* shard, int shard_id) override;
 
  public:
   void Update(TensorMap* grad) override;
@@ -0,0 +1,100 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#pragma once
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/op.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/tensor/data_type.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* PredictPlan */
+/************************************************************************/
+// PredictPlan is a frozen execution plan of predict targets
+// at a fixed batch size.
+//
+// 'Freeze' runs 'InitPredict' of all ops once, so tensor pointers are
+// resolved and hidden tensors are sized ahead of time.
+// 'Predict' then only runs the kernels of hidden nodes in a flat array,
+// without map lookups, shape inference or buffer resizing.
+//
+// Usage.
+//   plan.Init(graph, param);
+//   plan.InitOp(target_names);
+//   // Optionally fill instance tensors whose shapes are not (batch, ...).
+//   plan.Freeze(batch);
+//   for each request:
+//     // Refill instance tensors in place, keeping their shapes.
+//     plan.Predict();
+//     // Read plan.target(i).
+//
+// Instance tensors must be got by 'get' or 'get_or_insert' of
+// 'mutable_inst()', 'insert' replaces them and invalidates the plan.
+// CSR must keep its # of rows, TSR/TSRI/TSRS must keep their shapes.
+class PredictPlan : public DataType {
+ private:
+  const Graph* graph_ = nullptr;
+  TensorMap* param_ = nullptr;
+  std::vector<std::unique_ptr<Op>> ops_;
+  std::vector<const GraphNode*> op_nodes_;
+  std::vector<const GraphNode*> target_nodes_;
+  Hidden hidden_;
+  TensorMap ptr_;
+  TensorMap grad_;
+  TensorMap grad_ptr_;
+  TensorMap overwritten_param_;
+  TensorMap overwritten_ptr_;
+  int intra_op_thread_ = 1;
+
+  // frozen
+  int batch_ = 0;
+  std::vector<Op*> kernels_;
+  std::vector<const tsr_t*> targets_;
+  struct InstanceCheck {
+    const GraphNode* node = nullptr;
+    const csr_t* csr = nullptr;
+    int row = 0;
+    const Shape* shape = nullptr;
+    Shape frozen_shape;
+  };
+  std::vector<InstanceCheck> instance_checks_;
+
+ public:
+  const Graph& graph() const noexcept { return *graph_; }
+  const TensorMap& param() const noexcept { return *param_; }
+  Instance* mutable_inst() noexcept { return hidden_.mutable_inst(); }
+  const Instance& inst() const noexcept { return hidden_.inst(); }
+  const Hidden& hidden() const noexcept { return hidden_; }
+  bool frozen() const noexcept { return batch_ > 0; }
+  int batch() const noexcept { return batch_; }
+  int target_size() const noexcept { return (int)targets_.size(); }
+  const tsr_t& target(int i) const noexcept { return *targets_[i]; }
+  // # of ops run by 'Predict'.
+  int kernel_size() const noexcept { return (int)kernels_.size(); }
+
+  void set_intra_op_thread(int intra_op_thread) noexcept {
+    intra_op_thread_ = intra_op_thread > 1 ? intra_op_thread : 1;
+  }
+  int intra_op_thread() const noexcept { return intra_op_thread_; }
+
+ private:
+  bool InitInstancePlaceholder(const GraphNode* node, int batch);
+
+ public:
+  void Init(const Graph* graph, TensorMap* param) noexcept;
+  bool InitOp(const std::vector<std::string>& target_names);
+  // Instance tensors not filled by the caller are created with
+  // 'batch' rows, e.g. a CSR with 'batch' empty rows,
+  // a TSR of the node shape with the first dim replaced by 'batch'.
+  bool Freeze(int batch);
+  // Throw if the batch size or shapes of instance tensors changed.
+  void Predict();
+};
+
+}  // namespace deepx_core
@@ -57,6 +57,11 @@ class Shard : public DataType {
 
  public:
   void InitNonShard();
+  // Registered 'shard_func_name':
+  // "default", id % 'shard_size'.
+  // "modulo", backward compatibility.
+  // "consistent_hash", consistent hashing with virtual nodes,
+  // growing 'shard_size' by 1 only moves ids to the new shard.
   void InitShard(int shard_size, const std::string& shard_func_name);
   bool Write(OutputStream& os) const;  // NOLINT
   bool Read(InputStream& is);          // NOLINT
@@ -4,25 +4,48 @@
 //
 
 #pragma once
+#include <deepx_core/common/hash.h>
+#include <deepx_core/common/hash_map.h>
 #include <deepx_core/common/stream.h>
 #include <deepx_core/graph/shard.h>
 #include <deepx_core/graph/tensor_map.h>
 #include <deepx_core/tensor/data_type.h>
+#include <cstddef>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 namespace deepx_core {
 
 /************************************************************************/
 /* TSStore */
 /************************************************************************/
+// TSStore records the last update timestamp of SRM ids.
+//
+// Timestamps are stored in a flat hash map.
+// Ids are also indexed by time buckets of 'bucket_width' timestamps,
+// 'Expire' only visits buckets older than 'now - expire_threshold'.
+// Index entries are invalidated lazily, an entry is stale
+// if the id has been updated into a newer bucket or has been expired.
+// The index is rebuilt when stale entries outnumber live ones.
 class TSStore : public DataType {
  private:
+  using ts_map_t = FlatHashMap<int_t, ts_t, MurmurHash<int_t>>;
+  // bucket key -> ids
+  using ts_index_t = std::map<ts_t, std::vector<int_t>>;
+
   ts_t now_ = 0;
   ts_t expire_threshold_ = 0;
+  ts_t bucket_width_ = 1;
   const TensorMap* param_ = nullptr;
-  id_ts_map_t id_ts_map_;
+  ts_map_t id_ts_map_;
+  // # of erased entries since the last compaction of 'id_ts_map_'
+  size_t id_ts_map_erased_ = 0;
+  ts_index_t ts_index_;
+  // # of ids in all buckets of 'ts_index_'
+  size_t ts_index_size_ = 0;
   int use_lock_ = 0;
   std::unique_ptr<std::mutex> id_ts_map_lock_;
 
@@ -33,7 +56,24 @@ class TSStore : public DataType {
     expire_threshold_ = expire_threshold;
   }
   ts_t expire_threshold() const noexcept { return expire_threshold_; }
+  // 'bucket_width' should be much less than 'expire_threshold'.
+  void set_bucket_width(ts_t bucket_width);
+  ts_t bucket_width() const noexcept { return bucket_width_; }
   const TensorMap& param() const noexcept { return *param_; }
+  size_t size() const noexcept { return id_ts_map_.size(); }
+  // # of time buckets, for test and benchmark.
+  size_t bucket_size() const noexcept { return ts_index_.size(); }
+  // # of ids in all time buckets including stale ones,
+  // for test and benchmark.
+  size_t index_size() const noexcept { return ts_index_size_; }
+
+ private:
+  ts_t GetBucketKey(ts_t ts) const noexcept { return ts / bucket_width_; }
+  void IndexId(int_t id, ts_t ts);
+  void RebuildIndex();
+  void MaybeCompactIndex();
+  void MaybeCompactMap();
+  void UpdateIds(const srm_t& G);
 
  public:
   void Init(const TensorMap* param) noexcept;
@@ -52,10 +92,17 @@ class TSStore : public DataType {
   bool LoadLegacy(const std::string& file);
   bool Load(const std::string& file);
   void Merge(TSStore* other, const Shard* shard = nullptr, int shard_id = 0);
+  // Move ids of 'shard_id' under 'shard'(all ids if 'shard' is null)
+  // to 'other', overwriting its timestamps.
+  //
+  // Not thread safe, it is used to migrate ids between shards.
+  void Split(TSStore* other, const Shard* shard = nullptr, int shard_id = 0);
 
  public:
   // thread safe after 'InitLock'
   void Update(TensorMap* grad);
+  // Remove and return ids whose timestamps are less than
+  // 'now - expire_threshold'.
   id_set_t Expire();
 };
 
@@ -5,6 +5,7 @@
 #pragma once
 #include <deepx_core/ps/file_dispatcher.h>
 #include <deepx_core/ps/tcp_server.h>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -21,6 +22,7 @@ struct CoordServerConfig {
   int file_dispatcher_reverse = 0;
   int file_dispatcher_shuffle = 0;
   int file_dispatcher_timeout = 0;
+  uint64_t file_dispatcher_split_bytes = 0;
   int dump_model = 0;
 };
 
@@ -5,6 +5,8 @@
 #pragma once
 #include <deepx_core/common/array_view.h>
 #include <deepx_core/common/stream.h>
+#include <cstdint>
+#include <functional>
 #include <string>
 
 namespace deepx_core {
@@ -37,6 +39,16 @@ enum DIST_MESSAGE_TYPE {
   DIST_MESSAGE_TYPE_MODEL_SAVE_RESPONSE = 18,
   // CS sends this message to PS to notify the termination of training.
   DIST_MESSAGE_TYPE_TERMINATION_NOTIFY = 19,
+  // CS sends this message to PS to export entries of another shard
+  // under the new shard.
+  DIST_MESSAGE_TYPE_SHARD_EXPORT_REQUEST = 20,
+  DIST_MESSAGE_TYPE_SHARD_EXPORT_RESPONSE = 21,
+  // CS sends this message to PS to import exported entries.
+  DIST_MESSAGE_TYPE_SHARD_IMPORT_REQUEST = 22,
+  DIST_MESSAGE_TYPE_SHARD_IMPORT_RESPONSE = 23,
+  // CS sends this message to PS to switch to the new shard.
+  DIST_MESSAGE_TYPE_SHARD_COMMIT_REQUEST = 24,
+  DIST_MESSAGE_TYPE_SHARD_COMMIT_RESPONSE = 25,
 
   DIST_MESSAGE_TYPE_USER_REQUEST = 31,
   DIST_MESSAGE_TYPE_USER_RESPONSE = 32,
@@ -57,9 +69,14 @@ class DistMessage {
   struct FileResponse {
     int epoch = 0;
     std::string file;
+    // byte range of 'file', see FileChunk
+    uint64_t offset = 0;
+    uint64_t length = 0;
   };
   struct FileFinishNotify {
     std::string file;
+    uint64_t offset = 0;
+    uint64_t length = 0;
     double loss = 0;
     double loss_weight = 0;
   };
@@ -68,6 +85,12 @@ class DistMessage {
   };
   struct PullResponse {
     std::string buf;
+    // If set, 'buf' is ignored,
+    // 'buf_writer' writes the content of 'buf' to the stream directly.
+    //
+    // It saves copying large data into 'buf',
+    // see 'OutputGatherStream'.
+    std::function<void(OutputStream&)> buf_writer;
   };
   struct PushNotify {
     std::string buf;
@@ -77,6 +100,19 @@ class DistMessage {
     std::string timestamp;
     int feature_kv_protocol_version = 0;
   };
+  struct ShardRequest {
+    int shard_size = 0;
+    std::string shard_func_name;
+    int shard_id = 0;
+  };
+  using ShardExportRequest = ShardRequest;
+  struct ShardExportResponse {
+    std::string buf;
+  };
+  struct ShardImportRequest {
+    std::string buf;
+  };
+  using ShardCommitRequest = ShardRequest;
   struct UserRequest {
     std::string buf;
   };
@@ -97,6 +133,10 @@ class DistMessage {
   PullResponse pull_response_;
   PushNotify push_notify_;
   ModelSaveRequest model_save_request_;
+  ShardExportRequest shard_export_request_;
+  ShardExportResponse shard_export_response_;
+  ShardImportRequest shard_import_request_;
+  ShardCommitRequest shard_commit_request_;
   UserRequest user_request_;
   UserResponse user_response_;
   UserNotify user_notify_;
@@ -137,6 +177,34 @@ class DistMessage {
     return model_save_request_;
   }
 
+  ShardExportRequest* mutable_shard_export_request() noexcept {
+    return &shard_export_request_;
+  }
+  const ShardExportRequest& shard_export_request() const noexcept {
+    return shard_export_request_;
+  }
+
+  ShardExportResponse* mutable_shard_export_response() noexcept {
+    return &shard_export_response_;
+  }
+  const ShardExportResponse& shard_export_response() const noexcept {
+    return shard_export_response_;
+  }
+
+  ShardImportRequest* mutable_shard_import_request() noexcept {
+    return &shard_import_request_;
+  }
+  const ShardImportRequest& shard_import_request() const noexcept {
+    return shard_import_request_;
+  }
+
+  ShardCommitRequest* mutable_shard_commit_request() noexcept {
+    return &shard_commit_request_;
+  }
+  const ShardCommitRequest& shard_commit_request() const noexcept {
+    return shard_commit_request_;
+  }
+
   UserRequest* mutable_user_request() noexcept { return &user_request_; }
   const UserRequest& user_request() const noexcept { return user_request_; }
 
@@ -153,6 +221,8 @@ class DistMessage {
 
 OutputStringStream& operator<<(OutputStringStream& os,
                                const DistMessage& message);
+OutputGatherStream& operator<<(OutputGatherStream& os,
+                               const DistMessage& message);
 
 /************************************************************************/
 /* DistMessageView */
@@ -168,9 +238,14 @@ class DistMessageView {
   struct FileResponse {
     int epoch = 0;
     std::string file;
+    // byte range of 'file', see FileChunk
+    uint64_t offset = 0;
+    uint64_t length = 0;
   };
   struct FileFinishNotify {
     std::string file;
+    uint64_t offset = 0;
+    uint64_t length = 0;
     double loss = 0;
     double loss_weight = 0;
   };
@@ -188,6 +263,19 @@ class DistMessageView {
     std::string timestamp;
     int feature_kv_protocol_version = 0;
   };
+  struct ShardRequest {
+    int shard_size = 0;
+    std::string shard_func_name;
+    int shard_id = 0;
+  };
+  using ShardExportRequest = ShardRequest;
+  struct ShardExportResponse {
+    const_string_view buf;
+  };
+  struct ShardImportRequest {
+    const_string_view buf;
+  };
+  using ShardCommitRequest = ShardRequest;
   struct UserRequest {
     const_string_view buf;
   };
@@ -208,6 +296,10 @@ class DistMessageView {
   PullResponse pull_response_;
   PushNotify push_notify_;
   ModelSaveRequest model_save_request_;
+  ShardExportRequest shard_export_request_;
+  ShardExportResponse shard_export_response_;
+  ShardImportRequest shard_import_request_;
+  ShardCommitRequest shard_commit_request_;
   UserRequest user_request_;
   UserResponse user_response_;
   UserNotify user_notify_;
@@ -248,6 +340,34 @@ class DistMessageView {
     return model_save_request_;
   }
 
+  ShardExportRequest* mutable_shard_export_request() noexcept {
+    return &shard_export_request_;
+  }
+  const ShardExportRequest& shard_export_request() const noexcept {
+    return shard_export_request_;
+  }
+
+  ShardExportResponse* mutable_shard_export_response() noexcept {
+    return &shard_export_response_;
+  }
+  const ShardExportResponse& shard_export_response() const noexcept {
+    return shard_export_response_;
+  }
+
+  ShardImportRequest* mutable_shard_import_request() noexcept {
+    return &shard_import_request_;
+  }
+  const ShardImportRequest& shard_import_request() const noexcept {
+    return shard_import_request_;
+  }
+
+  ShardCommitRequest* mutable_shard_commit_request() noexcept {
+    return &shard_commit_request_;
+  }
+  const ShardCommitRequest& shard_commit_request() const noexcept {
+    return shard_commit_request_;
+  }
+
   UserRequest* mutable_user_request() noexcept { return &user_request_; }
   const UserRequest& user_request() const noexcept { return user_request_; }
 
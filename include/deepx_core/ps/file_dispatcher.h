@@ -3,6 +3,7 @@
 //
 
 #pragma once
+#include <cstdint>
 #include <ctime>
 #include <list>
 #include <mutex>
@@ -13,20 +14,48 @@
 
 namespace deepx_core {
 
+/************************************************************************/
+/* FileChunk */
+/************************************************************************/
+// FileChunk is the byte range ['offset', 'offset' + 'length') of 'file'.
+struct FileChunk {
+  std::string file;
+  uint64_t offset = 0;
+  // 0 means the whole file.
+  uint64_t length = 0;
+
+  bool whole() const noexcept { return offset == 0 && length == 0; }
+};
+
+// 'file' for a whole file, 'file@offset+length' for other chunks.
+std::string to_string(const FileChunk& chunk);
+
 /************************************************************************/
 /* FileDispatcher */
 /************************************************************************/
+// FileDispatcher dispatches files to workers in each epoch.
+//
+// If 'split_bytes' is positive, uncompressed files larger than it are
+// split into chunks of 'split_bytes', so that a large file is processed
+// by several workers and does not become the straggler of an epoch.
+// Chunks are identified by 'to_string(chunk)', which is the file name
+// for whole files.
 class FileDispatcher {
  private:
   int reverse_ = 0;
   int shuffle_ = 0;
   int timeout_ = 0;
+  uint64_t split_bytes_ = 0;
   std::mutex mutex_;
   std::default_random_engine engine_;
-  std::vector<std::string> files_;
-  std::list<std::string> to_dispatch_;
+  std::vector<FileChunk> chunks_;
+  std::list<FileChunk> to_dispatch_;
   std::vector<std::string> finished_;
-  std::unordered_map<std::string, time_t> dispatch_time_;
+  struct Dispatched {
+    FileChunk chunk;
+    time_t time = 0;
+  };
+  std::unordered_map<std::string, Dispatched> dispatched_;
 
  public:
   void set_reverse(int reverse) noexcept { reverse_ = reverse; }
@@ -35,13 +64,25 @@ class FileDispatcher {
   int shuffle() const noexcept { return shuffle_; }
   void set_timeout(int timeout) noexcept { timeout_ = timeout; }
   int timeout() const noexcept { return timeout_; }
+  void set_split_bytes(uint64_t split_bytes) noexcept {
+    split_bytes_ = split_bytes;
+  }
+  uint64_t split_bytes() const noexcept { return split_bytes_; }
+  // # of chunks of an epoch, for test.
+  size_t chunk_size() const noexcept { return chunks_.size(); }
+
+ private:
+  void SplitFile(const std::string& file);
 
  public:
   void PreTrain(const std::vector<std::string>& files);
   void PreEpoch();
+  bool WorkerDispatchFile(FileChunk* chunk);
+  // 'split_bytes' should be 0.
   bool WorkerDispatchFile(std::string* file);
-  bool WorkerFinishFile(const std::string& file);
-  void WorkerFailureFile(const std::string& file);
+  // 'key' is 'to_string(chunk)'.
+  bool WorkerFinishFile(const std::string& key);
+  void WorkerFailureFile(const std::string& key);
 };
 
 }  // namespace deepx_core
@@ -20,6 +20,10 @@ class ParamServer : public TcpServer {
   virtual void OnPushNotify(conn_t conn) = 0;
   virtual void OnModelSaveRequest(conn_t conn) = 0;
   virtual void OnTerminationNotify(conn_t conn) = 0;
+  // Shard migration, see 'TcpConnections::RpcShardMigrate'.
+  virtual void OnShardExportRequest(conn_t conn);
+  virtual void OnShardImportRequest(conn_t conn);
+  virtual void OnShardCommitRequest(conn_t conn);
   virtual void OnUserRequest(conn_t conn);
   virtual void OnUserResponse(conn_t conn);
   virtual void OnUserNotify(conn_t conn);
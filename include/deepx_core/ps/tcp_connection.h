@@ -18,6 +18,7 @@ using IpAddress = asio::ip::address;
 using TcpEndpoint = asio::ip::tcp::endpoint;
 using TcpSocket = asio::ip::tcp::socket;
 using MutableBuffers = asio::mutable_buffers_1;
+using ConstBuffers = std::vector<asio::const_buffer>;
 using TcpAcceptor = asio::ip::tcp::acceptor;
 using TcpNoDelay = asio::ip::tcp::no_delay;
 using SteadyTimer = asio::steady_timer;
@@ -50,11 +51,14 @@ class TcpConnection {
   size_t in_bytes_ = 0;
 
   DistMessage out_message_;
-  OutputStringStream out_stream_;
+  // Large data of 'out_message_' is referenced by 'out_stream_',
+  // they are written with vectored writes.
+  OutputGatherStream out_stream_;
+  ConstBuffers out_bufs_;
   // bytes written for current message
   size_t out_bytes_ = 0;
 
-  // the file that remote worker is processing
+  // the file chunk that remote worker is processing, see FileChunk
   std::string file_;
 
   Any user_data_;
@@ -84,7 +88,8 @@ class TcpConnection {
   void Reset();
   MutableBuffers GetInBuf();
   void PrepareOutBuf();
-  MutableBuffers GetOutBuf();
+  // Buffers of the unwritten part of 'out_message_'.
+  const ConstBuffers& GetOutBuf();
 
   // 'in_bytes' bytes has been read,
   // try to deserialize data to 'in_message_'.
@@ -144,6 +149,9 @@ class TcpConnection {
   int RpcPushNotify();
   int RpcModelSaveRequest();
   int RpcTerminationNotify();
+  int RpcShardExportRequest();
+  int RpcShardImportRequest();
+  int RpcShardCommitRequest();
   int RpcUserRequest();
   int RpcUserResponse();
   int RpcUserNotify();
@@ -188,9 +196,22 @@ class TcpConnections : public std::vector<std::unique_ptr<TcpConnection>> {
   int RpcPushNotify(const std::vector<int>* masks = nullptr);
   int RpcModelSaveRequest(const std::vector<int>* masks = nullptr);
   int RpcTerminationNotify(const std::vector<int>* masks = nullptr);
+  int RpcShardCommitRequest(const std::vector<int>* masks = nullptr);
   int RpcUserRequest(const std::vector<int>* masks = nullptr);
   int RpcUserResponse(const std::vector<int>* masks = nullptr);
   int RpcUserNotify(const std::vector<int>* masks = nullptr);
+
+  // Migrate entries of all PSs to the new shard of 'shard_size' and
+  // 'shard_func_name', the i-th connection is the i-th PS of the new shard.
+  //
+  // Each PS exports entries of each other PS under the new shard,
+  // which are imported by the other PS, then all PSs commit the new shard.
+  // Workers should be paused and new PSs should be started before it,
+  // workers should switch to the new shard after it.
+  //
+  // Return 0, success.
+  // Return -1, error.
+  int RpcShardMigrate(int shard_size, const std::string& shard_func_name);
 };
 
 }  // namespace deepx_core
@@ -3,6 +3,7 @@
 //
 
 #pragma once
+#include <deepx_core/common/intra_op_thread.h>
 #include <deepx_core/common/read_write_lock.h>
 #include <deepx_core/dx_log.h>
 #include <deepx_core/tensor/csr_matrix.h>
@@ -12,6 +13,7 @@
 #include <deepx_core/tensor/tensor_type.h>
 #include <cstdint>
 #include <string>
+#include <vector>
 
 namespace deepx_core {
 
@@ -614,6 +616,17 @@ class LLSparseTensor : public LLTensor<T> {
   // Compute Z = beta * Z.
   static void scale(float_t beta, tsr_t* Z) noexcept;
   static void scale(float_t beta, srm_t* Z) noexcept;
+
+ private:
+  // Unique ids of nonzeros of X, an id is a col of X modulo k if k > 0.
+  // 'index[i]' is the index of the id of the i-th nonzero in 'ids'.
+  static void unique_ids(int_t k, const csr_t& X, std::vector<int_t>* ids,
+                         std::vector<int>* index);
+
+  // Compute Z = X.T * Y + Z in chunks of disjoint rows of Z.
+  //
+  // A modulo-by-k operation will be performed to cols of X if k > 0.
+  static void _gestmm(int_t k, const csr_t& X, const tsr_t& Y, srm_t* Z);
 };
 
 /************************************************************************/
@@ -664,25 +677,33 @@ void LLSparseTensor<T, I>::gesmm_mod(const csr_t& X, const tsr_t& Y, int beta,
     Z->zeros();
   }
 
-  if (n == 1) { // y.shape=(k, 1)， x.dense_shape=(batch, k)， z.shape=(batch, 1)， 所以等价于 tf.sparse.sparse_dense_matmul()
-    float_t Yj;
-    CSR_FOR_EACH_ROW(X, i) { // 逐行
-      CSR_FOR_EACH_COL(X, i) { // 遍历第i行有值的列
-        Yj = _Y[CSR_COL(X) % k]; // CSR_COL(x) 表示第 i 行第 __k 个有值特征的列坐标，所以 Yj 表示特征对应的权重；所以这里 %k 意味着特征可能比权重多，这个时候通过 mod 压缩，这里会引入冲突
-        *_Z += CSR_VALUE(X) * Yj; // CSR_VALUE(x) 表示第 i 行第 __k 个有值特征的值，所以这里相当于 dot 操作中的一个乘法项，累加到 Z 中
+  // rows of X and Z are split into chunks
+  int m = X.row();
+  int grain = GetIntraOpGrain(m > 0 ? (int)(X.col_size() / m + 1) * n : 1);
+  IntraOpParallelFor(m, grain, [&X, _Y, _Z, k, n](int, int row_begin,
+                                                 int row_end) {
+    if (n == 1) { // y.shape=(k, 1)， x.dense_shape=(batch, k)， z.shape=(batch, 1)， 所以等价于 tf.sparse.sparse_dense_matmul()
+      float_t Yj;
+      ptr_t Zi = _Z + row_begin;
+      for (int i = row_begin; i < row_end; ++i) { // 逐行
+        CSR_FOR_EACH_COL(X, i) { // 遍历第i行有值的列
+          Yj = _Y[CSR_COL(X) % k]; // CSR_COL(x) 表示第 i 行第 __k 个有值特征的列坐标，所以 Yj 表示特征对应的权重；所以这里 %k 意味着特征可能比权重多，这个时候通过 mod 压缩，这里会引入冲突
+          *Zi += CSR_VALUE(X) * Yj; // CSR_VALUE(x) 表示第 i 行第 __k 个有值特征的值，所以这里相当于 dot 操作中的一个乘法项，累加到 Z 中
+        }
+        Zi += 1;
       }
-      _Z += 1;
-    }
-  } else { // 等价与 tf.nn.embedding_lookup_sparse()
-    cptr_t Yj;
-    CSR_FOR_EACH_ROW(X, i) {
-      CSR_FOR_EACH_COL(X, i) {
-        Yj = _Y + (CSR_COL(X) % k) * n; // Yj 表示 X （也就是样本矩阵）中第 i 行第 __k 个有值特征对应的权重向量的起点，这个向量的长度为 n
-        ll_math_t::axpy(n, CSR_VALUE(X), Yj, _Z); // 所以这一行等价于把对应的特征 emb / 权重向量（长度为 n），取出来乘以特征的值，累加到 Z 中
+    } else { // 等价与 tf.nn.embedding_lookup_sparse()
+      cptr_t Yj;
+      ptr_t Zi = _Z + row_begin * n;
+      for (int i = row_begin; i < row_end; ++i) {
+        CSR_FOR_EACH_COL(X, i) {
+          Yj = _Y + (CSR_COL(X) % k) * n; // Yj 表示 X （也就是样本矩阵）中第 i 行第 __k 个有值特征对应的权重向量的起点，这个向量的长度为 n
+          ll_math_t::axpy(n, CSR_VALUE(X), Yj, Zi); // 所以这一行等价于把对应的特征 emb / 权重向量（长度为 n），取出来乘以特征的值，累加到 Z 中
+        }
+        Zi += n;
       }
-      _Z += n;
     }
-  }
+  });
 }
 
 template <typename T, typename I>
@@ -696,89 +717,132 @@ void LLSparseTensor<T, I>::gesmsm(const csr_t& X, const srm_t& Y, int beta,
     Z->zeros();
   }
 
-  if (n == 1) {
-    float_t Yj;
-    CSR_FOR_EACH_ROW(X, i) {
-      CSR_FOR_EACH_COL(X, i) {
-        Yj = Y.get_scalar_no_init(CSR_COL(X));
-        *_Z += CSR_VALUE(X) * Yj;
+  // rows of X and Z are split into chunks
+  int m = X.row();
+  int grain = GetIntraOpGrain(m > 0 ? (int)(X.col_size() / m + 1) * n : 1);
+  IntraOpParallelFor(m, grain, [&X, &Y, _Z, n](int, int row_begin,
+                                              int row_end) {
+    // Rows of Y are looked up in blocks and software pipelined,
+    // a block is looked up while the previous one is accumulated,
+    // so that cache misses of lookups overlap.
+    constexpr int BLOCK = (int)detail::HASH_MAP_PREFETCH_BLOCK;
+    cptr_t Yrows[2][BLOCK];
+    int k_begin = X.row_offset(row_begin);
+    int k_end = X.row_offset(row_end);
+    int i = row_begin;
+    ptr_t Zi = _Z + row_begin * n;
+    int block_size = 0, block = 0;
+    for (int k = k_begin;; k += BLOCK, block ^= 1) {
+      int next_block_size = k_end - k;
+      if (next_block_size > BLOCK) {
+        next_block_size = BLOCK;
       }
-      _Z += 1;
-    }
-  } else {
-    cptr_t Yj;
-    CSR_FOR_EACH_ROW(X, i) {
-      CSR_FOR_EACH_COL(X, i) {
-        Yj = Y.get_row_no_init(CSR_COL(X));
-        if (Yj) {
-          ll_math_t::axpy(n, CSR_VALUE(X), Yj, _Z);
+      if (next_block_size > 0) {
+        Y.get_rows_no_init(X.col_begin() + k, (size_t)next_block_size,
+                           Yrows[block]);
+      }
+
+      // accumulate the previous block
+      int k0 = k - BLOCK;
+      const cptr_t* Yj = Yrows[block ^ 1];
+      for (int j = 0; j < block_size; ++j) {
+        while (k0 + j >= X.row_offset(i + 1)) {
+          ++i;
+          Zi += n;
+        }
+        if (Yj[j]) {
+          if (n == 1) {
+            *Zi += X.value(k0 + j) * *Yj[j];
+          } else {
+            ll_math_t::axpy(n, X.value(k0 + j), Yj[j], Zi);
+          }
         }
       }
-      _Z += n;
+
+      if (next_block_size <= 0) {
+        break;
+      }
+      block_size = next_block_size;
     }
-  }
+  });
 }
 
 template <typename T, typename I>
 void LLSparseTensor<T, I>::gestmm_mod(int_t k, const csr_t& X, const tsr_t& Y,
                                       int beta, srm_t* Z) {
-  int n = Z->col();
-  DXASSERT(Y.same_shape(X.row(), n));
-  cptr_t _Y = get_data(Y);
+  DXASSERT(Y.same_shape(X.row(), Z->col()));
 
   if (beta == 0) {
     Z->zeros();
   }
 
-  if (n == 1) {
-    CSR_FOR_EACH_ROW(X, i) {
-      CSR_FOR_EACH_COL(X, i) {
-        float_t& Zj = Z->get_scalar_no_init(CSR_COL(X) % k);
-        Zj += CSR_VALUE(X) * *_Y;
-      }
-      _Y += 1;
-    }
-  } else {
-    ptr_t Zj;
-    CSR_FOR_EACH_ROW(X, i) {
-      CSR_FOR_EACH_COL(X, i) {
-        Zj = Z->get_row_no_init(CSR_COL(X) % k);
-        ll_math_t::axpy(n, CSR_VALUE(X), _Y, Zj);
-      }
-      _Y += n;
-    }
-  }
+  _gestmm(k, X, Y, Z);
 }
 
 template <typename T, typename I>
 void LLSparseTensor<T, I>::gestmm(const csr_t& X, const tsr_t& Y, int beta,
                                   srm_t* Z) {
-  int n = Z->col();
-  DXASSERT(Y.same_shape(X.row(), n));
-  cptr_t _Y = get_data(Y);
+  DXASSERT(Y.same_shape(X.row(), Z->col()));
 
   if (beta == 0) {
     Z->zeros();
   }
 
-  if (n == 1) {
-    CSR_FOR_EACH_ROW(X, i) {
-      CSR_FOR_EACH_COL(X, i) {
-        float_t& Zj = Z->get_scalar_no_init(CSR_COL(X));
-        Zj += CSR_VALUE(X) * *_Y;
-      }
-      _Y += 1;
+  _gestmm(0, X, Y, Z);
+}
+
+template <typename T, typename I>
+void LLSparseTensor<T, I>::unique_ids(int_t k, const csr_t& X,
+                                      std::vector<int_t>* ids,
+                                      std::vector<int>* index) {
+  int nnz = (int)X.col_size();
+  HashMap<int_t, int> id_index((size_t)nnz);
+  ids->clear();
+  ids->reserve((size_t)nnz);
+  index->resize((size_t)nnz);
+  for (int i = 0; i < nnz; ++i) {
+    int_t id = k > 0 ? X.col(i) % k : X.col(i);
+    auto result = id_index.emplace(id, (int)ids->size());
+    if (result.second) {
+      ids->emplace_back(id);
     }
-  } else {
-    ptr_t Zj;
+    (*index)[i] = result.first->second;
+  }
+}
+
+template <typename T, typename I>
+void LLSparseTensor<T, I>::_gestmm(int_t k, const csr_t& X, const tsr_t& Y,
+                                   srm_t* Z) {
+  int n = Z->col();
+  cptr_t _Y = get_data(Y);
+  int nnz = (int)X.col_size();
+
+  // Rows of Z are created serially in batches,
+  // repeated ids are looked up once.
+  std::vector<int_t> Zids;
+  std::vector<int> Zindex;
+  unique_ids(k, X, &Zids, &Zindex);
+  std::vector<ptr_t> Zrows(Zids.size());
+  Z->get_rows_no_init(Zids.data(), Zids.size(), Zrows.data());
+
+  // Each chunk accumulates its own rows in the original order,
+  // so the result is the same as the serial one.
+  int chunk = GetIntraOpChunk(nnz, GetIntraOpGrain(n));
+  IntraOpParallelFor(chunk, 1, [&X, _Y, n, chunk, &Zindex, &Zrows](
+                                   int, int part_begin, int part_end) {
+    cptr_t Yi = _Y;
+    int index, part;
     CSR_FOR_EACH_ROW(X, i) {
       CSR_FOR_EACH_COL(X, i) {
-        Zj = Z->get_row_no_init(CSR_COL(X));
-        ll_math_t::axpy(n, CSR_VALUE(X), _Y, Zj);
+        index = Zindex[__k];
+        part = index % chunk;
+        if (part >= part_begin && part < part_end) {
+          ll_math_t::axpy(n, CSR_VALUE(X), Yi, Zrows[index]);
+        }
       }
-      _Y += n;
+      Yi += n;
     }
-  }
+  });
 }
 
 template <typename T, typename I>
@@ -0,0 +1,222 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#pragma once
+#include <deepx_core/common/hash.h>
+#include <deepx_core/common/hash_map.h>
+#include <deepx_core/common/hash_map_io.h>
+#include <deepx_core/common/stream.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/tensor/quantized_tensor.h>
+#include <deepx_core/tensor/shape.h>
+#include <deepx_core/tensor/sparse_row_matrix.h>
+#include <deepx_core/tensor/tensor_type.h>
+#include <cmath>    // std::fabs, std::lround
+#include <cstdint>
+#include <cstring>  // memcpy
+#include <vector>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* QuantizedSparseRowMatrix */
+/************************************************************************/
+// QuantizedSparseRowMatrix is a predict-only sparse row matrix.
+//
+// Rows are packed in an arena, values are int8 with a scale per row,
+// or fp16.
+// Rows are addressed by indices, which are looked up once and then
+// dequantized on the fly.
+template <typename T, typename I>
+class QuantizedSparseRowMatrix {
+ public:
+  using float_t = T;
+  using ptr_t = float_t*;
+  using cptr_t = const float_t*;
+  using int_t = I;
+  using srm_t = SparseRowMatrix<float_t, int_t>;
+  using map_t = HashMap<int_t, int, MurmurHash<int_t>>;  // id -> row index
+
+ private:
+  Shape shape_{0, 0};
+  int dtype_ = TENSOR_DTYPE_NONE;
+  size_t row_bytes_ = 0;
+  map_t row_index_;
+  std::vector<char> data_;
+
+  template <typename T2, typename I2>
+  friend OutputStream& operator<<(
+      OutputStream& os, const QuantizedSparseRowMatrix<T2, I2>& qsrm);
+  template <typename T2, typename I2>
+  friend InputStream& operator>>(InputStream& is,
+                                 QuantizedSparseRowMatrix<T2, I2>& qsrm);
+
+ private:
+  static size_t GetRowBytes(int dtype, int col) noexcept {
+    if (dtype == TENSOR_DTYPE_INT8) {
+      // scale + int8 values
+      return sizeof(float_t) + (size_t)col;
+    }
+    return sizeof(uint16_t) * col;
+  }
+
+  const char* get_row_data(int index) const noexcept {
+    return data_.data() + (size_t)index * row_bytes_;
+  }
+
+ public:
+  const Shape& shape() const noexcept { return shape_; }
+  int col() const noexcept { return shape_[1]; }
+  int dtype() const noexcept { return dtype_; }
+  size_t size() const noexcept { return row_index_.size(); }
+  bool empty() const noexcept { return row_index_.empty(); }
+  // bytes of values and scales
+  size_t bytes() const noexcept { return data_.size(); }
+
+ public:
+  void clear() noexcept;
+  // Quantize rows of 'W'.
+  // 'dtype' is TENSOR_DTYPE_INT8 or TENSOR_DTYPE_FLOAT16.
+  void quantize(const srm_t& W, int dtype);
+  // Return the index of row 'id', -1 if it is absent.
+  int find_row(int_t id) const noexcept {
+    auto it = row_index_.find(id);
+    return it == row_index_.end() ? -1 : it->second;
+  }
+  void prefetch_row(int_t id) const noexcept { row_index_.prefetch(id); }
+  // Dequantize the row of 'index' to 'row'.
+  void get_row(int index, ptr_t row) const noexcept;
+  // y += alpha * the row of 'index'
+  void axpy_row(int index, float_t alpha, ptr_t y) const noexcept;
+};
+
+/************************************************************************/
+/* QuantizedSparseRowMatrix */
+/************************************************************************/
+template <typename T, typename I>
+OutputStream& operator<<(OutputStream& os,
+                         const QuantizedSparseRowMatrix<T, I>& qsrm) {
+  int version = 0;
+  os << version;
+  os << qsrm.shape_ << qsrm.dtype_ << qsrm.row_index_ << qsrm.data_;
+  return os;
+}
+
+template <typename T, typename I>
+InputStream& operator>>(InputStream& is, QuantizedSparseRowMatrix<T, I>& qsrm) {
+  int version;
+  is >> version;
+  if (!is) {
+    return is;
+  }
+
+  if (version > 0) {
+    DXERROR("Couldn't handle a higher version: %d.", version);
+    is.set_bad();
+    return is;
+  }
+
+  is >> qsrm.shape_ >> qsrm.dtype_ >> qsrm.row_index_ >> qsrm.data_;
+  if (!is) {
+    return is;
+  }
+  qsrm.row_bytes_ = qsrm.GetRowBytes(qsrm.dtype_, qsrm.col());
+  if (qsrm.data_.size() != qsrm.row_index_.size() * qsrm.row_bytes_) {
+    DXERROR("Invalid data size: %zu.", qsrm.data_.size());
+    is.set_bad();
+  }
+  return is;
+}
+
+template <typename T, typename I>
+void QuantizedSparseRowMatrix<T, I>::clear() noexcept {
+  shape_.resize(0, 0);
+  dtype_ = TENSOR_DTYPE_NONE;
+  row_bytes_ = 0;
+  row_index_.clear();
+  data_.clear();
+}
+
+template <typename T, typename I>
+void QuantizedSparseRowMatrix<T, I>::quantize(const srm_t& W, int dtype) {
+  DXCHECK_THROW(dtype == TENSOR_DTYPE_INT8 || dtype == TENSOR_DTYPE_FLOAT16);
+  clear();
+  int n = W.col();
+  shape_.resize(0, n);
+  dtype_ = dtype;
+  row_bytes_ = GetRowBytes(dtype_, n);
+  row_index_.reserve(W.size());
+  data_.resize(W.size() * row_bytes_);
+
+  int index = 0;
+  for (const auto& entry : W) {
+    const float_t* w = entry.second;
+    char* row = data_.data() + (size_t)index * row_bytes_;
+    if (dtype_ == TENSOR_DTYPE_INT8) {
+      float_t max_abs = 0;
+      for (int j = 0; j < n; ++j) {
+        float_t abs = std::fabs(w[j]);
+        if (max_abs < abs) {
+          max_abs = abs;
+        }
+      }
+      float_t scale = max_abs / 127;
+      float_t inv_scale = scale > 0 ? 1 / scale : 0;
+      memcpy(row, &scale, sizeof(scale));
+      int8_t* q = (int8_t*)(row + sizeof(scale));
+      for (int j = 0; j < n; ++j) {
+        q[j] = (int8_t)std::lround(w[j] * inv_scale);
+      }
+    } else {
+      uint16_t* h = (uint16_t*)row;
+      for (int j = 0; j < n; ++j) {
+        h[j] = FloatToHalf((float)w[j]);
+      }
+    }
+    row_index_.emplace(entry.first, index++);
+  }
+}
+
+template <typename T, typename I>
+void QuantizedSparseRowMatrix<T, I>::get_row(int index,
+                                             ptr_t row) const noexcept {
+  int n = col();
+  const char* data = get_row_data(index);
+  if (dtype_ == TENSOR_DTYPE_INT8) {
+    float_t scale;
+    memcpy(&scale, data, sizeof(scale));
+    const int8_t* q = (const int8_t*)(data + sizeof(scale));
+    for (int j = 0; j < n; ++j) {
+      row[j] = q[j] * scale;
+    }
+  } else {
+    const uint16_t* h = (const uint16_t*)data;
+    for (int j = 0; j < n; ++j) {
+      row[j] = (float_t)HalfToFloat(h[j]);
+    }
+  }
+}
+
+template <typename T, typename I>
+void QuantizedSparseRowMatrix<T, I>::axpy_row(int index, float_t alpha,
+                                              ptr_t y) const noexcept {
+  int n = col();
+  const char* data = get_row_data(index);
+  if (dtype_ == TENSOR_DTYPE_INT8) {
+    float_t scale;
+    memcpy(&scale, data, sizeof(scale));
+    const int8_t* q = (const int8_t*)(data + sizeof(scale));
+    float_t a = alpha * scale;
+    for (int j = 0; j < n; ++j) {
+      y[j] += a * q[j];
+    }
+  } else {
+    const uint16_t* h = (const uint16_t*)data;
+    for (int j = 0; j < n; ++j) {
+      y[j] += alpha * (float_t)HalfToFloat(h[j]);
+    }
+  }
+}
+
+}  // namespace deepx_core
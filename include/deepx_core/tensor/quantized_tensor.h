@@ -0,0 +1,298 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#pragma once
+#include <deepx_core/common/stream.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/tensor/ll_math.h>
+#include <deepx_core/tensor/shape.h>
+#include <deepx_core/tensor/tensor.h>
+#include <deepx_core/tensor/tensor_type.h>
+#include <algorithm>  // std::min
+#include <cmath>      // std::fabs, std::lround, std::nearbyint
+#include <cstdint>
+#include <cstring>  // memcpy
+#include <vector>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* half */
+/************************************************************************/
+// Convert a float to an IEEE 754 half, rounding to nearest even.
+inline uint16_t FloatToHalf(float f) noexcept {
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  uint32_t abs = x & 0x7fffffff;
+  if (abs >= 0x7f800000) {
+    // inf or nan
+    return (uint16_t)(sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0));
+  }
+  if (abs >= 0x477ff000) {
+    // rounded to inf
+    return (uint16_t)(sign | 0x7c00);
+  }
+  if (abs < 0x38800000) {
+    // subnormal half or zero, in units of 2^-24
+    float v;
+    memcpy(&v, &abs, sizeof(v));
+    return (uint16_t)(sign | (uint32_t)std::nearbyint(v * 16777216.0f));
+  }
+  // rebias the exponent, round the mantissa to nearest even
+  abs += 0xc8000fff + ((abs >> 13) & 1);
+  return (uint16_t)(sign | (abs >> 13));
+}
+
+// Convert an IEEE 754 half to a float.
+inline float HalfToFloat(uint16_t h) noexcept {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+  float f;
+  if (exp == 0) {
+    // subnormal or zero, in units of 2^-24
+    f = mantissa * (1.0f / 16777216.0f);
+    return sign ? -f : f;
+  }
+
+  uint32_t x;
+  if (exp == 0x1f) {
+    x = sign | 0x7f800000 | (mantissa << 13);
+  } else {
+    x = sign | ((exp + 112) << 23) | (mantissa << 13);
+  }
+  memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+/************************************************************************/
+/* QuantizedTensor */
+/************************************************************************/
+// QuantizedTensor is a predict-only rank 2 tensor.
+//
+// Values are int8 with a scale per row(axis 0) or per column(axis 1),
+// or fp16.
+// Values are dequantized on the fly, so that computations stay in float.
+template <typename T>
+class QuantizedTensor {
+ public:
+  using float_t = T;
+  using ptr_t = float_t*;
+  using cptr_t = const float_t*;
+  using tsr_t = Tensor<float_t>;
+
+ private:
+  Shape shape_;
+  int dtype_ = TENSOR_DTYPE_NONE;
+  int axis_ = 0;
+  std::vector<float_t> scale_;  // only for int8
+  std::vector<int8_t> i8_;
+  std::vector<uint16_t> f16_;
+
+  template <typename T2>
+  friend OutputStream& operator<<(OutputStream& os,
+                                  const QuantizedTensor<T2>& qtsr);
+  template <typename T2>
+  friend InputStream& operator>>(InputStream& is, QuantizedTensor<T2>& qtsr);
+
+ public:
+  const Shape& shape() const noexcept { return shape_; }
+  int dim(int i) const noexcept { return shape_[i]; }
+  int dtype() const noexcept { return dtype_; }
+  int axis() const noexcept { return axis_; }
+  bool empty() const noexcept { return shape_.empty(); }
+  // bytes of values and scales
+  size_t bytes() const noexcept {
+    return scale_.size() * sizeof(float_t) + i8_.size() +
+           f16_.size() * sizeof(uint16_t);
+  }
+
+ public:
+  void clear() noexcept;
+  // Quantize 'W' of rank 2.
+  // 'dtype' is TENSOR_DTYPE_INT8 or TENSOR_DTYPE_FLOAT16.
+  // 'axis' is the axis of int8 scales, 0 for rows, 1 for columns.
+  void quantize(const tsr_t& W, int dtype, int axis);
+  void dequantize(tsr_t* W) const;
+  // Dequantize columns [begin, end) of row 'i' to 'row'.
+  void get_row(int i, int begin, int end, ptr_t row) const noexcept;
+  // y += alpha * row 'i'
+  void axpy_row(int i, float_t alpha, ptr_t y) const noexcept;
+  // Z(m, n) = X(m, k) * this(k, n)
+  void gemm(int m, cptr_t X, ptr_t Z) const noexcept;
+};
+
+/************************************************************************/
+/* QuantizedTensor */
+/************************************************************************/
+template <typename T>
+OutputStream& operator<<(OutputStream& os, const QuantizedTensor<T>& qtsr) {
+  int version = 0;
+  os << version;
+  os << qtsr.shape_ << qtsr.dtype_ << qtsr.axis_ << qtsr.scale_ << qtsr.i8_
+     << qtsr.f16_;
+  return os;
+}
+
+template <typename T>
+InputStream& operator>>(InputStream& is, QuantizedTensor<T>& qtsr) {
+  int version;
+  is >> version;
+  if (!is) {
+    return is;
+  }
+
+  if (version > 0) {
+    DXERROR("Couldn't handle a higher version: %d.", version);
+    is.set_bad();
+    return is;
+  }
+
+  is >> qtsr.shape_ >> qtsr.dtype_ >> qtsr.axis_ >> qtsr.scale_ >> qtsr.i8_ >>
+      qtsr.f16_;
+  return is;
+}
+
+template <typename T>
+void QuantizedTensor<T>::clear() noexcept {
+  shape_.clear();
+  dtype_ = TENSOR_DTYPE_NONE;
+  axis_ = 0;
+  scale_.clear();
+  i8_.clear();
+  f16_.clear();
+}
+
+template <typename T>
+void QuantizedTensor<T>::quantize(const tsr_t& W, int dtype, int axis) {
+  DXCHECK_THROW(W.is_rank(2));
+  DXCHECK_THROW(dtype == TENSOR_DTYPE_INT8 || dtype == TENSOR_DTYPE_FLOAT16);
+  DXCHECK_THROW(axis == 0 || axis == 1);
+  clear();
+  shape_ = W.shape();
+  dtype_ = dtype;
+  axis_ = axis;
+
+  int m = W.dim(0);
+  int n = W.dim(1);
+  const float_t* _W = W.data();
+  if (dtype_ == TENSOR_DTYPE_FLOAT16) {
+    f16_.resize(W.total_dim());
+    for (int i = 0; i < m * n; ++i) {
+      f16_[i] = FloatToHalf((float)_W[i]);
+    }
+    return;
+  }
+
+  scale_.assign(axis_ == 0 ? m : n, 0);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) {
+      float_t& scale = scale_[axis_ == 0 ? i : j];
+      float_t abs = std::fabs(_W[i * n + j]);
+      if (scale < abs) {
+        scale = abs;
+      }
+    }
+  }
+  for (float_t& scale : scale_) {
+    scale /= 127;
+  }
+
+  i8_.resize(W.total_dim());
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) {
+      float_t scale = scale_[axis_ == 0 ? i : j];
+      float_t inv_scale = scale > 0 ? 1 / scale : 0;
+      i8_[i * n + j] = (int8_t)std::lround(_W[i * n + j] * inv_scale);
+    }
+  }
+}
+
+template <typename T>
+void QuantizedTensor<T>::dequantize(tsr_t* W) const {
+  W->resize(shape_);
+  for (int i = 0; i < shape_[0]; ++i) {
+    get_row(i, 0, shape_[1], W->data() + i * shape_[1]);
+  }
+}
+
+template <typename T>
+void QuantizedTensor<T>::get_row(int i, int begin, int end,
+                                 ptr_t row) const noexcept {
+  int offset = i * shape_[1];
+  if (dtype_ == TENSOR_DTYPE_FLOAT16) {
+    const uint16_t* h = f16_.data() + offset;
+    for (int j = begin; j < end; ++j) {
+      row[j - begin] = (float_t)HalfToFloat(h[j]);
+    }
+  } else if (axis_ == 0) {
+    const int8_t* q = i8_.data() + offset;
+    float_t scale = scale_[i];
+    for (int j = begin; j < end; ++j) {
+      row[j - begin] = q[j] * scale;
+    }
+  } else {
+    const int8_t* q = i8_.data() + offset;
+    for (int j = begin; j < end; ++j) {
+      row[j - begin] = q[j] * scale_[j];
+    }
+  }
+}
+
+template <typename T>
+void QuantizedTensor<T>::axpy_row(int i, float_t alpha,
+                                  ptr_t y) const noexcept {
+  int n = shape_[1];
+  int offset = i * n;
+  if (dtype_ == TENSOR_DTYPE_FLOAT16) {
+    const uint16_t* h = f16_.data() + offset;
+    for (int j = 0; j < n; ++j) {
+      y[j] += alpha * (float_t)HalfToFloat(h[j]);
+    }
+  } else if (axis_ == 0) {
+    const int8_t* q = i8_.data() + offset;
+    float_t a = alpha * scale_[i];
+    for (int j = 0; j < n; ++j) {
+      y[j] += a * q[j];
+    }
+  } else {
+    const int8_t* q = i8_.data() + offset;
+    for (int j = 0; j < n; ++j) {
+      y[j] += alpha * scale_[j] * q[j];
+    }
+  }
+}
+
+template <typename T>
+void QuantizedTensor<T>::gemm(int m, cptr_t X, ptr_t Z) const noexcept {
+  // Z is computed block by block.
+  // A block of a row of this is dequantized once,
+  // and is reused by a block of rows of X while they are in cache.
+  static constexpr int BLOCK_ROW = 64;   // magic number
+  static constexpr int BLOCK_COL = 256;  // magic number
+  int k = shape_[0];
+  int n = shape_[1];
+  float_t Wl[BLOCK_COL];
+  for (int i0 = 0; i0 < m; i0 += BLOCK_ROW) {
+    int i1 = std::min(i0 + BLOCK_ROW, m);
+    for (int j0 = 0; j0 < n; j0 += BLOCK_COL) {
+      int j1 = std::min(j0 + BLOCK_COL, n);
+      for (int i = i0; i < i1; ++i) {
+        LLMath<float_t>::zero(j1 - j0, Z + i * n + j0);
+      }
+      for (int l = 0; l < k; ++l) {
+        get_row(l, j0, j1, Wl);
+        for (int i = i0; i < i1; ++i) {
+          float_t Xil = X[i * k + l];
+          if (Xil != 0) {
+            LLMath<float_t>::axpy(j1 - j0, Xil, Wl, Z + i * n + j0);
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace deepx_core
@@ -13,7 +13,9 @@
 #include <deepx_core/dx_log.h>
 #include <deepx_core/tensor/shape.h>
 #include <deepx_core/tensor/tensor_type.h>
+#include <cstdint>
 #include <cstring>  // memcpy
+#include <functional>
 #include <initializer_list>
 #include <iostream>
 #include <random>
@@ -110,6 +112,55 @@ class SRMConstIterator {
   const value_type* operator->() const noexcept { return &value_; }
 };
 
+/************************************************************************/
+/* SRMMappedIndex */
+/************************************************************************/
+// A read-only index of rows in external memory, e.g. a mapped file.
+//
+// Rows are grouped into 'bucket_size'(a power of 2) buckets by hashes of
+// their ids, and stored bucket by bucket.
+// Ids of bucket b are 'row[bucket[b], bucket[b + 1])',
+// the value of 'row[i]' is 'value[i * col, (i + 1) * col)'.
+template <typename T, typename I>
+struct SRMMappedIndex {
+  const uint64_t* bucket = nullptr;
+  uint64_t bucket_size = 0;
+  const I* row = nullptr;
+  const T* value = nullptr;
+  uint64_t size = 0;
+  int col = 0;
+
+  static uint64_t get_bucket(I id, uint64_t bucket_size) noexcept {
+    return (uint64_t)MurmurHash<I>()(id) & (bucket_size - 1);
+  }
+
+  void prefetch(I id) const noexcept {
+    detail::prefetch(bucket + get_bucket(id, bucket_size));
+  }
+
+  const T* find(I id) const noexcept {
+    const uint64_t* b = bucket + get_bucket(id, bucket_size);
+    uint64_t last = b[1];
+    for (uint64_t i = b[0]; i < last; ++i) {
+      if (row[i] == id) {
+        return value + i * col;
+      }
+    }
+    return nullptr;
+  }
+};
+
+/************************************************************************/
+/* SRMExtraRows */
+/************************************************************************/
+// Rows written after rows of a SparseRowMatrix, e.g. rows in files.
+// 'func(os)' writes 'size' rows, each is an id followed by its values
+// in the format of 'Vector'.
+struct SRMExtraRows {
+  uint64_t size = 0;
+  std::function<void(OutputStream&)> func;
+};
+
 /************************************************************************/
 /* SparseRowMatrix */
 /************************************************************************/
@@ -126,10 +177,14 @@ class SparseRowMatrix {
   using key_type = typename map_t::key_type;
   using mapped_type = typename map_t::mapped_type;
   using value_type = typename map_t::value_type;
+  using mapped_index_t = SRMMappedIndex<T, I>;
 
  private:
   Shape shape_{0, 0};
   map_t row_map_;
+  mapped_index_t mapped_;
+  const SparseRowMatrix* base_ = nullptr;
+  const SRMExtraRows* extra_rows_ = nullptr;
   int initializer_type_ = TENSOR_INITIALIZER_TYPE_NONE;
   float_t initializer_param1_ = 0;
   float_t initializer_param2_ = 0;
@@ -142,6 +197,14 @@ class SparseRowMatrix {
   template <typename T2, typename I2>
   friend InputStringStream& ReadView(InputStringStream& is,          // NOLINT
                                      SparseRowMatrix<T2, I2>& srm);  // NOLINT
+  template <typename T2, typename I2, class Func>
+  friend InputStream& ReadEach(InputStream& is,               // NOLINT
+                               SparseRowMatrix<T2, I2>& srm,  // NOLINT
+                               Func&& func);
+  template <typename T2, typename I2, class Func>
+  friend OutputStream& WriteEach(OutputStream& os,  // NOLINT
+                                 const SparseRowMatrix<T2, I2>& srm,
+                                 uint64_t size, Func&& func);
 
   // backward compatibility
   template <typename T2, typename I2>
@@ -174,6 +237,9 @@ class SparseRowMatrix {
   void set_initializer(int initializer_type, float_t initializer_param1 = 0,
                        float_t initializer_param2 = 0);
 
+ private:
+  void init_split(SparseRowMatrix* other) const;
+
  public:
   SparseRowMatrix() = default;
   SparseRowMatrix(
@@ -183,8 +249,34 @@ class SparseRowMatrix {
  public:
   template <typename Int>
   void reserve(Int size);
+  // Grow incrementally, 'rehash_step' buckets are rehashed per insertion.
+  // 0 rehashes all buckets at once.
+  void set_rehash_step(size_t rehash_step) noexcept {
+    row_map_.set_rehash_step(rehash_step);
+  }
   void clear() noexcept;
   void zeros() noexcept { row_map_.clear(); }
+  // Rows missing from this matrix are looked up in 'mapped' by const
+  // lookups, e.g. rows of a mapped serving model.
+  // Mapped rows are read-only, they are not counted by 'size', iterated,
+  // compared or serialized.
+  void set_mapped(const mapped_index_t& mapped) noexcept { mapped_ = mapped; }
+  const mapped_index_t& mapped() const noexcept { return mapped_; }
+  // Rows missing from this matrix and 'mapped' are looked up in 'base' by
+  // const lookups, e.g. changed rows overlaid on a serving model.
+  // 'base' is not owned, it must outlive lookups.
+  // Like mapped rows, its rows are not counted, iterated, compared or
+  // serialized.
+  void set_base(const SparseRowMatrix* base) noexcept { base_ = base; }
+  const SparseRowMatrix* base() const noexcept { return base_; }
+  // 'extra_rows' are serialized after rows of this matrix, so that rows
+  // out of memory are saved without being loaded(see 'ColdStore').
+  // It is not owned, it must outlive serializations.
+  // Like mapped rows, extra rows are not counted, iterated or compared.
+  void set_extra_rows(const SRMExtraRows* extra_rows) noexcept {
+    extra_rows_ = extra_rows;
+  }
+  const SRMExtraRows* extra_rows() const noexcept { return extra_rows_; }
   size_t size() const noexcept { return row_map_.size(); }
   bool empty() const noexcept { return row_map_.empty(); }
   void upsert(const SparseRowMatrix& other);
@@ -196,6 +288,13 @@ class SparseRowMatrix {
   void merge_if(const SparseRowMatrix& other, Func&& func);
   template <class Func>
   void merge_if(SparseRowMatrix&& other, Func&& func);
+  // Move rows satisfying 'func' to 'other', overwriting its rows.
+  // If col of 'other' is 0, it inherits col and initializer from this.
+  template <class Func>
+  void split_if(SparseRowMatrix* other, Func&& func);
+  // Move 'row' to 'other' like 'split_if',
+  // return false if 'row' doesn't exist.
+  bool split(SparseRowMatrix* other, int_t row);
   void assign(int_t row, cptr_t row_value);
   void assign_view(int_t row, cptr_t row_value);
   template <class Func>
@@ -218,6 +317,19 @@ class SparseRowMatrix {
   inline float_t& get_scalar_no_init(int_t row);
   inline float_t get_scalar_no_init(int_t row) const noexcept;
 
+  // Batched 'get_row_no_init' of 'n' rows.
+  //
+  // Buckets of rows are prefetched in blocks, values of rows are
+  // prefetched as soon as their buckets are probed, so that cache misses
+  // of lookups overlap.
+  // The non-const version inserts rows which don't exist like
+  // 'get_row_no_init', the const version returns nullptr for them.
+  inline void get_rows_no_init(const int_t* rows, size_t n, ptr_t* row_values);
+  inline void get_rows_no_init(const int_t* rows, size_t n,
+                               cptr_t* row_values) const noexcept;
+  // Prefetch the bucket of 'row' for a following lookup.
+  void prefetch_row(int_t row) const noexcept { row_map_.prefetch(row); }
+
   template <class RandomEngine>
   inline ptr_t get_row(RandomEngine&& engine, int_t row, ReadWriteLock* lock);
   inline ptr_t get_row_no_init(int_t row, ReadWriteLock* lock);
@@ -271,6 +383,21 @@ std::ostream& operator<<(std::ostream& os, const SparseRowMatrix<T, I>& srm);
 /************************************************************************/
 template <typename T, typename I>
 OutputStream& operator<<(OutputStream& os, const SparseRowMatrix<T, I>& srm) {
+  const SRMExtraRows* extra_rows = srm.extra_rows_;
+  if (extra_rows) {
+    uint64_t size = (uint64_t)srm.row_map_.size() + extra_rows->size;
+    return WriteEach(os, srm, size,
+                     [&srm, extra_rows](OutputStream& os) {  // NOLINT
+                       for (const auto& entry : srm.row_map_) {
+                         os << entry.first << entry.second;
+                         if (!os) {
+                           return;
+                         }
+                       }
+                       extra_rows->func(os);
+                     });
+  }
+
   int version = 0x0a0c72e7;  // magic number version
   os << version;
   os << srm.col() << srm.row_map_ << srm.initializer_type_
@@ -335,6 +462,60 @@ InputStringStream& ReadView(InputStringStream& is,         // NOLINT
   return is;
 }
 
+// Read col and initializer into 'srm', pass rows to 'func' one by one,
+// rows are not inserted into 'srm'.
+// 'func' is called with a 'std::pair<I, Vector<T>>&'.
+template <typename T, typename I, class Func>
+InputStream& ReadEach(InputStream& is,             // NOLINT
+                      SparseRowMatrix<T, I>& srm,  // NOLINT
+                      Func&& func) {
+  int version;
+  if (is.Peek(&version, sizeof(version)) != sizeof(version)) {
+    return is;
+  }
+
+  srm.clear();
+  if (version == 0x0a0c72e7) {  // magic number version
+    int col;
+    is >> version;
+    is >> col;
+    if (!is) {
+      return is;
+    }
+    srm.set_col(col);
+    ReadEach<I, Vector<T>>(is, func);
+    is >> srm.initializer_type_ >> srm.initializer_param1_ >>
+        srm.initializer_param2_;
+  } else {
+    // backward compatibility
+    is >> srm;
+    if (is) {
+      for (auto& entry : srm.row_map_) {
+        std::pair<I, Vector<T>> kv(entry.first, std::move(entry.second));
+        func(kv);
+      }
+      srm.row_map_.clear();
+    }
+  }
+  return is;
+}
+
+// Write col and initializer of 'srm' and 'size' rows,
+// the rows are written by 'func(os)' instead of rows of 'srm'.
+// It can be read back as a SparseRowMatrix.
+template <typename T, typename I, class Func>
+OutputStream& WriteEach(OutputStream& os,                   // NOLINT
+                        const SparseRowMatrix<T, I>& srm,  // NOLINT
+                        uint64_t size, Func&& func) {
+  int version = 0x0a0c72e7;  // magic number version
+  os << version;
+  os << srm.col();
+  WriteEach(os, size, func);
+  os << srm.initializer_type_ << srm.initializer_param1_
+     << srm.initializer_param2_;
+  return os;
+}
+
 template <typename T, typename I>
 InputStream& ReadSRP(InputStream& is,               // NOLINT
                      SparseRowMatrix<T, I>& srm) {  // NOLINT
@@ -475,6 +656,9 @@ template <typename T, typename I>
 void SparseRowMatrix<T, I>::clear() noexcept {
   shape_.resize(0, 0);
   row_map_.clear();
+  mapped_ = mapped_index_t();
+  base_ = nullptr;
+  extra_rows_ = nullptr;
   initializer_type_ = TENSOR_INITIALIZER_TYPE_NONE;
   initializer_param1_ = 0;
   initializer_param2_ = 0;
@@ -565,6 +749,48 @@ void SparseRowMatrix<T, I>::merge_if(SparseRowMatrix&& other, Func&& func) {
   other.zeros();
 }
 
+template <typename T, typename I>
+void SparseRowMatrix<T, I>::init_split(SparseRowMatrix* other) const {
+  if (other->col() == 0) {
+    other->set_col(col());
+    other->initializer_type_ = initializer_type_;
+    other->initializer_param1_ = initializer_param1_;
+    other->initializer_param2_ = initializer_param2_;
+  }
+  if (col() != other->col()) {
+    DXTHROW_INVALID_ARGUMENT("Inconsistent col: %d vs %d.", col(),
+                             other->col());
+  }
+}
+
+template <typename T, typename I>
+template <class Func>
+void SparseRowMatrix<T, I>::split_if(SparseRowMatrix* other, Func&& func) {
+  init_split(other);
+  auto first = row_map_.begin();
+  auto last = row_map_.end();
+  for (; first != last;) {
+    if (func(*first)) {
+      other->row_map_[first->first] = std::move(first->second);
+      first = row_map_.erase(first);
+    } else {
+      ++first;
+    }
+  }
+}
+
+template <typename T, typename I>
+bool SparseRowMatrix<T, I>::split(SparseRowMatrix* other, int_t row) {
+  init_split(other);
+  auto it = row_map_.find(row);
+  if (it == row_map_.end()) {
+    return false;
+  }
+  other->row_map_[row] = std::move(it->second);
+  row_map_.erase(it);
+  return true;
+}
+
 template <typename T, typename I>
 void SparseRowMatrix<T, I>::assign(int_t row, cptr_t row_value) {
   auto& value = row_map_[row];
@@ -706,6 +932,15 @@ inline auto SparseRowMatrix<T, I>::get_row_no_init(int_t row) const noexcept
   if (it != row_map_.end()) {
     return &it->second[0];
   }
+  if (mapped_.size > 0) {
+    cptr_t value = mapped_.find(row);
+    if (value) {
+      return value;
+    }
+  }
+  if (base_) {
+    return base_->get_row_no_init(row);
+  }
   return nullptr;
 }
 
@@ -763,9 +998,90 @@ inline auto SparseRowMatrix<T, I>::get_scalar_no_init(int_t row) const noexcept
   if (it != row_map_.end()) {
     return it->second[0];
   }
+  if (mapped_.size > 0) {
+    cptr_t value = mapped_.find(row);
+    if (value) {
+      return *value;
+    }
+  }
+  if (base_) {
+    return base_->get_scalar_no_init(row);
+  }
   return 0;
 }
 
+template <typename T, typename I>
+inline void SparseRowMatrix<T, I>::get_rows_no_init(const int_t* rows, size_t n,
+                                                    ptr_t* row_values) {
+  using mapped_type = typename map_t::mapped_type;
+  mapped_type* values[detail::HASH_MAP_PREFETCH_BLOCK];
+  size_t i = 0, j, m;
+  while (i < n) {
+    m = n - i;
+    if (m > detail::HASH_MAP_PREFETCH_BLOCK) {
+      m = detail::HASH_MAP_PREFETCH_BLOCK;
+    }
+    row_map_.find_batch(rows + i, m, values);
+    for (j = 0; j < m; ++j) {
+      if (values[j]) {
+        row_values[i + j] = values[j]->data();
+        detail::prefetch(row_values[i + j]);
+      } else {
+        row_values[i + j] = nullptr;
+      }
+    }
+    // 'values' may be invalidated by insertions from now on,
+    // but row values are not moved.
+    for (j = 0; j < m; ++j) {
+      if (row_values[i + j] == nullptr) {
+        row_values[i + j] = get_row_no_init(rows[i + j]);
+      }
+    }
+    i += m;
+  }
+}
+
+template <typename T, typename I>
+inline void SparseRowMatrix<T, I>::get_rows_no_init(
+    const int_t* rows, size_t n, cptr_t* row_values) const noexcept {
+  using mapped_type = typename map_t::mapped_type;
+  const mapped_type* values[detail::HASH_MAP_PREFETCH_BLOCK];
+  size_t i = 0, j, m;
+  while (i < n) {
+    m = n - i;
+    if (m > detail::HASH_MAP_PREFETCH_BLOCK) {
+      m = detail::HASH_MAP_PREFETCH_BLOCK;
+    }
+    row_map_.find_batch(rows + i, m, values);
+    for (j = 0; j < m; ++j) {
+      if (values[j]) {
+        row_values[i + j] = values[j]->data();
+        detail::prefetch(row_values[i + j]);
+      } else {
+        row_values[i + j] = nullptr;
+        if (mapped_.size > 0) {
+          mapped_.prefetch(rows[i + j]);
+        }
+      }
+    }
+    if (mapped_.size > 0) {
+      for (j = 0; j < m; ++j) {
+        if (row_values[i + j] == nullptr) {
+          row_values[i + j] = mapped_.find(rows[i + j]);
+        }
+      }
+    }
+    if (base_) {
+      for (j = 0; j < m; ++j) {
+        if (row_values[i + j] == nullptr) {
+          row_values[i + j] = base_->get_row_no_init(rows[i + j]);
+        }
+      }
+    }
+    i += m;
+  }
+}
+
 template <typename T, typename I>
 template <class RandomEngine>
 inline auto SparseRowMatrix<T, I>::get_row(RandomEngine&& engine, int_t row,
@@ -35,6 +35,8 @@ enum TENSOR_TYPE {
   TENSOR_TYPE_CSR = 3, // 压缩稀疏行矩阵
   TENSOR_TYPE_TSRI = 4, // 整型稠密张量
   TENSOR_TYPE_TSRS = 5, // 字符串型稠密张量
+  TENSOR_TYPE_QTSR = 6,  // quantized dense tensor, only in models
+  TENSOR_TYPE_QSRM = 7,  // quantized sparse row matrix, only in models
   TENSOR_TYPE_SRP = 10,  // backward compatibility
   TENSOR_TYPE_SVP = 11,  // backward compatibility
   TENSOR_TYPE_SRG = 12,  // backward compatibility
@@ -6,6 +6,8 @@
 #include <deepx_core/common/hash_map_io.h>
 #include <deepx_core/common/stream.h>
 #include <gtest/gtest.h>
+#include <random>
+#include <unordered_map>
 #include <utility>
 
 namespace deepx_core {
@@ -261,6 +263,28 @@ TEST_F(FlatHashMapTest, WriteReadView) {
   EXPECT_EQ(hash_map, read_hash_map);
 }
 
+TEST_F(FlatHashMapTest, WriteReadEach) {
+  hash_map_t hash_map{{0, 0}, {1, 1}, {2, 2}, {3, 3}}, read_hash_map;
+
+  OutputStringStream os;
+  InputStringStream is;
+
+  WriteEach(os, (uint64_t)hash_map.size(), [&hash_map](OutputStream& os) {
+    for (const auto& entry : hash_map) {
+      os << entry.first << entry.second;
+    }
+  });
+  ASSERT_TRUE(os);
+
+  is.SetView(os.GetBuf());
+  ReadEach<int, int>(is, [&read_hash_map](std::pair<int, int>& entry) {
+    read_hash_map.emplace(entry.first, entry.second);
+  });
+  ASSERT_TRUE(is);
+
+  EXPECT_EQ(read_hash_map, hash_map);
+}
+
 TEST_F(FlatHashMapTest, KeyHash_KeyEqual_lambda) {
   auto key_hash = [](int k) { return (size_t)k; };
   auto key_equal = [](int left, int right) { return left == right; };
@@ -268,4 +292,223 @@ TEST_F(FlatHashMapTest, KeyHash_KeyEqual_lambda) {
       0, key_hash, key_equal);
 }
 
+template <bool GroupProbe>
+void TestRandomOps(size_t rehash_step) {
+  using hash_map_t = FlatHashMap<int, int, detail::KeyHash<int>,
+                                 detail::KeyEqual<int>, GroupProbe>;
+  hash_map_t hash_map;
+  hash_map.set_rehash_step(rehash_step);
+  int rehashing = 0;
+  std::unordered_map<int, int> expected;
+  std::default_random_engine engine;
+  // Integral keys are hashed to themselves,
+  // a small key range makes long probe sequences and many deleted buckets.
+  std::uniform_int_distribution<int> key_dist(0, 3000);
+  std::uniform_int_distribution<int> op_dist(0, 3);
+  for (int i = 0; i < 100000; ++i) {
+    int k = key_dist(engine);
+    switch (op_dist(engine)) {
+      case 0:
+        EXPECT_EQ(hash_map.emplace(k, i).second,
+                  expected.emplace(k, i).second);
+        break;
+      case 1:
+        hash_map[k] = i;
+        expected[k] = i;
+        break;
+      case 2: {
+        auto it = hash_map.find(k);
+        ASSERT_EQ(it != hash_map.end(), expected.count(k) > 0);
+        if (it != hash_map.end()) {
+          hash_map.erase(it);
+          expected.erase(k);
+        }
+      } break;
+      case 3: {
+        auto it = hash_map.find(k);
+        auto expected_it = expected.find(k);
+        ASSERT_EQ(it != hash_map.end(), expected_it != expected.end());
+        if (it != hash_map.end()) {
+          EXPECT_EQ(it->second, expected_it->second);
+        }
+      } break;
+    }
+    ASSERT_EQ(hash_map.size(), expected.size());
+    rehashing += hash_map.rehashing();
+  }
+  EXPECT_EQ(rehashing > 0, rehash_step > 0);
+
+  size_t n = 0;
+  for (const auto& entry : hash_map) {
+    ASSERT_EQ(expected.at(entry.first), entry.second);
+    ++n;
+  }
+  EXPECT_EQ(n, expected.size());
+}
+
+TEST_F(FlatHashMapTest, RandomOps) { TestRandomOps<false>(0); }
+
+TEST_F(FlatHashMapTest, RandomOps_GroupProbe) { TestRandomOps<true>(0); }
+
+TEST_F(FlatHashMapTest, RandomOps_IncrementalRehash) {
+  TestRandomOps<false>(1);
+  TestRandomOps<false>(2);
+}
+
+TEST_F(FlatHashMapTest, RandomOps_IncrementalRehash_GroupProbe) {
+  TestRandomOps<true>(1);
+  TestRandomOps<true>(2);
+}
+
+TEST_F(FlatHashMapTest, IncrementalRehash) {
+  hash_map_t hash_map;
+  hash_map.set_rehash_step(1);
+  int k = 0;
+  for (; !hash_map.rehashing(); ++k) {
+    hash_map.emplace(k, k);
+  }
+  size_t bucket_size = hash_map.bucket_size();
+
+  // Keys in both tables are visible to lookups, iteration and erase.
+  int sum = 0;
+  for (int i = 0; i < k; ++i) {
+    EXPECT_EQ(hash_map.at(i), i);
+    EXPECT_EQ(hash_map.count(i), 1u);
+    EXPECT_FALSE(hash_map.emplace(i, -1).second);
+    sum += i;
+  }
+  ASSERT_TRUE(hash_map.rehashing());
+  for (const auto& entry : hash_map) {
+    sum -= entry.second;
+  }
+  EXPECT_EQ(sum, 0);
+
+  for (int i = 0; i < k; i += 2) {
+    hash_map.erase(hash_map.find(i));
+  }
+  ASSERT_TRUE(hash_map.rehashing());
+  for (int i = 0; i < k; ++i) {
+    EXPECT_EQ(hash_map.count(i), (size_t)(i % 2));
+  }
+  EXPECT_EQ(hash_map.size(), (size_t)(k / 2));
+
+  // Copy and move carry the old table.
+  hash_map_t copied = hash_map;
+  EXPECT_EQ(copied, hash_map);
+  hash_map_t moved = std::move(copied);
+  EXPECT_EQ(moved, hash_map);
+
+  // 'rehash' completes the incremental rehash.
+  hash_map.rehash(0);
+  EXPECT_FALSE(hash_map.rehashing());
+  EXPECT_EQ(hash_map.bucket_size(), bucket_size);
+  EXPECT_EQ(hash_map, moved);
+
+  // Insertions complete the incremental rehash.
+  moved.set_rehash_step(2);
+  for (int i = 0; moved.rehashing(); ++i) {
+    moved[k + i] = k + i;
+  }
+  for (int i = 1; i < k; i += 2) {
+    EXPECT_EQ(moved.at(i), i);
+  }
+  EXPECT_EQ(moved.bucket_size(), bucket_size);
+}
+
+TEST_F(FlatHashMapTest, IncrementalRehash_prepare) {
+  hash_map_t hash_map;
+  hash_map.set_rehash_step(2);
+  int k = 0;
+  for (; !hash_map.rehashing(); ++k) {
+    hash_map.emplace(k, k);
+  }
+  for (; hash_map.rehashing(); ++k) {
+    hash_map.emplace(k, k);
+  }
+
+  // The table of the next growth is being prepared,
+  // copies and moves keep preparing it.
+  size_t bucket_size = hash_map.bucket_size();
+  hash_map_t copied = hash_map;
+  hash_map_t moved = std::move(copied);
+  for (int i = 0; i < 2; ++i) {
+    hash_map_t& m = i == 0 ? hash_map : moved;
+    int j = k;
+    for (; !m.rehashing(); ++j) {
+      m.emplace(j, j);
+    }
+    EXPECT_EQ(m.bucket_size(), bucket_size * 2);
+    for (; m.rehashing(); ++j) {
+      m.emplace(j, j);
+    }
+    ASSERT_EQ(m.size(), (size_t)j);
+    for (int l = 0; l < j; ++l) {
+      EXPECT_EQ(m.at(l), l);
+    }
+  }
+  EXPECT_EQ(hash_map, moved);
+}
+
+TEST_F(FlatHashMapTest, iterator_GroupProbe) {
+  using group_hash_map_t = FlatHashMap<int, int, detail::KeyHash<int>,
+                                       detail::KeyEqual<int>, true>;
+  group_hash_map_t hash_map;
+  hash_map.reserve(N);
+  // Keys in the first and last buckets, whose meta bytes are cloned.
+  int bucket_size = (int)hash_map.bucket_size();
+  int sum = 0;
+  for (int k : {0, 1, bucket_size - 2, bucket_size - 1}) {
+    hash_map.emplace(k, k);
+    sum += k;
+  }
+  int n = 0;
+  for (const auto& entry : hash_map) {
+    sum -= entry.second;
+    ++n;
+  }
+  EXPECT_EQ(n, 4);
+  EXPECT_EQ(sum, 0);
+  hash_map.erase(hash_map.find(0));
+  hash_map.erase(hash_map.find(bucket_size - 1));
+  EXPECT_EQ(hash_map.find(0), hash_map.end());
+  EXPECT_EQ(hash_map.find(bucket_size - 1), hash_map.end());
+  EXPECT_EQ(hash_map.begin()->first, 1);
+  EXPECT_EQ(++hash_map.begin(), hash_map.find(bucket_size - 2));
+}
+
+TEST_F(FlatHashMapTest, WriteRead_GroupProbe) {
+  using group_hash_map_t = FlatHashMap<int, int, detail::KeyHash<int>,
+                                       detail::KeyEqual<int>, true>;
+  using linear_hash_map_t = FlatHashMap<int, int, detail::KeyHash<int>,
+                                        detail::KeyEqual<int>, false>;
+  linear_hash_map_t hash_map, read_hash_map2;
+  group_hash_map_t read_hash_map1;
+  for (int i = 0; i < N; ++i) {
+    hash_map.emplace(i * 7, i);
+  }
+
+  OutputStringStream os;
+  InputStringStream is;
+
+  os << hash_map;
+  ASSERT_TRUE(os);
+
+  is.SetView(os.GetBuf());
+  is >> read_hash_map1;
+  ASSERT_TRUE(is);
+  EXPECT_EQ(read_hash_map1.size(), hash_map.size());
+  for (const auto& entry : hash_map) {
+    EXPECT_EQ(read_hash_map1.at(entry.first), entry.second);
+  }
+
+  os.clear();
+  os << read_hash_map1;
+  ASSERT_TRUE(os);
+
+  is.SetView(os.GetBuf());
+  is >> read_hash_map2;
+  ASSERT_TRUE(is);
+  EXPECT_EQ(hash_map, read_hash_map2);
+}
+
 }  // namespace deepx_core
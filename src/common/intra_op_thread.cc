@@ -0,0 +1,81 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/common/intra_op_thread.h>
+#include <deepx_core/common/thread_pool.h>
+#include <algorithm>  // std::max, std::min
+#include <thread>
+
+namespace deepx_core {
+namespace {
+
+// cost of a chunk which is worth running in another thread
+constexpr int INTRA_OP_CHUNK_COST = 32768;
+
+thread_local int tls_intra_op_thread = 1;
+
+ThreadPool& GetIntraOpThreadPool() {
+  struct IntraOpThreadPool {
+    ThreadPool pool;
+    IntraOpThreadPool() {
+      int n = (int)std::thread::hardware_concurrency() - 1;
+      pool.start(std::max(n, 1));
+    }
+  };
+  static IntraOpThreadPool intra_op_thread_pool;
+  return intra_op_thread_pool.pool;
+}
+
+}  // namespace
+
+int GetIntraOpThread() noexcept { return tls_intra_op_thread; }
+
+IntraOpThreadGuard::IntraOpThreadGuard(int thread) noexcept
+    : prev_thread_(tls_intra_op_thread) {
+  tls_intra_op_thread = std::max(thread, 1);
+}
+
+IntraOpThreadGuard::~IntraOpThreadGuard() {
+  tls_intra_op_thread = prev_thread_;
+}
+
+int GetIntraOpGrain(int cost) noexcept {
+  return cost > 0 ? std::max(INTRA_OP_CHUNK_COST / cost, 1) : 1;
+}
+
+int GetIntraOpChunk(int n, int min_grain) noexcept {
+  if (n <= 0) {
+    return 0;
+  }
+  if (min_grain < 1) {
+    min_grain = 1;
+  }
+  int chunk = std::min(tls_intra_op_thread, (n - 1) / min_grain + 1);
+  // drop trailing empty chunks
+  int grain = (n - 1) / chunk + 1;
+  return (n - 1) / grain + 1;
+}
+
+void IntraOpParallelFor(int n, int min_grain, const intra_op_function_t& func) {
+  int chunk = GetIntraOpChunk(n, min_grain);
+  if (chunk == 0) {
+    return;
+  }
+  if (chunk == 1) {
+    func(0, 0, n);
+    return;
+  }
+
+  int grain = (n - 1) / chunk + 1;
+  GetIntraOpThreadPool().parallel_for(
+      0, chunk, 1, [n, grain, &func](int chunk_begin, int chunk_end) {
+        // Kernels in chunks run single-threaded.
+        IntraOpThreadGuard guard(1);
+        for (int i = chunk_begin; i < chunk_end; ++i) {
+          func(i, i * grain, std::min(i * grain + grain, n));
+        }
+      });
+}
+
+}  // namespace deepx_core
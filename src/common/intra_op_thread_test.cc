@@ -0,0 +1,96 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/common/intra_op_thread.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <vector>
+
+namespace deepx_core {
+
+class IntraOpThreadTest : public testing::Test {
+ protected:
+  const int N = 1000;
+};
+
+TEST_F(IntraOpThreadTest, IntraOpThreadGuard) {
+  EXPECT_EQ(GetIntraOpThread(), 1);
+  {
+    IntraOpThreadGuard guard(4);
+    EXPECT_EQ(GetIntraOpThread(), 4);
+    {
+      IntraOpThreadGuard guard2(0);
+      EXPECT_EQ(GetIntraOpThread(), 1);
+    }
+    EXPECT_EQ(GetIntraOpThread(), 4);
+  }
+  EXPECT_EQ(GetIntraOpThread(), 1);
+}
+
+TEST_F(IntraOpThreadTest, GetIntraOpChunk) {
+  EXPECT_EQ(GetIntraOpChunk(0, 1), 0);
+  EXPECT_EQ(GetIntraOpChunk(N, 1), 1);
+
+  IntraOpThreadGuard guard(4);
+  EXPECT_EQ(GetIntraOpChunk(0, 1), 0);
+  EXPECT_EQ(GetIntraOpChunk(3, 1), 3);
+  EXPECT_EQ(GetIntraOpChunk(N, 1), 4);
+  EXPECT_EQ(GetIntraOpChunk(N, N / 2), 2);
+  EXPECT_EQ(GetIntraOpChunk(N, N), 1);
+  // 9 elements in chunks of 3
+  EXPECT_EQ(GetIntraOpChunk(9, 1), 3);
+}
+
+TEST_F(IntraOpThreadTest, IntraOpParallelFor_single_thread) {
+  int calls = 0;
+  IntraOpParallelFor(N, 1, [this, &calls](int chunk, int begin, int end) {
+    EXPECT_EQ(chunk, 0);
+    EXPECT_EQ(begin, 0);
+    EXPECT_EQ(end, N);
+    ++calls;
+  });
+  EXPECT_EQ(calls, 1);
+}
+
+TEST_F(IntraOpThreadTest, IntraOpParallelFor) {
+  IntraOpThreadGuard guard(4);
+  for (int min_grain : {1, 7, N / 3, N, 2 * N}) {
+    int chunk = GetIntraOpChunk(N, min_grain);
+    std::vector<int> visited(N, 0);
+    std::vector<int> chunk_visited(chunk, 0);
+    IntraOpParallelFor(N, min_grain, [&visited, &chunk_visited](
+                                         int chunk, int begin, int end) {
+      // kernels in chunks run single-threaded if there are more chunks
+      if (chunk_visited.size() > 1) {
+        EXPECT_EQ(GetIntraOpThread(), 1);
+      }
+      ++chunk_visited[chunk];
+      for (int i = begin; i < end; ++i) {
+        ++visited[i];
+      }
+    });
+    for (int i = 0; i < N; ++i) {
+      EXPECT_EQ(visited[i], 1);
+    }
+    for (int i = 0; i < chunk; ++i) {
+      EXPECT_EQ(chunk_visited[i], 1);
+    }
+  }
+  EXPECT_EQ(GetIntraOpThread(), 4);
+}
+
+TEST_F(IntraOpThreadTest, IntraOpParallelFor_nested) {
+  IntraOpThreadGuard guard(4);
+  std::atomic<int> sum(0);
+  IntraOpParallelFor(8, 1, [this, &sum](int, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      IntraOpParallelFor(N, 1, [&sum](int, int _begin, int _end) {
+        sum += _end - _begin;
+      });
+    }
+  });
+  EXPECT_EQ(sum, 8 * N);
+}
+
+}  // namespace deepx_core
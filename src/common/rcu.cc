@@ -0,0 +1,61 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/common/rcu.h>
+#include <thread>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* RCU */
+/************************************************************************/
+constexpr int RCU::SLOT_SIZE;
+
+int RCU::GetThreadSlot() noexcept {
+  static std::atomic<int> next_slot{0};
+  static thread_local int slot = next_slot.fetch_add(1) % SLOT_SIZE;
+  return slot;
+}
+
+void RCU::Synchronize() {
+  std::lock_guard<std::mutex> guard(synchronize_mutex_);
+  for (int phase = 0; phase < 2; ++phase) {
+    // New readers count in the other slots.
+    uint64_t epoch = epoch_.fetch_add(1);
+    for (Slot& slot : slots_[epoch & 1]) {
+      while (slot.count.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+}
+
+uint64_t RCU::GracePeriod() {
+  // Not in the middle of 'Synchronize'.
+  std::lock_guard<std::mutex> guard(synchronize_mutex_);
+  return epoch_.load() + 2;
+}
+
+bool RCU::PollGracePeriod(uint64_t ticket) {
+  std::unique_lock<std::mutex> guard(synchronize_mutex_, std::try_to_lock);
+  if (!guard.owns_lock()) {
+    return false;
+  }
+
+  for (;;) {
+    uint64_t epoch = epoch_.load();
+    if (epoch >= ticket) {
+      return true;
+    }
+    // Slots of the next epoch hold readers of the previous one.
+    for (const Slot& slot : slots_[(epoch + 1) & 1]) {
+      if (slot.count.load(std::memory_order_acquire) != 0) {
+        return false;
+      }
+    }
+    epoch_.fetch_add(1);
+  }
+}
+
+}  // namespace deepx_core
@@ -0,0 +1,118 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/common/rcu.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace deepx_core {
+
+class RCUTest : public testing::Test {
+ protected:
+  struct Object {
+    static std::atomic<int> alive;
+    std::atomic<int> value;
+
+    explicit Object(int v) : value(v) { ++alive; }
+    ~Object() {
+      value = -1;
+      --alive;
+    }
+  };
+};
+
+std::atomic<int> RCUTest::Object::alive{0};
+
+TEST_F(RCUTest, StoreLoad) {
+  {
+    RCUPtr<Object> ptr;
+    EXPECT_EQ(ptr.serial(), 0u);
+    EXPECT_FALSE(ptr.load());
+    {
+      RCUPtr<Object>::ReadGuard guard(ptr);
+      EXPECT_FALSE(guard);
+    }
+
+    ptr.store(std::make_shared<Object>(1));
+    EXPECT_EQ(ptr.serial(), 1u);
+    {
+      RCUPtr<Object>::ReadGuard guard(ptr);
+      ASSERT_TRUE(guard);
+      EXPECT_EQ(guard->value, 1);
+    }
+
+    uint64_t serial;
+    std::shared_ptr<Object> pinned = ptr.load(&serial);
+    EXPECT_EQ(serial, 1u);
+    ptr.store(std::make_shared<Object>(2));
+    EXPECT_EQ(ptr.serial(), 2u);
+    // The old object is alive until it is released.
+    EXPECT_EQ(pinned->value, 1);
+    EXPECT_EQ(Object::alive, 2);
+    pinned.reset();
+    EXPECT_EQ(Object::alive, 1);
+  }
+  EXPECT_EQ(Object::alive, 0);
+}
+
+TEST_F(RCUTest, ConcurrentReadStore) {
+  RCUPtr<Object> ptr;
+  ptr.store(std::make_shared<Object>(0));
+  std::atomic<int> stop{0};
+  std::atomic<int> error{0};
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 8; ++i) {
+    readers.emplace_back([&ptr, &stop, &error]() {
+      int last = 0;
+      while (!stop) {
+        RCUPtr<Object>::ReadGuard guard(ptr);
+        int value = guard->value;
+        // Values only increase, a freed object has value -1.
+        if (value < last) {
+          ++error;
+        }
+        std::this_thread::yield();
+        if (guard->value != value) {
+          ++error;
+        }
+        last = value;
+      }
+    });
+  }
+
+  for (int i = 1; i <= 1000; ++i) {
+    ptr.store(std::make_shared<Object>(i));
+    // Readers of objects before the last store have left.
+    EXPECT_EQ(Object::alive, 1);
+  }
+  stop = 1;
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(error, 0);
+  EXPECT_EQ(ptr.serial(), 1001u);
+}
+
+TEST_F(RCUTest, GracePeriod) {
+  RCU rcu;
+  EXPECT_TRUE(rcu.PollGracePeriod(rcu.GracePeriod()));
+
+  RCU::reader_t old_reader = rcu.ReadLock();
+  uint64_t ticket = rcu.GracePeriod();
+  EXPECT_FALSE(rcu.PollGracePeriod(ticket));
+  EXPECT_FALSE(rcu.PollGracePeriod(ticket));
+  // Readers which entered after don't hold the grace period.
+  RCU::reader_t new_reader = rcu.ReadLock();
+  EXPECT_FALSE(rcu.PollGracePeriod(ticket));
+  RCU::ReadUnlock(old_reader);
+  EXPECT_TRUE(rcu.PollGracePeriod(ticket));
+  EXPECT_FALSE(rcu.PollGracePeriod(rcu.GracePeriod()));
+  RCU::ReadUnlock(new_reader);
+  EXPECT_TRUE(rcu.PollGracePeriod(rcu.GracePeriod()));
+}
+
+}  // namespace deepx_core
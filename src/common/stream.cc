@@ -984,6 +984,15 @@ bool CFileStream::Open(const std::string& file, int mode) {
   }
 }
 
+bool CFileStream::Seek(size_t offset) {
+  if (fseek((FILE*)f_, (long)offset, SEEK_SET) == -1) {  // NOLINT
+    DXERROR("Failed to fseek, errno=%d(%s).", errno, strerror(errno));
+    bad_ = 1;
+    return false;
+  }
+  return true;
+}
+
 bool CFileStream::IsOpen() const noexcept { return f_; }
 
 void CFileStream::Close() noexcept {
@@ -1016,6 +1025,78 @@ void OutputStringStream::EndMessage() noexcept {
   *(int*)(&(*buf_ptr_)[0]) = (int)buf_ptr_->size();
 }
 
+size_t OutputStringStream::BeginString() {
+  size_t pos = buf_ptr_->size();
+  int place_holder = 0;
+  *this << place_holder;
+  return pos;
+}
+
+void OutputStringStream::EndString(size_t pos) noexcept {
+  *(int*)(&(*buf_ptr_)[pos]) = (int)(buf_ptr_->size() - pos - sizeof(int));
+}
+
+/************************************************************************/
+/* OutputGatherStream */
+/************************************************************************/
+size_t OutputGatherStream::Write(const void* data, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+
+  if (size >= min_ref_bytes_) {
+    pieces_.emplace_back(Piece{(const char*)data, 0, size});
+    ref_size_ += size;
+  } else {
+    if (pieces_.empty() || pieces_.back().data != nullptr) {
+      pieces_.emplace_back(Piece{nullptr, buf_.size(), 0});
+    }
+    buf_.append((const char*)data, size);
+    pieces_.back().size += size;
+  }
+  size_ += size;
+  return size;
+}
+
+std::string OutputGatherStream::GetString() const {
+  std::string s;
+  s.reserve(size_);
+  ForEachBuf(0, [&s](const char* data, size_t size) { s.append(data, size); });
+  return s;
+}
+
+void OutputGatherStream::clear() noexcept {
+  buf_.clear();
+  pieces_.clear();
+  size_ = 0;
+  ref_size_ = 0;
+}
+
+void OutputGatherStream::BeginMessage() {
+  clear();
+  int place_holder = 0;
+  *this << place_holder;
+}
+
+void OutputGatherStream::EndMessage() noexcept {
+  *(int*)(&buf_[0]) = (int)size_;
+}
+
+size_t OutputGatherStream::BeginString() {
+  // 'pos' is the position in 'buf_',
+  // the placeholder holds the stream size until 'EndString'.
+  size_t pos = buf_.size();
+  int place_holder = 0;
+  *this << place_holder;
+  *(int*)(&buf_[pos]) = (int)size_;
+  return pos;
+}
+
+void OutputGatherStream::EndString(size_t pos) noexcept {
+  int* place_holder = (int*)(&buf_[pos]);
+  *place_holder = (int)size_ - *place_holder;
+}
+
 /************************************************************************/
 /* InputStringStream */
 /************************************************************************/
@@ -1719,6 +1800,16 @@ bool HDFSFileStream::Open(const std::string& file, int mode) {
   }
 }
 
+bool HDFSFileStream::Seek(size_t offset) {
+  if (phdfsSeek((hdfsFS)handle_->raw_handle(),  // NOLINT
+                (hdfsFile)f_, (tOffset)offset) == -1) {
+    DXERROR("Failed to hdfsSeek, errno=%d(%s).", errno, strerror(errno));
+    bad_ = 1;
+    return false;
+  }
+  return true;
+}
+
 bool HDFSFileStream::IsOpen() const noexcept { return f_; }
 
 void HDFSFileStream::Close() noexcept {
@@ -1977,8 +2068,17 @@ size_t AutoInputFileStream::Peek(void* data, size_t size) {
 }
 
 bool AutoInputFileStream::Open(const std::string& file) {
+  return Open(file, 0);
+}
+
+bool AutoInputFileStream::Open(const std::string& file, size_t offset) {
   Close();
 
+  if (offset > 0 && (IsGzipFile(file) || IsStdinStdoutPath(file))) {
+    DXERROR("Couldn't seek %s.", file.c_str());
+    return false;
+  }
+
   if (IsHDFSPath(file)) {
     if (!HasHDFS()) {
       return false;
@@ -2001,6 +2101,10 @@ bool AutoInputFileStream::Open(const std::string& file) {
       return false;
     }
 
+    if (offset > 0 && !is_extra->Seek(offset)) {
+      return false;
+    }
+
     hdfs_handle_ = std::move(hdfs_handle);
     is_extra_ = std::move(is_extra);
     if (IsGzipFile(file)) {
@@ -2018,6 +2122,10 @@ bool AutoInputFileStream::Open(const std::string& file) {
       return false;
     }
 
+    if (offset > 0 && !is_extra->Seek(offset)) {
+      return false;
+    }
+
     is_extra_ = std::move(is_extra);
     if (IsGzipFile(file)) {
       is_.reset(new GunzipInputStream(is_extra_.get()));
@@ -460,6 +460,75 @@ TEST_F(OutputStringStreamTest, SetView_Write) {
   EXPECT_EQ(os.GetSize(), 8u);
 }
 
+TEST_F(OutputStringStreamTest, BeginString_EndString) {
+  OutputStringStream os;
+  os << std::string("12");
+  size_t pos = os.BeginString();
+  os.Write("345", 3);
+  os.EndString(pos);
+
+  std::string expected;
+  OutputStringStream expected_os;
+  expected_os.SetView(&expected);
+  expected_os << std::string("12") << std::string("345");
+  EXPECT_EQ(os.GetString(), expected);
+}
+
+/************************************************************************/
+/* OutputGatherStream */
+/************************************************************************/
+class OutputGatherStreamTest : public testing::Test {};
+
+TEST_F(OutputGatherStreamTest, Write) {
+  std::string large(100, 'a');
+  OutputGatherStream os;
+  os.set_min_ref_bytes(16);
+  os.Write("1234", 4);
+  os.Write("5678", 4);
+  os.Write(large.data(), large.size());
+  os.Write("9", 1);
+  EXPECT_EQ(os.GetSize(), 109u);
+  EXPECT_EQ(os.GetRefSize(), 100u);
+  EXPECT_EQ(os.GetPieceSize(), 3u);
+  EXPECT_EQ(os.GetString(), "12345678" + large + "9");
+
+  // referenced, not copied
+  large[0] = 'b';
+  EXPECT_EQ(os.GetString(), "12345678" + large + "9");
+
+  std::string s;
+  os.ForEachBuf(6, [&s](const char* data, size_t size) {
+    s.append(data, size);
+  });
+  EXPECT_EQ(s, "78" + large + "9");
+
+  os.clear();
+  EXPECT_EQ(os.GetSize(), 0u);
+  EXPECT_EQ(os.GetString(), "");
+}
+
+TEST_F(OutputGatherStreamTest, BeginMessage_BeginString) {
+  std::string large(100, 'a');
+  OutputGatherStream os;
+  os.set_min_ref_bytes(16);
+  os.BeginMessage();
+  size_t pos = os.BeginString();
+  os << large;
+  os.EndString(pos);
+  os.EndMessage();
+
+  std::string expected;
+  OutputStringStream expected_os;
+  expected_os.SetView(&expected);
+  expected_os.BeginMessage();
+  pos = expected_os.BeginString();
+  expected_os << large;
+  expected_os.EndString(pos);
+  expected_os.EndMessage();
+  EXPECT_EQ(os.GetString(), expected);
+  EXPECT_EQ(os.GetRefSize(), 100u);
+}
+
 /************************************************************************/
 /* InputStringStream */
 /************************************************************************/
@@ -3,54 +3,165 @@
 //
 
 #include <deepx_core/common/thread_pool.h>
+#include <algorithm>  // std::min
+#include <chrono>
 #include <utility>
 #if !defined NDEBUG
 #include <stdexcept>  // std::runtime_error
 #endif
 
 namespace deepx_core {
+namespace {
 
-int ThreadPool::started() const {
-  std::unique_lock<std::mutex> guard(mutex_);
-  return started_;
+// the pool and the worker index of the current thread
+thread_local const ThreadPool* tls_thread_pool = nullptr;
+thread_local int tls_worker = -1;
+
+}  // namespace
+
+void ThreadPool::TaskQueue::push_back(task_t&& task) {
+  if (size_ == buf_.size()) {
+    size_t capacity = buf_.empty() ? 16 : buf_.size() * 2;  // magic number
+    std::vector<task_t> buf(capacity);
+    for (size_t i = 0; i < size_; ++i) {
+      buf[i] = std::move(buf_[(head_ + i) & (buf_.size() - 1)]);
+    }
+    buf_.swap(buf);
+    head_ = 0;
+  }
+  buf_[(head_ + size_) & (buf_.size() - 1)] = std::move(task);
+  ++size_;
+}
+
+void ThreadPool::TaskQueue::pop_back(task_t* task) noexcept {
+  --size_;
+  *task = std::move(buf_[(head_ + size_) & (buf_.size() - 1)]);
+}
+
+void ThreadPool::TaskQueue::pop_front(task_t* task) noexcept {
+  *task = std::move(buf_[head_]);
+  head_ = (head_ + 1) & (buf_.size() - 1);
+  --size_;
 }
 
-void ThreadPool::worker_thread() {
-  function_t func;
+int ThreadPool::current_worker() const noexcept {
+  return tls_thread_pool == this ? tls_worker : -1;
+}
+
+bool ThreadPool::pop_task(int i, task_t* task) {
+  int n = (int)workers_.size();
+  if (i >= 0) {
+    // pop from the back of its own deque
+    Worker& worker = *workers_[i];
+    std::unique_lock<std::mutex> guard(worker.mutex);
+    if (!worker.tasks.empty()) {
+      worker.tasks.pop_back(task);
+      --pending_;
+      return true;
+    }
+  }
+
+  // steal from the front of other deques
+  int begin = i >= 0 ? i + 1 : (int)(next_worker_.load() % (unsigned)n);
+  for (int j = 0; j < n; ++j) {
+    int k = (begin + j) % n;
+    if (k == i) {
+      continue;
+    }
+    Worker& worker = *workers_[k];
+    std::unique_lock<std::mutex> guard(worker.mutex);
+    if (!worker.tasks.empty()) {
+      worker.tasks.pop_front(task);
+      --pending_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::worker_thread(int i) {
+  tls_thread_pool = this;
+  tls_worker = i;
+
+  task_t task;
   for (;;) {
+    if (pop_task(i, &task)) {
+      task();
+      task.reset();
+      continue;
+    }
+
     std::unique_lock<std::mutex> guard(mutex_);
-    while (started_ && tasks_.empty()) {
+    ++sleeping_;
+    while (started_ && pending_ == 0) {
       cond_.wait(guard);
     }
-
-    if (!started_) {
+    --sleeping_;
+    if (!started_ && pending_ == 0) {
+      // all remaining function objects have been run
       break;
     }
+  }
 
-    func = std::move(tasks_.front());
-    tasks_.pop_front();
-    guard.unlock();
-    func();
+  tls_thread_pool = nullptr;
+  tls_worker = -1;
+}
+
+void ThreadPool::wait(wait_token_t* token) {
+  int i = current_worker();
+  if (i >= 0) {
+    // Run other tasks while waiting in a worker thread,
+    // otherwise nested waits may deadlock.
+    task_t task;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> guard(token->mutex);
+        if (token->remain == 0) {
+          return;
+        }
+      }
+      if (pop_task(i, &task)) {
+        task();
+        task.reset();
+      } else {
+        std::unique_lock<std::mutex> guard(token->mutex);
+        if (token->remain) {
+          token->cond.wait_for(guard, std::chrono::microseconds(100));
+        }
+      }
+    }
   }
 
-  std::unique_lock<std::mutex> guard(mutex_);
-  while (!tasks_.empty()) {
-    func = std::move(tasks_.front());
-    tasks_.pop_front();
-    guard.unlock();
-    func();
-    guard.lock();
+  std::unique_lock<std::mutex> guard(token->mutex);
+  while (token->remain) {
+    token->cond.wait(guard);
   }
 }
 
+void ThreadPool::done(wait_token_t* token) {
+  std::unique_lock<std::mutex> guard(token->mutex);
+  if (--token->remain == 0) {
+    token->cond.notify_all();
+  }
+}
+
+ThreadPool::ThreadPool() {
+  // Tasks posted before 'start' are queued in it.
+  workers_.emplace_back(new Worker);
+}
+
 ThreadPool::~ThreadPool() { stop(); }
 
 void ThreadPool::start(int n) {
   std::unique_lock<std::mutex> guard(mutex_);
   if (!started_) {
     started_ = 1;
+    // Deques are kept after 'stop', tasks in them are not lost.
+    while ((int)workers_.size() < n) {
+      workers_.emplace_back(new Worker);
+    }
     for (int i = 0; i < n; ++i) {
-      threads_.emplace_back([this]() { worker_thread(); });
+      threads_.emplace_back([this, i]() { worker_thread(i); });
     }
   }
 }
@@ -72,18 +183,32 @@ void ThreadPool::stop() {
   }
 }
 
-void ThreadPool::post(function_t func) {
+void ThreadPool::post_task(task_t&& task) {
 #if !defined NDEBUG
   if (!started()) {
     throw std::runtime_error("post: the thread pool is not started.");
   }
 #endif
 
+  int i = current_worker();
+  if (i < 0) {
+    i = (int)(next_worker_++ % (unsigned)workers_.size());
+  }
+
   {
+    Worker& worker = *workers_[i];
+    std::unique_lock<std::mutex> guard(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+    ++pending_;
+  }
+
+  if (sleeping_ > 0) {
+    // Lock to avoid lost wakeups,
+    // a worker thread checks 'pending_' and sleeps with 'mutex_' locked.
     std::unique_lock<std::mutex> guard(mutex_);
-    tasks_.emplace_front(std::move(func));
+    guard.unlock();
+    cond_.notify_one();
   }
-  cond_.notify_one();
 }
 
 void ThreadPool::run(const function_t& func, wait_token_t* token) {
@@ -96,16 +221,9 @@ void ThreadPool::run(const function_t& func, wait_token_t* token) {
   token->remain = 1;
   post([&func, token] {
     func();
-    std::unique_lock<std::mutex> guard(token->mutex);
-    if (--token->remain == 0) {
-      token->cond.notify_all();
-    }
+    done(token);
   });
-
-  std::unique_lock<std::mutex> guard(token->mutex);
-  while (token->remain) {
-    token->cond.wait(guard);
-  }
+  wait(token);
 }
 
 void ThreadPool::run(const std::vector<function_t>& funcs,
@@ -120,17 +238,52 @@ void ThreadPool::run(const std::vector<function_t>& funcs,
   for (const function_t& func : funcs) {
     post([&func, token] {
       func();
-      std::unique_lock<std::mutex> guard(token->mutex);
-      if (--token->remain == 0) {
-        token->cond.notify_all();
-      }
+      done(token);
     });
   }
+  wait(token);
+}
 
-  std::unique_lock<std::mutex> guard(token->mutex);
-  while (token->remain) {
-    token->cond.wait(guard);
+void ThreadPool::parallel_for_impl(int begin, int end, int grain,
+                                   void (*call)(void*, int, int), void* func) {
+  if (begin >= end) {
+    return;
+  }
+  if (grain < 1) {
+    grain = 1;
+  }
+
+  int chunks = (end - begin - 1) / grain + 1;
+  std::atomic<int> next_chunk(0);
+  auto run_chunks = [begin, end, grain, chunks, call, func, &next_chunk]() {
+    for (;;) {
+      int chunk = next_chunk++;
+      if (chunk >= chunks) {
+        break;
+      }
+      int chunk_begin = begin + chunk * grain;
+      call(func, chunk_begin,
+           chunk_begin + std::min(grain, end - chunk_begin));
+    }
+  };
+
+  int helpers = std::min(chunks, size() + 1) - 1;
+  if (!started() || helpers == 0) {
+    run_chunks();
+    return;
+  }
+
+  wait_token_t token;
+  token.remain = helpers;
+  for (int i = 0; i < helpers; ++i) {
+    post([&run_chunks, &token]() {
+      run_chunks();
+      done(&token);
+    });
   }
+  // The calling thread claims chunks too.
+  run_chunks();
+  wait(&token);
 }
 
 }  // namespace deepx_core
@@ -4,10 +4,81 @@
 
 #include <deepx_core/common/thread_pool.h>
 #include <gtest/gtest.h>
+#include <array>
 #include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
 
 namespace deepx_core {
 
+class ThreadPoolTaskTest : public testing::Test {
+ protected:
+  // use_count of 'called' counts live copies
+  struct Func {
+    std::shared_ptr<int> called;
+    void operator()() { ++*called; }
+  };
+
+  struct LargeFunc : Func {
+    std::array<char, ThreadPoolTask::INLINE_SIZE> padding;
+  };
+
+  struct MoveOnlyFunc {
+    std::unique_ptr<int> value;
+    int* out;
+    void operator()() { *out = *value; }
+  };
+};
+
+TEST_F(ThreadPoolTaskTest, is_inline) {
+  EXPECT_TRUE(ThreadPoolTask::is_inline<Func>());
+  EXPECT_TRUE(ThreadPoolTask::is_inline<ThreadPool::function_t>());
+  EXPECT_FALSE(ThreadPoolTask::is_inline<LargeFunc>());
+}
+
+TEST_F(ThreadPoolTaskTest, Inline) {
+  std::shared_ptr<int> called(new int(0));
+  ThreadPoolTask task(Func{called});
+  EXPECT_TRUE((bool)task);
+  EXPECT_EQ(called.use_count(), 2);
+
+  ThreadPoolTask task2(std::move(task));
+  EXPECT_FALSE((bool)task);
+  task2();
+  EXPECT_EQ(*called, 1);
+  EXPECT_EQ(called.use_count(), 2);
+
+  task = std::move(task2);
+  task();
+  EXPECT_EQ(*called, 2);
+  task.reset();
+  EXPECT_FALSE((bool)task);
+  EXPECT_EQ(called.use_count(), 1);
+}
+
+TEST_F(ThreadPoolTaskTest, Heap) {
+  std::shared_ptr<int> called(new int(0));
+  LargeFunc func = LargeFunc();
+  func.called = called;
+  {
+    ThreadPoolTask task(std::move(func));
+    ThreadPoolTask task2(std::move(task));
+    task2();
+    EXPECT_EQ(*called, 1);
+    EXPECT_EQ(called.use_count(), 2);
+  }
+  EXPECT_EQ(called.use_count(), 1);
+}
+
+TEST_F(ThreadPoolTaskTest, MoveOnly) {
+  int out = 0;
+  ThreadPoolTask task(MoveOnlyFunc{std::unique_ptr<int>(new int(6)), &out});
+  ThreadPoolTask task2(std::move(task));
+  task2();
+  EXPECT_EQ(out, 6);
+}
+
 class ThreadPoolTest : public testing::Test {
  protected:
   const int N = 1000;
@@ -24,6 +95,35 @@ TEST_F(ThreadPoolTest, post) {
   EXPECT_EQ(sum, N * (N - 1) / 2);
 }
 
+#if defined NDEBUG
+TEST_F(ThreadPoolTest, post_not_started) {
+  // Tasks are queued until the pool is started.
+  ThreadPool thread_pool;
+  std::atomic<int> sum(0);
+  for (int i = 0; i < N; ++i) {
+    thread_pool.post([&sum, i]() { sum += i; });
+  }
+  EXPECT_EQ(sum, 0);
+  thread_pool.start(4);
+  thread_pool.stop();
+  EXPECT_EQ(sum, N * (N - 1) / 2);
+}
+#endif
+
+TEST_F(ThreadPoolTest, post_many) {
+  // deques grow while tasks are pending
+  ThreadPool thread_pool;
+  std::atomic<int> sum(0);
+  thread_pool.start(1);
+  thread_pool.post([&thread_pool, &sum]() {
+    for (int i = 0; i < 1000; ++i) {
+      thread_pool.post([&sum, i]() { sum += i; });
+    }
+  });
+  thread_pool.stop();
+  EXPECT_EQ(sum, 1000 * 999 / 2);
+}
+
 TEST_F(ThreadPoolTest, run_1) {
   ThreadPool thread_pool;
   ThreadPool::wait_token_t token;
@@ -49,4 +149,81 @@ TEST_F(ThreadPoolTest, run_2) {
   EXPECT_EQ(sum, N * (N - 1));
 }
 
+TEST_F(ThreadPoolTest, post_in_worker_thread) {
+  ThreadPool thread_pool;
+  std::atomic<int> sum(0);
+  thread_pool.start(4);
+  for (int i = 0; i < N; ++i) {
+    thread_pool.post([&thread_pool, &sum, i]() {
+      thread_pool.post([&sum, i]() { sum += i; });
+    });
+  }
+  thread_pool.stop();
+  EXPECT_EQ(sum, N * (N - 1) / 2);
+}
+
+TEST_F(ThreadPoolTest, run_nested) {
+  ThreadPool thread_pool;
+  ThreadPool::wait_token_t token;
+  std::atomic<int> sum(0);
+  thread_pool.start(1);
+  for (int i = 0; i < N; ++i) {
+    thread_pool.run(
+        [&thread_pool, &sum, i]() {
+          ThreadPool::wait_token_t nested_token;
+          thread_pool.run([&sum, i]() { sum += i; }, &nested_token);
+        },
+        &token);
+  }
+  thread_pool.stop();
+  EXPECT_EQ(sum, N * (N - 1) / 2);
+}
+
+TEST_F(ThreadPoolTest, parallel_for) {
+  ThreadPool thread_pool;
+  thread_pool.start(4);
+  for (int grain : {1, 7, N, 2 * N}) {
+    std::vector<int> visited(N, 0);
+    thread_pool.parallel_for(0, N, grain,
+                             [&visited, grain](int begin, int end) {
+                               EXPECT_LE(end - begin, grain);
+                               for (int i = begin; i < end; ++i) {
+                                 ++visited[i];
+                               }
+                             });
+    for (int i = 0; i < N; ++i) {
+      EXPECT_EQ(visited[i], 1);
+    }
+  }
+  thread_pool.stop();
+}
+
+TEST_F(ThreadPoolTest, parallel_for_not_started) {
+  ThreadPool thread_pool;
+  std::vector<int> visited(N, 0);
+  thread_pool.parallel_for(10, N, 3, [&visited](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      ++visited[i];
+    }
+  });
+  for (int i = 0; i < N; ++i) {
+    EXPECT_EQ(visited[i], i < 10 ? 0 : 1);
+  }
+}
+
+TEST_F(ThreadPoolTest, parallel_for_nested) {
+  ThreadPool thread_pool;
+  std::atomic<int> sum(0);
+  thread_pool.start(2);
+  thread_pool.parallel_for(0, 8, 1, [&thread_pool, &sum](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      thread_pool.parallel_for(0, 100, 10, [&sum](int _begin, int _end) {
+        sum += _end - _begin;
+      });
+    }
+  });
+  thread_pool.stop();
+  EXPECT_EQ(sum, 800);
+}
+
 }  // namespace deepx_core
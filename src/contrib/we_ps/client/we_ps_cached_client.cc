@@ -0,0 +1,405 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/common/profile_util.h>
+#include <deepx_core/contrib/we_ps/client/we_ps_cached_client.h>
+#include <deepx_core/dx_log.h>
+#include <chrono>
+#include <cstdlib>  // getenv
+#include <cstring>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* WePSCachedClient */
+/************************************************************************/
+WePSCachedClient::WePSCachedClient() {
+  const char* enable_profile =
+      getenv("DEEPX_WE_PS_CACHED_CLIENT_ENABLE_PROFILE");
+  if (enable_profile && strcmp(enable_profile, "1") == 0) {
+    enable_profile_ = 1;
+  } else {
+    enable_profile_ = 0;
+  }
+}
+
+WePSCachedClient::~WePSCachedClient() {
+  if (enable_profile_) {
+    DumpProfile();
+  }
+}
+
+bool WePSCachedClient::InitConfig(const AnyMap& config) {
+  StringMap _config;
+  AnyMapToStringMap(config, &_config);
+  return InitConfig(_config);
+}
+
+bool WePSCachedClient::InitConfig(const StringMap& config) {
+  StringMap client_config;
+  std::string client_name;
+  for (const auto& entry : config) {
+    const std::string& k = entry.first;
+    const std::string& v = entry.second;
+    if (k == "client") {
+      client_name = v;
+    } else if (k == "cache_capacity") {
+      cache_capacity_ = std::stoi(v);
+      if (cache_capacity_ < 0) {
+        DXERROR("Invalid cache_capacity: %d.", cache_capacity_);
+        return false;
+      }
+    } else if (k == "cache_max_staleness_batch") {
+      cache_max_staleness_batch_ = std::stoi(v);
+      if (cache_max_staleness_batch_ < 0) {
+        DXERROR("Invalid cache_max_staleness_batch: %d.",
+                cache_max_staleness_batch_);
+        return false;
+      }
+    } else if (k == "cache_max_staleness_second") {
+      cache_max_staleness_second_ = std::stod(v);
+      if (cache_max_staleness_second_ < 0) {
+        DXERROR("Invalid cache_max_staleness_second: %f.",
+                cache_max_staleness_second_);
+        return false;
+      }
+    } else {
+      client_config.emplace(k, v);
+    }
+  }
+
+  if (client_name.empty()) {
+    DXERROR("Please specify client.");
+    return false;
+  }
+  if (client_name == "cached" || client_name == class_name()) {
+    DXERROR("Invalid client: %s.", client_name.c_str());
+    return false;
+  }
+
+  client_ = NewWePSClient(client_name);
+  if (!client_) {
+    return false;
+  }
+  cache_map_.clear();
+  return client_->InitConfig(client_config);
+}
+
+double WePSCachedClient::Now() noexcept {
+  auto now = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(now.time_since_epoch()).count();
+}
+
+bool WePSCachedClient::IsFresh(const CachedRow& row,
+                               double now) const noexcept {
+  if (cache_max_staleness_batch_ > 0 &&
+      batch_ - row.batch >= cache_max_staleness_batch_) {
+    return false;
+  }
+  if (cache_max_staleness_second_ > 0 &&
+      now - row.second >= cache_max_staleness_second_) {
+    return false;
+  }
+  return true;
+}
+
+WePSCachedClient::cache_t* WePSCachedClient::GetCache(
+    const std::string& name) {
+  std::unique_ptr<cache_t>& cache = cache_map_[name];
+  if (!cache) {
+    cache.reset(new cache_t);
+    cache->init((size_t)cache_capacity_);
+  }
+  return cache.get();
+}
+
+void WePSCachedClient::GetCachedRows(const std::string& name,
+                                     const id_set_t& id_set, double now,
+                                     srm_t* W, id_set_t* miss_id_set) {
+  cache_t* cache = GetCache(name);
+  CacheStat& stat = stat_map_[name];
+  miss_id_set->clear();
+  for (int_t id : id_set) {
+    auto node = cache->get(id);
+    if (!node) {
+      ++stat.miss;
+      miss_id_set->emplace(id);
+    } else if (!IsFresh(node->value(), now)) {
+      ++stat.stale;
+      miss_id_set->emplace(id);
+    } else {
+      ++stat.hit;
+      DXASSERT((int)node->value().embedding.size() == W->col());
+      W->assign(id, node->value().embedding.data());
+    }
+  }
+}
+
+void WePSCachedClient::PutFetchedRows(const std::string& name,
+                                      const srm_t& miss_W, double now,
+                                      srm_t* W) {
+  cache_t* cache = GetCache(name);
+  int col = miss_W.col();
+  for (const auto& entry : miss_W) {
+    int_t id = entry.first;
+    const float_t* embedding = entry.second;
+    W->assign(id, embedding);
+    auto node = cache->get_or_insert(id);
+    CachedRow* row = node->mutable_value();
+    row->embedding.assign(embedding, embedding + col);
+    row->batch = batch_;
+    row->second = now;
+  }
+}
+
+void WePSCachedClient::SetCachedRows(const std::string& name, const srm_t& W) {
+  cache_t* cache = GetCache(name);
+  double now = Now();
+  int col = W.col();
+  for (const auto& entry : W) {
+    int_t id = entry.first;
+    const float_t* embedding = entry.second;
+    auto node = cache->get_or_insert(id);
+    CachedRow* row = node->mutable_value();
+    row->embedding.assign(embedding, embedding + col);
+    row->batch = batch_;
+    row->second = now;
+  }
+}
+
+void WePSCachedClient::UpdateCachedRows(const std::string& name,
+                                        const srm_t& delta_W) {
+  cache_t* cache = GetCache(name);
+  int col = delta_W.col();
+  for (const auto& entry : delta_W) {
+    int_t id = entry.first;
+    const float_t* delta_embedding = entry.second;
+    auto node = cache->get(id);
+    if (node) {
+      // Only the delta is applied, 'batch' and 'second' are left untouched,
+      // updates from other workers are still bounded by them.
+      std::vector<float_t>& embedding = node->mutable_value()->embedding;
+      DXASSERT((int)embedding.size() == col);
+      ll_math_t::add(col, embedding.data(), delta_embedding, embedding.data());
+    }
+  }
+}
+
+void WePSCachedClient::SetCachedRows(const TensorMap& param) {
+  for (const auto& entry : param) {
+    const std::string& name = entry.first;
+    const Any& Wany = entry.second;
+    if (Wany.is<srm_t>()) {
+      SetCachedRows(name, Wany.unsafe_to_ref<srm_t>());
+    }
+  }
+}
+
+void WePSCachedClient::UpdateCachedRows(const TensorMap& delta_param) {
+  for (const auto& entry : delta_param) {
+    const std::string& name = entry.first;
+    const Any& delta_Wany = entry.second;
+    if (delta_Wany.is<srm_t>()) {
+      UpdateCachedRows(name, delta_Wany.unsafe_to_ref<srm_t>());
+    }
+  }
+}
+
+void WePSCachedClient::DumpProfile() const {
+  for (const auto& entry : stat_map_) {
+    const std::string& name = entry.first;
+    const CacheStat& stat = entry.second;
+    int64_t total = stat.hit + stat.miss + stat.stale;
+    if (total == 0) {
+      continue;
+    }
+    DXINFO("%s: hit=%lld(%.2f%%), miss=%lld(%.2f%%), stale=%lld(%.2f%%).",
+           name.c_str(), (long long)stat.hit, 100.0 * stat.hit / total,
+           (long long)stat.miss, 100.0 * stat.miss / total,
+           (long long)stat.stale, 100.0 * stat.stale / total);
+  }
+
+  if (get_srm_nanosecond_ > 0) {
+    std::vector<ProfileItem> items;
+    items.emplace_back("GetSRM(cache)",
+                       get_srm_nanosecond_ - client_get_srm_nanosecond_);
+    items.emplace_back("GetSRM(client)", client_get_srm_nanosecond_);
+    DumpProfileItems(&items);
+  }
+}
+
+bool WePSCachedClient::SetTSR(const std::string& name, const tsr_t& W) {
+  return client_->SetTSR(name, W);
+}
+
+bool WePSCachedClient::GetTSR(const std::string& name, tsr_t* W) {
+  return client_->GetTSR(name, W);
+}
+
+bool WePSCachedClient::UpdateTSR(const std::string& name,
+                                 const tsr_t& delta_W, tsr_t* new_W) {
+  return client_->UpdateTSR(name, delta_W, new_W);
+}
+
+bool WePSCachedClient::SetTSR(const TensorMap& param) {
+  return client_->SetTSR(param);
+}
+
+bool WePSCachedClient::GetTSR(TensorMap* param) {
+  return client_->GetTSR(param);
+}
+
+bool WePSCachedClient::UpdateTSR(const TensorMap& delta_param,
+                                 TensorMap* new_param) {
+  return client_->UpdateTSR(delta_param, new_param);
+}
+
+bool WePSCachedClient::SetSRM(const std::string& name, const srm_t& W) {
+  if (!client_->SetSRM(name, W)) {
+    return false;
+  }
+  if (cache_capacity_ > 0) {
+    SetCachedRows(name, W);
+  }
+  return true;
+}
+
+bool WePSCachedClient::GetSRM(const std::string& name, const id_set_t& id_set,
+                              srm_t* W) {
+  if (cache_capacity_ == 0) {
+    return client_->GetSRM(name, id_set, W);
+  }
+
+  NanosecondTimerGuard guard(get_srm_nanosecond_);
+  ++batch_;
+  double now = Now();
+  W->zeros();
+  id_set_t& miss_id_set = miss_id_set_map_[name];
+  GetCachedRows(name, id_set, now, W, &miss_id_set);
+  if (miss_id_set.empty()) {
+    return true;
+  }
+
+  auto& miss_W = miss_param_.get_or_insert<srm_t>(name);
+  miss_W.set_col(W->col());
+  miss_W.zeros();
+  {
+    NanosecondTimerGuard _guard(client_get_srm_nanosecond_);
+    if (!client_->GetSRM(name, miss_id_set, &miss_W)) {
+      return false;
+    }
+  }
+  PutFetchedRows(name, miss_W, now, W);
+  return true;
+}
+
+bool WePSCachedClient::UpdateSRM(const std::string& name,
+                                 const srm_t& delta_W) {
+  if (!client_->UpdateSRM(name, delta_W)) {
+    return false;
+  }
+  if (cache_capacity_ > 0) {
+    UpdateCachedRows(name, delta_W);
+  }
+  return true;
+}
+
+bool WePSCachedClient::SetSRM(const TensorMap& param) {
+  if (!client_->SetSRM(param)) {
+    return false;
+  }
+  if (cache_capacity_ > 0) {
+    SetCachedRows(param);
+  }
+  return true;
+}
+
+bool WePSCachedClient::GetSRM(
+    const std::unordered_map<std::string, id_set_t>& id_set_map,
+    TensorMap* param) {
+  if (cache_capacity_ == 0) {
+    return client_->GetSRM(id_set_map, param);
+  }
+
+  NanosecondTimerGuard guard(get_srm_nanosecond_);
+  ++batch_;
+  double now = Now();
+  param->ClearSRMValue();
+  miss_id_set_map_.clear();
+  for (const auto& entry : id_set_map) {
+    const std::string& name = entry.first;
+    const id_set_t& id_set = entry.second;
+    auto& W = param->get<srm_t>(name);
+    id_set_t miss_id_set;
+    GetCachedRows(name, id_set, now, &W, &miss_id_set);
+    if (!miss_id_set.empty()) {
+      auto& miss_W = miss_param_.get_or_insert<srm_t>(name);
+      miss_W.set_col(W.col());
+      miss_id_set_map_.emplace(name, std::move(miss_id_set));
+    }
+  }
+  if (miss_id_set_map_.empty()) {
+    return true;
+  }
+
+  miss_param_.ClearSRMValue();
+  {
+    NanosecondTimerGuard _guard(client_get_srm_nanosecond_);
+    if (!client_->GetSRM(miss_id_set_map_, &miss_param_)) {
+      return false;
+    }
+  }
+  for (const auto& entry : miss_id_set_map_) {
+    const std::string& name = entry.first;
+    PutFetchedRows(name, miss_param_.get<srm_t>(name), now,
+                   &param->get<srm_t>(name));
+  }
+  return true;
+}
+
+bool WePSCachedClient::UpdateSRM(const TensorMap& delta_param) {
+  if (!client_->UpdateSRM(delta_param)) {
+    return false;
+  }
+  if (cache_capacity_ > 0) {
+    UpdateCachedRows(delta_param);
+  }
+  return true;
+}
+
+bool WePSCachedClient::UpdateParam(const TensorMap& delta_param,
+                                   const TensorMap& new_srm_param,
+                                   TensorMap* new_tsr_param) {
+  if (!client_->UpdateParam(delta_param, new_srm_param, new_tsr_param)) {
+    return false;
+  }
+  if (cache_capacity_ > 0) {
+    SetCachedRows(new_srm_param);
+    UpdateCachedRows(delta_param);
+  }
+  return true;
+}
+
+bool WePSCachedClient::SetParam(const TensorMap& param) {
+  if (!client_->SetParam(param)) {
+    return false;
+  }
+  if (cache_capacity_ > 0) {
+    SetCachedRows(param);
+  }
+  return true;
+}
+
+bool WePSCachedClient::SetGraph(const Graph& graph) {
+  return client_->SetGraph(graph);
+}
+
+bool WePSCachedClient::GetGraph(Graph* graph, int* exist) {
+  return client_->GetGraph(graph, exist);
+}
+
+WE_PS_CLIENT_REGISTER(WePSCachedClient, "WePSCachedClient");
+WE_PS_CLIENT_REGISTER(WePSCachedClient, "cached");
+
+}  // namespace deepx_core
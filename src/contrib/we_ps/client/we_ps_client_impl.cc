@@ -7,6 +7,20 @@
 
 namespace deepx_core {
 
+/************************************************************************/
+/* WePSClient */
+/************************************************************************/
+bool WePSClient::UpdateParam(const TensorMap& delta_param,
+                             const TensorMap& new_srm_param,
+                             TensorMap* new_tsr_param) {
+  return UpdateTSR(delta_param, new_tsr_param) && SetSRM(new_srm_param) &&
+         UpdateSRM(delta_param);
+}
+
+bool WePSClient::SetParam(const TensorMap& param) {
+  return SetTSR(param) && SetSRM(param);
+}
+
 /************************************************************************/
 /* WePSClient functions */
 /************************************************************************/
@@ -4,6 +4,7 @@
 //
 
 #include <deepx_core/common/any_map.h>
+#include <deepx_core/contrib/we_ps/client/we_ps_cached_client.h>
 #include <deepx_core/contrib/we_ps/client/we_ps_client.h>
 #include <deepx_core/dx_gtest.h>
 #include <deepx_core/graph/tensor_map.h>
@@ -261,6 +262,43 @@ class WePSClientTest : public testing::Test, public DataType {
     EXPECT_SRM_DELTA(W1, delta_W1, new_W1);
   }
 
+  void TestUpdateParam() {
+    TensorMap param;
+    auto& W0 = param.insert<tsr_t>("TSR_W0").resize(2, 3).randn(engine);
+    auto& W1 = param.insert<srm_t>("SRM_W1");
+    W1.set_col(8);
+    W1.set_initializer(TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+    W1.get_row(engine, 1);
+    W1.get_row(engine, 2);
+    ASSERT_TRUE(client->SetParam(param));
+
+    TensorMap new_srm_param;
+    auto& new_W1 = new_srm_param.insert<srm_t>("SRM_W1");
+    new_W1.set_col(8);
+    new_W1.set_initializer(TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+    new_W1.get_row(engine, 3);
+
+    TensorMap delta_param, new_tsr_param;
+    auto& delta_W0 =
+        delta_param.insert<tsr_t>("TSR_W0").resize(W0.shape()).randn(engine);
+    auto& delta_W1 = delta_param.insert<srm_t>("SRM_W1");
+    delta_W1.set_col(8);
+    delta_W1.set_initializer(TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+    delta_W1.get_row(engine, 1);
+    delta_W1.get_row(engine, 3);
+    auto& new_W0 = new_tsr_param.insert<tsr_t>("TSR_W0").resize(W0.shape());
+    ASSERT_TRUE(
+        client->UpdateParam(delta_param, new_srm_param, &new_tsr_param));
+    EXPECT_TSR_DELTA(W0, delta_W0, new_W0);
+
+    id_set_t id_set{1, 2, 3, 4};
+    srm_t read_W1;
+    read_W1.set_col(8);
+    ASSERT_TRUE(client->GetSRM("SRM_W1", id_set, &read_W1));
+    W1.upsert(new_W1);
+    EXPECT_SRM_DELTA(W1, delta_W1, read_W1);
+  }
+
   void TestSetGraph_GetGraph() {
     Graph graph;
     VariableNode X1("X1", Shape(2, 3));
@@ -321,6 +359,7 @@ TEST_F(WePSProxyClientTest, UpdateSRM_1_EmptySRM) {
 }
 TEST_F(WePSProxyClientTest, SetSRM_GetSRM_2) { TestSetSRM_GetSRM_2(); }
 TEST_F(WePSProxyClientTest, UpdateSRM_2) { TestUpdateSRM_2(); }
+TEST_F(WePSProxyClientTest, UpdateParam) { TestUpdateParam(); }
 TEST_F(WePSProxyClientTest, SetGraph_GetGraph) { TestSetGraph_GetGraph(); }
 #endif
 
@@ -352,6 +391,119 @@ TEST_F(WePSMockClientTest, UpdateSRM_1) { TestUpdateSRM_1(); }
 TEST_F(WePSMockClientTest, UpdateSRM_1_EmptySRM) { TestUpdateSRM_1_EmptySRM(); }
 TEST_F(WePSMockClientTest, SetSRM_GetSRM_2) { TestSetSRM_GetSRM_2(); }
 TEST_F(WePSMockClientTest, UpdateSRM_2) { TestUpdateSRM_2(); }
+TEST_F(WePSMockClientTest, UpdateParam) { TestUpdateParam(); }
 TEST_F(WePSMockClientTest, SetGraph_GetGraph) { TestSetGraph_GetGraph(); }
 
+class WePSCachedClientTest : public WePSClientTest {
+ protected:
+  WePSCachedClient* cached_client = nullptr;
+
+ protected:
+  void SetUp() override {
+    client = NewWePSClient("cached");
+    ASSERT_TRUE(client);
+    cached_client = (WePSCachedClient*)client.get();
+    StringMap config;
+    config["client"] = "mock";
+    config["cache_capacity"] = "16";
+    config["cache_max_staleness_batch"] = "2";
+    ASSERT_TRUE(client->InitConfig(config));
+  }
+
+  void SetRemoteSRM(srm_t* W0) {
+    W0->clear();
+    W0->set_col(8);
+    W0->set_initializer(TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+    W0->get_row(engine, 1);
+    W0->get_row(engine, 2);
+    // bypass the cache
+    ASSERT_TRUE(cached_client->mutable_client()->SetSRM("SRM_W0", *W0));
+  }
+};
+
+TEST_F(WePSCachedClientTest, SetTSR_GetTSR_1) { TestSetTSR_GetTSR_1(); }
+TEST_F(WePSCachedClientTest, SetTSR_GetTSR_1_EmptyTSR) {
+  TestSetTSR_GetTSR_1_EmptyTSR();
+}
+TEST_F(WePSCachedClientTest, UpdateTSR_1) { TestUpdateTSR_1(); }
+TEST_F(WePSCachedClientTest, UpdateTSR_1_EmptyTSR) {
+  TestUpdateTSR_1_EmptyTSR();
+}
+TEST_F(WePSCachedClientTest, SetTSR_GetTSR_2) { TestSetTSR_GetTSR_2(); }
+TEST_F(WePSCachedClientTest, SetTSR_2_NoTSR) { TestSetTSR_2_NoTSR(); }
+TEST_F(WePSCachedClientTest, GetTSR_2_NoTSR) { TestGetTSR_2_NoTSR(); }
+TEST_F(WePSCachedClientTest, UpdateTSR_2) { TestUpdateTSR_2(); }
+TEST_F(WePSCachedClientTest, UpdateTSR_2_NoTSR) { TestUpdateTSR_2_NoTSR(); }
+TEST_F(WePSCachedClientTest, SetSRM_GetSRM_1) { TestSetSRM_GetSRM_1(); }
+TEST_F(WePSCachedClientTest, SetSRM_1_EmptySRM) { TestSetSRM_1_EmptySRM(); }
+TEST_F(WePSCachedClientTest, GetSRM_1_EmptyIdSet) {
+  TestGetSRM_1_EmptyIdSet();
+}
+TEST_F(WePSCachedClientTest, UpdateSRM_1) { TestUpdateSRM_1(); }
+TEST_F(WePSCachedClientTest, UpdateSRM_1_EmptySRM) {
+  TestUpdateSRM_1_EmptySRM();
+}
+TEST_F(WePSCachedClientTest, SetSRM_GetSRM_2) { TestSetSRM_GetSRM_2(); }
+TEST_F(WePSCachedClientTest, UpdateSRM_2) { TestUpdateSRM_2(); }
+TEST_F(WePSCachedClientTest, UpdateParam) { TestUpdateParam(); }
+TEST_F(WePSCachedClientTest, SetGraph_GetGraph) { TestSetGraph_GetGraph(); }
+
+TEST_F(WePSCachedClientTest, GetSRM_Staleness) {
+  srm_t W0, new_W0;
+  new_W0.set_col(8);
+  id_set_t id_set{1, 2, 3, 4};
+
+  SetRemoteSRM(&W0);
+  ASSERT_TRUE(client->GetSRM("SRM_W0", id_set, &new_W0));  // batch 1
+  EXPECT_SRM_NEAR(new_W0, W0);
+
+  srm_t old_W0 = W0;
+  SetRemoteSRM(&W0);
+  // cached rows of batch 1 are served
+  ASSERT_TRUE(client->GetSRM("SRM_W0", id_set, &new_W0));  // batch 2
+  EXPECT_SRM_NEAR(new_W0, old_W0);
+
+  // cached rows of batch 1 are stale
+  ASSERT_TRUE(client->GetSRM("SRM_W0", id_set, &new_W0));  // batch 3
+  EXPECT_SRM_NEAR(new_W0, W0);
+}
+
+TEST_F(WePSCachedClientTest, UpdateSRM_WriteThrough) {
+  srm_t W0, new_W0;
+  new_W0.set_col(8);
+  id_set_t id_set{1, 2, 3, 4};
+
+  SetRemoteSRM(&W0);
+  ASSERT_TRUE(client->GetSRM("SRM_W0", id_set, &new_W0));
+
+  srm_t delta_W0;
+  delta_W0.set_col(8);
+  delta_W0.set_initializer(TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  delta_W0.get_row(engine, 1);
+  ASSERT_TRUE(client->UpdateSRM("SRM_W0", delta_W0));
+
+  // served from the cache
+  ASSERT_TRUE(client->GetSRM("SRM_W0", id_set, &new_W0));
+  EXPECT_SRM_DELTA(W0, delta_W0, new_W0);
+
+  // served from the underlying client
+  ASSERT_TRUE(
+      cached_client->mutable_client()->GetSRM("SRM_W0", id_set, &new_W0));
+  EXPECT_SRM_DELTA(W0, delta_W0, new_W0);
+}
+
+TEST_F(WePSCachedClientTest, SetSRM_WriteThrough) {
+  srm_t W0, new_W0;
+  new_W0.set_col(8);
+  id_set_t id_set{1, 2, 3, 4};
+
+  SetRemoteSRM(&W0);
+  ASSERT_TRUE(client->GetSRM("SRM_W0", id_set, &new_W0));
+
+  W0.get_row(engine, 3);
+  ASSERT_TRUE(client->SetSRM("SRM_W0", W0));
+  ASSERT_TRUE(client->GetSRM("SRM_W0", id_set, &new_W0));
+  EXPECT_SRM_NEAR(new_W0, W0);
+}
+
 }  // namespace deepx_core
@@ -32,7 +32,8 @@ int connect_abstract_unix(int fd, const char* path) noexcept {
   memset(&addr, 0, sizeof(addr));
   addr.sun_family = AF_UNIX;
   addr.sun_path[0] = '\0';
-  snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "%s", path);
+  snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "%.*s",
+           (int)sizeof(addr.sun_path) - 2, path);
   if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
     DXERROR("Failed to connect, fd=%d, path=%s, errno=%d(%s).", fd, path, errno,
             strerror(errno));
@@ -99,6 +100,20 @@ int readn(int fd, std::string* buf) noexcept {
   return readn(fd, &(*buf)[0], buf->size());
 }
 
+// A request which has been sent, but whose response has not been read.
+struct PostedRequest {
+  int fd = -1;
+
+  PostedRequest() = default;
+  PostedRequest(const PostedRequest&) = delete;
+  PostedRequest& operator=(const PostedRequest&) = delete;
+  ~PostedRequest() {
+    if (fd != -1) {
+      (void)_close(fd);
+    }
+  }
+};
+
 }  // namespace
 
 /************************************************************************/
@@ -168,6 +183,12 @@ class WePSProxyClient : public WePSClient {
   bool WriteMessage();
   bool ReadError();
   bool ReadMessage();
+  // Send 'cmd' and 'out_buf_' on a new connection,
+  // the response is read later by 'Wait'.
+  bool Post(uint16_t cmd, PostedRequest* request);
+  // Read the response of 'request' to 'in_buf_'.
+  // It is a no-op if 'request' has not been posted.
+  bool Wait(PostedRequest* request, int has_message);
 
  public:
   ~WePSProxyClient() override { Close(); }
@@ -195,6 +216,10 @@ class WePSProxyClient : public WePSClient {
               TensorMap* param) override;
   bool UpdateSRM(const TensorMap& delta_param) override;
 
+  bool UpdateParam(const TensorMap& delta_param, const TensorMap& new_srm_param,
+                   TensorMap* new_tsr_param) override;
+  bool SetParam(const TensorMap& param) override;
+
   bool SetGraph(const Graph& graph) override;
   bool GetGraph(Graph* graph, int* exist) override;
 };
@@ -736,6 +761,26 @@ bool WePSProxyClient::ReadMessage() {
   return true;
 }
 
+bool WePSProxyClient::Post(uint16_t cmd, PostedRequest* request) {
+  if (!Connect() || !WriteCmd(cmd) || !WriteMessage()) {
+    return false;
+  }
+  DXASSERT(request->fd == -1);
+  request->fd = fd_;
+  fd_ = -1;
+  return true;
+}
+
+bool WePSProxyClient::Wait(PostedRequest* request, int has_message) {
+  if (request->fd == -1) {
+    return true;
+  }
+  Close();
+  fd_ = request->fd;
+  request->fd = -1;
+  return ReadError() && (!has_message || ReadMessage());
+}
+
 bool WePSProxyClient::InitConfig(const AnyMap& config) {
   if (config.count("model_id") == 0) {
     DXERROR("Please specify model_id.");
@@ -837,6 +882,45 @@ bool WePSProxyClient::UpdateSRM(const TensorMap& delta_param) {
          (Connect() && WriteCmd(8) && WriteMessage() && ReadError());
 }
 
+bool WePSProxyClient::UpdateParam(const TensorMap& delta_param,
+                                  const TensorMap& new_srm_param,
+                                  TensorMap* new_tsr_param) {
+  // Each request is posted on its own connection, so 'UpdateTSR' and 'SetSRM'
+  // are in flight together.
+  // 'UpdateSRM' is posted once 'SetSRM' is done,
+  // because it may update rows set by 'SetSRM'.
+  PostedRequest update_tsr, set_srm, update_srm;
+  if (EncodeTSR(delta_param, 0) && !Post(0, &update_tsr)) {
+    return false;
+  }
+  if (EncodeSRM(new_srm_param, ENCODE_SRM_FLAG_SET) && !Post(1, &set_srm)) {
+    return false;
+  }
+  if (!Wait(&set_srm, 0)) {
+    return false;
+  }
+  if (EncodeSRM(delta_param, ENCODE_SRM_FLAG_UPDATE_DELTA) &&
+      !Post(8, &update_srm)) {
+    return false;
+  }
+  if (update_tsr.fd != -1 &&
+      (!Wait(&update_tsr, 1) || !DecodeTSR(new_tsr_param))) {
+    return false;
+  }
+  return Wait(&update_srm, 0);
+}
+
+bool WePSProxyClient::SetParam(const TensorMap& param) {
+  PostedRequest set_tsr, set_srm;
+  if (EncodeTSR(param, 1) && !Post(6, &set_tsr)) {
+    return false;
+  }
+  if (EncodeSRM(param, ENCODE_SRM_FLAG_SET) && !Post(1, &set_srm)) {
+    return false;
+  }
+  return Wait(&set_tsr, 0) && Wait(&set_srm, 0);
+}
+
 bool WePSProxyClient::SetGraph(const Graph& graph) {
   return EncodeGraph(graph) && Connect() && WriteCmd(12) && WriteMessage() &&
          ReadError();
@@ -185,28 +185,16 @@ bool WePSModel::Push(TensorMap* grad, TensorMap* overwritten_param) {
     delta_param_->ClearSRMValue();
     optimizer_->Update(grad, delta_param_.get());
 
-    if (!client_->UpdateTSR(*delta_param_, mutable_param())) {
-      DXINFO("Failed to UpdateTSR.");
-      return false;
-    }
-    // 'new_param_' must be pushed before calling 'UpdateSRM'.
-    if (!client_->SetSRM(*new_param_)) {
-      DXINFO("Failed to SetSRM.");
-      return false;
-    }
-    if (!client_->UpdateSRM(*delta_param_)) {
-      DXINFO("Failed to UpdateSRM.");
+    // 'new_param_' is set before updating SRMs.
+    if (!client_->UpdateParam(*delta_param_, *new_param_, mutable_param())) {
+      DXINFO("Failed to UpdateParam.");
       return false;
     }
   }
 
   if (overwritten_param && !overwritten_param->empty()) {
-    if (!client_->SetTSR(*overwritten_param)) {
-      DXINFO("Failed to SetTSR.");
-      return false;
-    }
-    if (!client_->SetSRM(*overwritten_param)) {
-      DXINFO("Failed to SetSRM.");
+    if (!client_->SetParam(*overwritten_param)) {
+      DXINFO("Failed to SetParam.");
       return false;
     }
   }
@@ -0,0 +1,747 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/cold_store.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>  // std::min, std::sort
+#include <cerrno>
+#include <cstdio>   // rename
+#include <cstdlib>  // strtod
+#include <cstring>  // memcpy
+#include <utility>
+
+namespace deepx_core {
+
+namespace {
+
+// Approximate bytes of a row in memory besides its values,
+// including its hash map bucket, its 'Vector' and malloc overhead.
+constexpr size_t ROW_OVERHEAD = 64;  // magic number
+// Rows are spilled down to this ratio of budgets, to amortize spills.
+constexpr double SPILL_RATIO = 0.9;  // magic number
+// Budgets are checked every this many accesses.
+constexpr uint64_t SPILL_CHECK_PERIOD = 64;  // magic number
+// Files with fewer dead records are not compacted.
+constexpr size_t MIN_COMPACT_DEAD_RECORD = 4096;  // magic number
+// Files are compacted in blocks of this many bytes.
+constexpr size_t COMPACT_BLOCK_BYTES = 4 << 20;  // magic number
+// The tick lock is released every this many ids visited by a selection.
+constexpr size_t SELECT_BLOCK = 1024;  // magic number
+
+void PWriteAll(int fd, const char* data, size_t size, uint64_t offset) {
+  while (size > 0) {
+    ssize_t n = pwrite(fd, data, size, (off_t)offset);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    DXCHECK_THROW(n > 0);
+    data += n;
+    size -= (size_t)n;
+    offset += (uint64_t)n;
+  }
+}
+
+void PReadAll(int fd, char* data, size_t size, uint64_t offset) {
+  while (size > 0) {
+    ssize_t n = pread(fd, data, size, (off_t)offset);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    DXCHECK_THROW(n > 0);
+    data += n;
+    size -= (size_t)n;
+    offset += (uint64_t)n;
+  }
+}
+
+// Erased entries of a flat hash map are marked deleted and
+// never become empty until the map is rehashed.
+template <class Map>
+void MaybeCompactMap(Map* map, size_t* erased) {
+  if (*erased > 0 && *erased >= map->bucket_size() / 4) {
+    Map compacted(map->begin(), map->end(), map->size());
+    map->swap(compacted);
+    *erased = 0;
+  }
+}
+
+}  // namespace
+
+/************************************************************************/
+/* ColdStore */
+/************************************************************************/
+size_t ColdStore::size() const noexcept {
+  size_t size = 0;
+  for (const auto& tier : tiers_) {
+    size += tier->offset_map.size();
+  }
+  return size;
+}
+
+size_t ColdStore::size(const std::string& name) const noexcept {
+  auto it = tier_map_.find(name);
+  return it == tier_map_.end() ? 0 : it->second->offset_map.size();
+}
+
+size_t ColdStore::max_row(const std::string& name) const noexcept {
+  auto it = tier_map_.find(name);
+  return it == tier_map_.end() ? 0 : it->second->max_row;
+}
+
+ColdStore::~ColdStore() { CloseFiles(); }
+
+std::unique_lock<std::mutex> ColdStore::LockTick() const {
+  return use_lock_ ? std::unique_lock<std::mutex>(*tick_lock_)
+                   : std::unique_lock<std::mutex>();
+}
+
+void ColdStore::CloseFiles() noexcept {
+  for (const auto& tier : tiers_) {
+    if (tier->fd != -1) {
+      close(tier->fd);
+      unlink(tier->file.c_str());
+      tier->fd = -1;
+    }
+  }
+}
+
+void ColdStore::Track(Tier* tier) {
+  // Rows of 'W0' not accessed yet, e.g. loaded or imported ones.
+  for (const auto& row : *tier->W[0]) {
+    if (tier->tick_map.emplace(row.first, 0).second) {
+      tier->clock.emplace_back(row.first, 0);
+    }
+  }
+}
+
+void ColdStore::Touch(const access_t& access, uint64_t tick) {
+  auto guard = LockTick();
+  for (const auto& entry : access) {
+    Tier* tier = entry.first;
+    for (int_t id : entry.second) {
+      auto result = tier->tick_map.emplace(id, tick);
+      if (result.second) {
+        tier->clock.emplace_back(id, tick);
+      } else {
+        result.first->second = tick;
+      }
+    }
+  }
+}
+
+bool ColdStore::NeedFaultIn(const access_t& access) const {
+  for (const auto& entry : access) {
+    const Tier* tier = entry.first;
+    if (tier->offset_map.empty()) {
+      continue;
+    }
+    for (int_t id : entry.second) {
+      if (tier->offset_map.count(id) > 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ColdStore::FaultIn(Tier* tier, const std::vector<int_t>& ids) {
+  if (tier->offset_map.empty()) {
+    return;
+  }
+
+  // (offset, id)
+  std::vector<std::pair<uint64_t, int_t>> records;
+  for (int_t id : ids) {
+    auto it = tier->offset_map.find(id);
+    if (it != tier->offset_map.end()) {
+      records.emplace_back(it->second, id);
+      tier->offset_map.erase(it);
+    }
+  }
+  if (records.empty()) {
+    return;
+  }
+
+  // Read records in the order of offsets.
+  std::sort(records.begin(), records.end());
+  std::vector<char> buf(tier->record_size);
+  for (const auto& record : records) {
+    int_t id = record.second;
+    PReadAll(tier->fd, buf.data(), buf.size(), record.first);
+    int_t record_id;
+    memcpy(&record_id, buf.data(), sizeof(record_id));
+    DXCHECK_THROW(record_id == id);
+    const char* p = buf.data() + sizeof(int_t);
+    for (srm_t* W : tier->W) {
+      W->assign(id, (const float_t*)p);
+      p += W->col() * sizeof(float_t);
+    }
+  }
+  tier->dead_record += records.size();
+  tier->offset_map_erased += records.size();
+  stat_.fault_in += records.size();
+  MaybeCompactMap(&tier->offset_map, &tier->offset_map_erased);
+  MaybeCompactFile(tier);
+}
+
+void ColdStore::FaultIn(const access_t& access) {
+  for (const auto& entry : access) {
+    FaultIn(entry.first, entry.second);
+  }
+}
+
+void ColdStore::Select(Tier* tier, victim_t* victims) {
+  size_t need = tier->need;
+  if (need == 0) {
+    return;
+  }
+
+  // Visit ids from the hand of the clock, at most one round.
+  auto guard = LockTick();
+  size_t round = tier->clock.size();
+  size_t block = SELECT_BLOCK;
+  while (round > 0 && victims->size() < need) {
+    std::pair<int_t, uint64_t> entry = tier->clock.front();
+    tier->clock.pop_front();
+    --round;
+    auto it = tier->tick_map.find(entry.first);
+    if (it != tier->tick_map.end()) {
+      if (it->second == entry.second) {
+        victims->emplace_back(entry);
+      } else {
+        // second chance
+        tier->clock.emplace_back(entry.first, it->second);
+      }
+    }
+    // Let readers touch ids.
+    if (guard && --block == 0) {
+      guard.unlock();
+      guard.lock();
+      block = SELECT_BLOCK;
+    }
+  }
+}
+
+void ColdStore::Select(victims_t* victims) {
+  std::unique_lock<std::mutex> guard;
+  if (use_lock_) {
+    // One selection at a time, others go on without victims.
+    guard = std::unique_lock<std::mutex>(*select_lock_, std::try_to_lock);
+    if (!guard) {
+      return;
+    }
+  }
+  for (size_t i = 0; i < tiers_.size(); ++i) {
+    Select(tiers_[i].get(), &(*victims)[i]);
+  }
+}
+
+void ColdStore::Spill(Tier* tier, const victim_t& victims, Retired* retired) {
+  const srm_t& W0 = *tier->W[0];
+  size_t low_row = (size_t)(tier->max_row * SPILL_RATIO);
+  size_t n = W0.size() > tier->max_row ? W0.size() - low_row : 0;
+
+  // Victims accessed since they were selected are not spilled,
+  // including ones accessed by the current access.
+  std::vector<int_t> ids;
+  {
+    auto guard = LockTick();
+    for (const auto& victim : victims) {
+      auto it = tier->tick_map.find(victim.first);
+      if (it == tier->tick_map.end()) {
+        continue;
+      }
+      if (ids.size() == n || it->second != victim.second) {
+        tier->clock.emplace_back(victim.first, it->second);
+        continue;
+      }
+      tier->tick_map.erase(it);
+      ++tier->tick_map_erased;
+      if (W0.get_row_no_init(victim.first)) {
+        ids.emplace_back(victim.first);
+      }
+    }
+    if (W0.size() > tier->tick_map.size() + ids.size()) {
+      Track(tier);
+    }
+  }
+  size_t row = W0.size() - ids.size();
+  tier->need = row > tier->max_row ? row - low_row : 0;
+  if (ids.empty()) {
+    return;
+  }
+
+  // Append records in blocks.
+  // Rows of optimizer slots which don't exist are spilled as zeros.
+  size_t block_record = COMPACT_BLOCK_BYTES / tier->record_size + 1;
+  std::vector<char> buf;
+  buf.reserve(block_record * tier->record_size);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    int_t id = ids[i];
+    size_t begin = buf.size();
+    buf.resize(begin + tier->record_size);
+    char* p = &buf[begin];
+    memcpy(p, &id, sizeof(id));
+    p += sizeof(id);
+    for (const srm_t* W : tier->W) {
+      size_t bytes = W->col() * sizeof(float_t);
+      const float_t* row = W->get_row_no_init(id);
+      if (row) {
+        memcpy(p, row, bytes);
+      } else {
+        memset(p, 0, bytes);
+      }
+      p += bytes;
+    }
+    tier->offset_map[id] = tier->file_size + begin;
+
+    if (buf.size() >= block_record * tier->record_size ||
+        i + 1 == ids.size()) {
+      PWriteAll(tier->fd, buf.data(), buf.size(), tier->file_size);
+      tier->file_size += buf.size();
+      buf.clear();
+    }
+  }
+
+  // Rows are moved out, they are freed after a grace period.
+  for (srm_t* W : tier->W) {
+    retired->rows.emplace_back();
+    srm_t& rows = retired->rows.back();
+    for (int_t id : ids) {
+      W->split(&rows, id);
+    }
+  }
+  tier->erased_row += ids.size();
+  stat_.spill += ids.size();
+  MaybeCompactRows(tier);
+  auto guard = LockTick();
+  MaybeCompactMap(&tier->tick_map, &tier->tick_map_erased);
+}
+
+void ColdStore::Spill(const victims_t& victims, std::deque<Retired>* freed) {
+  Retired retired;
+  for (size_t i = 0; i < tiers_.size(); ++i) {
+    Spill(tiers_[i].get(), victims[i], &retired);
+  }
+  if (!retired.rows.empty()) {
+    // No reader gets views of the rows after this point.
+    retired.ticket = rcu_.GracePeriod();
+    retired_.emplace_back(std::move(retired));
+  }
+  while (!retired_.empty() &&
+         rcu_.PollGracePeriod(retired_.front().ticket)) {
+    freed->emplace_back(std::move(retired_.front()));
+    retired_.pop_front();
+  }
+}
+
+void ColdStore::MaybeCompactFile(Tier* tier) {
+  if (tier->dead_record < MIN_COMPACT_DEAD_RECORD ||
+      tier->dead_record <= tier->offset_map.size()) {
+    return;
+  }
+
+  std::string file = tier->file + ".compacting";
+  int fd = open(file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  DXCHECK_THROW(fd != -1);
+
+  // Live records are copied in the order of offsets.
+  offset_map_t offset_map;
+  offset_map.reserve(tier->offset_map.size());
+  size_t block_bytes =
+      (COMPACT_BLOCK_BYTES / tier->record_size + 1) * tier->record_size;
+  std::vector<char> in(block_bytes), out;
+  out.reserve(block_bytes);
+  uint64_t file_size = 0;
+  for (uint64_t offset = 0; offset < tier->file_size; offset += block_bytes) {
+    size_t bytes = (size_t)std::min<uint64_t>(block_bytes,
+                                              tier->file_size - offset);
+    PReadAll(tier->fd, in.data(), bytes, offset);
+    out.clear();
+    for (size_t i = 0; i < bytes; i += tier->record_size) {
+      int_t id;
+      memcpy(&id, &in[i], sizeof(id));
+      auto it = tier->offset_map.find(id);
+      if (it != tier->offset_map.end() && it->second == offset + i) {
+        offset_map.emplace(id, file_size + out.size());
+        out.insert(out.end(), &in[i], &in[i] + tier->record_size);
+      }
+    }
+    PWriteAll(fd, out.data(), out.size(), file_size);
+    file_size += out.size();
+  }
+
+  DXCHECK_THROW(rename(file.c_str(), tier->file.c_str()) == 0);
+  close(tier->fd);
+  tier->fd = fd;
+  tier->file_size = file_size;
+  tier->offset_map.swap(offset_map);
+  tier->offset_map_erased = 0;
+  tier->dead_record = 0;
+  ++stat_.compaction;
+}
+
+void ColdStore::MaybeCompactRows(Tier* tier) {
+  // Rows erased from a flat hash map leave deleted buckets behind.
+  if (tier->erased_row == 0 || tier->erased_row < tier->W[0]->size() / 2) {
+    return;
+  }
+
+  for (srm_t* W : tier->W) {
+    srm_t compacted;
+    compacted.reserve(W->size());
+    W->split_if(&compacted,
+                [](const srm_t::value_type& /*row*/) { return true; });
+    *W = std::move(compacted);
+  }
+  tier->erased_row = 0;
+
+  // Ticks of ids not in memory are dropped.
+  auto guard = LockTick();
+  tick_map_t tick_map(tier->W[0]->size());
+  for (const auto& row : *tier->W[0]) {
+    auto it = tier->tick_map.find(row.first);
+    if (it != tier->tick_map.end()) {
+      tick_map.emplace(row.first, it->second);
+    }
+  }
+  tier->tick_map.swap(tick_map);
+  tier->tick_map_erased = 0;
+}
+
+uint64_t ColdStore::CountSpilled(const Tier* tier, const Shard* shard,
+                                 int shard_id) const {
+  if (shard == nullptr) {
+    return tier->offset_map.size();
+  }
+  uint64_t size = 0;
+  for (const auto& entry : tier->offset_map) {
+    if (shard->HasSRM(shard_id, entry.first)) {
+      ++size;
+    }
+  }
+  return size;
+}
+
+void ColdStore::WriteSpilled(OutputStream& os, const Tier* tier,  // NOLINT
+                             size_t i, const Shard* shard,
+                             int shard_id) const {
+  // offset of the row of 'W[i]' in a record
+  size_t row_offset = sizeof(int_t);
+  for (size_t j = 0; j < i; ++j) {
+    row_offset += tier->W[j]->col() * sizeof(float_t);
+  }
+  int col = tier->W[i]->col();
+
+  // Live records are read in blocks, like 'MaybeCompactFile'.
+  size_t block_bytes =
+      (COMPACT_BLOCK_BYTES / tier->record_size + 1) * tier->record_size;
+  std::vector<char> in(block_bytes);
+  for (uint64_t offset = 0; offset < tier->file_size && os;
+       offset += block_bytes) {
+    size_t bytes = (size_t)std::min<uint64_t>(block_bytes,
+                                              tier->file_size - offset);
+    PReadAll(tier->fd, in.data(), bytes, offset);
+    for (size_t j = 0; j < bytes; j += tier->record_size) {
+      int_t id;
+      memcpy(&id, &in[j], sizeof(id));
+      auto it = tier->offset_map.find(id);
+      if (it != tier->offset_map.end() && it->second == offset + j &&
+          (shard == nullptr || shard->HasSRM(shard_id, id))) {
+        // the format of 'Vector'
+        os << id << col;
+        os.Write(&in[j + row_offset], col * sizeof(float_t));
+      }
+    }
+  }
+}
+
+void ColdStore::Access(const access_t& access,
+                       const std::function<void()>& func) {
+  bool check = ++access_ % SPILL_CHECK_PERIOD == 0;
+  // Rows whose grace periods passed, they are freed out of the lock.
+  std::deque<Retired> freed;
+  if (!use_lock_) {
+    FaultIn(access);
+    Touch(access, ++tick_);
+    if (check) {
+      victims_t victims(tiers_.size());
+      Select(&victims);
+      Spill(victims, &freed);
+    }
+    func();
+    return;
+  }
+
+  // Rows are faulted in and spilled under the write lock,
+  // 'func' is called under the read lock.
+  // Rows faulted in may be spilled by others before the read lock is
+  // acquired, then they are faulted in again.
+  for (;;) {
+    if (!check) {
+      ReadLockGuard guard(lock_.get());
+      if (!NeedFaultIn(access)) {
+        Touch(access, ++tick_);
+        func();
+        return;
+      }
+    }
+
+    // Victims are selected without the write lock.
+    victims_t victims(tiers_.size());
+    if (check) {
+      Select(&victims);
+    }
+    {
+      WriteLockGuard guard(lock_.get());
+      FaultIn(access);
+      Touch(access, ++tick_);
+      Spill(victims, &freed);
+    }
+    freed.clear();
+    check = false;
+  }
+}
+
+void ColdStore::AddAccess(const std::string& name, const srm_t& W,
+                          access_t* access) const {
+  auto it = tier_map_.find(name);
+  if (it == tier_map_.end()) {
+    return;
+  }
+  std::vector<int_t> ids;
+  ids.reserve(W.size());
+  for (const auto& row : W) {
+    ids.emplace_back(row.first);
+  }
+  access->emplace_back(it->second, std::move(ids));
+}
+
+void ColdStore::Init(TensorMap* param, Optimizer* optimizer) noexcept {
+  param_ = param;
+  optimizer_ = optimizer;
+}
+
+bool ColdStore::InitConfig(const StringMap& config) {
+  CloseFiles();
+  tiers_.clear();
+  tier_map_.clear();
+
+  std::unordered_map<std::string, std::vector<srm_t*>> slot_map;
+  if (optimizer_) {
+    optimizer_->ForEachSRM([&slot_map](const std::string& name, srm_t* O) {
+      slot_map[name].emplace_back(O);
+    });
+  }
+
+  for (const auto& entry : config) {
+    const std::string& name = entry.first;
+    auto it = param_->find(name);
+    if (it == param_->end() || !it->second.is<srm_t>()) {
+      DXERROR("Invalid SRM param: %s.", name.c_str());
+      return false;
+    }
+    const char* budget = entry.second.c_str();
+    char* end = nullptr;
+    double budget_mb = strtod(budget, &end);
+    if (end == budget || *end != '\0' || !(budget_mb > 0)) {
+      DXERROR("Invalid budget of %s: %s.", name.c_str(), entry.second.c_str());
+      return false;
+    }
+
+    std::unique_ptr<Tier> tier(new Tier);
+    tier->name = name;
+    tier->W.emplace_back(&it->second.unsafe_to_ref<srm_t>());
+    for (srm_t* O : slot_map[name]) {
+      tier->W.emplace_back(O);
+    }
+    size_t row_bytes = 0;
+    tier->record_size = sizeof(int_t);
+    for (const srm_t* W : tier->W) {
+      row_bytes += W->col() * sizeof(float_t) + ROW_OVERHEAD;
+      tier->record_size += W->col() * sizeof(float_t);
+    }
+    tier->max_row = (size_t)(budget_mb * (1 << 20) / row_bytes);
+    tier->file = file_prefix_ + "." + std::to_string(tiers_.size());
+    tier->fd = open(tier->file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (tier->fd == -1) {
+      DXERROR("Failed to open: %s.", tier->file.c_str());
+      return false;
+    }
+    Track(tier.get());
+    DXINFO("ColdStore keeps at most %zu rows of %s in memory, spills to %s.",
+           tier->max_row, name.c_str(), tier->file.c_str());
+    tier_map_.emplace(name, tier.get());
+    tiers_.emplace_back(std::move(tier));
+  }
+  return true;
+}
+
+void ColdStore::InitLock() {
+  use_lock_ = 1;
+  lock_.reset(new ReadWriteLock);
+  tick_lock_.reset(new std::mutex);
+  select_lock_.reset(new std::mutex);
+}
+
+void ColdStore::Pull(const PullRequest& pull_request,
+                     const std::function<void()>& func) {
+  access_t access;
+  for (const auto& entry : pull_request.srm_map) {
+    auto it = tier_map_.find(entry.first);
+    if (it != tier_map_.end()) {
+      access.emplace_back(it->second, std::vector<int_t>(entry.second.begin(),
+                                                         entry.second.end()));
+    }
+  }
+  Access(access, func);
+}
+
+void ColdStore::Push(const TensorMap& grad, const TensorMap* overwritten_param,
+                     const std::function<void()>& func) {
+  access_t access;
+  for (const TensorMap* param : {&grad, overwritten_param}) {
+    if (param == nullptr) {
+      continue;
+    }
+    for (const auto& entry : *param) {
+      const Any& Wany = entry.second;
+      if (Wany.is<srm_t>()) {
+        AddAccess(entry.first, Wany.unsafe_to_ref<srm_t>(), &access);
+      }
+    }
+  }
+  Access(access, func);
+}
+
+void ColdStore::Spill() {
+  std::deque<Retired> freed;
+  // The first pass finds how many rows to spill.
+  victims_t victims(tiers_.size());
+  Spill(victims, &freed);
+  Select(&victims);
+  Spill(victims, &freed);
+}
+
+void ColdStore::Restore() {
+  for (const auto& tier : tiers_) {
+    std::vector<int_t> ids;
+    ids.reserve(tier->offset_map.size());
+    for (const auto& entry : tier->offset_map) {
+      ids.emplace_back(entry.first);
+    }
+    FaultIn(tier.get(), ids);
+    DXCHECK_THROW(ftruncate(tier->fd, 0) == 0);
+    tier->file_size = 0;
+    tier->dead_record = 0;
+    offset_map_t().swap(tier->offset_map);
+    tier->offset_map_erased = 0;
+  }
+}
+
+void ColdStore::Remove(const id_set_t& ids) {
+  for (const auto& tier : tiers_) {
+    for (int_t id : ids) {
+      auto it = tier->offset_map.find(id);
+      if (it != tier->offset_map.end()) {
+        tier->offset_map.erase(it);
+        ++tier->offset_map_erased;
+        ++tier->dead_record;
+      }
+      auto tick_it = tier->tick_map.find(id);
+      if (tick_it != tier->tick_map.end()) {
+        tier->tick_map.erase(tick_it);
+        ++tier->tick_map_erased;
+      }
+    }
+    MaybeCompactMap(&tier->offset_map, &tier->offset_map_erased);
+    MaybeCompactMap(&tier->tick_map, &tier->tick_map_erased);
+    MaybeCompactFile(tier.get());
+  }
+}
+
+void ColdStore::RemoveIf(const std::function<bool(int_t id)>& func) {
+  for (const auto& tier : tiers_) {
+    size_t prev_size = tier->offset_map.size();
+    auto first = tier->offset_map.begin();
+    auto last = tier->offset_map.end();
+    for (; first != last;) {
+      if (func(first->first)) {
+        first = tier->offset_map.erase(first);
+      } else {
+        ++first;
+      }
+    }
+    size_t removed = prev_size - tier->offset_map.size();
+    tier->offset_map_erased += removed;
+    tier->dead_record += removed;
+    MaybeCompactMap(&tier->offset_map, &tier->offset_map_erased);
+    MaybeCompactFile(tier.get());
+  }
+}
+
+/************************************************************************/
+/* ColdStore::SaveGuard */
+/************************************************************************/
+ColdStore::SaveGuard::SaveGuard(const ColdStore* cold_store, TensorMap* param,
+                                Optimizer* optimizer, const Shard* shard,
+                                int shard_id) {
+  if (cold_store == nullptr) {
+    return;
+  }
+
+  // name -> SRMs in the order of 'Tier::W', missing ones are nullptr
+  std::unordered_map<std::string, std::vector<srm_t*>> W_map;
+  for (const auto& tier : cold_store->tiers_) {
+    std::vector<srm_t*>& W = W_map[tier->name];
+    W.resize(1);
+    if (param) {
+      auto it = param->find(tier->name);
+      if (it != param->end() && it->second.is<srm_t>()) {
+        W[0] = &it->second.unsafe_to_ref<srm_t>();
+      }
+    }
+  }
+  if (optimizer) {
+    optimizer->ForEachSRM([&W_map](const std::string& name, srm_t* O) {
+      auto it = W_map.find(name);
+      if (it != W_map.end()) {
+        it->second.emplace_back(O);
+      }
+    });
+  }
+
+  for (const auto& _tier : cold_store->tiers_) {
+    const Tier* tier = _tier.get();
+    const std::vector<srm_t*>& W = W_map[tier->name];
+    uint64_t size = cold_store->CountSpilled(tier, shard, shard_id);
+    if (size == 0) {
+      continue;
+    }
+    for (size_t i = 0; i < W.size() && i < tier->W.size(); ++i) {
+      if (W[i] == nullptr) {
+        continue;
+      }
+      std::unique_ptr<SRMExtraRows> extra_rows(new SRMExtraRows);
+      extra_rows->size = size;
+      extra_rows->func = [cold_store, tier, i, shard,
+                          shard_id](OutputStream& os) {  // NOLINT
+        cold_store->WriteSpilled(os, tier, i, shard, shard_id);
+      };
+      W[i]->set_extra_rows(extra_rows.get());
+      W_.emplace_back(W[i]);
+      extra_rows_.emplace_back(std::move(extra_rows));
+    }
+  }
+}
+
+ColdStore::SaveGuard::~SaveGuard() {
+  for (srm_t* W : W_) {
+    W->set_extra_rows(nullptr);
+  }
+}
+
+}  // namespace deepx_core
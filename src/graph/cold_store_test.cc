@@ -0,0 +1,293 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/graph/cold_store.h>
+#include <deepx_core/common/stream.h>
+#include <deepx_core/graph/dist_proto.h>
+#include <deepx_core/graph/shard.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace deepx_core {
+
+class ColdStoreTest : public testing::Test, public DataType {
+ protected:
+  static constexpr int ROW = 1000;
+  TensorMap param;
+  srm_t* W = nullptr;
+  ColdStore cold_store;
+
+ protected:
+  void SetUp() override {
+    W = &param.insert<srm_t>("W");
+    W->set_col(2);
+    for (int i = 0; i < ROW; ++i) {
+      float_t row[2] = {(float_t)i, (float_t)-i};
+      W->assign((int_t)i, row);
+    }
+    param.insert<srm_t>("V").set_col(2);
+
+    cold_store.set_file_prefix("cold_store_test");
+    cold_store.Init(&param, nullptr);
+    // about 100 rows
+    StringMap config;
+    config["W"] = "0.007";
+    ASSERT_TRUE(cold_store.InitConfig(config));
+    ASSERT_GT(cold_store.max_row("W"), 50u);
+    ASSERT_LT(cold_store.max_row("W"), 200u);
+    EXPECT_EQ(cold_store.max_row("V"), 0u);
+  }
+
+  void CheckRow(int_t id) const {
+    const float_t* row = ((const srm_t*)W)->get_row_no_init(id);
+    ASSERT_TRUE(row != nullptr);
+    EXPECT_EQ(row[0], (float_t)id);
+    EXPECT_EQ(row[1], -(float_t)id);
+  }
+
+  void Pull(const id_set_t& id_set) {
+    PullRequest pull_request;
+    pull_request.srm_map["W"] = id_set;
+    cold_store.Pull(pull_request, [this, &id_set]() {
+      for (int_t id : id_set) {
+        CheckRow(id);
+      }
+    });
+  }
+};
+
+constexpr int ColdStoreTest::ROW;
+
+TEST_F(ColdStoreTest, InitConfig) {
+  StringMap config;
+  config["X"] = "1";
+  EXPECT_FALSE(cold_store.InitConfig(config));
+  config.clear();
+  for (const char* budget : {"0", "-1", "", "abc", "1MB", "nan"}) {
+    config["W"] = budget;
+    EXPECT_FALSE(cold_store.InitConfig(config));
+  }
+}
+
+TEST_F(ColdStoreTest, Spill_Pull) {
+  cold_store.Spill();
+  EXPECT_LE(W->size(), cold_store.max_row("W"));
+  EXPECT_EQ(W->size() + cold_store.size(), (size_t)ROW);
+  EXPECT_EQ(cold_store.size("W"), cold_store.size());
+  EXPECT_EQ(cold_store.stat().spill, cold_store.size());
+
+  id_set_t id_set;
+  for (int i = 0; i < ROW; i += 7) {
+    id_set.emplace((int_t)i);
+  }
+  Pull(id_set);
+  EXPECT_GT(cold_store.stat().fault_in, 0u);
+  EXPECT_EQ(W->size() + cold_store.size(), (size_t)ROW);
+}
+
+TEST_F(ColdStoreTest, Spill_LRU) {
+  id_set_t hot_id_set;
+  for (int i = 0; i < 50; ++i) {
+    hot_id_set.emplace((int_t)i);
+  }
+  Pull(hot_id_set);
+  cold_store.Spill();
+  for (int_t id : hot_id_set) {
+    CheckRow(id);
+  }
+}
+
+TEST_F(ColdStoreTest, Spill_ViewGuard) {
+  // (id, view of its row)
+  std::vector<std::pair<int_t, const float_t*>> views;
+  {
+    ColdStore::ViewGuard guard(cold_store);
+    for (const auto& row : *W) {
+      views.emplace_back(row.first, row.second);
+    }
+    cold_store.Spill();
+    cold_store.Spill();
+    ASSERT_GT(cold_store.size(), 0u);
+    // Spilled rows are not freed.
+    for (const auto& view : views) {
+      EXPECT_EQ(view.second[0], (float_t)view.first);
+      EXPECT_EQ(view.second[1], -(float_t)view.first);
+    }
+  }
+}
+
+TEST_F(ColdStoreTest, Spill_Concurrent) {
+  cold_store.InitLock();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([this, t]() {
+      for (int k = 0; k < 200; ++k) {
+        id_set_t id_set;
+        for (int i = 0; i < 20; ++i) {
+          id_set.emplace((int_t)((t * 211 + k * 37 + i * 13) % ROW));
+        }
+        Pull(id_set);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_GT(cold_store.stat().spill, 0u);
+  EXPECT_EQ(W->size() + cold_store.size(), (size_t)ROW);
+  cold_store.Restore();
+  ASSERT_EQ(W->size(), (size_t)ROW);
+  for (int i = 0; i < ROW; ++i) {
+    CheckRow((int_t)i);
+  }
+}
+
+TEST_F(ColdStoreTest, Push) {
+  cold_store.Spill();
+  TensorMap grad;
+  auto& G = grad.insert<srm_t>("W");
+  G.set_col(2);
+  float_t row[2] = {0, 0};
+  for (int i = 0; i < ROW; i += 3) {
+    G.assign((int_t)i, row);
+  }
+  cold_store.Push(grad, nullptr, [this]() {
+    for (int i = 0; i < ROW; i += 3) {
+      CheckRow((int_t)i);
+    }
+  });
+}
+
+TEST_F(ColdStoreTest, Restore) {
+  cold_store.Spill();
+  cold_store.Restore();
+  EXPECT_EQ(cold_store.size(), 0u);
+  ASSERT_EQ(W->size(), (size_t)ROW);
+  for (int i = 0; i < ROW; ++i) {
+    CheckRow((int_t)i);
+  }
+}
+
+TEST_F(ColdStoreTest, Remove) {
+  cold_store.Spill();
+  id_set_t removed;
+  for (int i = 0; i < ROW; i += 2) {
+    removed.emplace((int_t)i);
+  }
+  W->remove_if([&removed](const srm_t::value_type& entry) {
+    return removed.count(entry.first) > 0;
+  });
+  cold_store.Remove(removed);
+  cold_store.Restore();
+  ASSERT_EQ(W->size(), (size_t)ROW / 2);
+  for (int i = 1; i < ROW; i += 2) {
+    CheckRow((int_t)i);
+  }
+}
+
+TEST_F(ColdStoreTest, RemoveIf) {
+  cold_store.Spill();
+  auto func = [](int_t id) { return id % 2 == 0; };
+  W->remove_if(
+      [&func](const srm_t::value_type& entry) { return func(entry.first); });
+  cold_store.RemoveIf(func);
+  cold_store.Restore();
+  ASSERT_EQ(W->size(), (size_t)ROW / 2);
+  for (int i = 1; i < ROW; i += 2) {
+    CheckRow((int_t)i);
+  }
+}
+
+TEST_F(ColdStoreTest, SaveGuard) {
+  cold_store.Spill();
+  ASSERT_GT(cold_store.size(), 0u);
+  size_t row = W->size();
+
+  OutputStringStream os;
+  InputStringStream is;
+  TensorMap read_param;
+  {
+    ColdStore::SaveGuard guard(&cold_store, &param, nullptr);
+    os << param;
+    ASSERT_TRUE(os);
+  }
+  // Spilled rows are not faulted in.
+  EXPECT_EQ(W->size(), row);
+  EXPECT_TRUE(W->extra_rows() == nullptr);
+
+  is.SetView(os.GetBuf());
+  is >> read_param;
+  ASSERT_TRUE(is);
+  cold_store.Restore();
+  EXPECT_TRUE(read_param.get<srm_t>("W") == *W);
+  EXPECT_TRUE(read_param.get<srm_t>("V") == param.get<srm_t>("V"));
+}
+
+TEST_F(ColdStoreTest, SaveGuard_Shard) {
+  cold_store.Spill();
+  Shard shard;
+  shard.InitShard(3, "default");
+  for (int shard_id = 0; shard_id < 3; ++shard_id) {
+    OutputStringStream os;
+    InputStringStream is;
+    srm_t read_W;
+    {
+      ColdStore::SaveGuard guard(&cold_store, &param, nullptr, &shard,
+                                 shard_id);
+      os << *W;
+      ASSERT_TRUE(os);
+    }
+    is.SetView(os.GetBuf());
+    is >> read_W;
+    ASSERT_TRUE(is);
+
+    // in-memory rows plus spilled rows of 'shard_id'
+    size_t expected_row = W->size();
+    for (const auto& entry : read_W) {
+      int_t id = entry.first;
+      EXPECT_EQ(entry.second[0], (float_t)id);
+      EXPECT_EQ(entry.second[1], -(float_t)id);
+      if (((const srm_t*)W)->get_row_no_init(id) == nullptr) {
+        EXPECT_TRUE(shard.HasSRM(shard_id, id));
+      }
+    }
+    for (int i = 0; i < ROW; ++i) {
+      if (((const srm_t*)W)->get_row_no_init((int_t)i) == nullptr &&
+          shard.HasSRM(shard_id, (int_t)i)) {
+        ++expected_row;
+      }
+    }
+    EXPECT_EQ(read_W.size(), expected_row);
+  }
+}
+
+TEST_F(ColdStoreTest, Compaction) {
+  cold_store.InitLock();
+  // Hot ids move through all rows, rows are spilled and faulted in
+  // again and again.
+  for (int k = 0; k < 100; ++k) {
+    for (int i = 0; i < ROW; i += 50) {
+      id_set_t id_set;
+      for (int j = i; j < i + 50; ++j) {
+        id_set.emplace((int_t)j);
+      }
+      Pull(id_set);
+    }
+    cold_store.Spill();
+  }
+  EXPECT_GT(cold_store.stat().compaction, 0u);
+  EXPECT_EQ(W->size() + cold_store.size(), (size_t)ROW);
+  cold_store.Restore();
+  ASSERT_EQ(W->size(), (size_t)ROW);
+  for (int i = 0; i < ROW; ++i) {
+    CheckRow((int_t)i);
+  }
+}
+
+}  // namespace deepx_core
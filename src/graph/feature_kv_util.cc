@@ -7,6 +7,7 @@
 #include <deepx_core/graph/feature_kv_util.h>
 #include <cstring>  // memcpy
 #include <limits>   // std::numeric_limits
+#include <utility>  // std::move
 #if HAVE_SAGE2 == 1
 #include <sage2/half.h>
 #endif
@@ -407,6 +408,139 @@ bool FeatureKVUtil::SaveModel(const std::string& file, const Graph& graph,
   return true;
 }
 
+static bool IsGraphCompatible(const Graph& graph, const Graph& other,
+                              const TensorMap& param) {
+  for (const auto& entry : param) {
+    const std::string& name = entry.first;
+    const GraphNode* node = graph.find_node(name);
+    const GraphNode* other_node = other.find_node(name);
+    if (node == nullptr || other_node == nullptr ||
+        node->node_id() != other_node->node_id() ||
+        node->tensor_type() != other_node->tensor_type()) {
+      DXERROR("Inconsistent param: %s.", name.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+template <class Parser>
+static void ParseBatch(std::vector<std::string>* keys,
+                       std::vector<std::string>* values,
+                       std::vector<int16_t>* codes, Parser* parser,
+                       FeatureKVUtil::ParamParserStat* total_stat) {
+  FeatureKVUtil::ParamParserStat stat;
+  codes->assign(keys->size(), 0);
+  parser->Parse(*keys, *values, *codes, &stat);
+  total_stat->key_exist += stat.key_exist;
+  total_stat->key_bad += stat.key_bad;
+  total_stat->value_bad += stat.value_bad;
+  keys->clear();
+  values->clear();
+}
+
+bool FeatureKVUtil::ReadModel(InputStream& is, const Graph& graph,
+                              TensorMap* param) {
+  static constexpr size_t BATCH = 4096;  // magic number
+  DXINFO("Reading model...");
+  FeatureKVHead head;
+  std::string key, value;
+  int version = 0;
+  DenseParamParser dense_parser;
+  SparseParamParser sparse_parser;
+  std::vector<std::string> dense_keys, dense_values;
+  std::vector<std::string> sparse_keys, sparse_values;
+  std::vector<int16_t> codes;
+  ParamParserStat dense_stat, sparse_stat;
+
+  for (;;) {
+    size_t head_size = is.Read(&head, sizeof(head));
+    if (head_size == 0) {
+      break;
+    }
+    if (head_size != sizeof(head) || head.magic != 0xb2) {
+      DXERROR("Invalid item head.");
+      return false;
+    }
+    key.resize(head.key_size);
+    value.resize(head.value_size);
+    if (is.Read(&key[0], key.size()) != key.size() ||
+        is.Read(&value[0], value.size()) != value.size()) {
+      DXERROR("Incomplete item.");
+      return false;
+    }
+
+    if (version == 0) {
+      // The 1st item is version.
+      if (key != GetVersionKey() || !GetVersion(value, &version)) {
+        DXERROR("Invalid version item.");
+        return false;
+      }
+      CheckVersion(version);
+      dense_parser.Init(&graph, param);
+      sparse_parser.Init(&graph, param, version);
+      continue;
+    }
+
+    if (key == GetGraphKey()) {
+      Graph other;
+      if (!GetGraph(value, &other) ||
+          !IsGraphCompatible(graph, other, *param)) {
+        DXERROR("Invalid graph item.");
+        return false;
+      }
+      continue;
+    }
+
+    auto it = param->find(key);
+    if (it != param->end() && it->second.is<tsr_t>()) {
+      dense_keys.emplace_back(std::move(key));
+      dense_values.emplace_back(std::move(value));
+    } else {
+      sparse_keys.emplace_back(std::move(key));
+      sparse_values.emplace_back(std::move(value));
+    }
+
+    if (sparse_keys.size() >= BATCH) {
+      ParseBatch(&sparse_keys, &sparse_values, &codes, &sparse_parser,
+                 &sparse_stat);
+    }
+  }
+
+  if (version == 0) {
+    DXERROR("Empty model.");
+    return false;
+  }
+  ParseBatch(&dense_keys, &dense_values, &codes, &dense_parser, &dense_stat);
+  ParseBatch(&sparse_keys, &sparse_values, &codes, &sparse_parser,
+             &sparse_stat);
+  if (dense_stat.key_bad > 0 || dense_stat.value_bad > 0 ||
+      sparse_stat.key_bad > 0 || sparse_stat.value_bad > 0) {
+    DXERROR("Got %d bad keys and %d bad values.",
+            dense_stat.key_bad + sparse_stat.key_bad,
+            dense_stat.value_bad + sparse_stat.value_bad);
+    return false;
+  }
+  DXINFO("Read %d dense params and %d ids.", dense_stat.key_exist,
+         sparse_stat.key_exist);
+  return true;
+}
+
+bool FeatureKVUtil::LoadModel(const std::string& file, const Graph& graph,
+                              TensorMap* param) {
+  AutoInputFileStream is;
+  if (!is.Open(file)) {
+    DXERROR("Failed to open: %s.", file.c_str());
+    return false;
+  }
+  DXINFO("Loading model from %s...", file.c_str());
+  if (!ReadModel(is, graph, param)) {
+    return false;
+  }
+  DXINFO("Done.");
+  return true;
+}
+
 /************************************************************************/
 /* FeatureKVUtil::DenseParamParser */
 /************************************************************************/
@@ -444,8 +578,15 @@ void FeatureKVUtil::DenseParamParser::Parse(const std::string& key,
   const float_t* data = (const float_t*)value.data();  // NOLINT
   int total_dim = (int)(value.size() / sizeof(float_t));
   if (total_dim == W.total_dim()) {
-    // copy, not view
-    W.set_data(data, total_dim);
+    if (W.is_view()) {
+      // Views may be shared, they are replaced instead of being overwritten.
+      tsr_t copy(W.shape());
+      copy.set_data(data, total_dim);
+      W = std::move(copy);
+    } else {
+      // copy, not view
+      W.set_data(data, total_dim);
+    }
   } else {
     ++stat->value_bad;
   }
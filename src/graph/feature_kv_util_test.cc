@@ -271,6 +271,65 @@ TEST_F(FeatureKVUtilTest, WriteDenseParam_DenseParamParser) {
   EXPECT_EQ(stat.feature_kv_client_error, 0);
 }
 
+TEST_F(FeatureKVUtilTest, WriteModel_ReadModel) {
+  OutputStringStream os;
+  id_set_t id_set = {0, 2, 4, 6, 8};
+  ASSERT_TRUE(WriteModel(os, graph, param, id_set, 2));
+
+  TensorMap parsed_param;
+  InitParamPlaceholder(&parsed_param);
+  // Sparse params are cleared.
+  parsed_param.get<srm_t>(W3node->name()).get_row_no_init(100);
+  InputStringStream is;
+  is.SetView(os.GetData(), os.GetSize());
+  ASSERT_TRUE(ReadModel(is, graph, &parsed_param));
+
+  EXPECT_EQ(param.get<tsr_t>(W1node->name()),
+            parsed_param.get<tsr_t>(W1node->name()));
+  EXPECT_EQ(param.get<tsr_t>(W2node->name()),
+            parsed_param.get<tsr_t>(W2node->name()));
+  const auto& W3 = param.get<srm_t>(W3node->name());
+  const auto& parsed_W3 = parsed_param.get<srm_t>(W3node->name());
+  // W3: 0, 2, 4
+  ASSERT_EQ(parsed_W3.size(), 3u);
+  for (int_t id : {0, 2, 4}) {
+    auto it = parsed_W3.find(id);
+    ASSERT_TRUE(it != parsed_W3.end());
+    for (int j = 0; j < W3.col(); ++j) {
+      EXPECT_EQ(it->second[j], W3.find(id)->second[j]);
+    }
+  }
+  // W4: 0, 2, 4, 6, 8
+  EXPECT_EQ(parsed_param.get<srm_t>(W4node->name()).size(), 5u);
+}
+
+TEST_F(FeatureKVUtilTest, ReadModel_Invalid) {
+  OutputStringStream os;
+  ASSERT_TRUE(WriteModel(os, graph, param, 2));
+  TensorMap parsed_param;
+  InitParamPlaceholder(&parsed_param);
+  InputStringStream is;
+
+  // truncated
+  is.SetView(os.GetData(), os.GetSize() - 1);
+  EXPECT_FALSE(ReadModel(is, graph, &parsed_param));
+
+  // no version
+  OutputStringStream os2;
+  ASSERT_TRUE(WriteDenseParam(os2, param));
+  is.SetView(os2.GetData(), os2.GetSize());
+  EXPECT_FALSE(ReadModel(is, graph, &parsed_param));
+
+  // inconsistent dense param
+  OutputStringStream os3;
+  TensorMap bad_param;
+  bad_param.insert<tsr_t>(W1node->name()).resize(3, 3);
+  ASSERT_TRUE(WriteVersion(os3, 2));
+  ASSERT_TRUE(WriteDenseParam(os3, bad_param));
+  is.SetView(os3.GetData(), os3.GetSize());
+  EXPECT_FALSE(ReadModel(is, graph, &parsed_param));
+}
+
 TEST_F(FeatureKVUtilTest, WriteSparseParam_1_SparseParamParser_version2) {
   TestWriteSparseParam_1_SparseParamParser(2);
 }
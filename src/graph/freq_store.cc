@@ -106,6 +106,23 @@ void FreqStore::Merge(FreqStore* other, const Shard* shard, int shard_id) {
   DXINFO("FreqStore has merged %zu entries.", id_freq_map_.size() - prev_size);
 }
 
+void FreqStore::Split(FreqStore* other, const Shard* shard, int shard_id) {
+  DXINFO("Splitting FreqStore...");
+  size_t prev_size = id_freq_map_.size();
+  auto first = id_freq_map_.begin();
+  auto last = id_freq_map_.end();
+  for (; first != last;) {
+    if (shard == nullptr || shard->HasSRM(shard_id, first->first)) {
+      other->id_freq_map_[first->first] = first->second;
+      first = id_freq_map_.erase(first);
+    } else {
+      ++first;
+    }
+  }
+  DXINFO("FreqStore has %zu entries split, %zu entries remained.",
+         prev_size - id_freq_map_.size(), id_freq_map_.size());
+}
+
 void FreqStore::RemoveIf(
     const std::function<bool(const id_freq_map_t::value_type&)>& func) {
   DXINFO("Removing from FreqStore...");
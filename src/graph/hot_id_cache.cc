@@ -0,0 +1,188 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/hot_id_cache.h>
+#include <algorithm>  // std::nth_element
+#include <utility>
+
+namespace deepx_core {
+
+/************************************************************************/
+/* HotIdCache */
+/************************************************************************/
+bool HotIdCache::Sample() noexcept {
+  if (next_sample_ > 0) {
+    --next_sample_;
+    return false;
+  }
+  next_sample_ = (*skip_)(engine_);
+  return true;
+}
+
+void HotIdCache::Refresh() {
+  using item_t = std::pair<uint64_t, int_t>;
+  std::vector<item_t> items;
+  items.reserve(freq_map_.size());
+  for (const auto& entry : freq_map_) {
+    items.emplace_back(entry.second, entry.first);
+  }
+  if (items.size() > size_) {
+    std::nth_element(items.begin(), items.begin() + size_, items.end(),
+                     [](const item_t& left, const item_t& right) {
+                       return left.first > right.first;
+                     });
+    items.resize(size_);
+  }
+
+  hot_id_set_.clear();
+  hot_id_set_.reserve(items.size());
+  for (const item_t& item : items) {
+    hot_id_set_.emplace(item.second);
+  }
+
+  // Drop rows of ids which are not hot any more.
+  for (auto& entry : cache_) {
+    CachedSRM& cached = entry.second;
+    srm_t dropped;
+    cached.W.split_if(&dropped, [this](const srm_t::value_type& row) {
+      return hot_id_set_.count(row.first) == 0;
+    });
+    for (auto it = cached.batch_map.begin(); it != cached.batch_map.end();) {
+      if (hot_id_set_.count(it->first) == 0) {
+        it = cached.batch_map.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Decay, so that ids which are not hot any more age out.
+  for (auto it = freq_map_.begin(); it != freq_map_.end();) {
+    it->second /= 2;
+    if (it->second == 0) {
+      it = freq_map_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void HotIdCache::Init(size_t size, int sample_period, int refresh_batch,
+                      int max_staleness_batch, uint32_t seed) {
+  DXCHECK_THROW(sample_period > 0);
+  DXCHECK_THROW(refresh_batch > 0);
+  DXCHECK_THROW(max_staleness_batch >= 0);
+  size_ = size;
+  sample_period_ = sample_period;
+  refresh_batch_ = refresh_batch;
+  max_staleness_batch_ = max_staleness_batch;
+  engine_.seed(seed);
+  skip_.reset(new std::geometric_distribution<int>(1.0 / sample_period));
+  next_sample_ = (*skip_)(engine_);
+  freq_map_.clear();
+  hot_id_set_.clear();
+  cache_.clear();
+  batch_ = 0;
+  stat_ = Stat();
+}
+
+void HotIdCache::Filter(PullRequest* pull_request, TensorMap* cached_param) {
+  cached_param->clear();
+  if (!enabled()) {
+    return;
+  }
+
+  if (++batch_ % refresh_batch_ == 0) {
+    Refresh();
+  }
+
+  // Names are kept in 'pull_request' even if all their ids are removed,
+  // every PS receives the request and the following push as before.
+  for (auto& entry : pull_request->srm_map) {
+    const std::string& name = entry.first;
+    id_set_t& id_set = entry.second;
+    for (int_t id : id_set) {
+      if (Sample()) {
+        ++freq_map_[id];
+      }
+    }
+
+    if (hot_id_set_.empty()) {
+      continue;
+    }
+
+    auto cache_it = cache_.find(name);
+    CachedSRM* cached = cache_it == cache_.end() ? nullptr : &cache_it->second;
+    srm_t* W = nullptr;
+    for (auto it = id_set.begin(); it != id_set.end();) {
+      int_t id = *it;
+      if (hot_id_set_.count(id) == 0) {
+        ++it;
+        continue;
+      }
+
+      const float_t* row = nullptr;
+      if (cached) {
+        auto batch_it = cached->batch_map.find(id);
+        if (batch_it == cached->batch_map.end()) {
+          ++stat_.miss;
+        } else if (batch_ - batch_it->second > (uint64_t)max_staleness_batch_) {
+          ++stat_.stale;
+        } else {
+          row = cached->W.get_row_no_init(id);
+        }
+      } else {
+        ++stat_.miss;
+      }
+
+      if (row == nullptr) {
+        ++it;
+        continue;
+      }
+
+      ++stat_.hit;
+      if (W == nullptr) {
+        W = &cached_param->insert<srm_t>(name);
+        W->set_col(cached->W.col());
+      }
+      // copy, not view
+      W->assign(id, row);
+      pull_request->id_freq_map.erase(id);
+      it = id_set.erase(it);
+    }
+  }
+}
+
+void HotIdCache::Put(const TensorMap& param) {
+  if (!enabled() || hot_id_set_.empty()) {
+    return;
+  }
+
+  for (const auto& entry : param) {
+    const Any& Wany = entry.second;
+    if (!Wany.is<srm_t>()) {
+      continue;
+    }
+
+    const auto& W = Wany.unsafe_to_ref<srm_t>();
+    CachedSRM* cached = nullptr;
+    for (const auto& row : W) {
+      int_t id = row.first;
+      if (hot_id_set_.count(id) == 0) {
+        continue;
+      }
+      if (cached == nullptr) {
+        cached = &cache_[entry.first];
+        if (cached->W.col() == 0) {
+          cached->W.set_col(W.col());
+        }
+      }
+      cached->W.assign(id, row.second);
+      cached->batch_map[id] = batch_;
+    }
+  }
+}
+
+}  // namespace deepx_core
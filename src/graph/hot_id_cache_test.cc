@@ -0,0 +1,133 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/graph/dist_proto.h>
+#include <deepx_core/graph/hot_id_cache.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gtest/gtest.h>
+#include <random>
+
+namespace deepx_core {
+
+class HotIdCacheTest : public testing::Test, public DataType {
+ protected:
+  static void MakePullRequest(const id_set_t& id_set,
+                              PullRequest* pull_request) {
+    pull_request->clear();
+    pull_request->srm_map["S"] = id_set;
+    for (int_t id : id_set) {
+      pull_request->id_freq_map[id] = 1;
+    }
+  }
+
+  static void MakeParam(const PullRequest& pull_request, float_t value,
+                        TensorMap* param) {
+    param->clear();
+    auto& W = param->insert<srm_t>("S");
+    W.set_col(2);
+    float_t row[2] = {value, value};
+    for (int_t id : pull_request.srm_map.at("S")) {
+      W.assign(id, row);
+    }
+  }
+};
+
+TEST_F(HotIdCacheTest, Filter) {
+  HotIdCache cache;
+  // Sample every id, refresh every 3 batches, serve rows for 2 batches.
+  cache.Init(2, 1, 3, 2);
+
+  PullRequest pull_request;
+  TensorMap param, cached_param;
+
+  // batch 1, 2
+  MakePullRequest({1, 2, 3}, &pull_request);
+  cache.Filter(&pull_request, &cached_param);
+  EXPECT_TRUE(cached_param.empty());
+  MakePullRequest({1, 2}, &pull_request);
+  cache.Filter(&pull_request, &cached_param);
+  EXPECT_TRUE(cached_param.empty());
+  EXPECT_TRUE(cache.hot_id_set().empty());
+
+  // batch 3, 1 and 2 become hot, their rows are put.
+  MakePullRequest({1, 2, 4}, &pull_request);
+  cache.Filter(&pull_request, &cached_param);
+  EXPECT_EQ(cache.hot_id_set(), id_set_t({1, 2}));
+  EXPECT_EQ(pull_request.srm_map.at("S"), id_set_t({1, 2, 4}));
+  EXPECT_TRUE(cached_param.empty());
+  MakeParam(pull_request, 3, &param);
+  cache.Put(param);
+
+  // batch 4, 5, rows of 1 and 2 are served from the cache.
+  for (int i = 0; i < 2; ++i) {
+    MakePullRequest({1, 2, 4}, &pull_request);
+    cache.Filter(&pull_request, &cached_param);
+    EXPECT_EQ(pull_request.srm_map.at("S"), id_set_t({4}));
+    EXPECT_EQ(pull_request.id_freq_map, id_freq_map_t({{4, 1}}));
+    const auto& W = cached_param.get<srm_t>("S");
+    EXPECT_EQ(W.col(), 2);
+    EXPECT_EQ(W.size(), 2u);
+    EXPECT_EQ(W.get_row_no_init(1)[0], 3);
+    EXPECT_EQ(W.get_row_no_init(2)[1], 3);
+    MakeParam(pull_request, 5, &param);
+    cache.Put(param);
+  }
+
+  // batch 6, rows of 1 and 2 are stale.
+  MakePullRequest({1, 2, 4}, &pull_request);
+  cache.Filter(&pull_request, &cached_param);
+  EXPECT_EQ(pull_request.srm_map.at("S"), id_set_t({1, 2, 4}));
+  EXPECT_TRUE(cached_param.empty());
+
+  EXPECT_EQ(cache.stat().hit, 4u);
+  EXPECT_EQ(cache.stat().miss, 2u);
+  EXPECT_EQ(cache.stat().stale, 2u);
+}
+
+TEST_F(HotIdCacheTest, Sample) {
+  const int HOT = 10;
+  const int COLD = 10000;
+  HotIdCache cache;
+  cache.Init(HOT, 8, 100, 1);
+
+  std::default_random_engine engine;
+  std::uniform_int_distribution<int> dist(HOT, HOT + COLD - 1);
+  PullRequest pull_request;
+  TensorMap cached_param;
+  for (int i = 0; i < 100; ++i) {
+    id_set_t id_set;
+    for (int j = 0; j < HOT; ++j) {
+      id_set.emplace((int_t)j);
+    }
+    for (int j = 0; j < 100; ++j) {
+      id_set.emplace((int_t)dist(engine));
+    }
+    MakePullRequest(id_set, &pull_request);
+    cache.Filter(&pull_request, &cached_param);
+  }
+
+  ASSERT_EQ(cache.hot_id_set().size(), (size_t)HOT);
+  for (int j = 0; j < HOT; ++j) {
+    EXPECT_EQ(cache.hot_id_set().count((int_t)j), 1u);
+  }
+}
+
+TEST_F(HotIdCacheTest, Disabled) {
+  HotIdCache cache;
+  cache.Init(0, 1, 1, 1);
+  PullRequest pull_request;
+  TensorMap param, cached_param;
+  for (int i = 0; i < 3; ++i) {
+    MakePullRequest({1, 2}, &pull_request);
+    cache.Filter(&pull_request, &cached_param);
+    EXPECT_EQ(pull_request.srm_map.at("S"), id_set_t({1, 2}));
+    EXPECT_TRUE(cached_param.empty());
+    MakeParam(pull_request, 1, &param);
+    cache.Put(param);
+  }
+  EXPECT_TRUE(cache.hot_id_set().empty());
+}
+
+}  // namespace deepx_core
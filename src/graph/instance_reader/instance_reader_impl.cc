@@ -48,11 +48,41 @@ bool InstanceReaderImpl::InitConfig(const StringMap& config) {
 }
 
 bool InstanceReaderImpl::Open(const std::string& file) {
-  if (!is_.Open(file)) {
+  return Open(file, 0, 0);
+}
+
+bool InstanceReaderImpl::Open(const std::string& file, uint64_t offset,
+                              uint64_t length) {
+  pos_ = offset;
+  end_ = length > 0 ? offset + length : 0;
+  line_.reserve(64 * 1024);  // magic number
+  if (offset == 0) {
+    return is_.Open(file);
+  }
+
+  // Start from the byte before 'offset' and skip to the next line,
+  // the line starting at 'offset' is kept, the line across 'offset'
+  // belongs to the previous range.
+  if (!is_.Open(file, (size_t)(offset - 1))) {
     return false;
   }
-  line_.reserve(64 * 1024);  // magic number
-  return is_.IsOpen();
+  if (!GetLine(is_, line_)) {
+    // end of file
+    return true;
+  }
+  pos_ = offset + line_.size();
+  return true;
+}
+
+bool InstanceReaderImpl::GetLineInRange() {
+  if (end_ > 0 && pos_ >= end_) {
+    return false;
+  }
+  if (!GetLine(is_, line_)) {
+    return false;
+  }
+  pos_ += line_.size() + 1;
+  return true;
 }
 
 bool InstanceReaderImpl::GetBatch(Instance* inst) {
@@ -77,7 +107,7 @@ bool InstanceReaderImpl::GetBatch(Instance* inst) {
   }
 
   for (;;) {
-    if (!GetLine(is_, line_)) {
+    if (!GetLineInRange()) {
       is_.Close();
       return false;
     }
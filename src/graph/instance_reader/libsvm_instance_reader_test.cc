@@ -3,6 +3,7 @@
 //
 
 #include <deepx_core/common/any_map.h>
+#include <deepx_core/common/stream.h>
 #include <deepx_core/graph/instance_reader.h>
 #include <gtest/gtest.h>
 #include <memory>
@@ -43,6 +44,27 @@ class LibsvmInstanceReaderTest : public testing::Test {
     EXPECT_EQ(m, expected_m);
     EXPECT_EQ(n, expected_n);
   }
+
+  // Read 'file' in byte ranges of 'length', return the total # of inst.
+  int GetRangeInst(const std::string& file, uint64_t length) {
+    std::unique_ptr<InstanceReader> reader(NewInstanceReader("libsvm"));
+    StringMap config;
+    config["batch"] = "7";
+    EXPECT_TRUE(reader->InitConfig(config));
+
+    size_t file_size = 0;
+    EXPECT_TRUE(AutoFileSystem::GetFileSize(file, &file_size));
+    int n = 0;  // # of inst
+    for (uint64_t offset = 0; offset < file_size; offset += length) {
+      Instance inst;
+      EXPECT_TRUE(reader->Open(file, offset, length));
+      while (reader->GetBatch(&inst)) {
+        n += inst.batch();
+      }
+      n += inst.batch();
+    }
+    return n;
+  }
 };
 
 TEST_F(LibsvmInstanceReaderTest, GetBatch) {
@@ -55,4 +77,11 @@ TEST_F(LibsvmInstanceReaderTest, GetBatch) {
   TestGetBatch("testdata/graph/instance_reader/libsvm.txt", 64, 1, 1, 0, 60);
 }
 
+TEST_F(LibsvmInstanceReaderTest, Open_range) {
+  const std::string file = "testdata/graph/instance_reader/libsvm.txt";
+  for (uint64_t length : {1, 2, 3, 7, 16, 100, 1000, 100000}) {
+    EXPECT_EQ(GetRangeInst(file, length), 60);
+  }
+}
+
 }  // namespace deepx_core
@@ -0,0 +1,390 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/common/stream.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/mapped_model.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>  // memset
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace deepx_core {
+
+namespace {
+
+using float_t = DataType::float_t;
+using int_t = DataType::int_t;
+using tsr_t = DataType::tsr_t;
+using srm_t = DataType::srm_t;
+using mapped_index_t = srm_t::mapped_index_t;
+
+constexpr uint64_t MAPPED_MODEL_MAGIC = 0x4c444d4450414d44;  // magic number
+constexpr int MAPPED_MODEL_VERSION = 1;
+constexpr uint64_t MAPPED_MODEL_ALIGN = 64;
+
+struct MappedModelHeader {
+  uint64_t magic;
+  int32_t version;
+  int32_t float_size;
+  int32_t int_size;
+  int32_t reserved;
+  uint64_t directory_offset;
+  uint64_t directory_size;
+  char padding[24];
+};
+
+static_assert(sizeof(MappedModelHeader) == MAPPED_MODEL_ALIGN,
+              "Invalid MappedModelHeader.");
+
+uint64_t Align(uint64_t n) noexcept {
+  return (n + MAPPED_MODEL_ALIGN - 1) & ~(MAPPED_MODEL_ALIGN - 1);
+}
+
+// On average, a bucket has at most 2 rows.
+uint64_t GetBucketSize(uint64_t size) noexcept {
+  uint64_t bucket_size = 1;
+  while (bucket_size * 2 < size) {  // magic number
+    bucket_size <<= 1;
+  }
+  return bucket_size;
+}
+
+struct MappedEntry {
+  std::string name;
+  int type = TENSOR_TYPE_NONE;
+  const tsr_t* tsr = nullptr;
+  const srm_t* srm = nullptr;
+  // TSR
+  uint64_t offset = 0;
+  // SRM
+  uint64_t size = 0;
+  uint64_t bucket_size = 0;
+  uint64_t bucket_offset = 0;
+  uint64_t row_offset = 0;
+  uint64_t value_offset = 0;
+};
+
+bool WritePadding(OutputStream& os, uint64_t* pos, uint64_t offset) {
+  static const char zeros[MAPPED_MODEL_ALIGN] = {0};
+  DXASSERT(*pos <= offset && offset - *pos < MAPPED_MODEL_ALIGN);
+  size_t n = (size_t)(offset - *pos);
+  if (n > 0 && os.Write(zeros, n) != n) {
+    return false;
+  }
+  *pos = offset;
+  return true;
+}
+
+bool WriteData(OutputStream& os, uint64_t* pos, const void* data,
+               size_t size) {
+  if (size > 0 && os.Write(data, size) != size) {
+    return false;
+  }
+  *pos += size;
+  return true;
+}
+
+// Rows are written bucket by bucket, ids in a bucket are sorted,
+// so that the output is deterministic.
+bool WriteSRM(OutputStream& os, uint64_t* pos, const MappedEntry& entry) {
+  const srm_t& W = *entry.srm;
+  std::vector<uint64_t> bucket(entry.bucket_size + 1, 0);
+  for (const auto& row : W) {
+    ++bucket[mapped_index_t::get_bucket(row.first, entry.bucket_size) + 1];
+  }
+  for (uint64_t i = 0; i < entry.bucket_size; ++i) {
+    bucket[i + 1] += bucket[i];
+  }
+
+  std::vector<std::pair<int_t, const float_t*>> rows(entry.size);
+  std::vector<uint64_t> next(bucket.begin(), bucket.end() - 1);
+  for (const auto& row : W) {
+    uint64_t b = mapped_index_t::get_bucket(row.first, entry.bucket_size);
+    rows[next[b]++] = std::make_pair(row.first, (const float_t*)row.second);
+  }
+  for (uint64_t i = 0; i < entry.bucket_size; ++i) {
+    std::sort(rows.begin() + bucket[i], rows.begin() + bucket[i + 1],
+              [](const std::pair<int_t, const float_t*>& left,
+                 const std::pair<int_t, const float_t*>& right) {
+                return left.first < right.first;
+              });
+  }
+
+  if (!WritePadding(os, pos, entry.bucket_offset) ||
+      !WriteData(os, pos, bucket.data(), bucket.size() * sizeof(uint64_t))) {
+    return false;
+  }
+
+  if (!WritePadding(os, pos, entry.row_offset)) {
+    return false;
+  }
+  for (const auto& row : rows) {
+    if (!WriteData(os, pos, &row.first, sizeof(int_t))) {
+      return false;
+    }
+  }
+
+  if (!WritePadding(os, pos, entry.value_offset)) {
+    return false;
+  }
+  size_t row_bytes = (size_t)W.col() * sizeof(float_t);
+  for (const auto& row : rows) {
+    if (!WriteData(os, pos, row.second, row_bytes)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+/************************************************************************/
+/* MappedModel */
+/************************************************************************/
+MappedModel::~MappedModel() { Close(); }
+
+bool MappedModel::Save(const std::string& file, const TensorMap& param) {
+  // Layout blocks.
+  std::vector<MappedEntry> entries;
+  uint64_t offset = sizeof(MappedModelHeader);
+  for (const auto& entry : param) {
+    MappedEntry mapped_entry;
+    mapped_entry.name = entry.first;
+    const Any& Wany = entry.second;
+    if (Wany.is<tsr_t>()) {
+      const auto& W = Wany.unsafe_to_ref<tsr_t>();
+      mapped_entry.type = TENSOR_TYPE_TSR;
+      mapped_entry.tsr = &W;
+      mapped_entry.offset = offset;
+      offset = Align(offset + (uint64_t)W.total_dim() * sizeof(float_t));
+    } else if (Wany.is<srm_t>()) {
+      const auto& W = Wany.unsafe_to_ref<srm_t>();
+      mapped_entry.type = TENSOR_TYPE_SRM;
+      mapped_entry.srm = &W;
+      mapped_entry.size = W.size();
+      mapped_entry.bucket_size = GetBucketSize(W.size());
+      mapped_entry.bucket_offset = offset;
+      offset = Align(offset +
+                     (mapped_entry.bucket_size + 1) * sizeof(uint64_t));
+      mapped_entry.row_offset = offset;
+      offset = Align(offset + mapped_entry.size * sizeof(int_t));
+      mapped_entry.value_offset = offset;
+      offset = Align(offset + mapped_entry.size * (uint64_t)W.col() *
+                                  sizeof(float_t));
+    } else {
+      DXERROR("Unsupported param type: %s.", entry.first.c_str());
+      return false;
+    }
+    entries.emplace_back(std::move(mapped_entry));
+  }
+
+  OutputStringStream directory;
+  int s = (int)entries.size();
+  directory << s;
+  for (const MappedEntry& entry : entries) {
+    directory << entry.name << entry.type;
+    if (entry.type == TENSOR_TYPE_TSR) {
+      directory << entry.tsr->shape() << entry.offset;
+    } else {
+      directory << entry.srm->col() << entry.size << entry.bucket_size
+                << entry.bucket_offset << entry.row_offset
+                << entry.value_offset;
+    }
+  }
+
+  MappedModelHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = MAPPED_MODEL_MAGIC;
+  header.version = MAPPED_MODEL_VERSION;
+  header.float_size = (int32_t)sizeof(float_t);
+  header.int_size = (int32_t)sizeof(int_t);
+  header.directory_offset = offset;
+  header.directory_size = directory.GetSize();
+
+  CFileStream os;
+  if (!os.Open(file, FILE_OPEN_MODE_OUT | FILE_OPEN_MODE_BINARY)) {
+    DXERROR("Failed to open: %s.", file.c_str());
+    return false;
+  }
+
+  DXINFO("Saving mapped model to %s...", file.c_str());
+  uint64_t pos = 0;
+  if (!WriteData(os, &pos, &header, sizeof(header))) {
+    DXERROR("Failed to write mapped model.");
+    return false;
+  }
+  for (const MappedEntry& entry : entries) {
+    bool ok;
+    if (entry.type == TENSOR_TYPE_TSR) {
+      ok = WritePadding(os, &pos, entry.offset) &&
+           WriteData(os, &pos, entry.tsr->data(),
+                     (size_t)entry.tsr->total_dim() * sizeof(float_t));
+    } else {
+      ok = WriteSRM(os, &pos, entry);
+    }
+    if (!ok) {
+      DXERROR("Failed to write mapped model.");
+      return false;
+    }
+  }
+  if (!WritePadding(os, &pos, header.directory_offset) ||
+      !WriteData(os, &pos, directory.GetData(), directory.GetSize()) ||
+      !os.Flush()) {
+    DXERROR("Failed to write mapped model.");
+    return false;
+  }
+  DXINFO("Done.");
+  return true;
+}
+
+bool MappedModel::Open(const std::string& file, TensorMap* param,
+                       bool populate) {
+  Close();
+  param->clear();
+
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd == -1) {
+    DXERROR("Failed to open: %s.", file.c_str());
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(MappedModelHeader)) {
+    DXERROR("Invalid mapped model: %s.", file.c_str());
+    close(fd);
+    return false;
+  }
+
+  size_t size = (size_t)st.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping is alive after 'fd' is closed.
+  close(fd);
+  if (data == MAP_FAILED) {
+    DXERROR("Failed to mmap: %s.", file.c_str());
+    return false;
+  }
+  file_ = file;
+  data_ = (const char*)data;
+  size_ = size;
+  if (populate) {
+    (void)madvise(data, size, MADV_WILLNEED);
+  }
+
+  DXINFO("Opening mapped model from %s...", file.c_str());
+  MappedModelHeader header;
+  memcpy(&header, data_, sizeof(header));
+  if (header.magic != MAPPED_MODEL_MAGIC) {
+    DXERROR("Invalid mapped model: %s.", file.c_str());
+    Close();
+    return false;
+  }
+  if (header.version > MAPPED_MODEL_VERSION) {
+    DXERROR("Couldn't handle a higher version: %d.", (int)header.version);
+    Close();
+    return false;
+  }
+  if (header.float_size != (int32_t)sizeof(float_t) ||
+      header.int_size != (int32_t)sizeof(int_t)) {
+    DXERROR("Inconsistent float_t or int_t size: %d, %d.",
+            (int)header.float_size, (int)header.int_size);
+    Close();
+    return false;
+  }
+  if (header.directory_offset > size_ ||
+      header.directory_size > size_ - header.directory_offset) {
+    DXERROR("Invalid mapped model: %s.", file.c_str());
+    Close();
+    return false;
+  }
+
+  uint64_t end = header.directory_offset;
+  auto check_block = [end](uint64_t offset, uint64_t bytes) {
+    return offset % MAPPED_MODEL_ALIGN == 0 && offset <= end &&
+           bytes <= end - offset;
+  };
+
+  InputStringStream is;
+  is.SetView(data_ + header.directory_offset,
+             (size_t)header.directory_size);
+  int s;
+  is >> s;
+  for (int i = 0; i < s && is; ++i) {
+    std::string name;
+    int type;
+    is >> name >> type;
+    if (!is) {
+      break;
+    }
+
+    if (type == TENSOR_TYPE_TSR) {
+      Shape shape;
+      uint64_t offset;
+      is >> shape >> offset;
+      if (!is || !check_block(offset, (uint64_t)shape.total_dim() *
+                                          sizeof(float_t))) {
+        is.set_bad();
+        break;
+      }
+      // The view is read-only, writes to it fault.
+      auto* W = (float_t*)(data_ + offset);  // NOLINT
+      param->insert<tsr_t>(name).view(shape, W);
+    } else if (type == TENSOR_TYPE_SRM) {
+      int col;
+      mapped_index_t index;
+      uint64_t bucket_offset, row_offset, value_offset;
+      is >> col >> index.size >> index.bucket_size >> bucket_offset >>
+          row_offset >> value_offset;
+      if (!is || col <= 0 || index.bucket_size == 0 ||
+          (index.bucket_size & (index.bucket_size - 1)) != 0 ||
+          !check_block(bucket_offset,
+                       (index.bucket_size + 1) * sizeof(uint64_t)) ||
+          !check_block(row_offset, index.size * sizeof(int_t)) ||
+          !check_block(value_offset,
+                       index.size * (uint64_t)col * sizeof(float_t))) {
+        is.set_bad();
+        break;
+      }
+      index.bucket = (const uint64_t*)(data_ + bucket_offset);
+      index.row = (const int_t*)(data_ + row_offset);
+      index.value = (const float_t*)(data_ + value_offset);
+      index.col = col;
+      if (index.bucket[index.bucket_size] != index.size) {
+        is.set_bad();
+        break;
+      }
+      auto& W = param->insert<srm_t>(name);
+      W.set_col(col);
+      W.set_mapped(index);
+    } else {
+      is.set_bad();
+      break;
+    }
+  }
+
+  if (!is) {
+    DXERROR("Invalid mapped model: %s.", file.c_str());
+    param->clear();
+    Close();
+    return false;
+  }
+  DXINFO("Done.");
+  return true;
+}
+
+void MappedModel::Close() noexcept {
+  if (data_) {
+    (void)munmap((void*)data_, size_);  // NOLINT
+    data_ = nullptr;
+    size_ = 0;
+    file_.clear();
+  }
+}
+
+}  // namespace deepx_core
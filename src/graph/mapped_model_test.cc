@@ -0,0 +1,139 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/common/stream.h>
+#include <deepx_core/dx_gtest.h>
+#include <deepx_core/graph/graph_module_creator.h>
+#include <deepx_core/graph/instance_reader.h>
+#include <deepx_core/graph/mapped_model.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/graph/op_context.h>
+#include <deepx_core/graph/variable_scope.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace deepx_core {
+
+class MappedModelTest : public testing::Test, public DataType {
+ protected:
+  const std::string file = "mapped_model_test.bin";
+  std::default_random_engine engine;
+  Graph graph;
+  Model model;
+  std::string target_name;
+
+ protected:
+  void SetUp() override {
+    std::vector<GroupConfigItem> items(2);
+    for (int i = 0; i < 2; ++i) {
+      items[i].group_id = i + 1;
+      items[i].embedding_row = 16;
+      items[i].embedding_col = 4;
+    }
+    auto* X = GetX();
+    auto* E = DeepGroupEmbeddingLookup("E", X, items, 0);
+    auto* H = StackedFullyConnect("fc", E, {8, 4}, "relu");
+    auto* Z = AddBias("bias", FullyConnect("out", H, 1));
+    std::vector<GraphNode*> targets = BinaryClassificationTarget(Z, 0);
+    ASSERT_TRUE(graph.Compile(targets, 1));
+    ReleaseVariable();
+    target_name = targets[1]->name();
+
+    model.Init(&graph);
+    ASSERT_TRUE(model.InitParam(engine));
+    // ids 0, 2, ..., 98 of each group have embeddings
+    model.ForEachSRM([this](const std::string&, srm_t* W) {
+      for (int_t group_id = 1; group_id <= 2; ++group_id) {
+        for (int_t i = 0; i < 100; i += 2) {
+          W->get_row(engine, ll_sparse_tensor_t::make_feature_id(group_id, i));
+        }
+      }
+    });
+  }
+
+  void TearDown() override { (void)remove(file.c_str()); }
+
+  void FillInstance(Instance* inst) {
+    auto& X = inst->get_or_insert<csr_t>(X_NAME);
+    X.clear();
+    for (int_t i = 0; i < 100; ++i) {
+      X.emplace(ll_sparse_tensor_t::make_feature_id(1, i), 1);
+      X.emplace(ll_sparse_tensor_t::make_feature_id(2, 99 - i), 0.5);
+      X.add_row();
+    }
+    inst->set_batch(X.row());
+  }
+
+  tsr_t Predict(TensorMap* param) {
+    OpContext op_context;
+    op_context.Init(&graph, param);
+    DXCHECK_THROW(op_context.InitOp(std::vector<std::string>{target_name}, -1));
+    FillInstance(op_context.mutable_inst());
+    op_context.InitPredict();
+    op_context.Predict();
+    return op_context.hidden().get<tsr_t>(target_name);
+  }
+};
+
+TEST_F(MappedModelTest, SaveOpen) {
+  ASSERT_TRUE(MappedModel::Save(file, model.param()));
+
+  MappedModel mapped_model;
+  TensorMap param;
+  ASSERT_TRUE(mapped_model.Open(file, &param));
+  EXPECT_EQ(mapped_model.file(), file);
+  EXPECT_GT(mapped_model.size(), 0u);
+  ASSERT_EQ(param.size(), model.param().size());
+
+  for (const auto& entry : model.param()) {
+    if (entry.second.is<tsr_t>()) {
+      const auto& W = param.get<tsr_t>(entry.first);
+      EXPECT_TRUE(W.is_view());
+      EXPECT_EQ(W, entry.second.unsafe_to_ref<tsr_t>());
+    } else {
+      const auto& W = entry.second.unsafe_to_ref<srm_t>();
+      const auto& mapped_W = param.get<srm_t>(entry.first);
+      EXPECT_EQ(mapped_W.size(), 0u);
+      EXPECT_EQ(mapped_W.col(), W.col());
+      ASSERT_EQ(mapped_W.mapped().size, W.size());
+      for (const auto& row : W) {
+        const float_t* mapped_row = mapped_W.get_row_no_init(row.first);
+        ASSERT_TRUE(mapped_row != nullptr);
+        for (int j = 0; j < W.col(); ++j) {
+          EXPECT_EQ(mapped_row[j], row.second[j]);
+        }
+      }
+      EXPECT_TRUE(mapped_W.get_row_no_init(
+                      ll_sparse_tensor_t::make_feature_id(1, 1)) == nullptr);
+    }
+  }
+
+  mapped_model.Close();
+  EXPECT_EQ(mapped_model.size(), 0u);
+}
+
+TEST_F(MappedModelTest, Predict) {
+  ASSERT_TRUE(MappedModel::Save(file, model.param()));
+  MappedModel mapped_model;
+  TensorMap param;
+  ASSERT_TRUE(mapped_model.Open(file, &param, true));
+
+  tsr_t expected_P = Predict(model.mutable_param());
+  tsr_t P = Predict(&param);
+  EXPECT_TSR_NEAR(P, expected_P);
+}
+
+TEST_F(MappedModelTest, Open_Invalid) {
+  MappedModel mapped_model;
+  TensorMap param;
+  EXPECT_FALSE(mapped_model.Open(file, &param));
+
+  ASSERT_TRUE(model.Save(file));
+  EXPECT_FALSE(mapped_model.Open(file, &param));
+  EXPECT_TRUE(param.empty());
+  EXPECT_EQ(mapped_model.size(), 0u);
+}
+
+}  // namespace deepx_core
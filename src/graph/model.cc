@@ -271,6 +271,36 @@ void Model::Merge(Model* other, const Shard* shard, int shard_id) {
   DXINFO("Done.");
 }
 
+void Model::Split(Model* other, const Shard* shard, int shard_id) {
+  DXINFO("Splitting model...");
+  auto first = param_.begin();
+  auto last = param_.end();
+  for (; first != last;) {
+    const std::string& name = first->first;
+    Any& Wany = first->second;
+    if (Wany.is<tsr_t>()) {
+      if (shard == nullptr || shard->HasTSR(shard_id, name)) {
+        DXINFO("Splitting TSR %s...", name.c_str());
+        other->param_.get_or_insert<tsr_t>(name) =
+            std::move(Wany.unsafe_to_ref<tsr_t>());
+        first = param_.erase(first);
+        continue;
+      }
+    } else if (Wany.is<srm_t>()) {
+      auto& W = Wany.unsafe_to_ref<srm_t>();
+      auto& other_W = other->param_.get_or_insert<srm_t>(name);
+      size_t prev_size = W.size();
+      W.split_if(&other_W, [shard, shard_id](const srm_t::value_type& entry) {
+        return shard == nullptr || shard->HasSRM(shard_id, entry.first);
+      });
+      DXINFO("SRM %s has %zu entries split, %zu entries remained.",
+             name.c_str(), prev_size - W.size(), W.size());
+    }
+    ++first;
+  }
+  DXINFO("Done.");
+}
+
 bool Model::HasSRM() const noexcept {
   for (const auto& entry : param_) {
     const Any& Wany = entry.second;
@@ -309,15 +339,80 @@ void Model::ForEachSRM(
   }
 }
 
+// Copy rows of 'id_set' from 'local_W' to 'remote_W' under 'lock'.
+static void PullCopy(std::default_random_engine& engine,  // NOLINT
+                     const DataType::id_set_t& id_set, int is_train,
+                     ReadWriteLock* lock, DataType::srm_t* local_W,
+                     DataType::srm_t* remote_W) {
+  using int_t = DataType::int_t;
+  using float_t = DataType::float_t;
+  using srm_t = DataType::srm_t;
+  if (lock == nullptr) {
+    for (int_t id : id_set) {
+      const float_t* embedding =
+          is_train ? local_W->get_row(engine, id)
+                   : ((const srm_t*)local_W)->get_row_no_init(id);
+      if (embedding) {
+        remote_W->assign(id, embedding);
+      }
+    }
+    return;
+  }
+
+  // Copy existing rows under one read lock.
+  std::vector<int_t> missing;
+  {
+    ReadLockGuard guard(lock);
+    for (int_t id : id_set) {
+      const float_t* embedding = ((const srm_t*)local_W)->get_row_no_init(id);
+      if (embedding) {
+        remote_W->assign(id, embedding);
+      } else if (is_train) {
+        missing.emplace_back(id);
+      }
+    }
+  }
+
+  // get random values for missing keys
+  if (!missing.empty()) {
+    WriteLockGuard guard(lock);
+    for (int_t id : missing) {
+      remote_W->assign(id, local_W->get_row(engine, id));
+    }
+  }
+}
+
+// View rows of 'id_set' from 'local_W' in 'remote_W'.
+static void PullView(std::default_random_engine& engine,  // NOLINT
+                     const DataType::id_set_t& id_set, int is_train,
+                     DataType::srm_t* local_W, DataType::srm_t* remote_W) {
+  using int_t = DataType::int_t;
+  using float_t = DataType::float_t;
+  using srm_t = DataType::srm_t;
+  for (int_t id : id_set) {
+    const float_t* embedding =
+        is_train ? local_W->get_row(engine, id)
+                 : ((const srm_t*)local_W)->get_row_no_init(id);
+    if (embedding) {
+      remote_W->assign_view(id, embedding);
+    }
+  }
+}
+
 void Model::Pull(std::default_random_engine& engine,
-                 const PullRequest& pull_request, TensorMap* remote_param) {
+                 const PullRequest& pull_request, TensorMap* remote_param,
+                 int copy) {
   remote_param->ClearValue();
 
   for (const std::string& name : pull_request.tsr_set) {
     const auto& local_W = param_.get<tsr_t>(name);
     auto& remote_W = remote_param->get_or_insert<tsr_t>(name);
-    // view, zero-copy
-    remote_W = local_W.get_view();
+    if (copy) {
+      remote_W = local_W;
+    } else {
+      // view, zero-copy
+      remote_W = local_W.get_view();
+    }
   }
 
   for (const auto& entry : pull_request.srm_map) {
@@ -327,7 +422,15 @@ void Model::Pull(std::default_random_engine& engine,
     auto& remote_W = remote_param->get_or_insert<srm_t>(name);
     remote_W.set_col(local_W.col());
     remote_W.reserve(id_set.size());
-    if (pull_request.is_train) {
+    if (copy) {
+      ReadWriteLock* lock = nullptr;
+      if (use_lock_) {
+        lock = param_lock_.unsafe_get<std::shared_ptr<ReadWriteLock>>(name)
+                   .get();
+      }
+      PullCopy(engine, id_set, pull_request.is_train, lock, &local_W,
+               &remote_W);
+    } else if (pull_request.is_train) {
       // get random values for missing keys
       if (use_lock_) {
         auto& lock =
@@ -359,6 +462,51 @@ void Model::Pull(std::default_random_engine& engine,
   remote_param->RemoveEmptyValue();
 }
 
+void Model::Pull(std::default_random_engine& engine,
+                 const PullRequest& pull_request, TensorMap* remote_param,
+                 OutputStream& os) {
+  remote_param->ClearValue();
+  int size = (int)(pull_request.tsr_set.size() + pull_request.srm_map.size());
+  os << size;
+
+  for (const std::string& name : pull_request.tsr_set) {
+    int type = TENSOR_TYPE_TSR;
+    os << name << type << param_.get<tsr_t>(name);
+  }
+
+  for (const auto& entry : pull_request.srm_map) {
+    const std::string& name = entry.first;
+    const id_set_t& id_set = entry.second;
+    auto& local_W = param_.get<srm_t>(name);
+    auto& remote_W = remote_param->get_or_insert<srm_t>(name);
+    remote_W.set_col(local_W.col());
+    remote_W.reserve(id_set.size());
+    int type = TENSOR_TYPE_SRM;
+    if (!use_lock_) {
+      PullView(engine, id_set, pull_request.is_train, &local_W, &remote_W);
+      os << name << type << remote_W;
+      continue;
+    }
+
+    // Write existing rows under one read lock.
+    auto& lock = param_lock_.unsafe_get<std::shared_ptr<ReadWriteLock>>(name);
+    {
+      ReadLockGuard guard(lock.get());
+      PullView(engine, id_set, 0, &local_W, &remote_W);
+      if (!pull_request.is_train || remote_W.size() == id_set.size()) {
+        os << name << type << remote_W;
+        continue;
+      }
+    }
+
+    // get random values for missing keys, write rows under the write lock
+    WriteLockGuard guard(lock.get());
+    remote_W.zeros();
+    PullView(engine, id_set, 1, &local_W, &remote_W);
+    os << name << type << remote_W;
+  }
+}
+
 void Model::SetParam(std::vector<std::unique_ptr<TensorMap>>* remote_params) {
   param_.ClearSRMValue();
 
@@ -0,0 +1,180 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/graph_node.h>
+#include <deepx_core/graph/model_quantizer.h>
+#include <string>
+#include <unordered_map>
+
+namespace deepx_core {
+namespace {
+
+// Return the quantization axis of the i-th input of 'node',
+// -1 if it can't be quantized.
+int GetQuantizedAxis(const GraphNode* node, int i) {
+  const GraphNode* W = node->input(i);
+  std::string class_name = node->class_name();
+  if (class_name == "GroupEmbeddingLookupNode" ||
+      class_name == "GroupEmbeddingLookup2Node") {
+    return (i >= 1 && W->shape().is_rank(2)) ? 0 : -1;
+  }
+
+  if (i != 1 || W->tensor_type() != TENSOR_TYPE_TSR ||
+      !W->shape().is_rank(2)) {
+    return -1;
+  }
+
+  if (class_name == "FullyConnectNode" ||
+      class_name == "FusedFullyConnectNode") {
+    return 1;
+  }
+
+  if (class_name == "GEMMNode") {
+    const auto* gemm = (const GEMMNode*)node;
+    return (gemm->transX() == 0 && gemm->transY() == 0) ? 1 : -1;
+  }
+
+  if (class_name == "MatmulNode" || class_name == "Matmul2Node") {
+    if (class_name == "Matmul2Node") {
+      const auto* matmul = (const Matmul2Node*)node;
+      if (matmul->transX() != 0 || matmul->transY() != 0) {
+        return -1;
+      }
+    }
+    return node->input(0)->shape().rank() >= 2 ? 1 : -1;
+  }
+  return -1;
+}
+
+}  // namespace
+
+/************************************************************************/
+/* ModelQuantizer */
+/************************************************************************/
+void ModelQuantizer::Init(const Graph* graph, int dtype) {
+  DXCHECK_THROW(dtype == TENSOR_DTYPE_INT8 || dtype == TENSOR_DTYPE_FLOAT16);
+  graph_ = graph;
+  dtype_ = dtype;
+}
+
+bool ModelQuantizer::Quantize(const TensorMap& param,
+                              TensorMap* qparam) const {
+  // Rows narrower than it are quantized to fp16 instead of int8,
+  // since the scale outweighs the savings.
+  static constexpr int MIN_INT8_COL = 4;  // magic number
+
+  // Each use of a param votes for an axis, -1 vetoes.
+  std::unordered_map<std::string, int> axis_map;
+  for (const auto& entry : graph_->name_2_node()) {
+    const GraphNode* node = entry.second;
+    for (int i = 0; i < node->input_size(); ++i) {
+      const GraphNode* W = node->input(i);
+      if (W->node_type() != GRAPH_NODE_TYPE_PARAM) {
+        continue;
+      }
+
+      int axis = GetQuantizedAxis(node, i);
+      auto it = axis_map.find(W->name());
+      if (it == axis_map.end()) {
+        axis_map.emplace(W->name(), axis);
+      } else if (it->second != axis) {
+        it->second = -1;
+      }
+    }
+  }
+
+  // Either all or none of params of a lookup are quantized.
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (const auto& entry : graph_->name_2_node()) {
+      const GraphNode* node = entry.second;
+      if (std::string(node->class_name()) != "GroupEmbeddingLookupNode") {
+        continue;
+      }
+
+      bool all = true;
+      for (int i = 1; i < node->input_size(); ++i) {
+        auto it = axis_map.find(node->input(i)->name());
+        all = all && it != axis_map.end() && it->second >= 0;
+      }
+      if (all) {
+        continue;
+      }
+
+      for (int i = 1; i < node->input_size(); ++i) {
+        auto it = axis_map.find(node->input(i)->name());
+        if (it != axis_map.end() && it->second >= 0) {
+          it->second = -1;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  qparam->clear();
+  for (const auto& entry : param) {
+    const std::string& name = entry.first;
+    const Any& Wany = entry.second;
+    auto it = axis_map.find(name);
+    int axis = it == axis_map.end() ? -1 : it->second;
+    if (axis >= 0 && Wany.is<tsr_t>()) {
+      const auto& W = Wany.unsafe_to_ref<tsr_t>();
+      int dtype = dtype_;
+      if (axis == 0 && W.dim(1) < MIN_INT8_COL) {
+        dtype = TENSOR_DTYPE_FLOAT16;
+      }
+      auto& qW = qparam->insert<qtsr_t>(name);
+      qW.quantize(W, dtype, axis);
+      DXINFO("Quantized TSR %s to %s, %zu bytes.", name.c_str(),
+             dtype == TENSOR_DTYPE_INT8 ? "int8" : "fp16", qW.bytes());
+    } else if (axis >= 0 && Wany.is<srm_t>()) {
+      const auto& W = Wany.unsafe_to_ref<srm_t>();
+      if (W.mapped().size > 0) {
+        DXERROR("Couldn't quantize mapped SRM: %s.", name.c_str());
+        return false;
+      }
+      int dtype = dtype_;
+      if (W.col() < MIN_INT8_COL) {
+        dtype = TENSOR_DTYPE_FLOAT16;
+      }
+      auto& qW = qparam->insert<qsrm_t>(name);
+      qW.quantize(W, dtype);
+      DXINFO("Quantized SRM %s to %s, %zu bytes.", name.c_str(),
+             dtype == TENSOR_DTYPE_INT8 ? "int8" : "fp16", qW.bytes());
+    } else {
+      (*qparam)[name] = Wany;
+    }
+  }
+  return true;
+}
+
+bool ModelQuantizer::HasQuantizedParam(const TensorMap& param) noexcept {
+  for (const auto& entry : param) {
+    if (entry.second.is<qtsr_t>() || entry.second.is<qsrm_t>()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t ModelQuantizer::GetValueBytes(const TensorMap& param) noexcept {
+  size_t bytes = 0;
+  for (const auto& entry : param) {
+    const Any& Wany = entry.second;
+    if (Wany.is<tsr_t>()) {
+      bytes += Wany.unsafe_to_ref<tsr_t>().total_dim() * sizeof(float_t);
+    } else if (Wany.is<srm_t>()) {
+      const auto& W = Wany.unsafe_to_ref<srm_t>();
+      bytes += (W.size() + W.mapped().size) * W.col() * sizeof(float_t);
+    } else if (Wany.is<qtsr_t>()) {
+      bytes += Wany.unsafe_to_ref<qtsr_t>().bytes();
+    } else if (Wany.is<qsrm_t>()) {
+      bytes += Wany.unsafe_to_ref<qsrm_t>().bytes();
+    }
+  }
+  return bytes;
+}
+
+}  // namespace deepx_core
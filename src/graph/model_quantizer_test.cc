@@ -0,0 +1,167 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/dx_gtest.h>
+#include <deepx_core/graph/graph_module_creator.h>
+#include <deepx_core/graph/instance_reader.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/graph/model_quantizer.h>
+#include <deepx_core/graph/op_context.h>
+#include <deepx_core/graph/variable_scope.h>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace deepx_core {
+
+class ModelQuantizerTest : public testing::Test, public DataType {
+ protected:
+  const std::string file = "model_quantizer_test.bin";
+  std::default_random_engine engine;
+  Graph graph;
+  Model model;
+  std::string target_name;
+
+ protected:
+  void TearDown() override { (void)remove(file.c_str()); }
+
+  void Build(int sparse) {
+    std::vector<GroupConfigItem> items(2);
+    for (int i = 0; i < 2; ++i) {
+      items[i].group_id = i + 1;
+      items[i].embedding_row = 100;
+      items[i].embedding_col = 8;
+    }
+    auto* X = GetX();
+    auto* E = DeepGroupEmbeddingLookup("E", X, items, sparse);
+    auto* H = StackedFullyConnect("fc", E, {16, 8}, "relu");
+    auto* Z = AddBias("bias", FullyConnect("out", H, 1));
+    std::vector<GraphNode*> targets = BinaryClassificationTarget(Z, 0);
+    ASSERT_TRUE(graph.Compile(targets, 1));
+    ReleaseVariable();
+    target_name = targets[1]->name();
+
+    model.Init(&graph);
+    ASSERT_TRUE(model.InitParam(engine));
+    model.ForEachSRM([this](const std::string&, srm_t* W) {
+      W->set_initializer(TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+      for (int_t group_id = 1; group_id <= 2; ++group_id) {
+        for (int_t i = 0; i < 100; i += 2) {
+          W->get_row(engine, ll_sparse_tensor_t::make_feature_id(group_id, i));
+        }
+      }
+    });
+  }
+
+  void FillInstance(Instance* inst) {
+    auto& X = inst->get_or_insert<csr_t>(X_NAME);
+    X.clear();
+    for (int_t i = 0; i < 100; ++i) {
+      X.emplace(ll_sparse_tensor_t::make_feature_id(1, i), 1);
+      X.emplace(ll_sparse_tensor_t::make_feature_id(2, 99 - i), 0.5);
+      X.add_row();
+    }
+    inst->set_batch(X.row());
+  }
+
+  tsr_t Predict(TensorMap* param) {
+    OpContext op_context;
+    op_context.Init(&graph, param);
+    DXCHECK_THROW(op_context.InitOp(std::vector<std::string>{target_name}, -1));
+    FillInstance(op_context.mutable_inst());
+    op_context.InitPredict();
+    op_context.Predict();
+    return op_context.hidden().get<tsr_t>(target_name);
+  }
+
+  void TestQuantize(int dtype, double eps) {
+    ModelQuantizer quantizer;
+    quantizer.Init(&graph, dtype);
+    TensorMap qparam;
+    ASSERT_TRUE(quantizer.Quantize(model.param(), &qparam));
+    EXPECT_TRUE(ModelQuantizer::HasQuantizedParam(qparam));
+    EXPECT_FALSE(ModelQuantizer::HasQuantizedParam(model.param()));
+    EXPECT_LT(ModelQuantizer::GetValueBytes(qparam),
+              ModelQuantizer::GetValueBytes(model.param()));
+
+    // weights are quantized, biases are copied
+    for (const auto& entry : qparam) {
+      const std::string& name = entry.first;
+      if (name.find('W') == std::string::npos) {
+        EXPECT_TRUE(entry.second.is<tsr_t>()) << name;
+      } else {
+        EXPECT_TRUE(entry.second.is<qtsr_t>() || entry.second.is<qsrm_t>())
+            << name;
+      }
+    }
+
+    tsr_t P = Predict(model.mutable_param());
+    tsr_t qP = Predict(&qparam);
+    EXPECT_TSR_NEAR_EPS(qP, P, eps);
+  }
+};
+
+TEST_F(ModelQuantizerTest, Quantize_int8_dense) {
+  Build(0);
+  TestQuantize(TENSOR_DTYPE_INT8, 0.02);
+}
+
+TEST_F(ModelQuantizerTest, Quantize_int8_sparse) {
+  Build(1);
+  TestQuantize(TENSOR_DTYPE_INT8, 0.02);
+}
+
+TEST_F(ModelQuantizerTest, Quantize_fp16_dense) {
+  Build(0);
+  TestQuantize(TENSOR_DTYPE_FLOAT16, 0.002);
+}
+
+TEST_F(ModelQuantizerTest, Quantize_fp16_sparse) {
+  Build(1);
+  TestQuantize(TENSOR_DTYPE_FLOAT16, 0.002);
+}
+
+TEST_F(ModelQuantizerTest, Quantize_unsupported) {
+  auto* X = GetVariableRandn("X", Shape(4, 8));
+  auto* W = GetVariableRandn("W", Shape(8, 8));
+  auto* V = GetVariableRandn("V", Shape(8, 8));
+  auto* b = GetVariableZeros("b", Shape(1, 8));
+  auto* H = new FullyConnectNode("H", X, W, b);
+  // W is also used transposed, V is used only transposed.
+  auto* Z = new Matmul2Node("Z", new Matmul2Node("", H, W, 0, 1), V, 0, 1);
+  ASSERT_TRUE(graph.Compile(std::vector<GraphNode*>{Z}, 1));
+  ReleaseVariable();
+  model.Init(&graph);
+  ASSERT_TRUE(model.InitParam(engine));
+
+  ModelQuantizer quantizer;
+  quantizer.Init(&graph, TENSOR_DTYPE_INT8);
+  TensorMap qparam;
+  ASSERT_TRUE(quantizer.Quantize(model.param(), &qparam));
+  EXPECT_FALSE(ModelQuantizer::HasQuantizedParam(qparam));
+  EXPECT_EQ(qparam.get<tsr_t>("W"), model.param().get<tsr_t>("W"));
+  EXPECT_EQ(qparam.get<tsr_t>("V"), model.param().get<tsr_t>("V"));
+}
+
+TEST_F(ModelQuantizerTest, SaveLoad) {
+  Build(1);
+  ModelQuantizer quantizer;
+  quantizer.Init(&graph, TENSOR_DTYPE_INT8);
+  Model quantized_model;
+  quantized_model.Init(&graph);
+  ASSERT_TRUE(
+      quantizer.Quantize(model.param(), quantized_model.mutable_param()));
+  ASSERT_TRUE(quantized_model.Save(file));
+
+  Model read_model;
+  read_model.Init(&graph);
+  ASSERT_TRUE(read_model.Load(file));
+  EXPECT_TRUE(ModelQuantizer::HasQuantizedParam(read_model.param()));
+  tsr_t P = Predict(quantized_model.mutable_param());
+  tsr_t read_P = Predict(read_model.mutable_param());
+  EXPECT_TSR_NEAR(read_P, P);
+}
+
+}  // namespace deepx_core
@@ -187,38 +187,74 @@ bool ModelShard::InitFreqStore(freq_t freq_filter_threshold) {
 }
 
 bool ModelShard::InitOLStore(freq_t update_threshold,
-                             float_t distance_threshold) {
+                             float_t distance_threshold, int baseline_type) {
   ol_store_.reset(new OLStore);
   ol_store_->set_update_threshold(update_threshold);
   ol_store_->set_distance_threshold(distance_threshold);
+  ol_store_->set_baseline_type(baseline_type);
   ol_store_->Init(graph_, model_->mutable_param());
   return ol_store_->InitParam();
 }
 
-bool ModelShard::InitLock() {
-  if (ol_store_) {
-    DXERROR("OLStore does not support InitLock.");
+bool ModelShard::InitColdStore(const std::string& dir,
+                               const std::string& cold_store_config) {
+  StringMap config;
+  if (!ParseConfig(cold_store_config, &config)) {
+    DXERROR("Failed to parse cold store config: %s.",
+            cold_store_config.c_str());
     return false;
   }
+  cold_store_.reset(new ColdStore);
+  cold_store_->set_file_prefix(dir + "/cold_store" +
+                               GetSuffix(shard_, shard_id_));
+  cold_store_->Init(model_->mutable_param(), optimizer_.get());
+  return cold_store_->InitConfig(config);
+}
 
+bool ModelShard::InitLock() {
   model_->InitLock();
   if (optimizer_) {
     optimizer_->InitLock(model_->mutable_param_lock());
   }
+  if (ol_store_) {
+    ol_store_->InitLock(model_->mutable_param_lock());
+  }
   if (ts_store_) {
     ts_store_->InitLock();
   }
   if (freq_store_) {
     freq_store_->InitLock();
   }
+  if (cold_store_) {
+    cold_store_->InitLock();
+  }
   return true;
 }
 
+void ModelShard::ReserveSRM(size_t expected_id, size_t rehash_step) {
+  auto func = [expected_id, rehash_step](const std::string& name, srm_t* W) {
+    if (expected_id > W->size()) {
+      DXINFO("Reserving SRM %s from %zu to %zu entries...", name.c_str(),
+             W->size(), expected_id);
+      W->reserve(expected_id);
+    }
+    W->set_rehash_step(rehash_step);
+  };
+  model_->ForEachSRM(func);
+  if (optimizer_) {
+    optimizer_->ForEachSRM(func);
+  }
+}
+
 bool ModelShard::SaveModelLegacy(const std::string& dir) const {
+  ColdStore::SaveGuard guard(cold_store_.get(), model_->mutable_param(),
+                             nullptr);
   return model_->SaveLegacy(GetModelFileLegacy(dir));
 }
 
 bool ModelShard::SaveModel(const std::string& dir) const {
+  ColdStore::SaveGuard guard(cold_store_.get(), model_->mutable_param(),
+                             nullptr);
   return model_->Save(GetModelFile(dir));
 }
 
@@ -251,11 +287,13 @@ bool ModelShard::SaveOLFeatureKVModel(const std::string& dir,
 }
 
 bool ModelShard::SaveOptimizerLegacy(const std::string& dir) const {
+  ColdStore::SaveGuard guard(cold_store_.get(), nullptr, optimizer_.get());
   return deepx_core::SaveOptimizerLegacy(GetOptimizerFileLegacy(dir),
                                          *optimizer_);
 }
 
 bool ModelShard::SaveOptimizer(const std::string& dir) const {
+  ColdStore::SaveGuard guard(cold_store_.get(), nullptr, optimizer_.get());
   return deepx_core::SaveOptimizer(GetOptimizerFile(dir), *optimizer_);
 }
 
@@ -856,14 +894,39 @@ bool ModelShard::WarmupFreqStore(const std::string& dir) {
   return true;
 }
 
-void ModelShard::Pull(PullRequest* pull_request, TensorMap* param) {
+void ModelShard::_Pull(PullRequest* pull_request, TensorMap* param,
+                       int copy) {
+  model_->Pull(engine_, *pull_request, param, copy);
+}
+
+void ModelShard::Pull(PullRequest* pull_request, TensorMap* param, int copy) {
   if (freq_store_ && pull_request->is_train) {
     freq_store_->Filter(pull_request);
   }
-  model_->Pull(engine_, *pull_request, param);
+  if (cold_store_) {
+    cold_store_->Pull(*pull_request, [this, pull_request, param, copy]() {
+      _Pull(pull_request, param, copy);
+    });
+  } else {
+    _Pull(pull_request, param, copy);
+  }
 }
 
-void ModelShard::Push(TensorMap* grad, TensorMap* overwritten_param) {
+void ModelShard::Pull(PullRequest* pull_request, TensorMap* param,
+                      OutputStream& os) {
+  if (freq_store_ && pull_request->is_train) {
+    freq_store_->Filter(pull_request);
+  }
+  if (cold_store_) {
+    cold_store_->Pull(*pull_request, [this, pull_request, param, &os]() {
+      model_->Pull(engine_, *pull_request, param, os);
+    });
+  } else {
+    model_->Pull(engine_, *pull_request, param, os);
+  }
+}
+
+void ModelShard::_Push(TensorMap* grad, TensorMap* overwritten_param) {
   if (!grad->empty()) {
     if (ol_store_) {
       ol_store_->Update(grad);
@@ -885,6 +948,17 @@ void ModelShard::Push(TensorMap* grad, TensorMap* overwritten_param) {
   }
 }
 
+void ModelShard::Push(TensorMap* grad, TensorMap* overwritten_param) {
+  if (cold_store_) {
+    cold_store_->Push(*grad, overwritten_param,
+                      [this, grad, overwritten_param]() {
+                        _Push(grad, overwritten_param);
+                      });
+  } else {
+    _Push(grad, overwritten_param);
+  }
+}
+
 void ModelShard::ExpireTSStore() {
   auto expired = ts_store_->Expire();
   auto filter = [&expired](const std::string& name, srm_t* W) {
@@ -902,6 +976,208 @@ void ModelShard::ExpireTSStore() {
       return expired.count(entry.first) > 0;
     });
   }
+  if (cold_store_) {
+    size_t prev_size = cold_store_->size();
+    cold_store_->Remove(expired);
+    DXINFO("ColdStore has %zu entries expired, %zu entries remained.",
+           prev_size - cold_store_->size(), cold_store_->size());
+  }
+}
+
+void ModelShard::RestoreColdStore() {
+  if (cold_store_) {
+    DXINFO("Restoring %zu entries from ColdStore...", cold_store_->size());
+    cold_store_->Restore();
+    DXINFO("Done.");
+  }
+}
+
+bool ModelShard::Split(ModelShard* other, const Shard* shard, int shard_id) {
+  other->graph_ = graph_;
+  if (!other->model_) {
+    other->model_.reset(new Model);
+    other->model_->Init(graph_);
+  }
+  model_->Split(other->model_.get(), shard, shard_id);
+
+  if (optimizer_) {
+    if (!other->optimizer_) {
+      other->optimizer_ = NewOptimizer(optimizer_->class_name());
+      if (!other->optimizer_) {
+        return false;
+      }
+      other->optimizer_->Init(graph_, other->model_->mutable_param());
+    }
+    if (!optimizer_->Split(other->optimizer_.get(), shard, shard_id)) {
+      return false;
+    }
+  }
+
+  if (ts_store_) {
+    if (!other->ts_store_) {
+      other->ts_store_.reset(new TSStore);
+      other->ts_store_->Init(other->model_->mutable_param());
+    }
+    ts_store_->Split(other->ts_store_.get(), shard, shard_id);
+  }
+
+  if (freq_store_) {
+    if (!other->freq_store_) {
+      other->freq_store_.reset(new FreqStore);
+      other->freq_store_->Init(other->model_->mutable_param());
+    }
+    freq_store_->Split(other->freq_store_.get(), shard, shard_id);
+  }
+  return true;
+}
+
+bool ModelShard::ExportShard(const Shard* shard, int shard_id,
+                             OutputStream& os) {
+  DXINFO("Exporting shard %d/%d...", shard_id, shard->shard_size());
+  ModelShard exported;
+  if (!Split(&exported, shard, shard_id)) {
+    return false;
+  }
+
+  int version = 0;
+  int has_optimizer = exported.optimizer_ ? 1 : 0;
+  int has_ts_store = exported.ts_store_ ? 1 : 0;
+  int has_freq_store = exported.freq_store_ ? 1 : 0;
+  os << version;
+  bool success;
+  {
+    // Spilled rows of the shard are streamed from files.
+    ColdStore::SaveGuard guard(cold_store_.get(),
+                               exported.model_->mutable_param(),
+                               exported.optimizer_.get(), shard, shard_id);
+    success = exported.model_->Write(os);
+    os << has_optimizer;
+    if (success && has_optimizer) {
+      os << std::string(exported.optimizer_->class_name());
+      success = exported.optimizer_->Write(os);
+    }
+  }
+  os << has_ts_store;
+  if (success && has_ts_store) {
+    success = exported.ts_store_->Write(os);
+  }
+  os << has_freq_store;
+  if (success && has_freq_store) {
+    success = exported.freq_store_->Write(os);
+  }
+
+  // Move entries back, they are dropped by 'CommitShard'.
+  if (!exported.Split(this, nullptr, 0)) {
+    return false;
+  }
+
+  if (!success || !os) {
+    DXERROR("Failed to export shard.");
+    return false;
+  }
+  DXINFO("Done.");
+  return true;
+}
+
+bool ModelShard::ImportShard(InputStream& is) {
+  DXINFO("Importing shard...");
+  int version;
+  is >> version;
+  if (!is) {
+    DXERROR("Failed to import shard.");
+    return false;
+  }
+
+  if (version > 0) {
+    DXERROR("Couldn't handle a higher version: %d.", version);
+    is.set_bad();
+    return false;
+  }
+
+  ModelShard imported;
+  imported.graph_ = graph_;
+  imported.model_.reset(new Model);
+  imported.model_->Init(graph_);
+  if (!imported.model_->Read(is)) {
+    return false;
+  }
+
+  int has_optimizer = 0;
+  is >> has_optimizer;
+  if (has_optimizer) {
+    std::string name;
+    is >> name;
+    if (!is) {
+      DXERROR("Failed to import shard.");
+      return false;
+    }
+    imported.optimizer_ = NewOptimizer(name);
+    if (!imported.optimizer_) {
+      return false;
+    }
+    imported.optimizer_->Init(graph_, imported.model_->mutable_param());
+    if (!imported.optimizer_->Read(is)) {
+      return false;
+    }
+  }
+
+  int has_ts_store = 0;
+  is >> has_ts_store;
+  if (has_ts_store) {
+    imported.ts_store_.reset(new TSStore);
+    imported.ts_store_->Init(imported.model_->mutable_param());
+    if (!imported.ts_store_->Read(is)) {
+      return false;
+    }
+  }
+
+  int has_freq_store = 0;
+  is >> has_freq_store;
+  if (has_freq_store) {
+    imported.freq_store_.reset(new FreqStore);
+    imported.freq_store_->Init(imported.model_->mutable_param());
+    if (!imported.freq_store_->Read(is)) {
+      return false;
+    }
+  }
+
+  if (!is) {
+    DXERROR("Failed to import shard.");
+    return false;
+  }
+
+  // Drop members this shard doesn't have.
+  if (!optimizer_) {
+    imported.optimizer_.reset();
+  }
+  if (!ts_store_) {
+    imported.ts_store_.reset();
+  }
+  if (!freq_store_) {
+    imported.freq_store_.reset();
+  }
+  if (!imported.Split(this, nullptr, 0)) {
+    return false;
+  }
+  DXINFO("Done.");
+  return true;
+}
+
+bool ModelShard::CommitShard(const Shard* shard, int shard_id) {
+  DXINFO("Committing shard %d/%d...", shard_id, shard->shard_size());
+  ModelShard kept, dropped;
+  if (!Split(&kept, shard, shard_id) || !Split(&dropped, nullptr, 0) ||
+      !kept.Split(this, nullptr, 0)) {
+    return false;
+  }
+  if (cold_store_) {
+    cold_store_->RemoveIf([shard, shard_id](int_t id) {
+      return !shard->HasSRM(shard_id, id);
+    });
+  }
+  InitShard(shard, shard_id);
+  DXINFO("Done.");
+  return true;
 }
 
 bool ModelShard::InitThreadPool() {
@@ -0,0 +1,117 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/common/stream.h>
+#include <deepx_core/graph/dist_proto.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/graph_node.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+
+namespace deepx_core {
+
+class ModelTest : public testing::Test, public DataType {
+ protected:
+  Graph graph;
+  Model model;
+  std::default_random_engine engine;
+  PullRequest pull_request;
+
+ protected:
+  void SetUp() override {
+    auto* Tnode = new VariableNode("T", Shape(1, 2), TENSOR_TYPE_TSR,
+                                   TENSOR_INITIALIZER_TYPE_RAND, 0, 1);
+    auto* Snode = new VariableNode("S", Shape(0, 2), TENSOR_TYPE_SRM,
+                                   TENSOR_INITIALIZER_TYPE_RAND, 0, 1);
+    ASSERT_TRUE(graph.Compile({Tnode, Snode}, 1));
+    model.Init(&graph);
+    ASSERT_TRUE(model.InitParam(engine));
+    model.InitLock();
+
+    auto& S = model.mutable_param()->get<srm_t>("S");
+    for (int_t id : {1, 2}) {
+      float_t row[2] = {(float_t)id, (float_t)-id};
+      S.assign(id, row);
+    }
+    pull_request.tsr_set.emplace("T");
+    pull_request.srm_map["S"] = id_set_t{1, 2, 3};
+  }
+
+  void Modify() {
+    model.mutable_param()->get<tsr_t>("T").zeros();
+    auto& S = model.mutable_param()->get<srm_t>("S");
+    S.get_row_no_init(1)[0] = 100;
+    // Rows are freed.
+    S.zeros();
+  }
+
+  void TestPullCopy(int is_train) {
+    pull_request.is_train = is_train;
+    TensorMap param;
+    model.Pull(engine, pull_request, &param, 1);
+    tsr_t T = model.param().get<tsr_t>("T");
+    Modify();
+
+    EXPECT_TRUE(param.get<tsr_t>("T") == T);
+    const auto& S = param.get<srm_t>("S");
+    EXPECT_EQ(S.size(), is_train ? 3u : 2u);
+    for (int_t id : {1, 2}) {
+      const float_t* row = S.get_row_no_init(id);
+      ASSERT_TRUE(row != nullptr);
+      EXPECT_EQ(row[0], (float_t)id);
+      EXPECT_EQ(row[1], (float_t)-id);
+    }
+  }
+
+  void TestPullWrite(int is_train) {
+    pull_request.is_train = is_train;
+    TensorMap remote_param;
+    std::string buf;
+    OutputStringStream os;
+    os.SetView(&buf);
+    model.Pull(engine, pull_request, &remote_param, os);
+    ASSERT_TRUE(os);
+    tsr_t T = model.param().get<tsr_t>("T");
+    Modify();
+
+    TensorMap param;
+    InputStringStream is;
+    is.SetView(buf.data(), buf.size());
+    is >> param;
+    ASSERT_TRUE(is);
+    EXPECT_TRUE(param.get<tsr_t>("T") == T);
+    const auto& S = param.get<srm_t>("S");
+    EXPECT_EQ(S.size(), is_train ? 3u : 2u);
+    for (int_t id : {1, 2}) {
+      const float_t* row = S.get_row_no_init(id);
+      ASSERT_TRUE(row != nullptr);
+      EXPECT_EQ(row[0], (float_t)id);
+      EXPECT_EQ(row[1], (float_t)-id);
+    }
+  }
+};
+
+TEST_F(ModelTest, Pull_copy_train) { TestPullCopy(1); }
+
+TEST_F(ModelTest, Pull_copy_predict) { TestPullCopy(0); }
+
+TEST_F(ModelTest, Pull_write_train) { TestPullWrite(1); }
+
+TEST_F(ModelTest, Pull_write_predict) { TestPullWrite(0); }
+
+TEST_F(ModelTest, Pull_view) {
+  pull_request.is_train = 0;
+  TensorMap param;
+  model.Pull(engine, pull_request, &param);
+  EXPECT_EQ(param.get<tsr_t>("T").data(),
+            model.param().get<tsr_t>("T").data());
+  EXPECT_EQ(param.get<srm_t>("S").get_row_no_init(1),
+            model.param().get<srm_t>("S").get_row_no_init(1));
+}
+
+}  // namespace deepx_core
@@ -4,12 +4,106 @@
 // Author: Shuting Guo (tinkleguo@tencent.com)
 //
 
+#include <deepx_core/common/read_write_lock.h>
 #include <deepx_core/dx_log.h>
 #include <deepx_core/graph/feature_kv_util.h>
 #include <deepx_core/graph/ol_store.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>  // memcpy
 
 namespace deepx_core {
 
+/************************************************************************/
+/* OLStore::SRMBaseline */
+/************************************************************************/
+constexpr size_t OLStore::SRMBaseline::BLOCK_ROW;
+
+void OLStore::SRMBaseline::Init(int type, int col) {
+  type_ = type;
+  col_ = col;
+  switch (type_) {
+    case OL_STORE_BASELINE_TYPE_INT8:
+      // scale + int8 values
+      row_bytes_ = sizeof(float_t) + (size_t)col_;
+      break;
+    default:
+      row_bytes_ = sizeof(float_t) * col_;
+      break;
+  }
+  row_ = 0;
+  row_index_.clear();
+  blocks_.clear();
+}
+
+size_t OLStore::SRMBaseline::bytes() const noexcept {
+  return blocks_.size() * BLOCK_ROW * row_bytes_ +
+         row_index_.bucket_size() * (sizeof(int_t) + sizeof(size_t) + 1);
+}
+
+void OLStore::SRMBaseline::Assign(int_t id, const float_t* embedding) {
+  auto it = row_index_.find(id);
+  size_t index;
+  if (it == row_index_.end()) {
+    index = row_++;
+    if (index / BLOCK_ROW >= blocks_.size()) {
+      blocks_.emplace_back(new char[BLOCK_ROW * row_bytes_]);
+    }
+    row_index_.emplace(id, index);
+  } else {
+    index = it->second;
+  }
+
+  char* row = GetRow(index);
+  switch (type_) {
+    case OL_STORE_BASELINE_TYPE_INT8: {
+      float_t max_abs = 0;
+      for (int i = 0; i < col_; ++i) {
+        float_t abs = std::fabs(embedding[i]);
+        if (max_abs < abs) {
+          max_abs = abs;
+        }
+      }
+      float_t scale = max_abs / 127;
+      float_t inv_scale = scale > 0 ? 1 / scale : 0;
+      memcpy(row, &scale, sizeof(scale));
+      int8_t* q = (int8_t*)(row + sizeof(scale));
+      for (int i = 0; i < col_; ++i) {
+        q[i] = (int8_t)std::lround(embedding[i] * inv_scale);
+      }
+    } break;
+    default:
+      memcpy(row, embedding, row_bytes_);
+      break;
+  }
+}
+
+bool OLStore::SRMBaseline::Get(int_t id, float_t* embedding) const {
+  auto it = row_index_.find(id);
+  if (it == row_index_.end()) {
+    return false;
+  }
+
+  const char* row = GetRow(it->second);
+  switch (type_) {
+    case OL_STORE_BASELINE_TYPE_INT8: {
+      float_t scale;
+      memcpy(&scale, row, sizeof(scale));
+      const int8_t* q = (const int8_t*)(row + sizeof(scale));
+      for (int i = 0; i < col_; ++i) {
+        embedding[i] = q[i] * scale;
+      }
+    } break;
+    default:
+      memcpy(embedding, row, row_bytes_);
+      break;
+  }
+  return true;
+}
+
+/************************************************************************/
+/* OLStore */
+/************************************************************************/
 void OLStore::Init(const Graph* graph, const TensorMap* param) noexcept {
   graph_ = graph;
   param_ = param;
@@ -17,12 +111,50 @@ void OLStore::Init(const Graph* graph, const TensorMap* param) noexcept {
 
 bool OLStore::InitParam() {
   DXINFO("Initializing OLStore...");
-  prev_param_ = *param_;
-  DXINFO("Done.");
+  if (baseline_type_ != OL_STORE_BASELINE_TYPE_FP32 &&
+      baseline_type_ != OL_STORE_BASELINE_TYPE_INT8) {
+    DXERROR("Invalid baseline type: %d.", baseline_type_);
+    return false;
+  }
+
+  srm_baseline_map_.clear();
+  for (const auto& entry : *param_) {
+    const std::string& name = entry.first;
+    const Any& Wany = entry.second;
+    if (Wany.is<srm_t>()) {
+      const auto& W = Wany.unsafe_to_ref<srm_t>();
+      SRMBaseline& baseline = srm_baseline_map_[name];
+      baseline.Init(baseline_type_, W.col());
+      for (const auto& _entry : W) {
+        baseline.Assign(_entry.first, _entry.second);
+      }
+    }
+  }
+  DXINFO("OLStore baselines take %zu bytes.", baseline_bytes());
   return true;
 }
 
+void OLStore::InitLock(const AnyMap* param_lock) {
+  use_lock_ = 1;
+  param_lock_ = param_lock;
+  srm_state_map_lock_.reset(new std::mutex);
+  collect_lock_.reset(new std::mutex);
+}
+
+size_t OLStore::baseline_bytes() const noexcept {
+  size_t bytes = 0;
+  for (const auto& entry : srm_baseline_map_) {
+    bytes += entry.second.bytes();
+  }
+  return bytes;
+}
+
 void OLStore::Update(TensorMap* param) {
+  std::unique_lock<std::mutex> guard;
+  if (use_lock_) {
+    guard = std::unique_lock<std::mutex>(*srm_state_map_lock_);
+  }
+
   for (const auto& entry : *param) {
     const std::string& name = entry.first;
     auto it = param_->find(name);
@@ -49,32 +181,81 @@ auto OLStore::Collect() -> id_set_t {
   size_t updated = 0;
   size_t collected = 0;
 
-  for (auto& entry : srm_state_map_) {
+  std::unique_lock<std::mutex> guard;
+  if (use_lock_) {
+    guard = std::unique_lock<std::mutex>(*collect_lock_);
+  }
+
+  // Take states updated since the last 'Collect',
+  // so that 'Update' is only blocked by the swap.
+  srm_state_map_t srm_state_map;
+  {
+    std::unique_lock<std::mutex> state_guard;
+    if (use_lock_) {
+      state_guard = std::unique_lock<std::mutex>(*srm_state_map_lock_);
+    }
+    srm_state_map.swap(srm_state_map_);
+  }
+
+  for (const auto& entry : srm_state_map) {
+    srm_state_t& pending_srm_state = pending_srm_state_map_[entry.first];
+    for (const auto& _entry : entry.second) {
+      // no overflow check
+      pending_srm_state[_entry.first].update += _entry.second.update;
+    }
+  }
+  srm_state_map.clear();
+
+  std::vector<float_t> embedding_buf;
+  std::vector<float_t> prev_embedding_buf;
+  for (auto& entry : pending_srm_state_map_) {
     const std::string& name = entry.first;
     srm_state_t& srm_state = entry.second;
     const Any& Wany = param_->at(name);
-    Any& prev_Wany = prev_param_.at(name);
+    auto it = srm_baseline_map_.find(name);
+    if (!Wany.is<srm_t>() || it == srm_baseline_map_.end()) {
+      continue;
+    }
 
-    if (Wany.is<srm_t>() && prev_Wany.is<srm_t>()) {
-      const auto& W = Wany.unsafe_to_ref<srm_t>();
-      auto& prev_W = prev_Wany.unsafe_to_ref<srm_t>();
-      auto first = srm_state.begin();
-      auto last = srm_state.end();
-      for (; first != last;) {
-        int_t id = first->first;
-        const State& state = first->second;
-        const float_t* embedding = W.get_row_no_init(id);
-        const float_t* prev_embedding =
-            ((const srm_t&)prev_W).get_row_no_init(id);
-        ++updated;
-        if (Collect(state, W.col(), embedding, prev_embedding)) {
-          ++collected;
-          id_set.emplace(id);
-          prev_W.assign(id, embedding);
-          first = srm_state.erase(first);
-        } else {
-          ++first;
+    const auto& W = Wany.unsafe_to_ref<srm_t>();
+    SRMBaseline& baseline = it->second;
+    ReadWriteLock* lock = nullptr;
+    if (use_lock_) {
+      lock = param_lock_->unsafe_get<std::shared_ptr<ReadWriteLock>>(name)
+                 .get();
+    }
+    int col = W.col();
+    embedding_buf.resize(col);
+    prev_embedding_buf.resize(col);
+    auto first = srm_state.begin();
+    auto last = srm_state.end();
+    for (; first != last;) {
+      int_t id = first->first;
+      const State& state = first->second;
+      const float_t* embedding = nullptr;
+      if (lock) {
+        // Copy the row, it may be changed once the lock is released.
+        ReadLockGuard lock_guard(lock);
+        embedding = W.get_row_no_init(id);
+        if (embedding) {
+          memcpy(embedding_buf.data(), embedding, sizeof(float_t) * col);
+          embedding = embedding_buf.data();
         }
+      } else {
+        embedding = W.get_row_no_init(id);
+      }
+      const float_t* prev_embedding = nullptr;
+      if (baseline.Get(id, prev_embedding_buf.data())) {
+        prev_embedding = prev_embedding_buf.data();
+      }
+      ++updated;
+      if (Collect(state, col, embedding, prev_embedding)) {
+        ++collected;
+        id_set.emplace(id);
+        baseline.Assign(id, embedding);
+        first = srm_state.erase(first);
+      } else {
+        ++first;
       }
     }
   }
@@ -4,12 +4,17 @@
 // Author: Shuting Guo (tinkleguo@tencent.com)
 //
 
+#include <deepx_core/common/any_map.h>
+#include <deepx_core/common/read_write_lock.h>
 #include <deepx_core/graph/graph.h>
 #include <deepx_core/graph/graph_node.h>
 #include <deepx_core/graph/ol_store.h>
 #include <deepx_core/graph/tensor_map.h>
 #include <deepx_core/tensor/data_type.h>
 #include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
 
 namespace deepx_core {
 
@@ -62,14 +67,25 @@ class OLStoreTest : public testing::Test, public DataType {
 
   void TestCollect(freq_t update_threshold, float_t distance_threshold,
                    const id_set_t& expected_id_set) {
+    for (int baseline_type :
+         {OL_STORE_BASELINE_TYPE_FP32, OL_STORE_BASELINE_TYPE_INT8}) {
+      param.clear();
+      TestCollect(update_threshold, distance_threshold, baseline_type,
+                  expected_id_set);
+    }
+  }
+
+  void TestCollect(freq_t update_threshold, float_t distance_threshold,
+                   int baseline_type, const id_set_t& expected_id_set) {
     InitGraph();
     InitParam();
 
     OLStore ol_store;
     ol_store.set_update_threshold(update_threshold);
     ol_store.set_distance_threshold(distance_threshold);
+    ol_store.set_baseline_type(baseline_type);
     ol_store.Init(&graph, &param);
-    ol_store.InitParam();
+    ASSERT_TRUE(ol_store.InitParam());
 
     {
       TensorMap _param;
@@ -98,7 +114,7 @@ class OLStoreTest : public testing::Test, public DataType {
     //   4, update=3, {0} -> {4}, distance=4
 
     id_set_t id_set = ol_store.Collect();
-    EXPECT_EQ(id_set, expected_id_set);
+    EXPECT_EQ(id_set, expected_id_set) << "baseline_type=" << baseline_type;
   }
 };
 
@@ -138,4 +154,129 @@ TEST_F(OLStoreTest, Collect_update_threshold4_distance_threshold5) {
   TestCollect(4, 5, id_set_t({0, 2}));
 }
 
+TEST_F(OLStoreTest, Collect_baseline_int8) {
+  InitGraph();
+  auto& W = param.insert<srm_t>(W2node->name());
+  W.set_col(2);
+  float_t* embedding = W.get_row_no_init(1);
+  embedding[0] = 1;
+  embedding[1] = -0.5;
+
+  OLStore ol_store;
+  ol_store.set_update_threshold(100);
+  ol_store.set_distance_threshold(0.1);
+  ol_store.set_baseline_type(OL_STORE_BASELINE_TYPE_INT8);
+  ol_store.Init(&graph, &param);
+  ASSERT_TRUE(ol_store.InitParam());
+
+  TensorMap _param;
+  _param.insert<srm_t>(W2node->name()) = srm_t{{1}, {{1, 1}}};
+
+  // The quantization error is far below the distance threshold.
+  embedding[1] = -0.55;
+  ol_store.Update(&_param);
+  EXPECT_EQ(ol_store.Collect(), id_set_t({}));
+
+  embedding[1] = -0.7;
+  ol_store.Update(&_param);
+  EXPECT_EQ(ol_store.Collect(), id_set_t({1}));
+
+  // The baseline has been reset to {1, -0.7}.
+  embedding[1] = -0.75;
+  ol_store.Update(&_param);
+  EXPECT_EQ(ol_store.Collect(), id_set_t({}));
+}
+
+TEST_F(OLStoreTest, Collect_pending) {
+  InitGraph();
+  InitParam();
+
+  OLStore ol_store;
+  ol_store.set_update_threshold(2);
+  ol_store.set_distance_threshold(10);
+  ol_store.Init(&graph, &param);
+  ASSERT_TRUE(ol_store.InitParam());
+
+  TensorMap _param;
+  _param.insert<srm_t>(W2node->name()) = srm_t{{1, 2}, {{1, 1}, {1, 1}}};
+  ol_store.Update(&_param);
+  ol_store.Update(&_param);
+  EXPECT_EQ(ol_store.Collect(), id_set_t({}));
+
+  // Updates not collected are kept and accumulated.
+  _param.insert<srm_t>(W2node->name()) = srm_t{{2}, {{1, 1}}};
+  ol_store.Update(&_param);
+  EXPECT_EQ(ol_store.Collect(), id_set_t({2}));
+  EXPECT_EQ(ol_store.Collect(), id_set_t({}));
+
+  _param.insert<srm_t>(W2node->name()) = srm_t{{1}, {{1, 1}}};
+  ol_store.Update(&_param);
+  EXPECT_EQ(ol_store.Collect(), id_set_t({1}));
+}
+
+TEST_F(OLStoreTest, baseline_bytes) {
+  InitGraph();
+  auto& W = param.insert<srm_t>(W2node->name());
+  W.set_col(64);
+  for (int_t id = 0; id < 10000; ++id) {
+    W.get_row_no_init(id)[0] = 1;
+  }
+
+  OLStore fp32_ol_store;
+  fp32_ol_store.set_baseline_type(OL_STORE_BASELINE_TYPE_FP32);
+  fp32_ol_store.Init(&graph, &param);
+  ASSERT_TRUE(fp32_ol_store.InitParam());
+
+  OLStore int8_ol_store;
+  int8_ol_store.set_baseline_type(OL_STORE_BASELINE_TYPE_INT8);
+  int8_ol_store.Init(&graph, &param);
+  ASSERT_TRUE(int8_ol_store.InitParam());
+
+  EXPECT_LT(int8_ol_store.baseline_bytes() * 2,
+            fp32_ol_store.baseline_bytes());
+}
+
+TEST_F(OLStoreTest, InitLock) {
+  InitGraph();
+  InitParam();
+  AnyMap param_lock;
+  for (const std::string& name : {W2node->name(), W3node->name()}) {
+    std::shared_ptr<ReadWriteLock> lock(new ReadWriteLock);
+    param_lock[name].emplace(std::move(lock));
+  }
+
+  OLStore ol_store;
+  ol_store.set_update_threshold(0);
+  ol_store.Init(&graph, &param);
+  ASSERT_TRUE(ol_store.InitParam());
+  ol_store.InitLock(&param_lock);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([this, &ol_store]() {
+      for (int j = 0; j < 100; ++j) {
+        TensorMap _param;
+        _param.insert<srm_t>(W2node->name()) =
+            srm_t{{1, 2}, {{1, 1}, {1, 1}}};
+        _param.insert<srm_t>(W3node->name()) = srm_t{{4}, {{1}}};
+        ol_store.Update(&_param);
+      }
+    });
+  }
+  id_set_t id_set;
+  for (int j = 0; j < 10; ++j) {
+    // Collect while updating.
+    for (int_t id : ol_store.Collect()) {
+      id_set.emplace(id);
+    }
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (int_t id : ol_store.Collect()) {
+    id_set.emplace(id);
+  }
+  EXPECT_EQ(id_set, id_set_t({1, 2, 4}));
+}
+
 }  // namespace deepx_core
@@ -3,7 +3,10 @@
 // Author: Yafei Zhang (kimmyzhang@tencent.com)
 //
 
+#include <deepx_core/common/intra_op_thread.h>
 #include <deepx_core/graph/op_impl.h>
+#include <algorithm>
+#include <vector>
 
 namespace deepx_core {
 namespace {
@@ -551,6 +554,147 @@ void Col2imNDHWC(const T* in, T* out, const Im2colAux& aux) noexcept {
   }
 }
 
+/************************************************************************/
+/* Gemm */
+/************************************************************************/
+// Cache blocked gemm with packed panels of op(X) and op(Y).
+//
+// Products of conv are small or skinny,
+// e.g. m=out_channel, n=out spatial, k=in_channel*kernel spatial.
+// LLMath<T>::gemm streams whole rows of Z or Y for every element of X,
+// and transposed operands are read with large strides.
+// Here op(X) is packed into MC x KC blocks of GEMM_MR-row panels,
+// op(Y) is packed into KC x NC blocks of GEMM_NR-column panels,
+// so that transposition is done once while packing and
+// the micro kernel reads both panels contiguously.
+constexpr int GEMM_MR = 4;
+constexpr int GEMM_NR = 8;
+constexpr int GEMM_MC = 72;
+constexpr int GEMM_KC = 256;
+constexpr int GEMM_NC = 1024;
+
+template <typename T>
+struct GemmPack {
+  std::vector<T> X;
+  std::vector<T> Y;
+};
+
+template <typename T>
+void GemmPrepare(GemmPack<T>* pack) {
+  pack->X.resize((size_t)(GEMM_MC + GEMM_MR) * GEMM_KC);
+  pack->Y.resize((size_t)(GEMM_NC + GEMM_NR) * GEMM_KC);
+}
+
+// Pack op(X)[i0:i0+mc, p0:p0+kc], zero padded to whole panels.
+template <typename T>
+void GemmPackX(int transX, const T* X, int ldX, int i0, int mc, int p0,
+               int kc, T* pack) noexcept {
+  for (int ir = 0; ir < mc; ir += GEMM_MR) {
+    int mr = std::min(GEMM_MR, mc - ir);
+    for (int p = p0; p < p0 + kc; ++p) {
+      for (int i = 0; i < mr; ++i) {
+        int row = i0 + ir + i;
+        *pack++ = transX ? X[(size_t)p * ldX + row] : X[(size_t)row * ldX + p];
+      }
+      for (int i = mr; i < GEMM_MR; ++i) {
+        *pack++ = 0;
+      }
+    }
+  }
+}
+
+// Pack op(Y)[p0:p0+kc, j0:j0+nc], zero padded to whole panels.
+template <typename T>
+void GemmPackY(int transY, const T* Y, int ldY, int p0, int kc, int j0,
+               int nc, T* pack) noexcept {
+  for (int jr = 0; jr < nc; jr += GEMM_NR) {
+    int nr = std::min(GEMM_NR, nc - jr);
+    for (int p = p0; p < p0 + kc; ++p) {
+      if (transY) {
+        for (int j = 0; j < nr; ++j) {
+          *pack++ = Y[(size_t)(j0 + jr + j) * ldY + p];
+        }
+      } else {
+        const T* _Y = Y + (size_t)p * ldY + j0 + jr;
+        for (int j = 0; j < nr; ++j) {
+          *pack++ = _Y[j];
+        }
+      }
+      for (int j = nr; j < GEMM_NR; ++j) {
+        *pack++ = 0;
+      }
+    }
+  }
+}
+
+// Z[0:mr, 0:nr] += alpha * packed X panel * packed Y panel.
+template <typename T>
+void GemmMicroKernel(int kc, const T* pack_X, const T* pack_Y, T alpha, T* Z,
+                     int ldZ, int mr, int nr) noexcept {
+  // The accumulators are kept in registers.
+  T acc[GEMM_MR * GEMM_NR] = {0};
+  for (int p = 0; p < kc; ++p) {
+    for (int i = 0; i < GEMM_MR; ++i) {
+      T x = pack_X[i];
+      for (int j = 0; j < GEMM_NR; ++j) {
+        acc[i * GEMM_NR + j] += x * pack_Y[j];
+      }
+    }
+    pack_X += GEMM_MR;
+    pack_Y += GEMM_NR;
+  }
+  for (int i = 0; i < mr; ++i) {
+    for (int j = 0; j < nr; ++j) {
+      Z[j] += alpha * acc[i * GEMM_NR + j];
+    }
+    Z += ldZ;
+  }
+}
+
+// Z = alpha * op(X) * op(Y) + beta * Z,
+// op(X) is m x k, op(Y) is k x n, Z is m x n, all are row major.
+// 'pack' must have been prepared by GemmPrepare.
+template <typename T>
+void Gemm(int transX, int transY, int m, int n, int k, T alpha, const T* X,
+          const T* Y, T beta, T* Z, GemmPack<T>* pack) noexcept {
+#if HAVE_SAGE2_SGEMM == 1
+  (void)pack;
+  LLMath<T>::gemm(transX, transY, m, n, k, alpha, X, Y, beta, Z);
+#else
+  int ldX = transX ? m : k;
+  int ldY = transY ? k : n;
+  int ldZ = n;
+  if (beta == 0) {
+    LLMath<T>::zero(m * n, Z);
+  } else if (beta != 1) {
+    LLMath<T>::mul_scalar(m * n, Z, beta, Z);
+  }
+
+  T* pack_X = pack->X.data();
+  T* pack_Y = pack->Y.data();
+  for (int jc = 0; jc < n; jc += GEMM_NC) {
+    int nc = std::min(GEMM_NC, n - jc);
+    for (int pc = 0; pc < k; pc += GEMM_KC) {
+      int kc = std::min(GEMM_KC, k - pc);
+      GemmPackY(transY, Y, ldY, pc, kc, jc, nc, pack_Y);
+      for (int ic = 0; ic < m; ic += GEMM_MC) {
+        int mc = std::min(GEMM_MC, m - ic);
+        GemmPackX(transX, X, ldX, ic, mc, pc, kc, pack_X);
+        for (int jr = 0; jr < nc; jr += GEMM_NR) {
+          for (int ir = 0; ir < mc; ir += GEMM_MR) {
+            GemmMicroKernel(kc, pack_X + (size_t)ir * kc,
+                            pack_Y + (size_t)jr * kc, alpha,
+                            Z + (size_t)(ic + ir) * ldZ + jc + jr, ldZ,
+                            std::min(GEMM_MR, mc - ir),
+                            std::min(GEMM_NR, nc - jr));
+          }
+        }
+      }
+    }
+  }
+#endif
+}
+
 /************************************************************************/
 /* Conv */
 /************************************************************************/
@@ -570,7 +714,12 @@ struct ConvAux {
 
 template <typename T>
 struct ConvMutableAux {
-  Tensor<T> buf;
+  // im2col buffers of chunks
+  std::vector<Tensor<T>> buf;
+  // gK buffers of chunks except the first one
+  std::vector<Tensor<T>> gK_buf;
+  // gemm packing buffers of chunks
+  std::vector<GemmPack<T>> pack;
 };
 
 bool ConvCheckAttr(int conv_rank, int data_format,
@@ -809,47 +958,80 @@ bool ConvInferShape(const Shape& X, const Shape& K, int conv_rank,
   return true;
 }
 
+// Buffers are kept across batches,
+// resizing them to unchanged sizes doesn't reallocate.
 template <typename T>
-void ConvPrepare(const ConvAux& aux, ConvMutableAux<T>* maux) {
+void ConvPrepareChunk(const ConvAux& aux, int chunk, ConvMutableAux<T>* maux) {
+  if ((int)maux->pack.size() < chunk) {
+    maux->pack.resize(chunk);
+  }
+  for (int i = 0; i < chunk; ++i) {
+    GemmPrepare(&maux->pack[i]);
+  }
   if (aux.im2col) {
-    maux->buf.resize(aux.im2col_aux.in_channel * aux.K_spatial_total_dim *
-                     aux.Z_spatial_total_dim);
+    if ((int)maux->buf.size() < chunk) {
+      maux->buf.resize(chunk);
+    }
+    for (int i = 0; i < chunk; ++i) {
+      maux->buf[i].resize(aux.im2col_aux.in_channel *
+                          aux.K_spatial_total_dim * aux.Z_spatial_total_dim);
+    }
+  }
+}
+
+template <typename T>
+void ConvPrepareGKChunk(const Tensor<T>& K, int chunk,
+                        ConvMutableAux<T>* maux) {
+  while ((int)maux->gK_buf.size() < chunk - 1) {
+    maux->gK_buf.emplace_back();
+  }
+  for (int i = 0; i < chunk - 1; ++i) {
+    maux->gK_buf[i].resize(K.shape());
+    maux->gK_buf[i].zeros();
   }
 }
 
 template <typename T>
 void Conv(const Tensor<T>& X, const Tensor<T>& K, Tensor<T>* Z,
           const ConvAux& aux, ConvMutableAux<T>* maux) noexcept {
-  int batch = aux.batch;
   int m = aux.m, n = aux.n, k = aux.k;
-  const T* _X = X.data();
-  const T* _K = K.data();
-  T* _Z = Z->data();
+  int grain = GetIntraOpGrain(m * n * k);
+  ConvPrepareChunk(aux, GetIntraOpChunk(aux.batch, grain), maux);
+
+  // batch is split into chunks
+  IntraOpParallelFor(aux.batch, grain, [&X, &K, Z, &aux, maux, m, n, k](
+                                           int chunk, int batch_begin,
+                                           int batch_end) {
+    GemmPack<T>* _pack = &maux->pack[chunk];
+    const T* _X = X.data() + batch_begin * aux.X_batch_stride;
+    const T* _K = K.data();
+    T* _Z = Z->data() + batch_begin * m * n;
 
-  if (aux.im2col) {
-    T* _buf = maux->buf.data();
-    for (int i = 0; i < batch; ++i) {
-      if (aux.ncx) {
-        Im2colNCX(_X, _buf, aux.im2col_aux);
-        LLMath<T>::gemm(0, 0, m, n, k, 1, _K, _buf, 0, _Z);
-      } else {
-        Im2colNXC(_X, _buf, aux.im2col_aux);
-        LLMath<T>::gemm(0, 0, m, n, k, 1, _buf, _K, 0, _Z);
+    if (aux.im2col) {
+      T* _buf = maux->buf[chunk].data();
+      for (int i = batch_begin; i < batch_end; ++i) {
+        if (aux.ncx) {
+          Im2colNCX(_X, _buf, aux.im2col_aux);
+          Gemm<T>(0, 0, m, n, k, 1, _K, _buf, 0, _Z, _pack);
+        } else {
+          Im2colNXC(_X, _buf, aux.im2col_aux);
+          Gemm<T>(0, 0, m, n, k, 1, _buf, _K, 0, _Z, _pack);
+        }
+        _X += aux.X_batch_stride;
+        _Z += m * n;
       }
-      _X += aux.X_batch_stride;
-      _Z += m * n;
-    }
-  } else {
-    for (int i = 0; i < batch; ++i) {
-      if (aux.ncx) {
-        LLMath<T>::gemm(0, 0, m, n, k, 1, _K, _X, 0, _Z);
-      } else {
-        LLMath<T>::gemm(0, 0, m, n, k, 1, _X, _K, 0, _Z);
+    } else {
+      for (int i = batch_begin; i < batch_end; ++i) {
+        if (aux.ncx) {
+          Gemm<T>(0, 0, m, n, k, 1, _K, _X, 0, _Z, _pack);
+        } else {
+          Gemm<T>(0, 0, m, n, k, 1, _X, _K, 0, _Z, _pack);
+        }
+        _X += aux.X_batch_stride;
+        _Z += m * n;
       }
-      _X += aux.X_batch_stride;
-      _Z += m * n;
     }
-  }
+  });
 }
 
 template <typename T>
@@ -857,66 +1039,88 @@ void ConvBackward(const Tensor<T>& X, const Tensor<T>& K,
                   const Tensor<T>& /*Z*/, const Tensor<T>& gZ, Tensor<T>* gX,
                   Tensor<T>* gK, const ConvAux& aux,
                   ConvMutableAux<T>* maux) noexcept {
-  int batch = aux.batch;
   int m = aux.m, n = aux.n, k = aux.k;
-  const T* _X = X.data();
-  const T* _K = K.data();
-  T* _gX = gX ? gX->data() : nullptr;
-  T* _gK = gK ? gK->data() : nullptr;
-
-  if (_gX) {
-    const T* _gZ = gZ.data();
-    if (aux.im2col) {
-      T* _buf = maux->buf.data();
-      for (int i = 0; i < batch; ++i) {
-        if (aux.ncx) {
-          LLMath<T>::gemm(1, 0, k, n, m, 1, _K, _gZ, 0, _buf);
-          Col2imNCX(_buf, _gX, aux.im2col_aux);
-        } else {
-          LLMath<T>::gemm(0, 1, m, k, n, 1, _gZ, _K, 0, _buf);
-          Col2imNXC(_buf, _gX, aux.im2col_aux);
+  int grain = GetIntraOpGrain(m * n * k);
+  int chunk = GetIntraOpChunk(aux.batch, grain);
+  ConvPrepareChunk(aux, chunk, maux);
+
+  if (gX) {
+    // batch is split into chunks
+    IntraOpParallelFor(aux.batch, grain, [&K, &gZ, gX, &aux, maux, m, n, k](
+                                             int chunk, int batch_begin,
+                                             int batch_end) {
+      GemmPack<T>* _pack = &maux->pack[chunk];
+      const T* _K = K.data();
+      const T* _gZ = gZ.data() + batch_begin * m * n;
+      T* _gX = gX->data() + batch_begin * aux.X_batch_stride;
+
+      if (aux.im2col) {
+        T* _buf = maux->buf[chunk].data();
+        for (int i = batch_begin; i < batch_end; ++i) {
+          if (aux.ncx) {
+            Gemm<T>(1, 0, k, n, m, 1, _K, _gZ, 0, _buf, _pack);
+            Col2imNCX(_buf, _gX, aux.im2col_aux);
+          } else {
+            Gemm<T>(0, 1, m, k, n, 1, _gZ, _K, 0, _buf, _pack);
+            Col2imNXC(_buf, _gX, aux.im2col_aux);
+          }
+          _gX += aux.X_batch_stride;
+          _gZ += m * n;
         }
-        _gX += aux.X_batch_stride;
-        _gZ += m * n;
-      }
-    } else {
-      for (int i = 0; i < batch; ++i) {
-        if (aux.ncx) {
-          LLMath<T>::gemm(1, 0, k, n, m, 1, _K, _gZ, 1, _gX);
-        } else {
-          LLMath<T>::gemm(0, 1, m, k, n, 1, _gZ, _K, 1, _gX);
+      } else {
+        for (int i = batch_begin; i < batch_end; ++i) {
+          if (aux.ncx) {
+            Gemm<T>(1, 0, k, n, m, 1, _K, _gZ, 1, _gX, _pack);
+          } else {
+            Gemm<T>(0, 1, m, k, n, 1, _gZ, _K, 1, _gX, _pack);
+          }
+          _gX += aux.X_batch_stride;
+          _gZ += m * n;
         }
-        _gX += aux.X_batch_stride;
-        _gZ += m * n;
       }
-    }
+    });
   }
 
-  if (_gK) {
-    const T* _gZ = gZ.data();
-    if (aux.im2col) {
-      T* _buf = maux->buf.data();
-      for (int i = 0; i < batch; ++i) {
-        if (aux.ncx) {
-          Im2colNCX(_X, _buf, aux.im2col_aux);
-          LLMath<T>::gemm(0, 1, m, k, n, 1, _gZ, _buf, 1, _gK);
-        } else {
-          Im2colNXC(_X, _buf, aux.im2col_aux);
-          LLMath<T>::gemm(1, 0, k, n, m, 1, _buf, _gZ, 1, _gK);
+  if (gK) {
+    // Batch is split into chunks,
+    // each chunk except the first one accumulates gK in its own buffer.
+    ConvPrepareGKChunk(K, chunk, maux);
+    IntraOpParallelFor(aux.batch, grain, [&X, &gZ, gK, &aux, maux, m, n, k](
+                                             int chunk, int batch_begin,
+                                             int batch_end) {
+      GemmPack<T>* _pack = &maux->pack[chunk];
+      const T* _X = X.data() + batch_begin * aux.X_batch_stride;
+      const T* _gZ = gZ.data() + batch_begin * m * n;
+      T* _gK = chunk == 0 ? gK->data() : maux->gK_buf[chunk - 1].data();
+
+      if (aux.im2col) {
+        T* _buf = maux->buf[chunk].data();
+        for (int i = batch_begin; i < batch_end; ++i) {
+          if (aux.ncx) {
+            Im2colNCX(_X, _buf, aux.im2col_aux);
+            Gemm<T>(0, 1, m, k, n, 1, _gZ, _buf, 1, _gK, _pack);
+          } else {
+            Im2colNXC(_X, _buf, aux.im2col_aux);
+            Gemm<T>(1, 0, k, n, m, 1, _buf, _gZ, 1, _gK, _pack);
+          }
+          _X += aux.X_batch_stride;
+          _gZ += m * n;
         }
-        _X += aux.X_batch_stride;
-        _gZ += m * n;
-      }
-    } else {
-      for (int i = 0; i < batch; ++i) {
-        if (aux.ncx) {
-          LLMath<T>::gemm(0, 1, m, k, n, 1, _gZ, _X, 1, _gK);
-        } else {
-          LLMath<T>::gemm(1, 0, k, n, m, 1, _X, _gZ, 1, _gK);
+      } else {
+        for (int i = batch_begin; i < batch_end; ++i) {
+          if (aux.ncx) {
+            Gemm<T>(0, 1, m, k, n, 1, _gZ, _X, 1, _gK, _pack);
+          } else {
+            Gemm<T>(1, 0, k, n, m, 1, _X, _gZ, 1, _gK, _pack);
+          }
+          _X += aux.X_batch_stride;
+          _gZ += m * n;
         }
-        _X += aux.X_batch_stride;
-        _gZ += m * n;
       }
+    });
+    for (int i = 0; i < chunk - 1; ++i) {
+      LLMath<T>::add(gK->total_dim(), maux->gK_buf[i].data(), gK->data(),
+                     gK->data());
     }
   }
 }
@@ -971,11 +1175,6 @@ class OpConvBase : public OpBinaryBase {
     return aux_.Z;
   }
 
-  void InitForward() override {
-    OpBinaryBase::InitForward();
-    ConvPrepare(aux_, &maux_);
-  }
-
   void Forward() override { Conv(*X_, *Y_, Z_, aux_, &maux_); }
 
   void Backward() override {
@@ -348,6 +348,74 @@ TEST_F(ConvBackwardTest, Conv2d) {
   Test(CONV2D_TEST_CASES, GraphNodeConvBase::PADDING_MODE_USE_PADDINGS);
 }
 
+TEST_F(ConvBackwardTest, Conv2d_intra_op) {
+  // large enough to be split into chunks
+  const std::vector<TestCase> test_cases = {
+      {2,
+       Shape(16, 2, 8, 8),
+       Shape(4, 2, 3, 3),
+       GraphNodeConvBase::DATA_FORMAT_NCHW,
+       {1, 1},
+       {1, 1},
+       {1, 1}},
+      {2,
+       Shape(16, 8, 8, 2),
+       Shape(3, 3, 2, 4),
+       GraphNodeConvBase::DATA_FORMAT_NHWC,
+       {1, 1},
+       {1, 1},
+       {1, 1}}};
+  Test(test_cases, GraphNodeConvBase::PADDING_MODE_SAME);
+}
+
+TEST_F(ConvBackwardTest, Conv1d_gemm_block) {
+  // large enough to cross gemm blocks
+  const std::vector<TestCase> test_cases = {
+      {1,
+       Shape(2, 86, 5),
+       Shape(2, 86, 3),
+       GraphNodeConvBase::DATA_FORMAT_NCW,
+       {1},
+       {1},
+       {1}},
+      {1,
+       Shape(2, 5, 86),
+       Shape(3, 86, 2),
+       GraphNodeConvBase::DATA_FORMAT_NWC,
+       {1},
+       {1},
+       {1}},
+      {1,
+       Shape(2, 2, 5),
+       Shape(73, 2, 1),
+       GraphNodeConvBase::DATA_FORMAT_NCW,
+       {1},
+       {1},
+       {0}},
+      {1,
+       Shape(2, 5, 2),
+       Shape(1, 2, 73),
+       GraphNodeConvBase::DATA_FORMAT_NWC,
+       {1},
+       {1},
+       {0}},
+      {1,
+       Shape(1, 1, 1025),
+       Shape(1, 1, 1),
+       GraphNodeConvBase::DATA_FORMAT_NCW,
+       {1},
+       {1},
+       {0}},
+      {1,
+       Shape(1, 1025, 1),
+       Shape(1, 1, 1),
+       GraphNodeConvBase::DATA_FORMAT_NWC,
+       {1},
+       {1},
+       {0}}};
+  Test(test_cases, GraphNodeConvBase::PADDING_MODE_SAME);
+}
+
 TEST_F(ConvBackwardTest, Conv3d) {
   Test(CONV3D_TEST_CASES, GraphNodeConvBase::PADDING_MODE_SAME);
   Test(CONV3D_TEST_CASES, GraphNodeConvBase::PADDING_MODE_VALID);
@@ -2,6 +2,7 @@
 // Author: Yafei Zhang (kimmyzhang@tencent.com)
 //
 
+#include <deepx_core/common/intra_op_thread.h>
 #include <deepx_core/graph/op_impl.h>
 
 namespace deepx_core {
@@ -29,17 +30,23 @@ void BatchFMInteraction(const Tensor<T>& X, Tensor<T>* Z) noexcept {
   int batch = X.dim(0);
   int m = X.dim(1);
   int n = X.dim(2);
-  const T* _X = X.data();
-  T* _Z = Z->data();
-  for (int i = 0; i < batch; ++i) {
-    for (int j = 0; j < m; ++j) {
-      for (int k = j + 1; k < m; ++k) {
-        LLMath<T>::mul(n, _X + j * n, _X + k * n, _Z);
-        _Z += n;
-      }
-    }
-    _X += m * n;
-  }
+  int mm = m * (m - 1) / 2;
+  // batch is split into chunks
+  IntraOpParallelFor(
+      batch, GetIntraOpGrain(mm * n),
+      [&X, Z, m, n, mm](int, int batch_begin, int batch_end) {
+        const T* _X = X.data() + batch_begin * m * n;
+        T* _Z = Z->data() + batch_begin * mm * n;
+        for (int i = batch_begin; i < batch_end; ++i) {
+          for (int j = 0; j < m; ++j) {
+            for (int k = j + 1; k < m; ++k) {
+              LLMath<T>::mul(n, _X + j * n, _X + k * n, _Z);
+              _Z += n;
+            }
+          }
+          _X += m * n;
+        }
+      });
 }
 
 template <typename T>
@@ -48,20 +55,26 @@ void BatchFMInteractionBackward(const Tensor<T>& X, const Tensor<T>& /*Z*/,
   int batch = X.dim(0);
   int m = X.dim(1);
   int n = X.dim(2);
-  const T* _X = X.data();
-  const T* _gZ = gZ.data();
-  T* _gX = gX->data();
-  for (int i = 0; i < batch; ++i) {
-    for (int j = 0; j < m; ++j) {
-      for (int k = j + 1; k < m; ++k) {
-        LLMath<T>::xypz(n, _gZ, _X + k * n, _gX + j * n);
-        LLMath<T>::xypz(n, _gZ, _X + j * n, _gX + k * n);
-        _gZ += n;
-      }
-    }
-    _X += m * n;
-    _gX += m * n;
-  }
+  int mm = m * (m - 1) / 2;
+  // batch is split into chunks
+  IntraOpParallelFor(
+      batch, GetIntraOpGrain(2 * mm * n),
+      [&X, &gZ, gX, m, n, mm](int, int batch_begin, int batch_end) {
+        const T* _X = X.data() + batch_begin * m * n;
+        const T* _gZ = gZ.data() + batch_begin * mm * n;
+        T* _gX = gX->data() + batch_begin * m * n;
+        for (int i = batch_begin; i < batch_end; ++i) {
+          for (int j = 0; j < m; ++j) {
+            for (int k = j + 1; k < m; ++k) {
+              LLMath<T>::xypz(n, _gZ, _X + k * n, _gX + j * n);
+              LLMath<T>::xypz(n, _gZ, _X + j * n, _gX + k * n);
+              _gZ += n;
+            }
+          }
+          _X += m * n;
+          _gX += m * n;
+        }
+      });
 }
 
 }  // namespace
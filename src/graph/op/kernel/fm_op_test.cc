@@ -32,6 +32,13 @@ TEST_F(BatchFMInteractionBackwardTest, BatchFMInteraction) {
   CheckOpBackward(&Z, 0);
 }
 
+TEST_F(BatchFMInteractionBackwardTest, BatchFMInteraction_intra_op) {
+  // large enough to be split into chunks
+  VariableNode X("X", Shape(40, 16, 8), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  BatchFMInteractionNode Z("Z", &X);
+  CheckOpBackward(&Z, 0);
+}
+
 /************************************************************************/
 /* BatchFMInteraction2 */
 /************************************************************************/
@@ -2,6 +2,7 @@
 // Author: Yafei Zhang (kimmyzhang@tencent.com)
 //
 
+#include <deepx_core/common/intra_op_thread.h>
 #include <deepx_core/graph/op_impl.h>
 #if HAVE_SAGE2_SGEMM_JIT == 1 && HAVE_FLOAT64 == 0
 #include <sage2/sgemm.h>
@@ -45,6 +46,153 @@ bool FullyConnectInferShape(const Shape& X, const Shape& W, const Shape& b,
   return true;
 }
 
+template <typename T>
+void FusedActivation(int activation, int n, T* z) noexcept {
+  switch (activation) {
+    case FusedFullyConnectNode::ACTIVATION_RELU:
+      for (int i = 0; i < n; ++i) {
+        if (z[i] < 0) {
+          z[i] = 0;
+        }
+      }
+      break;
+    case FusedFullyConnectNode::ACTIVATION_SIGMOID:
+      LLMath<T>::sigmoid(n, z, z);
+      break;
+    case FusedFullyConnectNode::ACTIVATION_TANH:
+      LLMath<T>::tanh(n, z, z);
+      break;
+  }
+}
+
+// Compute gH = gZ * activation'(H), H is the input of the activation.
+template <typename T>
+void FusedActivationBackward(int activation, int n, const T* z, const T* gz,
+                             T* gh) noexcept {
+  switch (activation) {
+    case FusedFullyConnectNode::ACTIVATION_RELU:
+      for (int i = 0; i < n; ++i) {
+        gh[i] = (z[i] > 0) ? gz[i] : 0;
+      }
+      break;
+    case FusedFullyConnectNode::ACTIVATION_SIGMOID:
+      for (int i = 0; i < n; ++i) {
+        gh[i] = z[i] * (1 - z[i]) * gz[i];
+      }
+      break;
+    case FusedFullyConnectNode::ACTIVATION_TANH:
+      for (int i = 0; i < n; ++i) {
+        gh[i] = (1 - z[i] * z[i]) * gz[i];
+      }
+      break;
+  }
+}
+
+template <typename T>
+void FullyConnect(const Tensor<T>& X, const Tensor<T>& W, const Tensor<T>* b,
+                  int activation, Tensor<T>* Z) noexcept {
+  int m = X.dim(0);
+  int n = W.dim(1);
+  int k = X.dim(1);
+  const T* _X = X.data();
+  const T* _W = W.data();
+  const T* _b = b ? b->data() : nullptr;
+  T* _Z = Z->data();
+  // rows of X and Z are split into chunks,
+  // bias and activation are applied to a chunk while it is in cache
+  IntraOpParallelFor(m, GetIntraOpGrain(n * k),
+                     [_X, _W, _b, _Z, n, k, activation](int, int row_begin,
+                                                         int row_end) {
+                       int rows = row_end - row_begin;
+                       T* Zi = _Z + row_begin * n;
+                       LLMath<T>::gemm(0, 0, rows, n, k, _X + row_begin * k,
+                                       _W, Zi);
+                       if (_b) {
+                         LLMath<T>::add_row(rows, n, 1, Zi, 1, _b, Zi);
+                       }
+                       FusedActivation(activation, rows * n, Zi);
+                     });
+}
+
+// Predict only, values of W are dequantized on the fly.
+template <typename T>
+void QuantizedFullyConnect(const Tensor<T>& X, const QuantizedTensor<T>& W,
+                           const Tensor<T>* b, int activation,
+                           Tensor<T>* Z) noexcept {
+  int m = X.dim(0);
+  int n = W.dim(1);
+  int k = X.dim(1);
+  const QuantizedTensor<T>* _W = &W;
+  const T* _X = X.data();
+  const T* _b = b ? b->data() : nullptr;
+  T* _Z = Z->data();
+  IntraOpParallelFor(m, GetIntraOpGrain(n * k),
+                     [_X, _W, _b, _Z, n, k, activation](int, int row_begin,
+                                                         int row_end) {
+                       int rows = row_end - row_begin;
+                       T* Zi = _Z + row_begin * n;
+                       _W->gemm(rows, _X + row_begin * k, Zi);
+                       if (_b) {
+                         LLMath<T>::add_row(rows, n, 1, Zi, 1, _b, Zi);
+                       }
+                       FusedActivation(activation, rows * n, Zi);
+                     });
+}
+
+template <typename T>
+void FusedActivationBackward(int activation, const Tensor<T>& Z,
+                             const Tensor<T>& gZ, Tensor<T>* gH) noexcept {
+  int m = Z.dim(0);
+  int n = Z.dim(1);
+  const T* _Z = Z.data();
+  const T* _gZ = gZ.data();
+  T* _gH = gH->data();
+  IntraOpParallelFor(m, GetIntraOpGrain(n),
+                     [_Z, _gZ, _gH, n, activation](int, int row_begin,
+                                                    int row_end) {
+                       int offset = row_begin * n;
+                       FusedActivationBackward(
+                           activation, (row_end - row_begin) * n,
+                           _Z + offset, _gZ + offset, _gH + offset);
+                     });
+}
+
+template <typename T>
+void FullyConnectBackward(const Tensor<T>& X, const Tensor<T>& W,
+                          const Tensor<T>& gZ, Tensor<T>* gX, Tensor<T>* gW,
+                          Tensor<T>* gb) noexcept {
+  int m = X.dim(0);
+  int n = W.dim(1);
+  int k = X.dim(1);
+  const T* _X = X.data();
+  const T* _W = W.data();
+  const T* _gZ = gZ.data();
+  if (gX) {
+    // rows of gZ and gX are split into chunks
+    T* _gX = gX->data();
+    IntraOpParallelFor(m, GetIntraOpGrain(n * k),
+                       [_W, _gZ, _gX, n, k](int, int row_begin, int row_end) {
+                         LLMath<T>::gemm(0, 1, row_end - row_begin, k, n, 1,
+                                         _gZ + row_begin * n, _W, 1,
+                                         _gX + row_begin * k);
+                       });
+  }
+  if (gW) {
+    // rows of gW(cols of X) are split into chunks
+    T* _gW = gW->data();
+    IntraOpParallelFor(k, GetIntraOpGrain(m * n),
+                       [_X, _gZ, _gW, m, n, k](int, int row_begin,
+                                               int row_end) {
+                         LLMath<T>::gemm(1, 0, row_end - row_begin, n, m, 1,
+                                         _X + row_begin, k, _gZ, n, 1,
+                                         _gW + row_begin * n, n);
+                       });
+  }
+  if (gb) {
+    LLTensor<T>::sum_row(1, gZ, 1, gb);
+  }
+}
+
 }  // namespace
 
 FullyConnectNode::FullyConnectNode(std::string name, GraphNode* X, GraphNode* W)
@@ -79,6 +227,7 @@ class FullyConnectOp : public OpImpl {
  protected:
   const tsr_t* X_ = nullptr;
   const tsr_t* W_ = nullptr;
+  const qtsr_t* qW_ = nullptr;
   const tsr_t* b_ = nullptr;
   Shape Zshape_;
   tsr_t* Z_ = nullptr;
@@ -116,19 +265,21 @@ class FullyConnectOp : public OpImpl {
 
   void InitForward() override {
     X_ = GetPtrTSR(node_->input(0));
-    W_ = GetPtrTSR(node_->input(1));
+    qW_ = GetPtrQTSR(node_->input(1));
+    W_ = qW_ ? nullptr : GetPtrTSR(node_->input(1));
+    const Shape& Wshape = qW_ ? qW_->shape() : W_->shape();
     if (node_->input_size() == 2) {
       b_ = nullptr;
-      DXCHECK_THROW(FullyConnectInferShape(X_->shape(), W_->shape(), &Zshape_));
+      DXCHECK_THROW(FullyConnectInferShape(X_->shape(), Wshape, &Zshape_));
     } else {
       b_ = GetPtrTSR(node_->input(2));
-      DXCHECK_THROW(FullyConnectInferShape(X_->shape(), W_->shape(),
-                                           b_->shape(), &Zshape_));
+      DXCHECK_THROW(
+          FullyConnectInferShape(X_->shape(), Wshape, b_->shape(), &Zshape_));
     }
     Z_ = InitHiddenTSR(node_, Zshape_);
 #if HAVE_SAGE2_SGEMM_JIT == 1 && HAVE_FLOAT64 == 0
     m_ = X_->shape()[0];
-    n_ = W_->shape()[1];
+    n_ = Wshape[1];
     k_ = X_->shape()[1];
     if (forward_jit_) {
       sage2_sgemm_jit_uninit(forward_jit_);
@@ -142,6 +293,7 @@ class FullyConnectOp : public OpImpl {
   }
 
   void InitBackward() override {
+    DXCHECK_THROW(qW_ == nullptr);
     gZ_ = GetGradPtrTSR(node_);
     gX_ = InitGradTSR(node_->input(0), X_->shape());
     gW_ = InitGradTSR(node_->input(1), W_->shape());
@@ -175,38 +327,149 @@ class FullyConnectOp : public OpImpl {
   }
 
   void Forward() override {
+    if (qW_) {
+      QuantizedFullyConnect(*X_, *qW_, b_,
+                            FusedFullyConnectNode::ACTIVATION_NONE, Z_);
+      return;
+    }
 #if HAVE_SAGE2_SGEMM_JIT == 1 && HAVE_FLOAT64 == 0
-    forward_(forward_jit_, X_->data(), W_->data(), Z_->data());
-#else
-    ll_tensor_t::gemm(0, 0, *X_, *W_, Z_);
-#endif
-    if (b_) {
-      ll_tensor_t::add_row(1, *Z_, 1, *b_, Z_);
+    if (GetIntraOpThread() == 1) {
+      forward_(forward_jit_, X_->data(), W_->data(), Z_->data());
+      if (b_) {
+        ll_tensor_t::add_row(1, *Z_, 1, *b_, Z_);
+      }
+      return;
     }
+#endif
+    FullyConnect(*X_, *W_, b_, FusedFullyConnectNode::ACTIVATION_NONE, Z_);
   }
 
   void Backward() override {
 #if HAVE_SAGE2_SGEMM_JIT == 1 && HAVE_FLOAT64 == 0
-    if (gX_) {
-      backward_gX_(backward_gX_jit_, gZ_->data(), W_->data(), gX_->data());
+    if (GetIntraOpThread() == 1) {
+      if (gX_) {
+        backward_gX_(backward_gX_jit_, gZ_->data(), W_->data(), gX_->data());
+      }
+      if (gW_) {
+        backward_gW_(backward_gW_jit_, X_->data(), gZ_->data(), gW_->data());
+      }
+      if (gb_) {
+        ll_tensor_t::sum_row(1, *gZ_, 1, gb_);
+      }
+      return;
     }
-    if (gW_) {
-      backward_gW_(backward_gW_jit_, X_->data(), gZ_->data(), gW_->data());
+#endif
+    FullyConnectBackward(*X_, *W_, *gZ_, gX_, gW_, gb_);
+  }
+};
+
+GRAPH_NODE_OP_REGISTER(FullyConnect);
+
+/************************************************************************/
+/* FusedFullyConnect */
+/************************************************************************/
+FusedFullyConnectNode::FusedFullyConnectNode(std::string name, GraphNode* X,
+                                             GraphNode* W, int activation)
+    : GraphNode(std::move(name)), activation_(activation) {
+  DXCHECK_THROW(X->tensor_type() == TENSOR_TYPE_TSR);
+  DXCHECK_THROW(W->tensor_type() == TENSOR_TYPE_TSR);
+  DXCHECK_THROW(activation_ >= ACTIVATION_NONE &&
+                activation_ <= ACTIVATION_TANH);
+  input_ = {X, W};
+  node_type_ = GRAPH_NODE_TYPE_HIDDEN;
+  tensor_type_ = TENSOR_TYPE_TSR;
+
+  if (!X->shape().empty() && !W->shape().empty()) {
+    (void)FullyConnectInferShape(X->shape(), W->shape(), &shape_);
+  }
+}
+
+FusedFullyConnectNode::FusedFullyConnectNode(std::string name, GraphNode* X,
+                                             GraphNode* W, GraphNode* b,
+                                             int activation)
+    : GraphNode(std::move(name)), activation_(activation) {
+  DXCHECK_THROW(X->tensor_type() == TENSOR_TYPE_TSR);
+  DXCHECK_THROW(W->tensor_type() == TENSOR_TYPE_TSR);
+  DXCHECK_THROW(b->tensor_type() == TENSOR_TYPE_TSR);
+  DXCHECK_THROW(activation_ >= ACTIVATION_NONE &&
+                activation_ <= ACTIVATION_TANH);
+  input_ = {X, W, b};
+  node_type_ = GRAPH_NODE_TYPE_HIDDEN;
+  tensor_type_ = TENSOR_TYPE_TSR;
+
+  if (!X->shape().empty() && !W->shape().empty() && !b->shape().empty()) {
+    (void)FullyConnectInferShape(X->shape(), W->shape(), b->shape(), &shape_);
+  }
+}
+
+class FusedFullyConnectOp : public OpImpl {
+ private:
+  int activation_ = 0;
+  const tsr_t* X_ = nullptr;
+  const tsr_t* W_ = nullptr;
+  const qtsr_t* qW_ = nullptr;
+  const tsr_t* b_ = nullptr;
+  Shape Zshape_;
+  tsr_t* Z_ = nullptr;
+  tsr_t* gZ_ = nullptr;
+  tsr_t* gX_ = nullptr;
+  tsr_t* gW_ = nullptr;
+  tsr_t* gb_ = nullptr;
+  tsr_t gH_;
+
+ public:
+  DEFINE_OP_LIKE(FusedFullyConnectOp);
+
+  void InitForward() override {
+    activation_ = ((const FusedFullyConnectNode*)node_)->activation();
+    X_ = GetPtrTSR(node_->input(0));
+    qW_ = GetPtrQTSR(node_->input(1));
+    W_ = qW_ ? nullptr : GetPtrTSR(node_->input(1));
+    const Shape& Wshape = qW_ ? qW_->shape() : W_->shape();
+    if (node_->input_size() == 2) {
+      b_ = nullptr;
+      DXCHECK_THROW(FullyConnectInferShape(X_->shape(), Wshape, &Zshape_));
+    } else {
+      b_ = GetPtrTSR(node_->input(2));
+      DXCHECK_THROW(
+          FullyConnectInferShape(X_->shape(), Wshape, b_->shape(), &Zshape_));
     }
-#else
-    if (gX_) {
-      ll_tensor_t::gemm(0, 1, 1, *gZ_, *W_, 1, gX_);
+    Z_ = InitHiddenTSR(node_, Zshape_);
+  }
+
+  void InitBackward() override {
+    DXCHECK_THROW(qW_ == nullptr);
+    gZ_ = GetGradPtrTSR(node_);
+    gX_ = InitGradTSR(node_->input(0), X_->shape());
+    gW_ = InitGradTSR(node_->input(1), W_->shape());
+    if (b_) {
+      gb_ = InitGradTSR(node_->input(2), b_->shape());
+    } else {
+      gb_ = nullptr;
     }
-    if (gW_) {
-      ll_tensor_t::gemm(1, 0, 1, *X_, *gZ_, 1, gW_);
+    if (activation_ != FusedFullyConnectNode::ACTIVATION_NONE) {
+      gH_.resize(Zshape_);
     }
-#endif
-    if (gb_) {
-      ll_tensor_t::sum_row(1, *gZ_, 1, gb_);
+  }
+
+  void Forward() override {
+    if (qW_) {
+      QuantizedFullyConnect(*X_, *qW_, b_, activation_, Z_);
+    } else {
+      FullyConnect(*X_, *W_, b_, activation_, Z_);
+    }
+  }
+
+  void Backward() override {
+    if (activation_ == FusedFullyConnectNode::ACTIVATION_NONE) {
+      FullyConnectBackward(*X_, *W_, *gZ_, gX_, gW_, gb_);
+    } else {
+      FusedActivationBackward(activation_, *Z_, *gZ_, &gH_);
+      FullyConnectBackward(*X_, *W_, gH_, gX_, gW_, gb_);
     }
   }
 };
 
-GRAPH_NODE_OP_REGISTER(FullyConnect);
+GRAPH_NODE_OP_REGISTER(FusedFullyConnect);
 
 }  // namespace deepx_core
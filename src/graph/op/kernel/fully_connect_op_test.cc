@@ -23,4 +23,51 @@ TEST_F(FullyConnectBackwardTest, FullyConnect_b) {
   CheckOpBackward(&Z, 0);
 }
 
+TEST_F(FullyConnectBackwardTest, FullyConnect_b_intra_op) {
+  // large enough to be split into chunks
+  VariableNode X("X", Shape(96, 32), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  VariableNode W("W", Shape(32, 32), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  VariableNode b("b", Shape(1, 32), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  FullyConnectNode Z("Y", &X, &W, &b);
+  CheckOpBackward(&Z, 0);
+}
+
+class FusedFullyConnectBackwardTest : public testing::Test {
+ protected:
+  const std::vector<int> ACTIVATIONS = {
+      FusedFullyConnectNode::ACTIVATION_NONE,
+      FusedFullyConnectNode::ACTIVATION_RELU,
+      FusedFullyConnectNode::ACTIVATION_SIGMOID,
+      FusedFullyConnectNode::ACTIVATION_TANH};
+};
+
+TEST_F(FusedFullyConnectBackwardTest, FusedFullyConnect) {
+  for (int activation : ACTIVATIONS) {
+    VariableNode X("X", Shape(2, 3), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+    VariableNode W("W", Shape(3, 4), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+    FusedFullyConnectNode Z("Y", &X, &W, activation);
+    CheckOpBackward(&Z, 0);
+  }
+}
+
+TEST_F(FusedFullyConnectBackwardTest, FusedFullyConnect_b) {
+  for (int activation : ACTIVATIONS) {
+    VariableNode X("X", Shape(2, 3), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+    VariableNode W("W", Shape(3, 4), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+    VariableNode b("b", Shape(1, 4), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+    FusedFullyConnectNode Z("Y", &X, &W, &b, activation);
+    CheckOpBackward(&Z, 0);
+  }
+}
+
+TEST_F(FusedFullyConnectBackwardTest, FusedFullyConnect_b_intra_op) {
+  // large enough to be split into chunks
+  VariableNode X("X", Shape(96, 32), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  VariableNode W("W", Shape(32, 32), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  VariableNode b("b", Shape(1, 32), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  FusedFullyConnectNode Z("Y", &X, &W, &b,
+                          FusedFullyConnectNode::ACTIVATION_TANH);
+  CheckOpBackward(&Z, 0);
+}
+
 }  // namespace deepx_core
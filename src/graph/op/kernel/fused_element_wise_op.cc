@@ -0,0 +1,441 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/graph/op_impl.h>
+
+namespace deepx_core {
+namespace {
+
+// # of elements of a row processed at a time,
+// intermediate results of a block stay in cache.
+constexpr int FUSED_BLOCK_SIZE = 256;
+
+bool FusedElementWiseInferShape(const std::vector<const Shape*>& X,
+                                const std::vector<int>& ops,
+                                const std::vector<int>& operands,
+                                Shape* Z) noexcept {
+  const Shape& X0 = *X[0];
+  if (X0.empty()) {
+    DXERROR("Invalid X: X[0] is empty.");
+    return false;
+  }
+
+  for (size_t i = 0; i < ops.size(); ++i) {
+    if (FusedElementWiseNode::IsBinaryOp(ops[i])) {
+      const Shape& Y = *X[operands[i]];
+      if (!FusedElementWiseNode::IsBroadcastable(X0, Y)) {
+        DXERROR("Invalid X: %s can't be broadcast to %s.",
+                to_string(Y).c_str(), to_string(X0).c_str());
+        return false;
+      }
+    }
+  }
+
+  *Z = X0;
+  return true;
+}
+
+// Y is indexed by 'row * row_stride + col * col_stride',
+// when Z is viewed as a matrix of (total_dim / last dim, last dim).
+void GetBroadcastStride(const Shape& Z, const Shape& Y, int* row_stride,
+                        int* col_stride) noexcept {
+  if (Y == Z) {
+    *row_stride = Z[Z.rank() - 1];
+    *col_stride = 1;
+  } else if (Y.total_dim() == 1) {
+    *row_stride = 0;
+    *col_stride = 0;
+  } else {
+    *row_stride = 0;
+    *col_stride = 1;
+  }
+}
+
+template <typename T>
+void FusedUnary(int op, int n, const T* x, T* z) noexcept {
+  switch (op) {
+    case FusedElementWiseNode::FUSED_OP_SIGMOID:
+      LLMath<T>::sigmoid(n, x, z);
+      break;
+    case FusedElementWiseNode::FUSED_OP_TANH:
+      LLMath<T>::tanh(n, x, z);
+      break;
+    case FusedElementWiseNode::FUSED_OP_RELU:
+      for (int i = 0; i < n; ++i) {
+        z[i] = (x[i] > 0) ? x[i] : 0;
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_EXP:
+      LLMath<T>::exp(n, x, z);
+      break;
+    case FusedElementWiseNode::FUSED_OP_LOG:
+      LLMath<T>::log(n, x, z);
+      break;
+    case FusedElementWiseNode::FUSED_OP_NEGATE:
+      for (int i = 0; i < n; ++i) {
+        z[i] = -x[i];
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_INV:
+      LLMath<T>::inv(n, x, z);
+      break;
+    case FusedElementWiseNode::FUSED_OP_SQRT:
+      LLMath<T>::sqrt(n, x, z);
+      break;
+    case FusedElementWiseNode::FUSED_OP_SQUARE:
+      LLMath<T>::square(n, x, z);
+      break;
+  }
+}
+
+template <typename T>
+void FusedBinary(int op, int n, const T* x, const T* y, int col_stride,
+                 T* z) noexcept {
+  if (col_stride == 0) {
+    T _y = y[0];
+    switch (op) {
+      case FusedElementWiseNode::FUSED_OP_ADD:
+        LLMath<T>::add_scalar(n, x, _y, z);
+        break;
+      case FusedElementWiseNode::FUSED_OP_SUB:
+        LLMath<T>::sub_scalar(n, x, _y, z);
+        break;
+      case FusedElementWiseNode::FUSED_OP_RSUB:
+        for (int i = 0; i < n; ++i) {
+          z[i] = _y - x[i];
+        }
+        break;
+      case FusedElementWiseNode::FUSED_OP_MUL:
+        LLMath<T>::mul_scalar(n, x, _y, z);
+        break;
+    }
+    return;
+  }
+
+  switch (op) {
+    case FusedElementWiseNode::FUSED_OP_ADD:
+      LLMath<T>::add(n, x, y, z);
+      break;
+    case FusedElementWiseNode::FUSED_OP_SUB:
+      LLMath<T>::sub(n, x, y, z);
+      break;
+    case FusedElementWiseNode::FUSED_OP_RSUB:
+      LLMath<T>::sub(n, y, x, z);
+      break;
+    case FusedElementWiseNode::FUSED_OP_MUL:
+      LLMath<T>::mul(n, x, y, z);
+      break;
+  }
+}
+
+// g is the gradient of z on input, and the gradient of x on output.
+template <typename T>
+void FusedUnaryBackward(int op, int n, const T* x, const T* z, T* g) noexcept {
+  switch (op) {
+    case FusedElementWiseNode::FUSED_OP_SIGMOID:
+      for (int i = 0; i < n; ++i) {
+        g[i] *= z[i] * (1 - z[i]);
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_TANH:
+      for (int i = 0; i < n; ++i) {
+        g[i] *= 1 - z[i] * z[i];
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_RELU:
+      for (int i = 0; i < n; ++i) {
+        if (z[i] <= 0) {
+          g[i] = 0;
+        }
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_EXP:
+      for (int i = 0; i < n; ++i) {
+        g[i] *= z[i];
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_LOG:
+      for (int i = 0; i < n; ++i) {
+        g[i] /= x[i];
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_NEGATE:
+      for (int i = 0; i < n; ++i) {
+        g[i] = -g[i];
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_INV:
+      for (int i = 0; i < n; ++i) {
+        g[i] *= -z[i] * z[i];
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_SQRT:
+      for (int i = 0; i < n; ++i) {
+        if (z[i] > (T)1e-3) {
+          g[i] *= (T)0.5 / z[i];
+        } else {
+          g[i] *= (T)0.5 / (T)1e-3;
+        }
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_SQUARE:
+      for (int i = 0; i < n; ++i) {
+        g[i] *= 2 * x[i];
+      }
+      break;
+  }
+}
+
+// g is the gradient of z on input, and the gradient of x on output.
+// The gradient of y is accumulated to gy if gy is not nullptr.
+template <typename T>
+void FusedBinaryBackward(int op, int n, const T* x, const T* y, T* gy,
+                         int col_stride, T* g) noexcept {
+  switch (op) {
+    case FusedElementWiseNode::FUSED_OP_ADD:
+      if (gy) {
+        for (int i = 0; i < n; ++i) {
+          gy[i * col_stride] += g[i];
+        }
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_SUB:
+      if (gy) {
+        for (int i = 0; i < n; ++i) {
+          gy[i * col_stride] -= g[i];
+        }
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_RSUB:
+      if (gy) {
+        for (int i = 0; i < n; ++i) {
+          gy[i * col_stride] += g[i];
+        }
+      }
+      for (int i = 0; i < n; ++i) {
+        g[i] = -g[i];
+      }
+      break;
+    case FusedElementWiseNode::FUSED_OP_MUL:
+      if (gy) {
+        for (int i = 0; i < n; ++i) {
+          gy[i * col_stride] += g[i] * x[i];
+        }
+      }
+      for (int i = 0; i < n; ++i) {
+        g[i] *= y[i * col_stride];
+      }
+      break;
+  }
+}
+
+}  // namespace
+
+bool FusedElementWiseNode::IsUnaryOp(int op) noexcept {
+  return op >= FUSED_OP_SIGMOID && op <= FUSED_OP_SQUARE;
+}
+
+bool FusedElementWiseNode::IsBinaryOp(int op) noexcept {
+  return op >= FUSED_OP_ADD && op <= FUSED_OP_MUL;
+}
+
+bool FusedElementWiseNode::IsBroadcastable(const Shape& Z,
+                                           const Shape& Y) noexcept {
+  if (Z.empty() || Y.empty()) {
+    return false;
+  }
+  if (Y == Z || Y.total_dim() == 1) {
+    return true;
+  }
+  if (Y.rank() > Z.rank()) {
+    return false;
+  }
+  for (int i = 0; i < Y.rank() - 1; ++i) {
+    if (Y[i] != 1) {
+      return false;
+    }
+  }
+  return Y[Y.rank() - 1] == Z[Z.rank() - 1];
+}
+
+FusedElementWiseNode::FusedElementWiseNode(std::string name,
+                                           std::vector<GraphNode*> X,
+                                           std::vector<int> ops,
+                                           std::vector<int> operands)
+    : GraphNode(std::move(name)),
+      ops_(std::move(ops)),
+      operands_(std::move(operands)) {
+  DXCHECK_THROW(!X.empty());
+  for (const GraphNode* _X : X) {
+    DXCHECK_THROW(_X->tensor_type() == TENSOR_TYPE_TSR);
+  }
+  DXCHECK_THROW(!ops_.empty());
+  DXCHECK_THROW((int)ops_.size() <= MAX_FUSED_OP);
+  DXCHECK_THROW(ops_.size() == operands_.size());
+  for (size_t i = 0; i < ops_.size(); ++i) {
+    if (IsUnaryOp(ops_[i])) {
+      DXCHECK_THROW(operands_[i] == -1);
+    } else {
+      DXCHECK_THROW(IsBinaryOp(ops_[i]));
+      DXCHECK_THROW(operands_[i] >= 0 && operands_[i] < (int)X.size());
+    }
+  }
+
+  input_ = std::move(X);
+  node_type_ = GRAPH_NODE_TYPE_HIDDEN;
+  tensor_type_ = TENSOR_TYPE_TSR;
+
+  if (HasShape(input_)) {
+    std::vector<const Shape*> Xshape(input_size());
+    for (int i = 0; i < input_size(); ++i) {
+      Xshape[i] = &input_[i]->shape();
+    }
+    (void)FusedElementWiseInferShape(Xshape, ops_, operands_, &shape_);
+  }
+}
+
+class FusedElementWiseOp : public OpImpl {
+ private:
+  std::vector<int> ops_;
+  std::vector<int> operands_;
+  std::vector<const tsr_t*> X_;
+  std::vector<int> row_stride_;
+  std::vector<int> col_stride_;
+  int m_ = 0;
+  int n_ = 0;
+  tsr_t* Z_ = nullptr;
+  tsr_t* gZ_ = nullptr;
+  std::vector<tsr_t*> gX_;
+  int has_gX_ = 0;
+  tsr_t buf_;
+
+ public:
+  DEFINE_OP_LIKE(FusedElementWiseOp);
+
+  void InitForward() override {
+    const FusedElementWiseNode* node =  // NOLINT
+        (const FusedElementWiseNode*)node_;
+    ops_ = node->ops();
+    operands_ = node->operands();
+
+    int input_size = node_->input_size();
+    std::vector<const Shape*> Xshape(input_size);
+    X_.resize(input_size);
+    for (int i = 0; i < input_size; ++i) {
+      X_[i] = GetPtrTSR(node_->input(i));
+      Xshape[i] = &X_[i]->shape();
+    }
+
+    Shape Zshape;
+    DXCHECK_THROW(
+        FusedElementWiseInferShape(Xshape, ops_, operands_, &Zshape));
+    n_ = Zshape[Zshape.rank() - 1];
+    m_ = n_ ? Zshape.total_dim() / n_ : 0;
+
+    row_stride_.assign(input_size, 0);
+    col_stride_.assign(input_size, 0);
+    for (int i = 0; i < input_size; ++i) {
+      GetBroadcastStride(Zshape, *Xshape[i], &row_stride_[i], &col_stride_[i]);
+    }
+    Z_ = InitHiddenTSR(node_, Zshape);
+  }
+
+  void InitBackward() override {
+    gZ_ = GetGradPtrTSR(node_);
+    int input_size = node_->input_size();
+    gX_.resize(input_size);
+    has_gX_ = 0;
+    for (int i = 0; i < input_size; ++i) {
+      gX_[i] = InitGradTSR(node_->input(i), X_[i]->shape());
+      if (gX_[i]) {
+        has_gX_ = 1;
+      }
+    }
+    // intermediate results of a block and the gradient of a block
+    buf_.resize((int)ops_.size(), FUSED_BLOCK_SIZE);
+  }
+
+  void Forward() override {
+    int op_size = (int)ops_.size();
+    const float_t* _X0 = X_[0]->data();
+    float_t* _Z = Z_->data();
+    for (int i = 0; i < m_; ++i) {
+      for (int j = 0; j < n_; j += FUSED_BLOCK_SIZE) {
+        int n = std::min(FUSED_BLOCK_SIZE, n_ - j);
+        const float_t* x = _X0 + i * n_ + j;
+        float_t* z = _Z + i * n_ + j;
+        for (int k = 0; k < op_size; ++k) {
+          int op = ops_[k];
+          if (FusedElementWiseNode::IsUnaryOp(op)) {
+            FusedUnary(op, n, x, z);
+          } else {
+            int l = operands_[k];
+            const float_t* y = X_[l]->data() + i * row_stride_[l] +
+                               j * col_stride_[l];
+            FusedBinary(op, n, x, y, col_stride_[l], z);
+          }
+          x = z;
+        }
+      }
+    }
+  }
+
+  void Backward() override {
+    if (!has_gX_) {
+      return;
+    }
+
+    int op_size = (int)ops_.size();
+    const float_t* _X0 = X_[0]->data();
+    const float_t* _Z = Z_->data();
+    const float_t* _gZ = gZ_->data();
+    float_t* _gX0 = gX_[0] ? gX_[0]->data() : nullptr;
+    float_t* _buf = buf_.data();
+    float_t* g = _buf + (op_size - 1) * FUSED_BLOCK_SIZE;
+    // x[k] is the input of ops_[k], x[op_size] is the output
+    std::array<const float_t*, FusedElementWiseNode::MAX_FUSED_OP + 1> x;
+    for (int i = 0; i < m_; ++i) {
+      for (int j = 0; j < n_; j += FUSED_BLOCK_SIZE) {
+        int n = std::min(FUSED_BLOCK_SIZE, n_ - j);
+        // recompute intermediate results of the block
+        x[0] = _X0 + i * n_ + j;
+        for (int k = 0; k < op_size - 1; ++k) {
+          float_t* z = _buf + k * FUSED_BLOCK_SIZE;
+          int op = ops_[k];
+          if (FusedElementWiseNode::IsUnaryOp(op)) {
+            FusedUnary(op, n, x[k], z);
+          } else {
+            int l = operands_[k];
+            const float_t* y = X_[l]->data() + i * row_stride_[l] +
+                               j * col_stride_[l];
+            FusedBinary(op, n, x[k], y, col_stride_[l], z);
+          }
+          x[k + 1] = z;
+        }
+        x[op_size] = _Z + i * n_ + j;
+
+        LLMath<float_t>::copy(n, _gZ + i * n_ + j, g);
+        for (int k = op_size - 1; k >= 0; --k) {
+          int op = ops_[k];
+          if (FusedElementWiseNode::IsUnaryOp(op)) {
+            FusedUnaryBackward(op, n, x[k], x[k + 1], g);
+          } else {
+            int l = operands_[k];
+            int offset = i * row_stride_[l] + j * col_stride_[l];
+            const float_t* y = X_[l]->data() + offset;
+            float_t* gy = gX_[l] ? gX_[l]->data() + offset : nullptr;
+            FusedBinaryBackward(op, n, x[k], y, gy, col_stride_[l], g);
+          }
+        }
+        if (_gX0) {
+          LLMath<float_t>::add(n, _gX0 + i * n_ + j, g, _gX0 + i * n_ + j);
+        }
+      }
+    }
+  }
+};
+
+GRAPH_NODE_OP_REGISTER(FusedElementWise);
+
+}  // namespace deepx_core
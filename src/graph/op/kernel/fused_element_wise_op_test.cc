@@ -0,0 +1,87 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include "../op_test.h"
+
+namespace deepx_core {
+
+class FusedElementWiseForwardTest : public testing::Test, public DataType {};
+
+TEST_F(FusedElementWiseForwardTest, FusedElementWise) {
+  ConstantNode X("X", Shape(2, 3),
+                 {0, 1, 2,  //
+                  3, 4, 5});
+  ConstantNode b("b", Shape(1, 3), {1, 2, 3});
+  ConstantNode c("c", Shape(1), {2});
+  // Z = X - (-((X + b) * c))
+  FusedElementWiseNode Z("Z", {&X, &b, &c},
+                         {FusedElementWiseNode::FUSED_OP_ADD,
+                          FusedElementWiseNode::FUSED_OP_MUL,
+                          FusedElementWiseNode::FUSED_OP_NEGATE,
+                          FusedElementWiseNode::FUSED_OP_RSUB},
+                         {1, 2, -1, 0});
+  tsr_t expected_Z{{2, 7, 12},  //
+                   {11, 16, 21}};
+  CheckOpForward(&Z, 0, expected_Z);
+}
+
+class FusedElementWiseBackwardTest : public testing::Test {};
+
+TEST_F(FusedElementWiseBackwardTest, FusedElementWise_unary) {
+  VariableNode X("X", Shape(2, 3), TENSOR_INITIALIZER_TYPE_RAND, 0.5, 1.5);
+  FusedElementWiseNode Z("Z", {&X},
+                         {FusedElementWiseNode::FUSED_OP_SQUARE,
+                          FusedElementWiseNode::FUSED_OP_SQRT,
+                          FusedElementWiseNode::FUSED_OP_LOG,
+                          FusedElementWiseNode::FUSED_OP_EXP,
+                          FusedElementWiseNode::FUSED_OP_INV,
+                          FusedElementWiseNode::FUSED_OP_NEGATE,
+                          FusedElementWiseNode::FUSED_OP_TANH,
+                          FusedElementWiseNode::FUSED_OP_SIGMOID},
+                         {-1, -1, -1, -1, -1, -1, -1, -1});
+  CheckOpBackward(&Z, 0);
+}
+
+TEST_F(FusedElementWiseBackwardTest, FusedElementWise_relu) {
+  VariableNode X("X", Shape(2, 3), TENSOR_INITIALIZER_TYPE_RAND, 1, 2);
+  FusedElementWiseNode Z("Z", {&X},
+                         {FusedElementWiseNode::FUSED_OP_NEGATE,
+                          FusedElementWiseNode::FUSED_OP_RELU},
+                         {-1, -1});
+  CheckOpBackward(&Z, 0);
+
+  X.set_initializer(TENSOR_INITIALIZER_TYPE_RAND, -2, -1);
+  CheckOpBackward(&Z, 0);
+}
+
+TEST_F(FusedElementWiseBackwardTest, FusedElementWise_binary) {
+  VariableNode X("X", Shape(2, 3), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  VariableNode Y("Y", Shape(2, 3), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  VariableNode b("b", Shape(1, 3), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  VariableNode c("c", Shape(1), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  FusedElementWiseNode Z("Z", {&X, &Y, &b, &c},
+                         {FusedElementWiseNode::FUSED_OP_ADD,
+                          FusedElementWiseNode::FUSED_OP_MUL,
+                          FusedElementWiseNode::FUSED_OP_SUB,
+                          FusedElementWiseNode::FUSED_OP_TANH,
+                          FusedElementWiseNode::FUSED_OP_RSUB,
+                          FusedElementWiseNode::FUSED_OP_MUL},
+                         {1, 2, 3, -1, 2, 0});
+  CheckOpBackward(&Z, 0);
+}
+
+TEST_F(FusedElementWiseBackwardTest, FusedElementWise_multi_block) {
+  // the last dim is larger than a block
+  VariableNode X("X", Shape(2, 2, 300), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  VariableNode b("b", Shape(300), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  VariableNode c("c", Shape(1, 1, 1), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  FusedElementWiseNode Z("Z", {&X, &b, &c},
+                         {FusedElementWiseNode::FUSED_OP_MUL,
+                          FusedElementWiseNode::FUSED_OP_SIGMOID,
+                          FusedElementWiseNode::FUSED_OP_ADD},
+                         {1, -1, 2});
+  CheckOpBackward(&Z, 0);
+}
+
+}  // namespace deepx_core
@@ -284,10 +284,29 @@ class GEMMOp : public OpBinaryBase {
  private:
   GEMMAux aux_;
   GEMMJitAux<float_t> jaux_;
+  const qtsr_t* qY_ = nullptr;
 
  public:
   DEFINE_OP_LIKE(GEMMOp);
 
+  void InitForward() override {
+    qY_ = GetPtrQTSR(node_->input(1));
+    if (qY_ == nullptr) {
+      OpBinaryBase::InitForward();
+      return;
+    }
+
+    // Quantized Y is predict only and not transposed.
+    Xnode_ = node_->input(0);
+    Ynode_ = node_->input(1);
+    X_ = GetPtrTSR(Xnode_);
+    Y_ = nullptr;
+    DXCHECK_THROW(((const GEMMNode*)node_)->transX() == 0);
+    DXCHECK_THROW(((const GEMMNode*)node_)->transY() == 0);
+    DXCHECK_THROW(GEMMPrepare(X_->shape(), qY_->shape(), 0, 0, &aux_));
+    Z_ = InitHiddenTSR(node_, aux_.Z);
+  }
+
   const Shape& InferShape() override {
     int transX = ((const GEMMNode*)node_)->transX();
     int transY = ((const GEMMNode*)node_)->transY();
@@ -297,11 +316,18 @@ class GEMMOp : public OpBinaryBase {
   }
 
   void InitBackward() override {
+    DXCHECK_THROW(qY_ == nullptr);
     OpBinaryBase::InitBackward();
     GEMMJitPrepareBackward(aux_, &jaux_);
   }
 
-  void Forward() override { GEMMJit(*X_, *Y_, Z_, aux_, jaux_); }
+  void Forward() override {
+    if (qY_) {
+      qY_->gemm(aux_.m, X_->data(), Z_->data());
+    } else {
+      GEMMJit(*X_, *Y_, Z_, aux_, jaux_);
+    }
+  }
 
   void Backward() override {
     if (gZ_) {
@@ -126,6 +126,43 @@ void Group18EmbeddingLookupBackward(
   }
 }
 
+// Look up rows of W for nonzeros of X, nullptr for absent rows or groups.
+// Buckets are prefetched 'HASH_MAP_PREFETCH_BLOCK' nonzeros ahead.
+template <typename T, typename I>
+void Group18SparseEmbeddingLookupRows(
+    const CSRMatrix<T, I>& X,
+    const std::vector<const SparseRowMatrix<T, I>*>& W,
+    const Group18EmbeddingLookupAux& aux, std::vector<const T*>* Wrows) {
+  auto get_W = [&X, &W, &aux](int k) -> const SparseRowMatrix<T, I>* {
+    int group_id = LLSparseTensor<T, I>::group_18_get_group_id(X.col(k));
+    if (aux.GetZoffset(group_id) < 0) {
+      return nullptr;
+    }
+    return W[group_id];
+  };
+
+  int nnz = (int)X.col_size();
+  int ahead = (int)detail::HASH_MAP_PREFETCH_BLOCK;
+  const SparseRowMatrix<T, I>* _W;
+  Wrows->resize((size_t)nnz);
+  for (int k = 0; k < ahead && k < nnz; ++k) {
+    _W = get_W(k);
+    if (_W) {
+      _W->prefetch_row(X.col(k));
+    }
+  }
+  for (int k = 0; k < nnz; ++k) {
+    if (k + ahead < nnz) {
+      _W = get_W(k + ahead);
+      if (_W) {
+        _W->prefetch_row(X.col(k + ahead));
+      }
+    }
+    _W = get_W(k);
+    (*Wrows)[k] = _W ? _W->get_row_no_init(X.col(k)) : nullptr;
+  }
+}
+
 template <typename T, typename I>
 void Group18SparseEmbeddingLookup(
     const CSRMatrix<T, I>& X,
@@ -134,25 +171,24 @@ void Group18SparseEmbeddingLookup(
   int n = Z->dim(1);
   T* _Z = Z->data();
   Z->zeros();
+  std::vector<const T*> Wrows;
+  Group18SparseEmbeddingLookupRows(X, W, aux, &Wrows);
   CSR_FOR_EACH_ROW(X, i) {
     CSR_FOR_EACH_COL(X, i) {
+      const T* Wj = Wrows[__k];
+      if (Wj == nullptr) {
+        continue;
+      }
+
       I j = CSR_COL(X);
       T Xij = CSR_VALUE(X);
       int group_id = LLSparseTensor<T, I>::group_18_get_group_id(j);
       int Zoffset = aux.GetZoffset(group_id);
-      if (Zoffset < 0) {
-        continue;
-      }
-
-      const auto& _W = *W[group_id];
-      int Wcol = _W.col();
+      int Wcol = W[group_id]->col();
       if (Wcol == 1) {
-        _Z[Zoffset] += Xij * _W.get_scalar_no_init(j);
+        _Z[Zoffset] += Xij * *Wj;
       } else {
-        const T* Wj = _W.get_row_no_init(j);
-        if (Wj) {
-          LLMath<T>::axpy(Wcol, Xij, Wj, _Z + Zoffset);
-        }
+        LLMath<T>::axpy(Wcol, Xij, Wj, _Z + Zoffset);
       }
     }
     _Z += n;
@@ -495,39 +531,31 @@ void Group18SparseEmbeddingLookup2(
   int n = Z->dim(1);
   T* _Z = Z->data();
   Z->zeros();
-  if (Wcol == 1) {
-    CSR_FOR_EACH_ROW(X, i) {
-      CSR_FOR_EACH_COL(X, i) {
-        I j = CSR_COL(X);
-        T Xij = CSR_VALUE(X);
-        int group_id = LLSparseTensor<T, I>::group_18_get_group_id(j);
-        int Zoffset = aux.GetZoffset(group_id);
-        if (Zoffset < 0) {
-          continue;
-        }
+  // Rows are looked up in batches.
+  std::vector<const T*> Wrows(X.col_size());
+  W.get_rows_no_init(X.col_begin(), X.col_size(), Wrows.data());
+  CSR_FOR_EACH_ROW(X, i) {
+    CSR_FOR_EACH_COL(X, i) {
+      const T* Wj = Wrows[__k];
+      if (Wj == nullptr) {
+        continue;
+      }
 
-        _Z[Zoffset] += Xij * W.get_scalar_no_init(j);
+      I j = CSR_COL(X);
+      T Xij = CSR_VALUE(X);
+      int group_id = LLSparseTensor<T, I>::group_18_get_group_id(j);
+      int Zoffset = aux.GetZoffset(group_id);
+      if (Zoffset < 0) {
+        continue;
       }
-      _Z += n;
-    }
-  } else {
-    CSR_FOR_EACH_ROW(X, i) {
-      CSR_FOR_EACH_COL(X, i) {
-        I j = CSR_COL(X);
-        T Xij = CSR_VALUE(X);
-        int group_id = LLSparseTensor<T, I>::group_18_get_group_id(j);
-        int Zoffset = aux.GetZoffset(group_id);
-        if (Zoffset < 0) {
-          continue;
-        }
 
-        const T* Wj = W.get_row_no_init(j);
-        if (Wj) {
-          LLMath<T>::axpy(Wcol, Xij, Wj, _Z + Zoffset);
-        }
+      if (Wcol == 1) {
+        _Z[Zoffset] += Xij * *Wj;
+      } else {
+        LLMath<T>::axpy(Wcol, Xij, Wj, _Z + Zoffset);
       }
-      _Z += n;
     }
+    _Z += n;
   }
 }
 
@@ -127,6 +127,43 @@ void GroupEmbeddingLookupBackward(const CSRMatrix<T, I>& X,
   }
 }
 
+// Look up rows of W for nonzeros of X, nullptr for absent rows or groups.
+// Buckets are prefetched 'HASH_MAP_PREFETCH_BLOCK' nonzeros ahead.
+template <typename T, typename I>
+void GroupSparseEmbeddingLookupRows(
+    const CSRMatrix<T, I>& X,
+    const std::vector<const SparseRowMatrix<T, I>*>& W,
+    const GroupEmbeddingLookupAux& aux, std::vector<const T*>* Wrows) {
+  auto get_W = [&X, &W, &aux](int k) -> const SparseRowMatrix<T, I>* {
+    uint16_t group_id = LLSparseTensor<T, I>::get_group_id(X.col(k));
+    if (aux.GetZoffset(group_id) < 0) {
+      return nullptr;
+    }
+    return W[group_id];
+  };
+
+  int nnz = (int)X.col_size();
+  int ahead = (int)detail::HASH_MAP_PREFETCH_BLOCK;
+  const SparseRowMatrix<T, I>* _W;
+  Wrows->resize((size_t)nnz);
+  for (int k = 0; k < ahead && k < nnz; ++k) {
+    _W = get_W(k);
+    if (_W) {
+      _W->prefetch_row(X.col(k));
+    }
+  }
+  for (int k = 0; k < nnz; ++k) {
+    if (k + ahead < nnz) {
+      _W = get_W(k + ahead);
+      if (_W) {
+        _W->prefetch_row(X.col(k + ahead));
+      }
+    }
+    _W = get_W(k);
+    (*Wrows)[k] = _W ? _W->get_row_no_init(X.col(k)) : nullptr;
+  }
+}
+
 template <typename T, typename I>
 void GroupSparseEmbeddingLookup(
     const CSRMatrix<T, I>& X,
@@ -135,25 +172,24 @@ void GroupSparseEmbeddingLookup(
   int n = Z->dim(1);
   T* _Z = Z->data();
   Z->zeros();
+  std::vector<const T*> Wrows;
+  GroupSparseEmbeddingLookupRows(X, W, aux, &Wrows);
   CSR_FOR_EACH_ROW(X, i) {
     CSR_FOR_EACH_COL(X, i) {
+      const T* Wj = Wrows[__k];
+      if (Wj == nullptr) {
+        continue;
+      }
+
       I j = CSR_COL(X);
       T Xij = CSR_VALUE(X);
       uint16_t group_id = LLSparseTensor<T, I>::get_group_id(j);
       int Zoffset = aux.GetZoffset(group_id);
-      if (Zoffset < 0) {
-        continue;
-      }
-
-      const auto& _W = *W[group_id];
-      int Wcol = _W.col();
+      int Wcol = W[group_id]->col();
       if (Wcol == 1) {
-        _Z[Zoffset] += Xij * _W.get_scalar_no_init(j);
+        _Z[Zoffset] += Xij * *Wj;
       } else {
-        const T* Wj = _W.get_row_no_init(j);
-        if (Wj) {
-          LLMath<T>::axpy(Wcol, Xij, Wj, _Z + Zoffset);
-        }
+        LLMath<T>::axpy(Wcol, Xij, Wj, _Z + Zoffset);
       }
     }
     _Z += n;
@@ -193,6 +229,86 @@ void GroupSparseEmbeddingLookupBackward(
   }
 }
 
+// Predict only, rows of W are dequantized on the fly.
+template <typename T, typename I>
+void QuantizedGroupEmbeddingLookup(
+    const CSRMatrix<T, I>& X, const std::vector<const QuantizedTensor<T>*>& W,
+    Tensor<T>* Z, const GroupEmbeddingLookupAux& aux) noexcept {
+  int n = Z->dim(1);
+  T* _Z = Z->data();
+  Z->zeros();
+  CSR_FOR_EACH_ROW(X, i) {
+    CSR_FOR_EACH_COL(X, i) {
+      I j = CSR_COL(X);
+      T Xij = CSR_VALUE(X);
+      uint16_t group_id = LLSparseTensor<T, I>::get_group_id(j);
+      int Zoffset = aux.GetZoffset(group_id);
+      if (Zoffset < 0) {
+        continue;
+      }
+
+      const auto& _W = *W[group_id];
+      _W.axpy_row((int)(j % (I)_W.dim(0)), Xij, _Z + Zoffset);
+    }
+    _Z += n;
+  }
+}
+
+// Predict only, rows of W are dequantized on the fly.
+// Buckets are prefetched 'HASH_MAP_PREFETCH_BLOCK' nonzeros ahead.
+template <typename T, typename I>
+void QuantizedGroupSparseEmbeddingLookup(
+    const CSRMatrix<T, I>& X,
+    const std::vector<const QuantizedSparseRowMatrix<T, I>*>& W, Tensor<T>* Z,
+    const GroupEmbeddingLookupAux& aux) noexcept {
+  auto get_W = [&X, &W, &aux](int k) -> const QuantizedSparseRowMatrix<T, I>* {
+    uint16_t group_id = LLSparseTensor<T, I>::get_group_id(X.col(k));
+    if (aux.GetZoffset(group_id) < 0) {
+      return nullptr;
+    }
+    return W[group_id];
+  };
+
+  int nnz = (int)X.col_size();
+  int ahead = (int)detail::HASH_MAP_PREFETCH_BLOCK;
+  const QuantizedSparseRowMatrix<T, I>* _W;
+  std::vector<int> Wrows((size_t)nnz);
+  for (int k = 0; k < ahead && k < nnz; ++k) {
+    _W = get_W(k);
+    if (_W) {
+      _W->prefetch_row(X.col(k));
+    }
+  }
+  for (int k = 0; k < nnz; ++k) {
+    if (k + ahead < nnz) {
+      _W = get_W(k + ahead);
+      if (_W) {
+        _W->prefetch_row(X.col(k + ahead));
+      }
+    }
+    _W = get_W(k);
+    Wrows[k] = _W ? _W->find_row(X.col(k)) : -1;
+  }
+
+  int n = Z->dim(1);
+  T* _Z = Z->data();
+  Z->zeros();
+  CSR_FOR_EACH_ROW(X, i) {
+    CSR_FOR_EACH_COL(X, i) {
+      int Wj = Wrows[__k];
+      if (Wj < 0) {
+        continue;
+      }
+
+      I j = CSR_COL(X);
+      T Xij = CSR_VALUE(X);
+      uint16_t group_id = LLSparseTensor<T, I>::get_group_id(j);
+      W[group_id]->axpy_row(Wj, Xij, _Z + aux.GetZoffset(group_id));
+    }
+    _Z += n;
+  }
+}
+
 }  // namespace
 
 GroupEmbeddingLookupNode::GroupEmbeddingLookupNode(
@@ -241,6 +357,10 @@ class GroupEmbeddingLookupOp : public OpImpl {
   std::vector<const Shape*> Wshape_;      // indexed by i
   std::vector<const tsr_t*> Wtsr_;        // indexed by group id
   std::vector<const srm_t*> Wsrm_;        // indexed by group id
+  // Either all or none of W are quantized.
+  int quantized_ = 0;
+  std::vector<const qtsr_t*> Wqtsr_;  // indexed by group id
+  std::vector<const qsrm_t*> Wqsrm_;  // indexed by group id
   tsr_t* Z_ = nullptr;
   tsr_t* gZ_ = nullptr;
   std::vector<srm_t*> gW_;  // indexed by group id
@@ -267,8 +387,21 @@ class GroupEmbeddingLookupOp : public OpImpl {
     Wshape_.assign(Wsize_, nullptr);
     Wtsr_.clear();
     Wsrm_.clear();
+    Wqtsr_.clear();
+    Wqsrm_.clear();
     switch (W_tensor_type_) {
       case TENSOR_TYPE_TSR:
+        quantized_ = GetPtrQTSR(Wnode2_[0]) != nullptr;
+        if (quantized_) {
+          Wqtsr_.assign(max_group_id_, nullptr);
+          for (int i = 0; i < Wsize_; ++i) {
+            const qtsr_t* W = GetPtrQTSR(Wnode2_[i]);
+            DXCHECK_THROW(W);
+            Wqtsr_[group_ids_[i]] = W;
+            Wshape_[i] = &W->shape();
+          }
+          break;
+        }
         Wtsr_.assign(max_group_id_, nullptr);
         for (int i = 0; i < Wsize_; ++i) {
           tsr_t* W = GetPtrTSR(Wnode2_[i]);
@@ -277,6 +410,17 @@ class GroupEmbeddingLookupOp : public OpImpl {
         }
         break;
       case TENSOR_TYPE_SRM:
+        quantized_ = GetPtrQSRM(Wnode2_[0]) != nullptr;
+        if (quantized_) {
+          Wqsrm_.assign(max_group_id_, nullptr);
+          for (int i = 0; i < Wsize_; ++i) {
+            const qsrm_t* W = GetPtrQSRM(Wnode2_[i]);
+            DXCHECK_THROW(W);
+            Wqsrm_[group_ids_[i]] = W;
+            Wshape_[i] = &W->shape();
+          }
+          break;
+        }
         Wsrm_.assign(max_group_id_, nullptr);
         for (int i = 0; i < Wsize_; ++i) {
           srm_t* W = GetPtrSRM(Wnode2_[i]);
@@ -291,6 +435,7 @@ class GroupEmbeddingLookupOp : public OpImpl {
   }
 
   void InitBackward() override {
+    DXCHECK_THROW(!quantized_);
     gZ_ = GetGradPtrTSR(node_);
     gW_.assign(max_group_id_, nullptr);
     switch (W_tensor_type_) {
@@ -312,10 +457,18 @@ class GroupEmbeddingLookupOp : public OpImpl {
   void Forward() override {
     switch (W_tensor_type_) {
       case TENSOR_TYPE_TSR:
-        GroupEmbeddingLookup(*X_, Wtsr_, Z_, aux_);
+        if (quantized_) {
+          QuantizedGroupEmbeddingLookup(*X_, Wqtsr_, Z_, aux_);
+        } else {
+          GroupEmbeddingLookup(*X_, Wtsr_, Z_, aux_);
+        }
         break;
       case TENSOR_TYPE_SRM:
-        GroupSparseEmbeddingLookup(*X_, Wsrm_, Z_, aux_);
+        if (quantized_) {
+          QuantizedGroupSparseEmbeddingLookup(*X_, Wqsrm_, Z_, aux_);
+        } else {
+          GroupSparseEmbeddingLookup(*X_, Wsrm_, Z_, aux_);
+        }
         break;
     }
   }
@@ -496,39 +649,31 @@ void GroupSparseEmbeddingLookup2(const CSRMatrix<T, I>& X,
   int n = Z->dim(1);
   T* _Z = Z->data();
   Z->zeros();
-  if (Wcol == 1) {
-    CSR_FOR_EACH_ROW(X, i) {
-      CSR_FOR_EACH_COL(X, i) {
-        I j = CSR_COL(X);
-        T Xij = CSR_VALUE(X);
-        uint16_t group_id = LLSparseTensor<T, I>::get_group_id(j);
-        int Zoffset = aux.GetZoffset(group_id);
-        if (Zoffset < 0) {
-          continue;
-        }
+  // Rows are looked up in batches.
+  std::vector<const T*> Wrows(X.col_size());
+  W.get_rows_no_init(X.col_begin(), X.col_size(), Wrows.data());
+  CSR_FOR_EACH_ROW(X, i) {
+    CSR_FOR_EACH_COL(X, i) {
+      const T* Wj = Wrows[__k];
+      if (Wj == nullptr) {
+        continue;
+      }
 
-        _Z[Zoffset] += Xij * W.get_scalar_no_init(j);
+      I j = CSR_COL(X);
+      T Xij = CSR_VALUE(X);
+      uint16_t group_id = LLSparseTensor<T, I>::get_group_id(j);
+      int Zoffset = aux.GetZoffset(group_id);
+      if (Zoffset < 0) {
+        continue;
       }
-      _Z += n;
-    }
-  } else {
-    CSR_FOR_EACH_ROW(X, i) {
-      CSR_FOR_EACH_COL(X, i) {
-        I j = CSR_COL(X);
-        T Xij = CSR_VALUE(X);
-        uint16_t group_id = LLSparseTensor<T, I>::get_group_id(j);
-        int Zoffset = aux.GetZoffset(group_id);
-        if (Zoffset < 0) {
-          continue;
-        }
 
-        const T* Wj = W.get_row_no_init(j);
-        if (Wj) {
-          LLMath<T>::axpy(Wcol, Xij, Wj, _Z + Zoffset);
-        }
+      if (Wcol == 1) {
+        _Z[Zoffset] += Xij * *Wj;
+      } else {
+        LLMath<T>::axpy(Wcol, Xij, Wj, _Z + Zoffset);
       }
-      _Z += n;
     }
+    _Z += n;
   }
 }
 
@@ -604,6 +749,11 @@ class GroupEmbeddingLookup2Op : public OpImpl {
   const csr_t* X_ = nullptr;
   const tsr_t* Wtsr_ = nullptr;
   const srm_t* Wsrm_ = nullptr;
+  // W is quantized, indexed by group id to share the lookups of
+  // GroupEmbeddingLookup.
+  int quantized_ = 0;
+  std::vector<const qtsr_t*> Wqtsr_;
+  std::vector<const qsrm_t*> Wqsrm_;
   tsr_t* Z_ = nullptr;
   tsr_t* gZ_ = nullptr;
   srm_t* gW_ = nullptr;
@@ -623,22 +773,40 @@ class GroupEmbeddingLookup2Op : public OpImpl {
     X_ = GetPtrCSR(Xnode_);
     Wtsr_ = nullptr;
     Wsrm_ = nullptr;
-    switch (W_tensor_type_) {
-      case TENSOR_TYPE_TSR:
-        Wtsr_ = GetPtrTSR(Wnode_);
-        DXCHECK_THROW(GroupEmbeddingLookup2Prepare(X_->row(), Wtsr_->shape(),
-                                                   group_ids, &aux_));
-        break;
-      case TENSOR_TYPE_SRM:
-        Wsrm_ = GetPtrSRM(Wnode_);
-        DXCHECK_THROW(GroupEmbeddingLookup2Prepare(X_->row(), Wsrm_->shape(),
-                                                   group_ids, &aux_));
-        break;
+    Wqtsr_.clear();
+    Wqsrm_.clear();
+    const qtsr_t* qtsr = GetPtrQTSR(Wnode_);
+    const qsrm_t* qsrm = GetPtrQSRM(Wnode_);
+    uint16_t max_group_id =
+        *std::max_element(group_ids.begin(), group_ids.end()) + 1;
+    quantized_ = qtsr || qsrm;
+    if (qtsr) {
+      Wqtsr_.assign(max_group_id, qtsr);
+      DXCHECK_THROW(GroupEmbeddingLookup2Prepare(X_->row(), qtsr->shape(),
+                                                 group_ids, &aux_));
+    } else if (qsrm) {
+      Wqsrm_.assign(max_group_id, qsrm);
+      DXCHECK_THROW(GroupEmbeddingLookup2Prepare(X_->row(), qsrm->shape(),
+                                                 group_ids, &aux_));
+    } else {
+      switch (W_tensor_type_) {
+        case TENSOR_TYPE_TSR:
+          Wtsr_ = GetPtrTSR(Wnode_);
+          DXCHECK_THROW(GroupEmbeddingLookup2Prepare(
+              X_->row(), Wtsr_->shape(), group_ids, &aux_));
+          break;
+        case TENSOR_TYPE_SRM:
+          Wsrm_ = GetPtrSRM(Wnode_);
+          DXCHECK_THROW(GroupEmbeddingLookup2Prepare(
+              X_->row(), Wsrm_->shape(), group_ids, &aux_));
+          break;
+      }
     }
     Z_ = InitHiddenTSR(node_, aux_.Z);
   }
 
   void InitBackward() override {
+    DXCHECK_THROW(!quantized_);
     gZ_ = GetGradPtrTSR(node_);
     switch (W_tensor_type_) {
       case TENSOR_TYPE_TSR:
@@ -651,6 +819,14 @@ class GroupEmbeddingLookup2Op : public OpImpl {
   }
 
   void Forward() override {
+    if (!Wqtsr_.empty()) {
+      QuantizedGroupEmbeddingLookup(*X_, Wqtsr_, Z_, aux_);
+      return;
+    }
+    if (!Wqsrm_.empty()) {
+      QuantizedGroupSparseEmbeddingLookup(*X_, Wqsrm_, Z_, aux_);
+      return;
+    }
     switch (W_tensor_type_) {
       case TENSOR_TYPE_TSR:
         GroupEmbeddingLookup2(*X_, *Wtsr_, Z_, aux_);
@@ -401,6 +401,173 @@ class SigmoidBCELoss2Op : public OpBinaryElementWiseBase {
 
 GRAPH_NODE_OP_REGISTER(SigmoidBCELoss2);
 
+/************************************************************************/
+/* FusedSigmoidBCELoss */
+/************************************************************************/
+namespace {
+
+bool FusedSigmoidBCELossInferShape(const Shape& X, const Shape& Y,
+                                   Shape* Z) noexcept {
+  if (X != Y) {
+    DXERROR("Invalid X and Y: inconsistent shape %s vs %s.",
+            to_string(X).c_str(), to_string(Y).c_str());
+    return false;
+  }
+  Z->resize(1);
+  return true;
+}
+
+bool FusedSigmoidBCELossInferShape(const Shape& X, const Shape& Y,
+                                   const Shape& W, Shape* Z) noexcept {
+  if (!FusedSigmoidBCELossInferShape(X, Y, Z)) {
+    return false;
+  }
+  if (X != W) {
+    DXERROR("Invalid X and W: inconsistent shape %s vs %s.",
+            to_string(X).c_str(), to_string(W).c_str());
+    return false;
+  }
+  return true;
+}
+
+// Z = mean(SigmoidBCELoss(X, Y) * W), W is optional.
+template <typename T>
+void FusedSigmoidBCELoss(const Tensor<T>& X, const Tensor<T>& Y,
+                         const Tensor<T>* W, Tensor<T>* Z) noexcept {
+  const T* _X = X.data();
+  const T* _Y = Y.data();
+  const T* _W = W ? W->data() : nullptr;
+  T sum = 0;
+  T p, l;
+  for (int i = 0; i < X.total_dim(); ++i) {
+    p = LLMath<T>::sigmoid(_X[i]);
+    if (_Y[i] > 0) {
+      l = -LLMath<T>::safe_log(p);
+    } else {
+      l = -LLMath<T>::safe_log(1 - p);
+    }
+    if (_W) {
+      l *= _W[i];
+    }
+    sum += l;
+  }
+  Z->data(0) = sum / X.total_dim();
+}
+
+template <typename T>
+void FusedSigmoidBCELossBackward(const Tensor<T>& X, const Tensor<T>& Y,
+                                 const Tensor<T>* W, const Tensor<T>& gZ,
+                                 Tensor<T>* gX, Tensor<T>* gW) noexcept {
+  const T* _X = X.data();
+  const T* _Y = Y.data();
+  const T* _W = W ? W->data() : nullptr;
+  T* _gX = gX ? gX->data() : nullptr;
+  T* _gW = gW ? gW->data() : nullptr;
+  T g = gZ.data(0) / X.total_dim();
+  T p;
+  for (int i = 0; i < X.total_dim(); ++i) {
+    p = LLMath<T>::sigmoid(_X[i]);
+    if (_gX) {
+      T gl = (_Y[i] > 0) ? p - 1 : p;
+      if (_W) {
+        gl *= _W[i];
+      }
+      _gX[i] += g * gl;
+    }
+    if (_gW) {
+      if (_Y[i] > 0) {
+        _gW[i] -= g * LLMath<T>::safe_log(p);
+      } else {
+        _gW[i] -= g * LLMath<T>::safe_log(1 - p);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+FusedSigmoidBCELossNode::FusedSigmoidBCELossNode(std::string name,
+                                                 GraphNode* X, GraphNode* Y)
+    : GraphNode(std::move(name)) {
+  DXCHECK_THROW(X->tensor_type() == TENSOR_TYPE_TSR);
+  DXCHECK_THROW(Y->tensor_type() == TENSOR_TYPE_TSR);
+  input_ = {X, Y};
+  node_type_ = GRAPH_NODE_TYPE_HIDDEN;
+  tensor_type_ = TENSOR_TYPE_TSR;
+
+  if (!X->shape().empty() && !Y->shape().empty()) {
+    (void)FusedSigmoidBCELossInferShape(X->shape(), Y->shape(), &shape_);
+  }
+}
+
+FusedSigmoidBCELossNode::FusedSigmoidBCELossNode(std::string name,
+                                                 GraphNode* X, GraphNode* Y,
+                                                 GraphNode* W)
+    : GraphNode(std::move(name)) {
+  DXCHECK_THROW(X->tensor_type() == TENSOR_TYPE_TSR);
+  DXCHECK_THROW(Y->tensor_type() == TENSOR_TYPE_TSR);
+  DXCHECK_THROW(W->tensor_type() == TENSOR_TYPE_TSR);
+  input_ = {X, Y, W};
+  node_type_ = GRAPH_NODE_TYPE_HIDDEN;
+  tensor_type_ = TENSOR_TYPE_TSR;
+
+  if (!X->shape().empty() && !Y->shape().empty() && !W->shape().empty()) {
+    (void)FusedSigmoidBCELossInferShape(X->shape(), Y->shape(), W->shape(),
+                                        &shape_);
+  }
+}
+
+class FusedSigmoidBCELossOp : public OpImpl {
+ private:
+  const tsr_t* X_ = nullptr;
+  const tsr_t* Y_ = nullptr;
+  const tsr_t* W_ = nullptr;
+  Shape Zshape_;
+  tsr_t* Z_ = nullptr;
+  tsr_t* gZ_ = nullptr;
+  tsr_t* gX_ = nullptr;
+  tsr_t* gW_ = nullptr;
+
+ public:
+  DEFINE_OP_LIKE(FusedSigmoidBCELossOp);
+
+  void InitForward() override {
+    X_ = GetPtrTSR(node_->input(0));
+    Y_ = GetPtrTSR(node_->input(1));
+    if (node_->input_size() == 2) {
+      W_ = nullptr;
+      DXCHECK_THROW(
+          FusedSigmoidBCELossInferShape(X_->shape(), Y_->shape(), &Zshape_));
+    } else {
+      W_ = GetPtrTSR(node_->input(2));
+      DXCHECK_THROW(FusedSigmoidBCELossInferShape(X_->shape(), Y_->shape(),
+                                                  W_->shape(), &Zshape_));
+    }
+    Z_ = InitHiddenTSR(node_, Zshape_);
+  }
+
+  void InitBackward() override {
+    gZ_ = GetGradPtrTSR(node_);
+    gX_ = InitGradTSR(node_->input(0), X_->shape());
+    // gY is not computed.
+    if (W_) {
+      gW_ = InitGradTSR(node_->input(2), W_->shape());
+    } else {
+      gW_ = nullptr;
+    }
+  }
+
+  void Forward() override { FusedSigmoidBCELoss(*X_, *Y_, W_, Z_); }
+
+  void Backward() override {
+    if (gX_ || gW_) {
+      FusedSigmoidBCELossBackward(*X_, *Y_, W_, *gZ_, gX_, gW_);
+    }
+  }
+};
+
+GRAPH_NODE_OP_REGISTER(FusedSigmoidBCELoss);
+
 /************************************************************************/
 /* BatchCELoss */
 /************************************************************************/
@@ -58,6 +58,21 @@ TEST_F(LossBackwardTest, SigmoidBCELoss2) {
   CheckOpBackward(&Z, 0);
 }
 
+TEST_F(LossBackwardTest, FusedSigmoidBCELoss) {
+  VariableNode X("X", Shape(2, 3), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  ConstantNode Y("Y", Shape(2, 3), TENSOR_INITIALIZER_TYPE_RAND, -1, 1);
+  FusedSigmoidBCELossNode Z("Z", &X, &Y);
+  CheckOpBackward(&Z, 0);
+}
+
+TEST_F(LossBackwardTest, FusedSigmoidBCELoss_W) {
+  VariableNode X("X", Shape(2, 3), TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  ConstantNode Y("Y", Shape(2, 3), TENSOR_INITIALIZER_TYPE_RAND, -1, 1);
+  VariableNode W("W", Shape(2, 3), TENSOR_INITIALIZER_TYPE_RAND, 0, 1);
+  FusedSigmoidBCELossNode Z("Z", &X, &Y, &W);
+  CheckOpBackward(&Z, 0);
+}
+
 TEST_F(LossBackwardTest, BatchCELoss) {
   int batch = 30;
   int m = 5;
@@ -602,6 +602,24 @@ void MatmulJitBackward<float>(const Tensor<float>& X, const Tensor<float>& Y,
 }
 #endif
 
+// Quantized Y is predict only, of rank 2 and not transposed,
+// rows of X of rank 2 or higher are multiplied by Y as a whole.
+template <typename T>
+const Shape& QuantizedMatmulPrepare(const Tensor<T>& X,
+                                    const QuantizedTensor<T>& Y, int transX,
+                                    int transY, MatmulAux* aux) {
+  DXCHECK_THROW(transX == 0 && transY == 0);
+  DXCHECK_THROW(X.rank() >= 2);
+  DXCHECK_THROW(MatmulPrepare(X.shape(), Y.shape(), 0, 0, aux));
+  return aux->Z;
+}
+
+template <typename T>
+void QuantizedMatmul(const Tensor<T>& X, const QuantizedTensor<T>& Y,
+                     Tensor<T>* Z, const MatmulAux& aux) noexcept {
+  Y.gemm(X.total_dim() / aux.k, X.data(), Z->data());
+}
+
 }  // namespace
 
 /************************************************************************/
@@ -618,10 +636,24 @@ class MatmulOp : public OpBinaryBase {
  private:
   MatmulAux aux_;
   MatmulJitAux<float_t> jaux_;
+  const qtsr_t* qY_ = nullptr;
 
  public:
   DEFINE_OP_LIKE(MatmulOp);
 
+  void InitForward() override {
+    qY_ = GetPtrQTSR(node_->input(1));
+    if (qY_ == nullptr) {
+      OpBinaryBase::InitForward();
+      return;
+    }
+    Xnode_ = node_->input(0);
+    Ynode_ = node_->input(1);
+    X_ = GetPtrTSR(Xnode_);
+    Y_ = nullptr;
+    Z_ = InitHiddenTSR(node_, QuantizedMatmulPrepare(*X_, *qY_, 0, 0, &aux_));
+  }
+
   const Shape& InferShape() override {
     DXCHECK_THROW(MatmulPrepare(X_->shape(), Y_->shape(), 0, 0, &aux_));
     MatmulJitPrepare(aux_, &jaux_);
@@ -629,11 +661,18 @@ class MatmulOp : public OpBinaryBase {
   }
 
   void InitBackward() override {
+    DXCHECK_THROW(qY_ == nullptr);
     OpBinaryBase::InitBackward();
     MatmulJitPrepareBackward(aux_, &jaux_);
   }
 
-  void Forward() override { MatmulJit(*X_, *Y_, Z_, aux_, jaux_); }
+  void Forward() override {
+    if (qY_) {
+      QuantizedMatmul(*X_, *qY_, Z_, aux_);
+    } else {
+      MatmulJit(*X_, *Y_, Z_, aux_, jaux_);
+    }
+  }
 
   void Backward() override {
     if (gZ_) {
@@ -661,10 +700,27 @@ class Matmul2Op : public OpBinaryBase {
  private:
   MatmulAux aux_;
   MatmulJitAux<float_t> jaux_;
+  const qtsr_t* qY_ = nullptr;
 
  public:
   DEFINE_OP_LIKE(Matmul2Op);
 
+  void InitForward() override {
+    qY_ = GetPtrQTSR(node_->input(1));
+    if (qY_ == nullptr) {
+      OpBinaryBase::InitForward();
+      return;
+    }
+    int transX = ((const Matmul2Node*)node_)->transX();
+    int transY = ((const Matmul2Node*)node_)->transY();
+    Xnode_ = node_->input(0);
+    Ynode_ = node_->input(1);
+    X_ = GetPtrTSR(Xnode_);
+    Y_ = nullptr;
+    Z_ = InitHiddenTSR(
+        node_, QuantizedMatmulPrepare(*X_, *qY_, transX, transY, &aux_));
+  }
+
   const Shape& InferShape() override {
     int transX = ((const Matmul2Node*)node_)->transX();
     int transY = ((const Matmul2Node*)node_)->transY();
@@ -675,11 +731,18 @@ class Matmul2Op : public OpBinaryBase {
   }
 
   void InitBackward() override {
+    DXCHECK_THROW(qY_ == nullptr);
     OpBinaryBase::InitBackward();
     MatmulJitPrepareBackward(aux_, &jaux_);
   }
 
-  void Forward() override { MatmulJit(*X_, *Y_, Z_, aux_, jaux_); }
+  void Forward() override {
+    if (qY_) {
+      QuantizedMatmul(*X_, *qY_, Z_, aux_);
+    } else {
+      MatmulJit(*X_, *Y_, Z_, aux_, jaux_);
+    }
+  }
 
   void Backward() override {
     if (gZ_) {
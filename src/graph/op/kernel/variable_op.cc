@@ -57,6 +57,15 @@ class VariableOp : public OpImpl {
 
   void InitForward() override {
     Any& Wany = param_->at(node_->name());
+    // Quantized params are predict only, see 'ModelQuantizer'.
+    if (Wany.is<qtsr_t>()) {
+      InitPtrQTSR(node_, &Wany.unsafe_to_ref<qtsr_t>());
+      return;
+    }
+    if (Wany.is<qsrm_t>()) {
+      InitPtrQSRM(node_, &Wany.unsafe_to_ref<qsrm_t>());
+      return;
+    }
     switch (node_->tensor_type()) {
       case TENSOR_TYPE_TSR: {
         auto& W = Wany.unsafe_to_ref<tsr_t>();
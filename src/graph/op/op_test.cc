@@ -137,6 +137,9 @@ void OpTestContext::InitOpContext(const inst_initializer_t& inst_initializer,
 
 void OpTestContext::InitClosedOpContext(
     const inst_initializer_t& inst_initializer) {
+  // Closed gradients are computed with intra-op threads,
+  // numerical gradients are computed without them.
+  closed_.set_intra_op_thread(4);
   InitOpContext(inst_initializer, &closed_);
 }
 
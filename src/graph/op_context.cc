@@ -2,10 +2,11 @@
 // Author: Yafei Zhang (kimmyzhang@tencent.com)
 //
 
+#include <deepx_core/common/intra_op_thread.h>
 #include <deepx_core/common/profile_util.h>
 #include <deepx_core/dx_log.h>
 #include <deepx_core/graph/op_context.h>
-#include <cstdlib>  // getenv
+#include <cstdlib>  // atoi, getenv
 #include <cstring>  // strcmp
 #include <unordered_set>
 #include <utility>
@@ -57,6 +58,11 @@ OpContext::OpContext() {
   } else {
     enable_profile_ = 0;
   }
+
+  const char* intra_op_thread = getenv("DEEPX_OP_CONTEXT_INTRA_OP_THREAD");
+  if (intra_op_thread) {
+    set_intra_op_thread(atoi(intra_op_thread));
+  }
 }
 
 OpContext::~OpContext() {
@@ -244,6 +250,7 @@ void OpContext::InitBackward() {
 }
 
 void OpContext::Forward() { // 计算图执行入口
+  IntraOpThreadGuard intra_op_guard(intra_op_thread_);
   if (!enable_profile_) {
     for (int i = 0; i < forward_chain_size_; ++i) {
       forward_chain_[i]->Forward();
@@ -258,6 +265,7 @@ void OpContext::Forward() { // 计算图执行入口
 }
 
 void OpContext::Predict() {
+  IntraOpThreadGuard intra_op_guard(intra_op_thread_);
   if (!enable_profile_) {
     for (int i = 0; i < forward_chain_size_; ++i) {
       forward_chain_[i]->Predict();
@@ -272,6 +280,7 @@ void OpContext::Predict() {
 }
 
 void OpContext::Backward() {
+  IntraOpThreadGuard intra_op_guard(intra_op_thread_);
   if (!enable_profile_) {
     grad_.ZerosValue();
 
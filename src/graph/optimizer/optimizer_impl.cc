@@ -231,6 +231,58 @@ bool OptimizerImpl::Merge(Optimizer* other, const Shard* shard, int shard_id) {
   return true;
 }
 
+bool OptimizerImpl::Split(Optimizer* other, const Shard* shard, int shard_id) {
+  if (std::string(class_name()) != other->class_name()) {
+    DXERROR("Inconsistent class name: %s vs %s.", class_name(),
+            other->class_name());
+    return false;
+  }
+
+  DXINFO("Splitting optimizer...");
+  auto* _other = (OptimizerImpl*)other;
+  if (_other->config_.empty() && !config_.empty()) {
+    if (!_other->InitConfig(config_)) {
+      return false;
+    }
+  }
+
+  auto tsr_first = tsr_slot_map_.begin();
+  auto tsr_last = tsr_slot_map_.end();
+  for (; tsr_first != tsr_last;) {
+    const std::string& name = tsr_first->first;
+    if (shard == nullptr || shard->HasTSR(shard_id, name)) {
+      DXINFO("Splitting TSR %s...", name.c_str());
+      _other->tsr_slot_map_[name] = std::move(tsr_first->second);
+      tsr_first = tsr_slot_map_.erase(tsr_first);
+    } else {
+      ++tsr_first;
+    }
+  }
+
+  for (auto& entry : srm_slot_map_) {
+    const std::string& name = entry.first;
+    OptimizerSRMSlot& local_slot = entry.second;
+    OptimizerSRMSlot& remote_slot = _other->srm_slot_map_[name];
+    if (remote_slot.O.empty()) {
+      remote_slot.O.resize(local_slot.O.size());
+    } else if (remote_slot.O.size() != local_slot.O.size()) {
+      DXERROR("Inconsistent slot size of SRM %s: %zu vs %zu.", name.c_str(),
+              local_slot.O.size(), remote_slot.O.size());
+      return false;
+    }
+
+    DXINFO("Splitting SRM %s...", name.c_str());
+    for (size_t i = 0; i < local_slot.O.size(); ++i) {
+      local_slot.O[i].split_if(
+          &remote_slot.O[i], [shard, shard_id](const srm_t::value_type& entry) {
+            return shard == nullptr || shard->HasSRM(shard_id, entry.first);
+          });
+    }
+  }
+  DXINFO("Done.");
+  return true;
+}
+
 void OptimizerImpl::Update(TensorMap* grad) {
   PreUpdate();
 
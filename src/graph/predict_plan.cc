@@ -0,0 +1,203 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/common/intra_op_thread.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/predict_plan.h>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace deepx_core {
+
+void PredictPlan::Init(const Graph* graph, TensorMap* param) noexcept {
+  graph_ = graph;
+  param_ = param;
+}
+
+bool PredictPlan::InitOp(const std::vector<std::string>& target_names) {
+  ops_.clear();
+  op_nodes_.clear();
+  target_nodes_.clear();
+  hidden_.clear();
+  hidden_.mutable_inst()->clear();
+  ptr_.clear();
+  grad_.clear();
+  grad_ptr_.clear();
+  overwritten_param_.clear();
+  overwritten_ptr_.clear();
+  batch_ = 0;
+  kernels_.clear();
+  targets_.clear();
+  instance_checks_.clear();
+
+  std::unordered_set<std::string> dedup;
+  for (const std::string& target_name : target_names) {
+    const GraphTarget* target = graph_->find_target(target_name);
+    if (target == nullptr) {
+      DXERROR("Invalid target name: %s.", target_name.c_str());
+      return false;
+    }
+
+    if (target->node()->tensor_type() != TENSOR_TYPE_TSR) {
+      DXERROR("Target %s is not a TSR.", target_name.c_str());
+      return false;
+    }
+    target_nodes_.emplace_back(target->node());
+
+    for (int j = 0; j < target->forward_size(); ++j) {  // NOLINT
+      const GraphNode* node = target->forward(j);
+      if (dedup.count(node->name()) > 0) {
+        continue;
+      }
+
+      std::unique_ptr<Op> op(NewOp(node->class_name()));
+      if (!op) {
+        return false;
+      }
+      op->Init(graph_, node, param_, &hidden_, &ptr_, &grad_, &grad_ptr_,
+               &overwritten_param_, &overwritten_ptr_);
+      ops_.emplace_back(std::move(op));
+      op_nodes_.emplace_back(node);
+      dedup.emplace(node->name());
+    }
+  }
+  return true;
+}
+
+bool PredictPlan::InitInstancePlaceholder(const GraphNode* node, int batch) {
+  Instance* inst = hidden_.mutable_inst();
+  if (inst->count(node->name()) > 0) {
+    return true;
+  }
+
+  std::vector<int> dims(node->shape().begin(), node->shape().end());
+  if (!dims.empty()) {
+    dims[0] = batch;
+  }
+  Shape shape(dims);
+
+  switch (node->tensor_type()) {
+    case TENSOR_TYPE_TSR:
+      inst->insert<tsr_t>(node->name()).resize(shape);
+      break;
+    case TENSOR_TYPE_CSR: {
+      auto& X = inst->insert<csr_t>(node->name());
+      for (int i = 0; i < batch; ++i) {
+        X.add_row();
+      }
+    } break;
+    case TENSOR_TYPE_TSRI:
+      inst->insert<tsri_t>(node->name()).resize(shape);
+      break;
+    case TENSOR_TYPE_TSRS:
+      inst->insert<tsrs_t>(node->name()).resize(shape);
+      break;
+    default:
+      DXERROR("Invalid tensor type of instance node %s: %d.",
+              node->name().c_str(), node->tensor_type());
+      return false;
+  }
+  return true;
+}
+
+bool PredictPlan::Freeze(int batch) {
+  if (batch <= 0) {
+    DXERROR("Invalid batch: %d.", batch);
+    return false;
+  }
+
+  Instance* inst = hidden_.mutable_inst();
+  for (const GraphNode* node : op_nodes_) {
+    if (node->node_type() == GRAPH_NODE_TYPE_INSTANCE &&
+        !InitInstancePlaceholder(node, batch)) {
+      return false;
+    }
+  }
+  inst->set_batch(batch);
+
+  for (auto& op : ops_) {
+    op->InitPredict();
+  }
+
+  kernels_.clear();
+  instance_checks_.clear();
+  for (size_t i = 0; i < ops_.size(); ++i) {  // NOLINT
+    const GraphNode* node = op_nodes_[i];
+    switch (node->node_type()) {
+      case GRAPH_NODE_TYPE_PARAM:
+        // Variable ops only resolve pointers of params.
+        break;
+      case GRAPH_NODE_TYPE_INSTANCE: {
+        // Instance ops only resolve pointers of instance tensors.
+        InstanceCheck check;
+        check.node = node;
+        switch (node->tensor_type()) {
+          case TENSOR_TYPE_TSR:
+            check.shape = &inst->get<tsr_t>(node->name()).shape();
+            break;
+          case TENSOR_TYPE_CSR:
+            check.csr = &inst->get<csr_t>(node->name());
+            check.row = check.csr->row();
+            break;
+          case TENSOR_TYPE_TSRI:
+            check.shape = &inst->get<tsri_t>(node->name()).shape();
+            break;
+          case TENSOR_TYPE_TSRS:
+            check.shape = &inst->get<tsrs_t>(node->name()).shape();
+            break;
+        }
+        if (check.shape) {
+          check.frozen_shape = *check.shape;
+        }
+        instance_checks_.emplace_back(std::move(check));
+      } break;
+      default:
+        kernels_.emplace_back(ops_[i].get());
+        break;
+    }
+  }
+
+  targets_.clear();
+  for (const GraphNode* target_node : target_nodes_) {
+    targets_.emplace_back(ptr_.get<tsr_t*>(target_node->name()));
+  }
+
+  batch_ = batch;
+  return true;
+}
+
+void PredictPlan::Predict() {
+  DXCHECK_THROW(frozen());
+
+  const Instance& inst = hidden_.inst();
+  if (inst.batch() != batch_) {
+    DXTHROW_INVALID_ARGUMENT("Inconsistent batch: %d vs frozen %d.",
+                             inst.batch(), batch_);
+  }
+
+  for (const InstanceCheck& check : instance_checks_) {
+    if (check.csr) {
+      if (check.csr->row() != check.row) {
+        DXTHROW_INVALID_ARGUMENT("Inconsistent row of %s: %d vs frozen %d.",
+                                 check.node->name().c_str(), check.csr->row(),
+                                 check.row);
+      }
+    } else if (check.shape) {
+      if (*check.shape != check.frozen_shape) {
+        DXTHROW_INVALID_ARGUMENT(
+            "Inconsistent shape of %s: %s vs frozen %s.",
+            check.node->name().c_str(), to_string(*check.shape).c_str(),
+            to_string(check.frozen_shape).c_str());
+      }
+    }
+  }
+
+  IntraOpThreadGuard intra_op_guard(intra_op_thread_);
+  for (Op* op : kernels_) {
+    op->Predict();
+  }
+}
+
+}  // namespace deepx_core
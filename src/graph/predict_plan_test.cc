@@ -0,0 +1,136 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/dx_gtest.h>
+#include <deepx_core/graph/graph_module_creator.h>
+#include <deepx_core/graph/instance_reader.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/graph/op_context.h>
+#include <deepx_core/graph/predict_plan.h>
+#include <deepx_core/graph/variable_scope.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace deepx_core {
+
+class PredictPlanTest : public testing::Test, public DataType {
+ protected:
+  enum { BATCH = 8 };
+  std::default_random_engine engine;
+  Graph graph;
+  Model model;
+  std::string target_name;
+
+ protected:
+  void SetUp() override {
+    std::vector<GroupConfigItem> items(2);
+    for (int i = 0; i < 2; ++i) {
+      items[i].group_id = i + 1;
+      items[i].embedding_row = 16;
+      items[i].embedding_col = 4;
+    }
+    auto* X = GetX();
+    auto* Xdense = GetInstance("Xdense", Shape(BATCH_PLACEHOLDER, 3),
+                               TENSOR_TYPE_TSR);
+    auto* E = DeepGroupEmbeddingLookup("E", X, items, 0);
+    auto* H = StackedFullyConnect("fc", Concat("", std::vector<GraphNode*>{E, Xdense}), {8, 4},
+                                  "relu");
+    auto* Z = AddBias("bias", FullyConnect("out", H, 1));
+    std::vector<GraphNode*> targets = BinaryClassificationTarget(Z, 0);
+    ASSERT_TRUE(graph.Compile(targets, 1));
+    ReleaseVariable();
+    target_name = targets[1]->name();
+
+    model.Init(&graph);
+    ASSERT_TRUE(model.InitParam(engine));
+  }
+
+  void FillInstance(int batch, Instance* inst) {
+    std::uniform_int_distribution<int_t> id_dist(0, 100);
+    std::uniform_real_distribution<float_t> value_dist(-1, 1);
+    auto& X = inst->get_or_insert<csr_t>(X_NAME);
+    X.clear();
+    for (int i = 0; i < batch; ++i) {
+      X.emplace(ll_sparse_tensor_t::make_feature_id(1, id_dist(engine)), 1);
+      X.emplace(ll_sparse_tensor_t::make_feature_id(2, id_dist(engine)),
+                value_dist(engine));
+      X.add_row();
+    }
+    auto& Xdense = inst->get_or_insert<tsr_t>("Xdense");
+    Xdense.resize(batch, 3);
+    Xdense.rand(engine, -1, 1);
+    inst->set_batch(batch);
+  }
+};
+
+TEST_F(PredictPlanTest, Predict) {
+  PredictPlan plan;
+  plan.Init(&graph, model.mutable_param());
+  ASSERT_TRUE(plan.InitOp({target_name}));
+  ASSERT_TRUE(plan.Freeze(BATCH));
+  ASSERT_EQ(plan.batch(), BATCH);
+  ASSERT_EQ(plan.target_size(), 1);
+  ASSERT_GT(plan.kernel_size(), 0);
+  EXPECT_EQ(plan.target(0).shape(), Shape(BATCH, 1));
+
+  OpContext op_context;
+  op_context.Init(&graph, model.mutable_param());
+  ASSERT_TRUE(op_context.InitOp(std::vector<std::string>{target_name}, -1));
+
+  for (int k = 0; k < 3; ++k) {
+    FillInstance(BATCH, op_context.mutable_inst());
+    // in place
+    plan.mutable_inst()->get<csr_t>(X_NAME) =
+        op_context.inst().get<csr_t>(X_NAME);
+    plan.mutable_inst()->get<tsr_t>("Xdense") =
+        op_context.inst().get<tsr_t>("Xdense");
+    op_context.InitPredict();
+    op_context.Predict();
+    plan.Predict();
+
+    const auto& expected = op_context.hidden().get<tsr_t>(target_name);
+    const auto& P = plan.target(0);
+    ASSERT_EQ(P.shape(), expected.shape());
+    for (int i = 0; i < P.total_dim(); ++i) {
+      EXPECT_NEAR(P.data(i), expected.data(i), 1e-6);
+    }
+  }
+}
+
+TEST_F(PredictPlanTest, Predict_inconsistent_shape) {
+  PredictPlan plan;
+  plan.Init(&graph, model.mutable_param());
+  ASSERT_TRUE(plan.InitOp({target_name}));
+  ASSERT_TRUE(plan.Freeze(BATCH));
+
+  FillInstance(BATCH, plan.mutable_inst());
+  plan.Predict();
+
+  FillInstance(BATCH + 1, plan.mutable_inst());
+  EXPECT_ANY_THROW(plan.Predict());
+
+  FillInstance(BATCH, plan.mutable_inst());
+  plan.mutable_inst()->get<tsr_t>("Xdense").resize(BATCH, 4);
+  EXPECT_ANY_THROW(plan.Predict());
+}
+
+TEST_F(PredictPlanTest, Freeze_filled_instance) {
+  PredictPlan plan;
+  plan.Init(&graph, model.mutable_param());
+  ASSERT_TRUE(plan.InitOp({target_name}));
+  FillInstance(BATCH, plan.mutable_inst());
+  ASSERT_TRUE(plan.Freeze(BATCH));
+  plan.Predict();
+  EXPECT_EQ(plan.target(0).shape(), Shape(BATCH, 1));
+}
+
+TEST_F(PredictPlanTest, InitOp_invalid_target) {
+  PredictPlan plan;
+  plan.Init(&graph, model.mutable_param());
+  ASSERT_FALSE(plan.InitOp({"not_exist"}));
+  ASSERT_FALSE(plan.Freeze(0));
+}
+
+}  // namespace deepx_core
@@ -6,9 +6,13 @@
 #include <deepx_core/common/hash.h>
 #include <deepx_core/dx_log.h>
 #include <deepx_core/graph/shard.h>
+#include <algorithm>  // std::sort, std::upper_bound
+#include <atomic>
 #include <cstdint>
+#include <mutex>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace deepx_core {
 namespace {
@@ -44,6 +48,83 @@ class ModuloShardFunc : public DataType {
   }
 };
 
+/************************************************************************/
+/* ConsistentHashRing */
+/************************************************************************/
+// ConsistentHashRing places 'VIRTUAL_NODE' virtual nodes of each shard on
+// a 64-bit hash ring, a key belongs to the first virtual node after it.
+//
+// Growing 'shard_size' from n to n + 1 only moves about 1 / (n + 1) keys,
+// all of which move to the new shard.
+class ConsistentHashRing {
+ public:
+  static constexpr int VIRTUAL_NODE = 160;  // magic number
+  static constexpr int MAX_SHARD_SIZE = 4096;  // magic number
+
+ private:
+  std::vector<std::pair<uint64_t, int>> points_;
+
+ public:
+  explicit ConsistentHashRing(int shard_size) {
+    points_.reserve((size_t)shard_size * VIRTUAL_NODE);
+    for (int i = 0; i < shard_size; ++i) {
+      for (int j = 0; j < VIRTUAL_NODE; ++j) {
+        uint64_t point = ((uint64_t)(uint32_t)i << 32) | (uint32_t)j;
+        points_.emplace_back(MurmurHash3Mix(point), i);
+      }
+    }
+    std::sort(points_.begin(), points_.end());
+  }
+
+  int Get(uint64_t key) const noexcept {
+    auto it = std::upper_bound(
+        points_.begin(), points_.end(), key,
+        [](uint64_t key, const std::pair<uint64_t, int>& point) {
+          return key < point.first;
+        });
+    if (it == points_.end()) {
+      it = points_.begin();
+    }
+    return it->second;
+  }
+
+ public:
+  // Rings are built on first use and never freed.
+  static const ConsistentHashRing* GetRing(int shard_size) {
+    if (shard_size <= 0 || shard_size > MAX_SHARD_SIZE) {
+      DXTHROW_INVALID_ARGUMENT("Invalid shard_size: %d.", shard_size);
+    }
+    static std::atomic<const ConsistentHashRing*> rings[MAX_SHARD_SIZE + 1];
+    static std::mutex mutex;
+    std::atomic<const ConsistentHashRing*>& ring = rings[shard_size];
+    const ConsistentHashRing* p = ring.load(std::memory_order_acquire);
+    if (p == nullptr) {
+      std::lock_guard<std::mutex> guard(mutex);
+      p = ring.load(std::memory_order_relaxed);
+      if (p == nullptr) {
+        p = new ConsistentHashRing(shard_size);
+        ring.store(p, std::memory_order_release);
+      }
+    }
+    return p;
+  }
+};
+
+/************************************************************************/
+/* ConsistentHashShardFunc */
+/************************************************************************/
+class ConsistentHashShardFunc : public DataType {
+ public:
+  static int TSRShardFunc(const std::string& name, int shard_size) {
+    return ConsistentHashRing::GetRing(shard_size)->Get(MurmurHash2(name));
+  }
+
+  static int SRMShardFunc(int_t id, int shard_size) {
+    return ConsistentHashRing::GetRing(shard_size)->Get(
+        MurmurHash3Mix((uint64_t)id));
+  }
+};
+
 /************************************************************************/
 /* ShardFuncMap */
 /************************************************************************/
@@ -108,6 +189,18 @@ class ModuloShardFuncRegister {
   }
 } modulo_shard_func_register;
 
+/************************************************************************/
+/* ConsistentHashShardFuncRegister */
+/************************************************************************/
+class ConsistentHashShardFuncRegister {
+ public:
+  ConsistentHashShardFuncRegister() {
+    ShardFuncMap::GetInstance().Register(
+        "consistent_hash", &ConsistentHashShardFunc::TSRShardFunc,
+        &ConsistentHashShardFunc::SRMShardFunc);
+  }
+} consistent_hash_shard_func_register;
+
 }  // namespace
 
 /************************************************************************/
@@ -0,0 +1,83 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/common/stream.h>
+#include <deepx_core/graph/shard.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace deepx_core {
+
+class ShardTest : public testing::Test, public DataType {};
+
+TEST_F(ShardTest, WriteRead) {
+  Shard shard, read_shard;
+  shard.InitShard(3, "consistent_hash");
+
+  OutputStringStream os;
+  InputStringStream is;
+  ASSERT_TRUE(shard.Write(os));
+  is.SetView(os.GetBuf());
+  ASSERT_TRUE(read_shard.Read(is));
+
+  EXPECT_EQ(read_shard.shard_mode(), 1);
+  EXPECT_EQ(read_shard.shard_size(), 3);
+  EXPECT_EQ(read_shard.shard_func_name(), "consistent_hash");
+  for (int_t id = 0; id < 1000; ++id) {
+    EXPECT_EQ(read_shard.GetSRMShardId(id), shard.GetSRMShardId(id));
+  }
+}
+
+TEST_F(ShardTest, consistent_hash_balance) {
+  const int ID = 100000;
+  for (int shard_size : {1, 2, 3, 8, 16}) {
+    Shard shard;
+    shard.InitShard(shard_size, "consistent_hash");
+    std::vector<int> counts(shard_size);
+    for (int_t id = 0; id < (int_t)ID; ++id) {
+      int shard_id = shard.GetSRMShardId(id);
+      ASSERT_GE(shard_id, 0);
+      ASSERT_LT(shard_id, shard_size);
+      ++counts[shard_id];
+    }
+    for (int count : counts) {
+      EXPECT_GT(count, ID / shard_size * 3 / 4);
+      EXPECT_LT(count, ID / shard_size * 5 / 4);
+    }
+  }
+}
+
+TEST_F(ShardTest, consistent_hash_grow) {
+  const int ID = 100000;
+  for (int shard_size : {1, 2, 3, 8, 16}) {
+    Shard shard, new_shard;
+    shard.InitShard(shard_size, "consistent_hash");
+    new_shard.InitShard(shard_size + 1, "consistent_hash");
+    int moved = 0;
+    for (int_t id = 0; id < (int_t)ID; ++id) {
+      int shard_id = shard.GetSRMShardId(id);
+      int new_shard_id = new_shard.GetSRMShardId(id);
+      if (shard_id != new_shard_id) {
+        // Ids only move to the new shard.
+        ASSERT_EQ(new_shard_id, shard_size);
+        ++moved;
+      }
+    }
+    EXPECT_GT(moved, ID / (shard_size + 1) * 3 / 4);
+    EXPECT_LT(moved, ID / (shard_size + 1) * 5 / 4);
+
+    for (int i = 0; i < 100; ++i) {
+      std::string name = "W" + std::to_string(i);
+      int shard_id = shard.GetTSRShardId(name);
+      int new_shard_id = new_shard.GetTSRShardId(name);
+      if (shard_id != new_shard_id) {
+        ASSERT_EQ(new_shard_id, shard_size);
+      }
+    }
+  }
+}
+
+}  // namespace deepx_core
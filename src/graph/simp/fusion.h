@@ -0,0 +1,21 @@
+// Copyright 2021 the deepx authors.
+// Author: Chuan Cheng (chuancheng@tencent.com)
+//
+
+#pragma once
+#include "simp_impl.h"
+
+namespace deepx_core {
+
+/************************************************************************/
+/* FusionSimp */
+/************************************************************************/
+// Fuse chains of nodes into fused nodes, whose ops make one pass over
+// memory in forward and backward.
+class FusionSimp : public Simp {
+ public:
+  FusionSimp();
+  bool Simplify(SimpItem* item) const override;
+};
+
+}  // namespace deepx_core
@@ -0,0 +1,349 @@
+// Copyright 2021 the deepx authors.
+// Author: Chuan Cheng (chuancheng@tencent.com)
+//
+
+#include "fusion_impl.h"
+#include <algorithm>  // std::find
+#include <memory>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace deepx_core {
+namespace {
+
+// Return the fused op of the type of 'node',
+// FUSED_OP_NONE for FusedElementWiseNode, -1 for others.
+int GetFusedOpOfType(const GraphNode* node) noexcept {
+  static const std::unordered_map<std::type_index, int> TYPE_2_FUSED_OP = {
+      {typeid(SigmoidNode), FusedElementWiseNode::FUSED_OP_SIGMOID},
+      {typeid(TanhNode), FusedElementWiseNode::FUSED_OP_TANH},
+      {typeid(ReluNode), FusedElementWiseNode::FUSED_OP_RELU},
+      {typeid(ExpNode), FusedElementWiseNode::FUSED_OP_EXP},
+      {typeid(LogNode), FusedElementWiseNode::FUSED_OP_LOG},
+      {typeid(NegateNode), FusedElementWiseNode::FUSED_OP_NEGATE},
+      {typeid(InvNode), FusedElementWiseNode::FUSED_OP_INV},
+      {typeid(SqrtNode), FusedElementWiseNode::FUSED_OP_SQRT},
+      {typeid(SquareNode), FusedElementWiseNode::FUSED_OP_SQUARE},
+      {typeid(AddNode), FusedElementWiseNode::FUSED_OP_ADD},
+      {typeid(BroadcastAddNode), FusedElementWiseNode::FUSED_OP_ADD},
+      {typeid(SubNode), FusedElementWiseNode::FUSED_OP_SUB},
+      {typeid(BroadcastSubNode), FusedElementWiseNode::FUSED_OP_SUB},
+      {typeid(MulNode), FusedElementWiseNode::FUSED_OP_MUL},
+      {typeid(BroadcastMulNode), FusedElementWiseNode::FUSED_OP_MUL},
+      {typeid(FusedElementWiseNode), FusedElementWiseNode::FUSED_OP_NONE}};
+  auto it = TYPE_2_FUSED_OP.find(node->type_index());
+  if (it == TYPE_2_FUSED_OP.end()) {
+    return -1;
+  }
+  return it->second;
+}
+
+bool RunPipeline(SimpContext* ctx, SimpItem* item,
+                 std::vector<std::unique_ptr<SimpStage>> stages) {
+  SimpPipeline pipeline(ctx, std::move(stages));
+  ctx->Init(item);
+  bool simplified = false;
+  while (!ctx->nodes_to_simp.Empty()) {
+    GraphNode* node = ctx->nodes_to_simp.PopBack();
+    if (pipeline.TrySimplify(node)) {
+      simplified = true;
+    }
+  }
+  ctx->item->Prune();
+  return simplified;
+}
+
+}  // namespace
+
+/************************************************************************/
+/* FusionStageBase */
+/************************************************************************/
+bool FusionStageBase::Absorbable(const GraphNode* node) const noexcept {
+  return !IsTarget(node) && IsSingleOutput(node);
+}
+
+bool FusionStageBase::ReplaceWithFused(GraphNode* fused) {
+  if (!ctx_->item->ReplaceNode(fused)) {
+    delete fused;
+    return false;
+  }
+  ctx_->nodes_to_simp.PushBack(fused);
+  return true;
+}
+
+bool FusionStageBase::GetFullyConnectBias(const GraphNode* node,
+                                          GraphNode** X, GraphNode** W,
+                                          GraphNode** b) const noexcept {
+  if (node->type_index() != typeid(BroadcastAddNode)) {
+    return false;
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    GraphNode* H = node->input()[i];
+    GraphNode* _b = node->input()[1 - i];
+    if (H->type_index() != typeid(FullyConnectNode) || H->input_size() != 2 ||
+        !Absorbable(H)) {
+      continue;
+    }
+    const Shape& Hshape = H->shape();
+    if (!Hshape.is_rank(2) || Hshape != node->shape() ||
+        _b->shape() != Shape(1, Hshape[1])) {
+      continue;
+    }
+    *X = H->input()[0];
+    *W = H->input()[1];
+    *b = _b;
+    return true;
+  }
+  return false;
+}
+
+/************************************************************************/
+/* FuseFullyConnectBiasStage */
+/************************************************************************/
+bool FuseFullyConnectBiasStage::MaySimplify(const GraphNode* node) const
+    noexcept {
+  return node->type_index() == typeid(BroadcastAddNode);
+}
+
+bool FuseFullyConnectBiasStage::TrySimplify(GraphNode* node) {
+  GraphNode *X, *W, *b;
+  if (!GetFullyConnectBias(node, &X, &W, &b)) {
+    return false;
+  }
+  return ReplaceWithFused(new FullyConnectNode(node->name(), X, W, b));
+}
+
+/************************************************************************/
+/* FuseFullyConnectActivationStage */
+/************************************************************************/
+int FuseFullyConnectActivationStage::GetActivation(
+    const GraphNode* node) noexcept {
+  if (node->type_index() == typeid(SigmoidNode)) {
+    return FusedFullyConnectNode::ACTIVATION_SIGMOID;
+  } else if (node->type_index() == typeid(TanhNode)) {
+    return FusedFullyConnectNode::ACTIVATION_TANH;
+  } else if (node->type_index() == typeid(ReluNode)) {
+    return FusedFullyConnectNode::ACTIVATION_RELU;
+  }
+  return FusedFullyConnectNode::ACTIVATION_NONE;
+}
+
+bool FuseFullyConnectActivationStage::MaySimplify(const GraphNode* node) const
+    noexcept {
+  return GetActivation(node) != FusedFullyConnectNode::ACTIVATION_NONE;
+}
+
+bool FuseFullyConnectActivationStage::TrySimplify(GraphNode* node) {
+  GraphNode* H = node->input()[0];
+  if (!Absorbable(H)) {
+    return false;
+  }
+
+  GraphNode *X, *W, *b = nullptr;
+  if (H->type_index() == typeid(FullyConnectNode) ||
+      (H->type_index() == typeid(FusedFullyConnectNode) &&
+       ((const FusedFullyConnectNode*)H)->activation() ==
+           FusedFullyConnectNode::ACTIVATION_NONE)) {
+    X = H->input()[0];
+    W = H->input()[1];
+    if (H->input_size() == 3) {
+      b = H->input()[2];
+    }
+  } else if (!GetFullyConnectBias(H, &X, &W, &b)) {
+    return false;
+  }
+
+  int activation = GetActivation(node);
+  GraphNode* fused;
+  if (b) {
+    fused = new FusedFullyConnectNode(node->name(), X, W, b, activation);
+  } else {
+    fused = new FusedFullyConnectNode(node->name(), X, W, activation);
+  }
+  return ReplaceWithFused(fused);
+}
+
+/************************************************************************/
+/* FuseSigmoidBCELossStage */
+/************************************************************************/
+bool FuseSigmoidBCELossStage::MaySimplify(const GraphNode* node) const
+    noexcept {
+  return node->type_index() == typeid(ReduceMeanNode) &&
+         ((const ReduceMeanNode*)node)->reduce_all();
+}
+
+bool FuseSigmoidBCELossStage::TrySimplify(GraphNode* node) {
+  GraphNode* L = node->input()[0];
+  if (IsAbsorbableSigmoidBCELoss(L)) {
+    return ReplaceWithFused(new FusedSigmoidBCELossNode(
+        node->name(), L->input()[0], L->input()[1]));
+  }
+
+  if (L->type_index() != typeid(MulNode) || !Absorbable(L)) {
+    return false;
+  }
+  for (int i = 0; i < 2; ++i) {
+    GraphNode* _L = L->input()[i];
+    GraphNode* W = L->input()[1 - i];
+    if (IsAbsorbableSigmoidBCELoss(_L)) {
+      return ReplaceWithFused(new FusedSigmoidBCELossNode(
+          node->name(), _L->input()[0], _L->input()[1], W));
+    }
+  }
+  return false;
+}
+
+bool FuseSigmoidBCELossStage::IsAbsorbableSigmoidBCELoss(
+    const GraphNode* node) const noexcept {
+  return node->type_index() == typeid(SigmoidBCELossNode) && Absorbable(node);
+}
+
+/************************************************************************/
+/* FuseElementWiseStage */
+/************************************************************************/
+bool FuseElementWiseStage::GetFusedOp(const GraphNode* node, int* op,
+                                      int* chain_input) const noexcept {
+  *op = GetFusedOpOfType(node);
+  if (*op == -1) {
+    return false;
+  }
+
+  if (!FusedElementWiseNode::IsBinaryOp(*op)) {
+    *chain_input = 0;
+    return true;
+  }
+
+  const Shape& Z = node->shape();
+  const GraphNode* X = node->input(0);
+  const GraphNode* Y = node->input(1);
+  bool X_on_chain = X->shape() == Z &&
+                    FusedElementWiseNode::IsBroadcastable(Z, Y->shape());
+  bool Y_on_chain = Y->shape() == Z &&
+                    FusedElementWiseNode::IsBroadcastable(Z, X->shape());
+  if (X_on_chain && Y_on_chain) {
+    // prefer the input which can be absorbed
+    if (!IsChainMember(X, Z) && IsChainMember(Y, Z)) {
+      X_on_chain = false;
+    }
+  }
+
+  if (X_on_chain) {
+    *chain_input = 0;
+  } else if (Y_on_chain) {
+    *chain_input = 1;
+    if (*op == FusedElementWiseNode::FUSED_OP_SUB) {
+      *op = FusedElementWiseNode::FUSED_OP_RSUB;
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool FuseElementWiseStage::IsChainMember(const GraphNode* node,
+                                         const Shape& shape) const noexcept {
+  return GetFusedOpOfType(node) != -1 && node->shape() == shape &&
+         Absorbable(node);
+}
+
+bool FuseElementWiseStage::MaySimplify(const GraphNode* node) const noexcept {
+  int op, chain_input;
+  return !node->shape().empty() && GetFusedOp(node, &op, &chain_input);
+}
+
+bool FuseElementWiseStage::TrySimplify(GraphNode* node) {
+  const Shape& shape = node->shape();
+  // ops and Ys from 'node' to X0
+  std::vector<int> ops;
+  std::vector<GraphNode*> Ys;
+  int members = 0;
+  GraphNode* X0 = node;
+  while (members == 0 || IsChainMember(X0, shape)) {
+    int op, chain_input;
+    if (!GetFusedOp(X0, &op, &chain_input)) {
+      break;
+    }
+
+    if (op == FusedElementWiseNode::FUSED_OP_NONE) {
+      const auto* fused = (const FusedElementWiseNode*)X0;
+      int op_size = (int)fused->ops().size();
+      if ((int)ops.size() + op_size > FusedElementWiseNode::MAX_FUSED_OP) {
+        break;
+      }
+      for (int i = op_size - 1; i >= 0; --i) {
+        int operand = fused->operands()[i];
+        ops.emplace_back(fused->ops()[i]);
+        Ys.emplace_back(operand >= 0 ? X0->input()[operand] : nullptr);
+      }
+    } else {
+      if ((int)ops.size() + 1 > FusedElementWiseNode::MAX_FUSED_OP) {
+        break;
+      }
+      ops.emplace_back(op);
+      Ys.emplace_back(FusedElementWiseNode::IsBinaryOp(op)
+                          ? X0->input()[1 - chain_input]
+                          : nullptr);
+    }
+    ++members;
+    X0 = X0->input()[chain_input];
+  }
+
+  if (members < 2) {
+    return false;
+  }
+
+  std::vector<GraphNode*> X{X0};
+  std::vector<int> fused_ops, operands;
+  for (int i = (int)ops.size() - 1; i >= 0; --i) {
+    fused_ops.emplace_back(ops[i]);
+    if (Ys[i] == nullptr) {
+      operands.emplace_back(-1);
+      continue;
+    }
+    auto it = std::find(X.begin(), X.end(), Ys[i]);
+    operands.emplace_back((int)(it - X.begin()));
+    if (it == X.end()) {
+      X.emplace_back(Ys[i]);
+    }
+  }
+  return ReplaceWithFused(new FusedElementWiseNode(
+      node->name(), std::move(X), std::move(fused_ops), std::move(operands)));
+}
+
+/************************************************************************/
+/* FusionSimp */
+/************************************************************************/
+FusionSimp::FusionSimp() : Simp("fusion") {}
+
+bool FusionSimp::Simplify(SimpItem* mutable_item) const {
+  SimpContext ctx;
+  bool simplified = false;
+
+  // Stages run in separate pipelines in order, because bias adds,
+  // activations and muls of the loss must not be absorbed into
+  // FusedElementWise before other stages see them.
+  std::vector<std::unique_ptr<SimpStage>> stages;
+  stages.emplace_back(new FuseFullyConnectActivationStage(name(), &ctx));
+  stages.emplace_back(new FuseFullyConnectBiasStage(name(), &ctx));
+  if (RunPipeline(&ctx, mutable_item, std::move(stages))) {
+    simplified = true;
+  }
+
+  stages.clear();
+  stages.emplace_back(new FuseSigmoidBCELossStage(name(), &ctx));
+  if (RunPipeline(&ctx, mutable_item, std::move(stages))) {
+    simplified = true;
+  }
+
+  stages.clear();
+  stages.emplace_back(new FuseElementWiseStage(name(), &ctx));
+  if (RunPipeline(&ctx, mutable_item, std::move(stages))) {
+    simplified = true;
+  }
+  return simplified;
+}
+
+}  // namespace deepx_core
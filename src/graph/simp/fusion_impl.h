@@ -0,0 +1,91 @@
+// Copyright 2021 the deepx authors.
+// Author: Chuan Cheng (chuancheng@tencent.com)
+//
+
+#pragma once
+#include <string>
+#include "fusion.h"
+#include "simp_stage.h"
+
+namespace deepx_core {
+
+#define DEFINE_FUSION_STAGE_LIKE(clazz_name)                 \
+  clazz_name(const std::string& simp_name, SimpContext* ctx) \
+      : FusionStageBase(simp_name, #clazz_name, ctx) {}
+
+// Fused nodes take over the names of the nodes they replace,
+// so targets are fused too.
+class FusionStageBase : public SimpStage {
+ public:
+  DEFINE_SIMP_STAGE_LIKE_BASE(FusionStageBase);
+
+ protected:
+  // Return if 'node' can be absorbed into a fused node of its output.
+  bool Absorbable(const GraphNode* node) const noexcept;
+  // 'fused' has the same name as the node it replaces.
+  bool ReplaceWithFused(GraphNode* fused);
+  // Return if 'node' is BroadcastAdd(H, b) or BroadcastAdd(b, H),
+  // H is an absorbable FullyConnect(X, W) and b is of shape (1, n).
+  bool GetFullyConnectBias(const GraphNode* node, GraphNode** X,
+                           GraphNode** W, GraphNode** b) const noexcept;
+};
+
+// FullyConnect(X, W) + b -> FullyConnect(X, W, b)
+class FuseFullyConnectBiasStage : public FusionStageBase {
+ public:
+  DEFINE_FUSION_STAGE_LIKE(FuseFullyConnectBiasStage);
+
+ public:
+  bool MaySimplify(const GraphNode* node) const noexcept override;
+  bool TrySimplify(GraphNode* node) override;
+};
+
+// Sigmoid/Tanh/Relu(FullyConnect(X, W[, b]) [+ b])
+// -> FusedFullyConnect(X, W, b, activation)
+class FuseFullyConnectActivationStage : public FusionStageBase {
+ public:
+  DEFINE_FUSION_STAGE_LIKE(FuseFullyConnectActivationStage);
+
+ public:
+  bool MaySimplify(const GraphNode* node) const noexcept override;
+  bool TrySimplify(GraphNode* node) override;
+
+ private:
+  static int GetActivation(const GraphNode* node) noexcept;
+};
+
+// ReduceMean(SigmoidBCELoss(X, Y)) -> FusedSigmoidBCELoss(X, Y)
+// ReduceMean(Mul(SigmoidBCELoss(X, Y), W)) -> FusedSigmoidBCELoss(X, Y, W)
+class FuseSigmoidBCELossStage : public FusionStageBase {
+ public:
+  DEFINE_FUSION_STAGE_LIKE(FuseSigmoidBCELossStage);
+
+ public:
+  bool MaySimplify(const GraphNode* node) const noexcept override;
+  bool TrySimplify(GraphNode* node) override;
+
+ private:
+  bool IsAbsorbableSigmoidBCELoss(const GraphNode* node) const noexcept;
+};
+
+// A chain of element-wise unary/binary/broadcast nodes -> FusedElementWise
+class FuseElementWiseStage : public FusionStageBase {
+ public:
+  DEFINE_FUSION_STAGE_LIKE(FuseElementWiseStage);
+
+ public:
+  bool MaySimplify(const GraphNode* node) const noexcept override;
+  bool TrySimplify(GraphNode* node) override;
+
+ private:
+  // Get the fused op of 'node' and the index of its input along the chain.
+  bool GetFusedOp(const GraphNode* node, int* op, int* chain_input) const
+      noexcept;
+  // Return if 'node' can be absorbed into a chain of 'shape'.
+  bool IsChainMember(const GraphNode* node, const Shape& shape) const
+      noexcept;
+};
+
+#undef DEFINE_FUSION_STAGE_LIKE
+
+}  // namespace deepx_core
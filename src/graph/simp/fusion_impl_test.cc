@@ -0,0 +1,276 @@
+// Copyright 2021 the deepx authors.
+// Author: Chuan Cheng (chuancheng@tencent.com)
+//
+
+#include "fusion_impl.h"
+#include <deepx_core/graph/graph_module_creator.h>
+#include <deepx_core/graph/variable_scope.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "simp_test.h"
+
+namespace deepx_core {
+
+class FusionSimpStageTest : public SimpStageTestBase {
+ protected:
+  void SetUp() override { simp_name = "fusion_simp"; }
+
+  const FusedElementWiseNode* FindFusedElementWise(const std::string& name) {
+    return (const FusedElementWiseNode*)item.find_node(name);
+  }
+};
+
+/*
+ *    ReduceMean                      ReduceMean
+ *        |                               |
+ *   BroadcastAdd           ->      *FullyConnect
+ *     /      \                     /     |     \
+ * FullyConnect  b                 X      W      b
+ *    /  \
+ *   X    W
+ */
+TEST_F(FusionSimpStageTest, FuseFullyConnectBiasStage) {
+  auto* X = new InstanceNode("X", Shape(2, 3), TENSOR_TYPE_TSR);
+  auto* W = new VariableNode("W", Shape(3, 4));
+  auto* b = new VariableNode("b", Shape(1, 4));
+  auto* fc = FullyConnect("FullyConnect", X, W);
+  auto* add = BroadcastAdd("BroadcastAdd", fc, b);
+  auto* reduce_mean = ReduceMean("ReduceMean", add);
+  ASSERT_TRUE(graph.Compile({reduce_mean}, 1));
+  item.FromGraph(graph);
+
+  stage.reset(new FuseFullyConnectBiasStage(simp_name, &ctx));
+  SimplifyTwice();
+  ASSERT_EQ(5, item.node_size());
+  AssertNodesDeleted({fc});
+  AssertTypeEQ(add->name(), typeid(FullyConnectNode));
+  AssertInputsEQ(add->name(), {X->name(), W->name(), b->name()});
+  AssertInputsEQ(reduce_mean->name(), {add->name()});
+}
+
+/*
+ *      Relu1(target)             *Relu1(target)
+ *        |                       /    |     \
+ *   FullyConnect1               X     W      b
+ *    /   |   \
+ *   X    W    b          ->
+ *
+ *      Sigmoid2(target)          *Sigmoid2(target)
+ *        |                       /    |     \
+ *   BroadcastAdd2               X     W      b
+ *     /      \
+ * FullyConnect2  b
+ *    /  \
+ *   X    W
+ */
+TEST_F(FusionSimpStageTest, FuseFullyConnectActivationStage) {
+  auto* X = new InstanceNode("X", Shape(2, 3), TENSOR_TYPE_TSR);
+  auto* W = new VariableNode("W", Shape(3, 4));
+  auto* b = new VariableNode("b", Shape(1, 4));
+  auto* fc1 = FullyConnect("FullyConnect1", X, W, b);
+  auto* relu1 = Relu("Relu1", fc1);
+  auto* fc2 = FullyConnect("FullyConnect2", X, W);
+  auto* add2 = BroadcastAdd("BroadcastAdd2", fc2, b);
+  auto* sigmoid2 = Sigmoid("Sigmoid2", add2);
+  ASSERT_TRUE(graph.Compile({relu1, sigmoid2}, 1));
+  item.FromGraph(graph);
+
+  stage.reset(new FuseFullyConnectActivationStage(simp_name, &ctx));
+  SimplifyTwice();
+  ASSERT_EQ(5, item.node_size());
+  AssertNodesDeleted({fc1, fc2, add2});
+  AssertTypeEQ(relu1->name(), typeid(FusedFullyConnectNode));
+  AssertInputsEQ(relu1->name(), {X->name(), W->name(), b->name()});
+  ASSERT_EQ(((const FusedFullyConnectNode*)item.find_node(relu1->name()))
+                ->activation(),
+            FusedFullyConnectNode::ACTIVATION_RELU);
+  AssertTypeEQ(sigmoid2->name(), typeid(FusedFullyConnectNode));
+  AssertInputsEQ(sigmoid2->name(), {X->name(), W->name(), b->name()});
+  ASSERT_EQ(((const FusedFullyConnectNode*)item.find_node(sigmoid2->name()))
+                ->activation(),
+            FusedFullyConnectNode::ACTIVATION_SIGMOID);
+}
+
+TEST_F(FusionSimpStageTest, FuseFullyConnectActivationStage_multi_output) {
+  auto* X = new InstanceNode("X", Shape(2, 3), TENSOR_TYPE_TSR);
+  auto* W = new VariableNode("W", Shape(3, 4));
+  auto* b = new VariableNode("b", Shape(1, 4));
+  auto* fc = FullyConnect("FullyConnect", X, W, b);
+  auto* tanh = Tanh("Tanh", fc);
+  auto* reduce_mean = ReduceMean("ReduceMean", fc);
+  ASSERT_TRUE(graph.Compile({tanh, reduce_mean}, 1));
+  item.FromGraph(graph);
+
+  stage.reset(new FuseFullyConnectActivationStage(simp_name, &ctx));
+  SimplifyTwice();
+  ASSERT_EQ(6, item.node_size());
+  AssertTypeEQ(tanh->name(), typeid(TanhNode));
+}
+
+/*
+ *  ReduceMean(target)           *ReduceMean(target)
+ *        |                          /   |   \
+ *       Mul                        X    Y    W
+ *      /   \               ->
+ * SigmoidBCELoss  W
+ *    /   \
+ *   X     Y
+ */
+TEST_F(FusionSimpStageTest, FuseSigmoidBCELossStage) {
+  auto* X = new InstanceNode("X", Shape(2, 3), TENSOR_TYPE_TSR);
+  auto* Y = new InstanceNode("Y", Shape(2, 3), TENSOR_TYPE_TSR);
+  auto* SW = new InstanceNode("SW", Shape(2, 3), TENSOR_TYPE_TSR);
+  auto* loss = SigmoidBCELoss("SigmoidBCELoss", X, Y);
+  auto* mul = Mul("Mul", loss, SW);
+  auto* reduce_mean = ReduceMean("ReduceMean", mul);
+  ASSERT_TRUE(graph.Compile({reduce_mean}, 1));
+  item.FromGraph(graph);
+
+  stage.reset(new FuseSigmoidBCELossStage(simp_name, &ctx));
+  SimplifyTwice();
+  ASSERT_EQ(4, item.node_size());
+  AssertNodesDeleted({loss, mul});
+  AssertTypeEQ(reduce_mean->name(), typeid(FusedSigmoidBCELossNode));
+  AssertInputsEQ(reduce_mean->name(), {X->name(), Y->name(), SW->name()});
+}
+
+TEST_F(FusionSimpStageTest, FuseSigmoidBCELossStage_no_W) {
+  auto* X = new InstanceNode("X", Shape(2, 3), TENSOR_TYPE_TSR);
+  auto* Y = new InstanceNode("Y", Shape(2, 3), TENSOR_TYPE_TSR);
+  auto* loss = SigmoidBCELoss("SigmoidBCELoss", X, Y);
+  auto* reduce_mean = ReduceMean("ReduceMean", loss);
+  auto* P = Sigmoid("P", X);
+  ASSERT_TRUE(graph.Compile({reduce_mean, P}, 1));
+  item.FromGraph(graph);
+
+  stage.reset(new FuseSigmoidBCELossStage(simp_name, &ctx));
+  SimplifyTwice();
+  ASSERT_EQ(4, item.node_size());
+  AssertNodesDeleted({loss});
+  AssertTypeEQ(reduce_mean->name(), typeid(FusedSigmoidBCELossNode));
+  AssertInputsEQ(reduce_mean->name(), {X->name(), Y->name()});
+}
+
+/*
+ *    ReduceMean                     ReduceMean
+ *        |                              |
+ *     Sigmoid                   *Sigmoid(FusedElementWise)
+ *        |                          /   |   \
+ *   BroadcastSub         ->        X    Y    b
+ *     /      \
+ *    b       Mul
+ *           /   \
+ *         Exp    Y
+ *          |
+ *          X
+ */
+TEST_F(FusionSimpStageTest, FuseElementWiseStage) {
+  auto* X = new InstanceNode("X", Shape(2, 3), TENSOR_TYPE_TSR);
+  auto* Y = new InstanceNode("Y", Shape(2, 3), TENSOR_TYPE_TSR);
+  auto* c = new VariableNode("c", Shape(1, 3));
+  auto* exp = Exp("Exp", X);
+  auto* mul = Mul("Mul", exp, Y);
+  auto* sub = BroadcastSub("BroadcastSub", c, mul);
+  auto* sigmoid = Sigmoid("Sigmoid", sub);
+  auto* reduce_mean = ReduceMean("ReduceMean", sigmoid);
+  ASSERT_TRUE(graph.Compile({reduce_mean}, 1));
+  item.FromGraph(graph);
+
+  stage.reset(new FuseElementWiseStage(simp_name, &ctx));
+  SimplifyTwice();
+  ASSERT_EQ(5, item.node_size());
+  AssertNodesDeleted({exp, mul, sub});
+  AssertTypeEQ(sigmoid->name(), typeid(FusedElementWiseNode));
+  AssertInputsEQ(sigmoid->name(), {X->name(), Y->name(), c->name()});
+  const auto* fused = FindFusedElementWise(sigmoid->name());
+  ASSERT_EQ(fused->ops(), std::vector<int>({
+                              FusedElementWiseNode::FUSED_OP_EXP,
+                              FusedElementWiseNode::FUSED_OP_MUL,
+                              FusedElementWiseNode::FUSED_OP_RSUB,
+                              FusedElementWiseNode::FUSED_OP_SIGMOID,
+                          }));
+  ASSERT_EQ(fused->operands(), std::vector<int>({-1, 1, 2, -1}));
+}
+
+TEST_F(FusionSimpStageTest, FuseElementWiseStage_multi_output) {
+  auto* X = new InstanceNode("X", Shape(2, 3), TENSOR_TYPE_TSR);
+  auto* exp = Exp("Exp", X);
+  auto* tanh = Tanh("Tanh", exp);
+  auto* negate = Negate("Negate", tanh);
+  auto* square = Square("Square", negate);
+  auto* reduce_mean = ReduceMean("ReduceMean", tanh);
+  ASSERT_TRUE(graph.Compile({square, reduce_mean}, 1));
+  item.FromGraph(graph);
+
+  stage.reset(new FuseElementWiseStage(simp_name, &ctx));
+  SimplifyTwice();
+  ASSERT_EQ(4, item.node_size());
+  AssertNodesDeleted({exp, negate});
+  AssertTypeEQ(square->name(), typeid(FusedElementWiseNode));
+  AssertInputsEQ(square->name(), {tanh->name()});
+  AssertTypeEQ(tanh->name(), typeid(FusedElementWiseNode));
+  AssertInputsEQ(tanh->name(), {X->name()});
+}
+
+TEST_F(FusionSimpStageTest, FuseElementWiseStage_max_fused_op) {
+  auto* X = new InstanceNode("X", Shape(2, 3), TENSOR_TYPE_TSR);
+  GraphNode* Z = X;
+  for (int i = 0; i < FusedElementWiseNode::MAX_FUSED_OP + 1; ++i) {
+    Z = Sigmoid("Sigmoid" + std::to_string(i), Z);
+  }
+  ASSERT_TRUE(graph.Compile({Z}, 1));
+  item.FromGraph(graph);
+
+  stage.reset(new FuseElementWiseStage(simp_name, &ctx));
+  SimplifyTwice();
+  ASSERT_EQ(3, item.node_size());
+  const auto* fused = FindFusedElementWise(Z->name());
+  ASSERT_EQ((int)fused->ops().size(), FusedElementWiseNode::MAX_FUSED_OP);
+  AssertTypeEQ("Sigmoid0", typeid(SigmoidNode));
+}
+
+class FusionSimpTest : public SimpTestBase {
+ protected:
+  std::unique_ptr<FusionSimp> fusion;
+
+ protected:
+  void SetUp() override { fusion.reset(new FusionSimp); }
+  void Simplify() override { fusion->Simplify(&item); }
+};
+
+TEST_F(FusionSimpTest, FusionSimp) {
+  auto* X = new InstanceNode("X", Shape(BATCH_PLACEHOLDER, 8), TENSOR_TYPE_TSR);
+  auto* H = StackedFullyConnect("fc", X, {8, 4}, "relu");
+  auto* W = new VariableNode("W", Shape(4, 1));
+  auto* Z = AddBias("bias", FullyConnect("", H, W));
+  std::vector<GraphNode*> targets = BinaryClassificationTarget(Z, 1);
+  ASSERT_TRUE(graph.Compile(targets, 1));
+  ReleaseVariable();
+  item.FromGraph(graph);
+
+  SimplifyTwice();
+  AssertTypeEQ(targets[0]->name(), typeid(FusedSigmoidBCELossNode));
+  std::vector<GraphNode*> nodes;
+  item.GetTopologicalSortedNodes(&nodes);
+  int fused_fc = 0, fc = 0, broadcast_add = 0;
+  for (const GraphNode* node : nodes) {
+    if (node->type_index() == typeid(FusedFullyConnectNode)) {
+      ++fused_fc;
+    } else if (node->type_index() == typeid(FullyConnectNode)) {
+      ++fc;
+    } else if (node->type_index() == typeid(BroadcastAddNode)) {
+      ++broadcast_add;
+    }
+  }
+  // FullyConnect + Relu
+  ASSERT_EQ(1, fused_fc);
+  // FullyConnect + AddBias
+  ASSERT_EQ(1, fc);
+  ASSERT_EQ(0, broadcast_add);
+
+  Graph simplified;
+  ASSERT_TRUE(item.ToGraph(&simplified));
+}
+
+}  // namespace deepx_core
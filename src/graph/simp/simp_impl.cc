@@ -10,6 +10,7 @@
 #include "arithmetic.h"
 #include "cf.h"
 #include "cse.h"
+#include "fusion.h"
 
 namespace deepx_core {
 namespace {
@@ -25,6 +26,10 @@ simps_t GetSimps(const SimpConfig& config) {
   simps.emplace_back(new CFSimp(cf_config));
 
   simps.emplace_back(new CSESimp);
+
+  if (config.enable_fusion) {
+    simps.emplace_back(new FusionSimp);
+  }
   return simps;
 }
 
@@ -5,7 +5,7 @@
 #include "simp_item.h"
 #include <deepx_core/common/stream.h>
 #include <deepx_core/dx_log.h>
-#include <algorithm>  // std::sort
+#include <algorithm>  // std::replace, std::sort
 #include <list>
 #include <queue>
 
@@ -124,6 +124,42 @@ bool SimpItem::ReplaceInputOfAllOutputs(const std::string& replaced,
   return true;
 }
 
+bool SimpItem::ReplaceNode(GraphNode* node) {
+  auto it = name_2_node_.find(node->name());
+  if (it == name_2_node_.end()) {
+    return false;
+  }
+  for (const GraphNode* input : node->input()) {
+    DXCHECK_THROW(name_2_node_.count(input->name()) > 0);
+  }
+  GraphNode* replaced = it->second.get();
+  DXCHECK_THROW(replaced != node);
+  DXCHECK_THROW(!IsReachable(node, replaced));
+
+  for (auto* output : find_output(node->name())) {
+    for (int i = 0; i < output->input_size(); ++i) {
+      if (output->input_[i] == replaced) {
+        output->input_[i] = node;
+      }
+    }
+  }
+  for (GraphNode* input : replaced->input()) {
+    name_2_output_[input->name()].erase(replaced);
+  }
+  for (GraphNode* input : node->input()) {
+    name_2_output_[input->name()].insert(node);
+  }
+
+  auto target_it = name_2_target_.find(node->name());
+  if (target_it != name_2_target_.end()) {
+    std::replace(target_.begin(), target_.end(), replaced, node);
+    target_it->second = node;
+  }
+
+  it->second.reset(node);
+  return true;
+}
+
 void SimpItem::GetTopologicalSortedNodes(std::vector<GraphNode*>* sorted,
                                          bool reverse) const {
   std::unordered_map<std::string, int> num_ready_input;
@@ -58,6 +58,12 @@ class SimpItem {
   // node before calling this function.
   bool ReplaceInputOfAllOutputs(const std::string& replaced,
                                 const std::string& replacement);
+  // 'node' has the same name as an existing node, it replaces the existing
+  // one as an input of its outputs and as a target, and is owned by this
+  // object. The existing one is destroyed.
+  // The existing one can not be reachable from 'node' along the direction
+  // from target node to input node before calling this function.
+  bool ReplaceNode(GraphNode* node);
   void GetTopologicalSortedNodes(std::vector<GraphNode*>* sorted,
                                  bool reverse = false) const;
   std::string NewNodeName(const std::string& old_name,
@@ -4,6 +4,7 @@
 
 #include "simp_item.h"
 #include <gtest/gtest.h>
+#include <memory>
 
 namespace deepx_core {
 
@@ -111,6 +112,43 @@ TEST_F(SimpItemTest, ReplaceInputOfAllOutputs_throw) {
   ASSERT_ANY_THROW(item.ReplaceInputOfAllOutputs("X1", "X3"));
 }
 
+TEST_F(SimpItemTest, ReplaceNode) {
+  auto* X1 = Constant("X1", shape, 1);
+  auto* X2 = ReduceMean("X2", X1, 0, 1);
+  auto* X3 = Sub("X3", X2, X2);
+  auto* X4 = ReduceMean("X4", X3, 0, 1);
+  ASSERT_TRUE(graph.Compile({X3, X4}, 1));
+  item.FromGraph(graph);
+
+  auto* X0 = new ReduceMinNode("X0", item.find_node("X1"));
+  ASSERT_FALSE(item.ReplaceNode(X0));
+  delete X0;
+
+  auto* new_X3 = new AddNode("X3", item.find_node("X1"), item.find_node("X1"));
+  ASSERT_TRUE(item.ReplaceNode(new_X3));
+  ASSERT_EQ(item.find_node("X3"), new_X3);
+  ASSERT_TRUE(item.is_target("X3"));
+  ASSERT_EQ(item.find_node("X4")->input(0), new_X3);
+  ASSERT_EQ(1, (int)item.find_output("X3").count(item.find_node("X4")));
+  ASSERT_EQ(1, (int)item.find_output("X1").count(new_X3));
+  ASSERT_TRUE(item.find_output("X2").empty());
+
+  Graph new_graph;
+  ASSERT_TRUE(item.ToGraph(&new_graph));
+  ASSERT_EQ(new_graph.find_node("X2"), null_node);
+  ASSERT_EQ(new_graph.target(0).name(), "X3");
+}
+
+TEST_F(SimpItemTest, ReplaceNode_throw) {
+  auto* X1 = Constant("X1", shape, 1);
+  auto* X2 = ReduceMean("X2", X1, 0, 1);
+  ASSERT_TRUE(graph.Compile({X2}, 1));
+  item.FromGraph(graph);
+  std::unique_ptr<GraphNode> new_X2(
+      new ReduceMinNode("X2", item.find_node("X2")));
+  ASSERT_ANY_THROW(item.ReplaceNode(new_X2.get()));
+}
+
 TEST_F(SimpItemTest, Prune) {
   auto* X1 = Constant("X1", shape, 1);
   auto* X3 = Constant("X3", shape, 1);
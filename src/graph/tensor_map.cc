@@ -36,6 +36,14 @@ void TensorMap::_Write(OutputStream& os) const {
       int type = TENSOR_TYPE_TSRS;
       const auto& W = v.unsafe_to_ref<tsrs_t>();
       os << k << type << W;
+    } else if (v.is<qtsr_t>()) {
+      int type = TENSOR_TYPE_QTSR;
+      const auto& W = v.unsafe_to_ref<qtsr_t>();
+      os << k << type << W;
+    } else if (v.is<qsrm_t>()) {
+      int type = TENSOR_TYPE_QSRM;
+      const auto& W = v.unsafe_to_ref<qsrm_t>();
+      os << k << type << W;
     } else {
       int type = TENSOR_TYPE_NONE;
       os << k << type;
@@ -78,6 +86,12 @@ void TensorMap::_Read(InputStream& is) {
       case TENSOR_TYPE_TSRS:
         is >> insert<tsrs_t>(name);
         break;
+      case TENSOR_TYPE_QTSR:
+        is >> insert<qtsr_t>(name);
+        break;
+      case TENSOR_TYPE_QSRM:
+        is >> insert<qsrm_t>(name);
+        break;
       case TENSOR_TYPE_SRP:  // backward compatibility
         ReadSRP(is, insert<srm_t>(name));
         break;
@@ -125,6 +139,12 @@ void TensorMap::_ReadView(InputStringStream& is) {
       case TENSOR_TYPE_TSRS:
         ReadView(is, insert<tsrs_t>(name));
         break;
+      case TENSOR_TYPE_QTSR:  // no view, copied
+        is >> insert<qtsr_t>(name);
+        break;
+      case TENSOR_TYPE_QSRM:  // no view, copied
+        is >> insert<qsrm_t>(name);
+        break;
       case TENSOR_TYPE_SRP:  // backward compatibility
         ReadSRPView(is, insert<srm_t>(name));
         break;
@@ -163,6 +183,12 @@ void TensorMap::_WriteText(std::ostream& os) const {
       const auto& W = v.unsafe_to_ref<tsrs_t>();
       os << k << std::endl;
       os << W << std::endl;
+    } else if (v.is<qtsr_t>()) {
+      const auto& W = v.unsafe_to_ref<qtsr_t>();
+      tsr_t dequantized;
+      W.dequantize(&dequantized);
+      os << k << std::endl;
+      os << dequantized << std::endl;
     } else {
       os << k << std::endl;
       os << std::endl;
@@ -3,18 +3,64 @@
 // Author: Yafei Zhang (kimmyzhang@tencent.com)
 //
 
+#include <deepx_core/common/hash_map_io.h>
 #include <deepx_core/dx_log.h>
 #include <deepx_core/graph/ts_store.h>
 #include <cstdint>
 #include <unordered_map>
+#include <utility>
 
 namespace deepx_core {
 
+void TSStore::set_bucket_width(ts_t bucket_width) {
+  if (bucket_width == 0) {
+    bucket_width = 1;
+  }
+  if (bucket_width_ != bucket_width) {
+    bucket_width_ = bucket_width;
+    RebuildIndex();
+  }
+}
+
+void TSStore::IndexId(int_t id, ts_t ts) {
+  ts_index_[GetBucketKey(ts)].emplace_back(id);
+  ++ts_index_size_;
+}
+
+void TSStore::RebuildIndex() {
+  ts_index_.clear();
+  ts_index_size_ = 0;
+  for (const auto& entry : id_ts_map_) {
+    IndexId(entry.first, entry.second);
+  }
+}
+
+void TSStore::MaybeCompactIndex() {
+  // Stale entries are at most half of the index after compaction,
+  // so the cost of rebuilding is amortized by updates.
+  if (ts_index_size_ > 1024 && ts_index_size_ > 2 * id_ts_map_.size()) {
+    RebuildIndex();
+  }
+}
+
+void TSStore::MaybeCompactMap() {
+  // Erased entries of 'id_ts_map_' are marked deleted and
+  // never become empty until 'id_ts_map_' is rehashed.
+  if (id_ts_map_erased_ > 0 &&
+      id_ts_map_erased_ >= id_ts_map_.bucket_size() / 4) {
+    ts_map_t id_ts_map(id_ts_map_.begin(), id_ts_map_.end(),
+                       id_ts_map_.size());
+    id_ts_map_.swap(id_ts_map);
+    id_ts_map_erased_ = 0;
+  }
+}
+
 void TSStore::Init(const TensorMap* param) noexcept { param_ = param; }
 
 bool TSStore::InitParam() {
   DXINFO("Initializing TSStore...");
   id_ts_map_.clear();
+  id_ts_map_erased_ = 0;
   for (const auto& entry : *param_) {
     const Any& Wany = entry.second;
     if (Wany.is<srm_t>()) {
@@ -24,6 +70,7 @@ bool TSStore::InitParam() {
       }
     }
   }
+  RebuildIndex();
   DXINFO("TSStore has %zu entries.", id_ts_map_.size());
   return true;
 }
@@ -108,6 +155,8 @@ bool TSStore::ReadLegacy(InputStream& is) {
     is.set_bad();
     return false;
   }
+  id_ts_map_erased_ = 0;
+  RebuildIndex();
   return true;
 }
 
@@ -130,6 +179,8 @@ bool TSStore::Read(InputStream& is) {
     DXERROR("Failed to read TSStore.");
     return false;
   }
+  id_ts_map_erased_ = 0;
+  RebuildIndex();
   return true;
 }
 
@@ -195,12 +246,73 @@ void TSStore::Merge(TSStore* other, const Shard* shard, int shard_id) {
   id_ts_map_.reserve(id_ts_map_.size() + other->id_ts_map_.size());
   for (const auto& entry : other->id_ts_map_) {
     if (shard == nullptr || shard->HasSRM(shard_id, entry.first)) {
-      id_ts_map_.emplace(entry);
+      if (id_ts_map_.emplace(entry).second) {
+        IndexId(entry.first, entry.second);
+      }
     }
   }
   DXINFO("TSStore has merged %zu entries.", id_ts_map_.size() - prev_size);
 }
 
+void TSStore::Split(TSStore* other, const Shard* shard, int shard_id) {
+  DXINFO("Splitting TSStore...");
+  size_t prev_size = id_ts_map_.size();
+  auto first = id_ts_map_.begin();
+  auto last = id_ts_map_.end();
+  for (; first != last;) {
+    int_t id = first->first;
+    ts_t ts = first->second;
+    if (shard == nullptr || shard->HasSRM(shard_id, id)) {
+      auto it = other->id_ts_map_.find(id);
+      if (it == other->id_ts_map_.end()) {
+        other->id_ts_map_.emplace(id, ts);
+        other->IndexId(id, ts);
+      } else if (it->second != ts) {
+        it->second = ts;
+        other->IndexId(id, ts);
+      }
+      first = id_ts_map_.erase(first);
+      ++id_ts_map_erased_;
+    } else {
+      ++first;
+    }
+  }
+  // Index entries of split ids become stale.
+  MaybeCompactMap();
+  MaybeCompactIndex();
+  other->MaybeCompactIndex();
+  DXINFO("TSStore has %zu entries split, %zu entries remained.",
+         prev_size - id_ts_map_.size(), id_ts_map_.size());
+}
+
+void TSStore::UpdateIds(const srm_t& G) {
+  ts_t now_key = GetBucketKey(now_);
+  std::vector<int_t>* now_bucket = nullptr;
+  for (const auto& entry : G) {
+    int_t id = entry.first;
+    auto it = id_ts_map_.find(id);
+    if (it == id_ts_map_.end()) {
+      id_ts_map_.emplace(id, now_);
+    } else if (it->second != now_) {
+      ts_t key = GetBucketKey(it->second);
+      it->second = now_;
+      if (key == now_key) {
+        // The index entry in the bucket of now is still valid.
+        continue;
+      }
+    } else {
+      continue;
+    }
+
+    if (now_bucket == nullptr) {
+      now_bucket = &ts_index_[now_key];
+    }
+    now_bucket->emplace_back(id);
+    ++ts_index_size_;
+  }
+  MaybeCompactIndex();
+}
+
 void TSStore::Update(TensorMap* grad) {
   for (const auto& entry : *grad) {
     const std::string& name = entry.first;
@@ -215,13 +327,9 @@ void TSStore::Update(TensorMap* grad) {
       const auto& G = Gany.unsafe_to_ref<srm_t>();
       if (use_lock_) {
         std::unique_lock<std::mutex> guard(*id_ts_map_lock_);
-        for (const auto& _entry : G) {
-          id_ts_map_[_entry.first] = now_;
-        }
+        UpdateIds(G);
       } else {
-        for (const auto& _entry : G) {
-          id_ts_map_[_entry.first] = now_;
-        }
+        UpdateIds(G);
       }
     }
   }
@@ -230,15 +338,47 @@ void TSStore::Update(TensorMap* grad) {
 auto TSStore::Expire() -> id_set_t {
   id_set_t expired;
   if (expire_threshold_ > 0) {
-    auto first = id_ts_map_.begin();
-    auto last = id_ts_map_.end();
-    for (; first != last;) {
-      if (now_ > expire_threshold_ + first->second) {
-        expired.emplace(first->first);
-        first = id_ts_map_.erase(first);
-      } else {
-        ++first;
+    if (now_ > expire_threshold_) {
+      // Ids whose timestamps are less than 'deadline' expire.
+      uint64_t deadline = (uint64_t)now_ - expire_threshold_;
+      size_t visited = 0;
+      auto first = ts_index_.begin();
+      auto last = ts_index_.end();
+      while (first != last &&
+             (uint64_t)first->first * bucket_width_ < deadline) {
+        ts_t key = first->first;
+        std::vector<int_t>& bucket = first->second;
+        // Whether all timestamps of the bucket are less than 'deadline'.
+        bool full = ((uint64_t)key + 1) * bucket_width_ <= deadline;
+        size_t remained = 0;
+        for (int_t id : bucket) {
+          auto it = id_ts_map_.find(id);
+          if (it == id_ts_map_.end() || GetBucketKey(it->second) != key) {
+            // stale
+            continue;
+          }
+          if (full || it->second < deadline) {
+            expired.emplace(id);
+            id_ts_map_.erase(it);
+            ++id_ts_map_erased_;
+          } else {
+            bucket[remained++] = id;
+          }
+        }
+        visited += bucket.size();
+        ts_index_size_ -= bucket.size() - remained;
+        if (remained == 0) {
+          first = ts_index_.erase(first);
+        } else {
+          bucket.resize(remained);
+          ++first;
+        }
+        if (!full) {
+          break;
+        }
       }
+      MaybeCompactMap();
+      DXINFO("TSStore has visited %zu index entries.", visited);
     }
     DXINFO("TSStore has %zu entries expired, %zu entries remained.",
            expired.size(), id_ts_map_.size());
@@ -2,10 +2,12 @@
 // Author: Yafei Zhang (kimmyzhang@tencent.com)
 //
 
+#include <deepx_core/common/stream.h>
 #include <deepx_core/graph/tensor_map.h>
 #include <deepx_core/graph/ts_store.h>
 #include <deepx_core/tensor/data_type.h>
 #include <gtest/gtest.h>
+#include <vector>
 
 namespace deepx_core {
 
@@ -66,4 +68,135 @@ TEST_F(TSStoreTest, Expire_now5_expire_threshold8) {
   TestExpire(5, 8, id_set_t({}));
 }
 
+TEST_F(TSStoreTest, Expire_incremental) {
+  TensorMap param;
+  param.insert<srm_t>("W");
+
+  TSStore ts_store;
+  ts_store.set_expire_threshold(2);
+  ts_store.Init(&param);
+
+  auto update = [&ts_store](ts_t now, const std::vector<int_t>& ids) {
+    TensorMap grad;
+    auto& G = grad.insert<srm_t>("W");
+    G.set_col(1);
+    for (int_t id : ids) {
+      float_t g = 1;
+      G.assign(id, &g);
+    }
+    ts_store.set_now(now);
+    ts_store.Update(&grad);
+  };
+
+  update(0, {1, 2, 3});
+  update(1, {2, 4});
+  update(2, {3, 3, 5});
+  // 1: 0
+  // 2: 1
+  // 3: 2
+  // 4: 1
+  // 5: 2
+  EXPECT_EQ(ts_store.size(), 5u);
+  EXPECT_EQ(ts_store.bucket_size(), 3u);
+  EXPECT_EQ(ts_store.index_size(), 7u);
+
+  ts_store.set_now(3);
+  EXPECT_EQ(ts_store.Expire(), id_set_t({1}));
+  ts_store.set_now(4);
+  EXPECT_EQ(ts_store.Expire(), id_set_t({2, 4}));
+  ts_store.set_now(4);
+  EXPECT_EQ(ts_store.Expire(), id_set_t({}));
+  // An expired id comes back.
+  update(4, {1});
+  ts_store.set_now(5);
+  EXPECT_EQ(ts_store.Expire(), id_set_t({3, 5}));
+  EXPECT_EQ(ts_store.size(), 1u);
+  EXPECT_EQ(ts_store.index_size(), 1u);
+  ts_store.set_now(7);
+  EXPECT_EQ(ts_store.Expire(), id_set_t({1}));
+  EXPECT_EQ(ts_store.size(), 0u);
+  EXPECT_EQ(ts_store.bucket_size(), 0u);
+}
+
+TEST_F(TSStoreTest, Expire_bucket_width) {
+  TensorMap param;
+  param.insert<srm_t>("W");
+
+  TSStore ts_store;
+  ts_store.set_expire_threshold(10);
+  ts_store.set_bucket_width(4);
+  ts_store.Init(&param);
+  for (ts_t now = 0; now < 8; ++now) {
+    TensorMap grad;
+    auto& G = grad.insert<srm_t>("W");
+    G.set_col(1);
+    float_t g = 1;
+    G.assign((int_t)now, &g);
+    ts_store.set_now(now);
+    ts_store.Update(&grad);
+  }
+  EXPECT_EQ(ts_store.bucket_size(), 2u);
+
+  // Bucket [4, 8) partially expires.
+  ts_store.set_now(16);
+  EXPECT_EQ(ts_store.Expire(), id_set_t({0, 1, 2, 3, 4, 5}));
+  EXPECT_EQ(ts_store.bucket_size(), 1u);
+  EXPECT_EQ(ts_store.index_size(), 2u);
+  ts_store.set_now(18);
+  EXPECT_EQ(ts_store.Expire(), id_set_t({6, 7}));
+  EXPECT_EQ(ts_store.bucket_size(), 0u);
+}
+
+TEST_F(TSStoreTest, Expire_compact) {
+  TensorMap param;
+  param.insert<srm_t>("W");
+
+  TSStore ts_store;
+  ts_store.set_expire_threshold(1);
+  ts_store.Init(&param);
+
+  // Each id is updated at many timestamps.
+  int_t n = 2000;
+  for (ts_t now = 0; now < 10; ++now) {
+    TensorMap grad;
+    auto& G = grad.insert<srm_t>("W");
+    G.set_col(1);
+    for (int_t id = 0; id < n; ++id) {
+      float_t g = 1;
+      G.assign(id + now * n / 2, &g);
+    }
+    ts_store.set_now(now);
+    ts_store.Update(&grad);
+    EXPECT_LE(ts_store.index_size(), 2 * ts_store.size());
+    EXPECT_EQ(ts_store.Expire().size(), now >= 2 ? (size_t)n / 2 : 0u);
+  }
+}
+
+TEST_F(TSStoreTest, WriteRead) {
+  TensorMap param;
+  param.insert<srm_t>("W");
+
+  TSStore ts_store;
+  ts_store.set_now(1);
+  ts_store.set_expire_threshold(1);
+  ts_store.Init(&param);
+  TensorMap grad;
+  grad.insert<srm_t>("W") = srm_t{{1, 2}, {{1, 1}, {2, 2}}};
+  ts_store.Update(&grad);
+
+  OutputStringStream os;
+  ASSERT_TRUE(ts_store.Write(os));
+
+  TSStore read_ts_store;
+  read_ts_store.set_now(3);
+  read_ts_store.set_expire_threshold(1);
+  read_ts_store.Init(&param);
+  InputStringStream is;
+  is.SetView(os.GetData(), os.GetSize());
+  ASSERT_TRUE(read_ts_store.Read(is));
+  EXPECT_EQ(read_ts_store.size(), 2u);
+  EXPECT_EQ(read_ts_store.index_size(), 2u);
+  EXPECT_EQ(read_ts_store.Expire(), id_set_t({1, 2}));
+}
+
 }  // namespace deepx_core
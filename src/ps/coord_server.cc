@@ -20,6 +20,7 @@ void CoordServer::Run() {
   file_dispatcher_.set_reverse(cs_config_.file_dispatcher_reverse);
   file_dispatcher_.set_shuffle(cs_config_.file_dispatcher_shuffle);
   file_dispatcher_.set_timeout(cs_config_.file_dispatcher_timeout);
+  file_dispatcher_.set_split_bytes(cs_config_.file_dispatcher_split_bytes);
   PreTrain();
   for (epoch_ = 0; epoch_ < cs_config_.epoch; ++epoch_) {
     PreEpoch();
@@ -102,19 +103,29 @@ void CoordServer::OnFileRequest(conn_t conn) {
   auto* response = conn->mutable_out_message()->mutable_file_response();
   response->epoch = epoch_;
   response->file.clear();
-  if (file_dispatcher_.WorkerDispatchFile(&response->file)) {
-    conn->set_file(response->file);
+  response->offset = 0;
+  response->length = 0;
+  FileChunk chunk;
+  if (file_dispatcher_.WorkerDispatchFile(&chunk)) {
+    response->file = chunk.file;
+    response->offset = chunk.offset;
+    response->length = chunk.length;
+    conn->set_file(to_string(chunk));
   }
 }
 
 void CoordServer::OnFileFinishNotify(conn_t conn) {
   const auto& notify = conn->in_message().file_finish_notify();
+  FileChunk chunk;
+  chunk.file = notify.file;
+  chunk.offset = notify.offset;
+  chunk.length = notify.length;
+  std::string key = to_string(chunk);
   conn->clear_file();
-  if (file_dispatcher_.WorkerFinishFile(notify.file)) {
+  if (file_dispatcher_.WorkerFinishFile(key)) {
     StopLoop();
   }
-  DXINFO("file=%s, loss=%f", notify.file.c_str(),
-         notify.loss / notify.loss_weight);
+  DXINFO("file=%s, loss=%f", key.c_str(), notify.loss / notify.loss_weight);
 }
 
 void CoordServer::OnUserRequest(conn_t /*conn*/) {
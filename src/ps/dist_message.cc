@@ -18,6 +18,9 @@ bool DistMessage::HasResponse(int type) noexcept {
     case DIST_MESSAGE_TYPE_FILE_REQUEST:
     case DIST_MESSAGE_TYPE_PULL_REQUEST:
     case DIST_MESSAGE_TYPE_MODEL_SAVE_REQUEST:
+    case DIST_MESSAGE_TYPE_SHARD_EXPORT_REQUEST:
+    case DIST_MESSAGE_TYPE_SHARD_IMPORT_REQUEST:
+    case DIST_MESSAGE_TYPE_SHARD_COMMIT_REQUEST:
     case DIST_MESSAGE_TYPE_USER_REQUEST:
       return true;
     default:
@@ -25,8 +28,28 @@ bool DistMessage::HasResponse(int type) noexcept {
   }
 }
 
-OutputStringStream& operator<<(OutputStringStream& os,
-                               const DistMessage& message) {
+namespace {
+
+template <class OStream>
+void WritePullResponse(OStream& os, const DistMessage::PullResponse& response) {
+  if (response.buf_writer) {
+    size_t pos = os.BeginString();
+    response.buf_writer(os);
+    os.EndString(pos);
+  } else {
+    os << response.buf;
+  }
+}
+
+template <class OStream>
+void WriteShardRequest(OStream& os, const DistMessage::ShardRequest& request) {
+  os << request.shard_size;
+  os << request.shard_func_name;
+  os << request.shard_id;
+}
+
+template <class OStream>
+void WriteMessage(OStream& os, const DistMessage& message) {
   os.BeginMessage();
   os << message.type();
   switch (message.type()) {
@@ -43,9 +66,13 @@ OutputStringStream& operator<<(OutputStringStream& os,
     case DIST_MESSAGE_TYPE_FILE_RESPONSE:
       os << message.file_response().epoch;
       os << message.file_response().file;
+      os << message.file_response().offset;
+      os << message.file_response().length;
       break;
     case DIST_MESSAGE_TYPE_FILE_FINISH_NOTIFY:
       os << message.file_finish_notify().file;
+      os << message.file_finish_notify().offset;
+      os << message.file_finish_notify().length;
       os << message.file_finish_notify().loss;
       os << message.file_finish_notify().loss_weight;
       break;
@@ -53,7 +80,7 @@ OutputStringStream& operator<<(OutputStringStream& os,
       os << message.pull_request().buf;
       break;
     case DIST_MESSAGE_TYPE_PULL_RESPONSE:
-      os << message.pull_response().buf;
+      WritePullResponse(os, message.pull_response());
       break;
     case DIST_MESSAGE_TYPE_PUSH_NOTIFY:
       os << message.push_notify().buf;
@@ -67,6 +94,22 @@ OutputStringStream& operator<<(OutputStringStream& os,
       break;
     case DIST_MESSAGE_TYPE_TERMINATION_NOTIFY:
       break;
+    case DIST_MESSAGE_TYPE_SHARD_EXPORT_REQUEST:
+      WriteShardRequest(os, message.shard_export_request());
+      break;
+    case DIST_MESSAGE_TYPE_SHARD_EXPORT_RESPONSE:
+      os << message.shard_export_response().buf;
+      break;
+    case DIST_MESSAGE_TYPE_SHARD_IMPORT_REQUEST:
+      os << message.shard_import_request().buf;
+      break;
+    case DIST_MESSAGE_TYPE_SHARD_IMPORT_RESPONSE:
+      break;
+    case DIST_MESSAGE_TYPE_SHARD_COMMIT_REQUEST:
+      WriteShardRequest(os, message.shard_commit_request());
+      break;
+    case DIST_MESSAGE_TYPE_SHARD_COMMIT_RESPONSE:
+      break;
     case DIST_MESSAGE_TYPE_USER_REQUEST:
       os << message.user_request().buf;
       break;
@@ -78,6 +121,19 @@ OutputStringStream& operator<<(OutputStringStream& os,
       break;
   }
   os.EndMessage();
+}
+
+}  // namespace
+
+OutputStringStream& operator<<(OutputStringStream& os,
+                               const DistMessage& message) {
+  WriteMessage(os, message);
+  return os;
+}
+
+OutputGatherStream& operator<<(OutputGatherStream& os,
+                               const DistMessage& message) {
+  WriteMessage(os, message);
   return os;
 }
 
@@ -94,6 +150,9 @@ bool DistMessageView::HasResponse(int type) noexcept {
     case DIST_MESSAGE_TYPE_FILE_REQUEST:
     case DIST_MESSAGE_TYPE_PULL_REQUEST:
     case DIST_MESSAGE_TYPE_MODEL_SAVE_REQUEST:
+    case DIST_MESSAGE_TYPE_SHARD_EXPORT_REQUEST:
+    case DIST_MESSAGE_TYPE_SHARD_IMPORT_REQUEST:
+    case DIST_MESSAGE_TYPE_SHARD_COMMIT_REQUEST:
     case DIST_MESSAGE_TYPE_USER_REQUEST:
       return true;
     default:
@@ -101,6 +160,17 @@ bool DistMessageView::HasResponse(int type) noexcept {
   }
 }
 
+namespace {
+
+void ReadShardRequestView(InputStringStream& is,
+                          DistMessageView::ShardRequest* request) {
+  ReadView(is, request->shard_size);
+  ReadView(is, request->shard_func_name);
+  ReadView(is, request->shard_id);
+}
+
+}  // namespace
+
 InputStringStream& ReadView(InputStringStream& is, DistMessageView& message) {
   int place_holder, type;
   ReadView(is, place_holder);
@@ -124,9 +194,13 @@ InputStringStream& ReadView(InputStringStream& is, DistMessageView& message) {
     case DIST_MESSAGE_TYPE_FILE_RESPONSE:
       ReadView(is, message.mutable_file_response()->epoch);
       ReadView(is, message.mutable_file_response()->file);
+      ReadView(is, message.mutable_file_response()->offset);
+      ReadView(is, message.mutable_file_response()->length);
       break;
     case DIST_MESSAGE_TYPE_FILE_FINISH_NOTIFY:
       ReadView(is, message.mutable_file_finish_notify()->file);
+      ReadView(is, message.mutable_file_finish_notify()->offset);
+      ReadView(is, message.mutable_file_finish_notify()->length);
       ReadView(is, message.mutable_file_finish_notify()->loss);
       ReadView(is, message.mutable_file_finish_notify()->loss_weight);
       break;
@@ -150,6 +224,22 @@ InputStringStream& ReadView(InputStringStream& is, DistMessageView& message) {
       break;
     case DIST_MESSAGE_TYPE_TERMINATION_NOTIFY:
       break;
+    case DIST_MESSAGE_TYPE_SHARD_EXPORT_REQUEST:
+      ReadShardRequestView(is, message.mutable_shard_export_request());
+      break;
+    case DIST_MESSAGE_TYPE_SHARD_EXPORT_RESPONSE:
+      ReadView(is, message.mutable_shard_export_response()->buf);
+      break;
+    case DIST_MESSAGE_TYPE_SHARD_IMPORT_REQUEST:
+      ReadView(is, message.mutable_shard_import_request()->buf);
+      break;
+    case DIST_MESSAGE_TYPE_SHARD_IMPORT_RESPONSE:
+      break;
+    case DIST_MESSAGE_TYPE_SHARD_COMMIT_REQUEST:
+      ReadShardRequestView(is, message.mutable_shard_commit_request());
+      break;
+    case DIST_MESSAGE_TYPE_SHARD_COMMIT_RESPONSE:
+      break;
     case DIST_MESSAGE_TYPE_USER_REQUEST:
       ReadView(is, message.mutable_user_request()->buf);
       break;
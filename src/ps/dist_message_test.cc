@@ -30,4 +30,67 @@ TEST_F(DistMessageTest, WriteReadView) {
   EXPECT_EQ(message.pull_request().buf, read_message.pull_request().buf);
 }
 
+TEST_F(DistMessageTest, WriteReadView_FileResponse) {
+  DistMessage message;
+  DistMessageView read_message;
+  message.set_type(DIST_MESSAGE_TYPE_FILE_RESPONSE);
+  auto* file_response = message.mutable_file_response();
+  file_response->file = "file";
+  file_response->offset = 100;
+  file_response->length = 200;
+  file_response->epoch = 3;
+
+  OutputStringStream os;
+  InputStringStream is;
+
+  os << message;
+  ASSERT_TRUE(os);
+
+  is.SetView(os.GetBuf());
+  ReadView(is, read_message);
+  ASSERT_TRUE(is);
+
+  EXPECT_EQ(read_message.type(), DIST_MESSAGE_TYPE_FILE_RESPONSE);
+  EXPECT_EQ(read_message.file_response().file, "file");
+  EXPECT_EQ(read_message.file_response().offset, 100u);
+  EXPECT_EQ(read_message.file_response().length, 200u);
+  EXPECT_EQ(read_message.file_response().epoch, 3);
+}
+
+TEST_F(DistMessageTest, WriteReadView_PullResponse_buf_writer) {
+  std::string large(OutputGatherStream::DEFAULT_MIN_REF_BYTES, 'a');
+  DistMessage message;
+  DistMessageView read_message;
+  message.set_type(DIST_MESSAGE_TYPE_PULL_RESPONSE);
+  message.mutable_pull_response()->buf = "ignored";
+  message.mutable_pull_response()->buf_writer = [&large](OutputStream& os) {
+    os << 1;
+    os << large;
+  };
+
+  OutputStringStream os1;
+  OutputGatherStream os2;
+  os1 << message;
+  ASSERT_TRUE(os1);
+  os2 << message;
+  ASSERT_TRUE(os2);
+  ASSERT_EQ(os1.GetString(), os2.GetString());
+  EXPECT_GE(os2.GetRefSize(), large.size());
+
+  InputStringStream is;
+  is.SetView(os1.GetBuf());
+  ReadView(is, read_message);
+  ASSERT_TRUE(is);
+
+  const const_string_view& buf = read_message.pull_response().buf;
+  InputStringStream buf_is;
+  buf_is.SetView(buf.data(), buf.size());
+  int i = 0;
+  std::string s;
+  buf_is >> i >> s;
+  ASSERT_TRUE(buf_is);
+  EXPECT_EQ(i, 1);
+  EXPECT_EQ(s, large);
+}
+
 }  // namespace deepx_core
@@ -2,52 +2,94 @@
 // Author: Yafei Zhang (kimmyzhang@tencent.com)
 //
 
+#include <deepx_core/common/stream.h>
 #include <deepx_core/dx_log.h>
 #include <deepx_core/ps/file_dispatcher.h>
 #include <algorithm>  // std::reverse, std::shuffle
 
 namespace deepx_core {
 
+/************************************************************************/
+/* FileChunk */
+/************************************************************************/
+std::string to_string(const FileChunk& chunk) {
+  if (chunk.whole()) {
+    return chunk.file;
+  }
+  return chunk.file + "@" + std::to_string(chunk.offset) + "+" +
+         std::to_string(chunk.length);
+}
+
+/************************************************************************/
+/* FileDispatcher */
+/************************************************************************/
+void FileDispatcher::SplitFile(const std::string& file) {
+  FileChunk chunk;
+  chunk.file = file;
+
+  size_t file_size = 0;
+  if (split_bytes_ == 0 || IsGzipFile(file) || IsStdinStdoutPath(file) ||
+      !AutoFileSystem::GetFileSize(file, &file_size) ||
+      file_size <= split_bytes_) {
+    chunks_.emplace_back(chunk);
+    return;
+  }
+
+  for (uint64_t offset = 0; offset < file_size; offset += split_bytes_) {
+    chunk.offset = offset;
+    chunk.length = std::min<uint64_t>(split_bytes_, file_size - offset);
+    chunks_.emplace_back(chunk);
+  }
+  DXINFO("File is split into %zu chunks: %s.",
+         (size_t)((file_size + split_bytes_ - 1) / split_bytes_),
+         file.c_str());
+}
+
 void FileDispatcher::PreTrain(const std::vector<std::string>& files) {
   std::unique_lock<std::mutex> guard(mutex_);
   DXASSERT(!files.empty());
-  files_ = files;
+  chunks_.clear();
+  for (const std::string& file : files) {
+    SplitFile(file);
+  }
   if (reverse_) {
-    std::reverse(files_.begin(), files_.end());
+    std::reverse(chunks_.begin(), chunks_.end());
   }
 }
 
 void FileDispatcher::PreEpoch() {
   std::unique_lock<std::mutex> guard(mutex_);
-  DXASSERT(!files_.empty());
+  DXASSERT(!chunks_.empty());
   DXASSERT(to_dispatch_.empty());
-  DXASSERT(dispatch_time_.empty());
+  DXASSERT(dispatched_.empty());
   if (shuffle_) {
-    std::shuffle(files_.begin(), files_.end(), engine_);
+    std::shuffle(chunks_.begin(), chunks_.end(), engine_);
   }
-  to_dispatch_.assign(files_.begin(), files_.end());
+  to_dispatch_.assign(chunks_.begin(), chunks_.end());
   finished_.clear();
 }
 
-bool FileDispatcher::WorkerDispatchFile(std::string* file) {
+bool FileDispatcher::WorkerDispatchFile(FileChunk* chunk) {
   std::unique_lock<std::mutex> guard(mutex_);
   for (;;) {
     if (!to_dispatch_.empty()) {
-      *file = to_dispatch_.front();
+      *chunk = to_dispatch_.front();
       to_dispatch_.pop_front();
-      dispatch_time_[*file] = time(nullptr);
-      DXINFO("File is dispatched: %s.", file->c_str());
+      std::string key = to_string(*chunk);
+      Dispatched& dispatched = dispatched_[key];
+      dispatched.chunk = *chunk;
+      dispatched.time = time(nullptr);
+      DXINFO("File is dispatched: %s.", key.c_str());
       return true;
     }
 
     if (timeout_ > 0) {
       time_t now = time(nullptr);
-      for (const auto& entry : dispatch_time_) {
-        if (now - entry.second > (time_t)timeout_) {
-          const std::string& _file = entry.first;
-          to_dispatch_.emplace_back(_file);
-          dispatch_time_.erase(_file);
-          DXERROR("File timed out: %s.", _file.c_str());
+      for (auto it = dispatched_.begin(); it != dispatched_.end(); ++it) {
+        if (now - it->second.time > (time_t)timeout_) {
+          DXERROR("File timed out: %s.", it->first.c_str());
+          to_dispatch_.emplace_back(it->second.chunk);
+          dispatched_.erase(it);
           break;
         }
       }
@@ -60,25 +102,36 @@ bool FileDispatcher::WorkerDispatchFile(std::string* file) {
   }
 }
 
-bool FileDispatcher::WorkerFinishFile(const std::string& file) {
+bool FileDispatcher::WorkerDispatchFile(std::string* file) {
+  FileChunk chunk;
+  if (!WorkerDispatchFile(&chunk)) {
+    return false;
+  }
+  DXASSERT(chunk.whole());
+  *file = chunk.file;
+  return true;
+}
+
+bool FileDispatcher::WorkerFinishFile(const std::string& key) {
   std::unique_lock<std::mutex> guard(mutex_);
-  DXINFO("File is finished: %s.", file.c_str());
-  finished_.emplace_back(file);
-  dispatch_time_.erase(file);
-  if (finished_.size() >= files_.size() && to_dispatch_.empty() &&
-      dispatch_time_.empty()) {
+  DXINFO("File is finished: %s.", key.c_str());
+  finished_.emplace_back(key);
+  dispatched_.erase(key);
+  if (finished_.size() >= chunks_.size() && to_dispatch_.empty() &&
+      dispatched_.empty()) {
     DXINFO("Epoch is finished.");
     return true;
   }
   return false;
 }
 
-void FileDispatcher::WorkerFailureFile(const std::string& file) {
+void FileDispatcher::WorkerFailureFile(const std::string& key) {
   std::unique_lock<std::mutex> guard(mutex_);
-  DXERROR("File is failed: %s.", file.c_str());
-  if (dispatch_time_.count(file) > 0) {
-    to_dispatch_.emplace_back(file);
-    dispatch_time_.erase(file);
+  DXERROR("File is failed: %s.", key.c_str());
+  auto it = dispatched_.find(key);
+  if (it != dispatched_.end()) {
+    to_dispatch_.emplace_back(it->second.chunk);
+    dispatched_.erase(it);
   }
 }
 
@@ -2,6 +2,7 @@
 // Author: Yafei Zhang (kimmyzhang@tencent.com)
 //
 
+#include <deepx_core/common/stream.h>
 #include <deepx_core/ps/file_dispatcher.h>
 #include <gtest/gtest.h>
 #include <algorithm>  // std::sort
@@ -104,4 +105,52 @@ TEST_F(FileDispatcherTest, reverse0_shuffle1_timeout0) {
   EXPECT_EQ(files, dispatched);
 }
 
+TEST_F(FileDispatcherTest, split_bytes) {
+  const std::string file = "testdata/graph/instance_reader/libsvm.txt";
+  size_t file_size = 0;
+  ASSERT_TRUE(AutoFileSystem::GetFileSize(file, &file_size));
+  uint64_t split_bytes = (uint64_t)file_size / 3 + 1;
+
+  FileDispatcher file_dispatcher;
+  file_dispatcher.set_reverse(0);
+  file_dispatcher.set_shuffle(0);
+  file_dispatcher.set_timeout(0);
+  file_dispatcher.set_split_bytes(split_bytes);
+
+  std::vector<std::string> files = {file, "not_exist"};
+  file_dispatcher.PreTrain(files);
+  ASSERT_EQ(file_dispatcher.chunk_size(), 4u);
+  file_dispatcher.PreEpoch();
+
+  FileChunk chunk;
+  uint64_t offset = 0;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(file_dispatcher.WorkerDispatchFile(&chunk));
+    EXPECT_EQ(chunk.file, file);
+    EXPECT_EQ(chunk.offset, offset);
+    EXPECT_GT(chunk.length, 0u);
+    EXPECT_EQ(to_string(chunk), file + "@" + std::to_string(chunk.offset) +
+                                    "+" + std::to_string(chunk.length));
+    offset += chunk.length;
+    if (i == 1) {
+      file_dispatcher.WorkerFailureFile(to_string(chunk));
+    } else {
+      ASSERT_FALSE(file_dispatcher.WorkerFinishFile(to_string(chunk)));
+    }
+  }
+  EXPECT_EQ(offset, (uint64_t)file_size);
+
+  ASSERT_TRUE(file_dispatcher.WorkerDispatchFile(&chunk));
+  EXPECT_TRUE(chunk.whole());
+  EXPECT_EQ(to_string(chunk), "not_exist");
+  ASSERT_FALSE(file_dispatcher.WorkerFinishFile(to_string(chunk)));
+
+  // the failed chunk
+  ASSERT_TRUE(file_dispatcher.WorkerDispatchFile(&chunk));
+  EXPECT_EQ(chunk.offset, split_bytes);
+  ASSERT_TRUE(file_dispatcher.WorkerFinishFile(to_string(chunk)));
+
+  ASSERT_FALSE(file_dispatcher.WorkerDispatchFile(&chunk));
+}
+
 }  // namespace deepx_core
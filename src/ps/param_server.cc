@@ -2,6 +2,7 @@
 // Author: Yafei Zhang (kimmyzhang@tencent.com)
 //
 
+#include <deepx_core/dx_log.h>
 #include <deepx_core/ps/param_server.h>
 
 namespace deepx_core {
@@ -27,6 +28,21 @@ int ParamServer::OnReadMessage(conn_t conn) {
       OnTerminationNotify(conn);
       StopLoop();
       break;
+    case DIST_MESSAGE_TYPE_SHARD_EXPORT_REQUEST:
+      conn->mutable_out_message()->set_type(
+          DIST_MESSAGE_TYPE_SHARD_EXPORT_RESPONSE);
+      OnShardExportRequest(conn);
+      break;
+    case DIST_MESSAGE_TYPE_SHARD_IMPORT_REQUEST:
+      conn->mutable_out_message()->set_type(
+          DIST_MESSAGE_TYPE_SHARD_IMPORT_RESPONSE);
+      OnShardImportRequest(conn);
+      break;
+    case DIST_MESSAGE_TYPE_SHARD_COMMIT_REQUEST:
+      conn->mutable_out_message()->set_type(
+          DIST_MESSAGE_TYPE_SHARD_COMMIT_RESPONSE);
+      OnShardCommitRequest(conn);
+      break;
     case DIST_MESSAGE_TYPE_USER_REQUEST:
       conn->mutable_out_message()->set_type(DIST_MESSAGE_TYPE_USER_RESPONSE);
       OnUserRequest(conn);
@@ -48,6 +64,29 @@ int ParamServer::OnReadMessage(conn_t conn) {
   return 0;
 }
 
+void ParamServer::OnShardExportRequest(conn_t conn) {
+  // input
+  //   conn->in_message().shard_export_request()
+  // output
+  //   conn->mutable_out_message()->mutable_shard_export_response()
+  //
+  // An empty response means shard migration is not supported.
+  DXERROR("Shard migration is not supported.");
+  conn->mutable_out_message()->mutable_shard_export_response()->buf.clear();
+}
+
+void ParamServer::OnShardImportRequest(conn_t /*conn*/) {
+  // input
+  //   conn->in_message().shard_import_request()
+  DXERROR("Shard migration is not supported.");
+}
+
+void ParamServer::OnShardCommitRequest(conn_t /*conn*/) {
+  // input
+  //   conn->in_message().shard_commit_request()
+  DXERROR("Shard migration is not supported.");
+}
+
 void ParamServer::OnUserRequest(conn_t /*conn*/) {
   // input
   //   conn->in_message().user_request()
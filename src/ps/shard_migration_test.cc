@@ -0,0 +1,331 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// PSs run in child processes on loopback,
+// the test process migrates them from 2 shards to 3 shards.
+//
+
+#include <deepx_core/common/stream.h>
+#include <deepx_core/graph/dist_proto.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/graph_node.h>
+#include <deepx_core/graph/model_shard.h>
+#include <deepx_core/graph/shard.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/ps/param_server.h>
+#include <deepx_core/ps/tcp_connection.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace deepx_core {
+namespace {
+
+const int OLD_SHARD_SIZE = 2;
+const int NEW_SHARD_SIZE = 3;
+const int ID = 2000;
+const int TSR = 8;
+const int COL = 4;
+
+void InitGraph(Graph* graph) {
+  std::vector<GraphNode*> nodes;
+  for (int i = 0; i < TSR; ++i) {
+    nodes.emplace_back(new VariableNode("T" + std::to_string(i), Shape(1, 2),
+                                        TENSOR_TYPE_TSR,
+                                        TENSOR_INITIALIZER_TYPE_RAND, 0, 1));
+  }
+  nodes.emplace_back(new VariableNode("S", Shape(0, COL), TENSOR_TYPE_SRM,
+                                      TENSOR_INITIALIZER_TYPE_RAND, 0, 1));
+  DXCHECK_THROW(graph->Compile(nodes, 1));
+}
+
+/************************************************************************/
+/* TestParamServer */
+/************************************************************************/
+class TestParamServer : public ParamServer, public DataType {
+ private:
+  ModelShard* model_shard_;
+  Shard shard_;
+
+ public:
+  explicit TestParamServer(ModelShard* model_shard)
+      : model_shard_(model_shard) {}
+
+ protected:
+  void OnPullRequest(conn_t conn) override {
+    conn->mutable_out_message()->mutable_pull_response()->buf.clear();
+  }
+  void OnPushNotify(conn_t /*conn*/) override {}
+  void OnModelSaveRequest(conn_t /*conn*/) override {}
+  void OnTerminationNotify(conn_t /*conn*/) override {}
+
+  void OnShardExportRequest(conn_t conn) override {
+    const auto& request = conn->in_message().shard_export_request();
+    Shard shard;
+    shard.InitShard(request.shard_size, request.shard_func_name);
+    std::string& buf =
+        conn->mutable_out_message()->mutable_shard_export_response()->buf;
+    buf.clear();
+    OutputStringStream os;
+    os.SetView(&buf);
+    DXCHECK_THROW(model_shard_->ExportShard(&shard, request.shard_id, os));
+  }
+
+  void OnShardImportRequest(conn_t conn) override {
+    const const_string_view& buf =
+        conn->in_message().shard_import_request().buf;
+    InputStringStream is;
+    is.SetView(buf.data(), buf.size());
+    DXCHECK_THROW(model_shard_->ImportShard(is));
+  }
+
+  void OnShardCommitRequest(conn_t conn) override {
+    const auto& request = conn->in_message().shard_commit_request();
+    shard_.InitShard(request.shard_size, request.shard_func_name);
+    DXCHECK_THROW(model_shard_->CommitShard(&shard_, request.shard_id));
+  }
+
+  // Dump params, optimizer slots, sizes of TSStore and FreqStore.
+  void OnUserRequest(conn_t conn) override {
+    TensorMap slot;
+    model_shard_->mutable_optimizer()->ForEachTSR(
+        [&slot](const std::string& name, tsr_t* O) {
+          slot.insert<tsr_t>(name) = *O;
+        });
+    model_shard_->mutable_optimizer()->ForEachSRM(
+        [&slot](const std::string& name, srm_t* O) {
+          slot.insert<srm_t>(name) = *O;
+        });
+    uint64_t ts_size = model_shard_->ts_store().size();
+    uint64_t freq_size = model_shard_->freq_store().size();
+
+    std::string& buf =
+        conn->mutable_out_message()->mutable_user_response()->buf;
+    buf.clear();
+    OutputStringStream os;
+    os.SetView(&buf);
+    os << model_shard_->param() << slot << ts_size << freq_size;
+    DXCHECK_THROW(os);
+  }
+};
+
+// Run a PS of 'shard_size' and 'shard_id'.
+// If 'train', ids and TSRs it owns are pulled and pushed.
+void RunPS(const TcpEndpoint& endpoint, int shard_size, int shard_id,
+           int train) {
+  using tsr_t = DataType::tsr_t;
+  using srm_t = DataType::srm_t;
+  Graph graph;
+  InitGraph(&graph);
+  Shard shard;
+  shard.InitShard(shard_size, "consistent_hash");
+  ModelShard model_shard;
+  model_shard.seed(shard_id + 1);
+  model_shard.InitShard(&shard, shard_id);
+  model_shard.InitGraph(&graph);
+  DXCHECK_THROW(model_shard.InitModel());
+  DXCHECK_THROW(model_shard.InitOptimizer("adagrad", ""));
+  DXCHECK_THROW(model_shard.InitTSStore(1, 0));
+  DXCHECK_THROW(model_shard.InitFreqStore(1));
+  DXCHECK_THROW(model_shard.InitLock());
+
+  if (train) {
+    PullRequest pull_request;
+    pull_request.is_train = 1;
+    TensorMap grad;
+    auto& G = grad.insert<srm_t>("S");
+    G.set_col(COL);
+    std::vector<DataType::float_t> g(COL, 1);
+    for (int i = 0; i < ID; ++i) {
+      if (shard.HasSRM(shard_id, (DataType::int_t)i)) {
+        pull_request.srm_map["S"].emplace((DataType::int_t)i);
+        pull_request.id_freq_map[(DataType::int_t)i] = 1;
+        G.assign((DataType::int_t)i, g.data());
+      }
+    }
+    for (int i = 0; i < TSR; ++i) {
+      std::string name = "T" + std::to_string(i);
+      if (shard.HasTSR(shard_id, name)) {
+        auto& GT = grad.insert<tsr_t>(name);
+        GT.resize(1, 2);
+        GT.ones();
+      }
+    }
+    TensorMap param;
+    model_shard.Pull(&pull_request, &param);
+    model_shard.Push(&grad, nullptr);
+  }
+
+  TestParamServer server(&model_shard);
+  TcpServerConfig config;
+  config.listen_endpoint = endpoint;
+  config.thread = 1;
+  server.set_config(config);
+  server.Run();
+}
+
+struct State : DataType {
+  TensorMap param;
+  TensorMap slot;
+  uint64_t ts_size = 0;
+  uint64_t freq_size = 0;
+};
+
+void Dump(TcpConnection* conn, State* state) {
+  ASSERT_EQ(conn->RpcUserRequest(), 0);
+  const const_string_view& buf = conn->in_message().user_response().buf;
+  InputStringStream is;
+  is.SetView(buf.data(), buf.size());
+  is >> state->param >> state->slot >> state->ts_size >> state->freq_size;
+  ASSERT_TRUE(is);
+}
+
+// Kill child processes which are still running.
+class ChildGuard {
+ private:
+  std::vector<pid_t> pids_;
+
+ public:
+  void Add(pid_t pid) { pids_.emplace_back(pid); }
+
+  // Return whether all children exit with 0.
+  bool Wait() {
+    bool success = true;
+    for (pid_t pid : pids_) {
+      int status = 0;
+      if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+          WEXITSTATUS(status) != 0) {
+        success = false;
+      }
+    }
+    pids_.clear();
+    return success;
+  }
+
+  ~ChildGuard() {
+    for (pid_t pid : pids_) {
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+    }
+  }
+};
+
+}  // namespace
+
+class ShardMigrationTest : public testing::Test, public DataType {};
+
+TEST_F(ShardMigrationTest, Migrate) {
+  int port = 30000 + (int)(getpid() % 10000) * 3;  // magic number
+  std::vector<TcpEndpoint> endpoints;
+  for (int i = 0; i < NEW_SHARD_SIZE; ++i) {
+    endpoints.emplace_back(MakeTcpEndpoint("127.0.0.1", port + i));
+  }
+
+  ChildGuard guard;
+  for (int i = 0; i < NEW_SHARD_SIZE; ++i) {
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      int status = 0;
+      try {
+        if (i < OLD_SHARD_SIZE) {
+          RunPS(endpoints[i], OLD_SHARD_SIZE, i, 1);
+        } else {
+          // a new PS
+          RunPS(endpoints[i], NEW_SHARD_SIZE, i, 0);
+        }
+      } catch (...) {
+        status = 1;
+      }
+      _exit(status);
+    }
+    guard.Add(pid);
+  }
+
+  IoContext io;
+  TcpConnections conns(&io);
+  ASSERT_EQ(conns.ConnectRetry(endpoints, 30, 1), 0);
+
+  std::vector<State> before(NEW_SHARD_SIZE), after(NEW_SHARD_SIZE);
+  for (int i = 0; i < NEW_SHARD_SIZE; ++i) {
+    Dump(conns[i].get(), &before[i]);
+  }
+  ASSERT_EQ(conns.RpcShardMigrate(NEW_SHARD_SIZE, "consistent_hash"), 0);
+  for (int i = 0; i < NEW_SHARD_SIZE; ++i) {
+    Dump(conns[i].get(), &after[i]);
+  }
+  ASSERT_EQ(conns.RpcTerminationNotify(), 0);
+  conns.Close();
+  EXPECT_TRUE(guard.Wait());
+
+  Shard old_shard, new_shard;
+  old_shard.InitShard(OLD_SHARD_SIZE, "consistent_hash");
+  new_shard.InitShard(NEW_SHARD_SIZE, "consistent_hash");
+
+  // SRM rows and optimizer slots.
+  size_t moved = 0;
+  for (int i = 0; i < ID; ++i) {
+    int_t id = (int_t)i;
+    int old_shard_id = old_shard.GetSRMShardId(id);
+    int new_shard_id = new_shard.GetSRMShardId(id);
+    moved += old_shard_id != new_shard_id;
+    const State& old_state = before[old_shard_id];
+    const float_t* old_row =
+        old_state.param.get<srm_t>("S").get_row_no_init(id);
+    const float_t* old_slot_row =
+        old_state.slot.get<srm_t>("S").get_row_no_init(id);
+    ASSERT_TRUE(old_row != nullptr);
+    ASSERT_TRUE(old_slot_row != nullptr);
+    for (int j = 0; j < NEW_SHARD_SIZE; ++j) {
+      // const, so that rows are not inserted
+      const State& state = after[j];
+      const float_t* row = state.param.get<srm_t>("S").get_row_no_init(id);
+      const float_t* slot_row = state.slot.get<srm_t>("S").get_row_no_init(id);
+      if (j == new_shard_id) {
+        ASSERT_TRUE(row != nullptr);
+        ASSERT_TRUE(slot_row != nullptr);
+        for (int k = 0; k < COL; ++k) {
+          EXPECT_EQ(row[k], old_row[k]);
+          EXPECT_EQ(slot_row[k], old_slot_row[k]);
+        }
+      } else {
+        EXPECT_TRUE(row == nullptr);
+        EXPECT_TRUE(slot_row == nullptr);
+      }
+    }
+  }
+  EXPECT_GT(moved, 0u);
+
+  // TSRs and optimizer slots.
+  for (int i = 0; i < TSR; ++i) {
+    std::string name = "T" + std::to_string(i);
+    int old_shard_id = old_shard.GetTSRShardId(name);
+    int new_shard_id = new_shard.GetTSRShardId(name);
+    const auto& old_W = before[old_shard_id].param.get<tsr_t>(name);
+    const auto& old_O = before[old_shard_id].slot.get<tsr_t>(name);
+    for (int j = 0; j < NEW_SHARD_SIZE; ++j) {
+      if (j == new_shard_id) {
+        EXPECT_EQ(after[j].param.get<tsr_t>(name), old_W);
+        EXPECT_EQ(after[j].slot.get<tsr_t>(name), old_O);
+      } else {
+        EXPECT_EQ(after[j].param.count(name), 0u);
+        EXPECT_EQ(after[j].slot.count(name), 0u);
+      }
+    }
+  }
+
+  // TSStore and FreqStore.
+  for (int j = 0; j < NEW_SHARD_SIZE; ++j) {
+    size_t size = after[j].param.get<srm_t>("S").size();
+    EXPECT_EQ(after[j].ts_size, size);
+    EXPECT_EQ(after[j].freq_size, size);
+  }
+}
+
+}  // namespace deepx_core
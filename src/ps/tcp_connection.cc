@@ -118,9 +118,12 @@ void TcpConnection::PrepareOutBuf() {
   out_bytes_ = 0;
 }
 
-MutableBuffers TcpConnection::GetOutBuf() {
-  return asio::buffer((void*)(out_stream_.GetData() + out_bytes_),
-                      out_stream_.GetSize() - out_bytes_);
+const ConstBuffers& TcpConnection::GetOutBuf() {
+  out_bufs_.clear();
+  out_stream_.ForEachBuf(out_bytes_, [this](const char* data, size_t size) {
+    out_bufs_.emplace_back(data, size);
+  });
+  return out_bufs_;
 }
 
 int TcpConnection::TryReadMessage(size_t in_bytes) {
@@ -177,19 +180,13 @@ int TcpConnection::ReadMessage() {
 
 int TcpConnection::WriteMessage() {
   std::error_code ec;
-  size_t to_out_bytes, n;
   PrepareOutBuf();
-  to_out_bytes = out_stream_.GetSize();
-  while (to_out_bytes != 0) {
-    n = socket_->write_some(GetOutBuf(), ec);
-    if (ec) {
-      DXERROR("Failed to write to %s: %s.", to_string(remote_).c_str(),
-              ec.message().c_str());
-      Close();
-      return -1;
-    }
-    to_out_bytes -= n;
-    out_bytes_ += n;
+  out_bytes_ += asio::write(*socket_, GetOutBuf(), ec);
+  if (ec) {
+    DXERROR("Failed to write to %s: %s.", to_string(remote_).c_str(),
+            ec.message().c_str());
+    Close();
+    return -1;
   }
   return 0;
 }
@@ -293,6 +290,18 @@ int TcpConnection::RpcTerminationNotify() {
   return Rpc(DIST_MESSAGE_TYPE_TERMINATION_NOTIFY);
 }
 
+int TcpConnection::RpcShardExportRequest() {
+  return Rpc(DIST_MESSAGE_TYPE_SHARD_EXPORT_REQUEST);
+}
+
+int TcpConnection::RpcShardImportRequest() {
+  return Rpc(DIST_MESSAGE_TYPE_SHARD_IMPORT_REQUEST);
+}
+
+int TcpConnection::RpcShardCommitRequest() {
+  return Rpc(DIST_MESSAGE_TYPE_SHARD_COMMIT_REQUEST);
+}
+
 int TcpConnection::RpcUserRequest() {
   return Rpc(DIST_MESSAGE_TYPE_USER_REQUEST);
 }
@@ -386,6 +395,10 @@ int TcpConnections::RpcTerminationNotify(const std::vector<int>* masks) {
   return Rpc(DIST_MESSAGE_TYPE_TERMINATION_NOTIFY, masks);
 }
 
+int TcpConnections::RpcShardCommitRequest(const std::vector<int>* masks) {
+  return Rpc(DIST_MESSAGE_TYPE_SHARD_COMMIT_REQUEST, masks);
+}
+
 int TcpConnections::RpcUserRequest(const std::vector<int>* masks) {
   return Rpc(DIST_MESSAGE_TYPE_USER_REQUEST, masks);
 }
@@ -398,4 +411,59 @@ int TcpConnections::RpcUserNotify(const std::vector<int>* masks) {
   return Rpc(DIST_MESSAGE_TYPE_USER_NOTIFY, masks);
 }
 
+int TcpConnections::RpcShardMigrate(int shard_size,
+                                    const std::string& shard_func_name) {
+  if ((int)size() != shard_size) {
+    DXERROR("Inconsistent shard size: %d vs %d.", (int)size(), shard_size);
+    return -1;
+  }
+
+  DXINFO("Migrating to shard %s/%d...", shard_func_name.c_str(), shard_size);
+  for (int i = 0; i < shard_size; ++i) {
+    TcpConnection* from = (*this)[i].get();
+    for (int j = 0; j < shard_size; ++j) {
+      if (i == j) {
+        continue;
+      }
+
+      auto* request =
+          from->mutable_out_message()->mutable_shard_export_request();
+      request->shard_size = shard_size;
+      request->shard_func_name = shard_func_name;
+      request->shard_id = j;
+      if (from->RpcShardExportRequest() == -1) {
+        return -1;
+      }
+      const const_string_view& buf =
+          from->in_message().shard_export_response().buf;
+      if (buf.empty()) {
+        DXERROR("PS %d doesn't support shard migration.", i);
+        return -1;
+      }
+
+      TcpConnection* to = (*this)[j].get();
+      to->mutable_out_message()->mutable_shard_import_request()->buf.assign(
+          buf.data(), buf.size());
+      if (to->RpcShardImportRequest() == -1) {
+        return -1;
+      }
+      to->mutable_out_message()->mutable_shard_import_request()->buf.clear();
+      DXINFO("Migrated %zu bytes from PS %d to PS %d.", buf.size(), i, j);
+    }
+  }
+
+  for (int i = 0; i < shard_size; ++i) {
+    auto* request =
+        (*this)[i]->mutable_out_message()->mutable_shard_commit_request();
+    request->shard_size = shard_size;
+    request->shard_func_name = shard_func_name;
+    request->shard_id = i;
+  }
+  if (RpcShardCommitRequest() == -1) {
+    return -1;
+  }
+  DXINFO("Done.");
+  return 0;
+}
+
 }  // namespace deepx_core
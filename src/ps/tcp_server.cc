@@ -103,8 +103,8 @@ void TcpServer::OnRead(conn_t conn, size_t in_bytes) {
 }
 
 void TcpServer::AsyncWrite(conn_t conn) {
-  conn->socket().async_write_some(
-      conn->GetOutBuf(),
+  asio::async_write(
+      conn->socket(), conn->GetOutBuf(),
       [this, conn](const std::error_code& ec, size_t out_bytes) {
         if (ec) {
           DeleteConnection(conn);
@@ -5,10 +5,27 @@
 #include <deepx_core/dx_gtest.h>
 #include <deepx_core/tensor/data_type.h>
 #include <deepx_core/tensor/ll_tensor.h>
+#include <random>
 
 namespace deepx_core {
 
-class LLSparseTensorTest : public testing::Test, public DataTypeD {};
+class LLSparseTensorTest : public testing::Test, public DataTypeD {
+ protected:
+  std::default_random_engine engine;
+
+ protected:
+  void RandomCSR(int row, int row_nnz, int_t max_col, csr_t* X) {
+    std::uniform_int_distribution<int_t> col_dist(0, max_col - 1);
+    std::uniform_real_distribution<float_t> value_dist(-1, 1);
+    X->clear();
+    for (int i = 0; i < row; ++i) {
+      for (int j = 0; j < row_nnz; ++j) {
+        X->emplace(col_dist(engine), value_dist(engine));
+      }
+      X->add_row();
+    }
+  }
+};
 
 TEST_F(LLSparseTensorTest, add_col1) {
   srm_t X{{0, 2}, {{1}, {2}}};
@@ -105,6 +122,34 @@ TEST_F(LLSparseTensorTest, gesmsm_col2) {
   EXPECT_TSR_NEAR(Z, expected_Z2);
 }
 
+TEST_F(LLSparseTensorTest, gesmsm_random) {
+  for (int n : {1, 3}) {
+    for (int row_nnz : {0, 1, 7, 50}) {
+      csr_t X;
+      RandomCSR(37, row_nnz, 200, &X);
+      srm_t Y;
+      Y.set_col(n);
+      for (int_t j = 0; j < 200; j += 2) {
+        Y.get_row_no_init(j)[0] = (float_t)j;
+      }
+
+      tsr_t Z(Shape(X.row(), n));
+      ll_sparse_tensor_t::gesmsm(X, Y, 0, &Z);
+
+      tsr_t expected_Z(Shape(X.row(), n));
+      expected_Z.zeros();
+      CSR_FOR_EACH_ROW(X, i) {
+        CSR_FOR_EACH_COL(X, i) {
+          if (CSR_COL(X) % 2 == 0) {
+            expected_Z.data(i * n) += CSR_VALUE(X) * CSR_COL(X);
+          }
+        }
+      }
+      EXPECT_TSR_NEAR(Z, expected_Z);
+    }
+  }
+}
+
 TEST_F(LLSparseTensorTest, gestmm_mod_col1) {
   csr_t X{{0, 1, 4, 6, 7},
           {1, 2, 3, 4, 15, 16, 17},
@@ -209,6 +254,80 @@ TEST_F(LLSparseTensorTest, gestmm_col2) {
   EXPECT_SRM_NEAR(Z, expected_Z2);
 }
 
+TEST_F(LLSparseTensorTest, gesmsm_intra_op) {
+  csr_t X;
+  RandomCSR(1000, 32, 2000, &X);
+  for (int n : {1, 4}) {
+    srm_t Y;
+    Y.set_col(n);
+    Y.set_initializer(TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+    for (int_t id = 0; id < 2000; id += 2) {
+      Y.get_row(engine, id);
+    }
+    tsr_t expected_Z(Shape(X.row(), n));
+    ll_sparse_tensor_t::gesmsm(X, Y, 0, &expected_Z);
+
+    IntraOpThreadGuard guard(4);
+    tsr_t Z(Shape(X.row(), n));
+    ll_sparse_tensor_t::gesmsm(X, Y, 0, &Z);
+    EXPECT_TSR_NEAR(Z, expected_Z);
+  }
+}
+
+TEST_F(LLSparseTensorTest, gesmm_mod_intra_op) {
+  csr_t X;
+  RandomCSR(1000, 32, 2000, &X);
+  for (int n : {1, 4}) {
+    tsr_t Y(Shape(500, n));
+    Y.randn(engine);
+    tsr_t expected_Z(Shape(X.row(), n));
+    ll_sparse_tensor_t::gesmm_mod(X, Y, 0, &expected_Z);
+
+    IntraOpThreadGuard guard(4);
+    tsr_t Z(Shape(X.row(), n));
+    ll_sparse_tensor_t::gesmm_mod(X, Y, 0, &Z);
+    EXPECT_TSR_NEAR(Z, expected_Z);
+  }
+}
+
+TEST_F(LLSparseTensorTest, gestmm_intra_op) {
+  csr_t X;
+  RandomCSR(1000, 32, 2000, &X);
+  for (int n : {1, 4}) {
+    tsr_t Y(Shape(X.row(), n));
+    Y.randn(engine);
+    srm_t expected_Z;
+    expected_Z.set_col(n);
+    ll_sparse_tensor_t::gestmm(X, Y, 0, &expected_Z);
+    ll_sparse_tensor_t::gestmm(X, Y, 1, &expected_Z);
+
+    IntraOpThreadGuard guard(4);
+    srm_t Z;
+    Z.set_col(n);
+    ll_sparse_tensor_t::gestmm(X, Y, 0, &Z);
+    ll_sparse_tensor_t::gestmm(X, Y, 1, &Z);
+    EXPECT_SRM_NEAR(Z, expected_Z);
+  }
+}
+
+TEST_F(LLSparseTensorTest, gestmm_mod_intra_op) {
+  csr_t X;
+  RandomCSR(1000, 32, 2000, &X);
+  for (int n : {1, 4}) {
+    tsr_t Y(Shape(X.row(), n));
+    Y.randn(engine);
+    srm_t expected_Z;
+    expected_Z.set_col(n);
+    ll_sparse_tensor_t::gestmm_mod(500, X, Y, 0, &expected_Z);
+
+    IntraOpThreadGuard guard(4);
+    srm_t Z;
+    Z.set_col(n);
+    ll_sparse_tensor_t::gestmm_mod(500, X, Y, 0, &Z);
+    EXPECT_SRM_NEAR(Z, expected_Z);
+  }
+}
+
 TEST_F(LLSparseTensorTest, add_to_tsr) {
   tsr_t X{{0, 1, 2}, {3, 4, 5}};
   tsr_t Z{{0, 1, 2}, {3, 4, 5}};
@@ -0,0 +1,103 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/common/stream.h>
+#include <deepx_core/dx_gtest.h>
+#include <deepx_core/tensor/data_type.h>
+#include <random>
+#include <vector>
+
+namespace deepx_core {
+
+class QuantizedSparseRowMatrixTest : public testing::Test, public DataTypeD {
+ protected:
+  std::default_random_engine engine;
+  srm_t W;
+
+ protected:
+  void SetUp() override {
+    W.set_col(8);
+    W.set_initializer(TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+    for (int_t i = 0; i < 100; i += 2) {
+      W.get_row(engine, i);
+    }
+  }
+
+  void TestQuantize(int dtype, double eps) {
+    qsrm_t qW;
+    qW.quantize(W, dtype);
+    EXPECT_EQ(qW.col(), 8);
+    EXPECT_EQ(qW.dtype(), dtype);
+    EXPECT_EQ(qW.size(), W.size());
+
+    std::vector<float_t> row(8), y(8);
+    for (int_t i = 0; i < 100; ++i) {
+      int index = qW.find_row(i);
+      if (i % 2) {
+        EXPECT_EQ(index, -1);
+        continue;
+      }
+
+      ASSERT_GE(index, 0);
+      const float_t* w = W.get_row_no_init(i);
+      qW.get_row(index, row.data());
+      y.assign(8, 1);
+      qW.axpy_row(index, 2, y.data());
+      for (int j = 0; j < 8; ++j) {
+        EXPECT_NEAR(row[j], w[j], eps);
+        EXPECT_NEAR(y[j], 1 + 2 * row[j], 1e-6);
+      }
+    }
+  }
+};
+
+TEST_F(QuantizedSparseRowMatrixTest, quantize_int8) {
+  TestQuantize(TENSOR_DTYPE_INT8, 0.02);
+  qsrm_t qW;
+  qW.quantize(W, TENSOR_DTYPE_INT8);
+  EXPECT_EQ(qW.bytes(), 50 * (sizeof(float_t) + 8));
+}
+
+TEST_F(QuantizedSparseRowMatrixTest, quantize_fp16) {
+  TestQuantize(TENSOR_DTYPE_FLOAT16, 0.002);
+  qsrm_t qW;
+  qW.quantize(W, TENSOR_DTYPE_FLOAT16);
+  EXPECT_EQ(qW.bytes(), 50 * 8 * 2u);
+}
+
+TEST_F(QuantizedSparseRowMatrixTest, clear) {
+  qsrm_t qW;
+  qW.quantize(W, TENSOR_DTYPE_INT8);
+  qW.clear();
+  EXPECT_TRUE(qW.empty());
+  EXPECT_EQ(qW.bytes(), 0u);
+  EXPECT_EQ(qW.find_row(0), -1);
+}
+
+TEST_F(QuantizedSparseRowMatrixTest, WriteRead) {
+  qsrm_t qW, read_qW;
+  qW.quantize(W, TENSOR_DTYPE_INT8);
+
+  OutputStringStream os;
+  InputStringStream is;
+
+  os << qW;
+  ASSERT_TRUE(os);
+
+  is.SetView(os.GetBuf());
+  is >> read_qW;
+  ASSERT_TRUE(is);
+
+  EXPECT_EQ(read_qW.shape(), qW.shape());
+  EXPECT_EQ(read_qW.dtype(), qW.dtype());
+  EXPECT_EQ(read_qW.size(), qW.size());
+  std::vector<float_t> row(8), read_row(8);
+  for (int_t i = 0; i < 100; i += 2) {
+    qW.get_row(qW.find_row(i), row.data());
+    read_qW.get_row(read_qW.find_row(i), read_row.data());
+    EXPECT_EQ(read_row, row);
+  }
+}
+
+}  // namespace deepx_core
@@ -0,0 +1,162 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+
+#include <deepx_core/common/stream.h>
+#include <deepx_core/dx_gtest.h>
+#include <deepx_core/tensor/data_type.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace deepx_core {
+
+class QuantizedTensorTest : public testing::Test, public DataTypeD {
+ protected:
+  std::default_random_engine engine;
+  tsr_t W;
+  double max_abs = 0;
+
+ protected:
+  void SetUp() override {
+    W.resize(16, 8);
+    W.randn(engine);
+    W.data(3) = 0;
+    for (int i = 0; i < W.total_dim(); ++i) {
+      max_abs = std::max(max_abs, std::fabs(W.data(i)));
+    }
+  }
+
+  // max |W - dequantized W|
+  double GetMaxError(const qtsr_t& qW) const {
+    tsr_t dW;
+    qW.dequantize(&dW);
+    double max_error = 0;
+    for (int i = 0; i < W.total_dim(); ++i) {
+      double error = std::fabs(W.data(i) - dW.data(i));
+      if (max_error < error) {
+        max_error = error;
+      }
+    }
+    return max_error;
+  }
+};
+
+TEST_F(QuantizedTensorTest, Half) {
+  const float values[] = {0,    1,     -1,     0.5f,     -2.75f,
+                          1e-3f, 1e-6f, 65504, -1e-7f, 3.14159f};
+  for (float value : values) {
+    float f = HalfToFloat(FloatToHalf(value));
+    EXPECT_NEAR(f, value, std::fabs(value) / 1024 + 1e-7f);
+  }
+  EXPECT_EQ(FloatToHalf(1), 0x3c00);
+  EXPECT_EQ(FloatToHalf(-2), 0xc000);
+  EXPECT_EQ(FloatToHalf(65504), 0x7bff);
+  EXPECT_EQ(FloatToHalf(1e6f), 0x7c00);
+  EXPECT_EQ(FloatToHalf(-std::numeric_limits<float>::infinity()), 0xfc00);
+  EXPECT_TRUE(std::isnan(HalfToFloat(
+      FloatToHalf(std::numeric_limits<float>::quiet_NaN()))));
+  // round to nearest even
+  EXPECT_EQ(FloatToHalf(1 + 1.0f / 2048), 0x3c00);
+  EXPECT_EQ(FloatToHalf(1 + 3.0f / 2048), 0x3c02);
+}
+
+TEST_F(QuantizedTensorTest, quantize_int8_axis0) {
+  qtsr_t qW;
+  qW.quantize(W, TENSOR_DTYPE_INT8, 0);
+  EXPECT_EQ(qW.shape(), W.shape());
+  EXPECT_EQ(qW.dtype(), TENSOR_DTYPE_INT8);
+  EXPECT_EQ(qW.axis(), 0);
+  EXPECT_EQ(qW.bytes(), 16 * sizeof(float_t) + 16 * 8u);
+  EXPECT_LT(GetMaxError(qW), max_abs / 127);
+}
+
+TEST_F(QuantizedTensorTest, quantize_int8_axis1) {
+  qtsr_t qW;
+  qW.quantize(W, TENSOR_DTYPE_INT8, 1);
+  EXPECT_EQ(qW.axis(), 1);
+  EXPECT_EQ(qW.bytes(), 8 * sizeof(float_t) + 16 * 8u);
+  EXPECT_LT(GetMaxError(qW), max_abs / 127);
+}
+
+TEST_F(QuantizedTensorTest, quantize_fp16) {
+  qtsr_t qW;
+  qW.quantize(W, TENSOR_DTYPE_FLOAT16, 1);
+  EXPECT_EQ(qW.dtype(), TENSOR_DTYPE_FLOAT16);
+  EXPECT_EQ(qW.bytes(), 16 * 8 * 2u);
+  EXPECT_LT(GetMaxError(qW), max_abs / 1024);
+}
+
+TEST_F(QuantizedTensorTest, axpy_row) {
+  for (int axis = 0; axis < 2; ++axis) {
+    qtsr_t qW;
+    qW.quantize(W, TENSOR_DTYPE_INT8, axis);
+    tsr_t dW;
+    qW.dequantize(&dW);
+    tsr_t y, expected_y;
+    y.resize(8);
+    y.ones();
+    expected_y.resize(8);
+    expected_y.ones();
+    qW.axpy_row(5, 0.5, y.data());
+    for (int j = 0; j < 8; ++j) {
+      expected_y.data(j) += 0.5 * dW.data(5 * 8 + j);
+    }
+    EXPECT_TSR_NEAR(y, expected_y);
+  }
+}
+
+TEST_F(QuantizedTensorTest, gemm) {
+  const int dtypes[] = {TENSOR_DTYPE_INT8, TENSOR_DTYPE_FLOAT16};
+  for (int dtype : dtypes) {
+    // more rows than a block
+    tsr_t X;
+    X.resize(100, 16);
+    X.randn(engine);
+    X.data(7) = 0;
+    qtsr_t qW;
+    qW.quantize(W, dtype, 1);
+    tsr_t dW;
+    qW.dequantize(&dW);
+
+    tsr_t Z, expected_Z;
+    Z.resize(100, 8);
+    expected_Z.resize(100, 8);
+    expected_Z.zeros();
+    qW.gemm(100, X.data(), Z.data());
+    for (int i = 0; i < 100; ++i) {
+      for (int l = 0; l < 16; ++l) {
+        for (int j = 0; j < 8; ++j) {
+          expected_Z.data(i * 8 + j) += X.data(i * 16 + l) * dW.data(l * 8 + j);
+        }
+      }
+    }
+    EXPECT_TSR_NEAR(Z, expected_Z);
+  }
+}
+
+TEST_F(QuantizedTensorTest, WriteRead) {
+  qtsr_t qW, read_qW;
+  qW.quantize(W, TENSOR_DTYPE_INT8, 1);
+
+  OutputStringStream os;
+  InputStringStream is;
+
+  os << qW;
+  ASSERT_TRUE(os);
+
+  is.SetView(os.GetBuf());
+  is >> read_qW;
+  ASSERT_TRUE(is);
+
+  tsr_t dW, read_dW;
+  qW.dequantize(&dW);
+  read_qW.dequantize(&read_dW);
+  EXPECT_EQ(read_qW.shape(), qW.shape());
+  EXPECT_EQ(read_qW.dtype(), qW.dtype());
+  EXPECT_EQ(read_qW.axis(), qW.axis());
+  EXPECT_EQ(read_dW, dW);
+}
+
+}  // namespace deepx_core
@@ -125,6 +125,48 @@ TEST_F(SparseRowMatrixTest, merge_if_2) {
   EXPECT_EQ(X, expected_X);
 }
 
+TEST_F(SparseRowMatrixTest, split_if) {
+  srm_t X{{1, 2, 3, 4}, {{1, 1}, {2, 2}, {3, 3}, {4, 4}}};
+  X.set_initializer(TENSOR_INITIALIZER_TYPE_ONES);
+  srm_t Y;
+  X.split_if(&Y, [](const srm_t::value_type& entry) {
+    return entry.first % 2 == 0;
+  });
+
+  srm_t expected_X{{1, 3}, {{1, 1}, {3, 3}}};
+  expected_X.set_initializer(TENSOR_INITIALIZER_TYPE_ONES);
+  srm_t expected_Y{{2, 4}, {{2, 2}, {4, 4}}};
+  expected_Y.set_initializer(TENSOR_INITIALIZER_TYPE_ONES);
+  EXPECT_EQ(X, expected_X);
+  EXPECT_EQ(Y, expected_Y);
+
+  srm_t Z{{2}, {{0, 0, 0}}};
+  EXPECT_ANY_THROW(X.split_if(&Z, [](const srm_t::value_type&) {
+    return true;
+  }));
+}
+
+TEST_F(SparseRowMatrixTest, split) {
+  srm_t X{{1, 2}, {{1, 1}, {2, 2}}};
+  X.set_initializer(TENSOR_INITIALIZER_TYPE_ONES);
+  const float_t* row = X.get_row_no_init(2);
+  srm_t Y;
+  EXPECT_TRUE(X.split(&Y, 2));
+  EXPECT_FALSE(X.split(&Y, 3));
+
+  srm_t expected_X{{1}, {{1, 1}}};
+  expected_X.set_initializer(TENSOR_INITIALIZER_TYPE_ONES);
+  srm_t expected_Y{{2}, {{2, 2}}};
+  expected_Y.set_initializer(TENSOR_INITIALIZER_TYPE_ONES);
+  EXPECT_EQ(X, expected_X);
+  EXPECT_EQ(Y, expected_Y);
+  // The row is moved, not copied.
+  EXPECT_EQ(Y.get_row_no_init(2), row);
+
+  srm_t Z{{2}, {{0, 0, 0}}};
+  EXPECT_ANY_THROW(X.split(&Z, 1));
+}
+
 TEST_F(SparseRowMatrixTest, assign) {
   srm_t X{{1, 2}, {{1, 11}, {2, 22}}};
   std::vector<float_t> row_value;
@@ -325,6 +367,142 @@ TEST_F(SparseRowMatrixTest, get_scalar_TENSOR_INITIALIZER_TYPE_RANDN) {
   EXPECT_EQ(X.get_scalar_no_init(2), 2);
 }
 
+TEST_F(SparseRowMatrixTest, get_rows_no_init) {
+  srm_t X;
+  X.set_col(1);
+  std::vector<int_t> rows;
+  for (int_t i = 0; i < 100; ++i) {
+    X.get_row_no_init(i * 2)[0] = (float_t)i;
+    rows.emplace_back(i);
+  }
+  rows.emplace_back(6);
+
+  const srm_t& cX = X;
+  std::vector<const float_t*> crow_values(rows.size());
+  cX.get_rows_no_init(rows.data(), rows.size(), crow_values.data());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    if (rows[i] % 2 == 0) {
+      ASSERT_TRUE(crow_values[i]);
+      EXPECT_EQ(crow_values[i][0], rows[i] / 2);
+    } else {
+      EXPECT_FALSE(crow_values[i]);
+    }
+  }
+  EXPECT_EQ(X.size(), 100u);
+
+  std::vector<float_t*> row_values(rows.size());
+  X.get_rows_no_init(rows.data(), rows.size(), row_values.data());
+  EXPECT_EQ(X.size(), 150u);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    ASSERT_TRUE(row_values[i]);
+    EXPECT_EQ(row_values[i], X.get_row_no_init(rows[i]));
+    EXPECT_EQ(row_values[i][0], rows[i] % 2 == 0 ? rows[i] / 2 : 0);
+  }
+}
+
+TEST_F(SparseRowMatrixTest, set_mapped) {
+  // rows 0, 2, ..., 38 in 4 buckets
+  const uint64_t bucket_size = 4;
+  std::vector<uint64_t> bucket(bucket_size + 1, 0);
+  std::vector<int_t> row;
+  std::vector<float_t> value;
+  for (uint64_t b = 0; b < bucket_size; ++b) {
+    for (int_t i = 0; i < 40; i += 2) {
+      if (srm_t::mapped_index_t::get_bucket(i, bucket_size) == b) {
+        row.emplace_back(i);
+        value.emplace_back((float_t)i);
+      }
+    }
+    bucket[b + 1] = row.size();
+  }
+  srm_t::mapped_index_t index;
+  index.bucket = bucket.data();
+  index.bucket_size = bucket_size;
+  index.row = row.data();
+  index.value = value.data();
+  index.size = row.size();
+  index.col = 1;
+
+  srm_t X;
+  X.set_col(1);
+  X.set_mapped(index);
+  // row 4 of X shadows the mapped one.
+  X.get_row_no_init(4)[0] = 100;
+  EXPECT_EQ(X.size(), 1u);
+
+  const srm_t& cX = X;
+  EXPECT_EQ(cX.get_row_no_init(4)[0], 100);
+  EXPECT_EQ(cX.get_row_no_init(6)[0], 6);
+  EXPECT_FALSE(cX.get_row_no_init(7));
+  EXPECT_EQ(cX.get_scalar_no_init(38), 38);
+  EXPECT_EQ(cX.get_scalar_no_init(39), 0);
+
+  std::vector<int_t> rows;
+  for (int_t i = 0; i < 50; ++i) {
+    rows.emplace_back(i);
+  }
+  std::vector<const float_t*> crow_values(rows.size());
+  cX.get_rows_no_init(rows.data(), rows.size(), crow_values.data());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    if (rows[i] == 4) {
+      EXPECT_EQ(crow_values[i][0], 100);
+    } else if (rows[i] % 2 == 0 && rows[i] < 40) {
+      ASSERT_TRUE(crow_values[i]);
+      EXPECT_EQ(crow_values[i][0], rows[i]);
+    } else {
+      EXPECT_FALSE(crow_values[i]);
+    }
+  }
+
+  X.clear();
+  EXPECT_EQ(X.mapped().size, 0u);
+}
+
+TEST_F(SparseRowMatrixTest, set_base) {
+  srm_t base;
+  base.set_col(1);
+  for (int_t i = 0; i < 40; i += 2) {
+    base.get_row_no_init(i)[0] = (float_t)i;
+  }
+
+  srm_t X;
+  X.set_col(1);
+  X.set_base(&base);
+  // row 4 of X overlays the base one.
+  X.get_row_no_init(4)[0] = 100;
+  X.get_row_no_init(5)[0] = 101;
+  EXPECT_EQ(X.size(), 2u);
+  EXPECT_EQ(base.get_row_no_init(4)[0], 4);
+
+  const srm_t& cX = X;
+  EXPECT_EQ(cX.get_row_no_init(4)[0], 100);
+  EXPECT_EQ(cX.get_row_no_init(5)[0], 101);
+  EXPECT_EQ(cX.get_row_no_init(6)[0], 6);
+  EXPECT_FALSE(cX.get_row_no_init(7));
+  EXPECT_EQ(cX.get_scalar_no_init(38), 38);
+  EXPECT_EQ(cX.get_scalar_no_init(39), 0);
+
+  std::vector<int_t> rows;
+  for (int_t i = 0; i < 50; ++i) {
+    rows.emplace_back(i);
+  }
+  std::vector<const float_t*> crow_values(rows.size());
+  cX.get_rows_no_init(rows.data(), rows.size(), crow_values.data());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    if (rows[i] == 4 || rows[i] == 5) {
+      EXPECT_EQ(crow_values[i][0], rows[i] + 96);
+    } else if (rows[i] % 2 == 0 && rows[i] < 40) {
+      ASSERT_TRUE(crow_values[i]);
+      EXPECT_EQ(crow_values[i][0], rows[i]);
+    } else {
+      EXPECT_FALSE(crow_values[i]);
+    }
+  }
+
+  X.clear();
+  EXPECT_FALSE(X.base());
+}
+
 TEST_F(SparseRowMatrixTest, find) {
   srm_t X{{2, 3}, {{2}, {3}}};
   const srm_t& cX = X;
@@ -400,4 +578,63 @@ TEST_F(SparseRowMatrixTest, WriteReadView) {
   EXPECT_EQ(X, read_X);
 }
 
+TEST_F(SparseRowMatrixTest, WriteReadEach) {
+  srm_t X{{1, 2, 3, 4}, {{1, 11}, {2, 22}, {3, 33}, {4, 44}}}, read_X;
+  X.set_initializer(TENSOR_INITIALIZER_TYPE_CONSTANT, 1);
+
+  OutputStringStream os;
+  InputStringStream is;
+
+  os << X;
+  ASSERT_TRUE(os);
+
+  std::vector<std::pair<int_t, Vector<float_t>>> rows;
+  is.SetView(os.GetBuf());
+  ReadEach(is, read_X, [&rows](std::pair<int_t, Vector<float_t>>& entry) {
+    rows.emplace_back(entry.first, entry.second);
+  });
+  ASSERT_TRUE(is);
+  EXPECT_EQ(read_X.col(), 2);
+  EXPECT_EQ(rows.size(), 4u);
+
+  os.clear();
+  WriteEach(os, read_X, (uint64_t)rows.size(), [&rows](OutputStream& os) {
+    for (const auto& entry : rows) {
+      os << entry.first << entry.second;
+    }
+  });
+  ASSERT_TRUE(os);
+
+  is.SetView(os.GetBuf());
+  read_X.clear();
+  is >> read_X;
+  ASSERT_TRUE(is);
+  EXPECT_EQ(read_X, X);
+}
+
+TEST_F(SparseRowMatrixTest, WriteRead_extra_rows) {
+  srm_t X{{1, 2}, {{1, 1}, {2, 2}}};
+  SRMExtraRows extra_rows;
+  extra_rows.size = 2;
+  extra_rows.func = [](OutputStream& os) {  // NOLINT
+    for (int_t id : {3, 4}) {
+      os << id << Vector<float_t>{(float_t)id, (float_t)id};
+    }
+  };
+  X.set_extra_rows(&extra_rows);
+  EXPECT_EQ(X.size(), 2u);
+
+  OutputStringStream os;
+  InputStringStream is;
+  srm_t read_X;
+  os << X;
+  ASSERT_TRUE(os);
+  is.SetView(os.GetBuf());
+  is >> read_X;
+  ASSERT_TRUE(is);
+  srm_t expected{{1, 2, 3, 4}, {{1, 1}, {2, 2}, {3, 3}, {4, 4}}};
+  EXPECT_EQ(read_X, expected);
+  EXPECT_TRUE(read_X.extra_rows() == nullptr);
+}
+
 }  // namespace deepx_core
@@ -0,0 +1,159 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Benchmark of ColdStore, throughput of pulls versus memory budgets.
+//
+// Ids of pulls follow a Zipfian distribution,
+// the rows they hit are looked up like 'Model::Pull'.
+// Budget 0 means no ColdStore, all rows are in memory.
+//
+
+#include <deepx_core/common/str_util.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/cold_store.h>
+#include <deepx_core/graph/dist_proto.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gflags/gflags.h>
+#include <chrono>
+#include <cmath>  // std::pow
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+DEFINE_string(dir, "/tmp", "local directory of ColdStore files");
+DEFINE_uint64(row, 10000000, "# of rows of the srm");
+DEFINE_int32(col, 16, "# of cols of the srm");
+DEFINE_string(budget, "0,512,256,128,64",
+              "comma separated memory budgets in MB, 0 means no ColdStore");
+DEFINE_int32(batch, 4096, "# of ids of each pull");
+DEFINE_double(zipf, 1.1, "skewness of ids");
+DEFINE_int32(repeat, 1000, "# of pulls");
+
+namespace deepx_core {
+namespace {
+
+using float_t = DataType::float_t;
+using int_t = DataType::int_t;
+using srm_t = DataType::srm_t;
+using id_set_t = DataType::id_set_t;
+using steady_clock_t = std::chrono::steady_clock;
+
+// Ids are scattered, so that adjacent ids are not in adjacent buckets.
+int_t GetId(uint64_t i) noexcept {
+  return (int_t)(i * 0x9e3779b97f4a7c15ULL);  // magic number
+}
+
+// Sample ranks with P(i) ~ 1 / (i + 1)^zipf approximately.
+class IdSampler {
+ private:
+  std::default_random_engine engine_;
+  std::uniform_real_distribution<double> dist_;
+
+ public:
+  uint64_t Sample() {
+    double u = dist_(engine_);
+    // inverse CDF of a continuous power law on [1, row + 1)
+    double n = (double)FLAGS_row + 1;
+    double s = 1 - FLAGS_zipf;
+    double x;
+    if (s == 0) {
+      x = std::pow(n, u);
+    } else {
+      x = std::pow(1 + u * (std::pow(n, s) - 1), 1 / s);
+    }
+    return ((uint64_t)x - 1) % FLAGS_row;
+  }
+};
+
+void Run(const std::string& budget) {
+  TensorMap param;
+  auto& W = param.insert<srm_t>("W");
+  W.set_col(FLAGS_col);
+  W.reserve(FLAGS_row);
+  std::vector<float_t> row(FLAGS_col, 1);
+  for (uint64_t i = 0; i < FLAGS_row; ++i) {
+    W.assign(GetId(i), row.data());
+  }
+
+  std::unique_ptr<ColdStore> cold_store;
+  if (std::stod(budget) > 0) {
+    cold_store.reset(new ColdStore);
+    cold_store->set_file_prefix(FLAGS_dir + "/cold_store_bench");
+    cold_store->Init(&param, nullptr);
+    StringMap config;
+    config["W"] = budget;
+    DXCHECK_THROW(cold_store->InitConfig(config));
+    cold_store->Spill();
+  }
+
+  IdSampler sampler;
+  PullRequest pull_request;
+  pull_request.is_train = 1;
+  id_set_t& id_set = pull_request.srm_map["W"];
+  double checksum = 0;
+  auto func = [&W, &id_set, &checksum]() {
+    for (int_t id : id_set) {
+      const float_t* embedding = ((const srm_t&)W).get_row_no_init(id);
+      if (embedding) {
+        checksum += embedding[0];
+      }
+    }
+  };
+
+  double second = 0;
+  size_t id = 0;
+  for (int i = 0; i < FLAGS_repeat; ++i) {
+    id_set.clear();
+    for (int j = 0; j < FLAGS_batch; ++j) {
+      id_set.emplace(GetId(sampler.Sample()));
+    }
+    id += id_set.size();
+    auto begin = steady_clock_t::now();
+    if (cold_store) {
+      cold_store->Pull(pull_request, func);
+    } else {
+      func();
+    }
+    second +=
+        std::chrono::duration<double>(steady_clock_t::now() - begin).count();
+  }
+
+  uint64_t fault_in = cold_store ? cold_store->stat().fault_in : 0;
+  DXINFO(
+      "budget=%sMB: %.2fM ids/s, %.1fms/pull, rows in memory=%zu, "
+      "fault in=%.2f%%, checksum=%.0f.",
+      budget.c_str(), id / second / 1e6, second * 1e3 / FLAGS_repeat,
+      W.size(), 100.0 * fault_in / id, checksum);
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(FLAGS_row > 0);
+  DXCHECK_THROW(FLAGS_col > 0);
+  DXCHECK_THROW(FLAGS_batch > 0);
+  DXCHECK_THROW(FLAGS_zipf > 0);
+  DXCHECK_THROW(FLAGS_repeat > 0);
+
+  std::vector<std::string> budgets;
+  Split(FLAGS_budget, ",", &budgets);
+  for (const std::string& budget : budgets) {
+    Run(budget);
+  }
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
@@ -0,0 +1,159 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Benchmark of Conv1d, Conv2d and Conv3d forward and backward
+// over typical shapes.
+//
+
+#include <deepx_core/common/str_util.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/graph_node.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/graph/op_context.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+DEFINE_string(case, "", "comma separated cases to run, empty means all");
+DEFINE_int32(repeat, 20, "# of forward and backward passes of each case");
+DEFINE_int32(intra_op_thread, 1, "# of intra-op threads");
+
+namespace deepx_core {
+namespace {
+
+using tsr_t = DataType::tsr_t;
+using steady_clock_t = std::chrono::steady_clock;
+
+struct Case {
+  const char* name;
+  int conv_rank;
+  Shape X;
+  Shape K;
+  int data_format;
+  int kernel;
+};
+
+// Text CNNs convolve sequences of embeddings,
+// image-like CNNs convolve small feature maps.
+const std::vector<Case> CASES = {
+    {"conv1d_nwc_text", 1, Shape(64, 100, 128), Shape(3, 128, 128),
+     GraphNodeConvBase::DATA_FORMAT_NWC, 3},
+    {"conv1d_ncw_text", 1, Shape(64, 128, 100), Shape(128, 128, 3),
+     GraphNodeConvBase::DATA_FORMAT_NCW, 3},
+    {"conv1d_nwc_pointwise", 1, Shape(64, 100, 128), Shape(1, 128, 128),
+     GraphNodeConvBase::DATA_FORMAT_NWC, 1},
+    {"conv2d_nhwc", 2, Shape(32, 32, 32, 16), Shape(3, 3, 16, 32),
+     GraphNodeConvBase::DATA_FORMAT_NHWC, 3},
+    {"conv2d_nchw", 2, Shape(32, 16, 32, 32), Shape(32, 16, 3, 3),
+     GraphNodeConvBase::DATA_FORMAT_NCHW, 3},
+    {"conv3d_ndhwc", 3, Shape(8, 16, 16, 16, 8), Shape(3, 3, 3, 8, 16),
+     GraphNodeConvBase::DATA_FORMAT_NDHWC, 3},
+    {"conv3d_ncdhw", 3, Shape(8, 8, 16, 16, 16), Shape(16, 8, 3, 3, 3),
+     GraphNodeConvBase::DATA_FORMAT_NCDHW, 3}};
+
+double ToMillisecond(steady_clock_t::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void Run(const Case& c) {
+  auto* X = new VariableNode("X", c.X, TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  auto* K = new VariableNode("K", c.K, TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  GraphNode* Z;
+  std::vector<int> ones(c.conv_rank, 1);
+  std::vector<int> zeros(c.conv_rank, 0);
+  if (c.conv_rank == 1) {
+    Z = new Conv1dNode("Z", X, K, c.data_format, 1, 1,
+                       GraphNodeConvBase::PADDING_MODE_SAME, 0);
+  } else if (c.conv_rank == 2) {
+    Z = new Conv2dNode("Z", X, K, c.data_format, ones, ones,
+                       GraphNodeConvBase::PADDING_MODE_SAME, zeros);
+  } else {
+    Z = new Conv3dNode("Z", X, K, c.data_format, ones, ones,
+                       GraphNodeConvBase::PADDING_MODE_SAME, zeros);
+  }
+  auto* L = new ReduceMeanNode("L", Z);
+
+  Graph graph;
+  DXCHECK_THROW(graph.Compile({L}, 1));
+  std::default_random_engine engine;
+  Model model;
+  model.Init(&graph);
+  DXCHECK_THROW(model.InitParam(engine));
+
+  OpContext op_context;
+  op_context.set_intra_op_thread(FLAGS_intra_op_thread);
+  op_context.Init(&graph, model.mutable_param());
+  DXCHECK_THROW(op_context.InitOp(std::vector<int>{0}, 0));
+
+  double forward_ms = 0, backward_ms = 0;
+  for (int i = 0; i <= FLAGS_repeat; ++i) {
+    auto begin = steady_clock_t::now();
+    op_context.InitForward();
+    op_context.Forward();
+    auto middle = steady_clock_t::now();
+    op_context.InitBackward();
+    op_context.Backward();
+    auto end = steady_clock_t::now();
+    // The first pass warms up.
+    if (i > 0) {
+      forward_ms += ToMillisecond(middle - begin);
+      backward_ms += ToMillisecond(end - middle);
+    }
+  }
+  forward_ms /= FLAGS_repeat;
+  backward_ms /= FLAGS_repeat;
+
+  // 2 * batch * out_channel * out spatial * in_channel * kernel spatial
+  const Shape& Zshape = Z->shape();
+  int ncx = c.data_format == GraphNodeConvBase::DATA_FORMAT_NCW ||
+            c.data_format == GraphNodeConvBase::DATA_FORMAT_NCHW ||
+            c.data_format == GraphNodeConvBase::DATA_FORMAT_NCDHW;
+  int in_channel = ncx ? c.X[1] : c.X[c.X.rank() - 1];
+  int kernel_spatial = 1;
+  for (int i = 0; i < c.conv_rank; ++i) {
+    kernel_spatial *= c.kernel;
+  }
+  double flop = 2.0 * Zshape.total_dim() * in_channel * kernel_spatial;
+  double checksum = op_context.hidden().get<tsr_t>("Z").sum();
+  DXINFO(
+      "%s: forward=%.3fms(%.2fGFLOPS), backward=%.3fms(%.2fGFLOPS), "
+      "checksum=%.4f.",
+      c.name, forward_ms, flop / forward_ms / 1e6, backward_ms,
+      2 * flop / backward_ms / 1e6, checksum);
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(FLAGS_repeat > 0);
+  std::vector<std::string> names;
+  if (!FLAGS_case.empty()) {
+    Split(FLAGS_case, ",", &names);
+  }
+
+  for (const Case& c : CASES) {
+    if (names.empty() ||
+        std::find(names.begin(), names.end(), c.name) != names.end()) {
+      Run(c);
+    }
+  }
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
@@ -0,0 +1,208 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Benchmark of FlatHashMap at high load factors.
+//
+// In 'linear' mode, buckets are probed one by one.
+// In 'group' mode, meta bytes of 16 buckets are matched at a time.
+//
+// In 'load_factor' bench, the bucket size is fixed,
+// keys are inserted until a load factor is reached,
+// then finds, erases and inserts after erases are timed.
+//
+// In 'latency' bench, keys are inserted into an empty map,
+// the worst single insertion latencies are reported,
+// which are dominated by rehashes.
+// Compare '--rehash_step=0' with '--rehash_step=8',
+// with a rehash step, no insertion allocates or fills a whole table,
+// so the worst latency stays bounded as '--key' grows.
+//
+
+#include <deepx_core/common/hash.h>
+#include <deepx_core/common/hash_map.h>
+#include <deepx_core/common/str_util.h>
+#include <deepx_core/dx_log.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+DEFINE_string(bench, "load_factor", "load_factor or latency");
+DEFINE_string(mode, "group", "linear or group");
+DEFINE_uint64(bucket, 1 << 22, "bucket size, a power of 2");
+DEFINE_string(load_factor, "0.25,0.5,0.6,0.65",
+              "comma separated load factors, less than 1 / 1.5");
+DEFINE_uint64(key, 50000000, "# of keys inserted in latency bench");
+DEFINE_uint64(rehash_step, 0, "rehash step in latency bench");
+
+namespace deepx_core {
+namespace {
+
+using steady_clock_t = std::chrono::steady_clock;
+
+double ToNanosecond(steady_clock_t::duration duration, size_t n) {
+  return std::chrono::duration<double, std::nano>(duration).count() /
+         (double)(n > 0 ? n : 1);
+}
+
+/************************************************************************/
+/* Bench */
+/************************************************************************/
+template <bool GroupProbe>
+class Bench {
+ private:
+  using hash_map_t = FlatHashMap<int64_t, int64_t, MurmurHash<int64_t>,
+                                 detail::KeyEqual<int64_t>, GroupProbe>;
+
+  std::default_random_engine engine_;
+  int64_t checksum_ = 0;
+
+ private:
+  void RunLoadFactor(double load_factor) {
+    size_t n = (size_t)(load_factor * (double)FLAGS_bucket);
+    std::vector<int64_t> keys(n * 3);
+    std::uniform_int_distribution<int64_t> key_dist;
+    for (int64_t& key : keys) {
+      key = key_dist(engine_);
+    }
+    // keys[0, n) are inserted,
+    // keys[n, 2n) are missed,
+    // keys[2n, 3n) are inserted after keys[0, n/2) are erased.
+    std::vector<int64_t> shuffled(keys.begin(), keys.begin() + n);
+    std::shuffle(shuffled.begin(), shuffled.end(), engine_);
+
+    hash_map_t m(FLAGS_bucket / 2);
+    DXCHECK_THROW(m.bucket_size() == FLAGS_bucket);
+
+    auto begin = steady_clock_t::now();
+    for (size_t i = 0; i < n; ++i) {
+      m.emplace(keys[i], (int64_t)i);
+    }
+    double insert_ns = ToNanosecond(steady_clock_t::now() - begin, n);
+
+    begin = steady_clock_t::now();
+    for (size_t i = 0; i < n; ++i) {
+      checksum_ += m.find(shuffled[i])->second;
+    }
+    double find_hit_ns = ToNanosecond(steady_clock_t::now() - begin, n);
+
+    begin = steady_clock_t::now();
+    for (size_t i = n; i < 2 * n; ++i) {
+      checksum_ += (int64_t)m.count(keys[i]);
+    }
+    double find_miss_ns = ToNanosecond(steady_clock_t::now() - begin, n);
+
+    begin = steady_clock_t::now();
+    for (size_t i = 0; i < n / 2; ++i) {
+      m.erase(m.find(keys[i]));
+    }
+    double erase_ns = ToNanosecond(steady_clock_t::now() - begin, n / 2);
+
+    begin = steady_clock_t::now();
+    for (size_t i = 2 * n; i < 2 * n + n / 2; ++i) {
+      m.emplace(keys[i], (int64_t)i);
+    }
+    double reinsert_ns = ToNanosecond(steady_clock_t::now() - begin, n / 2);
+
+    // Deleted buckets are probed through.
+    begin = steady_clock_t::now();
+    for (size_t i = n; i < 2 * n; ++i) {
+      checksum_ += (int64_t)m.count(keys[i]);
+    }
+    double find_miss_deleted_ns =
+        ToNanosecond(steady_clock_t::now() - begin, n);
+
+    DXINFO(
+        "%s: load_factor=%.2f, insert=%.1fns, find_hit=%.1fns, "
+        "find_miss=%.1fns, erase=%.1fns, reinsert=%.1fns, "
+        "find_miss_deleted=%.1fns.",
+        FLAGS_mode.c_str(), load_factor, insert_ns, find_hit_ns, find_miss_ns,
+        erase_ns, reinsert_ns, find_miss_deleted_ns);
+  }
+
+ public:
+  void RunLoadFactor() {
+    std::vector<double> load_factors;
+    DXCHECK_THROW(Split(FLAGS_load_factor, ",", &load_factors));
+    for (double load_factor : load_factors) {
+      DXCHECK_THROW(load_factor > 0 && load_factor < 1 / 1.5);
+      RunLoadFactor(load_factor);
+    }
+    DXINFO("checksum=%lld.", (long long)checksum_);  // NOLINT
+  }
+
+  void RunLatency() {
+    size_t n = (size_t)FLAGS_key;
+    std::vector<int64_t> keys(n);
+    std::uniform_int_distribution<int64_t> key_dist;
+    for (int64_t& key : keys) {
+      key = key_dist(engine_);
+    }
+
+    hash_map_t m;
+    m.set_rehash_step((size_t)FLAGS_rehash_step);
+    std::vector<double> latencies(n);
+    auto begin = steady_clock_t::now();
+    for (size_t i = 0; i < n; ++i) {
+      auto op_begin = steady_clock_t::now();
+      m.emplace(keys[i], (int64_t)i);
+      latencies[i] = ToNanosecond(steady_clock_t::now() - op_begin, 1);
+    }
+    double total_ms = std::chrono::duration<double, std::milli>(
+                          steady_clock_t::now() - begin)
+                          .count();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+      return latencies[(size_t)(p * (double)(latencies.size() - 1))];
+    };
+    DXINFO(
+        "%s: rehash_step=%zu, total=%.1fms, p50=%.1fns, p99.99=%.1fns, "
+        "max=%.3fms, bucket_size=%zu.",
+        FLAGS_mode.c_str(), (size_t)FLAGS_rehash_step, total_ms,
+        percentile(0.5), percentile(0.9999), latencies.back() / 1e6,
+        m.bucket_size());
+  }
+
+  void Run() {
+    if (FLAGS_bench == "load_factor") {
+      RunLoadFactor();
+    } else {
+      RunLatency();
+    }
+  }
+};
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(FLAGS_bench == "load_factor" || FLAGS_bench == "latency");
+  DXCHECK_THROW(FLAGS_bucket >= 128);
+  DXCHECK_THROW((FLAGS_bucket & (FLAGS_bucket - 1)) == 0);
+
+  if (FLAGS_mode == "linear") {
+    Bench<false>().Run();
+  } else if (FLAGS_mode == "group") {
+    Bench<true>().Run();
+  } else {
+    DXERROR("Invalid mode: %s.", FLAGS_mode.c_str());
+    return 1;
+  }
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
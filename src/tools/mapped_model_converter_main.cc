@@ -0,0 +1,114 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Convert a model file to a mapped model file for serving,
+// see 'MappedModel'.
+//
+
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/mapped_model.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+DEFINE_string(in_model, "", "input model file");
+DEFINE_string(out_model, "", "output mapped model file");
+DEFINE_int32(verify, 1, "open the output and compare it with the input");
+
+namespace deepx_core {
+namespace {
+
+using tsr_t = DataType::tsr_t;
+using srm_t = DataType::srm_t;
+using steady_clock_t = std::chrono::steady_clock;
+
+bool Verify(const TensorMap& param, const TensorMap& mapped_param) {
+  if (param.size() != mapped_param.size()) {
+    DXERROR("Inconsistent # of params: %zu vs %zu.", param.size(),
+            mapped_param.size());
+    return false;
+  }
+
+  for (const auto& entry : param) {
+    const std::string& name = entry.first;
+    auto it = mapped_param.find(name);
+    if (it == mapped_param.end()) {
+      DXERROR("Missing param: %s.", name.c_str());
+      return false;
+    }
+
+    if (entry.second.is<tsr_t>()) {
+      const auto& W = entry.second.unsafe_to_ref<tsr_t>();
+      if (!it->second.is<tsr_t>() || W != it->second.to_ref<tsr_t>()) {
+        DXERROR("Inconsistent param: %s.", name.c_str());
+        return false;
+      }
+    } else {
+      const auto& W = entry.second.unsafe_to_ref<srm_t>();
+      if (!it->second.is<srm_t>()) {
+        DXERROR("Inconsistent param: %s.", name.c_str());
+        return false;
+      }
+      const auto& mapped_W = it->second.to_ref<srm_t>();
+      if (W.col() != mapped_W.col() || W.size() != mapped_W.mapped().size) {
+        DXERROR("Inconsistent param: %s.", name.c_str());
+        return false;
+      }
+      for (const auto& row : W) {
+        const auto* mapped_row = mapped_W.get_row_no_init(row.first);
+        if (mapped_row == nullptr ||
+            !std::equal(row.second, row.second + W.col(), mapped_row)) {
+          DXERROR("Inconsistent row %llu of param: %s.",
+                  (unsigned long long)row.first, name.c_str());  // NOLINT
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(!FLAGS_in_model.empty());
+  if (FLAGS_out_model.empty()) {
+    FLAGS_out_model = FLAGS_in_model + ".mapped";
+    DXINFO("Didn't specify --out_model, output to: %s.",
+           FLAGS_out_model.c_str());
+  }
+
+  Model model;
+  DXCHECK_THROW(model.Load(FLAGS_in_model));
+  DXCHECK_THROW(MappedModel::Save(FLAGS_out_model, model.param()));
+
+  if (FLAGS_verify) {
+    MappedModel mapped_model;
+    TensorMap mapped_param;
+    auto begin = steady_clock_t::now();
+    DXCHECK_THROW(mapped_model.Open(FLAGS_out_model, &mapped_param));
+    double ms = std::chrono::duration<double, std::milli>(
+                    steady_clock_t::now() - begin)
+                    .count();
+    DXINFO("Opened %zu bytes in %.3fms.", mapped_model.size(), ms);
+    DXCHECK_THROW(Verify(model.param(), mapped_param));
+    DXINFO("Verified.");
+  }
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
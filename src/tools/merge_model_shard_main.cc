@@ -3,22 +3,43 @@
 //
 
 #include <deepx_core/common/stream.h>
+#include <deepx_core/common/thread_pool.h>
 #include <deepx_core/dx_log.h>
 #include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/model.h>
 #include <deepx_core/graph/model_shard.h>
 #include <deepx_core/graph/shard.h>
 #include <gflags/gflags.h>
+#include <unistd.h>  // getpid, unlink
+#include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 DEFINE_string(in_model, "", "input model dir");
-DEFINE_string(out_model, "", "output model file(optional)");
+DEFINE_string(out_model, "",
+              "output model file, or output model dir if --out_shard_size > "
+              "0(optional)");
+DEFINE_int32(stream, 0,
+             "streaming merge, read model shards once in parallel and spool "
+             "rows of output shards to --tmp_dir");
+DEFINE_int32(thread, 4, "# of threads reading model shards in streaming mode");
+DEFINE_int32(out_shard_size, 0,
+             "output shard size in streaming mode, 0 for a single model file");
+DEFINE_string(out_shard_func, "default", "output shard func in streaming mode");
+DEFINE_string(tmp_dir, "/tmp",
+              "local dir of temporary row files in streaming mode");
 
 namespace deepx_core {
 namespace {
 
 Shard FLAGS_shard;
+Shard FLAGS_out_shard;
 
 void CheckFlags() {
   AutoFileSystem fs;
@@ -37,6 +58,365 @@ void CheckFlags() {
   DXCHECK_THROW(fs.Open(FLAGS_out_model));
   DXCHECK_THROW(!IsStdinStdoutPath(FLAGS_out_model));
   DXCHECK_THROW(LoadShard(FLAGS_in_model, &FLAGS_shard));
+
+  if (FLAGS_stream) {
+    DXCHECK_THROW(FLAGS_thread > 0);
+    DXCHECK_THROW(FLAGS_out_shard_size >= 0);
+    if (FLAGS_out_shard_size == 0) {
+      FLAGS_out_shard.InitNonShard();
+    } else {
+      FLAGS_out_shard.InitShard(FLAGS_out_shard_size, FLAGS_out_shard_func);
+    }
+  } else {
+    DXCHECK_THROW(FLAGS_out_shard_size == 0);
+  }
+}
+
+/************************************************************************/
+/* StreamingMerger */
+/************************************************************************/
+// StreamingMerger merges input shards in a single pass.
+//
+// Input shards are read in parallel.
+// SRM rows are routed to output shards as soon as they are read,
+// and appended to local row files of (output shard, SRM).
+// TSRs are kept in memory.
+// At last, each output shard is written from its TSRs and row files.
+class StreamingMerger : public DataType {
+ private:
+  // rows of an SRM of an output shard
+  struct RowFile {
+    std::string file;
+    AutoOutputFileStream os;
+    std::mutex mutex;
+    uint64_t size = 0;   // # of rows
+    uint64_t bytes = 0;  // # of bytes
+
+    ~RowFile() {
+      os.Close();
+      unlink(file.c_str());
+    }
+  };
+
+  // rows of an SRM of an output shard read by an input shard,
+  // they are appended to the row file in batches
+  struct RowBuf {
+    OutputStringStream os;
+    uint64_t size = 0;
+  };
+
+  struct SRMEntry {
+    std::string name;
+    // col and initializer, no rows
+    srm_t W;
+    // row files of output shards
+    std::vector<std::unique_ptr<RowFile>> row_files;
+  };
+
+  const Graph* graph_ = nullptr;
+  ThreadPool thread_pool_;
+  std::mutex tsr_mutex_;
+  // TSRs of output shards
+  std::vector<TensorMap> tsr_;
+  std::vector<SRMEntry> srm_;
+  std::unordered_map<std::string, int> srm_index_;
+
+ private:
+  static std::string GetModelFile(const std::string& dir, int shard_id) {
+    // the same as 'ModelShard::GetModelFile' in shard mode
+    return dir + "/model.bin." + std::to_string(shard_id);
+  }
+
+  static bool Flush(RowFile* row_file, RowBuf* row_buf) {
+    if (row_buf->size == 0) {
+      return true;
+    }
+    std::lock_guard<std::mutex> guard(row_file->mutex);
+    row_file->os.Write(row_buf->os.GetData(), row_buf->os.GetSize());
+    if (!row_file->os) {
+      DXERROR("Failed to write: %s.", row_file->file.c_str());
+      return false;
+    }
+    row_file->size += row_buf->size;
+    row_file->bytes += row_buf->os.GetSize();
+    row_buf->os.clear();
+    row_buf->size = 0;
+    return true;
+  }
+
+  static bool CopyRows(RowFile* row_file, OutputStream& os) {  // NOLINT
+    row_file->os.Close();
+    AutoInputFileStream is;
+    if (!is.Open(row_file->file)) {
+      DXERROR("Failed to open: %s.", row_file->file.c_str());
+      return false;
+    }
+
+    std::vector<char> buf(1 << 20);  // magic number
+    uint64_t remain = row_file->bytes;
+    while (remain > 0) {
+      size_t n = (size_t)std::min<uint64_t>(remain, buf.size());
+      if (is.Read(buf.data(), n) != n) {
+        DXERROR("Failed to read: %s.", row_file->file.c_str());
+        return false;
+      }
+      os.Write(buf.data(), n);
+      if (!os) {
+        return false;
+      }
+      remain -= n;
+    }
+    return true;
+  }
+
+  void AddTSR(const std::string& name, tsr_t* W) {
+    TensorMap& param = tsr_[FLAGS_out_shard.GetTSRShardId(name)];
+    std::lock_guard<std::mutex> guard(tsr_mutex_);
+    auto it = param.find(name);
+    if (it != param.end() && it->second.to_ref<tsr_t>().same_shape(*W)) {
+      it->second.to_ref<tsr_t>() = std::move(*W);
+    }
+  }
+
+  // Route rows of 'is' to row files of output shards.
+  bool AddSRM(const std::string& name, InputStream& is) {  // NOLINT
+    auto it = srm_index_.find(name);
+    SRMEntry* entry = it == srm_index_.end() ? nullptr : &srm_[it->second];
+    std::vector<RowBuf> row_bufs(FLAGS_out_shard.shard_size());
+    bool ok = true;
+    srm_t W;
+    ReadEach(is, W, [entry, &W, &row_bufs, &ok](
+                        std::pair<int_t, Vector<float_t>>& kv) {
+      if (entry == nullptr || W.col() != entry->W.col()) {
+        return;
+      }
+      int shard_id = FLAGS_out_shard.GetSRMShardId(kv.first);
+      RowBuf& row_buf = row_bufs[shard_id];
+      row_buf.os << kv.first << kv.second;
+      ++row_buf.size;
+      if (row_buf.os.GetSize() >= (1 << 20)) {  // magic number
+        ok = ok && Flush(entry->row_files[shard_id].get(), &row_buf);
+      }
+    });
+    if (entry) {
+      for (size_t i = 0; i < row_bufs.size(); ++i) {
+        ok = ok && Flush(entry->row_files[i].get(), &row_bufs[i]);
+      }
+    }
+    return ok;
+  }
+
+  bool Read(int shard_id) {
+    std::string file = GetModelFile(FLAGS_in_model, shard_id);
+    AutoInputFileStream is;
+    if (!is.Open(file)) {
+      DXERROR("Failed to open: %s.", file.c_str());
+      return false;
+    }
+
+    DXINFO("Reading model from %s...", file.c_str());
+    int version;
+    is >> version;
+    if (!is) {
+      DXERROR("Failed to read model.");
+      return false;
+    }
+
+    if (version > 0) {
+      DXERROR("Couldn't handle a higher version: %d.", version);
+      return false;
+    }
+
+    int s;
+    is >> s;
+    for (int i = 0; i < s && is; ++i) {
+      std::string name;
+      int type;
+      is >> name >> type;
+      if (!is) {
+        break;
+      }
+
+      switch (type) {
+        case TENSOR_TYPE_TSR: {
+          tsr_t W;
+          is >> W;
+          if (is) {
+            AddTSR(name, &W);
+          }
+        } break;
+        case TENSOR_TYPE_SRM:
+          if (!AddSRM(name, is)) {
+            return false;
+          }
+          break;
+        case TENSOR_TYPE_SRP:    // backward compatibility
+        case TENSOR_TYPE_SVP: {  // backward compatibility
+          srm_t W;
+          if (type == TENSOR_TYPE_SRP) {
+            ReadSRP(is, W);
+          } else {
+            ReadSVP(is, W);
+          }
+          if (is) {
+            OutputStringStream os;
+            InputStringStream W_is;
+            os << W;
+            W.clear();
+            W_is.SetView(os.GetBuf());
+            if (!AddSRM(name, W_is)) {
+              return false;
+            }
+          }
+        } break;
+        default:
+          DXERROR("Invalid tensor type: %d.", type);
+          return false;
+      }
+    }
+
+    if (!is) {
+      DXERROR("Failed to read model.");
+      return false;
+    }
+    DXINFO("Done.");
+    return true;
+  }
+
+  bool Write(int shard_id) {
+    std::string file = FLAGS_out_shard.shard_mode()
+                           ? GetModelFile(FLAGS_out_model, shard_id)
+                           : FLAGS_out_model;
+    AutoOutputFileStream os;
+    if (!os.Open(file)) {
+      DXERROR("Failed to open: %s.", file.c_str());
+      return false;
+    }
+
+    DXINFO("Saving model to %s...", file.c_str());
+    // the same format as 'Model::Write'
+    int version = 0;
+    int s = (int)(tsr_[shard_id].size() + srm_.size());
+    os << version << s;
+    for (const auto& entry : tsr_[shard_id]) {
+      int type = TENSOR_TYPE_TSR;
+      os << entry.first << type << entry.second.to_ref<tsr_t>();
+    }
+    tsr_[shard_id].clear();
+
+    for (SRMEntry& entry : srm_) {
+      std::unique_ptr<RowFile> row_file(
+          std::move(entry.row_files[shard_id]));
+      int type = TENSOR_TYPE_SRM;
+      os << entry.name << type;
+      bool ok = true;
+      WriteEach(os, entry.W, row_file->size,
+                [&row_file, &ok](OutputStream& os) {  // NOLINT
+                  ok = CopyRows(row_file.get(), os);
+                });
+      if (!ok) {
+        return false;
+      }
+    }
+
+    if (!os) {
+      DXERROR("Failed to write model.");
+      return false;
+    }
+    DXINFO("Done.");
+    return true;
+  }
+
+  bool RunAll(int n, const std::function<bool(int)>& func) {
+    std::vector<int> status(n, 0);
+    std::vector<ThreadPool::function_t> funcs(n);
+    for (int i = 0; i < n; ++i) {
+      funcs[i] = [i, &func, &status]() { status[i] = func(i) ? 1 : 0; };
+    }
+    ThreadPool::wait_token_t token;
+    thread_pool_.run(funcs, &token);
+    return std::all_of(status.begin(), status.end(),
+                       [](int ok) { return ok == 1; });
+  }
+
+ public:
+  explicit StreamingMerger(const Graph* graph) : graph_(graph) {}
+
+  bool Init() {
+    Model model;
+    model.Init(graph_);
+    if (!model.InitParamPlaceholder()) {
+      return false;
+    }
+
+    int out_shard_size = FLAGS_out_shard.shard_size();
+    tsr_.resize(out_shard_size);
+    for (auto& entry : *model.mutable_param()) {
+      const std::string& name = entry.first;
+      Any& Wany = entry.second;
+      if (Wany.is<tsr_t>()) {
+        // TSRs never read remain as placeholders.
+        tsr_[FLAGS_out_shard.GetTSRShardId(name)].insert<tsr_t>(name) =
+            std::move(Wany.unsafe_to_ref<tsr_t>());
+      } else if (Wany.is<srm_t>()) {
+        srm_index_[name] = (int)srm_.size();
+        srm_.emplace_back();
+        SRMEntry& srm_entry = srm_.back();
+        srm_entry.name = name;
+        srm_entry.W = std::move(Wany.unsafe_to_ref<srm_t>());
+        for (int i = 0; i < out_shard_size; ++i) {
+          std::unique_ptr<RowFile> row_file(new RowFile);
+          row_file->file = FLAGS_tmp_dir + "/merge_model_shard." +
+                           std::to_string(getpid()) + "." +
+                           std::to_string(srm_index_[name]) + "." +
+                           std::to_string(i);
+          if (!row_file->os.Open(row_file->file)) {
+            DXERROR("Failed to open: %s.", row_file->file.c_str());
+            return false;
+          }
+          srm_entry.row_files.emplace_back(std::move(row_file));
+        }
+      }
+    }
+    return true;
+  }
+
+  void Start() { thread_pool_.start(FLAGS_thread); }
+  void Stop() { thread_pool_.stop(); }
+
+  // Read all input shards in parallel, each of them is read once.
+  bool Read() {
+    return RunAll(FLAGS_shard.shard_size(),
+                  [this](int shard_id) { return Read(shard_id); });
+  }
+
+  // Write all output shards in parallel.
+  bool Write() {
+    return RunAll(FLAGS_out_shard.shard_size(),
+                  [this](int shard_id) { return Write(shard_id); });
+  }
+};
+
+void StreamingMerge(const Graph& graph) {
+  std::string new_path;
+  if (AutoFileSystem::BackupIfExists(FLAGS_out_model, &new_path)) {
+    DXINFO("Backed up %s to %s.", FLAGS_out_model.c_str(), new_path.c_str());
+  }
+
+  if (FLAGS_out_shard.shard_mode()) {
+    AutoFileSystem fs;
+    DXCHECK_THROW(fs.Open(FLAGS_out_model));
+    DXCHECK_THROW(fs.MakeDir(FLAGS_out_model));
+    DXCHECK_THROW(SaveGraph(FLAGS_out_model, graph));
+    DXCHECK_THROW(SaveShard(FLAGS_out_model, FLAGS_out_shard));
+  }
+
+  StreamingMerger merger(&graph);
+  DXCHECK_THROW(merger.Init());
+  merger.Start();
+  DXCHECK_THROW(merger.Read());
+  DXCHECK_THROW(merger.Write());
+  merger.Stop();
 }
 
 int main(int argc, char** argv) {
@@ -61,6 +441,12 @@ int main(int argc, char** argv) {
   Graph graph;
   DXCHECK_THROW(LoadGraph(FLAGS_in_model, &graph));
 
+  if (FLAGS_stream) {
+    StreamingMerge(graph);
+    google::ShutDownCommandLineFlags();
+    return 0;
+  }
+
   std::vector<std::unique_ptr<ModelShard>> model_shards(shard_size);
   for (int i = 0; i < shard_size; ++i) {
     model_shards[i].reset(new ModelShard);
@@ -0,0 +1,72 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Convert a model file to a predict-only quantized model file for serving,
+// see 'ModelQuantizer'.
+//
+
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/model.h>
+#include <deepx_core/graph/model_quantizer.h>
+#include <gflags/gflags.h>
+#include <string>
+
+DEFINE_string(in_graph, "", "input graph file");
+DEFINE_string(in_model, "", "input model file");
+DEFINE_string(out_model, "", "output quantized model file");
+DEFINE_string(dtype, "int8", "int8 or fp16");
+
+namespace deepx_core {
+namespace {
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(!FLAGS_in_graph.empty());
+  DXCHECK_THROW(!FLAGS_in_model.empty());
+  if (FLAGS_out_model.empty()) {
+    FLAGS_out_model = FLAGS_in_model + "." + FLAGS_dtype;
+    DXINFO("Didn't specify --out_model, output to: %s.",
+           FLAGS_out_model.c_str());
+  }
+  int dtype;
+  if (FLAGS_dtype == "int8") {
+    dtype = TENSOR_DTYPE_INT8;
+  } else if (FLAGS_dtype == "fp16") {
+    dtype = TENSOR_DTYPE_FLOAT16;
+  } else {
+    DXTHROW_INVALID_ARGUMENT("Invalid dtype: %s.", FLAGS_dtype.c_str());
+  }
+
+  Graph graph;
+  DXCHECK_THROW(graph.Load(FLAGS_in_graph));
+  Model model;
+  model.Init(&graph);
+  DXCHECK_THROW(model.Load(FLAGS_in_model));
+
+  ModelQuantizer quantizer;
+  quantizer.Init(&graph, dtype);
+  Model quantized_model;
+  quantized_model.Init(&graph);
+  DXCHECK_THROW(
+      quantizer.Quantize(model.param(), quantized_model.mutable_param()));
+  DXINFO("Quantized %zu bytes of values to %zu bytes.",
+         ModelQuantizer::GetValueBytes(model.param()),
+         ModelQuantizer::GetValueBytes(quantized_model.param()));
+  DXCHECK_THROW(quantized_model.Save(FLAGS_out_model));
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
@@ -0,0 +1,195 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Loopback throughput benchmark of pull responses of 'ModelShard::Pull'.
+//
+// In 'copy' mode, params are copied to a TensorMap by 'ModelShard::Pull'
+// with 'copy' being 1, and written by 'pull_response().buf_writer'.
+// In 'write' mode, params are written to 'pull_response().buf' by
+// 'ModelShard::Pull' under the param locks, they are copied only once.
+//
+
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/dist_proto.h>
+#include <deepx_core/graph/graph.h>
+#include <deepx_core/graph/graph_node.h>
+#include <deepx_core/graph/model_shard.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/ps/tcp_server.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gflags/gflags.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+DEFINE_string(mode, "write", "copy or write");
+DEFINE_string(endpoint, "127.0.0.1:61000", "loopback endpoint");
+DEFINE_int32(client, 4, "# of client threads");
+DEFINE_int32(server_thread, 4, "# of server threads");
+DEFINE_int32(request, 200, "# of pull requests of each client");
+DEFINE_int32(row, 20000, "# of rows of the pulled srm");
+DEFINE_int32(col, 64, "# of cols of the pulled srm");
+DEFINE_int32(dense, 1000000, "# of elements of the pulled tsr");
+
+namespace deepx_core {
+namespace {
+
+using int_t = DataType::int_t;
+using srm_t = DataType::srm_t;
+using steady_clock_t = std::chrono::steady_clock;
+
+/************************************************************************/
+/* BenchServer */
+/************************************************************************/
+class BenchServer : public TcpServer {
+ private:
+  const int write_;
+  ModelShard* model_shard_;
+  const PullRequest* pull_request_;
+
+ public:
+  BenchServer(int write, ModelShard* model_shard,
+              const PullRequest* pull_request)
+      : write_(write), model_shard_(model_shard), pull_request_(pull_request) {}
+  void Run() override { RunLoop(); }
+  void Stop() { StopLoop(); }
+
+ protected:
+  void OnAccept(conn_t conn) override {
+    conn->mutable_user_data()->emplace(TensorMap());
+    TcpServer::OnAccept(conn);
+  }
+
+  int OnReadMessage(conn_t conn) override {
+    if (conn->in_message().type() != DIST_MESSAGE_TYPE_PULL_REQUEST) {
+      DeleteConnection(conn);
+      return -1;
+    }
+
+    auto* param = &conn->mutable_user_data()->unsafe_to_ref<TensorMap>();
+    // Like a param server, each request is read to its own 'PullRequest'.
+    PullRequest pull_request = *pull_request_;
+    DistMessage* out = conn->mutable_out_message();
+    out->set_type(DIST_MESSAGE_TYPE_PULL_RESPONSE);
+    auto* pull_response = out->mutable_pull_response();
+    if (write_) {
+      OutputStringStream os;
+      pull_response->buf.clear();
+      os.SetView(&pull_response->buf);
+      model_shard_->Pull(&pull_request, param, os);
+      DXCHECK_THROW(os);
+    } else {
+      model_shard_->Pull(&pull_request, param, 1);
+      pull_response->buf_writer = [param](OutputStream& os) { os << *param; };
+    }
+    AsyncWriteMessage(conn);
+    return 1;
+  }
+};
+
+void InitModelShard(Graph* graph, ModelShard* model_shard,
+                    PullRequest* pull_request) {
+  auto* Wnode = new VariableNode("dense", Shape(1, FLAGS_dense),
+                                 TENSOR_TYPE_TSR, TENSOR_INITIALIZER_TYPE_RAND,
+                                 0, 1);
+  auto* Snode =
+      new VariableNode("sparse", Shape(0, FLAGS_col), TENSOR_TYPE_SRM,
+                       TENSOR_INITIALIZER_TYPE_RAND, 0, 1);
+  DXCHECK_THROW(graph->Compile({Wnode, Snode}, 1));
+  model_shard->InitShard(nullptr, 0);
+  model_shard->InitGraph(graph);
+  DXCHECK_THROW(model_shard->InitModel());
+  DXCHECK_THROW(model_shard->InitLock());
+
+  pull_request->tsr_set.emplace("dense");
+  auto& id_set = pull_request->srm_map["sparse"];
+  for (int i = 0; i < FLAGS_row; ++i) {
+    id_set.emplace((int_t)i * 7);  // magic number
+  }
+  // Rows are initialized by the first train pull.
+  pull_request->is_train = 1;
+  TensorMap param;
+  PullRequest init_request = *pull_request;
+  model_shard->Pull(&init_request, &param, 1);
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(FLAGS_mode == "copy" || FLAGS_mode == "write");
+  DXCHECK_THROW(FLAGS_client > 0);
+  DXCHECK_THROW(FLAGS_server_thread > 0);
+  DXCHECK_THROW(FLAGS_request > 0);
+  DXCHECK_THROW(FLAGS_row >= 0);
+  DXCHECK_THROW(FLAGS_col > 0);
+  DXCHECK_THROW(FLAGS_dense > 0);
+
+  Graph graph;
+  ModelShard model_shard;
+  PullRequest pull_request;
+  InitModelShard(&graph, &model_shard, &pull_request);
+
+  TcpServerConfig config;
+  config.listen_endpoint = MakeTcpEndpoint(FLAGS_endpoint);
+  config.thread = FLAGS_server_thread;
+  BenchServer server(FLAGS_mode == "write", &model_shard, &pull_request);
+  server.set_config(config);
+  std::thread server_thread([&server]() { server.Run(); });
+
+  std::vector<size_t> response_bytes((size_t)FLAGS_client);
+  std::vector<std::thread> clients;
+  auto begin = steady_clock_t::now();
+  for (int i = 0; i < FLAGS_client; ++i) {
+    clients.emplace_back([i, &config, &response_bytes]() {
+      IoContext io;
+      TcpConnection conn(&io);
+      DXCHECK_THROW(conn.ConnectRetry(config.listen_endpoint, 10, 1) == 0);
+      for (int j = 0; j < FLAGS_request; ++j) {
+        DXCHECK_THROW(conn.RpcPullRequest() == 0);
+        const const_string_view& buf = conn.in_message().pull_response().buf;
+        response_bytes[(size_t)i] += buf.size();
+        if (j == 0 && FLAGS_row > 0) {
+          TensorMap pulled;
+          InputStringStream is;
+          is.SetView(buf.data(), buf.size());
+          ReadView(is, pulled);
+          DXCHECK_THROW(is);
+          DXCHECK_THROW(pulled.get<srm_t>("sparse").size() ==
+                        (size_t)FLAGS_row);
+        }
+      }
+      conn.Close();
+    });
+  }
+  for (std::thread& client : clients) {
+    client.join();
+  }
+  double second =
+      std::chrono::duration<double>(steady_clock_t::now() - begin).count();
+  server.Stop();
+  server_thread.join();
+
+  double total_mb = 0;
+  for (size_t bytes : response_bytes) {
+    total_mb += (double)bytes / (1024.0 * 1024.0);
+  }
+  int total_request = FLAGS_client * FLAGS_request;
+  DXINFO("%s: %d requests, %.1fMB/response, %.1fMB/s, %.1fus/request.",
+         FLAGS_mode.c_str(), total_request, total_mb / total_request,
+         total_mb / second, second * 1e6 / total_request);
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
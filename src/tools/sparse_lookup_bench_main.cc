@@ -0,0 +1,162 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Benchmark of sparse embedding lookups from a huge SparseRowMatrix.
+//
+// In 'probe' mode, a row is probed for each nonzero,
+// which was how 'LLSparseTensor::gesmsm' worked.
+// In 'batch' mode, 'LLSparseTensor::gesmsm' is called, rows are looked up
+// in software pipelined blocks with prefetching.
+//
+// Cover 10^8 rows with '--row=100000000'.
+//
+
+#include <deepx_core/dx_log.h>
+#include <deepx_core/tensor/csr_matrix.h>
+#include <deepx_core/tensor/data_type.h>
+#include <deepx_core/tensor/ll_math.h>
+#include <deepx_core/tensor/ll_tensor.h>
+#include <gflags/gflags.h>
+#include <chrono>
+#include <cmath>  // std::pow
+#include <random>
+#include <string>
+
+DEFINE_string(mode, "batch", "probe or batch");
+DEFINE_uint64(row, 10000000, "# of rows of the srm");
+DEFINE_int32(col, 8, "# of cols of the srm");
+DEFINE_int32(batch, 1024, "# of rows of each batch");
+DEFINE_int32(nnz, 32, "# of nonzeros of each row of a batch");
+DEFINE_double(zipf, 0, "skewness of ids, 0 means uniform");
+DEFINE_int32(repeat, 100, "# of batches");
+
+namespace deepx_core {
+namespace {
+
+using float_t = DataType::float_t;
+using int_t = DataType::int_t;
+using tsr_t = DataType::tsr_t;
+using srm_t = DataType::srm_t;
+using csr_t = DataType::csr_t;
+using ll_sparse_tensor_t = DataType::ll_sparse_tensor_t;
+using steady_clock_t = std::chrono::steady_clock;
+
+// Ids are scattered, so that adjacent ids are not in adjacent buckets.
+int_t GetId(uint64_t i) noexcept {
+  return (int_t)(i * 0x9e3779b97f4a7c15ULL);  // magic number
+}
+
+void InitSRM(srm_t* W) {
+  W->set_col(FLAGS_col);
+  W->reserve(FLAGS_row);
+  for (uint64_t i = 0; i < FLAGS_row; ++i) {
+    float_t* row = W->get_row_no_init(GetId(i));
+    row[0] = 1;
+  }
+}
+
+// Sample ranks with P(i) ~ 1 / (i + 1)^zipf approximately.
+class IdSampler {
+ private:
+  std::default_random_engine engine_;
+  std::uniform_real_distribution<double> dist_;
+
+ public:
+  uint64_t Sample() {
+    double u = dist_(engine_);
+    if (FLAGS_zipf <= 0) {
+      return (uint64_t)(u * FLAGS_row) % FLAGS_row;
+    }
+    // inverse CDF of a continuous power law on [1, row + 1)
+    double n = (double)FLAGS_row + 1;
+    double s = 1 - FLAGS_zipf;
+    double x;
+    if (s == 0) {
+      x = std::pow(n, u);
+    } else {
+      x = std::pow(1 + u * (std::pow(n, s) - 1), 1 / s);
+    }
+    return ((uint64_t)x - 1) % FLAGS_row;
+  }
+};
+
+void InitBatch(IdSampler* sampler, csr_t* X) {
+  X->clear();
+  for (int i = 0; i < FLAGS_batch; ++i) {
+    for (int j = 0; j < FLAGS_nnz; ++j) {
+      X->emplace(GetId(sampler->Sample()), 1);
+    }
+    X->add_row();
+  }
+}
+
+void Probe(const csr_t& X, const srm_t& W, tsr_t* Z) {
+  int n = W.col();
+  Z->zeros();
+  float_t* Zi = Z->data();
+  CSR_FOR_EACH_ROW(X, i) {
+    CSR_FOR_EACH_COL(X, i) {
+      const float_t* Wj = W.get_row_no_init(CSR_COL(X));
+      if (Wj) {
+        LLMath<float_t>::axpy(n, CSR_VALUE(X), Wj, Zi);
+      }
+    }
+    Zi += n;
+  }
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(FLAGS_mode == "probe" || FLAGS_mode == "batch");
+  DXCHECK_THROW(FLAGS_row > 0);
+  DXCHECK_THROW(FLAGS_col > 0);
+  DXCHECK_THROW(FLAGS_batch > 0);
+  DXCHECK_THROW(FLAGS_nnz > 0);
+  DXCHECK_THROW(FLAGS_zipf >= 0);
+  DXCHECK_THROW(FLAGS_repeat > 0);
+
+  srm_t W;
+  DXINFO("Initializing %zu rows...", (size_t)FLAGS_row);
+  InitSRM(&W);
+  DXINFO("Done.");
+
+  IdSampler sampler;
+  csr_t X;
+  tsr_t Z;
+  Z.resize(FLAGS_batch, FLAGS_col);
+  int probe = FLAGS_mode == "probe";
+  double second = 0;
+  double checksum = 0;
+  for (int i = 0; i < FLAGS_repeat; ++i) {
+    InitBatch(&sampler, &X);
+    auto begin = steady_clock_t::now();
+    if (probe) {
+      Probe(X, W, &Z);
+    } else {
+      ll_sparse_tensor_t::gesmsm(X, W, 0, &Z);
+    }
+    second +=
+        std::chrono::duration<double>(steady_clock_t::now() - begin).count();
+    checksum += Z.sum();
+  }
+
+  double nnz = (double)FLAGS_repeat * FLAGS_batch * FLAGS_nnz;
+  DXINFO("%s: %.1fns/nonzero, %.1fms/batch, checksum=%.0f.",
+         FLAGS_mode.c_str(), second * 1e9 / nnz,
+         second * 1e3 / FLAGS_repeat, checksum);
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
@@ -0,0 +1,234 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Throughput and latency benchmark of ThreadPool.
+//
+// Heap allocations per task are counted by replacing the global operator new.
+//
+
+#include <deepx_core/common/thread_pool.h>
+#include <deepx_core/dx_log.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <forward_list>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+DEFINE_int32(thread, 4, "# of worker threads");
+DEFINE_int32(producer, 4, "# of threads posting tasks");
+DEFINE_int32(task, 200000, "# of tasks posted by each producer");
+DEFINE_int32(fanout, 8, "# of child tasks posted by each task in fork mode");
+
+namespace {
+
+std::atomic<size_t> g_alloc{0};
+
+}  // namespace
+
+void* operator new(size_t size) {
+  ++g_alloc;
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+namespace deepx_core {
+namespace {
+
+/************************************************************************/
+/* LegacyThreadPool */
+/************************************************************************/
+// The former ThreadPool, a single task list protected by one mutex.
+class LegacyThreadPool {
+ public:
+  using function_t = std::function<void()>;
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  int started_ = 0;
+  std::forward_list<function_t> tasks_;
+  std::vector<std::thread> threads_;
+
+ private:
+  void worker_thread() {
+    function_t func;
+    for (;;) {
+      std::unique_lock<std::mutex> guard(mutex_);
+      while (started_ && tasks_.empty()) {
+        cond_.wait(guard);
+      }
+
+      if (!started_) {
+        break;
+      }
+
+      func = std::move(tasks_.front());
+      tasks_.pop_front();
+      guard.unlock();
+      func();
+    }
+
+    std::unique_lock<std::mutex> guard(mutex_);
+    while (!tasks_.empty()) {
+      func = std::move(tasks_.front());
+      tasks_.pop_front();
+      guard.unlock();
+      func();
+      guard.lock();
+    }
+  }
+
+ public:
+  ~LegacyThreadPool() { stop(); }
+
+  void start(int n) {
+    std::unique_lock<std::mutex> guard(mutex_);
+    if (!started_) {
+      started_ = 1;
+      for (int i = 0; i < n; ++i) {
+        threads_.emplace_back([this]() { worker_thread(); });
+      }
+    }
+  }
+
+  void stop() {
+    {
+      std::unique_lock<std::mutex> guard(mutex_);
+      started_ = 0;
+      cond_.notify_all();
+    }
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+    threads_.clear();
+  }
+
+  void post(function_t func) {
+    {
+      std::unique_lock<std::mutex> guard(mutex_);
+      tasks_.emplace_front(std::move(func));
+    }
+    cond_.notify_one();
+  }
+};
+
+/************************************************************************/
+/* Benchmark */
+/************************************************************************/
+using steady_clock_t = std::chrono::steady_clock;
+
+double ToMicrosecond(steady_clock_t::duration duration) {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// Post tiny tasks from producers, measure throughput and the latency from
+// posting to running.
+template <class Pool>
+void BenchPost(const char* name) {
+  int total = FLAGS_producer * FLAGS_task;
+  std::vector<double> latency((size_t)total);
+  std::atomic<int> done(0);
+
+  Pool pool;
+  pool.start(FLAGS_thread);
+  size_t alloc = g_alloc;
+  auto begin = steady_clock_t::now();
+  std::vector<std::thread> producers;
+  for (int i = 0; i < FLAGS_producer; ++i) {
+    producers.emplace_back([&pool, &latency, &done, i]() {
+      for (int j = 0; j < FLAGS_task; ++j) {
+        double* l = &latency[(size_t)i * FLAGS_task + j];
+        auto post_time = steady_clock_t::now();
+        pool.post([l, post_time, &done]() {
+          *l = ToMicrosecond(steady_clock_t::now() - post_time);
+          ++done;
+        });
+      }
+    });
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  pool.stop();
+  double second =
+      std::chrono::duration<double>(steady_clock_t::now() - begin).count();
+  DXCHECK_THROW(done == total);
+  // including a few allocations of starting producer threads
+  double alloc_per_task = (double)(g_alloc - alloc) / total;
+
+  std::sort(latency.begin(), latency.end());
+  DXINFO(
+      "%-8s post: %.0f tasks/s, p50=%.1fus p99=%.1fus p999=%.1fus, "
+      "%.3f allocs/task",
+      name, total / second, latency[total / 2],
+      latency[(size_t)total * 99 / 100], latency[(size_t)total * 999 / 1000],
+      alloc_per_task);
+}
+
+// Each task posts 'FLAGS_fanout' child tasks from a worker thread.
+template <class Pool>
+void BenchFork(const char* name) {
+  int total = FLAGS_producer * FLAGS_task;
+  int parents = total / (FLAGS_fanout + 1);
+  std::atomic<int> done(0);
+
+  Pool pool;
+  pool.start(FLAGS_thread);
+  size_t alloc = g_alloc;
+  auto begin = steady_clock_t::now();
+  for (int i = 0; i < parents; ++i) {
+    pool.post([&pool, &done]() {
+      for (int j = 0; j < FLAGS_fanout; ++j) {
+        pool.post([&done]() { ++done; });
+      }
+      ++done;
+    });
+  }
+  pool.stop();
+  double second =
+      std::chrono::duration<double>(steady_clock_t::now() - begin).count();
+  DXCHECK_THROW(done == parents * (FLAGS_fanout + 1));
+  DXINFO("%-8s fork: %.0f tasks/s, %.3f allocs/task", name, done / second,
+         (double)(g_alloc - alloc) / done);
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(FLAGS_thread > 0);
+  DXCHECK_THROW(FLAGS_producer > 0);
+  DXCHECK_THROW(FLAGS_task > 0);
+  DXCHECK_THROW(FLAGS_fanout >= 0);
+
+  BenchPost<LegacyThreadPool>("legacy");
+  BenchPost<ThreadPool>("stealing");
+  BenchFork<LegacyThreadPool>("legacy");
+  BenchFork<ThreadPool>("stealing");
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
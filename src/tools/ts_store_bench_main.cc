@@ -0,0 +1,225 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Memory and expiry time benchmark of TSStore.
+//
+// Cover 10^8 ids with '--id=100000000'.
+//
+
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <deepx_core/graph/ts_store.h>
+#include <deepx_core/tensor/data_type.h>
+#include <gflags/gflags.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+DEFINE_string(mode, "indexed", "legacy or indexed");
+DEFINE_uint64(id, 10000000, "# of live ids");
+DEFINE_int32(expire_threshold, 7, "expire threshold in days");
+DEFINE_int32(day, 7, "# of days to run after ids are filled");
+DEFINE_double(touch, 0.2,
+              "ratio of live ids updated each day besides new ids");
+DEFINE_int32(batch, 65536, "# of ids of each update");
+
+namespace deepx_core {
+namespace {
+
+using float_t = DataType::float_t;
+using int_t = DataType::int_t;
+using ts_t = DataType::ts_t;
+using srm_t = DataType::srm_t;
+using id_set_t = DataType::id_set_t;
+using id_ts_map_t = DataType::id_ts_map_t;
+using steady_clock_t = std::chrono::steady_clock;
+
+double ToMillisecond(steady_clock_t::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+double GetRSSMB() {
+  long pages = 0;  // NOLINT
+  long rss = 0;    // NOLINT
+  FILE* fp = fopen("/proc/self/statm", "r");
+  if (fp == nullptr) {
+    return 0;
+  }
+  if (fscanf(fp, "%ld %ld", &pages, &rss) != 2) {  // NOLINT
+    rss = 0;
+  }
+  fclose(fp);
+  return (double)rss * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+}
+
+/************************************************************************/
+/* LegacyTSStore */
+/************************************************************************/
+// The former TSStore, 'Expire' scans all ids.
+class LegacyTSStore : public DataType {
+ private:
+  ts_t now_ = 0;
+  ts_t expire_threshold_ = 0;
+  const TensorMap* param_ = nullptr;
+  id_ts_map_t id_ts_map_;
+
+ public:
+  void set_now(ts_t now) noexcept { now_ = now; }
+  void set_expire_threshold(ts_t expire_threshold) noexcept {
+    expire_threshold_ = expire_threshold;
+  }
+  size_t size() const noexcept { return id_ts_map_.size(); }
+
+ public:
+  void Init(const TensorMap* param) noexcept { param_ = param; }
+
+  void Update(TensorMap* grad) {
+    for (const auto& entry : *grad) {
+      if (param_->find(entry.first) == param_->end()) {
+        continue;
+      }
+      const auto& G = entry.second.to_ref<srm_t>();
+      for (const auto& _entry : G) {
+        id_ts_map_[_entry.first] = now_;
+      }
+    }
+  }
+
+  id_set_t Expire() {
+    id_set_t expired;
+    auto first = id_ts_map_.begin();
+    auto last = id_ts_map_.end();
+    for (; first != last;) {
+      if (now_ > expire_threshold_ + first->second) {
+        expired.emplace(first->first);
+        first = id_ts_map_.erase(first);
+      } else {
+        ++first;
+      }
+    }
+    return expired;
+  }
+};
+
+/************************************************************************/
+/* Bench */
+/************************************************************************/
+template <class Store>
+class Bench {
+ private:
+  TensorMap param_;
+  TensorMap grad_;
+  srm_t* G_ = nullptr;
+  Store store_;
+  double update_ms_ = 0;
+
+ private:
+  void Add(int_t id) {
+    float_t g = 1;
+    G_->assign(id, &g);
+    if (G_->size() >= (size_t)FLAGS_batch) {
+      Flush();
+    }
+  }
+
+  void Flush() {
+    if (G_->size() > 0) {
+      auto begin = steady_clock_t::now();
+      store_.Update(&grad_);
+      update_ms_ += ToMillisecond(steady_clock_t::now() - begin);
+      G_->clear();
+    }
+  }
+
+ public:
+  void Run() {
+    param_.insert<srm_t>("W");
+    G_ = &grad_.insert<srm_t>("W");
+    G_->set_col(1);
+    store_.set_expire_threshold((ts_t)FLAGS_expire_threshold);
+    store_.Init(&param_);
+
+    // Ids are filled evenly in days [0, expire_threshold].
+    ts_t days = (ts_t)FLAGS_expire_threshold + 1;
+    uint64_t n = FLAGS_id;
+    double rss = GetRSSMB();
+    for (ts_t now = 0; now < days; ++now) {
+      store_.set_now(now);
+      for (uint64_t id = now; id < n; id += days) {
+        Add((int_t)id);
+      }
+      Flush();
+    }
+    DXINFO("%s: filled %zu ids, rss=%.1fMB, update=%.1fms.",
+           FLAGS_mode.c_str(), store_.size(), GetRSSMB() - rss, update_ms_);
+
+    // Each day, ids of the oldest day expire unless they are touched,
+    // the same # of new ids come in.
+    std::default_random_engine engine;
+    std::uniform_int_distribution<uint64_t> id_dist(0, n - 1);
+    uint64_t next_id = n;
+    uint64_t touch = (uint64_t)(FLAGS_touch * (double)n);
+    for (int day = 0; day < FLAGS_day; ++day) {
+      ts_t now = days + (ts_t)day;
+      store_.set_now(now);
+      update_ms_ = 0;
+      for (uint64_t i = 0; i < n / days; ++i) {
+        Add((int_t)next_id++);
+      }
+      for (uint64_t i = 0; i < touch; ++i) {
+        // Touch ids which may have expired.
+        Add((int_t)(next_id - n + id_dist(engine) % n));
+      }
+      Flush();
+
+      auto begin = steady_clock_t::now();
+      id_set_t expired = store_.Expire();
+      double expire_ms = ToMillisecond(steady_clock_t::now() - begin);
+      // Models may be saved several times a day,
+      // the later expiries have nothing to expire.
+      begin = steady_clock_t::now();
+      (void)store_.Expire();
+      double expire_again_ms = ToMillisecond(steady_clock_t::now() - begin);
+      DXINFO(
+          "%s: day=%d, update=%.1fms, expire=%.1fms, expire_again=%.1fms, "
+          "expired=%zu, remained=%zu, rss=%.1fMB.",
+          FLAGS_mode.c_str(), (int)now, update_ms_, expire_ms, expire_again_ms,
+          expired.size(), store_.size(), GetRSSMB() - rss);
+    }
+  }
+};
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+  DXCHECK_THROW(FLAGS_id > 0);
+  DXCHECK_THROW(FLAGS_expire_threshold > 0);
+  DXCHECK_THROW(FLAGS_day >= 0);
+  DXCHECK_THROW(FLAGS_touch >= 0);
+  DXCHECK_THROW(FLAGS_batch > 0);
+
+  if (FLAGS_mode == "legacy") {
+    Bench<LegacyTSStore>().Run();
+  } else if (FLAGS_mode == "indexed") {
+    Bench<TSStore>().Run();
+  } else {
+    DXERROR("Invalid mode: %s.", FLAGS_mode.c_str());
+    return 1;
+  }
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }
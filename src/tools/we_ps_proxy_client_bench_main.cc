@@ -0,0 +1,268 @@
+// Copyright 2021 the deepx authors.
+// Author: Yafei Zhang (kimmyzhang@tencent.com)
+//
+// Latency benchmark of WePSProxyClient against a local stand-in proxy server.
+//
+
+#include <deepx_core/contrib/we_ps/client/we_ps_client.h>
+#include <deepx_core/dx_log.h>
+#include <deepx_core/graph/tensor_map.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#if OS_POSIX == 1
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#endif
+
+DEFINE_int32(model_id, 7999, "model id of the stand-in proxy server");
+DEFINE_string(client_uuid, "bench", "client uuid of the stand-in proxy server");
+DEFINE_int32(server_delay_us, 200,
+             "simulated storage latency of each request in microseconds");
+DEFINE_int32(iteration, 200, "# of pushes of each mode");
+DEFINE_int32(tsr_size, 65536, "total # of elements in TSRs");
+DEFINE_int32(srm_row, 4096, "# of rows in SRMs");
+DEFINE_int32(srm_col, 16, "# of columns in SRMs");
+
+namespace deepx_core {
+namespace {
+
+#if OS_POSIX == 1
+/************************************************************************/
+/* StandInProxyServer */
+/************************************************************************/
+// StandInProxyServer speaks the wire protocol of WePSProxyClient.
+//
+// It serves one request per connection, as the real proxy does.
+// TSR responses echo the requests, it is enough for measuring latency.
+class StandInProxyServer {
+ private:
+  int fd_ = -1;
+  std::thread accept_thread_;
+
+ private:
+  static bool ReadN(int fd, char* p, size_t size) {
+    while (size > 0) {
+      ssize_t n = read(fd, p, size);
+      if (n == -1 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return false;
+      }
+      p += n;
+      size -= (size_t)n;
+    }
+    return true;
+  }
+
+  static bool WriteN(int fd, const char* p, size_t size) {
+    while (size > 0) {
+      ssize_t n = write(fd, p, size);
+      if (n == -1 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return false;
+      }
+      p += n;
+      size -= (size_t)n;
+    }
+    return true;
+  }
+
+  static void Serve(int fd) {
+    uint16_t cmd;
+    uint64_t size;
+    std::string buf;
+    if (ReadN(fd, (char*)&cmd, sizeof(cmd)) &&
+        ReadN(fd, (char*)&size, sizeof(size))) {
+      buf.resize((size_t)size);
+      if (ReadN(fd, &buf[0], buf.size())) {
+        std::this_thread::sleep_for(
+            std::chrono::microseconds(FLAGS_server_delay_us));
+        uint8_t error = 0;
+        switch (cmd) {
+          case 0:  // UpdateTSR
+          case 5:  // GetTSR
+            (void)(WriteN(fd, (const char*)&error, sizeof(error)) &&
+                   WriteN(fd, (const char*)&size, sizeof(size)) &&
+                   WriteN(fd, buf.data(), buf.size()));
+            break;
+          case 1:  // SetSRM
+          case 6:  // SetTSR
+          case 8:  // UpdateSRM
+            (void)WriteN(fd, (const char*)&error, sizeof(error));
+            break;
+          default:
+            error = 1;
+            (void)WriteN(fd, (const char*)&error, sizeof(error));
+            break;
+        }
+      }
+    }
+    (void)close(fd);
+  }
+
+ public:
+  ~StandInProxyServer() {
+    if (fd_ != -1) {
+      (void)shutdown(fd_, SHUT_RDWR);
+      (void)close(fd_);
+    }
+    if (accept_thread_.joinable()) {
+      accept_thread_.join();
+    }
+  }
+
+  bool Start(const std::string& path) {
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ == -1) {
+      DXERROR("Failed to socket, errno=%d(%s).", errno, strerror(errno));
+      return false;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    addr.sun_path[0] = '\0';
+    snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "%s", path.c_str());
+    if (bind(fd_, (struct sockaddr*)&addr, sizeof(addr)) == -1 ||
+        listen(fd_, 128) == -1) {
+      DXERROR("Failed to bind or listen, path=%s, errno=%d(%s).", path.c_str(),
+              errno, strerror(errno));
+      return false;
+    }
+
+    accept_thread_ = std::thread([this]() {
+      for (;;) {
+        int fd = accept(fd_, nullptr, nullptr);
+        if (fd == -1) {
+          if (errno == EINTR) {
+            continue;
+          }
+          break;
+        }
+        std::thread(&StandInProxyServer::Serve, fd).detach();
+      }
+    });
+    return true;
+  }
+};
+#endif
+
+/************************************************************************/
+/* Benchmark */
+/************************************************************************/
+// The same as the default 'WePSClient::UpdateParam'.
+bool SequentialUpdateParam(WePSClient* client, const TensorMap& delta_param,
+                           const TensorMap& new_srm_param,
+                           TensorMap* new_tsr_param) {
+  return client->UpdateTSR(delta_param, new_tsr_param) &&
+         client->SetSRM(new_srm_param) && client->UpdateSRM(delta_param);
+}
+
+void InitParam(std::default_random_engine& engine, TensorMap* delta_param,
+               TensorMap* new_srm_param, TensorMap* new_tsr_param) {
+  using tsr_t = DataType::tsr_t;
+  using srm_t = DataType::srm_t;
+  using int_t = DataType::int_t;
+
+  delta_param->insert<tsr_t>("TSR_W").resize(FLAGS_tsr_size).randn(engine);
+  new_tsr_param->insert<tsr_t>("TSR_W").resize(FLAGS_tsr_size);
+
+  auto& delta_W = delta_param->insert<srm_t>("SRM_W");
+  delta_W.set_col(FLAGS_srm_col);
+  delta_W.set_initializer(TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  auto& new_W = new_srm_param->insert<srm_t>("SRM_W");
+  new_W.set_col(FLAGS_srm_col);
+  new_W.set_initializer(TENSOR_INITIALIZER_TYPE_RANDN, 0, 1);
+  for (int_t id = 0; id < (int_t)FLAGS_srm_row; ++id) {
+    delta_W.get_row(engine, id);
+    if (id % 8 == 0) {
+      new_W.get_row(engine, id);
+    }
+  }
+}
+
+template <class Func>
+void Run(const char* mode, Func&& func) {
+  std::vector<double> latency(FLAGS_iteration);
+  for (int i = 0; i < FLAGS_iteration; ++i) {
+    auto begin = std::chrono::steady_clock::now();
+    DXCHECK_THROW(func());
+    auto end = std::chrono::steady_clock::now();
+    latency[i] =
+        std::chrono::duration<double, std::micro>(end - begin).count();
+  }
+
+  std::sort(latency.begin(), latency.end());
+  double total = 0;
+  for (double l : latency) {
+    total += l;
+  }
+  DXINFO("%-12s avg=%.1fus p50=%.1fus p99=%.1fus", mode,
+         total / FLAGS_iteration, latency[FLAGS_iteration / 2],
+         latency[FLAGS_iteration * 99 / 100]);
+}
+
+int main(int argc, char** argv) {
+  google::SetUsageMessage("Usage: [Options]");
+#if HAVE_COMPILE_FLAGS_H == 1
+  google::SetVersionString("\n\n"
+#include "compile_flags.h"
+  );
+#endif
+  google::ParseCommandLineFlags(&argc, &argv, true);
+
+#if OS_POSIX == 1
+  DXCHECK_THROW(FLAGS_server_delay_us >= 0);
+  DXCHECK_THROW(FLAGS_iteration > 0);
+  DXCHECK_THROW(FLAGS_tsr_size > 0);
+  DXCHECK_THROW(FLAGS_srm_row > 0);
+  DXCHECK_THROW(FLAGS_srm_col > 0);
+
+  StandInProxyServer server;
+  DXCHECK_THROW(server.Start("psstor_proxy:" + std::to_string(FLAGS_model_id) +
+                             "/" + FLAGS_client_uuid));
+
+  std::unique_ptr<WePSClient> client = NewWePSClient("proxy");
+  DXCHECK_THROW(client);
+  StringMap config;
+  config["model_id"] = std::to_string(FLAGS_model_id);
+  config["client_uuid"] = FLAGS_client_uuid;
+  DXCHECK_THROW(client->InitConfig(config));
+
+  std::default_random_engine engine;
+  TensorMap delta_param, new_srm_param, new_tsr_param;
+  InitParam(engine, &delta_param, &new_srm_param, &new_tsr_param);
+
+  Run("sequential", [&]() {
+    return SequentialUpdateParam(client.get(), delta_param, new_srm_param,
+                                 &new_tsr_param);
+  });
+  Run("pipelined", [&]() {
+    return client->UpdateParam(delta_param, new_srm_param, &new_tsr_param);
+  });
+#else
+  DXERROR("WePSProxyClient is only available on POSIX systems.");
+#endif
+
+  google::ShutDownCommandLineFlags();
+  return 0;
+}
+
+}  // namespace
+}  // namespace deepx_core
+
+int main(int argc, char** argv) { return deepx_core::main(argc, argv); }